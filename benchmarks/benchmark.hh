@@ -0,0 +1,186 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// A minimal benchmark harness: each benchmark is run for at least a minimum time, and its
+// results (time per item, items per second) are printed and collected for a JSON report.
+
+// Keep the compiler from optimizing away a value that a benchmark computes
+template<typename T>
+inline void do_not_optimize( const T& value )
+{
+  asm volatile( "" : : "r,m"( value ) : "memory" );
+}
+
+class BenchmarkSuite
+{
+public:
+  struct Result
+  {
+    std::string name;
+    uint64_t iterations;
+    uint64_t items;
+    double ns_per_item;
+    double items_per_second;
+    std::vector<std::pair<std::string, double>> counters {}; // anything else worth tracking
+  };
+
+private:
+  std::chrono::nanoseconds min_time_;
+  std::string filter_;
+  std::vector<Result> results_ {};
+
+public:
+  explicit BenchmarkSuite( std::chrono::nanoseconds min_time, std::string filter = {} )
+    : min_time_( min_time ), filter_( std::move( filter ) )
+  {}
+
+  // Record the result of a benchmark that was timed by the caller
+  void report( std::string_view name,
+               uint64_t iterations,
+               uint64_t items,
+               std::chrono::nanoseconds elapsed,
+               std::vector<std::pair<std::string, double>> counters = {} )
+  {
+    const auto ns = static_cast<double>( elapsed.count() );
+    Result result { std::string { name },
+                    iterations,
+                    items,
+                    ns / static_cast<double>( items ),
+                    static_cast<double>( items ) * 1e9 / ns,
+                    std::move( counters ) };
+    std::cerr << result.name << ": " << result.ns_per_item << " ns/item, " << result.items_per_second
+              << " items/s (" << result.iterations << " iterations)";
+    for ( const auto& [counter, value] : result.counters ) {
+      std::cerr << ", " << counter << "=" << value;
+    }
+    std::cerr << "\n";
+    results_.push_back( std::move( result ) );
+  }
+
+  // Whether a benchmark is selected by the name filter (a substring; empty selects all)
+  bool selected( std::string_view name ) const { return name.find( filter_ ) != std::string_view::npos; }
+
+  // Time `body`, which handles `items_per_call` items per call, over at least the minimum time
+  void run( std::string_view name, uint64_t items_per_call, const std::function<void()>& body )
+  {
+    run_timed( name, items_per_call, [&] {
+      const auto start = std::chrono::steady_clock::now();
+      body();
+      return std::chrono::steady_clock::now() - start;
+    } );
+  }
+
+  // Same, for a body that times its own measured section and returns how long it took (so that
+  // per-call setup is not counted)
+  void run_timed( std::string_view name,
+                  uint64_t items_per_call,
+                  const std::function<std::chrono::nanoseconds()>& body )
+  {
+    if ( not selected( name ) ) {
+      return;
+    }
+    body(); // warm up
+    uint64_t iterations = 0;
+    std::chrono::nanoseconds elapsed {};
+    while ( elapsed < min_time_ ) {
+      elapsed += body();
+      iterations++;
+    }
+    report( name, iterations, iterations * items_per_call, elapsed );
+  }
+
+  // Record a benchmark that was not run, so that the report says why
+  void skip( std::string_view name, std::string_view reason )
+  {
+    if ( selected( name ) ) {
+      std::cerr << name << ": skipped (" << reason << ")\n";
+    }
+  }
+
+  void write_json( std::ostream& out ) const
+  {
+    out << "{\n  \"benchmarks\": [";
+    for ( size_t i = 0; i < results_.size(); i++ ) {
+      const Result& r = results_[i];
+      out << ( i == 0 ? "\n" : ",\n" ) << "    {\"name\": \"" << r.name << "\", \"iterations\": " << r.iterations
+          << ", \"items\": " << r.items << ", \"ns_per_item\": " << r.ns_per_item
+          << ", \"items_per_second\": " << r.items_per_second;
+      for ( const auto& [counter, value] : r.counters ) {
+        out << ", \"" << counter << "\": " << value;
+      }
+      out << "}";
+    }
+    out << "\n  ]\n}\n";
+  }
+};
+
+// Parse the common command line: [--json FILE] [--min-time SECONDS] [--filter SUBSTRING], plus any
+// benchmark-specific [--NAME VALUE] parameters
+struct BenchmarkOptions
+{
+  std::string json_path {};
+  double min_time_seconds { 0.2 };
+  std::string filter {};
+  std::map<std::string, std::string, std::less<>> parameters {};
+
+  // A benchmark-specific parameter, or `fallback` if it was not given
+  double get( std::string_view name, double fallback ) const
+  {
+    const auto it = parameters.find( name );
+    return it == parameters.end() ? fallback : std::stod( it->second );
+  }
+
+  static BenchmarkOptions parse( int argc, char* argv[] ) // NOLINT(*-avoid-c-arrays)
+  {
+    BenchmarkOptions options;
+    const std::vector<std::string_view> args( argv + 1, argv + argc );
+    for ( size_t i = 0; i + 1 < args.size(); i += 2 ) {
+      if ( args[i] == "--json" ) {
+        options.json_path = args[i + 1];
+      } else if ( args[i] == "--min-time" ) {
+        options.min_time_seconds = std::stod( std::string { args[i + 1] } );
+      } else if ( args[i] == "--filter" ) {
+        options.filter = args[i + 1];
+      } else if ( args[i].starts_with( "--" ) ) {
+        options.parameters.emplace( args[i].substr( 2 ), args[i + 1] );
+      } else {
+        throw std::runtime_error( "usage: " + std::string { argv[0] }
+                                  + " [--json FILE] [--min-time SECONDS] [--filter SUBSTRING] [--NAME VALUE]..." );
+      }
+    }
+    if ( args.size() % 2 != 0 ) {
+      throw std::runtime_error( "missing value for " + std::string { args.back() } );
+    }
+    return options;
+  }
+
+  BenchmarkSuite suite() const
+  {
+    return BenchmarkSuite { std::chrono::nanoseconds { static_cast<int64_t>( min_time_seconds * 1e9 ) }, filter };
+  }
+
+  // Write the JSON report to the --json file (if one was given)
+  void finish( const BenchmarkSuite& suite ) const
+  {
+    if ( json_path.empty() ) {
+      return;
+    }
+    std::ofstream out { json_path };
+    suite.write_json( out );
+    if ( not out ) {
+      throw std::runtime_error( "could not write " + json_path );
+    }
+  }
+};
@@ -0,0 +1,121 @@
+#include "benchmark.hh"
+
+#include "fabric_simulator.hh"
+
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+
+using namespace std;
+
+// Simulates a leaf-spine fabric (see FabricSimulator): every leaf router is joined to every spine
+// router, and has its own hosts, each of which sends datagrams at a steady rate to a random host
+// of another leaf. Leaves spread their traffic over the spines by ECMP. Reports how fast the
+// simulation runs (router hops per second of wall-clock time) and what it simulated (datagrams
+// delivered and dropped, end-to-end and per-hop latency).
+//
+// Host h of leaf l is 10.l.h.2, behind the leaf's interface 10.l.h.1; the link between spine s
+// and leaf l is 172.(16 + s).l.0/30.
+//
+// usage: benchmark_fabric [--spines S] [--leaves L] [--hosts H (per leaf)] [--ms MILLISECONDS]
+//                         [--interval MILLISECONDS (between a host's datagrams)] [--threads T]
+//                         [--json FILE]
+
+namespace {
+
+string dotted( const size_t a, const size_t b, const size_t c, const size_t d )
+{
+  return to_string( a ) + "." + to_string( b ) + "." + to_string( c ) + "." + to_string( d );
+}
+
+uint32_t ip( const string& str )
+{
+  return Address { str }.ipv4_numeric();
+}
+
+} // namespace
+
+int main( int argc, char* argv[] )
+{
+  try {
+    const BenchmarkOptions options = BenchmarkOptions::parse( argc, argv );
+    BenchmarkSuite suite = options.suite();
+
+    const auto spines = static_cast<size_t>( options.get( "spines", 4 ) );
+    const auto leaves = static_cast<size_t>( options.get( "leaves", 32 ) );
+    const auto hosts = static_cast<size_t>( options.get( "hosts", 64 ) );
+    const auto ms = static_cast<uint64_t>( options.get( "ms", 1000 ) );
+    const auto interval = static_cast<uint64_t>( options.get( "interval", 2 ) );
+    const auto threads = static_cast<size_t>( options.get( "threads", 1 ) );
+    if ( spines == 0 or spines > 16 or leaves < 2 or leaves > 250 or hosts == 0 or hosts > 250 or interval == 0 ) {
+      throw runtime_error( "need 1-16 spines, 2-250 leaves, 1-250 hosts per leaf and an interval of at least 1" );
+    }
+
+    FabricSimulator sim;
+    vector<size_t> spine_routers;
+    for ( size_t s = 0; s < spines; s++ ) {
+      spine_routers.push_back( sim.add_router() );
+    }
+    for ( size_t l = 0; l < leaves; l++ ) {
+      const size_t leaf = sim.add_router();
+      for ( size_t s = 0; s < spines; s++ ) {
+        const string spine_side = dotted( 172, 16 + s, l, 1 );
+        const string leaf_side = dotted( 172, 16 + s, l, 2 );
+        const auto [spine_port, leaf_port]
+          = sim.connect( spine_routers[s], Address { spine_side }, leaf, Address { leaf_side } );
+        sim.router( spine_routers[s] ).add_route( ip( dotted( 10, l, 0, 0 ) ), 16, Address { leaf_side }, spine_port );
+        sim.router( leaf ).add_path( 0, 0, Address { spine_side }, leaf_port );
+      }
+      for ( size_t h = 0; h < hosts; h++ ) {
+        const size_t host = sim.add_host( leaf, Address { dotted( 10, l, h, 2 ) }, Address { dotted( 10, l, h, 1 ) } );
+        sim.router( leaf ).add_route( ip( dotted( 10, l, h, 0 ) ), 24, {}, sim.attachment( host ) );
+      }
+    }
+
+    // Every host sends to a random host of another leaf
+    mt19937 rng { 458 };
+    uniform_int_distribution<size_t> other_leaf { 1, leaves - 1 };
+    uniform_int_distribution<size_t> any_host { 0, hosts - 1 };
+    uniform_int_distribution<uint64_t> phase { 0, interval - 1 };
+    vector<Address> destinations;
+    vector<uint64_t> phases;
+    for ( size_t l = 0; l < leaves; l++ ) {
+      for ( size_t h = 0; h < hosts; h++ ) {
+        destinations.emplace_back( dotted( 10, ( l + other_leaf( rng ) ) % leaves, any_host( rng ), 2 ) );
+        phases.push_back( phase( rng ) );
+      }
+    }
+
+    // Warm up (ARP resolution along every path) before measuring
+    for ( size_t host = 0; host < sim.hosts(); host++ ) {
+      sim.add_flow( host, destinations[host], 4, interval, phases[host] );
+    }
+    sim.run( 4 * interval + 50, threads );
+
+    for ( size_t host = 0; host < sim.hosts(); host++ ) {
+      sim.add_flow( host, destinations[host], ms / interval, interval, phases[host] );
+    }
+    const FabricSimulator::Report report = sim.run( ms, threads );
+
+    const string name = "fabric/" + to_string( spines ) + "_spines_" + to_string( leaves ) + "_leaves_"
+                        + to_string( sim.hosts() ) + "_hosts_" + to_string( report.threads ) + "_threads";
+    suite.report( name,
+                  report.windows,
+                  max<uint64_t>( report.forwarded, 1 ),
+                  report.wall,
+                  { { "sent", static_cast<double>( report.sent ) },
+                    { "delivered", static_cast<double>( report.delivered ) },
+                    { "link_drops", static_cast<double>( report.link_drops ) },
+                    { "e2e_p99_us", static_cast<double>( report.end_to_end.percentile( 0.99 ) ) },
+                    { "hop_p50_us", static_cast<double>( report.per_hop.percentile( 0.5 ) ) } } );
+    report.print( cout );
+
+    options.finish( suite );
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,390 @@
+#include "benchmark.hh"
+
+#include "alloc_tracker.hh"
+#include "arp_message.hh"
+#include "cpu_affinity.hh"
+#include "ethernet_frame.hh"
+#include "ipv4_datagram.hh"
+#include "network_interface.hh"
+#include "router.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+// End-to-end forwarding throughput: hosts on N Ethernet segments (each a NetworkInterface of
+// its own) send datagrams to each other through one Router, with Zipf-distributed destinations.
+// Reports packets per second, ns per packet and heap allocations per packet, at steady state.
+//
+// With --workers W (more than 1), the router forwards with route_parallel( W ), and with --pin 1
+// its workers are pinned to one CPU each (see Router::set_worker_cpus()), to compare pinned and
+// unpinned throughput.
+//
+// Built as benchmark_forwarding_instrumented (see benchmarks/CMakeLists.txt), it also reports the
+// allocations per packet of each call site, from the allocation tracker.
+//
+// usage: benchmark_forwarding [--interfaces N] [--hosts M] [--routes K] [--zipf S] [--packets P]
+//                             [--burst B] [--payload BYTES] [--workers W] [--pin 0|1] [--json FILE]
+
+// -- Allocation counting (every operator new in the process; the instrumented build's allocation
+// tracker does this itself) --
+
+#ifndef ALLOCATION_TRACKING
+namespace {
+atomic<uint64_t> allocation_count { 0 };
+
+void* counted_allocation( size_t size, size_t alignment )
+{
+  allocation_count.fetch_add( 1, memory_order_relaxed );
+  size = max<size_t>( size, 1 );
+  void* const p = alignment <= alignof( max_align_t )
+                    ? malloc( size )                                                   // NOLINT(*-no-malloc)
+                    : aligned_alloc( alignment, ( size + alignment - 1 ) / alignment * alignment ); // NOLINT(*-no-malloc)
+  if ( p == nullptr ) {
+    throw bad_alloc();
+  }
+  return p;
+}
+} // namespace
+
+void* operator new( size_t size )
+{
+  return counted_allocation( size, alignof( max_align_t ) );
+}
+void* operator new( size_t size, align_val_t alignment )
+{
+  return counted_allocation( size, static_cast<size_t>( alignment ) );
+}
+void operator delete( void* p ) noexcept
+{
+  free( p ); // NOLINT(*-no-malloc)
+}
+void operator delete( void* p, size_t /* size */ ) noexcept
+{
+  free( p ); // NOLINT(*-no-malloc)
+}
+void operator delete( void* p, align_val_t /* alignment */ ) noexcept
+{
+  free( p ); // NOLINT(*-no-malloc)
+}
+void operator delete( void* p, size_t /* size */, align_val_t /* alignment */ ) noexcept
+{
+  free( p ); // NOLINT(*-no-malloc)
+}
+#endif
+
+namespace {
+
+uint64_t allocations_so_far()
+{
+#ifdef ALLOCATION_TRACKING
+  return alloc_tracker::totals().allocations;
+#else
+  return allocation_count.load();
+#endif
+}
+
+} // namespace
+
+namespace {
+
+// Ranks 0 .. n-1, where rank r is drawn with probability proportional to 1 / (r + 1)^s
+class ZipfDistribution
+{
+  vector<double> cdf_ {};
+
+public:
+  ZipfDistribution( size_t n, double s )
+  {
+    double total = 0;
+    for ( size_t r = 0; r < n; r++ ) {
+      total += 1.0 / pow( static_cast<double>( r + 1 ), s );
+      cdf_.push_back( total );
+    }
+    for ( double& c : cdf_ ) {
+      c /= total;
+    }
+  }
+
+  template<class Generator>
+  size_t operator()( Generator& rng )
+  {
+    const double u = uniform_real_distribution<double> { 0, 1 }( rng );
+    return min<size_t>( lower_bound( cdf_.begin(), cdf_.end(), u ) - cdf_.begin(), cdf_.size() - 1 );
+  }
+};
+
+struct Topology
+{
+  size_t interfaces;
+  size_t hosts;
+  size_t routes;
+  double zipf;
+  uint64_t packets;
+  size_t burst;
+  size_t payload;
+  size_t workers;
+  bool pin;
+};
+
+// Host h lives on segment h % interfaces, at 10.<segment>.x.y; the router is 10.<segment>.255.254
+class Network
+{
+  struct Host
+  {
+    NetworkInterface interface;
+    size_t segment;
+    uint32_t ip;
+  };
+
+  Topology topology_;
+  Router router_ {};
+  vector<Host> hosts_ {};
+  ZipfDistribution destinations_;
+  vector<size_t> destination_hosts_ {}; // host of each Zipf rank (shuffled, so ranks are not segments)
+  mt19937 rng_ { 458 };
+  Buffer payload_;
+
+  vector<size_t> busy_hosts_ {}; // hosts that may have frames to send
+  vector<char> busy_ {};
+  vector<EthernetFrame> frames_ {};
+
+  uint64_t rounds_ {};
+  uint64_t sent_ {};
+  uint64_t delivered_ {};
+
+  static EthernetAddress host_eth( size_t h )
+  {
+    return { 0x02, 0x01, 0, static_cast<uint8_t>( h >> 16 ), static_cast<uint8_t>( h >> 8 ), static_cast<uint8_t>( h ) };
+  }
+  static EthernetAddress router_eth( size_t segment )
+  {
+    return { 0x02, 0, 0, 0, static_cast<uint8_t>( segment >> 8 ), static_cast<uint8_t>( segment ) };
+  }
+  static uint32_t gateway_ip( size_t segment ) { return 0x0A'00'FF'FE | static_cast<uint32_t>( segment << 16 ); }
+
+  size_t host_of( const EthernetAddress& eth ) const
+  {
+    return static_cast<size_t>( eth[3] ) << 16 | static_cast<size_t>( eth[4] ) << 8 | eth[5];
+  }
+
+  void mark_busy( size_t h )
+  {
+    if ( not busy_[h] ) {
+      busy_[h] = 1;
+      busy_hosts_.push_back( h );
+    }
+  }
+
+  // Hosts' frames go onto their segment, to the router
+  void flush_hosts()
+  {
+    for ( const size_t h : busy_hosts_ ) {
+      busy_[h] = 0;
+      while ( auto frame = hosts_[h].interface.maybe_send() ) {
+        router_.interface( hosts_[h].segment ).recv_frame( *frame );
+      }
+    }
+    busy_hosts_.clear();
+  }
+
+  // The router's frames go to their host (a broadcast ARP request only to the host it asks
+  // for, as a switch with ARP suppression would do)
+  void flush_router()
+  {
+    for ( size_t segment = 0; segment < topology_.interfaces; segment++ ) {
+      frames_.clear();
+      router_.interface( segment ).maybe_send_batch( frames_ );
+      for ( const auto& frame : frames_ ) {
+        size_t h = host_of( frame.header.dst );
+        if ( frame.header.dst == ETHERNET_BROADCAST ) {
+          ARPMessage arp;
+          if ( not parse( arp, frame.payload ) ) {
+            continue;
+          }
+          const uint32_t k = ( arp.target_ip_address & 0xFFFF ) - 1;
+          h = k * topology_.interfaces + segment;
+        }
+        if ( h >= hosts_.size() ) {
+          continue;
+        }
+        if ( hosts_[h].interface.recv_frame( frame ).has_value() ) {
+          delivered_++;
+        }
+        mark_busy( h );
+      }
+    }
+  }
+
+public:
+  explicit Network( const Topology& topology )
+    : topology_( topology )
+    , destinations_( topology.hosts, topology.zipf )
+    , payload_( string( topology.payload, 'x' ) )
+    , busy_( topology.hosts, 0 )
+  {
+    vector<Router::Route> routes;
+    for ( size_t segment = 0; segment < topology.interfaces; segment++ ) {
+      router_.add_interface(
+        AsyncNetworkInterface { router_eth( segment ), Address::from_ipv4_numeric( gateway_ip( segment ) ) } );
+      routes.push_back( { 0x0A'00'00'00 | static_cast<uint32_t>( segment << 16 ), 16, {}, segment } );
+    }
+
+    hosts_.reserve( topology.hosts );
+    for ( size_t h = 0; h < topology.hosts; h++ ) {
+      const size_t segment = h % topology.interfaces;
+      const auto k = static_cast<uint32_t>( h / topology.interfaces + 1 );
+      const uint32_t ip = 0x0A'00'00'00 | static_cast<uint32_t>( segment << 16 ) | k;
+      hosts_.push_back( { NetworkInterface { host_eth( h ), Address::from_ipv4_numeric( ip ) }, segment, ip } );
+    }
+
+    // More specific routes around random hosts (the same interface as their /16, but
+    // exercising the longest-prefix match)
+    for ( size_t r = topology.interfaces; r < topology.routes; r++ ) {
+      const Host& host = hosts_[rng_() % hosts_.size()];
+      const auto length = static_cast<uint8_t>( 17 + rng_() % 14 );
+      const uint32_t prefix = host.ip & ~( ( 1U << ( 32 - length ) ) - 1 );
+      routes.push_back( { prefix, length, {}, host.segment } );
+    }
+    router_.load_routes( routes );
+
+    // (worker w on the w-th allowed CPU, wrapping around if there are more workers than CPUs)
+    if ( topology.pin ) {
+      const vector<int>& allowed = allowed_cpus();
+      vector<int> cpus;
+      for ( size_t w = 0; w < topology.workers; w++ ) {
+        cpus.push_back( allowed[w % allowed.size()] );
+      }
+      router_.set_worker_cpus( std::move( cpus ) );
+    }
+
+    destination_hosts_.resize( topology.hosts );
+    iota( destination_hosts_.begin(), destination_hosts_.end(), 0 );
+    shuffle( destination_hosts_.begin(), destination_hosts_.end(), rng_ );
+  }
+
+  // One round: every host in a burst sends a datagram, then the router forwards everything
+  void round()
+  {
+    for ( size_t i = 0; i < topology_.burst; i++ ) {
+      const size_t src = rng_() % hosts_.size();
+      size_t dst = destination_hosts_[destinations_( rng_ )];
+      dst = dst == src ? ( dst + 1 ) % hosts_.size() : dst;
+
+      InternetDatagram dgram;
+      dgram.header.src = hosts_[src].ip;
+      dgram.header.dst = hosts_[dst].ip;
+      dgram.header.len = IPv4Header::LENGTH + topology_.payload;
+      dgram.header.compute_checksum();
+      dgram.payload.push_back( payload_ );
+      hosts_[src].interface.send_datagram( std::move( dgram ), gateway_ip( hosts_[src].segment ) );
+      mark_busy( src );
+    }
+    sent_ += topology_.burst;
+
+    flush_hosts();
+    router_.route_parallel( topology_.workers );
+    flush_router();
+    flush_hosts(); // ARP replies
+
+    // a millisecond per round for the router, and a second per thousand rounds for the hosts
+    for ( size_t segment = 0; segment < topology_.interfaces; segment++ ) {
+      router_.interface( segment ).tick( 1 );
+    }
+    if ( ++rounds_ % 1000 == 0 ) {
+      for ( auto& host : hosts_ ) {
+        host.interface.tick( 1000 );
+      }
+    }
+  }
+
+  uint64_t sent() const { return sent_; }
+  uint64_t delivered() const { return delivered_; }
+  Router& router() { return router_; }
+};
+
+} // namespace
+
+int main( int argc, char* argv[] )
+{
+  try {
+    const BenchmarkOptions options = BenchmarkOptions::parse( argc, argv );
+    BenchmarkSuite suite = options.suite();
+
+    Topology topology {};
+    topology.interfaces = static_cast<size_t>( options.get( "interfaces", 4 ) );
+    topology.hosts = static_cast<size_t>( options.get( "hosts", 1000 ) );
+    topology.routes = static_cast<size_t>( options.get( "routes", 1000 ) );
+    topology.zipf = options.get( "zipf", 1.0 );
+    topology.packets = static_cast<uint64_t>( options.get( "packets", 2'000'000 ) );
+    topology.burst = static_cast<size_t>( options.get( "burst", 256 ) );
+    topology.payload = static_cast<size_t>( options.get( "payload", 64 ) );
+    topology.workers = static_cast<size_t>( options.get( "workers", 1 ) );
+    topology.pin = options.get( "pin", 0 ) != 0;
+    if ( topology.interfaces == 0 or topology.interfaces > 256 or topology.hosts < 2
+         or topology.hosts / topology.interfaces > 65'000 ) {
+      throw runtime_error( "need 1-256 interfaces, and 2 to 65,000 hosts per interface" );
+    }
+
+    Network network { topology };
+
+    // Warm up (ARP resolution, pools, queues) before measuring
+    while ( network.sent() < max<uint64_t>( topology.packets / 10, topology.hosts * 4 ) ) {
+      network.round();
+    }
+
+    const uint64_t sent_before = network.sent();
+    const uint64_t delivered_before = network.delivered();
+    alloc_tracker::reset();
+    const uint64_t allocations_before = allocations_so_far();
+    const Router::Stats stats_before = network.router().stats();
+    uint64_t rounds = 0;
+
+    const auto start = steady_clock::now();
+    while ( network.sent() - sent_before < topology.packets ) {
+      network.round();
+      rounds++;
+    }
+    const auto elapsed = steady_clock::now() - start;
+
+    const uint64_t delivered = network.delivered() - delivered_before;
+    const uint64_t allocations = allocations_so_far() - allocations_before;
+    const Router::Stats stats = network.router().stats();
+
+    const string name = "forwarding/" + to_string( topology.interfaces ) + "_interfaces_"
+                        + to_string( topology.hosts ) + "_hosts_" + to_string( topology.routes ) + "_routes"
+                        + ( topology.workers > 1 ? "_" + to_string( topology.workers ) + "_workers" : "" )
+                        + ( topology.pin ? "_pinned" : "" );
+    suite.report( name,
+                  rounds,
+                  max<uint64_t>( delivered, 1 ),
+                  duration_cast<nanoseconds>( elapsed ),
+                  { { "sent", static_cast<double>( network.sent() - sent_before ) },
+                    { "delivered", static_cast<double>( delivered ) },
+                    { "forwarded", static_cast<double>( stats.forwarded - stats_before.forwarded ) },
+                    { "allocations_per_packet",
+                      static_cast<double>( allocations ) / static_cast<double>( max<uint64_t>( delivered, 1 ) ) } } );
+
+    if constexpr ( ALLOCATION_TRACKING_ENABLED ) {
+      cout << "per packet delivered, by call site:\n";
+      alloc_tracker::report( cout, max<uint64_t>( delivered, 1 ) );
+    }
+
+    options.finish( suite );
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
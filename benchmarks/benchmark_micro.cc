@@ -0,0 +1,440 @@
+#include "benchmark.hh"
+
+#include "acl.hh"
+#include "address_map.hh"
+#include "arp_message.hh"
+#include "checksum.hh"
+#include "ethernet_frame.hh"
+#include "flow_table.hh"
+#include "ipv4_datagram.hh"
+#include "ipv4_header.hh"
+#include "neighbor_store.hh"
+#include "network_interface.hh"
+#include "packet_sampler.hh"
+#include "router.hh"
+
+#include <cstdlib>
+#include <deque>
+#include <filesystem>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+namespace {
+
+const EthernetAddress router_eth { 0x02, 0, 0, 0, 0, 1 };
+const EthernetAddress host_eth { 0x02, 0, 0, 0, 0, 2 };
+
+// The ARP reply that teaches `interface` the Ethernet address of `ip`
+EthernetFrame arp_reply( const EthernetAddress& local_eth, uint32_t local_ip, const EthernetAddress& eth, uint32_t ip )
+{
+  ARPMessage arp;
+  arp.opcode = ARPMessage::OPCODE_REPLY;
+  arp.sender_ethernet_address = eth;
+  arp.sender_ip_address = ip;
+  arp.target_ethernet_address = local_eth;
+  arp.target_ip_address = local_ip;
+  EthernetFrame frame;
+  frame.header = { local_eth, eth, EthernetHeader::TYPE_ARP };
+  frame.payload = serialize( arp );
+  return frame;
+}
+
+InternetDatagram make_datagram( uint32_t dst, size_t payload_size )
+{
+  InternetDatagram dgram;
+  dgram.header.src = 0x0A'00'00'02;
+  dgram.header.dst = dst;
+  dgram.header.ttl = 64;
+  dgram.payload.emplace_back( string( payload_size, 'x' ) );
+  dgram.header.len = IPv4Header::LENGTH + payload_size;
+  dgram.header.compute_checksum();
+  return dgram;
+}
+
+// Items are bytes
+void bench_checksum( BenchmarkSuite& suite )
+{
+  for ( const size_t size : { 20, 64, 576, 1500, 9000 } ) {
+    const string data( size, '\x5a' );
+    suite.run( "checksum_add/" + to_string( size ), size, [&] {
+      InternetChecksum sum;
+      sum.add( data );
+      do_not_optimize( sum.value() );
+    } );
+  }
+}
+
+void bench_ipv4_header( BenchmarkSuite& suite )
+{
+  const InternetDatagram dgram = make_datagram( 0xC0'A8'00'05, 0 );
+  const vector<Buffer> wire = serialize( dgram.header );
+
+  suite.run( "ipv4_header_parse", 1, [&] {
+    IPv4Header header;
+    do_not_optimize( parse( header, wire ) );
+    do_not_optimize( header );
+  } );
+
+  suite.run( "ipv4_header_serialize", 1, [&] {
+    const vector<Buffer> out = serialize( dgram.header );
+    do_not_optimize( out );
+  } );
+}
+
+void bench_route( BenchmarkSuite& suite )
+{
+  constexpr size_t burst = 256;
+
+  for ( const size_t num_routes : { 10UL, 1'000UL, 100'000UL, 1'000'000UL } ) {
+    const string name = "router_route/" + to_string( num_routes ) + "_routes";
+    if ( not suite.selected( name ) ) {
+      continue;
+    }
+
+    Router router;
+    const uint32_t in_ip = 0x0A'00'00'01;
+    const uint32_t out_ip = 0x0B'00'00'01;
+    const uint32_t gateway = 0x0B'00'00'02;
+    router.add_interface( AsyncNetworkInterface { router_eth, Address::from_ipv4_numeric( in_ip ) } );
+    router.add_interface( AsyncNetworkInterface { { 0x02, 0, 0, 0, 1, 1 }, Address::from_ipv4_numeric( out_ip ) } );
+    router.interface( 1 ).recv_frame( arp_reply( { 0x02, 0, 0, 0, 1, 1 }, out_ip, host_eth, gateway ) );
+
+    // random prefixes from /8 to /24, all through the gateway (destinations are picked among them)
+    mt19937 rng { 458 };
+    vector<Router::Route> routes;
+    vector<uint32_t> destinations;
+    for ( size_t i = 0; i < num_routes; i++ ) {
+      const auto length = static_cast<uint8_t>( 8 + rng() % 17 );
+      const uint32_t prefix = static_cast<uint32_t>( rng() ) & ~( ( 1U << ( 32 - length ) ) - 1 );
+      routes.push_back( { prefix, length, gateway, 1 } );
+      destinations.push_back( prefix | ( rng() & ( ( 1U << ( 32 - length ) ) - 1 ) ) );
+    }
+    const auto load_start = steady_clock::now();
+    router.load_routes( routes );
+    cerr << name << ": loaded in " << duration<double, milli>( steady_clock::now() - load_start ).count()
+         << " ms\n";
+
+    // startup from a saved table instead
+    const string snapshot = ( filesystem::temp_directory_path() / "benchmark_micro.fib" ).string();
+    router.save_fib_snapshot( snapshot );
+    const auto snapshot_start = steady_clock::now();
+    router.load_fib_snapshot( snapshot );
+    cerr << name << ": loaded from a snapshot in "
+         << duration<double, milli>( steady_clock::now() - snapshot_start ).count() << " ms\n";
+    filesystem::remove( snapshot );
+
+    vector<EthernetFrame> frames;
+    for ( size_t i = 0; i < burst; i++ ) {
+      EthernetFrame frame;
+      frame.header = { router_eth, host_eth, EthernetHeader::TYPE_IPv4 };
+      frame.payload = serialize( make_datagram( destinations[rng() % destinations.size()], 64 ) );
+      frames.push_back( std::move( frame ) );
+    }
+
+    vector<EthernetFrame> sent;
+    suite.run_timed( name, burst, [&] {
+      for ( const auto& frame : frames ) {
+        router.interface( 0 ).recv_frame( frame );
+      }
+      const auto start = steady_clock::now();
+      router.route();
+      const auto elapsed = steady_clock::now() - start;
+      sent.clear();
+      router.interface( 1 ).maybe_send_batch( sent );
+      return elapsed;
+    } );
+  }
+}
+
+// Items are route changes: a diff of next-hop changes committed as one RouteUpdate, whose cost
+// should not depend on the size of the table
+void bench_route_update( BenchmarkSuite& suite )
+{
+  constexpr size_t diff_size = 1000;
+
+  for ( const size_t num_routes : { 10'000UL, 1'000'000UL } ) {
+    const string name = "route_update/" + to_string( num_routes ) + "_routes";
+    if ( not suite.selected( name ) ) {
+      continue;
+    }
+
+    Router router;
+    router.add_interface( AsyncNetworkInterface { router_eth, Address::from_ipv4_numeric( 0x0A'00'00'01 ) } );
+    router.add_interface( AsyncNetworkInterface { { 0x02, 0, 0, 0, 1, 1 }, Address::from_ipv4_numeric( 0x0B'00'00'01 ) } );
+
+    mt19937 rng { 458 };
+    vector<Router::Route> routes;
+    for ( size_t i = 0; i < num_routes; i++ ) {
+      const auto length = static_cast<uint8_t>( 8 + rng() % 17 );
+      const uint32_t prefix = static_cast<uint32_t>( rng() ) & ~( ( 1U << ( 32 - length ) ) - 1 );
+      routes.push_back( { prefix, length, 0x0B'00'00'02, 1 } );
+    }
+    router.load_routes( routes );
+
+    // moving a random thousand routes between two gateways, back and forth
+    vector<Router::RouteChange> diffs[2]; // NOLINT(*-avoid-c-arrays)
+    for ( size_t i = 0; i < diff_size; i++ ) {
+      const Router::Route& route = routes[rng() % routes.size()];
+      for ( uint32_t side = 0; side < 2; side++ ) {
+        diffs[side].push_back(
+          { Router::RouteChange::Kind::REPLACE, route.prefix, route.prefix_length, 0x0B'00'00'03 + side, 1 } );
+      }
+    }
+
+    size_t side = 0;
+    suite.run( name, diff_size, [&] {
+      Router::RouteUpdate update = router.begin_update();
+      update.apply( diffs[side] );
+      do_not_optimize( update.commit() );
+      side ^= 1;
+    } );
+  }
+}
+
+void bench_arp_lookup( BenchmarkSuite& suite )
+{
+  constexpr size_t burst = 256;
+  const uint32_t local_ip = 0x0A'00'00'01;
+
+  for ( const size_t neighbors : { 10UL, 10'000UL, 100'000UL } ) {
+    NetworkInterface interface { router_eth, Address::from_ipv4_numeric( local_ip ) };
+    for ( size_t i = 0; i < neighbors; i++ ) {
+      interface.recv_frame( arp_reply( router_eth, local_ip, host_eth, 0x14'00'00'00 + static_cast<uint32_t>( i ) ) );
+    }
+
+    mt19937 rng { 458 };
+    vector<uint32_t> next_hops;
+    for ( size_t i = 0; i < burst; i++ ) {
+      next_hops.push_back( 0x14'00'00'00 + static_cast<uint32_t>( rng() % neighbors ) );
+    }
+    const InternetDatagram dgram = make_datagram( 0xC0'A8'00'05, 64 );
+
+    vector<EthernetFrame> sent;
+    suite.run_timed( "arp_lookup/" + to_string( neighbors ) + "_neighbors", burst, [&] {
+      const auto start = steady_clock::now();
+      for ( const uint32_t next_hop : next_hops ) {
+        interface.send_datagram( dgram, next_hop );
+      }
+      const auto elapsed = steady_clock::now() - start;
+      sent.clear();
+      interface.maybe_send_batch( sent );
+      return elapsed;
+    } );
+  }
+}
+
+// Items are lookups of random present neighbors: the structure-of-arrays NeighborStore against
+// an AddressMap of whole entries, shaped as the ARP table's were before it
+void bench_neighbor_store( BenchmarkSuite& suite )
+{
+  constexpr size_t burst = 4096;
+
+  struct WholeEntry
+  {
+    bool complete_entry {};
+    uint32_t ip_address {};
+    EthernetAddress mac_address {};
+    uint64_t expiry_time {};
+    uint64_t refresh_time {};
+    uint64_t scheduled_time {};
+    std::deque<InternetDatagram> pending_datagrams {};
+    size_t pending_bytes {};
+  };
+  struct ColdState
+  {
+    uint64_t expiry_time {};
+    std::deque<InternetDatagram> pending_datagrams {};
+  };
+
+  for ( const size_t neighbors : { 1'000UL, 64'000UL, 1'000'000UL } ) {
+    mt19937 rng { 458 };
+    vector<uint32_t> keys;
+    for ( size_t i = 0; i < neighbors; i++ ) {
+      keys.push_back( static_cast<uint32_t>( rng() ) );
+    }
+
+    AddressMap<WholeEntry> whole;
+    NeighborStore<ColdState> store;
+    for ( const uint32_t key : keys ) {
+      WholeEntry& entry = whole.insert( key ).first;
+      entry.complete_entry = true;
+      entry.mac_address = host_eth;
+      store.set_complete( store.insert( key ).first, host_eth );
+    }
+
+    vector<uint32_t> probes;
+    for ( size_t i = 0; i < burst; i++ ) {
+      probes.push_back( keys[rng() % neighbors] );
+    }
+
+    const string size = to_string( neighbors / 1000 ) + "k";
+    suite.run( "neighbor_lookup_aos/" + size, burst, [&] {
+      for ( const uint32_t probe : probes ) {
+        const WholeEntry* entry = whole.find( probe );
+        do_not_optimize( entry != nullptr and entry->complete_entry ? &entry->mac_address : nullptr );
+      }
+    } );
+    suite.run( "neighbor_lookup_soa/" + size, burst, [&] {
+      for ( const uint32_t probe : probes ) {
+        do_not_optimize( store.find_complete( probe ) );
+      }
+    } );
+  }
+}
+
+// Items are datagrams counted in their flows (the per-datagram cost of Router::track_flows())
+void bench_flow_table( BenchmarkSuite& suite )
+{
+  constexpr size_t burst = 4096;
+
+  for ( const size_t num_flows : { 1'000UL, 100'000UL } ) {
+    FlowTable table { num_flows * 4 * 80, 60'000 }; // (room for at least twice as many flows)
+    mt19937 rng { 458 };
+    vector<FlowKey> flows;
+    for ( size_t i = 0; i < num_flows; i++ ) {
+      flows.push_back( { static_cast<uint32_t>( rng() ), static_cast<uint32_t>( rng() ), static_cast<uint32_t>( rng() ), 17 } );
+    }
+    vector<FlowKey> datagrams;
+    for ( size_t i = 0; i < burst; i++ ) {
+      datagrams.push_back( flows[rng() % num_flows] );
+    }
+
+    suite.run( "flow_record/" + to_string( num_flows ) + "_flows", burst, [&] {
+      for ( const FlowKey& key : datagrams ) {
+        do_not_optimize( table.record( key, FlowTable::hash( key ), 64, 0 ) );
+      }
+    } );
+  }
+}
+
+// Items are datagrams counted by the countdown of Router::start_sampling() (the whole cost of
+// sampling to a datagram that is not sampled)
+void bench_sample_countdown( BenchmarkSuite& suite )
+{
+  constexpr size_t burst = 4096;
+
+  for ( const uint32_t rate : { 0U, 1'000U } ) {
+    SampleCountdown countdown;
+    countdown.reset( rate, 458 );
+    suite.run( "sample_countdown/" + ( rate == 0 ? string { "off" } : "1_in_" + to_string( rate ) ), burst, [&] {
+      size_t sampled = 0;
+      for ( size_t i = 0; i < burst; i++ ) {
+        sampled += countdown.due() ? 1 : 0;
+      }
+      do_not_optimize( sampled );
+    } );
+  }
+}
+
+void bench_maybe_send( BenchmarkSuite& suite )
+{
+  const uint32_t local_ip = 0x0A'00'00'01;
+  const uint32_t neighbor_ip = 0x0A'00'00'02;
+  NetworkInterface interface { router_eth, Address::from_ipv4_numeric( local_ip ) };
+  interface.recv_frame( arp_reply( router_eth, local_ip, host_eth, neighbor_ip ) );
+  const InternetDatagram dgram = make_datagram( 0xC0'A8'00'05, 64 );
+
+  for ( const size_t burst : { 32UL, 256UL } ) {
+    suite.run_timed( "maybe_send_drain/" + to_string( burst ), burst, [&] {
+      for ( size_t i = 0; i < burst; i++ ) {
+        interface.send_datagram( dgram, neighbor_ip );
+      }
+      const auto start = steady_clock::now();
+      while ( auto frame = interface.maybe_send() ) {
+        do_not_optimize( frame );
+      }
+      return steady_clock::now() - start;
+    } );
+
+    vector<EthernetFrame> sent;
+    suite.run_timed( "maybe_send_batch_drain/" + to_string( burst ), burst, [&] {
+      for ( size_t i = 0; i < burst; i++ ) {
+        interface.send_datagram( dgram, neighbor_ip );
+      }
+      sent.clear();
+      const auto start = steady_clock::now();
+      interface.maybe_send_batch( sent );
+      return steady_clock::now() - start;
+    } );
+  }
+}
+
+// Items are datagrams classified: the compiled classifier against a scan of the same rules
+void bench_acl( BenchmarkSuite& suite )
+{
+  constexpr size_t burst = 256;
+
+  for ( const size_t num_rules : { 16UL, 256UL, 2048UL } ) {
+    // random rules over 10.0.0.0/8 (about half with a protocol), none of which most datagrams match,
+    // so that a scan has to try them all
+    mt19937 rng { 458 };
+    vector<AclRule> rules;
+    for ( size_t i = 0; i < num_rules; i++ ) {
+      AclRule rule;
+      rule.src_prefix = 0x0A'00'00'00 | ( static_cast<uint32_t>( rng() ) & 0x00FF'FFFF );
+      rule.src_length = static_cast<uint8_t>( 16 + rng() % 17 );
+      rule.dst_prefix = static_cast<uint32_t>( rng() );
+      rule.dst_length = static_cast<uint8_t>( 8 + rng() % 17 );
+      if ( rng() % 2 ) {
+        rule.proto = 17;
+      }
+      rule.action = AclRule::Action::DENY;
+      rules.push_back( rule );
+    }
+    const auto compile_start = steady_clock::now();
+    const AclClassifier acl { rules };
+    cerr << "acl/" << num_rules << "_rules: compiled in "
+         << duration<double, milli>( steady_clock::now() - compile_start ).count() << " ms\n";
+
+    vector<IPv4Header> headers( burst );
+    for ( auto& header : headers ) {
+      header.src = 0x0A'00'00'00 | ( static_cast<uint32_t>( rng() ) & 0x00FF'FFFF );
+      header.dst = static_cast<uint32_t>( rng() );
+      header.proto = 6;
+    }
+
+    suite.run( "acl_bitmap/" + to_string( num_rules ) + "_rules", burst, [&] {
+      for ( const auto& header : headers ) {
+        do_not_optimize( acl.match( header ) );
+      }
+    } );
+    suite.run( "acl_linear/" + to_string( num_rules ) + "_rules", burst, [&] {
+      for ( const auto& header : headers ) {
+        do_not_optimize( acl.match_linear( header ) );
+      }
+    } );
+  }
+}
+
+} // namespace
+
+int main( int argc, char* argv[] )
+{
+  try {
+    const BenchmarkOptions options = BenchmarkOptions::parse( argc, argv );
+    BenchmarkSuite suite = options.suite();
+
+    bench_checksum( suite );
+    bench_ipv4_header( suite );
+    bench_route( suite );
+    bench_route_update( suite );
+    bench_arp_lookup( suite );
+    bench_neighbor_store( suite );
+    bench_flow_table( suite );
+    bench_sample_countdown( suite );
+    bench_maybe_send( suite );
+    bench_acl( suite );
+
+    options.finish( suite );
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
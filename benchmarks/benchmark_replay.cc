@@ -0,0 +1,216 @@
+#include "benchmark.hh"
+
+#include "arp_message.hh"
+#include "ethernet_frame.hh"
+#include "packet_pool.hh"
+#include "pcap.hh"
+#include "router.hh"
+
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+// Replays a packet capture (pcap, as written by tcpdump -w or by a PcapWriter) through a Router:
+// every frame is received on interface 0, and whatever the router forwards leaves on interface 1,
+// where every next hop answers ARP. Reports frames per second and the rate in Gbit/s.
+//
+// By default frames are replayed as fast as the router takes them; --speed S replays them at S
+// times their original pace (1: as captured). Either way the router's clocks follow the capture's
+// timestamps, so ARP and reassembly timeouts happen as they did in the trace.
+//
+// usage: benchmark_replay --pcap FILE [--speed S] [--loops N] [--burst B] [--json FILE]
+namespace {
+
+const EthernetAddress INSIDE_ETH { 0x02, 0, 0, 0, 0, 0 };
+const EthernetAddress OUTSIDE_ETH { 0x02, 0, 0, 0, 0, 1 };
+const EthernetAddress NEXT_HOP_ETH { 0x02, 0, 0, 0, 0xFF, 0xFF };
+
+class Replay
+{
+  Router router_ {};
+  PacketPool pool_ {};
+  vector<EthernetFrame> frames_ {};
+
+  uint64_t received_ {};
+  uint64_t transmitted_ {};
+  uint64_t transmitted_bytes_ {};
+  uint64_t last_ms_ {}; // capture time the router's clocks are at
+
+  // Frames the router sends on interface 1: an ARP request is answered, anything else counted
+  // as transmitted. (Interface 0's frames, e.g. answers to ARP in the capture, are dropped.)
+  void drain()
+  {
+    frames_.clear();
+    router_.interface( 0 ).maybe_send_batch( frames_ );
+
+    frames_.clear();
+    router_.interface( 1 ).maybe_send_batch( frames_ );
+    for ( const auto& frame : frames_ ) {
+      ARPMessage request;
+      if ( frame.header.type == EthernetHeader::TYPE_ARP and parse( request, frame.payload )
+           and request.opcode == ARPMessage::OPCODE_REQUEST ) {
+        ARPMessage reply;
+        reply.opcode = ARPMessage::OPCODE_REPLY;
+        reply.sender_ethernet_address = NEXT_HOP_ETH;
+        reply.sender_ip_address = request.target_ip_address;
+        reply.target_ethernet_address = OUTSIDE_ETH;
+        reply.target_ip_address = request.sender_ip_address;
+        EthernetFrame answer;
+        answer.header = { OUTSIDE_ETH, NEXT_HOP_ETH, EthernetHeader::TYPE_ARP };
+        answer.payload = serialize( reply );
+        router_.interface( 1 ).recv_frame( answer );
+        continue;
+      }
+      transmitted_++;
+      transmitted_bytes_ += EthernetHeader::LENGTH;
+      for ( const auto& piece : frame.payload ) {
+        transmitted_bytes_ += piece.size();
+      }
+    }
+  }
+
+public:
+  Replay()
+  {
+    router_.add_interface( AsyncNetworkInterface { INSIDE_ETH, Address( "10.255.255.254", 0 ) } );
+    router_.add_interface( AsyncNetworkInterface { OUTSIDE_ETH, Address( "192.168.255.254", 0 ) } );
+    router_.add_route( 0, 0, {}, 1 ); // everything out of interface 1, to its destination directly
+  }
+
+  // Receive one captured frame on interface 0 (copied once into a pooled buffer, as a driver
+  // would; frames to unicast addresses are readdressed to the interface)
+  void receive( const PcapRecord& record )
+  {
+    if ( record.bytes.size() < EthernetHeader::LENGTH ) {
+      return;
+    }
+    string bytes = pool_.take();
+    bytes.assign( record.bytes );
+    if ( string_view { bytes }.substr( 0, 6 ) != "\xff\xff\xff\xff\xff\xff" ) {
+      copy( INSIDE_ETH.begin(), INSIDE_ETH.end(), bytes.begin() );
+    }
+
+    EthernetFrame frame;
+    if ( parse( frame, { Buffer { pool_.wrap( std::move( bytes ) ) } } ) ) {
+      router_.interface( 0 ).recv_frame( frame );
+      received_++;
+    }
+  }
+
+  // Route what has been received, and send it on
+  void route()
+  {
+    router_.route();
+    drain();
+  }
+
+  // Advance the router's clocks to `capture_ms` (a time in the capture)
+  void advance( const uint64_t capture_ms )
+  {
+    if ( last_ms_ == 0 or capture_ms < last_ms_ ) {
+      last_ms_ = capture_ms;
+      return;
+    }
+    const uint64_t elapsed = capture_ms - last_ms_;
+    if ( elapsed > 0 ) {
+      router_.interface( 0 ).tick( elapsed );
+      router_.interface( 1 ).tick( elapsed );
+      last_ms_ = capture_ms;
+    }
+  }
+
+  uint64_t received() const { return received_; }
+  uint64_t transmitted() const { return transmitted_; }
+  uint64_t transmitted_bytes() const { return transmitted_bytes_; }
+  Router& router() { return router_; }
+};
+
+} // namespace
+
+int main( int argc, char* argv[] )
+{
+  try {
+    const BenchmarkOptions options = BenchmarkOptions::parse( argc, argv );
+    BenchmarkSuite suite = options.suite();
+
+    const auto pcap = options.parameters.find( "pcap" );
+    if ( pcap == options.parameters.end() ) {
+      throw runtime_error( "usage: " + string { argv[0] }
+                           + " --pcap FILE [--speed S] [--loops N] [--burst B] [--json FILE]" );
+    }
+    const double speed = options.get( "speed", 0 );
+    const auto loops = static_cast<uint64_t>( options.get( "loops", 1 ) );
+    const auto burst = static_cast<size_t>( max( options.get( "burst", 256 ), 1.0 ) );
+
+    PcapReader reader { pcap->second };
+    if ( reader.link_type() != PcapWriter::LINKTYPE_ETHERNET ) {
+      throw runtime_error( pcap->second + ": not a capture of Ethernet frames" );
+    }
+
+    Replay replay;
+    uint64_t frames = 0;
+    uint64_t bytes = 0;
+    const auto start = steady_clock::now();
+    for ( uint64_t loop = 0; loop < loops; loop++ ) {
+      reader.rewind();
+      const auto loop_start = steady_clock::now();
+      optional<uint64_t> first_ns;
+      size_t queued = 0;
+      while ( const auto record = reader.next() ) {
+        first_ns = first_ns.value_or( record->timestamp_ns );
+        const uint64_t offset_ns = record->timestamp_ns - min( record->timestamp_ns, *first_ns );
+
+        // at the original pace (scaled): whatever is queued goes first, then wait for the frame's time
+        if ( speed > 0 ) {
+          const auto due = loop_start + nanoseconds( static_cast<int64_t>( static_cast<double>( offset_ns ) / speed ) );
+          if ( steady_clock::now() < due ) {
+            replay.route();
+            queued = 0;
+            this_thread::sleep_until( due );
+          }
+        }
+
+        replay.advance( record->timestamp_ns / 1'000'000 );
+        replay.receive( *record );
+        frames++;
+        bytes += record->bytes.size();
+        if ( ++queued == burst ) {
+          replay.route();
+          queued = 0;
+        }
+      }
+      replay.route();
+    }
+    const auto elapsed = steady_clock::now() - start;
+
+    const double seconds = duration<double>( elapsed ).count();
+    const Router::Stats stats = replay.router().stats();
+    suite.report( "replay/" + filesystem::path( pcap->second ).filename().string(),
+                  loops,
+                  max<uint64_t>( frames, 1 ),
+                  duration_cast<nanoseconds>( elapsed ),
+                  { { "frames", static_cast<double>( frames ) },
+                    { "received", static_cast<double>( replay.received() ) },
+                    { "forwarded", static_cast<double>( stats.forwarded ) },
+                    { "no_route", static_cast<double>( stats.no_route ) },
+                    { "ttl_expired", static_cast<double>( stats.ttl_expired ) },
+                    { "transmitted", static_cast<double>( replay.transmitted() ) },
+                    { "gbps_in", static_cast<double>( bytes ) * 8 / seconds / 1e9 },
+                    { "gbps_out", static_cast<double>( replay.transmitted_bytes() ) * 8 / seconds / 1e9 } } );
+
+    options.finish( suite );
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
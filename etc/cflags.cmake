@@ -3,6 +3,50 @@ set (CMAKE_EXPORT_COMPILE_COMMANDS ON)
 
 set(SANITIZING_FLAGS)
 
+# the instrumented variant (the *_instrumented libraries): optimized, with frame pointers and
+# symbols for perf, the allocation tracker and the profiling markers (see util/alloc_tracker.hh
+# and util/profile_markers.hh)
+set(INSTRUMENTING_FLAGS -O2 -g -fno-omit-frame-pointer)
+set(INSTRUMENTING_DEFINITIONS ALLOCATION_TRACKING PROFILING_MARKERS)
+
+# the release variant (the *_release libraries): optimized, with link-time optimization across
+# util and src, and optionally trained on a profile (PGO=generate to instrument it, PGO=use to
+# rebuild it from the profiles; see etc/pgo.cmake, run by the `pgo` target). The *_native
+# libraries are the same for -march=native, which also turns on the AVX2 checksum and
+# neighbor-lookup kernels.
+include(CheckIPOSupported)
+check_ipo_supported(RESULT IPO_SUPPORTED OUTPUT IPO_OUTPUT LANGUAGES CXX)
+if (NOT IPO_SUPPORTED)
+  message (STATUS "No release targets: link-time optimization is not supported (${IPO_OUTPUT})")
+endif ()
+set(RELEASE_FLAGS -O2)
+set(NATIVE_FLAGS -O2 -march=native)
+# (GCC 12 reports a false stringop-overflow in std::string's small-string copy once LTO has
+# inlined it across files; the warning is only turned off for the link-time code generation)
+set(LTO_LINK_FLAGS -Wno-stringop-overflow)
+
+set (PGO "" CACHE STRING "Profile-guided optimization of the release variant: empty, generate or use")
+set(PGO_FLAGS)
+if (PGO STREQUAL "generate")
+  set(PGO_FLAGS -fprofile-generate -fprofile-update=atomic)
+elseif (PGO STREQUAL "use")
+  set(PGO_FLAGS -fprofile-use -fprofile-correction -Wno-missing-profile)
+elseif (NOT PGO STREQUAL "")
+  message (FATAL_ERROR "PGO must be empty, generate or use")
+endif ()
+
 # ask for more warnings from the compiler
 set (CMAKE_BASE_CXX_FLAGS "${CMAKE_CXX_FLAGS}")
 set (CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS} -Wall -Wpedantic -Wextra -Weffc++ -Werror -Wshadow -Wpointer-arith -Wcast-qual -Wformat=2 -Wno-unqualified-std-cast-call")
+
+# compile out log records below this level (0: TRACE ... 5: OFF; see util/log.hh)
+set (LOG_MIN_LEVEL "" CACHE STRING "Minimum log level compiled in (0-5, empty for the default)")
+if (NOT LOG_MIN_LEVEL STREQUAL "")
+  add_compile_definitions (LOG_MIN_LEVEL=${LOG_MIN_LEVEL})
+endif ()
+
+# latency histograms around route(), send_datagram() and recv_frame() (see util/latency.hh)
+option (LATENCY_HISTOGRAMS "Compile in the hot-path latency histograms" OFF)
+if (LATENCY_HISTOGRAMS)
+  add_compile_definitions (LATENCY_HISTOGRAMS)
+endif ()
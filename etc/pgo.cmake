@@ -0,0 +1,86 @@
+# Profile-guided optimization pipeline, run by the `pgo` target (see benchmarks/CMakeLists.txt):
+#
+#   cmake -P etc/pgo.cmake -DSOURCE_DIR=... -DBINARY_DIR=... -DBASELINE=... -DRELEASE=... [-DNATIVE=...]
+#
+# 1. configures a build of its own in BINARY_DIR with PGO=generate, and builds the release
+#    forwarding benchmark there with the profiling instrumentation;
+# 2. trains it on the synthetic forwarding workload (with one worker and with several, so that
+#    both route() and route_parallel() are profiled);
+# 3. reconfigures the same build with PGO=use and rebuilds the benchmark from the profiles (the
+#    objects keep their paths, so each finds its own profile);
+# 4. runs the baseline (-O2), the release build (LTO), the native build if one is given (LTO and
+#    -march=native) and the PGO build on the same workload, and reports each one's speedup over
+#    the baseline. The JSON reports are left in BINARY_DIR.
+
+foreach (variable SOURCE_DIR BINARY_DIR BASELINE RELEASE)
+  if (NOT DEFINED ${variable})
+    message (FATAL_ERROR "pgo.cmake needs -D${variable}=...")
+  endif ()
+endforeach ()
+
+set (TRAINING_WORKLOADS "--packets 1000000 --workers 1" "--packets 1000000 --workers 2")
+set (MEASURED_WORKLOAD --packets 2000000)
+
+function (run)
+  execute_process (COMMAND ${ARGN} COMMAND_ECHO STDOUT RESULT_VARIABLE result)
+  if (NOT result EQUAL 0)
+    message (FATAL_ERROR "pgo.cmake: command failed (${result})")
+  endif ()
+endfunction ()
+
+# 1. The instrumented build
+run ("${CMAKE_COMMAND}" -S "${SOURCE_DIR}" -B "${BINARY_DIR}" -DCMAKE_BUILD_TYPE=Release -DPGO=generate)
+file (GLOB_RECURSE stale_profiles "${BINARY_DIR}/*.gcda")
+if (stale_profiles)
+  file (REMOVE ${stale_profiles})
+endif ()
+run ("${CMAKE_COMMAND}" --build "${BINARY_DIR}" -t benchmark_forwarding_release)
+
+# 2. Training
+foreach (workload IN LISTS TRAINING_WORKLOADS)
+  separate_arguments (arguments UNIX_COMMAND "${workload}")
+  run ("${BINARY_DIR}/benchmarks/benchmark_forwarding_release" ${arguments})
+endforeach ()
+
+# 3. The optimized build
+run ("${CMAKE_COMMAND}" -S "${SOURCE_DIR}" -B "${BINARY_DIR}" -DPGO=use)
+run ("${CMAKE_COMMAND}" --build "${BINARY_DIR}" -t benchmark_forwarding_release)
+
+# 4. Measurements
+set (variants baseline "${BASELINE}" lto "${RELEASE}")
+if (DEFINED NATIVE)
+  list (APPEND variants native "${NATIVE}")
+endif ()
+list (APPEND variants lto_pgo "${BINARY_DIR}/benchmarks/benchmark_forwarding_release")
+
+set (report "")
+list (LENGTH variants length)
+math (EXPR last "${length} - 1")
+foreach (i RANGE 0 ${last} 2)
+  math (EXPR j "${i} + 1")
+  list (GET variants ${i} name)
+  list (GET variants ${j} executable)
+  set (json "${BINARY_DIR}/benchmarks_forwarding_${name}.json")
+  run ("${executable}" ${MEASURED_WORKLOAD} --json "${json}")
+  file (READ "${json}" contents)
+  string (JSON ns GET "${contents}" benchmarks 0 ns_per_item)
+  if (name STREQUAL "baseline")
+    set (baseline_ns ${ns})
+  endif ()
+  # (CMake's math is integer only: the speedup in thousandths)
+  string (REGEX REPLACE "\\..*" "" ns_whole "${ns}")
+  string (REGEX REPLACE "\\..*" "" baseline_whole "${baseline_ns}")
+  if (ns_whole EQUAL 0)
+    set (ns_whole 1)
+  endif ()
+  math (EXPR permille "${baseline_whole} * 1000 / ${ns_whole}")
+  math (EXPR whole "${permille} / 1000")
+  math (EXPR fraction "${permille} % 1000")
+  math (EXPR fraction "${fraction} + 1000")
+  string (SUBSTRING "${fraction}" 1 3 fraction)
+  string (REGEX REPLACE "(\\.[0-9][0-9]?[0-9]?).*" "\\1" ns "${ns}")
+  string (APPEND report "  ${name}: ${ns} ns/packet, ${whole}.${fraction}x the baseline\n")
+endforeach ()
+
+list (JOIN MEASURED_WORKLOAD " " workload)
+message (STATUS "Forwarding benchmark (${workload}):\n${report}")
@@ -24,6 +24,23 @@ ttest(net_interface_test_large_1)
 ttest(net_interface_test_large_2)
 ttest(net_interface_test_large_3)
 ttest(net_interface_test_large_4)
+ttest(net_interface_test_address_map)
+ttest(net_interface_test_neighbor_store)
+ttest(net_interface_test_zero_copy)
+ttest(net_interface_test_parse)
+ttest(net_interface_test_adjacency)
+ttest(net_interface_test_limits)
+ttest(net_interface_test_socket_batch)
+ttest(net_interface_test_packet_ring)
+ttest(net_interface_test_xdp)
+ttest(net_interface_test_event_loop)
+ttest(net_interface_test_coroutines)
+ttest(net_interface_test_fragmentation)
+ttest(net_interface_test_refresh)
+ttest(net_interface_test_egress)
+ttest(net_interface_test_shaping)
+ttest(net_interface_test_neighbors)
+ttest(net_interface_test_pcap)
 
 ttest(net_interface_test_hidden_1)
 ttest(net_interface_test_hidden_2)
@@ -44,6 +61,27 @@ ttest(router_noroute)
 ttest(router_same_dest)
 ttest(router_test_lpm)
 ttest(router_route_many)
+ttest(router_test_trie)
+ttest(router_test_checksum)
+ttest(router_test_parallel)
+ttest(router_test_rings)
+ttest(router_test_rcu)
+ttest(router_test_log)
+ttest(router_test_counters)
+ttest(router_test_latency)
+ttest(router_test_load)
+ttest(router_test_snapshot)
+ttest(router_test_ecmp)
+ttest(router_test_acl)
+ttest(router_test_forwarding)
+ttest(router_test_route_update)
+ttest(router_test_flows)
+ttest(router_test_sampling)
+ttest(router_test_huge_pages)
+ttest(router_test_affinity)
+ttest(router_test_ipv6)
+ttest(router_test_pipeline)
+ttest(router_test_fabric)
 
 add_custom_target (pa1 COMMAND ${CMAKE_CTEST_COMMAND} --output-on-failure --continue-on-failure --timeout 180 -R '^net_interface')
 
@@ -0,0 +1,112 @@
+#include "acl.hh"
+
+#include <algorithm>
+#include <bit>
+
+using namespace std;
+
+namespace {
+
+uint32_t prefix_mask( const uint8_t length )
+{
+  return length == 0 ? 0 : ~uint32_t { 0 } << ( 32 - min<uint8_t>( length, 32 ) );
+}
+
+} // namespace
+
+bool AclRule::matches( const IPv4Header& header ) const
+{
+  return ( ( header.src ^ src_prefix ) & prefix_mask( src_length ) ) == 0
+         and ( ( header.dst ^ dst_prefix ) & prefix_mask( dst_length ) ) == 0
+         and ( not proto.has_value() or header.proto == *proto ) and ( header.tos & tos_mask ) == tos;
+}
+
+AclClassifier::AclClassifier( span<const AclRule> rules, const AclRule::Action default_action )
+  : rules_( rules.begin(), rules.end() ), default_action_( default_action ), words_( ( rules.size() + 63 ) / 64 )
+{
+  src_ = compileField( &AclRule::src_prefix, &AclRule::src_length );
+  dst_ = compileField( &AclRule::dst_prefix, &AclRule::dst_length );
+
+  proto_bitmaps_.assign( 256 * words_, 0 );
+  tos_bitmaps_.assign( 256 * words_, 0 );
+  for ( size_t r = 0; r < rules_.size(); r++ ) {
+    const AclRule& rule = rules_[r];
+    for ( size_t value = 0; value < 256; value++ ) {
+      if ( not rule.proto.has_value() or *rule.proto == value ) {
+        setBit( proto_bitmaps_, value, r );
+      }
+      if ( ( value & rule.tos_mask ) == rule.tos ) {
+        setBit( tos_bitmaps_, value, r );
+      }
+    }
+  }
+}
+
+AclClassifier::AddressField AclClassifier::compileField( uint32_t AclRule::* prefix, uint8_t AclRule::* length ) const
+{
+  // Every rule's range is [first, last]; the intervals start at 0 and at every first and last + 1
+  AddressField field;
+  field.starts.push_back( 0 );
+  for ( const AclRule& rule : rules_ ) {
+    const uint32_t mask = prefix_mask( rule.*length );
+    const uint32_t first = rule.*prefix & mask;
+    const uint32_t last = first | ~mask;
+    field.starts.push_back( first );
+    if ( last != UINT32_MAX ) {
+      field.starts.push_back( last + 1 );
+    }
+  }
+  ranges::sort( field.starts );
+  field.starts.erase( ranges::unique( field.starts ).begin(), field.starts.end() );
+
+  // ... and each interval's bitmap has the rules whose range covers it
+  field.bitmaps.assign( field.starts.size() * words_, 0 );
+  for ( size_t r = 0; r < rules_.size(); r++ ) {
+    const uint32_t mask = prefix_mask( rules_[r].*length );
+    const uint32_t first = rules_[r].*prefix & mask;
+    const uint32_t last = first | ~mask;
+    const auto begin = ranges::lower_bound( field.starts, first ) - field.starts.begin();
+    const auto end = last == UINT32_MAX ? field.starts.end() - field.starts.begin()
+                                        : ranges::lower_bound( field.starts, last + 1 ) - field.starts.begin();
+    for ( auto row = begin; row < end; row++ ) {
+      setBit( field.bitmaps, static_cast<size_t>( row ), r );
+    }
+  }
+  return field;
+}
+
+const uint64_t* AclClassifier::fieldBitmap( const AddressField& field, const uint32_t value ) const
+{
+  // The last interval starting at or before the value (the first always starts at 0)
+  const auto row = ranges::upper_bound( field.starts, value ) - field.starts.begin() - 1;
+  return &field.bitmaps[static_cast<size_t>( row ) * words_];
+}
+
+size_t AclClassifier::match( const IPv4Header& header ) const
+{
+  if ( rules_.empty() ) {
+    return NO_MATCH;
+  }
+
+  const uint64_t* src = fieldBitmap( src_, header.src );
+  const uint64_t* dst = fieldBitmap( dst_, header.dst );
+  const uint64_t* proto = &proto_bitmaps_[header.proto * words_];
+  const uint64_t* tos = &tos_bitmaps_[header.tos * words_];
+  for ( size_t w = 0; w < words_; w++ ) {
+    const uint64_t both = src[w] & dst[w] & proto[w] & tos[w];
+    if ( both != 0 ) {
+      return w * 64 + static_cast<size_t>( countr_zero( both ) );
+    }
+  }
+  return NO_MATCH;
+}
+
+size_t AclClassifier::match_linear( const IPv4Header& header ) const
+{
+  for ( size_t r = 0; r < rules_.size(); r++ ) {
+    if ( rules_[r].matches( header ) ) {
+      return r;
+    }
+  }
+  return NO_MATCH;
+}
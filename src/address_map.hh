@@ -0,0 +1,153 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// An open-addressing hash map keyed by a raw 32-bit IPv4 address.
+//
+// Slots are stored inline in one flat vector (no per-entry allocation, no
+// pointer chasing), probed linearly from a multiplicative hash of the key.
+// Deletion uses backward shifting, so there are no tombstones and probe
+// sequences stay short. The table doubles whenever it becomes half full.
+//
+// Pointers and references returned by find() or insert() are invalidated by
+// any later insert() or erase().
+template<typename T>
+class AddressMap
+{
+  struct Slot
+  {
+    uint32_t key {};
+    bool used {};
+    T value {};
+  };
+
+  std::vector<Slot> slots_ {};
+  size_t size_ {};
+  uint8_t bits_ {};
+
+  size_t home( const uint32_t key ) const
+  {
+    // Fibonacci hashing: the high bits of the product are well mixed
+    return static_cast<size_t>( ( key * 0x9E37'79B9U ) >> ( 32 - bits_ ) );
+  }
+
+  size_t mask() const { return slots_.size() - 1; }
+
+  size_t find_slot( const uint32_t key ) const
+  {
+    if ( slots_.empty() ) {
+      return SIZE_MAX;
+    }
+    for ( size_t i = home( key );; i = ( i + 1 ) & mask() ) {
+      if ( not slots_[i].used ) {
+        return SIZE_MAX;
+      }
+      if ( slots_[i].key == key ) {
+        return i;
+      }
+    }
+  }
+
+  void grow()
+  {
+    std::vector<Slot> old = std::move( slots_ );
+    bits_ = bits_ ? static_cast<uint8_t>( bits_ + 1 ) : 4;
+    slots_ = std::vector<Slot>( size_t { 1 } << bits_ );
+    size_ = 0;
+    for ( auto& slot : old ) {
+      if ( slot.used ) {
+        insert( slot.key ).first = std::move( slot.value );
+      }
+    }
+  }
+
+public:
+  // Returns the value stored for `key`, or nullptr
+  T* find( const uint32_t key )
+  {
+    const size_t i = find_slot( key );
+    return i == SIZE_MAX ? nullptr : &slots_[i].value;
+  }
+
+  const T* find( const uint32_t key ) const
+  {
+    const size_t i = find_slot( key );
+    return i == SIZE_MAX ? nullptr : &slots_[i].value;
+  }
+
+  // Returns the value stored for `key` (default-constructing it if absent),
+  // and whether it was newly inserted
+  std::pair<T&, bool> insert( const uint32_t key )
+  {
+    if ( ( size_ + 1 ) * 2 > slots_.size() ) {
+      grow();
+    }
+    size_t i = home( key );
+    for ( ; slots_[i].used; i = ( i + 1 ) & mask() ) {
+      if ( slots_[i].key == key ) {
+        return { slots_[i].value, false };
+      }
+    }
+    slots_[i].key = key;
+    slots_[i].used = true;
+    size_++;
+    return { slots_[i].value, true };
+  }
+
+  // Removes `key`. Returns false if it was not present.
+  bool erase( const uint32_t key )
+  {
+    size_t hole = find_slot( key );
+    if ( hole == SIZE_MAX ) {
+      return false;
+    }
+
+    // Shift later members of the probe run back into the hole
+    for ( size_t i = ( hole + 1 ) & mask(); slots_[i].used; i = ( i + 1 ) & mask() ) {
+      const size_t distance_from_home = ( i - home( slots_[i].key ) ) & mask();
+      const size_t distance_to_hole = ( i - hole ) & mask();
+      if ( distance_from_home >= distance_to_hole ) {
+        slots_[hole] = std::move( slots_[i] );
+        hole = i;
+      }
+    }
+
+    slots_[hole] = Slot {};
+    size_--;
+    return true;
+  }
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  void clear()
+  {
+    slots_.clear();
+    size_ = 0;
+    bits_ = 0;
+  }
+
+  // Calls f( key, value ) for every entry, in no particular order
+  template<typename F>
+  void for_each( F&& f )
+  {
+    for ( auto& slot : slots_ ) {
+      if ( slot.used ) {
+        f( slot.key, slot.value );
+      }
+    }
+  }
+
+  template<typename F>
+  void for_each( F&& f ) const
+  {
+    for ( const auto& slot : slots_ ) {
+      if ( slot.used ) {
+        f( slot.key, slot.value );
+      }
+    }
+  }
+};
@@ -0,0 +1,93 @@
+#include "co_interface.hh"
+
+#include <utility>
+
+using namespace std;
+
+CoInterface::CoInterface( AsyncNetworkInterface& interface, EventLoop& loop )
+  : CoInterface( interface, loop, DEFAULT_ARP_TIMEOUT )
+{}
+
+CoInterface::CoInterface( AsyncNetworkInterface& interface,
+                          EventLoop& loop,
+                          const chrono::milliseconds arp_timeout )
+  : interface_( interface ), loop_( loop ), arp_timeout_ms_( arp_timeout.count() )
+{
+  loop_.add_round_hook( [this] { poll(); } );
+}
+
+bool CoInterface::ReceiveAwaiter::await_ready()
+{
+  // (a datagram goes to the oldest waiter first)
+  if ( owner_.receivers_.empty() ) {
+    datagram_ = owner_.interface_.maybe_receive();
+  }
+  return datagram_.has_value();
+}
+
+void CoInterface::ReceiveAwaiter::await_suspend( const coroutine_handle<> waiter )
+{
+  waiter_ = waiter;
+  owner_.receivers_.push_back( this );
+}
+
+bool CoInterface::SendAwaiter::await_ready()
+{
+  if ( owner_.interface_.resolve( next_hop_ ) ) {
+    owner_.interface_.send_datagram( std::move( datagram_ ), next_hop_ );
+    sent_ = true;
+  }
+  return sent_;
+}
+
+void CoInterface::SendAwaiter::await_suspend( const coroutine_handle<> waiter )
+{
+  waiter_ = waiter;
+  deadline_ = owner_.loop_.ticked_ms() + owner_.arp_timeout_ms_;
+  owner_.senders_[next_hop_].push_back( this );
+  owner_.waiting_senders_++;
+}
+
+void CoInterface::poll()
+{
+  // Decide who runs first, and resume them afterwards: a resumed coroutine may wait again
+  vector<coroutine_handle<>> runnable = std::move( runnable_ );
+  runnable.clear();
+
+  while ( not receivers_.empty() ) {
+    auto datagram = interface_.maybe_receive();
+    if ( not datagram.has_value() ) {
+      break;
+    }
+    ReceiveAwaiter* receiver = receivers_.front();
+    receivers_.pop_front();
+    receiver->datagram_ = std::move( datagram );
+    runnable.push_back( receiver->waiter_ );
+  }
+
+  const uint64_t now = loop_.ticked_ms();
+  for ( auto it = senders_.begin(); it != senders_.end(); ) {
+    // (also asks again once an unanswered request's ARP entry has expired)
+    const bool resolved = interface_.resolve( it->first );
+    auto& waiting = it->second;
+    size_t kept = 0;
+    for ( SendAwaiter* sender : waiting ) {
+      if ( resolved ) {
+        interface_.send_datagram( std::move( sender->datagram_ ), sender->next_hop_ );
+        sender->sent_ = true;
+      } else if ( sender->deadline_ > now ) {
+        waiting[kept++] = sender;
+        continue;
+      }
+      runnable.push_back( sender->waiter_ );
+    }
+    waiting_senders_ -= waiting.size() - kept;
+    waiting.resize( kept );
+    it = waiting.empty() ? senders_.erase( it ) : next( it );
+  }
+
+  for ( const auto waiter : runnable ) {
+    waiter.resume();
+  }
+  runnable_ = std::move( runnable );
+}
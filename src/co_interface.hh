@@ -0,0 +1,119 @@
+#pragma once
+
+#include "event_loop.hh"
+#include "router.hh"
+
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+// A coroutine view of an AsyncNetworkInterface that an EventLoop drives:
+//
+//   Task echo( CoInterface& iface ) {
+//     while ( true ) {
+//       InternetDatagram dgram = co_await iface.receive();
+//       ...
+//       co_await iface.send( std::move( dgram ), next_hop );
+//     }
+//   }
+//   loop.spawn( echo( iface ) );
+//
+// receive() suspends until a datagram arrives. send() to a next hop whose Ethernet address is
+// known sends at once without suspending; otherwise it sends an ARP request and suspends until
+// the address is learned (then sends, and resumes with true) or until the ARP timeout passes
+// (resumes with false, having sent nothing). So a datagram waiting for ARP stays with the
+// coroutine that sent it, instead of in the interface's pending queues, and the sender knows
+// whether it went out.
+//
+// Waiters are resumed from a round hook of the loop, after it has received and ticked, and
+// the ARP timeout is measured in the loop's ticks. Waiting sends are grouped by next hop, so
+// a round costs one ARP table lookup per next hop still being resolved, however many
+// coroutines wait on it.
+//
+// The CoInterface must outlive the loop, and an awaiting coroutine must not be destroyed
+// while it waits (tasks owned by the loop are not).
+class CoInterface
+{
+public:
+  static constexpr std::chrono::milliseconds DEFAULT_ARP_TIMEOUT { 5000 };
+
+  // Waits for the next datagram the interface receives
+  class ReceiveAwaiter
+  {
+  public:
+    explicit ReceiveAwaiter( CoInterface& owner ) : owner_( owner ) {}
+
+    bool await_ready();
+    void await_suspend( std::coroutine_handle<> waiter );
+    InternetDatagram await_resume() { return std::move( *datagram_ ); }
+
+  private:
+    friend class CoInterface;
+
+    CoInterface& owner_;
+    std::optional<InternetDatagram> datagram_ {};
+    std::coroutine_handle<> waiter_ {};
+  };
+
+  // Sends a datagram once its next hop is resolved; resumes with whether it was sent
+  class SendAwaiter
+  {
+  public:
+    SendAwaiter( CoInterface& owner, InternetDatagram&& datagram, uint32_t next_hop )
+      : owner_( owner ), datagram_( std::move( datagram ) ), next_hop_( next_hop )
+    {}
+
+    bool await_ready();
+    void await_suspend( std::coroutine_handle<> waiter );
+    bool await_resume() const { return sent_; }
+
+  private:
+    friend class CoInterface;
+
+    CoInterface& owner_;
+    InternetDatagram datagram_;
+    uint32_t next_hop_;
+    uint64_t deadline_ {}; // in the loop's ticked_ms()
+    bool sent_ {};
+    std::coroutine_handle<> waiter_ {};
+  };
+
+  CoInterface( AsyncNetworkInterface& interface, EventLoop& loop );
+  CoInterface( AsyncNetworkInterface& interface, EventLoop& loop, std::chrono::milliseconds arp_timeout );
+
+  CoInterface( const CoInterface& other ) = delete;
+  CoInterface& operator=( const CoInterface& other ) = delete;
+  CoInterface( CoInterface&& other ) = delete;
+  CoInterface& operator=( CoInterface&& other ) = delete;
+  ~CoInterface() = default;
+
+  ReceiveAwaiter receive() { return ReceiveAwaiter { *this }; }
+  SendAwaiter send( InternetDatagram datagram, uint32_t next_hop )
+  {
+    return SendAwaiter { *this, std::move( datagram ), next_hop };
+  }
+
+  AsyncNetworkInterface& interface() { return interface_; }
+
+  // Coroutines waiting in receive(), and in send()
+  size_t waiting_receivers() const { return receivers_.size(); }
+  size_t waiting_senders() const { return waiting_senders_; }
+
+private:
+  AsyncNetworkInterface& interface_;
+  EventLoop& loop_;
+  uint64_t arp_timeout_ms_;
+
+  std::deque<ReceiveAwaiter*> receivers_ {};                            // oldest first
+  std::unordered_map<uint32_t, std::vector<SendAwaiter*>> senders_ {}; // by next hop, oldest first
+  size_t waiting_senders_ {};
+  std::vector<std::coroutine_handle<>> runnable_ {};
+
+  // Hand out received datagrams, and finish sends that are resolved or timed out (run by the loop)
+  void poll();
+};
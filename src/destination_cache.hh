@@ -0,0 +1,69 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// A direct-mapped cache of route lookups, keyed by destination address.
+//
+// Each entry remembers the route found for one destination together with the generation of
+// the FIB it was found in; an entry only hits if its generation is still the current one, so
+// bumping the FIB's generation on every change invalidates the whole cache at once. Misses
+// (including "no route") are simply looked up again and overwrite whatever was in the slot.
+class DestinationCache
+{
+public:
+  static constexpr size_t DEFAULT_SIZE = 1024; // entries (rounded up to a power of two)
+
+  struct Stats
+  {
+    uint64_t hits;
+    uint64_t misses;
+  };
+
+private:
+  struct Entry
+  {
+    uint32_t destination {};
+    uint32_t route {};
+    uint64_t generation {}; // 0: never filled (FIB generations start at 1)
+  };
+
+  std::vector<Entry> entries_;
+  uint8_t bits_;
+  Stats stats_ {};
+
+  Entry& slot( const uint32_t destination )
+  {
+    // Fibonacci hashing: the high bits of the product are well mixed
+    return entries_[static_cast<size_t>( ( destination * 0x9E37'79B9U ) >> ( 32 - bits_ ) )];
+  }
+
+public:
+  explicit DestinationCache( const size_t size = DEFAULT_SIZE )
+    : entries_( std::bit_ceil( std::max<size_t>( size, 2 ) ) )
+    , bits_( static_cast<uint8_t>( std::countr_zero( entries_.size() ) ) )
+  {}
+
+  // If `destination` was looked up in this generation of the FIB, set `route` and return true
+  bool find( const uint32_t destination, const uint64_t generation, uint32_t& route )
+  {
+    const Entry& entry = slot( destination );
+    if ( entry.generation == generation and entry.destination == destination ) {
+      stats_.hits++;
+      route = entry.route;
+      return true;
+    }
+    stats_.misses++;
+    return false;
+  }
+
+  void store( const uint32_t destination, const uint64_t generation, const uint32_t route )
+  {
+    slot( destination ) = { destination, route, generation };
+  }
+
+  const Stats& stats() const { return stats_; }
+};
@@ -0,0 +1,156 @@
+#include "egress_scheduler.hh"
+
+#include <algorithm>
+
+using namespace std;
+
+EgressScheduler::EgressScheduler( const Config& config ) : config_( config ) {}
+
+size_t EgressScheduler::configure( const Config& config )
+{
+  vector<EthernetFrame> waiting;
+  pop_batch( waiting );
+
+  config_ = config;
+  active_head_ = 0;
+  active_count_ = 0;
+  turn_started_ = false;
+  deficit_ = {};
+
+  size_t dropped = 0;
+  for ( EthernetFrame& frame : waiting ) {
+    dropped += push( std::move( frame ) ) ? 0 : 1;
+  }
+  return dropped;
+}
+
+size_t EgressScheduler::classify( const EthernetFrame& frame )
+{
+  if ( frame.header.type == EthernetHeader::TYPE_ARP ) {
+    return ARP_CLASS;
+  }
+  // The type of service is the second byte of the IPv4 header (which a serialized datagram
+  // keeps together in its first buffer); its top two bits pick the class
+  if ( frame.header.type != EthernetHeader::TYPE_IPv4 or frame.payload.empty()
+       or frame.payload.front().size() < 2 ) {
+    return BEST_EFFORT_CLASS;
+  }
+  const auto tos = static_cast<uint8_t>( string_view { frame.payload.front() }[1] );
+  return BEST_EFFORT_CLASS - ( tos >> 6 );
+}
+
+bool EgressScheduler::push( EthernetFrame&& frame )
+{
+  const size_t size = frameSize( frame );
+  const size_t cls = classify( frame );
+  if ( queued_frames_[cls] + 1 > config_.max_frames[cls] or queued_bytes_[cls] + size > config_.max_bytes[cls] ) {
+    return false;
+  }
+  queued_frames_[cls]++;
+  queued_bytes_[cls] += size;
+  frames_++;
+
+  if ( config_.policy == Policy::FIFO ) {
+    queues_.front().push_back( { std::move( frame ), size, cls } );
+    return true;
+  }
+  if ( config_.policy == Policy::DRR and cls != ARP_CLASS and queues_[cls].empty() ) {
+    activate( cls );
+  }
+  queues_[cls].push_back( { std::move( frame ), size, cls } );
+  return true;
+}
+
+optional<EthernetFrame> EgressScheduler::pop()
+{
+  if ( empty() ) {
+    return {};
+  }
+
+  deque<Entry>& queue = nextQueue();
+  Entry entry = std::move( queue.front() );
+  queue.pop_front();
+  queued_frames_[entry.cls]--;
+  queued_bytes_[entry.cls] -= entry.size;
+  frames_--;
+
+  // DRR: charging the class for the frame, and ending its turn (and its place in the round)
+  // once it has nothing left to send
+  if ( config_.policy == Policy::DRR and entry.cls != ARP_CLASS ) {
+    deficit_[entry.cls] -= entry.size;
+    if ( queue.empty() ) {
+      deficit_[entry.cls] = 0;
+      active_head_ = ( active_head_ + 1 ) % CLASSES;
+      active_count_--;
+      turn_started_ = false;
+    }
+  }
+  return std::move( entry.frame );
+}
+
+size_t EgressScheduler::next_size()
+{
+  return empty() ? 0 : nextQueue().front().size;
+}
+
+size_t EgressScheduler::pop_batch( vector<EthernetFrame>& out, const size_t max_frames )
+{
+  const size_t count = min( max_frames, frames_ );
+  out.reserve( out.size() + count );
+  for ( size_t i = 0; i < count; i++ ) {
+    out.push_back( std::move( *pop() ) );
+  }
+  return count;
+}
+
+deque<EgressScheduler::Entry>& EgressScheduler::nextQueue()
+{
+  if ( config_.policy == Policy::FIFO ) {
+    return queues_.front();
+  }
+  if ( not queues_[ARP_CLASS].empty() ) {
+    return queues_[ARP_CLASS];
+  }
+
+  if ( config_.policy == Policy::PRIORITY ) {
+    return *ranges::find_if( queues_, []( const deque<Entry>& queue ) { return not queue.empty(); } );
+  }
+
+  // DRR: the first class in the round, once its deficit covers its next frame
+  while ( true ) {
+    const size_t cls = active_[active_head_];
+    if ( not turn_started_ ) {
+      deficit_[cls] += max<size_t>( config_.quantum[cls], 1 );
+      turn_started_ = true;
+    }
+    if ( queues_[cls].front().size <= deficit_[cls] ) {
+      return queues_[cls];
+    }
+    rotate();
+  }
+}
+
+void EgressScheduler::activate( const size_t cls )
+{
+  active_[( active_head_ + active_count_ ) % CLASSES] = cls;
+  active_count_++;
+  deficit_[cls] = 0;
+}
+
+// End the first class's turn, moving it to the end of the round (keeping its deficit)
+void EgressScheduler::rotate()
+{
+  const size_t cls = active_[active_head_];
+  active_head_ = ( active_head_ + 1 ) % CLASSES;
+  active_[( active_head_ + active_count_ - 1 ) % CLASSES] = cls;
+  turn_started_ = false;
+}
+
+size_t EgressScheduler::frameSize( const EthernetFrame& frame )
+{
+  size_t size = EthernetHeader::LENGTH;
+  for ( const Buffer& piece : frame.payload ) {
+    size += piece.size();
+  }
+  return size;
+}
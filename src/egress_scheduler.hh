@@ -0,0 +1,116 @@
+#pragma once
+
+#include "ethernet_frame.hh"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <vector>
+
+// The queue of frames an interface has ready to send, and the order they leave in.
+//
+// Frames are sorted into classes: ARP first, then four classes of IPv4 by the top two bits of
+// the DSCP (in IPv4Header::tos): network control (CS6, CS7); CS4, AF4x, CS5 and EF; CS2, AF2x,
+// CS3 and AF3x; and best effort, CS1 and AF1x. Each class has its own limits, and the policy
+// picks the class to send from next:
+//
+//   FIFO      the order the frames were queued in, whatever their class (the default)
+//   PRIORITY  always the most important class with a frame waiting (so ARP goes first)
+//   DRR       ARP first, then deficit round robin over the IPv4 classes, each of which may send
+//             its quantum of bytes per round
+//
+// Queueing and dequeueing a frame are O(1) under every policy (under DRR, as long as every
+// quantum is at least a full frame, so that each turn of a class sends something).
+class EgressScheduler
+{
+public:
+  enum class Policy
+  {
+    FIFO,
+    PRIORITY,
+    DRR,
+  };
+
+  // Classes by importance (0: most)
+  static constexpr size_t CLASSES = 5;
+  static constexpr size_t ARP_CLASS = 0;
+  static constexpr size_t BEST_EFFORT_CLASS = CLASSES - 1;
+
+  // A full-size Ethernet frame (the default DRR quanta are multiples of it)
+  static constexpr size_t FULL_FRAME = 1514;
+
+  struct Config
+  {
+    Policy policy = Policy::FIFO;
+    // Per class: the most frames and bytes waiting at once (a frame over either is dropped)
+    std::array<size_t, CLASSES> max_frames { SIZE_MAX, SIZE_MAX, SIZE_MAX, SIZE_MAX, SIZE_MAX };
+    std::array<size_t, CLASSES> max_bytes { SIZE_MAX, SIZE_MAX, SIZE_MAX, SIZE_MAX, SIZE_MAX };
+    // DRR: bytes each IPv4 class may send per round (ARP, always first, has none)
+    std::array<size_t, CLASSES> quantum { 0, 8 * FULL_FRAME, 4 * FULL_FRAME, 2 * FULL_FRAME, FULL_FRAME };
+  };
+
+  EgressScheduler() : EgressScheduler( Config {} ) {}
+  explicit EgressScheduler( const Config& config );
+
+  // Change the policy or limits; frames already waiting are queued again under the new ones
+  // (in the order they would have left), so some may be dropped. Returns the number dropped.
+  size_t configure( const Config& config );
+  const Config& config() const { return config_; }
+
+  // The class a frame falls in
+  static size_t classify( const EthernetFrame& frame );
+
+  // Queue a frame, unless its class is full (then it is dropped and false returned)
+  bool push( EthernetFrame&& frame );
+
+  // The next frame to send, if any
+  std::optional<EthernetFrame> pop();
+
+  // The size (Ethernet header included) of the frame pop() would return, or 0 if there is none
+  size_t next_size();
+
+  // Move up to `max_frames` frames to the end of `out`, in the order they are to leave.
+  // Returns the number moved.
+  size_t pop_batch( std::vector<EthernetFrame>& out, size_t max_frames = SIZE_MAX );
+
+  size_t size() const { return frames_; }
+  bool empty() const { return frames_ == 0; }
+
+  // Frames and bytes of a class waiting
+  size_t queued_frames( size_t cls ) const { return queued_frames_.at( cls ); }
+  size_t queued_bytes( size_t cls ) const { return queued_bytes_.at( cls ); }
+
+private:
+  struct Entry
+  {
+    EthernetFrame frame {};
+    size_t size {};
+    size_t cls {};
+  };
+
+  Config config_;
+
+  // One queue per class (under FIFO, every frame waits in the first)
+  std::array<std::deque<Entry>, CLASSES> queues_ {};
+  std::array<size_t, CLASSES> queued_frames_ {};
+  std::array<size_t, CLASSES> queued_bytes_ {};
+  size_t frames_ {};
+
+  // DRR: the IPv4 classes with frames waiting, in round order (a ring holding active_count_
+  // classes from active_head_), whether the first has started its turn, and what each has left
+  std::array<size_t, CLASSES> active_ {};
+  size_t active_head_ {};
+  size_t active_count_ {};
+  bool turn_started_ {};
+  std::array<size_t, CLASSES> deficit_ {};
+
+  // The queue to take the next frame from
+  std::deque<Entry>& nextQueue();
+
+  void activate( size_t cls );
+  void rotate();
+
+  static size_t frameSize( const EthernetFrame& frame );
+};
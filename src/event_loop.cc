@@ -0,0 +1,253 @@
+#include "event_loop.hh"
+
+#include "exception.hh"
+
+#include <algorithm>
+#include <array>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+// epoll tags of the loop's own descriptors (ports are tagged with their index)
+constexpr uint64_t TIMER_TAG = UINT64_MAX;
+constexpr uint64_t WAKEUP_TAG = UINT64_MAX - 1;
+
+// Read a timerfd's or eventfd's counter (0 if it has not fired)
+uint64_t read_counter( const FileDescriptor& fd )
+{
+  uint64_t count = 0;
+  if ( ::read( fd.fd_num(), &count, sizeof( count ) ) != sizeof( count ) ) {
+    return 0;
+  }
+  return count;
+}
+
+} // namespace
+
+EventLoop::EventLoop( const chrono::milliseconds tick_interval )
+  : epoll_( CheckSystemCall( "epoll_create1", epoll_create1( EPOLL_CLOEXEC ) ) )
+  , timer_( CheckSystemCall( "timerfd_create", timerfd_create( CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC ) ) )
+  , wakeup_( CheckSystemCall( "eventfd", eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC ) ) )
+  , tick_interval_( max( tick_interval, chrono::milliseconds { 1 } ) )
+{
+  const auto seconds = chrono::duration_cast<chrono::seconds>( tick_interval_ );
+  const auto nanoseconds = chrono::duration_cast<chrono::nanoseconds>( tick_interval_ - seconds );
+  const timespec interval { seconds.count(), nanoseconds.count() };
+  const itimerspec timer { interval, interval };
+  CheckSystemCall( "timerfd_settime", timerfd_settime( timer_.fd_num(), 0, &timer, nullptr ) );
+
+  watch( EPOLL_CTL_ADD, timer_.fd_num(), EPOLLIN, TIMER_TAG );
+  watch( EPOLL_CTL_ADD, wakeup_.fd_num(), EPOLLIN, WAKEUP_TAG );
+}
+
+void EventLoop::watch( const int operation, const int fd, const uint32_t events, const uint64_t tag )
+{
+  epoll_event event {};
+  event.events = events;
+  event.data.u64 = tag;
+  CheckSystemCall( "epoll_ctl", epoll_ctl( epoll_.fd_num(), operation, fd, &event ) );
+}
+
+void EventLoop::add( AsyncNetworkInterface& interface, FrameLink& link )
+{
+  link.socket().set_blocking( false );
+  if ( adaptive_ ) {
+    link.set_burst( clamp( link.burst(), adaptive_->min_burst, adaptive_->max_burst ) );
+  }
+  ports_.push_back( { &interface, &link, false } );
+  watch( EPOLL_CTL_ADD, link.socket().fd_num(), EPOLLIN, ports_.size() - 1 );
+}
+
+void EventLoop::set_adaptive_polling( const AdaptivePolling& policy )
+{
+  adaptive_ = policy;
+  adaptive_->min_burst = max<size_t>( adaptive_->min_burst, 1 );
+  adaptive_->max_burst = max( adaptive_->max_burst, adaptive_->min_burst );
+  for ( auto& port : ports_ ) {
+    port.link->set_burst( clamp( port.link->burst(), adaptive_->min_burst, adaptive_->max_burst ) );
+  }
+}
+
+void EventLoop::updateInterest( const size_t port )
+{
+  Port& p = ports_[port];
+  const bool want_output = p.link->unsent() > 0;
+  if ( want_output != p.watching_output ) {
+    watch( EPOLL_CTL_MOD, p.link->socket().fd_num(), want_output ? EPOLLIN | EPOLLOUT : EPOLLIN, port );
+    p.watching_output = want_output;
+  }
+}
+
+void EventLoop::spawn( Task task )
+{
+  // (started before it is stored, since it may spawn others; its frame does not move with it)
+  task.resume();
+  if ( task.done() ) {
+    task.rethrow_if_failed();
+    return;
+  }
+  tasks_.push_back( std::move( task ) );
+}
+
+void EventLoop::reapTasks()
+{
+  const auto finished = ranges::partition( tasks_, []( const Task& task ) { return not task.done(); } ).begin();
+  if ( finished == tasks_.end() ) {
+    return;
+  }
+  vector<Task> done { make_move_iterator( finished ), make_move_iterator( tasks_.end() ) };
+  tasks_.erase( finished, tasks_.end() );
+  for ( const auto& task : done ) {
+    task.rethrow_if_failed();
+  }
+}
+
+void EventLoop::tickExpired()
+{
+  const uint64_t expirations = read_counter( timer_ );
+  const auto ms = static_cast<size_t>( expirations * tick_interval_.count() );
+  if ( ms > 0 ) {
+    for ( auto& port : ports_ ) {
+      port.interface->tick( ms );
+    }
+    ticked_ms_ += ms;
+  }
+}
+
+size_t EventLoop::receiveFrom( Port& port )
+{
+  size_t received = 0;
+  size_t full_bursts = 0;
+  for ( size_t burst = 0; burst < MAX_BURSTS_PER_WAKEUP; burst++ ) {
+    const size_t frames = port.link->receive( *port.interface );
+    received += frames;
+    if ( frames < port.link->burst() ) {
+      break;
+    }
+    full_bursts++;
+  }
+
+  if ( adaptive_ ) {
+    // (more than a burst waiting means the queue is building up; a quarter of one, that it is not)
+    const size_t burst = port.link->burst();
+    if ( full_bursts > 1 and burst < adaptive_->max_burst ) {
+      port.link->set_burst( min( burst * 2, adaptive_->max_burst ) );
+      polling_stats_.burst_increases++;
+    } else if ( received < burst / 4 and burst > adaptive_->min_burst ) {
+      port.link->set_burst( max( burst / 2, adaptive_->min_burst ) );
+      polling_stats_.burst_decreases++;
+    }
+  }
+  return received;
+}
+
+size_t EventLoop::finishRound( const size_t received )
+{
+  if ( handler_ ) {
+    handler_( received );
+  }
+  for ( const auto& hook : round_hooks_ ) {
+    hook();
+  }
+  reapTasks();
+
+  size_t sent = 0;
+  for ( size_t i = 0; i < ports_.size(); i++ ) {
+    ports_[i].interface->flush_sends();
+    while ( const size_t frames = ports_[i].link->transmit( *ports_[i].interface ) ) {
+      sent += frames;
+    }
+    updateInterest( i );
+  }
+  return sent;
+}
+
+EventLoop::Round EventLoop::waitAndHandle( const int timeout_ms )
+{
+  array<epoll_event, 64> events {};
+  const auto waiting = chrono::steady_clock::now();
+  const int ready = epoll_wait( epoll_.fd_num(), events.data(), events.size(), timeout_ms );
+  const auto woken = chrono::steady_clock::now();
+  polling_stats_.sleeping += woken - waiting;
+  if ( ready < 0 ) {
+    if ( errno == EINTR ) {
+      return {};
+    }
+    throw unix_error { "epoll_wait" };
+  }
+
+  size_t received = 0;
+  for ( int i = 0; i < ready; i++ ) {
+    const uint64_t tag = events[i].data.u64;
+    if ( tag == TIMER_TAG ) {
+      tickExpired();
+    } else if ( tag == WAKEUP_TAG ) {
+      read_counter( wakeup_ );
+    } else if ( events[i].events & ( EPOLLIN | EPOLLERR ) ) {
+      received += receiveFrom( ports_[tag] );
+    }
+    // (ports that became writable are served below, with every other port)
+  }
+  const size_t sent = finishRound( received );
+
+  polling_stats_.wakeups++;
+  polling_stats_.interrupt += chrono::steady_clock::now() - woken;
+  return { static_cast<size_t>( ready ), received + sent };
+}
+
+size_t EventLoop::run_once( const int timeout_ms )
+{
+  return waitAndHandle( timeout_ms ).events;
+}
+
+size_t EventLoop::poll_once()
+{
+  const auto start = chrono::steady_clock::now();
+  if ( start >= next_tick_check_ ) {
+    tickExpired();
+    next_tick_check_ = start + tick_interval_;
+  }
+
+  size_t received = 0;
+  for ( auto& port : ports_ ) {
+    received += receiveFrom( port );
+  }
+  const size_t frames = received + finishRound( received );
+
+  polling_stats_.polls++;
+  if ( frames == 0 ) {
+    polling_stats_.empty_polls++;
+  }
+  polling_stats_.polling += chrono::steady_clock::now() - start;
+  return frames;
+}
+
+void EventLoop::run()
+{
+  bool polling = false;
+  size_t empty_polls = 0;
+  while ( not stopping_ ) {
+    if ( not polling ) {
+      polling = waitAndHandle( -1 ).frames > 0 and adaptive_.has_value();
+      empty_polls = 0;
+    } else if ( poll_once() > 0 ) {
+      empty_polls = 0;
+    } else if ( ++empty_polls >= adaptive_->empty_polls_before_sleep ) {
+      polling = false;
+      polling_stats_.sleeps++;
+    }
+  }
+  stopping_ = false;
+}
+
+void EventLoop::stop()
+{
+  stopping_ = true;
+  const uint64_t one = 1;
+  CheckSystemCall( "write (eventfd)", static_cast<int>( ::write( wakeup_.fd_num(), &one, sizeof( one ) ) ) );
+}
@@ -0,0 +1,156 @@
+#pragma once
+
+#include "file_descriptor.hh"
+#include "frame_link.hh"
+#include "router.hh"
+#include "task.hh"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <vector>
+
+// An epoll(7) event loop that drives interfaces over their FrameLinks, instead of a busy loop.
+//
+// Each interface's socket is watched for input, which is drained a burst at a time into the
+// interface; then the handler (e.g. one that calls Router::route()) runs, and every interface
+// sends what it has queued. A socket is only watched for output while its link holds frames
+// that the socket would not take, and those are sent as soon as it is writable again. A timerfd
+// drives every interface's tick(), so ARP timers advance without polling, and stop() wakes the
+// loop through an eventfd. With nothing to do, the loop sleeps in epoll_wait().
+//
+// With adaptive polling set, run() busy-polls instead while frames keep arriving: each round
+// receives from every socket without waiting, and only after a number of rounds in a row with
+// nothing received or sent does the loop go back to sleeping in epoll_wait() (from which the next
+// frame brings it back to polling). The burst of each link then follows its queue too, growing
+// while a round finds more than a burst waiting and shrinking while rounds find little. The time
+// spent in each mode is kept in polling_stats().
+//
+// Coroutines (Tasks) can run on the loop too: spawn() starts one, and it is resumed by whatever
+// it waits on (e.g. a CoInterface, which resumes its waiters from a round hook).
+//
+// The loop, its interfaces and its links all belong to the thread that calls run(); only stop()
+// may be called from other threads.
+class EventLoop
+{
+public:
+  static constexpr std::chrono::milliseconds DEFAULT_TICK_INTERVAL { 10 };
+
+  // Bursts taken from one socket per wakeup, at most (so that one busy link cannot starve the others)
+  static constexpr size_t MAX_BURSTS_PER_WAKEUP = 8;
+
+  // How run() switches between busy-polling and sleeping
+  struct AdaptivePolling
+  {
+    size_t empty_polls_before_sleep = 64; // rounds with nothing to do before going back to sleep
+    size_t min_burst = 8;                 // the links' bursts stay within these
+    size_t max_burst = 256;
+  };
+
+  // Time spent in each mode (and rounds run in it) by run() and run_once()
+  struct PollingStats
+  {
+    std::chrono::nanoseconds polling {};   // busy-polling rounds
+    std::chrono::nanoseconds interrupt {}; // handling what epoll_wait() reported
+    std::chrono::nanoseconds sleeping {};  // waiting in epoll_wait()
+    uint64_t polls {};                     // busy-polling rounds
+    uint64_t empty_polls {};               // ... with nothing to do
+    uint64_t wakeups {};                   // rounds after epoll_wait()
+    uint64_t sleeps {};                    // switches from polling to sleeping
+    uint64_t burst_increases {};
+    uint64_t burst_decreases {};
+  };
+
+  explicit EventLoop( std::chrono::milliseconds tick_interval = DEFAULT_TICK_INTERVAL );
+
+  // Drive `interface` over `link`, whose socket is made non-blocking. Both must outlive the loop.
+  void add( AsyncNetworkInterface& interface, FrameLink& link );
+
+  // Called after each round of receiving (with the number of frames received), before the interfaces send
+  void set_handler( std::function<void( size_t )> handler ) { handler_ = std::move( handler ); }
+
+  // Called after the handler each round, before the interfaces send (in the order they were added)
+  void add_round_hook( std::function<void()> hook ) { round_hooks_.push_back( std::move( hook ) ); }
+
+  // Start `task`, and keep it until it finishes. An exception that escapes a task is rethrown by
+  // run_once() (or by spawn(), if the task fails before it first suspends).
+  void spawn( Task task );
+
+  // Tasks that have not finished yet
+  size_t tasks() const { return tasks_.size(); }
+
+  // Handle whatever is ready, waiting up to `timeout_ms` (or forever, if negative) for something
+  // to be. Returns the number of events handled.
+  size_t run_once( int timeout_ms );
+
+  // Receive from every socket without waiting, and run a round as run_once() does (ticking the
+  // interfaces if the timer is due). Returns the number of frames received and sent.
+  size_t poll_once();
+
+  // Handle events until stop() is called (returning at once if it already has been since the last
+  // run()), busy-polling while there is work if adaptive polling is set
+  void run();
+
+  // Busy-poll in run() as `policy` says (and adapt the links' bursts)
+  void set_adaptive_polling( const AdaptivePolling& policy );
+
+  const PollingStats& polling_stats() const { return polling_stats_; }
+
+  // Make run() return (safe to call from any thread, or from the handler)
+  void stop();
+
+  // Time the interfaces have been ticked by, so far
+  uint64_t ticked_ms() const { return ticked_ms_; }
+
+private:
+  struct Port
+  {
+    AsyncNetworkInterface* interface;
+    FrameLink* link;
+    bool watching_output;
+  };
+
+  FileDescriptor epoll_;
+  FileDescriptor timer_;
+  FileDescriptor wakeup_;
+  std::chrono::milliseconds tick_interval_;
+  std::vector<Port> ports_ {};
+  std::function<void( size_t )> handler_ {};
+  std::vector<std::function<void()>> round_hooks_ {};
+  std::vector<Task> tasks_ {};
+  std::atomic<bool> stopping_ { false };
+  uint64_t ticked_ms_ {};
+  std::optional<AdaptivePolling> adaptive_ {};
+  PollingStats polling_stats_ {};
+  std::chrono::steady_clock::time_point next_tick_check_ {}; // while polling, when to look at the timer
+
+  struct Round
+  {
+    size_t events;
+    size_t frames; // received and sent
+  };
+
+  // Wait up to `timeout_ms` for events, and handle them
+  Round waitAndHandle( int timeout_ms );
+
+  // Tick the interfaces by however many timer intervals have passed
+  void tickExpired();
+
+  // Receive up to MAX_BURSTS_PER_WAKEUP bursts from a port's socket (adapting its burst, if polling
+  // is adaptive); returns the number of frames received
+  size_t receiveFrom( Port& port );
+
+  // Run the handler, hooks and tasks, and send; returns the number of frames sent
+  size_t finishRound( size_t received );
+
+  // Watch a port's socket for output only while it has frames to send
+  void updateInterest( size_t port );
+
+  // Forget finished tasks, rethrowing the first failure
+  void reapTasks();
+
+  void watch( int operation, int fd, uint32_t events, uint64_t tag );
+};
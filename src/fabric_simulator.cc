@@ -0,0 +1,323 @@
+#include "fabric_simulator.hh"
+
+#include <algorithm>
+#include <barrier>
+#include <cstring>
+#include <string>
+
+using namespace std;
+
+namespace {
+
+constexpr size_t TIME_BYTES = sizeof( uint64_t );
+
+// The sending time that a host wrote at the start of a datagram's payload
+uint64_t sending_time( const InternetDatagram& dgram )
+{
+  string start;
+  for ( const auto& buffer : dgram.payload ) {
+    start.append( string_view { buffer }.substr( 0, TIME_BYTES - start.size() ) );
+    if ( start.size() == TIME_BYTES ) {
+      break;
+    }
+  }
+  uint64_t time = 0;
+  memcpy( &time, start.data(), start.size() );
+  return time;
+}
+
+} // namespace
+
+double FabricSimulator::Report::throughput() const
+{
+  return simulated_ms == 0 ? 0 : static_cast<double>( delivered ) * 1000 / static_cast<double>( simulated_ms );
+}
+
+double FabricSimulator::Report::simulation_rate() const
+{
+  return wall.count() == 0 ? 0 : static_cast<double>( forwarded ) * 1e9 / static_cast<double>( wall.count() );
+}
+
+void FabricSimulator::Report::print( ostream& out ) const
+{
+  const auto mean_hop = hops == 0 ? 0 : static_cast<double>( latency_us ) / static_cast<double>( hops );
+  out << "simulated " << simulated_ms << " ms in " << static_cast<double>( wall.count() ) / 1e9 << " s on "
+      << threads << " thread(s), " << windows << " windows\n"
+      << "datagrams: sent=" << sent << " delivered=" << delivered << " forwarded=" << forwarded
+      << " link_drops=" << link_drops << "\n"
+      << "throughput: " << throughput() << " datagrams/s simulated, " << simulation_rate()
+      << " router hops/s of wall-clock time\n"
+      << "end-to-end latency: p50=" << end_to_end.percentile( 0.5 ) << "us p99=" << end_to_end.percentile( 0.99 )
+      << "us max=" << end_to_end.max() << "us\n"
+      << "per-hop latency: mean=" << mean_hop << "us p50=" << per_hop.percentile( 0.5 )
+      << "us p99=" << per_hop.percentile( 0.99 ) << "us max=" << per_hop.max() << "us\n";
+}
+
+EthernetAddress FabricSimulator::newEthernetAddress()
+{
+  // (locally administered, and unique within the simulation)
+  const uint64_t n = next_ethernet_address_++;
+  return { 0x02,
+           static_cast<uint8_t>( n >> 32 ),
+           static_cast<uint8_t>( n >> 24 ),
+           static_cast<uint8_t>( n >> 16 ),
+           static_cast<uint8_t>( n >> 8 ),
+           static_cast<uint8_t>( n ) };
+}
+
+size_t FabricSimulator::add_router()
+{
+  routers_.push_back( make_unique<RouterNode>() );
+  return routers_.size() - 1;
+}
+
+size_t FabricSimulator::addLink( const size_t capacity, const uint64_t latency_ms )
+{
+  const uint64_t latency = max<uint64_t>( latency_ms, 1 );
+  links_.push_back( make_unique<Link>( capacity, latency ) );
+  min_latency_ = min( min_latency_, latency );
+  return links_.size() - 1;
+}
+
+void FabricSimulator::attach( RouterNode& node, const size_t interface, const size_t in, const size_t out )
+{
+  node.in_links.resize( max( node.in_links.size(), interface + 1 ), NO_LINK );
+  node.out_links.resize( max( node.out_links.size(), interface + 1 ), NO_LINK );
+  node.in_links[interface] = in;
+  node.out_links[interface] = out;
+}
+
+pair<size_t, size_t> FabricSimulator::connect( const size_t a,
+                                               const Address& a_address,
+                                               const size_t b,
+                                               const Address& b_address,
+                                               const uint64_t latency_ms,
+                                               const size_t capacity )
+{
+  RouterNode& x = *routers_.at( a );
+  RouterNode& y = *routers_.at( b );
+  const size_t a_to_b = addLink( capacity, latency_ms );
+  const size_t b_to_a = addLink( capacity, latency_ms );
+
+  AsyncNetworkInterface a_port { newEthernetAddress(), a_address };
+  AsyncNetworkInterface b_port { newEthernetAddress(), b_address };
+  a_port.set_ring_capacities( capacity, capacity );
+  b_port.set_ring_capacities( capacity, capacity );
+  const size_t a_interface = x.router->add_interface( std::move( a_port ) );
+  const size_t b_interface = y.router->add_interface( std::move( b_port ) );
+  attach( x, a_interface, b_to_a, a_to_b );
+  attach( y, b_interface, a_to_b, b_to_a );
+  return { a_interface, b_interface };
+}
+
+size_t FabricSimulator::add_host( const size_t r,
+                                  const Address& address,
+                                  const Address& gateway,
+                                  const uint64_t latency_ms )
+{
+  RouterNode& node = *routers_.at( r );
+  const size_t up = addLink( HOST_RING_CAPACITY, latency_ms );
+  const size_t down = addLink( HOST_RING_CAPACITY, latency_ms );
+
+  AsyncNetworkInterface port { newEthernetAddress(), gateway };
+  port.set_ring_capacities( HOST_RING_CAPACITY, HOST_RING_CAPACITY );
+  const size_t attachment = node.router->add_interface( std::move( port ) );
+  attach( node, attachment, up, down );
+
+  AsyncNetworkInterface interface { newEthernetAddress(), address };
+  interface.set_ring_capacities( HOST_RING_CAPACITY, HOST_RING_CAPACITY );
+  hosts_.push_back(
+    { std::move( interface ), address.ipv4_numeric(), gateway.ipv4_numeric(), r, attachment, up, down } );
+  return hosts_.size() - 1;
+}
+
+void FabricSimulator::add_flow( const size_t host,
+                                const Address& destination,
+                                const uint64_t count,
+                                const uint64_t interval_ms,
+                                const uint64_t start_ms,
+                                const size_t payload )
+{
+  hosts_.at( host ).flows.push_back( { destination.ipv4_numeric(),
+                                       count,
+                                       max<uint64_t>( interval_ms, 1 ),
+                                       now_ + start_ms,
+                                       max( payload, TIME_BYTES ) } );
+}
+
+void FabricSimulator::deliver( Link& link, AsyncNetworkInterface& interface, const uint64_t time )
+{
+  // (frames arrive on a link in the order they were sent, so the ones due are at the front)
+  while ( auto in_flight = link.ring.pop() ) {
+    link.arrived.push_back( std::move( *in_flight ) );
+  }
+  while ( not link.arrived.empty() and link.arrived.front().arrival <= time ) {
+    interface.recv_frame( link.arrived.front().frame );
+    link.arrived.pop_front();
+  }
+}
+
+void FabricSimulator::transmit( AsyncNetworkInterface& interface,
+                                Link& link,
+                                const uint64_t time,
+                                vector<EthernetFrame>& frames )
+{
+  while ( not link.in_flight.empty() and link.in_flight.front() <= time ) {
+    link.in_flight.pop_front();
+  }
+
+  frames.clear();
+  interface.maybe_send_batch( frames );
+  for ( auto& frame : frames ) {
+    // (the ring itself cannot be full; see Link)
+    if ( link.in_flight.size() >= link.capacity
+         or not link.ring.push( { std::move( frame ), time + link.latency } ) ) {
+      link.drops++;
+      continue;
+    }
+    link.in_flight.push_back( time + link.latency );
+  }
+}
+
+void FabricSimulator::runHost( HostNode& host, Partition& p, const uint64_t time )
+{
+  for ( Flow& flow : host.flows ) {
+    while ( flow.remaining > 0 and flow.next <= time ) {
+      string payload( flow.payload, '\0' );
+      memcpy( payload.data(), &time, TIME_BYTES );
+
+      InternetDatagram dgram;
+      dgram.header.src = host.address;
+      dgram.header.dst = flow.destination;
+      dgram.header.ttl = HOST_TTL;
+      dgram.header.len = IPv4Header::LENGTH + payload.size();
+      dgram.header.compute_checksum();
+      dgram.payload.emplace_back( std::move( payload ) );
+      host.interface.send_datagram( std::move( dgram ), host.gateway );
+
+      p.sent++;
+      flow.remaining--;
+      flow.next += flow.interval;
+    }
+  }
+  erase_if( host.flows, []( const Flow& flow ) { return flow.remaining == 0; } );
+
+  while ( const auto dgram = host.interface.maybe_receive() ) {
+    // (each router on the way took one off the TTL)
+    const uint64_t links = static_cast<uint64_t>( HOST_TTL - dgram->header.ttl ) + 1;
+    const uint64_t latency_us = ( time - sending_time( *dgram ) ) * 1000;
+    p.delivered++;
+    p.hops += links;
+    p.latency_us += latency_us;
+    p.end_to_end.record( latency_us );
+    p.per_hop.record( latency_us / links );
+  }
+}
+
+void FabricSimulator::step( Partition& p, const uint64_t time )
+{
+  for ( const size_t r : p.routers ) {
+    RouterNode& node = *routers_[r];
+    for ( size_t i = 0; i < node.in_links.size(); i++ ) {
+      if ( node.in_links[i] != NO_LINK ) {
+        deliver( *links_[node.in_links[i]], node.router->interface( i ), time );
+      }
+    }
+  }
+  for ( const size_t h : p.hosts ) {
+    HostNode& host = hosts_[h];
+    deliver( *links_[host.in_link], host.interface, time );
+    runHost( host, p, time );
+  }
+
+  for ( const size_t r : p.routers ) {
+    routers_[r]->router->route();
+  }
+
+  for ( const size_t r : p.routers ) {
+    RouterNode& node = *routers_[r];
+    for ( size_t i = 0; i < node.out_links.size(); i++ ) {
+      if ( node.out_links[i] != NO_LINK ) {
+        transmit( node.router->interface( i ), *links_[node.out_links[i]], time, p.frames );
+      }
+    }
+    node.router->tick( 1 );
+  }
+  for ( const size_t h : p.hosts ) {
+    HostNode& host = hosts_[h];
+    transmit( host.interface, *links_[host.out_link], time, p.frames );
+    host.interface.tick( 1 );
+  }
+}
+
+FabricSimulator::Report FabricSimulator::run( const uint64_t duration_ms, size_t threads )
+{
+  threads = clamp<size_t>( threads, 1, max<size_t>( routers_.size(), 1 ) );
+
+  // Contiguous blocks of routers, with their hosts
+  vector<Partition> partitions( threads );
+  for ( size_t r = 0; r < routers_.size(); r++ ) {
+    partitions[r * threads / routers_.size()].routers.push_back( r );
+  }
+  for ( size_t h = 0; h < hosts_.size(); h++ ) {
+    partitions[hosts_[h].router * threads / routers_.size()].hosts.push_back( h );
+  }
+
+  uint64_t forwarded_before = 0;
+  for ( const auto& node : routers_ ) {
+    forwarded_before += node->router->stats().forwarded;
+  }
+  uint64_t drops_before = 0;
+  for ( const auto& link : links_ ) {
+    drops_before += link->drops;
+  }
+
+  // Windows no longer than the shortest link latency (nothing sent in one can arrive before the next)
+  const uint64_t window = min( min_latency_, max<uint64_t>( duration_ms, 1 ) );
+  const uint64_t start = now_;
+  const uint64_t end = now_ + duration_ms;
+  barrier window_done { static_cast<ptrdiff_t>( threads ) };
+  const auto simulate = [&]( const size_t w ) {
+    for ( uint64_t window_start = start; window_start < end; window_start += window ) {
+      for ( uint64_t time = window_start; time < min( window_start + window, end ); time++ ) {
+        step( partitions[w], time );
+      }
+      window_done.arrive_and_wait();
+    }
+  };
+
+  const auto wall_start = chrono::steady_clock::now();
+  if ( threads == 1 ) {
+    simulate( 0 );
+  } else {
+    if ( workers_ == nullptr or workers_->size() != threads ) {
+      workers_.reset();
+      workers_ = make_unique<WorkerPool>( threads );
+    }
+    workers_->run( simulate );
+  }
+  now_ = end;
+
+  Report report;
+  report.wall = chrono::steady_clock::now() - wall_start;
+  report.simulated_ms = duration_ms;
+  report.threads = threads;
+  report.windows = ( duration_ms + window - 1 ) / window;
+  for ( const Partition& p : partitions ) {
+    report.sent += p.sent;
+    report.delivered += p.delivered;
+    report.hops += p.hops;
+    report.latency_us += p.latency_us;
+    report.end_to_end.merge( p.end_to_end );
+    report.per_hop.merge( p.per_hop );
+  }
+  for ( const auto& node : routers_ ) {
+    report.forwarded += node->router->stats().forwarded;
+  }
+  report.forwarded -= forwarded_before;
+  for ( const auto& link : links_ ) {
+    report.link_drops += link->drops;
+  }
+  report.link_drops -= drops_before;
+  return report;
+}
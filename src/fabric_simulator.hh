@@ -0,0 +1,218 @@
+#pragma once
+
+#include "address.hh"
+#include "ethernet_frame.hh"
+#include "latency.hh"
+#include "ring_buffer.hh"
+#include "router.hh"
+#include "worker_pool.hh"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <ostream>
+#include <utility>
+#include <vector>
+
+// A parallel discrete-event simulation of a whole fabric: many Routers, and hosts attached to
+// them, joined by point-to-point links with a latency, for trying routing changes out at scale.
+//
+// Simulated time advances a millisecond at a time (the resolution of tick()). In each step, every
+// node takes the frames that its links deliver by then, hosts send what their flows are due to
+// send and take what has arrived, routers route(), every interface's outgoing frames are put on
+// its link (to arrive one link latency later), and everything is ticked.
+//
+// run() splits the routers into as many contiguous blocks as it has threads, each thread stepping
+// its own routers and the hosts attached to them. The threads synchronize conservatively: time is
+// cut into windows as long as the shortest link latency, which each thread simulates on its own
+// before waiting for the others at a barrier, since a frame sent during a window cannot arrive
+// before the next one. Each direction of a link is a lock-free single-producer, single-consumer
+// ring (its sender's thread pushes, its receiver's thread pops), so threads share nothing else.
+// Frames are delivered (or dropped, when a link already has as many frames in flight as it
+// holds) in the same order whatever the number of threads, so a run's results do not depend on it.
+//
+// Hosts send datagrams that carry their sending time, so each delivery gives an end-to-end
+// latency, and (from the TTL) the number of links it took to get there.
+class FabricSimulator
+{
+public:
+  static constexpr size_t DEFAULT_LINK_CAPACITY = 1024; // frames in flight on a router link, each way
+
+  // Frames in flight on a host's link, each way, and datagrams held by the rings of the
+  // interfaces at either end (kept small, so that tens of thousands of hosts fit in memory)
+  static constexpr size_t HOST_RING_CAPACITY = 64;
+
+  static constexpr uint8_t HOST_TTL = 64;       // of the datagrams hosts send
+  static constexpr size_t DEFAULT_PAYLOAD = 64; // bytes of the datagrams hosts send
+
+  // What a run() did
+  struct Report
+  {
+    uint64_t simulated_ms {};         // time simulated
+    std::chrono::nanoseconds wall {}; // ... and how long it took
+    size_t threads {};
+    uint64_t windows {}; // time windows (barrier synchronizations)
+
+    uint64_t sent {};       // datagrams sent by hosts
+    uint64_t delivered {};  // ... that reached their destination
+    uint64_t forwarded {};  // router hops (datagrams forwarded by a router)
+    uint64_t link_drops {}; // frames dropped because their link was full
+    uint64_t hops {};       // links taken by the datagrams delivered, in total
+    uint64_t latency_us {}; // end-to-end latencies of the datagrams delivered, in total
+
+    // Of the datagrams delivered, in simulated microseconds: the time from sending to delivery,
+    // and that time divided by the number of links taken
+    LatencyHistogram end_to_end {};
+    LatencyHistogram per_hop {};
+
+    // Datagrams delivered per simulated second
+    double throughput() const;
+
+    // Router hops simulated per second of wall-clock time
+    double simulation_rate() const;
+
+    void print( std::ostream& out ) const;
+  };
+
+  FabricSimulator() = default;
+
+  // Add a router; returns its index (its routes are added through router())
+  size_t add_router();
+
+  Router& router( size_t index ) { return *routers_.at( index )->router; }
+
+  // Join routers `a` and `b` with a link of `latency_ms` (at least 1) each way, adding an interface
+  // with the given address to each. `capacity` is the number of frames the link holds in flight
+  // each way, and of datagrams the two interfaces' rings hold. Returns the numbers of the two
+  // interfaces.
+  std::pair<size_t, size_t> connect( size_t a,
+                                     const Address& a_address,
+                                     size_t b,
+                                     const Address& b_address,
+                                     uint64_t latency_ms = 1,
+                                     size_t capacity = DEFAULT_LINK_CAPACITY );
+
+  // Add a host with `address` on a link of `latency_ms` to a new interface of router `r`, whose
+  // address (`gateway`) is the host's next hop. Returns the host's index; see attachment().
+  size_t add_host( size_t r, const Address& address, const Address& gateway, uint64_t latency_ms = 1 );
+
+  // The number of the router interface that a host is attached to (e.g. to route to the host)
+  size_t attachment( size_t host ) const { return hosts_.at( host ).attachment; }
+
+  size_t routers() const { return routers_.size(); }
+  size_t hosts() const { return hosts_.size(); }
+
+  // Have `host` send `count` datagrams (of `payload` bytes, at least 8) to `destination`, one every
+  // `interval_ms`, starting `start_ms` after the current time
+  void add_flow( size_t host,
+                 const Address& destination,
+                 uint64_t count,
+                 uint64_t interval_ms = 1,
+                 uint64_t start_ms = 0,
+                 size_t payload = DEFAULT_PAYLOAD );
+
+  // Simulate the next `duration_ms` (at least) on `threads` threads (at most one per router), and
+  // report what happened in that time. Routes may be changed between runs.
+  Report run( uint64_t duration_ms, size_t threads = 1 );
+
+  // Simulated time so far, in milliseconds
+  uint64_t now() const { return now_; }
+
+private:
+  // A frame on its way along a link
+  struct InFlight
+  {
+    EthernetFrame frame {};
+    uint64_t arrival {}; // simulated time at which it is delivered
+  };
+
+  // One direction of a link. Whether a frame fits is decided by the sender alone, from the
+  // simulated arrival times of the frames it has in flight, so that drops do not depend on how
+  // far its thread has run ahead of the receiver's. The ring holds twice the capacity, so it
+  // never fills: the frames a receiver has not popped yet are all still in flight at its sender's
+  // time (at most `capacity`), or were at the last step of the previous window (as many again).
+  struct Link
+  {
+    SpscRing<InFlight> ring;
+    size_t capacity;
+    uint64_t latency;
+    std::deque<uint64_t> in_flight {}; // arrival times of the frames the sender has in flight
+    std::deque<InFlight> arrived {};   // popped from the ring by the receiver, not yet due
+    uint64_t drops {};                 // by the sender, when `capacity` frames were in flight
+
+    Link( size_t frames, uint64_t latency_ms ) : ring( 2 * frames ), capacity( frames ), latency( latency_ms ) {}
+  };
+
+  struct Flow
+  {
+    uint32_t destination;
+    uint64_t remaining;
+    uint64_t interval;
+    uint64_t next; // simulated time of its next datagram
+    size_t payload;
+  };
+
+  // The link of a router interface that has none (one added to the Router directly)
+  static constexpr size_t NO_LINK = SIZE_MAX;
+
+  struct RouterNode
+  {
+    std::unique_ptr<Router> router { std::make_unique<Router>() };
+    std::vector<size_t> out_links {}; // by interface number (NO_LINK for an interface without one)
+    std::vector<size_t> in_links {};  // ... and those delivering to it
+  };
+
+  struct HostNode
+  {
+    AsyncNetworkInterface interface;
+    uint32_t address;
+    uint32_t gateway;
+    size_t router;
+    size_t attachment; // the router's interface
+    size_t out_link;
+    size_t in_link;
+    std::vector<Flow> flows {};
+  };
+
+  // What one thread simulates, and what it counted
+  struct Partition
+  {
+    std::vector<size_t> routers {};
+    std::vector<size_t> hosts {};
+    std::vector<EthernetFrame> frames {}; // scratch, for draining interfaces
+    uint64_t sent {};
+    uint64_t delivered {};
+    uint64_t hops {};
+    uint64_t latency_us {};
+    LatencyHistogram end_to_end {};
+    LatencyHistogram per_hop {};
+  };
+
+  std::vector<std::unique_ptr<RouterNode>> routers_ {};
+  std::deque<HostNode> hosts_ {};
+  std::vector<std::unique_ptr<Link>> links_ {};
+  uint64_t now_ {};
+  uint64_t min_latency_ { UINT64_MAX };
+  uint64_t next_ethernet_address_ { 1 };
+  std::unique_ptr<WorkerPool> workers_ {};
+
+  // Attach links `in` and `out` to interface `interface` of `node`
+  static void attach( RouterNode& node, size_t interface, size_t in, size_t out );
+
+  EthernetAddress newEthernetAddress();
+  size_t addLink( size_t capacity, uint64_t latency_ms );
+
+  // Simulate the millisecond starting at `time` for partition `p`
+  void step( Partition& p, uint64_t time );
+
+  // Give `interface` the frames that `link` delivers by `time`
+  void deliver( Link& link, AsyncNetworkInterface& interface, uint64_t time );
+
+  // Put `interface`'s outgoing frames on `link`, sent at `time`
+  void transmit( AsyncNetworkInterface& interface, Link& link, uint64_t time, std::vector<EthernetFrame>& frames );
+
+  // Send what `host`'s flows are due to send at `time`, and take what it has received
+  void runHost( HostNode& host, Partition& p, uint64_t time );
+};
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "route_trie.hh"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// On-disk format of a saved routing table (see Router::save_fib_snapshot()).
+//
+// A snapshot is a FibSnapshotHeader followed by flat arrays, each starting on an 8-byte
+// boundary, in this order:
+//
+//   route_prefix[num_routes]           uint32_t
+//   route_next_hop[num_routes]         uint32_t   index into the next hop arrays, or
+//                                                 MULTIPATH_FLAG | index into the group arrays
+//   route_prefix_length[num_routes]    uint8_t
+//   free_slots[num_free_slots]         uint32_t   route slots that are unused
+//   next_hop_address[num_next_hops]    uint32_t
+//   next_hop_interface[num_next_hops]  uint32_t
+//   next_hop_direct[num_next_hops]     uint8_t
+//   group_num_paths[num_groups]        uint32_t   0 for an unused group
+//   group_paths[num_group_paths]       uint32_t   every group's next hop indices, one group after another
+//   group_buckets[num_groups * GROUP_BUCKETS]  uint32_t  next hop index of each flow-hash bucket
+//   trie_nodes[num_trie_nodes]         RouteTrie::Node (absent if num_trie_nodes is 0)
+//
+// Numbers are in host byte order (a snapshot is for restarting the same router, not for
+// exchanging tables between machines); byte_order tells a reader whether that matches its own.
+// The arrays are laid out so that a reader can map the file and load it in one sequential pass.
+struct FibSnapshotHeader
+{
+  static constexpr std::array<char, 8> MAGIC { 'N', 'L', 'F', 'I', 'B', 'S', 'N', 'P' };
+  static constexpr uint32_t VERSION = 2;
+  static constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+  // Multipath routes: the flag on a route_next_hop that names a group, and each group's bucket count
+  static constexpr uint32_t MULTIPATH_FLAG = 1U << 31;
+  static constexpr size_t GROUP_BUCKETS = 256;
+
+  std::array<char, 8> magic { MAGIC };
+  uint32_t version { VERSION };
+  uint32_t byte_order { BYTE_ORDER_MARK };
+  uint32_t num_routes {};
+  uint32_t num_free_slots {};
+  uint32_t num_next_hops {};
+  uint32_t num_trie_nodes {};
+  uint32_t num_groups {};
+  uint32_t num_group_paths {};
+};
+
+static_assert( sizeof( FibSnapshotHeader ) == 40 );
+static_assert( sizeof( RouteTrie::Node ) == 12 );
+
+// Where each array of a snapshot starts (byte offsets from the start of the file)
+struct FibSnapshotLayout
+{
+  size_t route_prefix, route_next_hop, route_prefix_length, free_slots;
+  size_t next_hop_address, next_hop_interface, next_hop_direct;
+  size_t group_num_paths, group_paths, group_buckets, trie_nodes;
+  size_t size; // of the whole file
+
+  explicit constexpr FibSnapshotLayout( const FibSnapshotHeader& header )
+    : route_prefix( sizeof( FibSnapshotHeader ) )
+    , route_next_hop( after( route_prefix, header.num_routes * sizeof( uint32_t ) ) )
+    , route_prefix_length( after( route_next_hop, header.num_routes * sizeof( uint32_t ) ) )
+    , free_slots( after( route_prefix_length, header.num_routes ) )
+    , next_hop_address( after( free_slots, header.num_free_slots * sizeof( uint32_t ) ) )
+    , next_hop_interface( after( next_hop_address, header.num_next_hops * sizeof( uint32_t ) ) )
+    , next_hop_direct( after( next_hop_interface, header.num_next_hops * sizeof( uint32_t ) ) )
+    , group_num_paths( after( next_hop_direct, header.num_next_hops ) )
+    , group_paths( after( group_num_paths, header.num_groups * sizeof( uint32_t ) ) )
+    , group_buckets( after( group_paths, header.num_group_paths * sizeof( uint32_t ) ) )
+    , trie_nodes( after( group_buckets, size_t { header.num_groups } * FibSnapshotHeader::GROUP_BUCKETS * sizeof( uint32_t ) ) )
+    , size( trie_nodes + size_t { header.num_trie_nodes } * sizeof( RouteTrie::Node ) )
+  {}
+
+private:
+  static constexpr size_t after( const size_t offset, const size_t length ) { return ( offset + length + 7 ) & ~7UL; }
+};
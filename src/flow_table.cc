@@ -0,0 +1,151 @@
+#include "flow_table.hh"
+
+#include "crc32c.hh"
+
+#include <algorithm>
+#include <bit>
+#include <stdexcept>
+#include <utility>
+
+using namespace std;
+
+FlowTable::FlowTable( const size_t memory_budget, const uint64_t idle_timeout )
+  : idle_timeout_( idle_timeout )
+  , tick_length_( max<uint64_t>( 1, ( idle_timeout + WHEEL_SLOTS - 3 ) / ( WHEEL_SLOTS - 2 ) ) )
+{
+  // (each flow takes a slot, and an event in the wheel)
+  const size_t slots = bit_floor( memory_budget / ( sizeof( Slot ) + sizeof( Event ) ) );
+  if ( slots < 8 ) {
+    throw runtime_error( "FlowTable: memory budget too small" );
+  }
+  slots_.resize( slots );
+
+  events_.resize( slots );
+  for ( uint32_t i = 0; i < slots; i++ ) {
+    events_[i].next = i + 1 < slots ? i + 1 : NO_EVENT;
+  }
+  free_events_ = 0;
+  wheel_.fill( NO_EVENT );
+}
+
+uint32_t FlowTable::hash( const FlowKey& key )
+{
+  return crc32c_extend( crc32c_extend( crc32c_extend( crc32c_extend( ~0U, key.src ), key.dst ), key.ports ),
+                        key.proto );
+}
+
+size_t FlowTable::locate( const FlowKey& key, const uint32_t hash ) const
+{
+  // (Robin Hood order: once the probe is further from home than the entry it reaches, the flow
+  // would have taken that slot, so it is not in the table)
+  for ( size_t i = hash & mask(), distance = 1;; i = ( i + 1 ) & mask(), distance++ ) {
+    const Slot& slot = slots_[i];
+    if ( slot.distance < distance ) {
+      return SIZE_MAX;
+    }
+    if ( slot.hash == hash and slot.flow.key == key ) {
+      return i;
+    }
+  }
+}
+
+const FlowTable::Flow* FlowTable::find( const FlowKey& key ) const
+{
+  const size_t i = locate( key, hash( key ) );
+  return i == SIZE_MAX ? nullptr : &slots_[i].flow;
+}
+
+const FlowTable::Flow* FlowTable::record( const FlowKey& key, const uint32_t hash, const size_t bytes, const uint64_t now )
+{
+  size_t i = hash & mask();
+  uint32_t distance = 1;
+  for ( ;; i = ( i + 1 ) & mask(), distance++ ) {
+    Slot& slot = slots_[i];
+    if ( slot.distance < distance ) {
+      break;
+    }
+    if ( slot.hash == hash and slot.flow.key == key ) {
+      slot.flow.datagrams++;
+      slot.flow.bytes += bytes;
+      slot.flow.last_seen = now;
+      return &slot.flow;
+    }
+  }
+
+  // A new flow, if there is room: it takes slot i, and the entries from there on are pushed
+  // along until one lands in an empty slot
+  if ( ( size_ + 1 ) * 8 > slots_.size() * 7 ) {
+    stats_.rejected++;
+    return nullptr;
+  }
+  Slot incoming { { key, 1, bytes, now, now }, hash, distance };
+  const size_t placed = i;
+  while ( slots_[i].distance != 0 ) {
+    if ( slots_[i].distance < incoming.distance ) {
+      swap( slots_[i], incoming );
+    }
+    i = ( i + 1 ) & mask();
+    incoming.distance++;
+  }
+  slots_[i] = incoming;
+
+  size_++;
+  stats_.created++;
+
+  // (there are as many events as slots, so one is free)
+  const uint32_t event = free_events_;
+  free_events_ = events_[event].next;
+  events_[event].key = key;
+  events_[event].hash = hash;
+  schedule( event, now );
+  return &slots_[placed].flow;
+}
+
+void FlowTable::remove( size_t i )
+{
+  // Backward shift: each following entry that is not in its home slot moves back one
+  for ( size_t next = ( i + 1 ) & mask(); slots_[next].distance > 1; i = next, next = ( next + 1 ) & mask() ) {
+    slots_[i] = slots_[next];
+    slots_[i].distance--;
+  }
+  slots_[i] = Slot {};
+  size_--;
+}
+
+void FlowTable::schedule( const uint32_t event, const uint64_t last_seen )
+{
+  // (the first tick at or after the expiry time; always a later tick than the current one, and
+  // less than a whole turn of the wheel ahead)
+  const uint64_t tick = max( ( last_seen + idle_timeout_ + tick_length_ - 1 ) / tick_length_, wheel_tick_ + 1 );
+  uint32_t& head = wheel_[tick % WHEEL_SLOTS];
+  events_[event].next = head;
+  head = event;
+}
+
+void FlowTable::expire( const uint64_t now )
+{
+  const uint64_t target = now / tick_length_;
+
+  // (after a long gap, every event is due: one turn of the wheel visits them all)
+  if ( target > wheel_tick_ + WHEEL_SLOTS ) {
+    wheel_tick_ = target - WHEEL_SLOTS;
+  }
+
+  while ( wheel_tick_ < target ) {
+    wheel_tick_++;
+    uint32_t event = exchange( wheel_[wheel_tick_ % WHEEL_SLOTS], NO_EVENT );
+    while ( event != NO_EVENT ) {
+      const uint32_t next = events_[event].next;
+      const size_t i = locate( events_[event].key, events_[event].hash );
+      if ( now >= slots_[i].flow.last_seen + idle_timeout_ ) {
+        remove( i );
+        stats_.expired++;
+        events_[event].next = free_events_;
+        free_events_ = event;
+      } else {
+        schedule( event, slots_[i].flow.last_seen );
+      }
+      event = next;
+    }
+  }
+}
@@ -0,0 +1,147 @@
+#pragma once
+
+#include "ipv4_view.hh"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// A datagram's flow: its addresses, protocol and (for TCP and UDP) ports
+struct FlowKey
+{
+  uint32_t src {};
+  uint32_t dst {};
+  uint32_t ports {}; // source port in the high 16 bits (see IPv4View::ports())
+  uint8_t proto {};
+
+  bool operator==( const FlowKey& other ) const = default;
+
+  static FlowKey of( const IPv4View& datagram )
+  {
+    return { datagram.src(), datagram.dst(), datagram.ports(), datagram.proto() };
+  }
+};
+
+// A table of the flows seen recently, with counters for each, within a fixed memory budget.
+//
+// Flows are kept inline in one flat array, by Robin Hood hashing (linear probing in which an
+// entry far from its home slot takes the place of one nearer to its own, so that every probe
+// sequence stays short): recording a datagram is one CRC-32C hash of its flow and one probe,
+// which usually ends at the first slot. The array is sized from the budget when the table is
+// made and never grows; a new flow that would take it over 7/8 full is not tracked (and is
+// counted as rejected).
+//
+// A flow that sees no datagram for the idle timeout is evicted by expire(), which is driven by
+// a timer wheel: every flow has one event in the wheel, filed under the tick at which it would
+// expire if it saw nothing more. When the event comes due, the flow is evicted if it has indeed
+// been idle since, and otherwise filed again under its new expiry time, so that recording a
+// datagram never touches the wheel.
+//
+// A table is not thread-safe; the Router keeps one for each inbound interface, so that a worker
+// of route_parallel() only ever touches the tables of its own interfaces.
+class FlowTable
+{
+public:
+  // A flow, and what has been seen of it
+  struct Flow
+  {
+    FlowKey key {};
+    uint64_t datagrams {};
+    uint64_t bytes {};
+    uint64_t first_seen {}; // times in ms (of the clock passed to record())
+    uint64_t last_seen {};
+  };
+
+  struct Stats
+  {
+    size_t active {};    // flows in the table
+    size_t capacity {};  // slots (of which at most 7/8 are used)
+    uint64_t created {}; // flows added
+    uint64_t expired {}; // flows evicted for being idle
+    uint64_t rejected {}; // new flows not tracked because the table was full
+  };
+
+  // Events in the timer wheel (which spans at least the idle timeout over this many ticks)
+  static constexpr size_t WHEEL_SLOTS = 256;
+
+private:
+  struct Slot
+  {
+    Flow flow {};
+    uint32_t hash {};
+    uint32_t distance {}; // 1 + distance from the home slot; 0 for an empty slot
+  };
+
+  static constexpr uint32_t NO_EVENT = UINT32_MAX;
+
+  // An event in the timer wheel: check the flow `key`. Events live in one array with a node per
+  // slot (there is never an event without a flow), each linked into the list of its tick's slot
+  // in the wheel, or into the free list.
+  struct Event
+  {
+    FlowKey key {};
+    uint32_t hash {};
+    uint32_t next { NO_EVENT };
+  };
+
+  std::vector<Slot> slots_ {};
+  size_t size_ {};
+  uint64_t idle_timeout_;
+
+  std::vector<Event> events_ {};
+  uint32_t free_events_ { NO_EVENT };
+  std::array<uint32_t, WHEEL_SLOTS> wheel_ {}; // first event of each slot's list
+  uint64_t tick_length_;   // ms
+  uint64_t wheel_tick_ {}; // the last tick whose events have been handled
+
+  Stats stats_ {};
+
+  size_t mask() const { return slots_.size() - 1; }
+
+  // Slot of a flow, or SIZE_MAX
+  size_t locate( const FlowKey& key, uint32_t hash ) const;
+
+  // File event `event` under the tick at which its flow expires, if it stays idle from `last_seen`
+  void schedule( uint32_t event, uint64_t last_seen );
+
+  // Remove the flow in slot `i` (shifting the ones after it back)
+  void remove( size_t i );
+
+public:
+  // A table of at most about `memory_budget` bytes (the slots and their events), whose flows
+  // are evicted after `idle_timeout` ms without a datagram
+  FlowTable( size_t memory_budget, uint64_t idle_timeout );
+
+  static uint32_t hash( const FlowKey& key );
+
+  // Count a datagram of `bytes` bytes of flow `key` (whose hash is `hash`), seen at `now` (in ms,
+  // never less than the last time passed to expire()). Returns the flow, or nullptr if it is new
+  // and the table is full. (The pointer is invalidated by the next record() or expire().)
+  const Flow* record( const FlowKey& key, uint32_t hash, size_t bytes, uint64_t now );
+
+  // The flow `key`, or nullptr
+  const Flow* find( const FlowKey& key ) const;
+
+  // Evict the flows that have been idle for the timeout at time `now` (in ms)
+  void expire( uint64_t now );
+
+  Stats stats() const
+  {
+    Stats stats = stats_;
+    stats.active = size_;
+    stats.capacity = slots_.size();
+    return stats;
+  }
+
+  // Calls f( flow ) for every flow, in no particular order
+  template<typename F>
+  void for_each( F&& f ) const
+  {
+    for ( const Slot& slot : slots_ ) {
+      if ( slot.distance != 0 ) {
+        f( slot.flow );
+      }
+    }
+  }
+};
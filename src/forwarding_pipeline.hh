@@ -0,0 +1,91 @@
+#pragma once
+
+#include "ipv4_view.hh"
+
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
+
+// A burst-at-a-time IPv4 forwarding loop, put together at compile time from three stages:
+//
+//   Lookup     lookup( datagrams, routes ) finds the route of each datagram of a burst, all together
+//   Filter     permits( datagram ) says whether a datagram may be forwarded at all
+//   Scheduler  forward( datagram, route ) routes one datagram and hands it on (e.g. sends it on its
+//              outbound interface straight away, or queues it to be sent by another thread)
+//
+// The stages are policy classes held by value, so that each combination gets a drain() loop of its
+// own with every stage inlined into it, and no indirect calls or intermediate std::optionals on
+// the way; a stage that has nothing to do (PermitAll) costs nothing at all. The vectors that hold
+// a burst belong to the caller, and keep their capacity from one call to the next.
+
+// A source of datagrams to forward (an AsyncNetworkInterface in forwarding mode)
+template<class Source>
+concept DatagramSource = requires( Source& source, std::vector<IPv4View>& out, size_t max_views ) {
+  { source.maybe_receive_views( out, max_views ) } -> std::convertible_to<size_t>;
+};
+
+template<class Lookup>
+concept ForwardingLookup
+  = requires( Lookup& lookup, std::span<const IPv4View> datagrams, std::span<uint32_t> routes ) {
+      lookup.lookup( datagrams, routes );
+    };
+
+template<class Filter>
+concept ForwardingFilter = requires( Filter& filter, const IPv4View& datagram ) {
+  { filter.permits( datagram ) } -> std::convertible_to<bool>;
+};
+
+template<class Scheduler>
+concept ForwardingScheduler = requires( Scheduler& scheduler, IPv4View& datagram, uint32_t route ) {
+  scheduler.forward( datagram, route );
+};
+
+// A filter that lets every datagram through
+struct PermitAll
+{
+  static constexpr bool permits( const IPv4View& /* datagram */ ) { return true; }
+};
+
+template<ForwardingLookup Lookup, ForwardingFilter Filter, ForwardingScheduler Scheduler>
+class ForwardingPipeline
+{
+  [[no_unique_address]] Lookup lookup_;
+  [[no_unique_address]] Filter filter_;
+  [[no_unique_address]] Scheduler scheduler_;
+
+public:
+  ForwardingPipeline( Lookup lookup, Filter filter, Scheduler scheduler )
+    : lookup_( std::move( lookup ) ), filter_( std::move( filter ) ), scheduler_( std::move( scheduler ) )
+  {}
+
+  // Forward every datagram waiting in `source`, taking up to `burst` at a time into `datagrams`
+  // (and their routes into `routes`). Returns the number of datagrams taken.
+  template<DatagramSource Source>
+  size_t drain( Source& source, std::vector<IPv4View>& datagrams, std::vector<uint32_t>& routes, const size_t burst )
+  {
+    size_t taken = 0;
+    while ( true ) {
+      datagrams.clear();
+      const size_t count = source.maybe_receive_views( datagrams, burst );
+      if ( count == 0 ) {
+        return taken;
+      }
+      taken += count;
+
+      routes.resize( count );
+      lookup_.lookup( datagrams, routes );
+      for ( size_t k = 0; k < count; k++ ) {
+        if ( filter_.permits( datagrams[k] ) ) {
+          scheduler_.forward( datagrams[k], routes[k] );
+        }
+      }
+    }
+  }
+
+  Lookup& lookup() { return lookup_; }
+  Filter& filter() { return filter_; }
+  Scheduler& scheduler() { return scheduler_; }
+};
@@ -0,0 +1,72 @@
+#include "frame_link.hh"
+
+#include <algorithm>
+
+using namespace std;
+
+FrameLink::FrameLink( DatagramSocket&& socket, const size_t burst )
+  : socket_( std::move( socket ) ), burst_( max<size_t>( burst, 1 ) ), rx_buffers_( burst_ )
+{}
+
+void FrameLink::set_burst( const size_t burst )
+{
+  // (buffers added here are empty, and replaced from the pool by the next burst)
+  burst_ = max<size_t>( burst, 1 );
+  rx_buffers_.resize( burst_ );
+}
+
+size_t FrameLink::receiveFrames()
+{
+  // buffers handed on to frames by the last burst are replaced from the pool
+  for ( auto& buffer : rx_buffers_ ) {
+    if ( buffer.capacity() < pool_.buffer_size() ) {
+      buffer = pool_.take();
+    }
+  }
+
+  const size_t received = socket_.recv_batch( rx_buffers_ );
+
+  rx_frames_.clear();
+  for ( size_t i = 0; i < received; i++ ) {
+    EthernetFrame frame;
+    if ( parse( frame, { Buffer { pool_.wrap( std::move( rx_buffers_[i] ) ) } } ) ) {
+      rx_frames_.push_back( std::move( frame ) );
+    }
+  }
+  return received;
+}
+
+size_t FrameLink::receive( AsyncNetworkInterface& interface )
+{
+  const size_t received = receiveFrames();
+  for ( const auto& frame : rx_frames_ ) {
+    interface.recv_frame( frame );
+  }
+  return received;
+}
+
+size_t FrameLink::receive( NetworkInterface& interface, vector<InternetDatagram>& datagrams )
+{
+  const size_t received = receiveFrames();
+  for ( const auto& frame : rx_frames_ ) {
+    if ( auto datagram = interface.recv_frame( frame ) ) {
+      datagrams.push_back( std::move( *datagram ) );
+    }
+  }
+  return received;
+}
+
+size_t FrameLink::transmit( NetworkInterface& interface )
+{
+  if ( unsent_.size() < burst_ ) {
+    tx_frames_.clear();
+    interface.maybe_send_batch( tx_frames_, burst_ - unsent_.size() );
+    for ( const auto& frame : tx_frames_ ) {
+      unsent_.push_back( serialize( frame, pool_ ) );
+    }
+  }
+
+  const size_t sent = socket_.send_batch( unsent_ );
+  unsent_.erase( unsent_.begin(), unsent_.begin() + static_cast<ptrdiff_t>( sent ) );
+  return sent;
+}
@@ -0,0 +1,186 @@
+#pragma once
+
+#include "ethernet_frame.hh"
+#include "network_interface.hh"
+#include "packet_pool.hh"
+#include "packet_ring.hh"
+#include "router.hh"
+#include "socket.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Carries a NetworkInterface's frames over a datagram socket (usually a PacketSocket bound to a
+// device, so that each datagram is one Ethernet frame), a burst at a time.
+//
+// receive() takes up to a burst of frames with one recvmmsg(2) and gives them to recv_frame();
+// transmit() drains up to a burst from maybe_send_batch() and sends them with one sendmmsg(2).
+// Frames are received into buffers from the link's PacketPool, and the datagrams parsed from
+// them keep viewing those buffers, so nothing is copied on the way in and the buffers return to
+// the pool once the datagrams have been forwarded. A FrameLink (like its pool) belongs to the
+// thread that created it.
+class FrameLink
+{
+public:
+  static constexpr size_t DEFAULT_BURST = 32;
+
+  explicit FrameLink( DatagramSocket&& socket, size_t burst = DEFAULT_BURST );
+
+  // Receive up to a burst of frames (waiting for the first, unless the socket is non-blocking),
+  // and give each to `interface`, whose receive ring takes the datagrams among them.
+  // Returns the number of frames received.
+  size_t receive( AsyncNetworkInterface& interface );
+
+  // Same, for a plain NetworkInterface: the datagrams received are appended to `datagrams`
+  size_t receive( NetworkInterface& interface, std::vector<InternetDatagram>& datagrams );
+
+  // Send up to a burst of `interface`'s outgoing frames. Frames that the socket does not take
+  // (a non-blocking socket whose send buffer is full) are kept, and sent first by the next call.
+  // Returns the number of frames sent.
+  size_t transmit( NetworkInterface& interface );
+
+  // Frames waiting to be sent by transmit()
+  size_t unsent() const { return unsent_.size(); }
+
+  // Frames taken (or sent) by one call, at most
+  size_t burst() const { return burst_; }
+
+  // Change the burst (at least 1) from the next call on
+  void set_burst( size_t burst );
+
+  DatagramSocket& socket() { return socket_; }
+
+private:
+  DatagramSocket socket_;
+  size_t burst_;
+  PacketPool pool_ {};
+
+  std::vector<std::string> rx_buffers_;       // filled by recv_batch()
+  std::vector<EthernetFrame> rx_frames_ {};   // ... and parsed
+  std::vector<EthernetFrame> tx_frames_ {};   // drained from the interface
+  std::vector<std::vector<Buffer>> unsent_ {}; // serialized frames not yet sent
+
+  // Receive a burst into rx_frames_ (only the frames that parse); returns the number received
+  size_t receiveFrames();
+};
+
+// Carries a NetworkInterface's frames over a ring shared with the kernel (a PacketRing or an
+// XdpSocket), like FrameLink does over a socket.
+//
+// Received frames are read in place, and only the ones the interface may want (IPv4, IPv6 and ARP) are
+// copied, once, into a pooled buffer: a datagram may be held for a long time (e.g. waiting for
+// ARP), and must not keep the ring's memory from going back to the kernel. Frames to send are
+// serialized straight into the ring.
+template<class Ring>
+class RingLink
+{
+public:
+  explicit RingLink( Ring& ring, size_t burst = FrameLink::DEFAULT_BURST ) : ring_( ring ), burst_( std::max<size_t>( burst, 1 ) ) {}
+
+  // Take every frame that the kernel has handed over, and give them to `interface`.
+  // Returns the number of frames received.
+  size_t receive( AsyncNetworkInterface& interface )
+  {
+    const size_t received = receiveFrames();
+    for ( const auto& frame : rx_frames_ ) {
+      interface.recv_frame( frame );
+    }
+    return received;
+  }
+
+  // Same, for a plain NetworkInterface: the datagrams received are appended to `datagrams`
+  size_t receive( NetworkInterface& interface, std::vector<InternetDatagram>& datagrams )
+  {
+    const size_t received = receiveFrames();
+    for ( const auto& frame : rx_frames_ ) {
+      if ( auto datagram = interface.recv_frame( frame ) ) {
+        datagrams.push_back( std::move( *datagram ) );
+      }
+    }
+    return received;
+  }
+
+  // Queue up to a burst of `interface`'s outgoing frames in the ring, and have the kernel send
+  // them. Frames that do not fit in the ring yet are kept for the next call. Returns the number queued.
+  size_t transmit( NetworkInterface& interface )
+  {
+    if ( unsent_.size() < burst_ ) {
+      tx_frames_.clear();
+      interface.maybe_send_batch( tx_frames_, burst_ - unsent_.size() );
+      for ( const auto& frame : tx_frames_ ) {
+        unsent_.push_back( serialize( frame ) );
+      }
+    }
+
+    size_t queued = 0;
+    while ( queued < unsent_.size() and ring_.send( unsent_[queued] ) ) {
+      queued++;
+    }
+    unsent_.erase( unsent_.begin(), unsent_.begin() + static_cast<ptrdiff_t>( queued ) );
+    ring_.flush();
+    return queued;
+  }
+
+  // Drive `interface` on this link until `stop` is set: receive, send what forwarding threads have
+  // queued with enqueue_send(), transmit, and advance the interface's timers, waiting up to
+  // `idle_wait_ms` for the ring whenever there was nothing to do.
+  void run( AsyncNetworkInterface& interface, const std::atomic<bool>& stop, int idle_wait_ms = 1 )
+  {
+    auto last_tick = std::chrono::steady_clock::now();
+    while ( not stop.load( std::memory_order_relaxed ) ) {
+      const size_t received = receive( interface );
+      const size_t flushed = interface.flush_sends();
+      const size_t sent = transmit( interface );
+
+      const auto now = std::chrono::steady_clock::now();
+      const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>( now - last_tick );
+      if ( elapsed.count() > 0 ) {
+        interface.tick( elapsed.count() );
+        last_tick += elapsed;
+      }
+
+      if ( received == 0 and flushed == 0 and sent == 0 and unsent_.empty() ) {
+        ring_.wait( idle_wait_ms );
+      }
+    }
+  }
+
+  size_t unsent() const { return unsent_.size(); }
+
+private:
+  Ring& ring_;
+  size_t burst_;
+  PacketPool pool_ {};
+  std::vector<EthernetFrame> rx_frames_ {};
+  std::vector<EthernetFrame> tx_frames_ {};
+  std::vector<std::vector<Buffer>> unsent_ {};
+
+  // Parse every frame waiting in the ring into rx_frames_ (only IPv4, IPv6 and ARP); returns the number received
+  size_t receiveFrames()
+  {
+    rx_frames_.clear();
+    return ring_.receive( [this]( const std::string_view bytes ) {
+      // (frames of other types are dropped by recv_frame(), so they are not worth copying)
+      if ( bytes.size() < EthernetHeader::LENGTH ) {
+        return;
+      }
+      const auto type = static_cast<uint16_t>( static_cast<uint8_t>( bytes[12] ) << 8 | static_cast<uint8_t>( bytes[13] ) );
+      if ( type != EthernetHeader::TYPE_IPv4 and type != EthernetHeader::TYPE_IPv6
+           and type != EthernetHeader::TYPE_ARP ) {
+        return;
+      }
+
+      std::string buffer = pool_.take();
+      buffer.assign( bytes );
+      EthernetFrame frame;
+      if ( parse( frame, { Buffer { pool_.wrap( std::move( buffer ) ) } } ) ) {
+        rx_frames_.push_back( std::move( frame ) );
+      }
+    } );
+  }
+};
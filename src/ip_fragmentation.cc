@@ -0,0 +1,276 @@
+#include "ip_fragmentation.hh"
+
+#include <algorithm>
+
+using namespace std;
+
+namespace {
+
+// Largest payload an IPv4 datagram can carry (its total length field is 16 bits)
+constexpr uint32_t MAX_PAYLOAD = UINT16_MAX - IPv4Header::LENGTH;
+
+size_t payload_size( const vector<Buffer>& payload )
+{
+  size_t size = 0;
+  for ( const Buffer& piece : payload ) {
+    size += piece.size();
+  }
+  return size;
+}
+
+// Keep only the first `length` bytes of a payload (dropping e.g. Ethernet padding)
+void truncate_payload( vector<Buffer>& payload, size_t length )
+{
+  size_t kept = 0;
+  while ( kept < payload.size() and length > 0 ) {
+    if ( payload[kept].size() > length ) {
+      payload[kept] = payload[kept].substr( 0, length );
+    }
+    length -= payload[kept].size();
+    kept++;
+  }
+  payload.resize( kept );
+}
+
+} // namespace
+
+bool fragment( const InternetDatagram& dgram, const size_t mtu, vector<InternetDatagram>& out )
+{
+  const size_t chunk = mtu > IPv4Header::LENGTH ? ( mtu - IPv4Header::LENGTH ) & ~size_t { 7 } : 0;
+  if ( dgram.header.df or chunk == 0 ) {
+    return false;
+  }
+
+  const size_t total = payload_size( dgram.payload );
+  const size_t base = static_cast<size_t>( dgram.header.offset ) * 8;
+
+  size_t piece = 0;    // payload buffer the next fragment starts in
+  size_t skip = 0;     // ... and how far into it
+  size_t position = 0; // payload bytes already cut
+  do {
+    const size_t length = min( chunk, total - position );
+
+    InternetDatagram& frag = out.emplace_back();
+    frag.header = dgram.header;
+    frag.header.hlen = IPv4Header::LENGTH / 4;
+    frag.header.len = static_cast<uint16_t>( IPv4Header::LENGTH + length );
+    frag.header.offset = static_cast<uint16_t>( ( base + position ) / 8 );
+    frag.header.mf = position + length < total or dgram.header.mf;
+    frag.header.compute_checksum();
+
+    for ( size_t needed = length; needed > 0; ) {
+      const Buffer& buffer = dgram.payload[piece];
+      const size_t take = min( needed, buffer.size() - skip );
+      frag.payload.push_back( buffer.substr( skip, take ) );
+      needed -= take;
+      skip += take;
+      if ( skip == buffer.size() ) {
+        piece++;
+        skip = 0;
+      }
+    }
+    position += length;
+  } while ( position < total );
+
+  return true;
+}
+
+size_t Reassembler::KeyHash::operator()( const Key& key ) const
+{
+  const uint64_t addresses = ( static_cast<uint64_t>( key.src ) << 32 ) | key.dst;
+  const uint64_t rest = ( static_cast<uint64_t>( key.id ) << 8 ) | key.proto;
+  const uint64_t mixed = ( addresses ^ ( rest * 0x9E37'79B9'7F4A'7C15ULL ) ) * 0xBF58'476D'1CE4'E5B9ULL;
+  return static_cast<size_t>( mixed ^ ( mixed >> 31 ) );
+}
+
+optional<InternetDatagram> Reassembler::add( InternetDatagram&& fragment, const uint64_t now )
+{
+  counters_.add( Counter::FRAGMENTS );
+
+  const IPv4Header& header = fragment.header;
+  const Key key { header.src, header.dst, header.id, header.proto };
+  const auto invalid = [&] {
+    if ( partials_.contains( key ) ) {
+      drop( key, Counter::INVALID );
+    } else {
+      counters_.add( Counter::INVALID );
+    }
+    return optional<InternetDatagram> {};
+  };
+
+  // The fragment's place in the datagram
+  const size_t header_length = static_cast<size_t>( header.hlen ) * 4;
+  if ( header.len < header_length or payload_size( fragment.payload ) < header.len - header_length ) {
+    return invalid();
+  }
+  const auto length = static_cast<uint32_t>( header.len - header_length );
+  const uint32_t begin = static_cast<uint32_t>( header.offset ) * 8;
+  const uint32_t end = begin + length;
+  if ( end > MAX_PAYLOAD or ( header.mf and ( length == 0 or length % 8 != 0 ) ) ) {
+    return invalid();
+  }
+  truncate_payload( fragment.payload, length );
+
+  // Room for it (which may push out other partial datagrams, or this one)
+  const size_t charge = length + FRAGMENT_OVERHEAD;
+  if ( not makeRoom( charge, key ) ) {
+    return {};
+  }
+
+  auto [it, created] = partials_.try_emplace( key );
+  Partial& partial = it->second;
+  if ( created ) {
+    partial.serial = next_serial_++;
+    partial.created = now;
+    order_.emplace_back( key, partial.serial );
+  }
+
+  // Consistency with what has arrived so far
+  if ( partial.pieces.size() >= limits_.max_fragments ) {
+    return invalid();
+  }
+  if ( header.mf ) {
+    if ( partial.total != 0 and end >= partial.total ) {
+      return invalid();
+    }
+  } else {
+    if ( ( partial.total != 0 and partial.total != end )
+         or ( not partial.pieces.empty() and partial.pieces.back().end > end ) ) {
+      return invalid();
+    }
+    partial.total = end;
+  }
+
+  const bool first = begin == 0;
+  bool duplicate = false;
+  if ( not insertPiece( partial, { begin, end, std::move( fragment.payload ) }, duplicate ) ) {
+    return invalid();
+  }
+  if ( duplicate ) {
+    return {};
+  }
+  if ( first ) {
+    partial.first_header = header;
+  }
+  partial.received += length;
+  partial.charged += charge;
+  bytes_ += charge;
+
+  if ( partial.total == 0 or partial.received != partial.total ) {
+    return {};
+  }
+
+  // Complete: the pieces do not overlap, so together they cover the whole payload
+  bytes_ -= partial.charged;
+  InternetDatagram whole = assemble( std::move( partial ) );
+  partials_.erase( it );
+  compactOrder();
+  counters_.add( Counter::REASSEMBLED );
+  return whole;
+}
+
+bool Reassembler::insertPiece( Partial& partial, Piece&& piece, bool& duplicate )
+{
+  auto& pieces = partial.pieces;
+  const auto next = ranges::lower_bound( pieces, piece.begin, {}, &Piece::begin );
+
+  if ( next != pieces.end() and next->begin == piece.begin and next->end == piece.end ) {
+    duplicate = true;
+    return true;
+  }
+  if ( ( next != pieces.begin() and prev( next )->end > piece.begin )
+       or ( next != pieces.end() and next->begin < piece.end ) ) {
+    return false;
+  }
+  pieces.insert( next, std::move( piece ) );
+  return true;
+}
+
+InternetDatagram Reassembler::assemble( Partial&& partial )
+{
+  InternetDatagram whole;
+  whole.header = *partial.first_header;
+  whole.header.hlen = IPv4Header::LENGTH / 4; // (options are not kept)
+  whole.header.len = static_cast<uint16_t>( IPv4Header::LENGTH + partial.total );
+  whole.header.mf = false;
+  whole.header.offset = 0;
+  whole.header.compute_checksum();
+
+  for ( Piece& piece : partial.pieces ) {
+    ranges::move( piece.payload, back_inserter( whole.payload ) );
+  }
+  return whole;
+}
+
+void Reassembler::drop( const Key& key, const Counter reason )
+{
+  const auto it = partials_.find( key );
+  if ( it == partials_.end() ) {
+    return;
+  }
+  bytes_ -= it->second.charged;
+  partials_.erase( it );
+  counters_.add( reason );
+  compactOrder();
+}
+
+bool Reassembler::makeRoom( const size_t charge, const Key& keep )
+{
+  const bool adding = not partials_.contains( keep );
+  while ( bytes_ + charge > limits_.max_bytes or partials_.size() + ( adding ? 1 : 0 ) > limits_.max_datagrams ) {
+    if ( order_.empty() ) {
+      counters_.add( Counter::EVICTIONS ); // (the fragment alone is over the budget)
+      return false;
+    }
+    const auto [key, serial] = order_.front();
+    order_.pop_front();
+
+    const auto it = partials_.find( key );
+    if ( it == partials_.end() or it->second.serial != serial ) {
+      continue;
+    }
+    drop( key, Counter::EVICTIONS );
+    if ( key == keep ) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void Reassembler::expire( const uint64_t now )
+{
+  while ( not order_.empty() ) {
+    const auto [key, serial] = order_.front();
+    const auto it = partials_.find( key );
+    const bool live = it != partials_.end() and it->second.serial == serial;
+    if ( live and it->second.created + limits_.timeout_ms > now ) {
+      return;
+    }
+    order_.pop_front();
+    if ( live ) {
+      drop( key, Counter::TIMEOUTS );
+    }
+  }
+}
+
+void Reassembler::compactOrder()
+{
+  if ( order_.size() <= 2 * partials_.size() + 64 ) {
+    return;
+  }
+  erase_if( order_, [&]( const pair<Key, uint64_t>& entry ) {
+    const auto it = partials_.find( entry.first );
+    return it == partials_.end() or it->second.serial != entry.second;
+  } );
+}
+
+Reassembler::Stats Reassembler::stats() const
+{
+  Stats snapshot {};
+  snapshot.fragments = counters_.sum( Counter::FRAGMENTS );
+  snapshot.reassembled = counters_.sum( Counter::REASSEMBLED );
+  snapshot.timeouts = counters_.sum( Counter::TIMEOUTS );
+  snapshot.evictions = counters_.sum( Counter::EVICTIONS );
+  snapshot.invalid = counters_.sum( Counter::INVALID );
+  return snapshot;
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include "counters.hh"
+#include "ipv4_datagram.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// IPv4 fragmentation and reassembly ([RFC 791](\ref rfc::rfc791), section 3.2).
+//
+// Both directions work on Buffer slices: a fragment's payload is a view of the datagram it
+// was cut from, and a reassembled datagram's payload is the list of its fragments' payloads,
+// so no payload bytes are copied either way.
+
+// Split `dgram` into fragments whose total length (header included) is at most `mtu`, and
+// append them to `out`, in order. A fragment of a fragment keeps its place in the original
+// datagram. Returns false (appending nothing) if the datagram must not be fragmented (DF set)
+// or the MTU leaves no room for 8 bytes of payload.
+bool fragment( const InternetDatagram& dgram, size_t mtu, std::vector<InternetDatagram>& out );
+
+// Reassembles fragmented datagrams, within a memory budget.
+//
+// Fragments are grouped by (source, destination, identification, protocol) and kept in offset
+// order, so adding one is a search and an insertion among the fragments already held. A
+// fragment that repeats one exactly is ignored; one that overlaps others only in part, or that
+// is inconsistent with the datagram's length, discards the whole datagram (as in RFC 5722, so
+// overlapping-fragment attacks get nothing through).
+//
+// A datagram that is not complete within the timeout is dropped, as is the oldest one whenever
+// keeping a new fragment would go over the byte or datagram budget, so a flood of fragments
+// that never complete costs a bounded amount of memory and pushes out only partial datagrams.
+// Held fragments are charged their payload size plus a fixed overhead.
+class Reassembler
+{
+public:
+  struct Limits
+  {
+    size_t max_bytes = 4 << 20;          // charged to held fragments, over all datagrams
+    size_t max_datagrams = 1024;         // partial datagrams held at once
+    size_t max_fragments = 128;          // per datagram
+    uint64_t timeout_ms = 30'000;        // from a datagram's first fragment
+  };
+
+  struct Stats
+  {
+    uint64_t fragments;   // fragments added
+    uint64_t reassembled; // datagrams completed
+    uint64_t timeouts;    // partial datagrams dropped by expire()
+    uint64_t evictions;   // ... dropped to stay within the limits
+    uint64_t invalid;     // ... dropped for overlapping or inconsistent fragments
+  };
+
+  // Charge for a held fragment on top of its payload
+  static constexpr size_t FRAGMENT_OVERHEAD = 64;
+
+  Reassembler() : Reassembler( Limits {} ) {}
+  explicit Reassembler( const Limits& limits ) : limits_( limits ) {}
+
+  // Add a fragment (a datagram with MF set or a nonzero offset) received at `now` (in ms).
+  // Returns the whole datagram once this was its last missing piece.
+  std::optional<InternetDatagram> add( InternetDatagram&& fragment, uint64_t now );
+
+  // Drop the partial datagrams whose timeout has passed at `now`
+  void expire( uint64_t now );
+
+  void set_limits( const Limits& limits ) { limits_ = limits; }
+
+  // Partial datagrams held, and the bytes charged for them
+  size_t datagrams() const { return partials_.size(); }
+  size_t bytes() const { return bytes_; }
+
+  // May be called from any thread
+  Stats stats() const;
+
+private:
+  struct Key
+  {
+    uint32_t src;
+    uint32_t dst;
+    uint16_t id;
+    uint8_t proto;
+
+    bool operator==( const Key& other ) const = default;
+  };
+
+  struct KeyHash
+  {
+    size_t operator()( const Key& key ) const;
+  };
+
+  // Payload bytes [begin, end) of a datagram
+  struct Piece
+  {
+    uint32_t begin;
+    uint32_t end;
+    std::vector<Buffer> payload;
+  };
+
+  struct Partial
+  {
+    uint64_t serial {};   // distinguishes this datagram from earlier ones with the same key
+    uint64_t created {};
+    std::optional<IPv4Header> first_header {}; // from the fragment at offset 0
+    uint32_t total {};    // payload length, once the last fragment has arrived (0 until then)
+    uint32_t received {}; // payload bytes held
+    size_t charged {};
+    std::vector<Piece> pieces {}; // by offset, not overlapping
+  };
+
+  enum class Counter
+  {
+    FRAGMENTS,
+    REASSEMBLED,
+    TIMEOUTS,
+    EVICTIONS,
+    INVALID,
+    COUNT
+  };
+
+  Limits limits_;
+  std::unordered_map<Key, Partial, KeyHash> partials_ {};
+  // Partial datagrams by creation, oldest first (entries of datagrams that are gone are skipped)
+  std::deque<std::pair<Key, uint64_t>> order_ {};
+  uint64_t next_serial_ {};
+  size_t bytes_ {};
+  ShardedCounters<Counter> counters_ {};
+
+  // Insert a piece, or report that it conflicts with those held (true: accepted or a duplicate)
+  static bool insertPiece( Partial& partial, Piece&& piece, bool& duplicate );
+
+  // Finish a complete datagram
+  InternetDatagram assemble( Partial&& partial );
+
+  void drop( const Key& key, Counter reason );
+
+  // Drop the oldest partial datagrams until `charge` more bytes (and, if `keep` is new, one more
+  // datagram) fit. Returns false if the fragment for `keep` cannot be kept (its own datagram
+  // was the oldest, or the fragment alone is over the budget).
+  bool makeRoom( size_t charge, const Key& keep );
+
+  // Forget creation-order entries of datagrams that are gone, once they outnumber the live ones
+  void compactOrder();
+};
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+// A read-mostly value kept as two copies, one for readers and one for the writer (the
+// left-right technique).
+//
+// Readers take a ReadGuard, as with Rcu, and see one copy for as long as they hold it. A writer
+// applies its change to the copy readers are not using, switches readers over to it with an
+// atomic store, waits for the readers of the other copy to drain, and then applies the same
+// change to that one. An update therefore costs the change itself, twice, where an Rcu update
+// first copies the whole value; the price is keeping two copies, and changes that must give
+// the same result on both (they are applied to equal copies, so any deterministic change does).
+//
+// As in Rcu, readers register on one of two counters; a writer parks new readers on the other
+// counter before waiting for one to drain, then waits for the second, so that a reader that was
+// about to register when the copies were switched cannot be left reading the copy being changed.
+// Writers are serialized by a mutex, and wait for readers, so an update must not be made while
+// holding a ReadGuard.
+template<typename T>
+class LeftRight
+{
+  struct alignas( 64 ) ReaderCount
+  {
+    std::atomic<uint64_t> readers { 0 };
+  };
+
+  T copies_[2]; // NOLINT(*-avoid-c-arrays)
+  std::atomic<uint32_t> active_ { 0 };  // the copy readers use
+  std::atomic<uint32_t> counter_ { 0 }; // the counter readers register on
+  mutable ReaderCount counts_[2] {};    // NOLINT(*-avoid-c-arrays)
+  std::mutex writer_ {};
+
+  const T* enter( const uint32_t counter ) const
+  {
+    counts_[counter].readers++;
+    return &copies_[active_.load()];
+  }
+
+  void drain( const uint32_t counter ) const
+  {
+    while ( counts_[counter].readers.load() != 0 ) {
+      std::this_thread::yield();
+    }
+  }
+
+  // Wait until no reader can still be using the copy that was active before the last switch
+  void synchronize()
+  {
+    const uint32_t old_counter = counter_.load();
+    drain( old_counter ^ 1 );
+    counter_.store( old_counter ^ 1 );
+    drain( old_counter );
+  }
+
+  // Make the standby copy the active one, and wait for readers to leave the other
+  T& flip()
+  {
+    const uint32_t standby = active_.load() ^ 1;
+    active_.store( standby );
+    synchronize();
+    return copies_[standby ^ 1];
+  }
+
+public:
+  // A reader's view of one copy of the value
+  class ReadGuard
+  {
+    const LeftRight* lr_;
+    uint32_t counter_;
+    const T* value_;
+
+  public:
+    explicit ReadGuard( const LeftRight& lr )
+      : lr_( &lr ), counter_( lr.counter_.load() ), value_( lr.enter( counter_ ) )
+    {}
+    ~ReadGuard() { lr_->counts_[counter_].readers--; }
+
+    ReadGuard( const ReadGuard& other ) = delete;
+    ReadGuard& operator=( const ReadGuard& other ) = delete;
+    ReadGuard( ReadGuard&& other ) = delete;
+    ReadGuard& operator=( ReadGuard&& other ) = delete;
+
+    const T& operator*() const { return *value_; }
+    const T* operator->() const { return value_; }
+  };
+
+  explicit LeftRight( const T& initial = {} ) : copies_ { initial, initial } {}
+
+  LeftRight( const LeftRight& other ) = delete;
+  LeftRight& operator=( const LeftRight& other ) = delete;
+  LeftRight( LeftRight&& other ) = delete;
+  LeftRight& operator=( LeftRight&& other ) = delete;
+
+  ~LeftRight() = default;
+
+  ReadGuard read() const { return ReadGuard { *this }; }
+
+  // Apply `change` (which returns whether it changed anything) to the standby copy, and if it
+  // did, publish that copy and apply `change` to the other one too. Returns the result of
+  // `change`.
+  template<class F>
+  bool update( F&& change )
+  {
+    const std::lock_guard lock { writer_ };
+
+    if ( not change( copies_[active_.load() ^ 1] ) ) {
+      return false;
+    }
+    change( flip() );
+    return true;
+  }
+
+  // Publish `make( current version )` as the new version (for changes that build a whole new
+  // value, which is then copied into both copies)
+  template<class F>
+  void replace( F&& make )
+  {
+    const std::lock_guard lock { writer_ };
+
+    T& standby = copies_[active_.load() ^ 1];
+    standby = std::forward<F>( make )( std::as_const( copies_[active_.load()] ) );
+    flip() = standby;
+  }
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "ethernet_header.hh"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// On-disk format of a router's saved ARP tables (see Router::save_neighbor_snapshot()).
+//
+// A snapshot is a NeighborSnapshotHeader followed by flat arrays, one element per complete ARP
+// table entry, each starting on an 8-byte boundary, in this order:
+//
+//   entry_interface[num_entries]         uint32_t   the interface whose table held the entry
+//   entry_ip_address[num_entries]        uint32_t
+//   entry_ttl[num_entries]               uint32_t   ms the entry had left when it was saved
+//   entry_ethernet_address[num_entries]  EthernetAddress (6 bytes)
+//
+// Numbers are in host byte order, as in a FIB snapshot (see fib_snapshot.hh). saved_at is the
+// wall-clock time of the save, so that a reader can count the time the router was down against
+// each entry's TTL.
+struct NeighborSnapshotHeader
+{
+  static constexpr std::array<char, 8> MAGIC { 'N', 'L', 'A', 'R', 'P', 'S', 'N', 'P' };
+  static constexpr uint32_t VERSION = 1;
+  static constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+  std::array<char, 8> magic { MAGIC };
+  uint32_t version { VERSION };
+  uint32_t byte_order { BYTE_ORDER_MARK };
+  uint32_t num_interfaces {}; // of the router that saved it
+  uint32_t num_entries {};
+  uint64_t saved_at {}; // ms since the Unix epoch
+};
+
+static_assert( sizeof( NeighborSnapshotHeader ) == 32 );
+static_assert( sizeof( EthernetAddress ) == 6 );
+
+// Where each array of a snapshot starts (byte offsets from the start of the file)
+struct NeighborSnapshotLayout
+{
+  size_t entry_interface, entry_ip_address, entry_ttl, entry_ethernet_address;
+  size_t size; // of the whole file
+
+  explicit constexpr NeighborSnapshotLayout( const NeighborSnapshotHeader& header )
+    : entry_interface( sizeof( NeighborSnapshotHeader ) )
+    , entry_ip_address( after( entry_interface, header.num_entries * sizeof( uint32_t ) ) )
+    , entry_ttl( after( entry_ip_address, header.num_entries * sizeof( uint32_t ) ) )
+    , entry_ethernet_address( after( entry_ttl, header.num_entries * sizeof( uint32_t ) ) )
+    , size( after( entry_ethernet_address, size_t { header.num_entries } * sizeof( EthernetAddress ) ) )
+  {}
+
+private:
+  static constexpr size_t after( const size_t offset, const size_t length ) { return ( offset + length + 7 ) & ~7UL; }
+};
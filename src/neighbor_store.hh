@@ -0,0 +1,284 @@
+#pragma once
+
+#include "ethernet_header.hh"
+#include "huge_pages.hh"
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined( __AVX2__ ) || defined( __SSE2__ )
+#include <immintrin.h>
+#endif
+
+// A neighbor (ARP) table keyed by raw 32-bit IPv4 address, laid out as a structure of arrays.
+//
+// A lookup only reads what it needs: the keys, in groups of eight that fill half a cache line
+// and are compared with the key sought all at once (one AVX2 compare, or two SSE2 compares),
+// each group's occupancy and "complete" bits, next to its keys, and then the Ethernet address
+// of the entry found, from an array of their own. Everything else about an entry (its timers,
+// its queue of datagrams waiting for ARP) is a `State`, kept in a third array that the lookup
+// never touches.
+//
+// Groups are probed linearly from the key's home group. Each group counts the keys that had
+// to be placed past it because it was full (as in F14), so a lookup stops at the first group
+// without the key and without overflow, and an erase needs neither tombstones nor shifting.
+// (A count that saturates is never decremented again, so a lookup also stops once it has
+// probed every group.)
+// The table doubles whenever it becomes three quarters full. A large table's arrays are on huge
+// pages (see HugePageAllocator).
+//
+// Slots returned by find() or insert() are invalidated by any later insert() (erase() leaves
+// other entries where they are).
+//
+// The key may also be another fixed-size address (e.g. an IPv6Address, for an NDP table): its
+// bytes are folded into 32 bits for its home group, and a group's keys are compared one by one.
+template<typename State, typename Key = uint32_t>
+class NeighborStore
+{
+public:
+  static constexpr size_t NONE = SIZE_MAX;
+  static constexpr size_t GROUP_SIZE = 8;
+
+private:
+  struct alignas( 32 ) Group
+  {
+    std::array<Key, GROUP_SIZE> keys {};
+    uint8_t occupied {}; // bit i: keys[i] is in use
+    uint8_t complete {}; // bit i: the entry in slot i has an Ethernet address
+    uint8_t overflow {}; // keys whose probe passed this group (saturates: then never decremented)
+  };
+
+  HugePageVector<Group> groups_ {};
+  HugePageVector<EthernetAddress> ethernet_addresses_ {};
+  HugePageVector<State> states_ {};
+  size_t size_ {};
+  uint8_t bits_ {}; // log2 of the number of groups
+
+  // The key as 32 bits (an IPv4 address is its own; a longer key's 32-bit words are folded together)
+  static uint32_t fold( const Key& key )
+  {
+    if constexpr ( std::is_same_v<Key, uint32_t> ) {
+      return key;
+    } else {
+      static_assert( sizeof( Key ) % sizeof( uint32_t ) == 0 and std::is_trivially_copyable_v<Key> );
+      std::array<uint32_t, sizeof( Key ) / sizeof( uint32_t )> words {};
+      std::memcpy( words.data(), &key, sizeof( Key ) );
+      uint32_t folded = 0;
+      for ( const uint32_t word : words ) {
+        folded = std::rotl( folded, 5 ) ^ word;
+      }
+      return folded;
+    }
+  }
+
+  size_t home( const Key& key ) const
+  {
+    // Fibonacci hashing: the high bits of the product are well mixed (and with no group bits,
+    // every key's home is group 0)
+    return static_cast<size_t>( ( uint64_t { fold( key ) * 0x9E37'79B9U } << bits_ ) >> 32 );
+  }
+
+  size_t mask() const { return groups_.size() - 1; }
+
+  // Bit i set if group.keys[i] == key (occupied or not)
+  static uint32_t matches( const Group& group, const Key& key )
+  {
+    if constexpr ( std::is_same_v<Key, uint32_t> ) {
+#if defined( __AVX2__ )
+      const __m256i keys = _mm256_load_si256( reinterpret_cast<const __m256i*>( group.keys.data() ) ); // NOLINT(*-cast)
+      const __m256i equal = _mm256_cmpeq_epi32( keys, _mm256_set1_epi32( static_cast<int>( key ) ) );
+      return static_cast<uint32_t>( _mm256_movemask_ps( _mm256_castsi256_ps( equal ) ) );
+#elif defined( __SSE2__ )
+      const __m128i wanted = _mm_set1_epi32( static_cast<int>( key ) );
+      const __m128i low = _mm_load_si128( reinterpret_cast<const __m128i*>( group.keys.data() ) );     // NOLINT(*-cast)
+      const __m128i high = _mm_load_si128( reinterpret_cast<const __m128i*>( group.keys.data() + 4 ) ); // NOLINT(*-cast)
+      // (the eight 32-bit results narrowed to eight bytes, for one movemask)
+      const __m128i equal = _mm_packs_epi32( _mm_cmpeq_epi32( low, wanted ), _mm_cmpeq_epi32( high, wanted ) );
+      return static_cast<uint32_t>( _mm_movemask_epi8( _mm_packs_epi16( equal, _mm_setzero_si128() ) ) );
+#endif
+    }
+    uint32_t bits = 0;
+    for ( size_t i = 0; i < GROUP_SIZE; i++ ) {
+      bits |= static_cast<uint32_t>( group.keys[i] == key ) << i;
+    }
+    return bits;
+  }
+
+  void grow()
+  {
+    HugePageVector<Group> old_groups = std::move( groups_ );
+    HugePageVector<EthernetAddress> old_addresses = std::move( ethernet_addresses_ );
+    HugePageVector<State> old_states = std::move( states_ );
+
+    bits_ = old_groups.empty() ? 0 : static_cast<uint8_t>( bits_ + 1 );
+    groups_ = HugePageVector<Group>( size_t { 1 } << bits_ );
+    ethernet_addresses_ = HugePageVector<EthernetAddress>( groups_.size() * GROUP_SIZE );
+    states_ = HugePageVector<State>( groups_.size() * GROUP_SIZE );
+    size_ = 0;
+
+    for ( size_t g = 0; g < old_groups.size(); g++ ) {
+      for ( uint32_t bits = old_groups[g].occupied; bits != 0; bits &= bits - 1 ) {
+        const size_t i = static_cast<size_t>( std::countr_zero( bits ) );
+        const size_t old_slot = g * GROUP_SIZE + i;
+        const size_t slot = place( old_groups[g].keys[i] );
+        states_[slot] = std::move( old_states[old_slot] );
+        if ( old_groups[g].complete & ( 1U << i ) ) {
+          set_complete( slot, old_addresses[old_slot] );
+        }
+      }
+    }
+  }
+
+  // Put a key that is not in the table into the first free slot of its probe sequence. Throws if
+  // there is none (which insert() prevents by growing the table before it is three quarters full).
+  size_t place( const Key& key )
+  {
+    size_t g = home( key );
+    for ( size_t probed = 0; probed < groups_.size(); probed++, g = ( g + 1 ) & mask() ) {
+      Group& group = groups_[g];
+      if ( group.occupied != 0xFF ) {
+        const auto i = static_cast<size_t>( std::countr_one( group.occupied ) );
+        group.keys[i] = key;
+        group.occupied |= static_cast<uint8_t>( 1U << i );
+        size_++;
+        return g * GROUP_SIZE + i;
+      }
+      if ( group.overflow != 0xFF ) {
+        group.overflow++;
+      }
+    }
+    throw std::length_error( "NeighborStore: no free slot" );
+  }
+
+public:
+  // The slot of `key`, or NONE
+  size_t find( const Key& key ) const
+  {
+    if ( groups_.empty() ) {
+      return NONE;
+    }
+    size_t g = home( key );
+    for ( size_t probed = 0; probed < groups_.size(); probed++, g = ( g + 1 ) & mask() ) {
+      const Group& group = groups_[g];
+      const uint32_t hits = matches( group, key ) & group.occupied;
+      if ( hits != 0 ) {
+        return g * GROUP_SIZE + static_cast<size_t>( std::countr_zero( hits ) );
+      }
+      if ( group.overflow == 0 ) {
+        return NONE;
+      }
+    }
+    return NONE;
+  }
+
+  // The Ethernet address of `key`, if its entry is complete, or nullptr: the lookup of the send
+  // path, which reads only keys, group bits and the address
+  const EthernetAddress* find_complete( const Key& key ) const
+  {
+    if ( groups_.empty() ) {
+      return nullptr;
+    }
+    size_t g = home( key );
+    for ( size_t probed = 0; probed < groups_.size(); probed++, g = ( g + 1 ) & mask() ) {
+      const Group& group = groups_[g];
+      const uint32_t hits = matches( group, key ) & group.occupied;
+      if ( hits != 0 ) [[likely]] {
+        // (a key is in only one slot)
+        return hits & group.complete ? &ethernet_addresses_[g * GROUP_SIZE + std::countr_zero( hits )] : nullptr;
+      }
+      if ( group.overflow == 0 ) {
+        return nullptr;
+      }
+    }
+    return nullptr;
+  }
+
+  // The slot of `key` (added, incomplete and with a default-constructed State, if absent), and
+  // whether it was newly inserted
+  std::pair<size_t, bool> insert( const Key& key )
+  {
+    const size_t existing = find( key );
+    if ( existing != NONE ) {
+      return { existing, false };
+    }
+    if ( ( size_ + 1 ) * 4 > groups_.size() * GROUP_SIZE * 3 ) {
+      grow();
+    }
+    return { place( key ), true };
+  }
+
+  // Removes `key`. Returns false if it was not present.
+  bool erase( const Key& key )
+  {
+    const size_t slot = find( key );
+    if ( slot == NONE ) {
+      return false;
+    }
+    const size_t g = slot / GROUP_SIZE;
+    const auto bit = static_cast<uint8_t>( 1U << ( slot % GROUP_SIZE ) );
+    groups_[g].occupied &= ~bit;
+    groups_[g].complete &= ~bit;
+    states_[slot] = State {};
+    size_--;
+
+    // The groups this key's probe passed have one key fewer past them
+    for ( size_t passed = home( key ); passed != g; passed = ( passed + 1 ) & mask() ) {
+      if ( groups_[passed].overflow != 0xFF ) {
+        groups_[passed].overflow--;
+      }
+    }
+    return true;
+  }
+
+  const Key& key( const size_t slot ) const { return groups_[slot / GROUP_SIZE].keys[slot % GROUP_SIZE]; }
+
+  // Whether an entry has an Ethernet address
+  bool complete( const size_t slot ) const
+  {
+    return ( groups_[slot / GROUP_SIZE].complete >> ( slot % GROUP_SIZE ) ) & 1U;
+  }
+
+  // An entry's Ethernet address (meaningful once it is complete)
+  const EthernetAddress& ethernet_address( const size_t slot ) const { return ethernet_addresses_[slot]; }
+
+  // Give an entry its Ethernet address (making it complete), or a new one
+  void set_complete( const size_t slot, const EthernetAddress& address )
+  {
+    ethernet_addresses_[slot] = address;
+    groups_[slot / GROUP_SIZE].complete |= static_cast<uint8_t>( 1U << ( slot % GROUP_SIZE ) );
+  }
+
+  State& state( const size_t slot ) { return states_[slot]; }
+  const State& state( const size_t slot ) const { return states_[slot]; }
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  void clear()
+  {
+    groups_.clear();
+    ethernet_addresses_.clear();
+    states_.clear();
+    size_ = 0;
+    bits_ = 0;
+  }
+
+  // Calls f( key, slot ) for every entry, in no particular order
+  template<typename F>
+  void for_each( F&& f ) const
+  {
+    for ( size_t g = 0; g < groups_.size(); g++ ) {
+      for ( uint32_t bits = groups_[g].occupied; bits != 0; bits &= bits - 1 ) {
+        const size_t i = static_cast<size_t>( std::countr_zero( bits ) );
+        f( groups_[g].keys[i], g * GROUP_SIZE + i );
+      }
+    }
+  }
+};
@@ -0,0 +1,64 @@
+#include "neighbor_table.hh"
+
+using namespace std;
+
+optional<NeighborTable::Entry> NeighborTable::find( const uint32_t ip_address ) const
+{
+  const auto shard = shards_[shardIndex( ip_address )].read();
+  const Entry* entry = shard->find( ip_address );
+  if ( entry == nullptr ) {
+    return {};
+  }
+  return *entry;
+}
+
+bool NeighborTable::learn( const uint32_t ip_address, const EthernetAddress& ethernet_address, const uint32_t view )
+{
+  Rcu<Shard>& shard = shards_[shardIndex( ip_address )];
+
+  // Most learns repeat what is already published (a neighbor refreshing its entry, or a broadcast
+  // heard by every view), and a lookup is much cheaper than an update
+  {
+    const auto current = shard.read();
+    const Entry* entry = current->find( ip_address );
+    if ( entry != nullptr and entry->ethernet_address == ethernet_address ) {
+      return false;
+    }
+  }
+
+  return shard.update( [&]( Shard& next ) {
+    auto [entry, inserted] = next.insert( ip_address );
+    if ( not inserted and entry.ethernet_address == ethernet_address ) {
+      return false;
+    }
+    entry.ethernet_address = ethernet_address;
+    entry.owner = view;
+    return true;
+  } );
+}
+
+bool NeighborTable::withdraw( const uint32_t ip_address, const uint32_t view )
+{
+  Rcu<Shard>& shard = shards_[shardIndex( ip_address )];
+  {
+    const auto current = shard.read();
+    const Entry* entry = current->find( ip_address );
+    if ( entry == nullptr or entry->owner != view ) {
+      return false;
+    }
+  }
+
+  return shard.update( [&]( Shard& next ) {
+    const Entry* entry = next.find( ip_address );
+    return entry != nullptr and entry->owner == view and next.erase( ip_address );
+  } );
+}
+
+size_t NeighborTable::size() const
+{
+  size_t total = 0;
+  for ( const auto& shard : shards_ ) {
+    total += shard.read()->size();
+  }
+  return total;
+}
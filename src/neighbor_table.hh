@@ -0,0 +1,68 @@
+#pragma once
+
+#include "address_map.hh"
+#include "ethernet_header.hh"
+#include "rcu.hh"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+// Neighbors (IP to Ethernet address mappings) shared by the interfaces that face one Ethernet
+// segment, so that a neighbor learned by any of them need not be resolved again by the others.
+//
+// Each interface keeps its own ARP table as a thin view: its pending datagrams, its expiry
+// heap, and a copy of each neighbor it is using. When it has no entry for a next hop, it looks
+// in the shared table before sending an ARP request; what it learns from ARP it publishes to the
+// shared table, and when an entry it published expires unrefreshed it withdraws it.
+//
+// The table is split into shards by a hash of the IP address, each updated by read-copy-update:
+// lookups take no lock (an atomic increment and decrement), and an update copies and republishes
+// only its own shard. Updates are rare next to lookups (an interface publishes only when a
+// neighbor is new or has moved).
+class NeighborTable
+{
+public:
+  static constexpr size_t SHARDS = 64;
+
+  // A published neighbor, and the view (interface) that published it
+  struct Entry
+  {
+    EthernetAddress ethernet_address {};
+    uint32_t owner {};
+  };
+
+  NeighborTable() : shards_() {}
+
+  // A new view id, for an interface that starts to share the table
+  uint32_t attach() { return next_view_.fetch_add( 1, std::memory_order_relaxed ); }
+
+  // The published neighbor for an IP address, if there is one
+  std::optional<Entry> find( uint32_t ip_address ) const;
+
+  // Publish a neighbor learned by `view`, which becomes its owner if it is new or has moved.
+  // Returns false if the table already had that address for it, so nothing was published.
+  bool learn( uint32_t ip_address, const EthernetAddress& ethernet_address, uint32_t view );
+
+  // Withdraw a neighbor, if `view` still owns it (a view that only heard the same address again
+  // does not take it over, so that views hearing the same broadcasts do not keep republishing).
+  // Returns whether it was withdrawn.
+  bool withdraw( uint32_t ip_address, uint32_t view );
+
+  // Neighbors published (an approximate count while views are changing it)
+  size_t size() const;
+
+private:
+  using Shard = AddressMap<Entry>;
+
+  std::array<Rcu<Shard>, SHARDS> shards_;
+  std::atomic<uint32_t> next_view_ { 1 };
+
+  // (a different hash from AddressMap's own, so that the keys of a shard still spread over it)
+  static size_t shardIndex( uint32_t ip_address )
+  {
+    return static_cast<size_t>( ( ip_address * 0x85EB'CA6BU ) >> 26 ) % SHARDS;
+  }
+};
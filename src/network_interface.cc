@@ -1,6 +1,13 @@
 #include "network_interface.hh"
 #include "arp_message.hh"
 #include "ethernet_frame.hh"
+#include "log.hh"
+#include "profile_markers.hh"
+
+#include <algorithm>
+#include <iterator>
+#include <string>
+#include <string_view>
 
 using namespace std;
 
@@ -10,15 +17,36 @@ NetworkInterface::NetworkInterface(const EthernetAddress& ethernet_address,
                                    const Address& ip_address) : 
     ethernet_address_(ethernet_address), 
     ip_address_(ip_address),
-    // Explicitly default-construct the vector members
+    ip_numeric_(ip_address.ipv4_numeric()),
+    // Explicitly default-construct the table and queue members
     ARPTable(),
     ReadyToBeSentQueue(),
-    IPQueues() {
-
-    cerr << "DEBUG: Network interface has Ethernet address ";
-    cerr << to_string(ethernet_address_);
-    cerr << " and IP address ";
-    cerr << ip_address.ip() << "\n";
+    Shaper(),
+    Policer(),
+    current_time(0),
+    ExpiryQueue(),
+    ArpRefreshLead(0),
+    Neighbors(),
+    NeighborView(0),
+    Ipv6Address(),
+    SolicitedNodeEthernet(),
+    NDPTable(),
+    NdpExpiryQueue(),
+    Capture(),
+    Adjacencies(),
+    AdjacencyIndex(),
+    Limits(),
+    PendingPackets(0),
+    PendingBytes(0),
+    ArpRequestLimiter(),
+    Mtu(DEFAULT_MTU),
+    Reassembly(),
+    Counters(),
+    SendLatency(),
+    RecvLatency() {
+
+    LOG_DEBUG("Network interface has Ethernet address ", to_string(ethernet_address_),
+              " and IP address ", LogIpv4{ip_numeric_});
 }
 
 // dgram: the IPv4 datagram to be sent
@@ -29,149 +57,245 @@ NetworkInterface::NetworkInterface(const EthernetAddress& ethernet_address,
 // Address::ipv4_numeric() method.
 void NetworkInterface::send_datagram(const InternetDatagram& dgram, 
                                      const Address& next_hop){
-    int indexARPTable = -999;
-    int foundARPTable = -999;
-    uint32_t next_hop_ip_address = next_hop.ipv4_numeric();
+    send_datagram(dgram, next_hop.ipv4_numeric());
+}
+
+// next_hop_ip_address: the raw 32-bit IP address of the next hop
+template<class Datagram>
+void NetworkInterface::sendDatagram(Datagram&& dgram, 
+                                    const uint32_t next_hop_ip_address){
+
+    // Larger than the MTU: sending it as fragments (each of which fits)
+    if(pendingSize(dgram) > Mtu){
+        sendFragments(dgram, next_hop_ip_address);
+        return;
+    }
+
+    size_t entry = ARPTable.find(next_hop_ip_address);
 
-    isEntryInARPTable(next_hop_ip_address, indexARPTable, foundARPTable);
+    // Entry is not found, but another interface on the segment has already resolved it
+    if(entry == ARPTable.NONE){
+        entry = adoptNeighbor(next_hop_ip_address);
+    }
 
     // Entry is found and complete
-    if(foundARPTable == 2){ 
+    if(entry != ARPTable.NONE && ARPTable.complete(entry)){ 
+        Counters.add(Counter::ARP_HITS);
 
         EthernetFrame frame = makeFrame(ethernet_address_, 
-                                        ARPTable[indexARPTable].mac_address, 
+                                        ARPTable.ethernet_address(entry), 
                                         EthernetHeader::TYPE_IPv4, 
-                                        serialize(dgram));
-
-        ReadyToBeSentQueue.push_back(frame);
+                                        serializeDatagram(std::forward<Datagram>(dgram)));
 
+        queueFrame(std::move(frame));
+        return;
     } 
 
 
-    // Entry is found but incomplete
-    if(foundARPTable == 1){ 
-
-        // If an entry is found in the ARP table but is incomplete,...
-        // ...there must be a corresponding entry in the IP queues
-
-        int indexIPQueues = -999;
-        int foundIPQueues = -999;
-
-        isEntryInIPQueues(next_hop_ip_address, indexIPQueues, foundIPQueues);
-
-        // Sanity check/Error checking
-        if(foundIPQueues != 1){
-            cerr << "ERROR: Entry not found in IP queues but found in ARP table\n";
-            exit(1);
-        }
+    Counters.add(Counter::ARP_MISSES);
 
-        // If we reach here, that means foundIPQueues = 1
+    // Entry is found but incomplete
+    if(entry != ARPTable.NONE){ 
 
-        // Adding the datagram to the corresponding IP queue
-        IPQueues[indexIPQueues].datagrams.push_back(dgram);
+        // Adding the datagram to the entry's IP queue (if the limits allow)
+        addPending(ARPTable.state(entry), std::forward<Datagram>(dgram));
 
         // TODO: Confirm if the following is correct! -> (PS: I think it is correct)
         // Note: I am not updating the TTL of the entry in the...
         // ...ARP table back to 5 seconds
-
+        return;
     }
 
 
     // Entry is not found
-    if(foundARPTable == 0){ 
 
-        // If an entry is not found in the ARP table, then it...
-        // ...must not be found in the IP queues
+    // Adding an incomplete entry and sending an ARP request. Over the ARP request rate limit:
+    // dropping the datagram without creating an entry, so that a later datagram to this next
+    // hop can try again
+    const size_t new_entry = requestArp(next_hop_ip_address);
+    if(new_entry == ARPTable.NONE){
+        countPendingDrop(pendingSize(dgram));
+        return;
+    }
 
-        int indexIPQueues = -999;
-        int foundIPQueues = -999;
+    // Adding the datagram to the entry's IP queue (if the limits allow)
+    addPending(ARPTable.state(new_entry), std::forward<Datagram>(dgram));
+}
 
-        isEntryInIPQueues(next_hop_ip_address, indexIPQueues, foundIPQueues);
+// dgram: a datagram larger than the MTU
+// next_hop_ip_address: the raw IP address of the next hop
+void NetworkInterface::sendFragments(const InternetDatagram& dgram, const uint32_t next_hop_ip_address){
 
-        // Sanity check/Error checking
-        if(foundIPQueues != 0){
-            cerr << "ERROR: Entry found in IP queues but not found in ARP table\n";
-            exit(1);
-        }
+    vector<InternetDatagram> fragments;
+    if(!fragment(dgram, Mtu, fragments)){
+        Counters.add(Counter::FRAGMENTATION_DROPS);
+        return;
+    }
+    Counters.add(Counter::FRAGMENTS_SENT, fragments.size());
 
+    for(InternetDatagram& piece : fragments){
+        sendDatagram(std::move(piece), next_hop_ip_address);
+    }
+}
 
-        // If we reach here, that means foundIPQueues = 0
+// view: a datagram larger than the MTU, as received
+// next_hop_ip_address: the raw IP address of the next hop
+void NetworkInterface::sendFragments(const IPv4View& view, const uint32_t next_hop_ip_address){
+    sendFragments(view.decode(), next_hop_ip_address);
+}
 
+// next_hop_ip_address: the raw IP address of a neighbor with no ARP table entry
+size_t NetworkInterface::requestArp(const uint32_t next_hop_ip_address){
 
-        // Adding an entry to the ARP table
-        // The entry must be an incomplete entry because we don't...
-        // ...know the dest MAC address
-        // The TTL of this entry is set to 5 seconds
-        ARPTableEntry entry;
-        entry.complete_entry = false;
-        entry.ip_address = next_hop_ip_address;
-        entry.mac_address = {}; // Since we don't know the corresponding MAC address
-        entry.ttl = 5000; // 5 seconds
+    if(!ArpRequestLimiter.consume(current_time)){
+        Counters.add(Counter::ARP_REQUESTS_SUPPRESSED);
+        return ARPTable.NONE;
+    }
 
-        ARPTable.push_back(entry);
+    // Adding an entry to the ARP table
+    // The entry must be an incomplete entry because we don't...
+    // ...know the dest MAC address
+    // The TTL of this entry is set to 5 seconds
+    // (it is left without a MAC address, since we don't know it)
+    const size_t new_entry = ARPTable.insert(next_hop_ip_address).first;
+    ARPTable.state(new_entry).ip_address = next_hop_ip_address;
+    setExpiry(new_entry, 5000); // 5 seconds
+
+    // Creating an ARP request
+    ARPMessage arp = makeArp(ARPMessage::OPCODE_REQUEST, 
+                              ethernet_address_, 
+                              ip_numeric_, 
+                              {}, 
+                              next_hop_ip_address);
+
+    // Creating an Ethernet frame for the ARP request
+    EthernetFrame frame = makeFrame(ethernet_address_, 
+                                    ETHERNET_BROADCAST, 
+                                    EthernetHeader::TYPE_ARP, 
+                                    serialize(arp, PacketPool::local()));
+
+
+    // Adding the frame to the ReadyToBeSentQueue
+    queueFrame(std::move(frame));
+    Counters.add(Counter::ARP_REQUESTS_SENT);
+
+    return new_entry;
+}
 
+bool NetworkInterface::resolved(const uint32_t next_hop) const{
+    return ARPTable.find_complete(next_hop) != nullptr;
+}
 
-        // Adding an entry to the IP queues
-        IPQueue ip_queue;
-        ip_queue.ip_address = next_hop_ip_address;
-        ip_queue.datagrams.push_back(dgram);
+bool NetworkInterface::resolve(const uint32_t next_hop){
+    if(ARPTable.find(next_hop) == ARPTable.NONE && adoptNeighbor(next_hop) == ARPTable.NONE){
+        requestArp(next_hop);
+        return false;
+    }
+    return resolved(next_hop);
+}
 
-        IPQueues.push_back(ip_queue);
+void NetworkInterface::send_datagram(const InternetDatagram& dgram, const uint32_t next_hop){
+    LATENCY_SCOPE(SendLatency);
+    PROFILE_SCOPE(send_datagram);
+    sendDatagram(dgram, next_hop);
+}
 
-        // Creating an ARP request
-        ARPMessage arp = makeArp(ARPMessage::OPCODE_REQUEST, 
-                                  ethernet_address_, 
-                                  ip_address_.ipv4_numeric(), 
-                                  {}, 
-                                  next_hop_ip_address);
+void NetworkInterface::send_datagram(InternetDatagram&& dgram, const uint32_t next_hop){
+    LATENCY_SCOPE(SendLatency);
+    PROFILE_SCOPE(send_datagram);
+    sendDatagram(std::move(dgram), next_hop);
+}
 
-        // Creating an Ethernet frame for the ARP request
-        EthernetFrame frame = makeFrame(ethernet_address_, 
-                                        ETHERNET_BROADCAST, 
-                                        EthernetHeader::TYPE_ARP, 
-                                        serialize(arp));
+void NetworkInterface::send_datagram(IPv4View&& view, const uint32_t next_hop){
+    LATENCY_SCOPE(SendLatency);
+    PROFILE_SCOPE(send_datagram);
+    sendDatagram(std::move(view), next_hop);
+}
 
+// next_hop: the raw IP address of the neighbor
+uint32_t NetworkInterface::adjacency(const uint32_t next_hop){
 
-        // TODO: Confirm if the following is correct! -> (PS: I think it is correct)
-        // Adding the frame to the ReadyToBeSentQueue
-        ReadyToBeSentQueue.push_back(frame);
+    auto [index, inserted] = AdjacencyIndex.insert(next_hop);
+    if(!inserted){
+        return index;
+    }
 
+    // New adjacency, resolved straight away if the ARP table already knows the neighbor
+    index = static_cast<uint32_t>(Adjacencies.size());
+    Adjacencies.emplace_back();
+    Adjacencies.back().ip_address = next_hop;
+
+    const size_t entry = ARPTable.find(next_hop);
+    if(entry == ARPTable.NONE){
+        adoptNeighbor(next_hop); // (which resolves the adjacency if it finds the neighbor)
+    } else if(ARPTable.complete(entry)){
+        resolveAdjacency(next_hop, ARPTable.ethernet_address(entry));
     }
+    return index;
+}
 
-    // TODO: You can comment out this error check (Seems like an Overkill)
-    // Sanity check/Error checking
-    if(foundARPTable == 0 || foundARPTable == 1 || foundARPTable == 2){
-        return; // All sucessful
-    } else {
-        cerr << "ERROR: Something went wrong in the send_datagram() function\n";
-        exit(1);
+// dgram: the IPv4 datagram to be sent
+// adjacency_id: an id returned by adjacency()
+template<class Datagram>
+void NetworkInterface::sendToAdjacency(Datagram&& dgram, const uint32_t adjacency_id){
+
+    const Adjacency& adj = Adjacencies.at(adjacency_id);
+
+    // Fast path: the header is already built (and the datagram fits the MTU)
+    if(adj.resolved && pendingSize(dgram) <= Mtu){
+        Counters.add(Counter::ARP_HITS);
+        EthernetFrame frame;
+        frame.header = adj.header;
+        frame.payload = serializeDatagram(std::forward<Datagram>(dgram));
+        queueFrame(std::move(frame));
+        return;
     }
 
+    // Otherwise, going through ARP
+    sendDatagram(std::forward<Datagram>(dgram), adj.ip_address);
+}
+
+void NetworkInterface::send_to_adjacency(const InternetDatagram& dgram, const uint32_t adjacency_id){
+    LATENCY_SCOPE(SendLatency);
+    PROFILE_SCOPE(send_datagram);
+    sendToAdjacency(dgram, adjacency_id);
+}
+
+void NetworkInterface::send_to_adjacency(InternetDatagram&& dgram, const uint32_t adjacency_id){
+    LATENCY_SCOPE(SendLatency);
+    PROFILE_SCOPE(send_datagram);
+    sendToAdjacency(std::move(dgram), adjacency_id);
+}
+
+void NetworkInterface::send_to_adjacency(IPv4View&& view, const uint32_t adjacency_id){
+    LATENCY_SCOPE(SendLatency);
+    PROFILE_SCOPE(send_datagram);
+    sendToAdjacency(std::move(view), adjacency_id);
 }
 
 // frame: the incoming Ethernet frame
 optional<InternetDatagram> NetworkInterface::recv_frame(const EthernetFrame& frame) {
-    
-    // Checking if a frame is destined for this interface or not
-    // A frame is destined for this interface if - 
-    // 1) its destination MAC address matches the interface’s MAC address or 
-    // 2) if it is broadcast to the whole network.
 
-    // If the frame is not destined for this interface, discard it.
-    if( !(frame.header.dst == ethernet_address_ || frame.header.dst == ETHERNET_BROADCAST) ){
+    LATENCY_SCOPE(RecvLatency);
+    PROFILE_SCOPE(recv_frame);
+
+    if(!admitFrame(frame)){
         return {};
     }
 
-    // If we reach here, this means that the frame is destined for this interface
-
     // Checking if the frame contains an IPv4 packet
     if(frame.header.type == EthernetHeader::TYPE_IPv4){
         
         // Parsing the frame to get the datagram
         InternetDatagram dgram;
         if(parse(dgram, frame.payload)){
+            // A fragment addressed to this interface: holding it until the datagram is whole
+            if((dgram.header.mf || dgram.header.offset != 0) && dgram.header.dst == ip_numeric_){
+                return Reassembly.add(std::move(dgram), current_time);
+            }
             return dgram;
         } else {
+            Counters.add(Counter::RX_PARSE_ERRORS);
             return {}; // Parse was unsuccessful
         }
 
@@ -180,236 +304,903 @@ optional<InternetDatagram> NetworkInterface::recv_frame(const EthernetFrame& fra
 
     // Checking if the frame contains an ARP message
     if(frame.header.type == EthernetHeader::TYPE_ARP){
+        recvArp(frame);
+    }
 
-        // Parsing the frame to get the ARP message
-        ARPMessage arp;
-        if(parse(arp, frame.payload)){
+    // Checking if the frame contains an IPv6 packet (only NDP messages are processed here)
+    if(frame.header.type == EthernetHeader::TYPE_IPv6){
+        recvIPv6(frame);
+    }
 
-            EthernetAddress sender_ethernet_address = arp.sender_ethernet_address;
-            uint32_t sender_ip_address = arp.sender_ip_address;
+    return {};
 
-            int indexARPTable = -999;
-            int foundARPTable = -999;
+}
 
-            isEntryInARPTable(sender_ip_address, indexARPTable, foundARPTable);
+// frame: the incoming Ethernet frame (of a router, which forwards what it receives)
+optional<IPv4View> NetworkInterface::recv_frame_view(const EthernetFrame& frame) {
 
-            int indexIPQueues = -999;
-            int foundIPQueues = -999;
+    LATENCY_SCOPE(RecvLatency);
+    PROFILE_SCOPE(recv_frame);
 
-            isEntryInIPQueues(sender_ip_address, indexIPQueues, foundIPQueues);
+    if(!admitFrame(frame)){
+        return {};
+    }
 
-            // STEP 1:
-            // Updating the ARP cache table (and IP queues) based on the ARP message
-            // To be done for both ARP request and ARP response
+    // Checking if the frame contains an IPv4 packet
+    if(frame.header.type == EthernetHeader::TYPE_IPv4){
 
-            // Case: Entry is found and complete
-            if(foundARPTable == 2){
+        // Checking the header where it is, without decoding it
+        optional<IPv4View> view = IPv4View::parse(frame.payload);
+        if(!view.has_value()){
+            Counters.add(Counter::RX_PARSE_ERRORS);
+            return {};
+        }
 
-                // No IP queues to process since no IP queues should exist...
-                // ...in this case i.e. for a complete entry
+        // A fragment addressed to this interface: decoding it, and holding it until the
+        // datagram is whole (which is then passed on as a view of its own)
+        if(view->fragment() && view->dst() == ip_numeric_){
+            optional<InternetDatagram> whole = Reassembly.add(view->decode(), current_time);
+            if(!whole.has_value()){
+                return {};
+            }
+            return IPv4View::of(*whole);
+        }
+        return view;
+    }
 
-                // Sanity check/Error checking
-                if(foundIPQueues != 0){
-                    cerr << "ERROR: Entry found in IP queues\n";
-                    exit(1);
-                }
+    // Checking if the frame contains an ARP message
+    if(frame.header.type == EthernetHeader::TYPE_ARP){
+        recvArp(frame);
+    }
 
-                // If we reach here, that means foundIPQueues = 0
-                
-                // TODO: Confirm this! -> (PS: I think it is correct)
-                // Update the TTL of the entry in the ARP table back to 30 seconds
-                ARPTable[indexARPTable].ttl = 30000;
+    // Checking if the frame contains an IPv6 packet (only NDP messages are processed here)
+    if(frame.header.type == EthernetHeader::TYPE_IPv6){
+        recvIPv6(frame);
+    }
 
-            }
+    return {};
 
+}
 
-            // Case: Entry is found but incomplete
-            if(foundARPTable == 1){
+// frame: a frame that has reached recv_frame() or recv_frame_view()
+// (returns whether it is for this interface, and within the ingress policer's rate)
+bool NetworkInterface::admitFrame(const EthernetFrame& frame) {
 
-                // If an entry is found in the ARP table but is incomplete,...
-                // ...there must be a corresponding entry in the IP queues
+    if(Capture){
+        Capture->capture(frame);
+    }
+    
+    // Checking if a frame is destined for this interface or not
+    // A frame is destined for this interface if - 
+    // 1) its destination MAC address matches the interface’s MAC address or 
+    // 2) if it is broadcast to the whole network.
+
+    // If the frame is not destined for this interface, discard it.
+    // (or 3) if it is a solicitation for the interface's IPv6 address, multicast to its
+    // solicited-node address)
+    const bool solicited_node = Ipv6Address.has_value() && frame.header.dst == SolicitedNodeEthernet;
+    if( !(frame.header.dst == ethernet_address_ || frame.header.dst == ETHERNET_BROADCAST || solicited_node) ){
+        return false;
+    }
+
+    // If we reach here, this means that the frame is destined for this interface
+    const size_t frame_size = EthernetHeader::LENGTH + payloadSize(frame.payload);
+    Counters.add(Counter::RX_FRAMES);
+    Counters.add(Counter::RX_BYTES, frame_size);
+
+    // Over the policer's rate: dropping the frame unread
+    if(!Policer.consume(current_time, min<uint64_t>(frame_size, Policer.burst()))){
+        Counters.add(Counter::POLICER_DROPS);
+        Counters.add(Counter::POLICER_DROPPED_BYTES, frame_size);
+        return false;
+    }
+
+    return true;
+
+}
 
-                // Sanity check/Error checking
-                if(foundIPQueues != 1){
-                    cerr << "ERROR: Entry not found in IP queues but found in ARP table\n";
-                    exit(1);
-                }
+// frame: a received frame (for this interface) that contains an ARP message
+void NetworkInterface::recvArp(const EthernetFrame& frame) {
 
-                // If we reach here, that means foundIPQueues = 1
+    // Parsing the frame to get the ARP message
+    ARPMessage arp;
+    if(parse(arp, frame.payload)){
 
-                // Updating the MAC address of the entry in the ARP table
-                ARPTable[indexARPTable].mac_address = sender_ethernet_address;
-                ARPTable[indexARPTable].complete_entry = true;
-                // Updating the TTL of the entry in the ARP table to 30 seconds from 5 seconds
-                ARPTable[indexARPTable].ttl = 30000;
+        EthernetAddress sender_ethernet_address = arp.sender_ethernet_address;
+        uint32_t sender_ip_address = arp.sender_ip_address;
 
-                // TODO: Confirm if we need to process the IP Queue! -> (PS: I think we need to!)
-                // Processing the IP queue
-                for(int i = 0; i < static_cast<int>(IPQueues[indexIPQueues].datagrams.size()); i++){
+        const size_t entry = ARPTable.find(sender_ip_address);
+        Counters.add(arp.opcode == ARPMessage::OPCODE_REQUEST ? Counter::ARP_REQUESTS_RECEIVED
+                                                              : Counter::ARP_REPLIES_RECEIVED);
 
-                    // Creating an Ethernet frame for the datagram
-                    EthernetFrame new_frame = makeFrame(ethernet_address_, 
-                                                    sender_ethernet_address, 
-                                                    EthernetHeader::TYPE_IPv4, 
-                                                    serialize(IPQueues[indexIPQueues].datagrams[i]));
+        // STEP 1:
+        // Updating the ARP cache table (and IP queues) based on the ARP message
+        // To be done for both ARP request and ARP response
 
-                    // Adding the frame to the ReadyToBeSentQueue
-                    ReadyToBeSentQueue.push_back(new_frame);
+        // Case: An ARP probe (which has no sender IP address yet) or a message claiming our...
+        // ...own IP address: there is nothing to learn
+        if(sender_ip_address == 0 || sender_ip_address == ip_numeric_){
+        }
 
-                }
+        // Case: Entry is found and complete
+        else if(entry != ARPTable.NONE && ARPTable.complete(entry)){
 
-                // Removing the entry from the IP queues
-                IPQueues.erase(IPQueues.begin() + indexIPQueues);
+            // No IP queue to process since a complete entry has no pending datagrams
 
+            // A new Ethernet address (e.g. announced by a gratuitous ARP after a failover)
+            // replaces the old one straight away
+            if(ARPTable.ethernet_address(entry) != sender_ethernet_address){
+                ARPTable.set_complete(entry, sender_ethernet_address);
+                resolveAdjacency(sender_ip_address, sender_ethernet_address);
+                Counters.add(Counter::ARP_ADDRESS_CHANGES);
             }
 
+            // TODO: Confirm this! -> (PS: I think it is correct)
+            // Update the TTL of the entry in the ARP table back to 30 seconds
+            // (which also answers a refresh request, if one is outstanding)
+            setExpiry(entry, 30000);
 
-            // Case: Entry is not found
-            if(foundARPTable == 0){
+        }
 
-                // If an entry is not found in the ARP table, then...
-                // ...no IP queues should exist for that entry
-                // Thus, there should be no IP queues to process
 
-                // Sanity check/Error checking
-                if(foundIPQueues != 0){
-                    cerr << "ERROR: Entry found in IP queues but not in ARP table\n";
-                    exit(1);
-                }
+        // Case: Entry is found but incomplete
+        else if(entry != ARPTable.NONE){
 
-                // If we reach here, that means foundIPQueues = 0
+            // Updating the MAC address of the entry in the ARP table
+            ARPTable.set_complete(entry, sender_ethernet_address);
+            resolveAdjacency(sender_ip_address, sender_ethernet_address);
+            // Updating the TTL of the entry in the ARP table to 30 seconds from 5 seconds
+            setExpiry(entry, 30000);
 
-                // Adding an entry to the ARP table
-                // The entry must be a complete entry because we know the dest MAC address
-                // The TTL of this entry is set to 30 seconds
-                ARPTableEntry entry;
-                entry.complete_entry = true;
-                entry.ip_address = sender_ip_address;
-                entry.mac_address = sender_ethernet_address;
-                entry.ttl = 30000; // 30 seconds
+            // TODO: Confirm if we need to process the IP Queue! -> (PS: I think we need to!)
+            // Processing the IP queue (the queued datagrams are moved into their frames)
+            for(InternetDatagram& pending : ARPTable.state(entry).pending_datagrams){
 
-                ARPTable.push_back(entry);
+                // Creating an Ethernet frame for the datagram
+                EthernetFrame new_frame = makeFrame(ethernet_address_, 
+                                                sender_ethernet_address, 
+                                                EthernetHeader::TYPE_IPv4, 
+                                                serializeDatagram(std::move(pending)));
+
+                // Adding the frame to the ReadyToBeSentQueue
+                queueFrame(std::move(new_frame));
 
             }
 
+            // Emptying the IP queue
+            releasePending(ARPTable.state(entry));
+
+        }
+
 
-            // STEP 2:
+        // Case: Entry is not found
+        else {
 
-            // Note: If this message was an arp response, we have already done...
-            // ...the work of processing it by updating the ARP cache table...
-            // ...(and IP queues) in STEP 1 (above).
+            // Adding an entry to the ARP table
+            // The entry must be a complete entry because we know the dest MAC address
+            // The TTL of this entry is set to 30 seconds
+            const size_t new_entry = ARPTable.insert(sender_ip_address).first;
+            ARPTable.state(new_entry).ip_address = sender_ip_address;
+            ARPTable.set_complete(new_entry, sender_ethernet_address);
+            setExpiry(new_entry, 30000); // 30 seconds
+            resolveAdjacency(sender_ip_address, sender_ethernet_address);
 
-            // If this message was an arp request, we need to send an arp response.
-            // PS: We have done pre-processing in STEP 1 for the arp request...
-            // ...i.e. we have updated the ARP cache table (and IP queues)
+        }
 
-            // Checking if the ARP message is an ARP request
-            if(arp.opcode == ARPMessage::OPCODE_REQUEST){
 
-                // We only need to respond to ARP requests that ask for our IP address
-                if(arp.target_ip_address == ip_address_.ipv4_numeric()){
+        // Publishing what was learned to the other interfaces on the segment (if shared)
+        if(Neighbors && sender_ip_address != 0 && sender_ip_address != ip_numeric_){
+            Neighbors->learn(sender_ip_address, sender_ethernet_address, NeighborView);
+        }
+
 
-                    // Creating an ARP response
-                    ARPMessage arp_response = makeArp(ARPMessage::OPCODE_REPLY, 
-                                                    ethernet_address_, 
-                                                    ip_address_.ipv4_numeric(), 
-                                                    sender_ethernet_address, 
-                                                    sender_ip_address);
+        // STEP 2:
 
-                    // Creating an Ethernet frame for the ARP response
-                    EthernetFrame new_frame = makeFrame(ethernet_address_, 
-                                                    sender_ethernet_address, 
-                                                    EthernetHeader::TYPE_ARP, 
-                                                    serialize(arp_response));
+        // Note: If this message was an arp response, we have already done...
+        // ...the work of processing it by updating the ARP cache table...
+        // ...(and IP queues) in STEP 1 (above).
 
-                    // Adding the frame to the ReadyToBeSentQueue
-                    ReadyToBeSentQueue.push_back(new_frame);
-                }
+        // If this message was an arp request, we need to send an arp response.
+        // PS: We have done pre-processing in STEP 1 for the arp request...
+        // ...i.e. we have updated the ARP cache table (and IP queues)
 
+        // Checking if the ARP message is an ARP request
+        if(arp.opcode == ARPMessage::OPCODE_REQUEST){
+
+            // We only need to respond to ARP requests that ask for our IP address
+            if(arp.target_ip_address == ip_numeric_){
+
+                // Creating an ARP response
+                ARPMessage arp_response = makeArp(ARPMessage::OPCODE_REPLY, 
+                                                ethernet_address_, 
+                                                ip_numeric_, 
+                                                sender_ethernet_address, 
+                                                sender_ip_address);
+
+                // Creating an Ethernet frame for the ARP response
+                EthernetFrame new_frame = makeFrame(ethernet_address_, 
+                                                sender_ethernet_address, 
+                                                EthernetHeader::TYPE_ARP, 
+                                                serialize(arp_response, PacketPool::local()));
+
+                // Adding the frame to the ReadyToBeSentQueue
+                queueFrame(std::move(new_frame));
+                Counters.add(Counter::ARP_REPLIES_SENT);
             }
 
-            return {}; // Successfully processed the arp message
+        }
+
+        return; // Successfully processed the arp message
 
-        } else {
-            return {}; // Parse was unsuccessful
+    } else {
+        Counters.add(Counter::RX_PARSE_ERRORS);
+        return; // Parse was unsuccessful
+    }
+
+
+}
+
+// -- IPv6 --
+
+void NetworkInterface::set_ipv6_address(const IPv6Address& address){
+    Ipv6Address = address;
+    SolicitedNodeEthernet = ethernet_multicast_address(solicited_node_address(address));
+}
+
+// view: an IPv6 datagram, as received
+// next_hop: the IPv6 address of the neighbor to send it to
+void NetworkInterface::send_datagram6(IPv6View&& view, const IPv6Address& next_hop){
+
+    LATENCY_SCOPE(SendLatency);
+    PROFILE_SCOPE(send_datagram);
+
+    // IPv6 datagrams are only fragmented by their source, never on the way
+    if(view.size() > Mtu){
+        Counters.add(Counter::FRAGMENTATION_DROPS);
+        return;
+    }
+
+    size_t entry = NDPTable.find(next_hop);
+
+    // Entry is found and complete
+    if(entry != NDPTable.NONE && NDPTable.complete(entry)){
+        queueFrame(makeFrame(ethernet_address_,
+                             NDPTable.ethernet_address(entry),
+                             EthernetHeader::TYPE_IPv6,
+                             view.release()));
+        return;
+    }
+
+    // Entry is not found: adding an incomplete entry and soliciting the neighbor (dropping the
+    // datagram if that is not possible, as for ARP)
+    if(entry == NDPTable.NONE){
+        entry = requestNdp(next_hop);
+        if(entry == NDPTable.NONE){
+            countPendingDrop(view.size());
+            return;
+        }
+    }
+
+    // Adding the datagram to the entry's IP queue (if the limits allow)
+    addPending(NDPTable.state(entry), std::move(view));
+}
+
+bool NetworkInterface::resolved6(const IPv6Address& next_hop) const{
+    return NDPTable.find_complete(next_hop) != nullptr;
+}
+
+// next_hop: the IPv6 address of a neighbor with no NDP table entry
+size_t NetworkInterface::requestNdp(const IPv6Address& next_hop){
+
+    // (a solicitation needs a source address)
+    if(!Ipv6Address.has_value()){
+        return NDPTable.NONE;
+    }
+    if(!ArpRequestLimiter.consume(current_time)){
+        Counters.add(Counter::ARP_REQUESTS_SUPPRESSED);
+        return NDPTable.NONE;
+    }
+
+    // Adding an incomplete entry, for 5 seconds
+    const size_t new_entry = NDPTable.insert(next_hop).first;
+    NDPTable.state(new_entry).ip_address = next_hop;
+    setNdpExpiry(new_entry, 5000);
+
+    // Soliciting the neighbor at its solicited-node multicast address, with our Ethernet address
+    NDPMessage solicitation;
+    solicitation.type = NDPMessage::TYPE_NEIGHBOR_SOLICITATION;
+    solicitation.target = next_hop;
+    solicitation.link_layer_address = ethernet_address_;
+    const IPv6Address multicast = solicited_node_address(next_hop);
+    sendNdp(std::move(solicitation), multicast, ethernet_multicast_address(multicast));
+    Counters.add(Counter::NDP_SOLICITATIONS_SENT);
+
+    return new_entry;
+}
+
+void NetworkInterface::sendNdp(NDPMessage message, const IPv6Address& dst, const EthernetAddress& ethernet_dst){
+
+    IPv6Datagram dgram;
+    dgram.header.next_header = IPv6Header::NEXT_HEADER_ICMPV6;
+    dgram.header.hop_limit = NDPMessage::HOP_LIMIT;
+    dgram.header.payload_length = static_cast<uint16_t>(message.serialized_length());
+    dgram.header.src = *Ipv6Address;
+    dgram.header.dst = dst;
+    message.compute_checksum(dgram.header);
+    dgram.payload = serialize(message, PacketPool::local());
+
+    queueFrame(makeFrame(ethernet_address_,
+                         ethernet_dst,
+                         EthernetHeader::TYPE_IPv6,
+                         serialize(dgram, PacketPool::local())));
+}
+
+void NetworkInterface::learnNdp(const IPv6Address& ip_address,
+                                const EthernetAddress& ethernet_address,
+                                const bool create){
+
+    size_t entry = NDPTable.find(ip_address);
+    if(entry == NDPTable.NONE){
+        if(!create){
+            return;
         }
+        entry = NDPTable.insert(ip_address).first;
+        NDPTable.state(entry).ip_address = ip_address;
+    }
+
+    // The entry is complete for 30 seconds (a new address replaces the old one)
+    NDPTable.set_complete(entry, ethernet_address);
+    setNdpExpiry(entry, 30000);
+
+    // Sending the datagrams that were waiting for it, as they were received
+    NDPTableEntry& state = NDPTable.state(entry);
+    for(IPv6View& pending : state.pending_datagrams){
+        queueFrame(makeFrame(ethernet_address_,
+                             ethernet_address,
+                             EthernetHeader::TYPE_IPv6,
+                             pending.release()));
+    }
+    releasePending(state);
+}
+
+// frame: a received frame of TYPE_IPv6
+optional<IPv6View> NetworkInterface::recvIPv6(const EthernetFrame& frame){
 
+    optional<IPv6View> view = IPv6View::parse(frame.payload);
+    if(!view.has_value()){
+        Counters.add(Counter::RX_PARSE_ERRORS);
+        return {};
     }
 
+    // Anything but an NDP message (ICMPv6, from a neighbor: no router has decremented its hop
+    // limit) is passed up
+    if(view->next_header() != IPv6Header::NEXT_HEADER_ICMPV6 || view->hop_limit() != NDPMessage::HOP_LIMIT){
+        return view;
+    }
+    const IPv6Datagram dgram = view->decode();
+    string raw;
+    for(const Buffer& piece : dgram.payload){
+        raw.append(string_view{piece});
+    }
+    if(raw.empty() || (static_cast<uint8_t>(raw[0]) != NDPMessage::TYPE_NEIGHBOR_SOLICITATION
+                       && static_cast<uint8_t>(raw[0]) != NDPMessage::TYPE_NEIGHBOR_ADVERTISEMENT)){
+        return view;
+    }
+
+    NDPMessage message;
+    if(!NDPMessage::checksum_ok(dgram.header, raw) || !parse(message, dgram.payload)){
+        Counters.add(Counter::RX_PARSE_ERRORS);
+        return {};
+    }
+
+    // An advertisement: completing the target's entry, if it has one (an advertisement nobody
+    // asked for adds no entry)
+    if(message.type == NDPMessage::TYPE_NEIGHBOR_ADVERTISEMENT){
+        Counters.add(Counter::NDP_ADVERTISEMENTS_RECEIVED);
+        if(message.link_layer_address.has_value()){
+            learnNdp(message.target, *message.link_layer_address, false);
+        }
+        return {};
+    }
+
+    // A solicitation: only those for our own address are answered
+    Counters.add(Counter::NDP_SOLICITATIONS_RECEIVED);
+    if(!Ipv6Address.has_value() || message.target != *Ipv6Address){
+        return {};
+    }
+
+    // Learning the sender (unless it has no address yet, and is checking that ours is free:
+    // then the answer goes to all nodes)
+    const bool unspecified = dgram.header.src == IPv6Address{};
+    if(!unspecified && message.link_layer_address.has_value()){
+        learnNdp(dgram.header.src, *message.link_layer_address, true);
+    }
+
+    NDPMessage advertisement;
+    advertisement.type = NDPMessage::TYPE_NEIGHBOR_ADVERTISEMENT;
+    advertisement.solicited = !unspecified;
+    advertisement.override_address = true;
+    advertisement.target = *Ipv6Address;
+    advertisement.link_layer_address = ethernet_address_;
+    if(unspecified){
+        const IPv6Address all_nodes{0xff, 0x02, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x01};
+        sendNdp(std::move(advertisement), all_nodes, ethernet_multicast_address(all_nodes));
+    } else {
+        sendNdp(std::move(advertisement), dgram.header.src, frame.header.src);
+    }
+    Counters.add(Counter::NDP_ADVERTISEMENTS_SENT);
     return {};
+}
+
+// frame: the incoming Ethernet frame (an IPv6 one, of a router)
+optional<IPv6View> NetworkInterface::recv_frame_view6(const EthernetFrame& frame){
 
+    LATENCY_SCOPE(RecvLatency);
+    PROFILE_SCOPE(recv_frame);
+
+    if(!admitFrame(frame) || frame.header.type != EthernetHeader::TYPE_IPv6){
+        return {};
+    }
+    return recvIPv6(frame);
+}
+
+// Set an NDP table entry to expire `ttl` ms from now
+void NetworkInterface::setNdpExpiry(const size_t slot, const uint64_t ttl){
+
+    NDPTableEntry& entry = NDPTable.state(slot);
+    entry.expiry_time = current_time + ttl;
+    if(entry.scheduled_time == 0 || entry.scheduled_time > entry.expiry_time){
+        entry.scheduled_time = entry.expiry_time;
+        NdpExpiryQueue.push({entry.expiry_time, entry.ip_address});
+    }
 }
 
 // ms_since_last_tick: the number of milliseconds since the last call to this method
 void NetworkInterface::tick(const size_t ms_since_last_tick){
-    
-    // Going through each entry in the ARP table
-    for(int i = 0; i < static_cast<int>(ARPTable.size()); i++){
 
-        // Reducing the TTL of the entry in the ARP table
-        ARPTable[i].ttl -= static_cast<int>(ms_since_last_tick);
+    PROFILE_SCOPE(tick);
+    current_time += ms_since_last_tick;
+    Reassembly.expire(current_time);
 
-        // If the TTL of an entry in the ARP table reaches 0...
-        // ...(or becomes negative), remove the entry
-        if(ARPTable[i].ttl <= 0){
+    // Going through the expiry events that are due (earliest first)
+    while(!ExpiryQueue.empty() && ExpiryQueue.top().time <= current_time){
 
-            // If entry is complete, no need to remove IP queues...
-            // ...since there should be no IP queues for a complete entry
+        const ExpiryEvent event = ExpiryQueue.top();
+        ExpiryQueue.pop();
 
-            // If entry is incomplete, remove the corresponding IP queues...
-            // ...since there should be a corresponding IP queue for an incomplete entry
-            if(!ARPTable[i].complete_entry){
+        const size_t slot = ARPTable.find(event.ip_address);
 
-                int indexIPQueues = -999;
-                int foundIPQueues = -999;
+        // Skipping events of entries that were removed (or removed and re-added) since
+        if(slot == ARPTable.NONE || ARPTable.state(slot).scheduled_time != event.time){
+            continue;
+        }
+        ARPTableEntry* entry = &ARPTable.state(slot);
+
+        // If the TTL of the entry has run out, remove the entry
+        // (an incomplete entry takes its IP queue with it, and a complete one's refresh...
+        // ...request has gone unanswered)
+        if(entry->expiry_time <= current_time){
+            // (withdrawing it from the shared neighbor table too, if this interface published it)
+            if(Neighbors && ARPTable.complete(slot)){
+                Neighbors->withdraw(event.ip_address, NeighborView);
+            }
+            releasePending(*entry);
+            ARPTable.erase(event.ip_address);
+            Counters.add(Counter::EXPIRIES);
+            unresolveAdjacency(event.ip_address);
+            continue;
+        }
 
-                isEntryInIPQueues(ARPTable[i].ip_address, indexIPQueues, foundIPQueues);
+        // A complete entry about to expire: asking the neighbor to confirm its address,...
+        // ...while datagrams keep going out to it
+        if(entry->refresh_time != 0 && entry->refresh_time <= current_time){
+            entry->refresh_time = 0;
+            sendRefresh(slot);
+        }
 
-                // Sanity check/Error checking
-                if(foundIPQueues != 1){
-                    cerr << "ERROR: Entry not found in IP queues\n";
-                    exit(1);
-                }
+        // Otherwise the entry was refreshed after this event was scheduled;
+        // checking it again at its next event
+        entry->scheduled_time = nextEvent(*entry);
+        ExpiryQueue.push({entry->scheduled_time, event.ip_address});
+    }
 
-                // If we reach here, that means foundIPQueues = 1
+    // And through the NDP table's (whose entries only expire)
+    while(!NdpExpiryQueue.empty() && NdpExpiryQueue.top().time <= current_time){
 
-                // Removing the entry from the IP queues
-                IPQueues.erase(IPQueues.begin() + indexIPQueues);
+        const NdpExpiryEvent event = NdpExpiryQueue.top();
+        NdpExpiryQueue.pop();
 
-            }
+        const size_t slot = NDPTable.find(event.ip_address);
+        if(slot == NDPTable.NONE || NDPTable.state(slot).scheduled_time != event.time){
+            continue;
+        }
+        NDPTableEntry& entry = NDPTable.state(slot);
 
-            // Removing the entry from the ARP table
-            ARPTable.erase(ARPTable.begin() + i);
-            i--; // Since we have removed an entry
+        if(entry.expiry_time <= current_time){
+            releasePending(entry);
+            NDPTable.erase(event.ip_address);
+            Counters.add(Counter::NDP_EXPIRIES);
+            continue;
         }
+        entry.scheduled_time = entry.expiry_time;
+        NdpExpiryQueue.push({entry.scheduled_time, event.ip_address});
     }
 
 }
 
+// requests_per_second: average ARP request rate allowed (0: unlimited)
+// burst: the most ARP requests that may be sent back to back
+void NetworkInterface::set_arp_rate_limit(const uint64_t requests_per_second, const uint64_t burst)
+{
+    ArpRequestLimiter = TokenBucket(requests_per_second, burst);
+}
+
+void NetworkInterface::set_egress_scheduler(const EgressScheduler::Config& config)
+{
+    Counters.add(Counter::EGRESS_DROPS, ReadyToBeSentQueue.configure(config));
+}
+
+// bytes_per_second: average egress rate allowed (0: unlimited)
+// burst_bytes: the most bytes that may be sent back to back
+void NetworkInterface::set_egress_shaper(const uint64_t bytes_per_second, const uint64_t burst_bytes)
+{
+    Shaper = TokenBucket(bytes_per_second, burst_bytes);
+}
+
+// bytes_per_second: average ingress rate allowed (0: unlimited)
+// burst_bytes: the most bytes that may be received back to back
+void NetworkInterface::set_ingress_policer(const uint64_t bytes_per_second, const uint64_t burst_bytes)
+{
+    Policer = TokenBucket(bytes_per_second, burst_bytes);
+}
+
+// table: the neighbor table to share (nullptr: none)
+void NetworkInterface::set_neighbor_table(shared_ptr<NeighborTable> table)
+{
+    Neighbors = std::move(table);
+    NeighborView = Neighbors ? Neighbors->attach() : 0;
+}
+
+// ip_address: the raw IP address of a neighbor with no ARP table entry
+size_t NetworkInterface::adoptNeighbor(const uint32_t ip_address)
+{
+    if(!Neighbors){
+        return ARPTable.NONE;
+    }
+    const optional<NeighborTable::Entry> shared = Neighbors->find(ip_address);
+    if(!shared.has_value()){
+        return ARPTable.NONE;
+    }
+
+    // A complete entry with a full TTL, as if this interface had heard the ARP reply itself
+    const size_t entry = ARPTable.insert(ip_address).first;
+    ARPTable.state(entry).ip_address = ip_address;
+    ARPTable.set_complete(entry, shared->ethernet_address);
+    setExpiry(entry, 30000); // 30 seconds
+    resolveAdjacency(ip_address, shared->ethernet_address);
+    Counters.add(Counter::NEIGHBOR_TABLE_HITS);
+    return entry;
+}
+
+vector<NetworkInterface::Neighbor> NetworkInterface::neighbors() const
+{
+    vector<Neighbor> saved;
+    saved.reserve(ARPTable.size());
+    ARPTable.for_each([&](const uint32_t ip_address, const size_t slot){
+        const uint64_t expiry_time = ARPTable.state(slot).expiry_time;
+        if(ARPTable.complete(slot) && expiry_time > current_time){
+            saved.push_back({ip_address, ARPTable.ethernet_address(slot), expiry_time - current_time});
+        }
+    });
+    return saved;
+}
+
+// neighbors: entries saved by neighbors(), maybe of another NetworkInterface object
+void NetworkInterface::restore_neighbors(const span<const Neighbor> neighbors)
+{
+    for(const Neighbor& neighbor : neighbors){
+        if(neighbor.ttl == 0 || ARPTable.find(neighbor.ip_address) != ARPTable.NONE){
+            continue;
+        }
+        const size_t entry = ARPTable.insert(neighbor.ip_address).first;
+        ARPTable.state(entry).ip_address = neighbor.ip_address;
+        ARPTable.set_complete(entry, neighbor.ethernet_address);
+        setExpiry(entry, neighbor.ttl);
+        resolveAdjacency(neighbor.ip_address, neighbor.ethernet_address);
+        Counters.add(Counter::NEIGHBORS_RESTORED);
+
+        // Verifying the entry at the next tick (unless it expires first); its old event is...
+        // ...skipped, as its time is no longer the scheduled one
+        ARPTableEntry& state = ARPTable.state(entry);
+        if(current_time + 1 < state.expiry_time){
+            state.refresh_time = current_time + 1;
+            state.scheduled_time = state.refresh_time;
+            ExpiryQueue.push({state.scheduled_time, neighbor.ip_address});
+        }
+    }
+}
+
+bool NetworkInterface::shaperAllows()
+{
+    if(Shaper.unlimited()){
+        return !ReadyToBeSentQueue.empty();
+    }
+    const size_t size = ReadyToBeSentQueue.next_size();
+    if(size == 0){
+        return false;
+    }
+
+    // (a frame larger than the burst takes a whole burst's worth, so that it is not held forever)
+    if(!Shaper.consume(current_time, min<uint64_t>(size, Shaper.burst()))){
+        Counters.add(Counter::SHAPER_DELAYS);
+        return false;
+    }
+    return true;
+}
+
+// frame: a frame ready to go out (dropped if its class in the ReadyToBeSentQueue is full)
+void NetworkInterface::queueFrame(EthernetFrame&& frame)
+{
+    if(!ReadyToBeSentQueue.push(std::move(frame))){
+        Counters.add(Counter::EGRESS_DROPS);
+    }
+}
+
+// entry: the slot of a complete entry whose refresh is due
+void NetworkInterface::sendRefresh(const size_t entry)
+{
+    if(!ArpRequestLimiter.consume(current_time)){
+        Counters.add(Counter::ARP_REQUESTS_SUPPRESSED);
+        return;
+    }
+
+    // Unicast to the address we already have: only the neighbor itself needs to hear it
+    ARPMessage arp = makeArp(ARPMessage::OPCODE_REQUEST,
+                             ethernet_address_,
+                             ip_numeric_,
+                             {},
+                             ARPTable.key(entry));
+    queueFrame(makeFrame(ethernet_address_,
+                                           ARPTable.ethernet_address(entry),
+                                           EthernetHeader::TYPE_ARP,
+                                           serialize(arp, PacketPool::local())));
+    Counters.add(Counter::ARP_REQUESTS_SENT);
+    Counters.add(Counter::ARP_REFRESHES_SENT);
+}
+
 optional<EthernetFrame> NetworkInterface::maybe_send()
 {   
-    // Check if there are any frames in the ReadyToBeSentQueue
-    if(static_cast<int>(ReadyToBeSentQueue.size()) > 0){
-        
-        // Get the first frame in the ReadyToBeSentQueue
-        EthernetFrame frame = ReadyToBeSentQueue[0];
+    // Check if there is a frame in the ReadyToBeSentQueue that the shaper lets out now
+    if(!shaperAllows()){
+        return {};
+    }
 
-        // Remove the frame from the ReadyToBeSentQueue
-        ReadyToBeSentQueue.erase(ReadyToBeSentQueue.begin());
+    // Take it out of the ReadyToBeSentQueue (moved, not copied)
+    optional<EthernetFrame> frame = ReadyToBeSentQueue.pop();
+    countSent(*frame);
 
-        return frame;
+    return frame;
+
+}
 
+// out: frames are appended to this vector
+// max_frames: the largest number of frames to take out
+size_t NetworkInterface::maybe_send_batch(vector<EthernetFrame>& out, const size_t max_frames)
+{
+    // Move the burst out of the ReadyToBeSentQueue, in the order the scheduler picks...
+    // ...(one frame at a time while the shaper has a say, so that it can stop the burst)
+    const size_t first = out.size();
+    size_t count = 0;
+    if(Shaper.unlimited()){
+        count = ReadyToBeSentQueue.pop_batch(out, max_frames);
     } else {
-        return {};
+        while(count < max_frames && shaperAllows()){
+            out.push_back(std::move(*ReadyToBeSentQueue.pop()));
+            count++;
+        }
     }
+    for(size_t i = first; i < out.size(); i++){
+        countSent(out[i]);
+    }
+
+    return count;
+}
+
+
+NetworkInterface::Stats NetworkInterface::stats() const
+{
+    Stats snapshot {};
+    snapshot.rx_frames = Counters.sum(Counter::RX_FRAMES);
+    snapshot.rx_bytes = Counters.sum(Counter::RX_BYTES);
+    snapshot.rx_parse_errors = Counters.sum(Counter::RX_PARSE_ERRORS);
+    snapshot.tx_frames = Counters.sum(Counter::TX_FRAMES);
+    snapshot.tx_bytes = Counters.sum(Counter::TX_BYTES);
+    snapshot.arp_requests_sent = Counters.sum(Counter::ARP_REQUESTS_SENT);
+    snapshot.arp_replies_sent = Counters.sum(Counter::ARP_REPLIES_SENT);
+    snapshot.arp_requests_received = Counters.sum(Counter::ARP_REQUESTS_RECEIVED);
+    snapshot.arp_replies_received = Counters.sum(Counter::ARP_REPLIES_RECEIVED);
+    snapshot.arp_hits = Counters.sum(Counter::ARP_HITS);
+    snapshot.arp_misses = Counters.sum(Counter::ARP_MISSES);
+    snapshot.pending_high_water = Counters.max(Counter::PENDING_HIGH_WATER);
+    snapshot.expiries = Counters.sum(Counter::EXPIRIES);
+    snapshot.pending_dropped_packets = Counters.sum(Counter::PENDING_DROPPED_PACKETS);
+    snapshot.pending_dropped_bytes = Counters.sum(Counter::PENDING_DROPPED_BYTES);
+    snapshot.arp_requests_suppressed = Counters.sum(Counter::ARP_REQUESTS_SUPPRESSED);
+    snapshot.fragments_sent = Counters.sum(Counter::FRAGMENTS_SENT);
+    snapshot.fragmentation_drops = Counters.sum(Counter::FRAGMENTATION_DROPS);
+    snapshot.arp_refreshes_sent = Counters.sum(Counter::ARP_REFRESHES_SENT);
+    snapshot.arp_address_changes = Counters.sum(Counter::ARP_ADDRESS_CHANGES);
+    snapshot.egress_drops = Counters.sum(Counter::EGRESS_DROPS);
+    snapshot.shaper_delays = Counters.sum(Counter::SHAPER_DELAYS);
+    snapshot.policer_drops = Counters.sum(Counter::POLICER_DROPS);
+    snapshot.policer_dropped_bytes = Counters.sum(Counter::POLICER_DROPPED_BYTES);
+    snapshot.neighbor_table_hits = Counters.sum(Counter::NEIGHBOR_TABLE_HITS);
+    snapshot.neighbors_restored = Counters.sum(Counter::NEIGHBORS_RESTORED);
+    snapshot.ndp_solicitations_sent = Counters.sum(Counter::NDP_SOLICITATIONS_SENT);
+    snapshot.ndp_advertisements_sent = Counters.sum(Counter::NDP_ADVERTISEMENTS_SENT);
+    snapshot.ndp_solicitations_received = Counters.sum(Counter::NDP_SOLICITATIONS_RECEIVED);
+    snapshot.ndp_advertisements_received = Counters.sum(Counter::NDP_ADVERTISEMENTS_RECEIVED);
+    snapshot.ndp_expiries = Counters.sum(Counter::NDP_EXPIRIES);
+    const Reassembler::Stats reassembly = Reassembly.stats();
+    snapshot.fragments_received = reassembly.fragments;
+    snapshot.reassembled = reassembly.reassembled;
+    snapshot.reassembly_drops = reassembly.timeouts + reassembly.evictions + reassembly.invalid;
+    return snapshot;
+}
 
+LatencyHistogram NetworkInterface::send_latency() const
+{
+#ifdef LATENCY_HISTOGRAMS
+    return SendLatency;
+#else
     return {};
+#endif
+}
 
+LatencyHistogram NetworkInterface::recv_latency() const
+{
+#ifdef LATENCY_HISTOGRAMS
+    return RecvLatency;
+#else
+    return {};
+#endif
 }
 
 
 // -- My Helper functions --
 
+void NetworkInterface::countSent(const EthernetFrame& frame)
+{
+    if(Capture){
+        Capture->capture(frame);
+    }
+    Counters.add(Counter::TX_FRAMES);
+    Counters.add(Counter::TX_BYTES, EthernetHeader::LENGTH + payloadSize(frame.payload));
+}
+
+// Serialize a datagram that stays with the caller (its payload buffers are shared)
+vector<Buffer> NetworkInterface::serializeDatagram(const InternetDatagram& dgram)
+{
+    return serialize(dgram, PacketPool::local());
+}
+
+// Serialize a datagram that is being handed off (its payload buffers are moved)
+vector<Buffer> NetworkInterface::serializeDatagram(InternetDatagram&& dgram)
+{
+    Serializer serializer {PacketPool::local()};
+    dgram.serialize_consuming(serializer);
+    return serializer.output();
+}
+
+// Send a received datagram as the bytes it arrived in
+vector<Buffer> NetworkInterface::serializeDatagram(IPv4View&& view)
+{
+    return view.release();
+}
+
+const InternetDatagram& NetworkInterface::pendingDatagram(const InternetDatagram& dgram)
+{
+    return dgram;
+}
+
+InternetDatagram&& NetworkInterface::pendingDatagram(InternetDatagram&& dgram)
+{
+    return std::move(dgram);
+}
+
+InternetDatagram NetworkInterface::pendingDatagram(IPv4View&& view)
+{
+    return view.decode();
+}
+
+// entry: an incomplete entry (of the ARP or the NDP table)
+// dgram: the datagram to queue on it
+template<class Entry, class Datagram>
+void NetworkInterface::addPending(Entry& entry, Datagram&& dgram)
+{
+    const size_t size = pendingSize(dgram);
+    const auto over_limit = [&] {
+        return entry.pending_datagrams.size() + 1 > Limits.max_packets_per_neighbor
+            || entry.pending_bytes + size > Limits.max_bytes_per_neighbor
+            || PendingPackets + 1 > Limits.max_packets
+            || PendingBytes + size > Limits.max_bytes;
+    };
+
+    // Making room by dropping this neighbor's oldest datagrams, if that is the policy
+    if(Limits.policy == DropPolicy::DROP_OLDEST){
+        while(over_limit() && !entry.pending_datagrams.empty()){
+            const size_t oldest = pendingSize(entry.pending_datagrams.front());
+            entry.pending_datagrams.pop_front();
+            entry.pending_bytes -= oldest;
+            PendingPackets--;
+            PendingBytes -= oldest;
+            countPendingDrop(oldest);
+        }
+    }
+
+    // Still no room (or tail drop): dropping the new datagram
+    if(over_limit()){
+        countPendingDrop(size);
+        return;
+    }
+
+    entry.pending_datagrams.push_back(pendingDatagram(std::forward<Datagram>(dgram)));
+    entry.pending_bytes += size;
+    PendingPackets++;
+    PendingBytes += size;
+    Counters.raise(Counter::PENDING_HIGH_WATER, PendingPackets);
+}
+
+template<class Entry>
+void NetworkInterface::releasePending(Entry& entry)
+{
+    PendingPackets -= entry.pending_datagrams.size();
+    PendingBytes -= entry.pending_bytes;
+    entry.pending_datagrams.clear();
+    entry.pending_bytes = 0;
+}
+
+void NetworkInterface::countPendingDrop(const size_t size)
+{
+    Counters.add(Counter::PENDING_DROPPED_PACKETS);
+    Counters.add(Counter::PENDING_DROPPED_BYTES, size);
+}
+
+size_t NetworkInterface::pendingSize(const InternetDatagram& dgram)
+{
+    return IPv4Header::LENGTH + payloadSize(dgram.payload);
+}
+
+size_t NetworkInterface::payloadSize(const vector<Buffer>& payload)
+{
+    size_t size = 0;
+    for(const Buffer& piece : payload){
+        size += piece.size();
+    }
+    return size;
+}
+
+// Fill in the prebuilt header of the adjacency for ip_address, if there is one
+void NetworkInterface::resolveAdjacency(const uint32_t ip_address, const EthernetAddress& mac_address)
+{
+    const uint32_t* index = AdjacencyIndex.find(ip_address);
+    if(index == nullptr){
+        return;
+    }
+    Adjacency& adj = Adjacencies[*index];
+    adj.header = {mac_address, ethernet_address_, EthernetHeader::TYPE_IPv4};
+    adj.resolved = true;
+}
+
+// Mark the adjacency for ip_address (if there is one) as needing ARP again
+void NetworkInterface::unresolveAdjacency(const uint32_t ip_address)
+{
+    const uint32_t* index = AdjacencyIndex.find(ip_address);
+    if(index != nullptr){
+        Adjacencies[*index].resolved = false;
+    }
+}
+
 // Make an ARP message
 ARPMessage NetworkInterface::makeArp( const uint16_t opcode,
                      const EthernetAddress sender_ethernet_address,
@@ -440,63 +1231,24 @@ EthernetFrame NetworkInterface::makeFrame( const EthernetAddress& src,
   return frame;
 }
 
-/***
- * Check if an entry is in the ARP table
- * 
- * Checks if an entry with the corresponding ip_address is in the ARP table
- * 
- * found = 0 - if entry is not found
- * found = 1 - if entry is found but is incomplete
- * found = 2 - if entry is found and is complete
- * 
- * index = index of the entry in the ARP table (if found = 1 or 2)...
- *         ...otherwise, index = -1
- */
-void NetworkInterface::isEntryInARPTable(uint32_t ip_address, int& index, int& found){
-    
-    for(int i = 0; i < static_cast<int>(ARPTable.size()); i++){
-
-        if(ARPTable[i].ip_address == ip_address){
-            index = i; 
-            if(ARPTable[i].complete_entry){
-                found = 2; 
-            } else {
-                found = 1; 
-            }
-            return; 
-        }
+// Set an entry to expire `ttl` ms from now
+void NetworkInterface::setExpiry(const size_t slot, const uint64_t ttl){
+
+    ARPTableEntry& entry = ARPTable.state(slot);
+    entry.expiry_time = current_time + ttl;
+    entry.refresh_time = ARPTable.complete(slot) && ArpRefreshLead != 0 && ArpRefreshLead < ttl
+                       ? entry.expiry_time - ArpRefreshLead
+                       : 0;
+
+    // A new entry needs an event in the expiry queue; an existing entry already has one,...
+    // ...which tick() will reschedule if it comes due before the entry's next event
+    const uint64_t next = nextEvent(entry);
+    if(entry.scheduled_time == 0 || entry.scheduled_time > next){
+        entry.scheduled_time = next;
+        ExpiryQueue.push({next, entry.ip_address});
     }
-
-    // No entry found
-    found = 0;
-    index = -1;
-    
 }
 
-/***
- * Check if an entry is in the IP queues
- * 
- * Checks if an entry with the corresponding ip_address is in the IP queues
- * 
- * found = 0 - if entry is not found
- * found = 1 - if entry is found
- * 
- * index = index of the entry in the IP queues (if found = 1)...
- *         ...otherwise, index = -1
- */
-void NetworkInterface::isEntryInIPQueues(uint32_t ip_address, int& index, int& found){
-    
-    for(int i = 0; i < static_cast<int>(IPQueues.size()); i++){
-
-        if(IPQueues[i].ip_address == ip_address){
-            index = i; 
-            found = 1; 
-            return; 
-        }
-    }
-
-    // No entry found
-    found = 0;
-    index = -1;
-    
-}
\ No newline at end of file
+uint64_t NetworkInterface::nextEvent(const ARPTableEntry& entry){
+    return entry.refresh_time != 0 ? entry.refresh_time : entry.expiry_time;
+}
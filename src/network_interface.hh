@@ -1,16 +1,34 @@
 #pragma once
 
 #include "address.hh"
+#include "address_map.hh"
 #include "ethernet_frame.hh"
 #include "ipv4_datagram.hh"
+#include "ipv4_view.hh"
+#include "ipv6_view.hh"
+#include "ndp_message.hh"
 #include "arp_message.hh"
+#include "counters.hh"
+#include "egress_scheduler.hh"
+#include "ip_fragmentation.hh"
+#include "latency.hh"
+#include "neighbor_store.hh"
+#include "neighbor_table.hh"
+#include "pcap.hh"
+#include "token_bucket.hh"
 
+#include <cstdint>
+#include <deque>
+#include <functional>
 #include <iostream>
 #include <list>
+#include <memory>
 #include <optional>
 #include <queue>
+#include <span>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 
 // A "network interface" that connects IP (the internet layer, or network layer)
@@ -36,6 +54,74 @@
 // and learns or replies as necessary.
 class NetworkInterface
 {
+public:
+  // What to do with a datagram waiting for ARP that would go over a limit
+  enum class DropPolicy
+  {
+    TAIL_DROP,   // drop the new datagram
+    DROP_OLDEST, // drop the oldest datagram waiting for the same neighbor (the new one if there is none)
+  };
+
+  // Limits on datagrams waiting for ARP (all unlimited by default)
+  struct PendingLimits
+  {
+    size_t max_packets_per_neighbor = SIZE_MAX;
+    size_t max_bytes_per_neighbor = SIZE_MAX;
+    size_t max_packets = SIZE_MAX; // for the whole interface
+    size_t max_bytes = SIZE_MAX;   // for the whole interface
+    DropPolicy policy = DropPolicy::TAIL_DROP;
+  };
+
+  // A snapshot of the interface's counters
+  struct Stats
+  {
+    uint64_t rx_frames;                // frames received for this interface
+    uint64_t rx_bytes;
+    uint64_t rx_parse_errors;          // ... that did not parse (e.g. a bad IPv4 checksum)
+    uint64_t tx_frames;                // frames taken out by maybe_send()
+    uint64_t tx_bytes;
+    uint64_t arp_requests_sent;
+    uint64_t arp_replies_sent;
+    uint64_t arp_requests_received;
+    uint64_t arp_replies_received;
+    uint64_t arp_hits;                 // datagrams sent to a neighbor whose address was known
+    uint64_t arp_misses;               // ... and queued (or dropped) waiting for ARP
+    uint64_t pending_high_water;       // most datagrams waiting for ARP at once
+    uint64_t expiries;                 // ARP table entries expired by tick()
+    uint64_t pending_dropped_packets;  // datagrams dropped by the pending limits
+    uint64_t pending_dropped_bytes;    // ... and their size
+    uint64_t arp_requests_suppressed;  // ARP requests not sent because of the rate limit
+    uint64_t fragments_sent;           // fragments made from datagrams larger than the MTU
+    uint64_t fragmentation_drops;      // datagrams larger than the MTU that could not be fragmented (DF set)
+    uint64_t fragments_received;       // fragments of datagrams addressed to this interface
+    uint64_t reassembled;              // ... that were reassembled into whole datagrams
+    uint64_t reassembly_drops;         // partial datagrams dropped (timed out, over the limits, or invalid)
+    uint64_t arp_refreshes_sent;       // unicast ARP requests sent to refresh entries about to expire
+    uint64_t arp_address_changes;      // complete entries whose Ethernet address changed (e.g. gratuitous ARP)
+    uint64_t egress_drops;             // frames dropped because their class of the send queue was full
+    uint64_t shaper_delays;            // times a frame was held back by the egress shaper
+    uint64_t policer_drops;            // frames received over the ingress policer's rate
+    uint64_t policer_dropped_bytes;
+    uint64_t neighbor_table_hits;      // next hops found in the shared neighbor table instead of by ARP
+    uint64_t neighbors_restored;       // ARP table entries added by restore_neighbors()
+    uint64_t ndp_solicitations_sent;   // NDP neighbor solicitations (IPv6's ARP requests)
+    uint64_t ndp_advertisements_sent;  // NDP neighbor advertisements (IPv6's ARP replies)
+    uint64_t ndp_solicitations_received;
+    uint64_t ndp_advertisements_received;
+    uint64_t ndp_expiries;             // NDP table entries expired by tick()
+  };
+
+  // A complete ARP table entry, as saved for a warm restart (see neighbors())
+  struct Neighbor
+  {
+    uint32_t ip_address;
+    EthernetAddress ethernet_address;
+    uint64_t ttl; // ms until the entry expires
+  };
+
+  // Largest datagram sent whole by default (an Ethernet payload)
+  static constexpr size_t DEFAULT_MTU = 1500;
+
 private:
   // Ethernet (known as hardware, network-access, or link-layer) address of the interface
   EthernetAddress ethernet_address_;
@@ -43,37 +129,272 @@ private:
   // IP (known as Internet-layer or network-layer) address of the interface
   Address ip_address_;
 
+  // The same IP address, as a raw 32-bit number (what the ARP code compares against)
+  uint32_t ip_numeric_;
+
   // -- My Data structures --
 
+  // What the ARP table keeps about an entry besides its IP address, whether it is complete (has
+  // a MAC address) and the MAC address itself, which its NeighborStore keeps where the send path
+  // looks them up: only tick() and ARP processing need these
   struct ARPTableEntry
   {
-    // an entry is considered complete if it has both corresponding IP and MAC address
-    bool complete_entry; // true if the entry is complete, false if it is incomplete
-
     uint32_t ip_address;
-    EthernetAddress mac_address;
-    int ttl; // time to live, in milliseconds
+    uint64_t expiry_time; // time (in ms since the interface was created) at which the entry expires
+    uint64_t refresh_time; // time at which to send a refresh request (0: none due)
+    uint64_t scheduled_time; // time of this entry's event in the expiry queue
+
+    // Datagrams waiting for this entry to become complete (empty for a complete entry)
+    std::deque<InternetDatagram> pending_datagrams;
+    size_t pending_bytes; // total size of pending_datagrams
 
     // Default constructor initializes members to safe defaults.
     ARPTableEntry() 
-      : complete_entry(false), ip_address(0), mac_address(), ttl(0) { }
+      : ip_address(0), expiry_time(0), refresh_time(0),
+        scheduled_time(0), pending_datagrams(), pending_bytes(0) { }
   };
 
-  struct IPQueue
+  // An entry in the expiry queue: "check ip_address at time"
+  struct ExpiryEvent
   {
+    uint64_t time;
     uint32_t ip_address;
-    std::vector<InternetDatagram> datagrams;
 
-    // Initialize ip_address to 0 and datagrams as an empty vector.
-    IPQueue() : ip_address(0), datagrams() { }
+    bool operator>(const ExpiryEvent& other) const { return time > other.time; }
   };
 
-  // ARP table
-  std::vector<ARPTableEntry> ARPTable;
-  // Ready-to-be-sent queue
-  std::vector<EthernetFrame> ReadyToBeSentQueue;
-  // List of IP queues
-  std::vector<IPQueue> IPQueues;
+  // ARP table, hashed by IP address, and referred to by slot
+  // (the IP queue of an incomplete entry lives inside the entry's state)
+  NeighborStore<ARPTableEntry> ARPTable;
+  // Ready-to-be-sent queue (FIFO unless another scheduler is set; frames are moved in and out)
+  EgressScheduler ReadyToBeSentQueue;
+
+  // Add a frame to the ReadyToBeSentQueue (counting it if its class is full and it is dropped)
+  void queueFrame(EthernetFrame&& frame);
+
+  // Egress shaper and ingress policer, in bytes (unlimited by default)
+  TokenBucket Shaper;
+  TokenBucket Policer;
+
+  // Whether the next frame in the ReadyToBeSentQueue may go out now (taking its tokens if so)
+  bool shaperAllows();
+
+  // Time elapsed since the interface was created, in milliseconds
+  uint64_t current_time;
+  // Min-heap of ARP table expiry events, so that tick() only visits entries that are due.
+  // Each entry has exactly one live event; refreshing an entry only moves its expiry_time,
+  // and the event is rescheduled when it comes due.
+  std::priority_queue<ExpiryEvent, std::vector<ExpiryEvent>, std::greater<ExpiryEvent>> ExpiryQueue;
+
+  // Set an entry to expire `ttl` ms from now (a complete entry is also set to be refreshed
+  // ArpRefreshLead ms before that, if refreshing is on)
+  void setExpiry(size_t slot, uint64_t ttl);
+
+  // The time of an entry's next event: its refresh if one is due, else its expiry
+  static uint64_t nextEvent(const ARPTableEntry& entry);
+
+  // How long before a complete entry expires to send a refresh request for it (0: never)
+  uint64_t ArpRefreshLead;
+
+  // Send a unicast ARP request to a complete entry's neighbor, so that its reply renews the
+  // entry before it expires (within the ARP request rate limit)
+  void sendRefresh(size_t entry);
+
+  // Neighbors shared with other interfaces on the same segment (none by default), and this
+  // interface's view id in them
+  std::shared_ptr<NeighborTable> Neighbors;
+  uint32_t NeighborView;
+
+  // Add a complete entry for a next hop with no ARP table entry, if the shared neighbor table
+  // knows it (returns its slot, or ARPTable.NONE if not)
+  size_t adoptNeighbor(uint32_t ip_address);
+
+  // -- IPv6 --
+
+  // The interface's IPv6 address, if it has one (see set_ipv6_address()), and the Ethernet
+  // address of its solicited-node multicast address, that solicitations for it are sent to
+  std::optional<IPv6Address> Ipv6Address;
+  EthernetAddress SolicitedNodeEthernet;
+
+  // What the NDP table (IPv6's ARP table) keeps about an entry, as ARPTableEntry does
+  struct NDPTableEntry
+  {
+    IPv6Address ip_address;
+    uint64_t expiry_time;
+    uint64_t scheduled_time;
+
+    // Datagrams waiting for this entry to become complete, as they were received
+    std::deque<IPv6View> pending_datagrams;
+    size_t pending_bytes;
+
+    NDPTableEntry()
+      : ip_address(), expiry_time(0), scheduled_time(0), pending_datagrams(), pending_bytes(0) { }
+  };
+
+  struct NdpExpiryEvent
+  {
+    uint64_t time;
+    IPv6Address ip_address;
+
+    bool operator>(const NdpExpiryEvent& other) const { return time > other.time; }
+  };
+
+  // NDP table, hashed by IPv6 address, with its own expiry queue (entries are not refreshed:
+  // a complete entry expires after 30 s, and the next datagram to it solicits it again)
+  NeighborStore<NDPTableEntry, IPv6Address> NDPTable;
+  std::priority_queue<NdpExpiryEvent, std::vector<NdpExpiryEvent>, std::greater<NdpExpiryEvent>> NdpExpiryQueue;
+
+  // Set an NDP table entry to expire `ttl` ms from now
+  void setNdpExpiry(size_t slot, uint64_t ttl);
+
+  // Start resolving an IPv6 next hop with no NDP table entry: add an incomplete entry and send
+  // a neighbor solicitation for it, unless the rate limit forbids (returns its slot, or NONE)
+  size_t requestNdp(const IPv6Address& next_hop);
+
+  // Learn a neighbor's Ethernet address from NDP, completing its entry (and sending what was
+  // waiting for it) if it has one, or adding a complete entry if `create`
+  void learnNdp(const IPv6Address& ip_address, const EthernetAddress& ethernet_address, bool create);
+
+  // Send an NDP message from this interface's IPv6 address
+  void sendNdp(NDPMessage message, const IPv6Address& dst, const EthernetAddress& ethernet_dst);
+
+  // A received IPv6 datagram: an NDP message is processed (returns none), anything else returned
+  std::optional<IPv6View> recvIPv6(const EthernetFrame& frame);
+
+  // Where frames received and sent are captured (none by default)
+  std::shared_ptr<PcapWriter> Capture;
+
+  // A neighbor that datagrams are sent to (see adjacency())
+  struct Adjacency
+  {
+    uint32_t ip_address;
+    bool resolved; // true while the ARP table has a complete entry for ip_address
+    EthernetHeader header; // prebuilt header for frames to this neighbor (valid when resolved)
+
+    Adjacency() : ip_address(0), resolved(false), header() { }
+  };
+
+  // Adjacency table: entries are never removed, so their ids stay valid
+  std::vector<Adjacency> Adjacencies;
+  // Adjacency ids, hashed by IP address
+  AddressMap<uint32_t> AdjacencyIndex;
+
+  // send_datagram() and send_to_adjacency(), for a datagram that is either copied from (const&)
+  // or moved from (&&) when it has to be queued or serialized
+  template<class Datagram>
+  void sendDatagram(Datagram&& dgram, uint32_t next_hop_ip_address);
+  template<class Datagram>
+  void sendToAdjacency(Datagram&& dgram, uint32_t adjacency_id);
+
+  // Serialize a datagram for an Ethernet frame (moving its payload buffers if it is an rvalue;
+  // a view is sent as the bytes it was received in)
+  static std::vector<Buffer> serializeDatagram(const InternetDatagram& dgram);
+  static std::vector<Buffer> serializeDatagram(InternetDatagram&& dgram);
+  static std::vector<Buffer> serializeDatagram(IPv4View&& view);
+
+  // A datagram to be queued for ARP (a view is decoded)
+  static const InternetDatagram& pendingDatagram(const InternetDatagram& dgram);
+  static InternetDatagram&& pendingDatagram(InternetDatagram&& dgram);
+  static InternetDatagram pendingDatagram(IPv4View&& view);
+  static IPv6View&& pendingDatagram(IPv6View&& view) { return std::move(view); }
+
+  // Limits on datagrams waiting for ARP, and how much is waiting on the whole interface
+  PendingLimits Limits;
+  size_t PendingPackets;
+  size_t PendingBytes;
+
+  // Rate limit on ARP requests
+  TokenBucket ArpRequestLimiter;
+
+  // Largest datagram sent whole (larger ones are fragmented)
+  size_t Mtu;
+  // Fragments of datagrams addressed to this interface, waiting for the rest
+  Reassembler Reassembly;
+
+  // Send a datagram larger than the MTU as fragments (its payload is sliced, not copied)
+  void sendFragments(const InternetDatagram& dgram, uint32_t next_hop_ip_address);
+  void sendFragments(const IPv4View& view, uint32_t next_hop_ip_address);
+
+  // What recv_frame() and recv_frame_view() do first: capture the frame, and count it if it is for
+  // this interface. Returns false if it is not, or if the ingress policer drops it.
+  bool admitFrame(const EthernetFrame& frame);
+
+  // Learn from a received ARP message, and answer it if it is a request for this interface
+  void recvArp(const EthernetFrame& frame);
+
+  enum class Counter
+  {
+    RX_FRAMES,
+    RX_BYTES,
+    RX_PARSE_ERRORS,
+    TX_FRAMES,
+    TX_BYTES,
+    ARP_REQUESTS_SENT,
+    ARP_REPLIES_SENT,
+    ARP_REQUESTS_RECEIVED,
+    ARP_REPLIES_RECEIVED,
+    ARP_HITS,
+    ARP_MISSES,
+    PENDING_HIGH_WATER,
+    EXPIRIES,
+    PENDING_DROPPED_PACKETS,
+    PENDING_DROPPED_BYTES,
+    ARP_REQUESTS_SUPPRESSED,
+    FRAGMENTS_SENT,
+    FRAGMENTATION_DROPS,
+    ARP_REFRESHES_SENT,
+    ARP_ADDRESS_CHANGES,
+    EGRESS_DROPS,
+    SHAPER_DELAYS,
+    POLICER_DROPS,
+    POLICER_DROPPED_BYTES,
+    NEIGHBOR_TABLE_HITS,
+    NEIGHBORS_RESTORED,
+    NDP_SOLICITATIONS_SENT,
+    NDP_ADVERTISEMENTS_SENT,
+    NDP_SOLICITATIONS_RECEIVED,
+    NDP_ADVERTISEMENTS_RECEIVED,
+    NDP_EXPIRIES,
+    COUNT
+  };
+  ShardedCounters<Counter> Counters;
+
+  // Time spent in send_datagram() (and send_to_adjacency()) and recv_frame(), per call
+  // (empty unless built with LATENCY_HISTOGRAMS)
+  [[no_unique_address]] LatencyRecorder SendLatency;
+  [[no_unique_address]] LatencyRecorder RecvLatency;
+
+  // Count (and capture, if capturing) a frame handed out by maybe_send()
+  void countSent(const EthernetFrame& frame);
+
+  // Queue a datagram on an incomplete entry, within the pending limits (it may be dropped,
+  // or make room by dropping older ones)
+  // (or on an incomplete NDP table entry)
+  template<class Entry, class Datagram>
+  void addPending(Entry& entry, Datagram&& dgram);
+
+  // Forget an entry's pending datagrams (they have been sent or dropped)
+  template<class Entry>
+  void releasePending(Entry& entry);
+
+  // Count a datagram dropped by the pending limits
+  void countPendingDrop(size_t size);
+
+  // Bytes a pending datagram counts for (header plus payload)
+  static size_t pendingSize(const InternetDatagram& dgram);
+  static size_t pendingSize(const IPv4View& view) { return view.size(); }
+  static size_t pendingSize(const IPv6View& view) { return view.size(); }
+
+  // Total size of a list of buffers
+  static size_t payloadSize(const std::vector<Buffer>& payload);
+
+  // Start resolving a next hop that has no ARP table entry: add an incomplete entry and send an
+  // ARP request for it, unless the rate limit forbids (returns its slot, or ARPTable.NONE)
+  size_t requestArp(uint32_t next_hop_ip_address);
+
+  // Keep the adjacency for an IP address (if there is one) in step with the ARP table
+  void resolveAdjacency(uint32_t ip_address, const EthernetAddress& mac_address);
+  void unresolveAdjacency(uint32_t ip_address);
 
 public:
   // Construct a network interface with given Ethernet (network-access-layer) and IP (internet-layer)
@@ -83,6 +404,11 @@ public:
   // Access queue of Ethernet frames awaiting transmission
   std::optional<EthernetFrame> maybe_send();
 
+  // Move up to `max_frames` frames awaiting transmission to the end of `out`, in the order the
+  // egress scheduler picks (oldest first by default), so a driver loop can pull a whole burst in
+  // one call. Returns the number of frames moved.
+  size_t maybe_send_batch( std::vector<EthernetFrame>& out, size_t max_frames = SIZE_MAX );
+
   // Sends an IPv4 datagram, encapsulated in an Ethernet frame (if it knows the Ethernet destination
   // address). Will need to use [ARP](\ref rfc::rfc826) to look up the Ethernet destination address
   // for the next hop.
@@ -90,15 +416,141 @@ public:
   // but please consider the frame sent as soon as it is generated.)
   void send_datagram( const InternetDatagram& dgram, const Address& next_hop );
 
+  // Same, with the next hop as a raw 32-bit IPv4 address (no Address to construct and unpack)
+  void send_datagram( const InternetDatagram& dgram, uint32_t next_hop );
+
+  // Same, taking ownership of the datagram: it is moved (never copied) into the ARP queue or
+  // into the frame, so its payload buffers are handed on without touching their refcounts
+  void send_datagram( InternetDatagram&& dgram, uint32_t next_hop );
+
+  // Same, for a datagram received by recv_frame_view(): its bytes become the frame's payload
+  // as they are (it is decoded only if it has to be fragmented, or wait for ARP)
+  void send_datagram( IPv4View&& view, uint32_t next_hop );
+
+  // Sends an IPv6 datagram received by recv_frame_view6() to a next hop, resolving its Ethernet
+  // address with [NDP](\ref rfc::rfc4861) as ARP does for IPv4 (a datagram waits for the
+  // neighbor's advertisement within the same pending limits, and solicitations share the ARP
+  // request rate limit). IPv6 datagrams are never fragmented: one larger than the MTU is dropped
+  // (and counted in fragmentation_drops). Needs an IPv6 address (set_ipv6_address()) to solicit from.
+  void send_datagram6( IPv6View&& view, const IPv6Address& next_hop );
+
+  // Whether the Ethernet address of an IPv6 next hop is known
+  bool resolved6( const IPv6Address& next_hop ) const;
+
+  // Marker for "no adjacency"
+  static constexpr uint32_t NO_ADJACENCY = UINT32_MAX;
+
+  // The id of the adjacency (neighbor entry) for a next hop, created if needed. An adjacency
+  // follows the ARP table: while the next hop's Ethernet address is known, it holds a prebuilt
+  // Ethernet header for it, so that sending through it needs no ARP table lookup. Ids stay
+  // valid for the life of the interface.
+  uint32_t adjacency( uint32_t next_hop );
+
+  // Sends a datagram to the next hop of an adjacency (same as send_datagram to that next hop)
+  void send_to_adjacency( const InternetDatagram& dgram, uint32_t adjacency_id );
+  void send_to_adjacency( InternetDatagram&& dgram, uint32_t adjacency_id );
+  void send_to_adjacency( IPv4View&& view, uint32_t adjacency_id );
+
+  // Whether the Ethernet address of a next hop is known (so a datagram sent to it goes out at once)
+  bool resolved( uint32_t next_hop ) const;
+
+  // Start resolving a next hop without sending anything to it: sends an ARP request (within the
+  // rate limit) unless one is already outstanding. Returns resolved( next_hop ).
+  bool resolve( uint32_t next_hop );
+
   // Receives an Ethernet frame and responds appropriately.
   // If type is IPv4, returns the datagram.
   // If type is ARP request, learn a mapping from the "sender" fields, and send an ARP reply.
   // If type is ARP reply, learn a mapping from the "sender" fields.
+  // (Either may be gratuitous, announcing a new Ethernet address for a known neighbor, which
+  // replaces the old one. ARP probes, whose sender IP address is 0, are answered but not learned,
+  // and neither is a message claiming the interface's own IP address.)
   std::optional<InternetDatagram> recv_frame( const EthernetFrame& frame );
 
+  // Same, for a router: an IPv4 datagram is not decoded but returned as a view of the frame's
+  // bytes, its header checked where it is, to be forwarded as it is (see IPv4View). Fragments
+  // addressed to this interface are still reassembled first.
+  std::optional<IPv4View> recv_frame_view( const EthernetFrame& frame );
+
+  // Same, for an IPv6 frame: answers neighbor solicitations for the interface's IPv6 address and
+  // learns from advertisements, and returns any other IPv6 datagram as a view of its bytes.
+  // (recv_frame() and recv_frame_view() process NDP messages too, and drop other IPv6 datagrams.)
+  std::optional<IPv6View> recv_frame_view6( const EthernetFrame& frame );
+
   // Called periodically when time elapses
   void tick( size_t ms_since_last_tick );
 
+  // Give the interface an IPv6 address, which it answers neighbor solicitations for (and
+  // accepts frames to its solicited-node multicast address for), and solicits neighbors from
+  void set_ipv6_address( const IPv6Address& address );
+  const std::optional<IPv6Address>& ipv6_address() const { return Ipv6Address; }
+
+  // Limit the datagrams that may wait for ARP (applies to datagrams queued from now on)
+  void set_pending_limits( const PendingLimits& limits ) { Limits = limits; }
+
+  // Allow at most `requests_per_second` ARP requests on average, in bursts of at most `burst`
+  // (0 requests per second: unlimited, the default). A datagram to an unknown next hop that
+  // cannot send its ARP request is dropped, so that a later one can try again.
+  void set_arp_rate_limit( uint64_t requests_per_second, uint64_t burst );
+
+  // Refresh complete ARP table entries `lead_ms` before they expire (0: never, the default).
+  // A unicast ARP request goes to the neighbor's known Ethernet address while datagrams keep
+  // going out to it; its reply renews the entry, and only an unanswered refresh lets the entry
+  // expire, so a busy neighbor is never stalled behind a broadcast ARP round trip.
+  void set_arp_refresh( uint64_t lead_ms ) { ArpRefreshLead = lead_ms; }
+
+  // Choose the order frames leave in (see EgressScheduler), and limits on each class of frame
+  // waiting to be sent. Frames already waiting are queued again under the new configuration.
+  void set_egress_scheduler( const EgressScheduler::Config& config );
+  const EgressScheduler& egress_scheduler() const { return ReadyToBeSentQueue; }
+
+  // Send at most `bytes_per_second` on average (Ethernet headers included), in bursts of at most
+  // `burst_bytes` (0 bytes per second: unlimited, the default). Frames over the rate wait in the
+  // send queue, and maybe_send() holds them back until tick() has let enough time pass.
+  void set_egress_shaper( uint64_t bytes_per_second, uint64_t burst_bytes );
+
+  // Accept at most `bytes_per_second` of received frames on average, in bursts of at most
+  // `burst_bytes` (0 bytes per second: unlimited, the default); recv_frame() drops the rest.
+  void set_ingress_policer( uint64_t bytes_per_second, uint64_t burst_bytes );
+
+  // Share neighbors with the other interfaces given the same table (those facing the same
+  // Ethernet segment), or stop sharing (nullptr). A next hop this interface has no ARP table
+  // entry for is looked up in the table before an ARP request is sent, and what the interface
+  // learns from ARP it publishes there; the table may be shared across threads.
+  void set_neighbor_table( std::shared_ptr<NeighborTable> table );
+  const std::shared_ptr<NeighborTable>& neighbor_table() const { return Neighbors; }
+
+  // The complete ARP table entries, with the time each has left (in no particular order)
+  std::vector<Neighbor> neighbors() const;
+
+  // Add complete ARP table entries saved by neighbors() (e.g. before a restart), each expiring
+  // when its TTL runs out. A restored entry is used at once, but starts out unverified: the next
+  // tick() sends its neighbor a unicast ARP request (as a refresh does, see set_arp_refresh()),
+  // whose reply renews it, so that a neighbor that has gone or moved is not kept for a whole
+  // TTL. Neighbors the table already has an entry for, and entries with no time left, are skipped.
+  void restore_neighbors(std::span<const Neighbor> neighbors);
+
+  // Capture every frame that reaches recv_frame() (whoever it is addressed to) and every frame
+  // taken out by maybe_send() or maybe_send_batch() into `writer`, or stop capturing (nullptr).
+  // The writer may be shared by several interfaces.
+  void set_capture( std::shared_ptr<PcapWriter> writer ) { Capture = std::move( writer ); }
+
+  // Send datagrams of more than `mtu` bytes (header included) as fragments of at most that size
+  void set_mtu( size_t mtu ) { Mtu = mtu; }
+  size_t mtu() const { return Mtu; }
+
+  // Limits on the memory and time spent reassembling fragments addressed to this interface.
+  // Fragments addressed elsewhere (e.g. to be forwarded by a router) are passed up as they are.
+  void set_reassembly_limits( const Reassembler::Limits& limits ) { Reassembly.set_limits( limits ); }
+
+  // May be called from any thread
+  Stats stats() const;
+
+  // Snapshots of the send_datagram() and recv_frame() latency histograms (empty unless built
+  // with LATENCY_HISTOGRAMS); may be called from any thread
+  LatencyHistogram send_latency() const;
+  LatencyHistogram recv_latency() const;
+
   // -- My Helper Functions --
 
   // Make an ARP message
@@ -114,32 +566,6 @@ public:
         const uint16_t type, 
         std::vector<Buffer> payload );
 
-  /***
-  * Check if an entry is in the ARP table
-  * 
-  * Checks if an entry with the corresponding ip_address is in the ARP table
-  * 
-  * found = 0 - if entry is not found
-  * found = 1 - if entry is found but is incomplete
-  * found = 2 - if entry is found and is complete
-  * 
-  * index = index of the entry in the ARP table (if found = 1 or 2)...
-  *         ...otherwise, index = -1
-  */
-  void isEntryInARPTable(uint32_t ip_address, int& index, int& found);
-
-  /***
-  * Check if an entry is in the IP queues
-  * 
-  * Checks if an entry with the corresponding ip_address is in the IP queues
-  * 
-  * found = 0 - if entry is not found
-  * found = 1 - if entry is found
-  * 
-  * index = index of the entry in the IP queues (if found = 1)...
-  *         ...otherwise, index = -1
-  */
-  void isEntryInIPQueues(uint32_t ip_address, int& index, int& found);
 
 };
 
@@ -0,0 +1,73 @@
+#include "packet_sampler.hh"
+
+#include <utility>
+
+using namespace std;
+
+PacketSampler::PacketSampler( const size_t sources,
+                              const size_t ring_capacity,
+                              Exporter exporter,
+                              const chrono::milliseconds poll_interval )
+  : exporter_( std::move( exporter ) ), ring_capacity_( ring_capacity ), poll_interval_( poll_interval )
+{
+  for ( size_t i = 0; i < sources; i++ ) {
+    sources_.push_back( make_unique<Source>( ring_capacity_ ) );
+  }
+  thread_ = jthread { [this]( const stop_token& stop ) { run( stop ); } };
+}
+
+void PacketSampler::add_source()
+{
+  const lock_guard lock { sources_mutex_ };
+  sources_.push_back( make_unique<Source>( ring_capacity_ ) );
+}
+
+size_t PacketSampler::drain( vector<PacketSample>& batch )
+{
+  const lock_guard lock { sources_mutex_ };
+  size_t total = 0;
+  for ( const auto& source : sources_ ) {
+    if ( source->ring.pop_batch( batch, EXPORT_BATCH ) != 0 ) {
+      exporter_( batch );
+      exported_.fetch_add( batch.size(), memory_order_relaxed );
+      total += batch.size();
+      batch.clear();
+    }
+  }
+  return total;
+}
+
+void PacketSampler::run( const stop_token& stop )
+{
+  vector<PacketSample> batch;
+  batch.reserve( EXPORT_BATCH );
+  while ( not stop.stop_requested() ) {
+    if ( drain( batch ) == 0 ) {
+      this_thread::sleep_for( poll_interval_ );
+    }
+  }
+  // (what was submitted before the stop)
+  while ( drain( batch ) != 0 ) {}
+}
+
+void PacketSampler::stop()
+{
+  if ( thread_.joinable() ) {
+    thread_.request_stop();
+    thread_.join();
+  }
+}
+
+PacketSampler::Stats PacketSampler::stats() const
+{
+  Stats stats {};
+  {
+    const lock_guard lock { sources_mutex_ };
+    for ( const auto& source : sources_ ) {
+      stats.sampled += source->sampled.load( memory_order_relaxed );
+      stats.dropped += source->dropped.load( memory_order_relaxed );
+    }
+  }
+  stats.exported = exported_.load( memory_order_relaxed );
+  return stats;
+}
@@ -0,0 +1,154 @@
+#pragma once
+
+#include "ring_buffer.hh"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <stop_token>
+#include <thread>
+#include <vector>
+
+// A forwarded datagram picked for sampling (as in sFlow): the start of its bytes, as they were
+// sent on, and how it was routed
+struct PacketSample
+{
+  static constexpr size_t HEADER_BYTES = 128;
+
+  std::array<uint8_t, HEADER_BYTES> header {};
+  uint16_t captured {};      // bytes of `header` in use
+  uint32_t length {};        // of the whole datagram
+  uint32_t in_interface {};  // the interface it was received on
+  uint32_t out_interface {}; // ... and sent on
+  uint32_t prefix {};        // the route it matched
+  uint8_t prefix_length {};
+  uint64_t time {}; // ms (of the Router's clock, see Router::tick())
+};
+
+// Picks datagrams to sample, 1 in `rate` on average, at random.
+//
+// Rather than drawing a random number for every datagram, it draws the gap to the next sample
+// (uniform in [1, 2 * rate - 1], so that the mean gap is `rate`) from a xorshift generator, and
+// counts down to it: a datagram that is not sampled costs a decrement and a branch. While
+// sampling is off (rate 0), the countdown starts so high that it never runs out.
+class SampleCountdown
+{
+  uint64_t countdown_ { UINT64_MAX }; // datagrams until the next sample
+  uint64_t state_ { 1 };              // of the generator (never 0)
+  uint32_t rate_ {};
+
+  uint64_t next()
+  {
+    state_ ^= state_ << 13;
+    state_ ^= state_ >> 7;
+    state_ ^= state_ << 17;
+    return state_;
+  }
+
+  uint64_t gap() { return rate_ == 0 ? UINT64_MAX : 1 + next() % ( uint64_t { rate_ } * 2 - 1 ); }
+
+public:
+  uint32_t rate() const { return rate_; }
+
+  // Sample 1 in `rate` datagrams (none, if 0) from here on; `seed` starts the generator
+  void reset( const uint32_t rate, const uint64_t seed )
+  {
+    rate_ = rate;
+    state_ = seed == 0 ? 1 : seed;
+    countdown_ = gap();
+  }
+
+  // Count a datagram; returns whether it is to be sampled
+  bool due()
+  {
+    if ( --countdown_ != 0 ) [[likely]] {
+      return false;
+    }
+    countdown_ = gap();
+    return rate_ != 0;
+  }
+};
+
+// Hands sampled datagrams from the threads that route them to an exporter thread, which passes
+// them on in batches.
+//
+// Each source (the Router has one per inbound interface, which only one thread routes at a time)
+// has its own SPSC ring, so submitting a sample takes no lock and touches nothing another
+// producer writes; a sample that finds its ring full is dropped, and counted. The exporter thread
+// drains the rings every `poll_interval` (or at once, while they have samples to give), calling
+// `exporter` with up to EXPORT_BATCH samples at a time, always from that one thread. When the
+// sampler is stopped (or destroyed), the samples still in the rings are exported first.
+class PacketSampler
+{
+public:
+  using Exporter = std::function<void( std::span<const PacketSample> )>;
+
+  static constexpr size_t EXPORT_BATCH = 64;
+
+  struct Stats
+  {
+    uint64_t sampled {};  // samples submitted
+    uint64_t dropped {};  // ... and dropped because their ring was full
+    uint64_t exported {}; // ... and handed to the exporter
+  };
+
+private:
+  struct Source
+  {
+    SpscRing<PacketSample> ring;
+    std::atomic<uint64_t> sampled { 0 };
+    std::atomic<uint64_t> dropped { 0 };
+
+    explicit Source( const size_t capacity ) : ring( capacity ) {}
+  };
+
+  Exporter exporter_;
+  size_t ring_capacity_;
+  std::chrono::milliseconds poll_interval_;
+
+  // (held by the exporter thread while it drains the rings, so that sources can be added
+  // meanwhile)
+  mutable std::mutex sources_mutex_ {};
+  std::vector<std::unique_ptr<Source>> sources_ {};
+  std::atomic<uint64_t> exported_ { 0 };
+
+  // (last, so that it is stopped and joined before anything it uses is destroyed)
+  std::jthread thread_ {};
+
+  void run( const std::stop_token& stop );
+
+  // Export up to EXPORT_BATCH samples from each ring; returns how many there were
+  size_t drain( std::vector<PacketSample>& batch );
+
+public:
+  PacketSampler( size_t sources,
+                 size_t ring_capacity,
+                 Exporter exporter,
+                 std::chrono::milliseconds poll_interval = std::chrono::milliseconds { 1 } );
+
+  // Add a source (numbered after the existing ones). Not to be called while a producer is
+  // submitting.
+  void add_source();
+
+  // Producer side of source `source`: queue a sample for export (or drop it, if its ring is full)
+  void submit( const size_t source, PacketSample&& sample )
+  {
+    Source& s = *sources_[source];
+    s.sampled.fetch_add( 1, std::memory_order_relaxed );
+    if ( not s.ring.push( std::move( sample ) ) ) {
+      s.dropped.fetch_add( 1, std::memory_order_relaxed );
+    }
+  }
+
+  // Export the samples still queued, and stop the exporter thread (after which nothing more may be
+  // submitted)
+  void stop();
+
+  Stats stats() const;
+};
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+// A read-mostly value updated by read-copy-update (RCU).
+//
+// Readers take a ReadGuard and see one immutable version of the value for as long as they
+// hold it; taking and dropping a guard costs one atomic increment and decrement, so a reader
+// that holds a guard across a whole batch of work pays nothing per item. Writers copy the
+// current version, change the copy, and publish it with a single atomic pointer swap; the old
+// version is freed once every reader that might still see it has dropped its guard.
+//
+// Grace periods use two reader counters (as in SRCU): readers register on the counter of the
+// current epoch, and a writer drains the other counter, flips the epoch and then waits for the
+// old counter to drain, so a steady stream of new readers cannot keep a writer waiting forever.
+// Writers are serialized by a mutex, and wait for readers, so an update must not be made while
+// holding a ReadGuard.
+template<typename T>
+class Rcu
+{
+  struct alignas( 64 ) ReaderCount
+  {
+    std::atomic<uint64_t> readers { 0 };
+  };
+
+  std::atomic<const T*> current_;
+  std::atomic<uint32_t> epoch_ { 0 };
+  mutable ReaderCount counts_[2] {}; // NOLINT(*-avoid-c-arrays)
+  std::mutex writer_ {};
+
+  // Register a reader on `epoch`, then load the version it will see
+  const T* enter( const uint32_t epoch ) const
+  {
+    counts_[epoch].readers++;
+    return current_.load();
+  }
+
+  void drain( const uint32_t epoch ) const
+  {
+    while ( counts_[epoch].readers.load() != 0 ) {
+      std::this_thread::yield();
+    }
+  }
+
+  // Wait until no reader can still be using the version that was current before the last swap.
+  // A reader that loaded the epoch just before the previous flip may register on the new epoch's
+  // counter only after that flip's drain, still holding an older version, so both counters are
+  // drained (as in LeftRight::synchronize()).
+  void synchronize()
+  {
+    const uint32_t old_epoch = epoch_.load();
+    drain( old_epoch ^ 1 );
+    epoch_.store( old_epoch ^ 1 );
+    drain( old_epoch );
+  }
+
+public:
+  // A reader's view of one version of the value
+  class ReadGuard
+  {
+    const Rcu* rcu_;
+    uint32_t epoch_;
+    const T* value_;
+
+  public:
+    explicit ReadGuard( const Rcu& rcu )
+      : rcu_( &rcu ), epoch_( rcu.epoch_.load() ), value_( rcu.enter( epoch_ ) )
+    {}
+    ~ReadGuard() { rcu_->counts_[epoch_].readers--; }
+
+    ReadGuard( const ReadGuard& other ) = delete;
+    ReadGuard& operator=( const ReadGuard& other ) = delete;
+    ReadGuard( ReadGuard&& other ) = delete;
+    ReadGuard& operator=( ReadGuard&& other ) = delete;
+
+    const T& operator*() const { return *value_; }
+    const T* operator->() const { return value_; }
+  };
+
+  explicit Rcu( T initial = {} ) : current_( new T( std::move( initial ) ) ) {}
+  ~Rcu() { delete current_.load(); }
+
+  Rcu( const Rcu& other ) = delete;
+  Rcu& operator=( const Rcu& other ) = delete;
+  Rcu( Rcu&& other ) = delete;
+  Rcu& operator=( Rcu&& other ) = delete;
+
+  ReadGuard read() const { return ReadGuard { *this }; }
+
+  // Apply `change` (which returns whether it changed anything) to a copy of the current version,
+  // and publish the copy if it did. Returns the result of `change`.
+  template<class F>
+  bool update( F&& change )
+  {
+    const std::lock_guard lock { writer_ };
+
+    auto next = std::make_unique<T>( *current_.load() );
+    if ( not std::forward<F>( change )( *next ) ) {
+      return false;
+    }
+
+    const std::unique_ptr<const T> old { current_.exchange( next.release() ) };
+    synchronize();
+    return true;
+  }
+
+  // Publish `make( current version )` as the new version, without copying the current one first
+  // (for changes that build a whole new value)
+  template<class F>
+  void replace( F&& make )
+  {
+    const std::lock_guard lock { writer_ };
+
+    auto next = std::make_unique<T>( std::forward<F>( make )( *current_.load() ) );
+    const std::unique_ptr<const T> old { current_.exchange( next.release() ) };
+    synchronize();
+  }
+};
@@ -0,0 +1,187 @@
+#include "route_trie.hh"
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+
+uint32_t RouteTrie::mask( const uint32_t prefix, const uint8_t prefix_length )
+{
+  if ( prefix_length == 0 ) {
+    return 0;
+  }
+  if ( prefix_length >= 32 ) {
+    return prefix;
+  }
+  return prefix & ( ~0U << ( 32 - prefix_length ) );
+}
+
+uint32_t RouteTrie::find_node( const uint32_t prefix, const uint8_t prefix_length, const bool create )
+{
+  if ( prefix_length > 32 ) {
+    throw runtime_error( "RouteTrie: prefix length must be at most 32" );
+  }
+
+  uint32_t node = 0;
+  for ( uint8_t depth = 0; depth < prefix_length; depth++ ) {
+    const uint32_t bit = ( prefix >> ( 31 - depth ) ) & 1U;
+    uint32_t next = nodes_[node].child[bit];
+    if ( next == NO_CHILD ) {
+      if ( not create ) {
+        return NO_CHILD;
+      }
+      next = static_cast<uint32_t>( nodes_.size() );
+      nodes_.emplace_back();
+      nodes_[node].child[bit] = next;
+    }
+    node = next;
+  }
+  return node;
+}
+
+uint32_t RouteTrie::locate( const uint32_t prefix, const uint8_t prefix_length ) const
+{
+  if ( prefix_length > 32 ) {
+    throw runtime_error( "RouteTrie: prefix length must be at most 32" );
+  }
+
+  uint32_t node = 0;
+  for ( uint8_t depth = 0; depth < prefix_length; depth++ ) {
+    node = nodes_[node].child[( prefix >> ( 31 - depth ) ) & 1U];
+    if ( node == NO_CHILD ) {
+      return NO_NODE;
+    }
+  }
+  return node;
+}
+
+bool RouteTrie::insert( const uint32_t prefix, const uint8_t prefix_length, const uint32_t route )
+{
+  Node& node = nodes_[find_node( mask( prefix, prefix_length ), prefix_length, true )];
+  if ( node.route != NO_ROUTE ) {
+    return false;
+  }
+  node.route = route;
+  num_routes_++;
+  return true;
+}
+
+uint32_t RouteTrie::find( const uint32_t prefix, const uint8_t prefix_length ) const
+{
+  const uint32_t node = locate( mask( prefix, prefix_length ), prefix_length );
+  return node == NO_NODE ? NO_ROUTE : nodes_[node].route;
+}
+
+uint32_t RouteTrie::erase( const uint32_t prefix, const uint8_t prefix_length )
+{
+  const uint32_t node = locate( mask( prefix, prefix_length ), prefix_length );
+  if ( node == NO_NODE or nodes_[node].route == NO_ROUTE ) {
+    return NO_ROUTE;
+  }
+  const uint32_t route = nodes_[node].route;
+  nodes_[node].route = NO_ROUTE;
+  num_routes_--;
+  return route;
+}
+
+uint32_t RouteTrie::lookup( const uint32_t address ) const
+{
+  uint32_t best = nodes_[0].route;
+  uint32_t node = 0;
+  for ( uint8_t depth = 0; depth < 32; depth++ ) {
+    node = nodes_[node].child[( address >> ( 31 - depth ) ) & 1U];
+    if ( node == NO_CHILD ) {
+      break;
+    }
+    if ( nodes_[node].route != NO_ROUTE ) {
+      best = nodes_[node].route;
+    }
+  }
+  return best;
+}
+
+void RouteTrie::lookup_batch( const span<const uint32_t> addresses, const span<uint32_t> routes ) const
+{
+  if ( routes.size() < addresses.size() ) {
+    throw runtime_error( "RouteTrie: lookup_batch needs one output per address" );
+  }
+
+  // Addresses walked together; enough to hide memory latency, few enough to stay in registers/L1
+  constexpr size_t LANES = 16;
+  constexpr uint32_t DONE = NO_NODE;
+
+  for ( size_t base = 0; base < addresses.size(); base += LANES ) {
+    const size_t lanes = min( LANES, addresses.size() - base );
+    uint32_t node[LANES] {}; // NOLINT(*-avoid-c-arrays)
+    size_t active = lanes;
+
+    for ( size_t i = 0; i < lanes; i++ ) {
+      routes[base + i] = NO_ROUTE;
+    }
+
+    for ( uint8_t depth = 0; active > 0; depth++ ) {
+      for ( size_t i = 0; i < lanes; i++ ) {
+        if ( node[i] == DONE ) {
+          continue;
+        }
+        const Node& current = nodes_[node[i]];
+        if ( current.route != NO_ROUTE ) {
+          routes[base + i] = current.route;
+        }
+        const uint32_t next
+          = depth < 32 ? current.child[( addresses[base + i] >> ( 31 - depth ) ) & 1U] : NO_CHILD;
+        if ( next == NO_CHILD ) {
+          node[i] = DONE;
+          active--;
+        } else {
+          node[i] = next;
+          __builtin_prefetch( &nodes_[next] );
+        }
+      }
+    }
+  }
+}
+
+void RouteTrie::clear()
+{
+  nodes_.assign( 1, Node {} );
+  num_routes_ = 0;
+}
+
+RouteTrie RouteTrie::from_nodes( const span<const Node> nodes, const uint32_t max_route )
+{
+  if ( nodes.empty() or nodes.size() >= NO_NODE ) {
+    throw runtime_error( "RouteTrie: wrong number of nodes" );
+  }
+
+  vector<bool> has_parent( nodes.size() );
+  vector<bool> has_route( max_route );
+  size_t num_routes = 0;
+  for ( size_t i = 0; i < nodes.size(); i++ ) {
+    for ( const uint32_t child : nodes[i].child ) {
+      if ( child == NO_CHILD ) {
+        continue;
+      }
+      if ( child <= i or child >= nodes.size() or has_parent[child] ) {
+        throw runtime_error( "RouteTrie: bad child index" );
+      }
+      has_parent[child] = true;
+    }
+    const uint32_t route = nodes[i].route;
+    if ( route != NO_ROUTE ) {
+      if ( route >= max_route or has_route[route] ) {
+        throw runtime_error( "RouteTrie: bad route index" );
+      }
+      has_route[route] = true;
+      num_routes++;
+    }
+  }
+  if ( std::find( has_parent.begin() + 1, has_parent.end(), false ) != has_parent.end() ) {
+    throw runtime_error( "RouteTrie: unreachable node" );
+  }
+
+  RouteTrie trie;
+  trie.nodes_.assign( nodes.begin(), nodes.end() );
+  trie.num_routes_ = num_routes;
+  return trie;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "huge_pages.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// A binary trie over IPv4 prefixes, used by the Router as its forwarding
+// information base (FIB). Each node may carry the index of a route; a lookup
+// walks at most 32 levels from the root, remembering the deepest route it has
+// passed, which is exactly the longest matching prefix.
+//
+// Nodes live in one flat vector and refer to their children by index, so the
+// whole structure is a single contiguous allocation (on huge pages, once it is
+// large enough: see HugePageAllocator).
+class RouteTrie
+{
+public:
+  // Marker for "no route" (returned by lookup() on a miss)
+  static constexpr uint32_t NO_ROUTE = UINT32_MAX;
+
+  // Marker for "no child"; node 0 is the root, so it can never be a child
+  static constexpr uint32_t NO_CHILD = 0;
+
+  struct Node
+  {
+    uint32_t child[2] { NO_CHILD, NO_CHILD }; // children for a 0 bit and a 1 bit
+    uint32_t route { NO_ROUTE };              // route stored at this prefix, if any
+  };
+
+private:
+  HugePageVector<Node> nodes_ { Node {} };
+  size_t num_routes_ {};
+
+  // Marker for "no such node" (returned by locate())
+  static constexpr uint32_t NO_NODE = UINT32_MAX;
+
+  // Find the node for a prefix, optionally creating it (and its parents)
+  uint32_t find_node( uint32_t prefix, uint8_t prefix_length, bool create );
+
+  // Find the node for a prefix if it exists, or NO_NODE
+  uint32_t locate( uint32_t prefix, uint8_t prefix_length ) const;
+
+public:
+  // Only the high-order `prefix_length` bits of a prefix are significant
+  static uint32_t mask( uint32_t prefix, uint8_t prefix_length );
+
+  // Store `route` at prefix/prefix_length. If a route is already stored there,
+  // it is kept and false is returned (the first route added for a prefix wins).
+  bool insert( uint32_t prefix, uint8_t prefix_length, uint32_t route );
+
+  // Route stored at exactly prefix/prefix_length, or NO_ROUTE
+  uint32_t find( uint32_t prefix, uint8_t prefix_length ) const;
+
+  // Remove the route stored at exactly prefix/prefix_length, and return it (or NO_ROUTE).
+  // The node itself is kept, so that the prefix can be added back without allocating.
+  uint32_t erase( uint32_t prefix, uint8_t prefix_length );
+
+  // Index of the route with the longest prefix matching `address`, or NO_ROUTE
+  uint32_t lookup( uint32_t address ) const;
+
+  // lookup() for a burst of addresses: routes[i] = lookup( addresses[i] ) (routes must be at least
+  // as long as addresses). The addresses are walked down the trie in lockstep, one level at a
+  // time, and the next node of each is prefetched while the others are visited, so the cache
+  // misses of a burst overlap instead of being paid one after another.
+  void lookup_batch( std::span<const uint32_t> addresses, std::span<uint32_t> routes ) const;
+
+  // Number of prefixes that currently carry a route
+  size_t size() const { return num_routes_; }
+
+  // Remove every route
+  void clear();
+
+  // The nodes, root first (e.g. to be saved and given back to from_nodes())
+  std::span<const Node> nodes() const { return nodes_; }
+
+  // A trie made of `nodes`, as returned by nodes(). Throws if they do not form a trie (every
+  // node but the root is the child of exactly one node that comes before it) whose routes are
+  // distinct and less than `max_route`.
+  static RouteTrie from_nodes( std::span<const Node> nodes, uint32_t max_route );
+};
@@ -0,0 +1,183 @@
+#include "route_trie6.hh"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+using namespace std;
+
+size_t RouteTrie6::PrefixHash::operator()( const Prefix& prefix ) const
+{
+  uint64_t high = 0;
+  uint64_t low = 0;
+  memcpy( &high, prefix.address.data(), sizeof( high ) );
+  memcpy( &low, prefix.address.data() + sizeof( high ), sizeof( low ) );
+  return hash<uint64_t> {}( high ^ ( low * 0x9E37'79B9'7F4A'7C15ULL ) ^ prefix.length );
+}
+
+IPv6Address RouteTrie6::mask( const IPv6Address& prefix, const uint8_t prefix_length )
+{
+  IPv6Address masked {};
+  const size_t whole = min<size_t>( prefix_length / 8, masked.size() );
+  copy_n( prefix.begin(), whole, masked.begin() );
+  if ( whole < masked.size() and prefix_length % 8 != 0 ) {
+    masked[whole] = prefix[whole] & static_cast<uint8_t>( 0xFF00U >> ( prefix_length % 8 ) );
+  }
+  return masked;
+}
+
+size_t RouteTrie6::depth( const uint8_t prefix_length )
+{
+  if ( prefix_length > 128 ) {
+    throw runtime_error( "RouteTrie6: prefix length must be at most 128" );
+  }
+  return prefix_length <= ROOT_STRIDE ? 0 : ( prefix_length - ROOT_STRIDE + STRIDE - 1 ) / STRIDE;
+}
+
+size_t RouteTrie6::index( const IPv6Address& address, const size_t depth )
+{
+  // (the root's stride is the first two bytes, and every later stride one byte)
+  return depth == 0 ? size_t { address[0] } << 8 | address[1] : address[depth + 1];
+}
+
+uint32_t RouteTrie6::findTable( const IPv6Address& address, const size_t depth, const bool create )
+{
+  if ( slots_.empty() ) {
+    if ( not create ) {
+      return NO_CHILD;
+    }
+    slots_.resize( ROOT_SLOTS );
+  }
+
+  uint32_t table = 0;
+  for ( size_t d = 0; d < depth; d++ ) {
+    const size_t slot = offset( table ) + index( address, d );
+    uint32_t next = slots_[slot].child;
+    if ( next == NO_CHILD ) {
+      if ( not create ) {
+        return NO_CHILD;
+      }
+      next = static_cast<uint32_t>( ( slots_.size() - ROOT_SLOTS ) / TABLE_SLOTS + 1 );
+      slots_.resize( slots_.size() + TABLE_SLOTS );
+      slots_[slot].child = next;
+    }
+    table = next;
+  }
+  return table;
+}
+
+bool RouteTrie6::insert( const IPv6Address& prefix, const uint8_t prefix_length, const uint32_t route )
+{
+  const size_t d = depth( prefix_length );
+  const Prefix key { mask( prefix, prefix_length ), prefix_length };
+  if ( not routes_.emplace( key, route ).second ) {
+    return false;
+  }
+
+  // Every slot the prefix covers, unless a longer prefix already holds it
+  const uint32_t table = findTable( key.address, d, true );
+  const size_t stride = d == 0 ? ROOT_STRIDE : STRIDE;
+  const size_t first = offset( table ) + index( key.address, d );
+  const size_t count = size_t { 1 } << ( stride - ( prefix_length - start( d ) ) );
+  for ( size_t i = first; i < first + count; i++ ) {
+    Slot& slot = slots_[i];
+    if ( slot.route == NO_ROUTE or slot.length < prefix_length ) {
+      slot.route = route;
+      slot.length = prefix_length;
+    }
+  }
+  return true;
+}
+
+uint32_t RouteTrie6::find( const IPv6Address& prefix, const uint8_t prefix_length ) const
+{
+  const auto it = routes_.find( { mask( prefix, prefix_length ), prefix_length } );
+  return it == routes_.end() ? NO_ROUTE : it->second;
+}
+
+uint32_t RouteTrie6::erase( const IPv6Address& prefix, const uint8_t prefix_length )
+{
+  const size_t d = depth( prefix_length );
+  const Prefix key { mask( prefix, prefix_length ), prefix_length };
+  const auto it = routes_.find( key );
+  if ( it == routes_.end() ) {
+    return NO_ROUTE;
+  }
+  const uint32_t route = it->second;
+  routes_.erase( it );
+
+  // The slots the prefix held go to the longest remaining prefix in the same table that covers
+  // them (a shorter prefix, held by a table above, is found by lookups on their way down)
+  const uint32_t table = findTable( key.address, d, false );
+  const size_t stride = d == 0 ? ROOT_STRIDE : STRIDE;
+  const size_t first_index = index( key.address, d );
+  const size_t count = size_t { 1 } << ( stride - ( prefix_length - start( d ) ) );
+  const size_t shortest = d == 0 ? 0 : start( d ) + 1;
+  for ( size_t i = first_index; i < first_index + count; i++ ) {
+    Slot& slot = slots_[offset( table ) + i];
+    if ( slot.route != route or slot.length != prefix_length ) {
+      continue;
+    }
+    slot = { slot.child, NO_ROUTE, 0 };
+
+    IPv6Address covered = key.address;
+    if ( d == 0 ) {
+      covered[0] = static_cast<uint8_t>( i >> 8 );
+      covered[1] = static_cast<uint8_t>( i );
+    } else {
+      covered[d + 1] = static_cast<uint8_t>( i );
+    }
+    for ( size_t length = prefix_length; length-- > shortest; ) {
+      const uint32_t shorter = find( covered, static_cast<uint8_t>( length ) );
+      if ( shorter != NO_ROUTE ) {
+        slot.route = shorter;
+        slot.length = static_cast<uint8_t>( length );
+        break;
+      }
+    }
+  }
+  return route;
+}
+
+uint32_t RouteTrie6::lookup( const IPv6Address& address ) const
+{
+  if ( slots_.empty() ) {
+    return NO_ROUTE;
+  }
+
+  uint32_t route = NO_ROUTE;
+  const Slot* slot = &slots_[index( address, 0 )];
+  for ( size_t d = 1;; d++ ) {
+    if ( slot->route != NO_ROUTE ) {
+      route = slot->route;
+    }
+    if ( slot->child == NO_CHILD ) {
+      return route;
+    }
+    slot = &slots_[offset( slot->child ) + index( address, d )];
+  }
+}
+
+void RouteTrie6::lookup_batch( const span<const IPv6Address> addresses, const span<uint32_t> routes ) const
+{
+  if ( routes.size() < addresses.size() ) {
+    throw runtime_error( "RouteTrie6: lookup_batch needs one output per address" );
+  }
+  if ( slots_.empty() ) {
+    fill_n( routes.begin(), addresses.size(), NO_ROUTE );
+    return;
+  }
+
+  for ( const IPv6Address& address : addresses ) {
+    __builtin_prefetch( &slots_[index( address, 0 )] );
+  }
+  for ( size_t i = 0; i < addresses.size(); i++ ) {
+    routes[i] = lookup( addresses[i] );
+  }
+}
+
+void RouteTrie6::clear()
+{
+  slots_.clear();
+  routes_.clear();
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "huge_pages.hh"
+#include "ipv6_header.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <unordered_map>
+
+// A multibit trie over IPv6 prefixes: the Router's IPv6 forwarding table (see RouteTrie for IPv4).
+//
+// The root is a table of 2^16 slots, indexed by the first 16 bits of an address, and each table
+// below it has 2^8 slots, indexed by the next byte, so a lookup for a /48 reads at most five
+// slots, and one for a /64 at most seven. A prefix whose length falls inside a table's stride is
+// expanded over every slot it covers (controlled prefix expansion), and each slot remembers the
+// length of the prefix whose route it holds, so that a longer prefix covering the same slot wins.
+// A lookup walks down from the root, remembering the last route it has passed, which is the route
+// of the longest matching prefix.
+//
+// Tables live in one flat vector of slots and refer to their children by table number (the root
+// is table 0, and is only allocated once there is a route), so the whole trie is one contiguous
+// allocation, on huge pages once it is large enough (see HugePageAllocator). Every route is also
+// kept by prefix, for find() and erase(), and so that erasing a route can give its slots back to
+// the next longest prefix that covers them.
+class RouteTrie6
+{
+public:
+  // Marker for "no route" (returned by lookup() on a miss)
+  static constexpr uint32_t NO_ROUTE = UINT32_MAX;
+
+  // Marker for "no child"; table 0 is the root, so it can never be a child
+  static constexpr uint32_t NO_CHILD = 0;
+
+  // Bits of the address indexing the root, and each table below it
+  static constexpr size_t ROOT_STRIDE = 16;
+  static constexpr size_t STRIDE = 8;
+
+  struct Slot
+  {
+    uint32_t child { NO_CHILD }; // the table for the next STRIDE bits, if any
+    uint32_t route { NO_ROUTE }; // route of the longest prefix covering this slot, if any
+    uint8_t length {};           // ... and that prefix's length
+  };
+
+private:
+  static constexpr size_t ROOT_SLOTS = size_t { 1 } << ROOT_STRIDE;
+  static constexpr size_t TABLE_SLOTS = size_t { 1 } << STRIDE;
+
+  HugePageVector<Slot> slots_ {};
+
+  struct Prefix
+  {
+    IPv6Address address {}; // (masked to its length)
+    uint8_t length {};
+
+    bool operator==( const Prefix& other ) const = default;
+  };
+
+  struct PrefixHash
+  {
+    size_t operator()( const Prefix& prefix ) const;
+  };
+
+  std::unordered_map<Prefix, uint32_t, PrefixHash> routes_ {};
+
+  // The first slot of a table
+  static size_t offset( uint32_t table ) { return table == 0 ? 0 : ROOT_SLOTS + ( table - 1 ) * TABLE_SLOTS; }
+
+  // The depth of the table that holds a prefix of `prefix_length` (0: the root), and the number
+  // of address bits above that table
+  static size_t depth( uint8_t prefix_length );
+  static size_t start( size_t depth ) { return depth == 0 ? 0 : ROOT_STRIDE + ( depth - 1 ) * STRIDE; }
+
+  // The slot of `address` in a table at `depth`
+  static size_t index( const IPv6Address& address, size_t depth );
+
+  // The table at `depth` on the path of `address`, creating it (and its parents) if asked, or
+  // NO_CHILD if it does not exist
+  uint32_t findTable( const IPv6Address& address, size_t depth, bool create );
+
+public:
+  // Only the high-order `prefix_length` bits of a prefix are significant
+  static IPv6Address mask( const IPv6Address& prefix, uint8_t prefix_length );
+
+  // Store `route` at prefix/prefix_length (prefix_length at most 128). If a route is already
+  // stored there, it is kept and false is returned (the first route added for a prefix wins).
+  bool insert( const IPv6Address& prefix, uint8_t prefix_length, uint32_t route );
+
+  // Route stored at exactly prefix/prefix_length, or NO_ROUTE
+  uint32_t find( const IPv6Address& prefix, uint8_t prefix_length ) const;
+
+  // Remove the route stored at exactly prefix/prefix_length, and return it (or NO_ROUTE). Its
+  // tables are kept, so that the prefix can be added back without allocating.
+  uint32_t erase( const IPv6Address& prefix, uint8_t prefix_length );
+
+  // Index of the route with the longest prefix matching `address`, or NO_ROUTE
+  uint32_t lookup( const IPv6Address& address ) const;
+
+  // lookup() for a burst of addresses: routes[i] = lookup( addresses[i] ) (routes must be at least
+  // as long as addresses). The root slot of every address is prefetched before any is walked, so
+  // that the misses of a burst on the (large) root overlap.
+  void lookup_batch( std::span<const IPv6Address> addresses, std::span<uint32_t> routes ) const;
+
+  // Number of prefixes that currently carry a route
+  size_t size() const { return routes_.size(); }
+
+  // Remove every route
+  void clear();
+};
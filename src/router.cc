@@ -1,17 +1,64 @@
 #include "router.hh"
+#include "cpu_affinity.hh"
+#include "exception.hh"
+#include "fib_snapshot.hh"
+#include "log.hh"
+#include "mapped_file.hh"
+#include "neighbor_snapshot.hh"
+#include "profile_markers.hh"
 
-#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
 #include <limits>
+#include <random>
+#include <unistd.h>
 
 using namespace std;
 
+namespace {
+
+// Element `i` of the array of T starting at `offset` in a FIB snapshot
+template<class T>
+T loadElement( const string_view file, const size_t offset, const size_t i ) {
+  T value;
+  memcpy( &value, file.data() + offset + i * sizeof( T ), sizeof( T ) );
+  return value;
+}
+
+template<class T>
+void storeElement( string& file, const size_t offset, const size_t i, const T value ) {
+  memcpy( file.data() + offset + i * sizeof( T ), &value, sizeof( T ) );
+}
+
+// Write a snapshot to a new file that then replaces the old one, so that a crash never leaves
+// half a snapshot
+void writeSnapshot( const string& path, const string_view file ) {
+  const string new_path = path + ".new";
+  {
+    FileDescriptor fd { CheckSystemCall( "open " + new_path,
+                                         ::open( new_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644 ) ) }; // NOLINT(*-vararg)
+    for( string_view remaining = file; not remaining.empty(); ) {
+      remaining.remove_prefix( fd.write( remaining ) );
+    }
+    CheckSystemCall( "fsync", ::fsync( fd.fd_num() ) );
+  }
+  CheckSystemCall( "rename " + new_path, ::rename( new_path.c_str(), path.c_str() ) );
+}
+
+uint64_t wallClockMs() {
+  return static_cast<uint64_t>(
+    chrono::duration_cast<chrono::milliseconds>( chrono::system_clock::now().time_since_epoch() ).count() );
+}
+
+} // namespace
+
 // Default constructor for Router.
 Router::Router()
-  : interfaces_(), RoutingTable() {
-    cerr << "DEBUG: Router constructed with " 
-              << interfaces_.size() << " interface(s) and " 
-              << RoutingTable.size() << " routing table entries." 
-              << endl;
+  : interfaces_(), RoutingTable( make_unique<LeftRight<Fib>>() ), Acl( make_unique<Rcu<AclVersion>>() ), RouteBurst(), NextHopAdjacencies(), Workers(), WorkerCpus(), Outboxes(), Outboxes6(), WorkerBursts(), Counters(), Flows(), FlowMemoryBudget( 0 ), FlowIdleTimeout( 0 ), CurrentTime( 0 ), Sampler(), SampleRate( 0 ) {
+    LOG_DEBUG( "Router constructed with ", interfaces_.size(), " interface(s) and ",
+               RoutingTable->read()->trie.size(), " routing table entries." );
 }
 
 // route_prefix: The "up-to-32-bit" IPv4 address prefix to match the datagram's destination address against
@@ -25,81 +72,1175 @@ void Router::add_route( const uint32_t route_prefix,
                         const optional<Address> next_hop,
                         const size_t interface_num )
 {
-  cerr << "DEBUG: adding route " << Address::from_ipv4_numeric( route_prefix ).ip() << "/"
-       << static_cast<int>( prefix_length ) << " => " << ( next_hop.has_value() ? next_hop->ip() : "(direct)" )
-       << " on interface " << interface_num << "\n";
+  if( next_hop.has_value() ) {
+    LOG_DEBUG( "adding route ", LogIpv4 { route_prefix }, "/", static_cast<int>( prefix_length ), " => ",
+               LogIpv4 { next_hop->ipv4_numeric() }, " on interface ", interface_num );
+  } else {
+    LOG_DEBUG( "adding route ", LogIpv4 { route_prefix }, "/", static_cast<int>( prefix_length ),
+               " => (direct) on interface ", interface_num );
+  }
+
+  const NextHop hop = makeNextHop( next_hop.has_value() ? optional<uint32_t> { next_hop->ipv4_numeric() } : nullopt,
+                                    interface_num );
+
+  // Publishing a new version of the FIB with the route added
+  // If an entry with the same prefix already exists, the earlier one keeps winning (nothing changes)
+  updateFib( [&]( Fib& fib ) {
+    if( fib.trie.find( route_prefix, prefix_length ) != RouteTrie::NO_ROUTE ) {
+      return false;
+    }
+    fib.add( route_prefix, prefix_length, fib.intern( hop ) );
+    return true;
+  } );
+}
+
+size_t Router::RouteUpdate::commit()
+{
+  // (applied to each copy of the FIB in turn, giving the same count each time)
+  size_t applied = 0;
+  router_.updateFib( [&]( Fib& fib ) {
+    applied = 0;
+    for( const RouteChange& change : changes_ ) {
+      const uint32_t route_index = fib.trie.find( change.prefix, change.prefix_length );
+      switch( change.kind ) {
+        case RouteChange::Kind::ADD:
+          if( route_index != RouteTrie::NO_ROUTE ) {
+            continue;
+          }
+          fib.add( change.prefix, change.prefix_length, fib.intern( makeNextHop( change.next_hop, change.interface_num ) ) );
+          break;
+        case RouteChange::Kind::REPLACE:
+          if( route_index == RouteTrie::NO_ROUTE ) {
+            fib.add( change.prefix, change.prefix_length, fib.intern( makeNextHop( change.next_hop, change.interface_num ) ) );
+          } else {
+            fib.releaseGroup( fib.routes[route_index].next_hop );
+            fib.routes[route_index].next_hop = fib.intern( makeNextHop( change.next_hop, change.interface_num ) );
+          }
+          break;
+        case RouteChange::Kind::WITHDRAW:
+          if( route_index == RouteTrie::NO_ROUTE ) {
+            continue;
+          }
+          fib.trie.erase( change.prefix, change.prefix_length );
+          fib.releaseGroup( fib.routes[route_index].next_hop );
+          fib.routes[route_index] = RoutingTableEntry();
+          fib.free_slots.push_back( route_index );
+          break;
+      }
+      applied++;
+    }
+    return applied != 0;
+  } );
+
+  LOG_INFO( "committed a route update of ", changes_.size(), " changes (", applied, " applied)" );
+  changes_.clear();
+  return applied;
+}
+
+void Router::load_routes( const span<const Route> routes )
+{
+  // Sorting by prefix (then length) puts the routes in trie order, so that the nodes are
+  // created, and laid out, depth first. Ties are broken by position, so that the first of
+  // several routes for the same prefix wins.
+  struct SortKey {
+    uint64_t prefix; // masked prefix, then length
+    uint32_t index;
+    bool operator<( const SortKey& other ) const {
+      return prefix != other.prefix ? prefix < other.prefix : index < other.index;
+    }
+  };
+  vector<SortKey> order( routes.size() );
+  for( uint32_t i = 0; i < order.size(); i++ ) {
+    const Route& route = routes[i];
+    order[i] = { uint64_t { RouteTrie::mask( route.prefix, route.prefix_length ) } << 8 | route.prefix_length, i };
+  }
+  sort( order.begin(), order.end() );
+
+  RoutingTable->replace( [&]( const Fib& current ) {
+    Fib fib;
+    fib.generation = current.generation + 1;
+    fib.next_hops = current.next_hops; // keeping the next hop indices that route() has cached
+    fib.next_hop_ids = current.next_hop_ids;
+    fib.trie6 = current.trie6; // (only the IPv4 routes are replaced)
+    fib.next_hops6 = current.next_hops6;
+    fib.routes.reserve( routes.size() );
+    for( size_t k = 0; k < order.size(); k++ ) {
+      const Route& route = routes[order[k].index];
+      // (duplicates are next to each other once sorted)
+      if( k > 0 and order[k - 1].prefix == order[k].prefix ) {
+        continue;
+      }
+      fib.add( route.prefix, route.prefix_length, fib.intern( makeNextHop( route.next_hop, route.interface_num ) ) );
+    }
+    return fib;
+  } );
+
+  LOG_INFO( "loaded ", routes.size(), " routes" );
+}
+
+void Router::save_fib_snapshot( const string& path, const bool include_trie ) const
+{
+  string file;
+  {
+    const auto fib = RoutingTable->read();
+
+    FibSnapshotHeader header;
+    header.num_routes = static_cast<uint32_t>( fib->routes.size() );
+    header.num_free_slots = static_cast<uint32_t>( fib->free_slots.size() );
+    header.num_next_hops = static_cast<uint32_t>( fib->next_hops.size() );
+    header.num_trie_nodes = include_trie ? static_cast<uint32_t>( fib->trie.nodes().size() ) : 0;
+    header.num_groups = static_cast<uint32_t>( fib->groups.size() );
+    for( const MultipathGroup& group : fib->groups ) {
+      header.num_group_paths += static_cast<uint32_t>( group.paths.size() );
+    }
+    const FibSnapshotLayout layout { header };
+
+    file.resize( layout.size ); // (the padding between arrays is zeroed)
+    memcpy( file.data(), &header, sizeof( header ) );
+    for( size_t i = 0; i < fib->routes.size(); i++ ) {
+      const RoutingTableEntry& entry = fib->routes[i];
+      storeElement( file, layout.route_prefix, i, entry.route_prefix );
+      storeElement( file, layout.route_next_hop, i, entry.next_hop );
+      storeElement( file, layout.route_prefix_length, i, entry.prefix_length );
+    }
+    for( size_t i = 0; i < fib->free_slots.size(); i++ ) {
+      storeElement( file, layout.free_slots, i, fib->free_slots[i] );
+    }
+    for( size_t i = 0; i < fib->next_hops.size(); i++ ) {
+      const NextHop& hop = fib->next_hops[i];
+      storeElement( file, layout.next_hop_address, i, hop.address );
+      storeElement( file, layout.next_hop_interface, i, hop.interface_num );
+      storeElement( file, layout.next_hop_direct, i, uint8_t { hop.direct } );
+    }
+    size_t num_paths = 0;
+    for( size_t g = 0; g < fib->groups.size(); g++ ) {
+      const MultipathGroup& group = fib->groups[g];
+      storeElement( file, layout.group_num_paths, g, static_cast<uint32_t>( group.paths.size() ) );
+      for( const uint32_t hop : group.paths ) {
+        storeElement( file, layout.group_paths, num_paths++, hop );
+      }
+      for( size_t b = 0; b < MULTIPATH_BUCKETS; b++ ) {
+        storeElement( file, layout.group_buckets, g * MULTIPATH_BUCKETS + b, group.buckets[b] );
+      }
+    }
+    if( include_trie ) {
+      const span<const RouteTrie::Node> nodes = fib->trie.nodes();
+      memcpy( file.data() + layout.trie_nodes, nodes.data(), nodes.size_bytes() );
+    }
+  }
+
+  writeSnapshot( path, file );
+  LOG_INFO( "saved ", file.size(), " byte FIB snapshot to ", path );
+}
+
+void Router::load_fib_snapshot( const string& path )
+{
+  const FileDescriptor fd { CheckSystemCall( "open " + path, ::open( path.c_str(), O_RDONLY | O_CLOEXEC ) ) }; // NOLINT(*-vararg)
+  const MappedFile mapping { fd };
+  const string_view file = mapping.view();
+
+  FibSnapshotHeader header;
+  if( file.size() < sizeof( header ) ) {
+    throw runtime_error( path + ": too short to be a FIB snapshot" );
+  }
+  memcpy( &header, file.data(), sizeof( header ) );
+  if( header.magic != FibSnapshotHeader::MAGIC ) {
+    throw runtime_error( path + ": not a FIB snapshot" );
+  }
+  if( header.version != FibSnapshotHeader::VERSION ) {
+    throw runtime_error( path + ": unsupported FIB snapshot version " + to_string( header.version ) );
+  }
+  if( header.byte_order != FibSnapshotHeader::BYTE_ORDER_MARK ) {
+    throw runtime_error( path + ": FIB snapshot has the wrong byte order" );
+  }
+  const FibSnapshotLayout layout { header };
+  if( file.size() != layout.size ) {
+    throw runtime_error( path + ": FIB snapshot has the wrong size" );
+  }
+
+  // The snapshot's next hops (routed through interfaces that this router has)
+  vector<NextHop> next_hops( header.num_next_hops );
+  for( size_t i = 0; i < next_hops.size(); i++ ) {
+    next_hops[i].address = loadElement<uint32_t>( file, layout.next_hop_address, i );
+    next_hops[i].interface_num = loadElement<uint32_t>( file, layout.next_hop_interface, i );
+    next_hops[i].direct = loadElement<uint8_t>( file, layout.next_hop_direct, i ) != 0;
+    if( next_hops[i].interface_num >= interfaces_.size() ) {
+      throw runtime_error( path + ": FIB snapshot routes through interface "
+                           + to_string( next_hops[i].interface_num ) + ", which does not exist" );
+    }
+  }
+
+  // The snapshot's multipath groups (of at least two of its next hops, which every bucket is one of)
+  static_assert( FibSnapshotHeader::MULTIPATH_FLAG == MULTIPATH and FibSnapshotHeader::GROUP_BUCKETS == MULTIPATH_BUCKETS );
+  Fib loaded;
+  loaded.groups.resize( header.num_groups );
+  size_t num_paths = 0;
+  for( uint32_t g = 0; g < header.num_groups; g++ ) {
+    MultipathGroup& group = loaded.groups[g];
+    const auto count = loadElement<uint32_t>( file, layout.group_num_paths, g );
+    if( count == 0 ) {
+      loaded.free_groups.push_back( g );
+      continue;
+    }
+    if( count == 1 or count > header.num_group_paths - num_paths ) {
+      throw runtime_error( path + ": FIB snapshot has a bad multipath group" );
+    }
+    group.paths.resize( count );
+    for( uint32_t& hop : group.paths ) {
+      hop = loadElement<uint32_t>( file, layout.group_paths, num_paths++ );
+      if( hop >= next_hops.size() ) {
+        throw runtime_error( path + ": FIB snapshot has a bad multipath group" );
+      }
+    }
+    for( size_t b = 0; b < MULTIPATH_BUCKETS; b++ ) {
+      group.buckets[b] = loadElement<uint32_t>( file, layout.group_buckets, size_t { g } * MULTIPATH_BUCKETS + b );
+      if( ranges::find( group.paths, group.buckets[b] ) == group.paths.end() ) {
+        throw runtime_error( path + ": FIB snapshot has a bad multipath group" );
+      }
+    }
+  }
+  if( num_paths != header.num_group_paths ) {
+    throw runtime_error( path + ": FIB snapshot has a bad multipath group" );
+  }
+
+  vector<bool> is_free( header.num_routes );
+  loaded.free_slots.resize( header.num_free_slots );
+  for( size_t i = 0; i < loaded.free_slots.size(); i++ ) {
+    const uint32_t slot = loadElement<uint32_t>( file, layout.free_slots, i );
+    if( slot >= header.num_routes or is_free[slot] ) {
+      throw runtime_error( path + ": FIB snapshot has a bad free slot" );
+    }
+    is_free[slot] = true;
+    loaded.free_slots[i] = slot;
+  }
+
+  const uint32_t num_live = header.num_routes - header.num_free_slots;
+  vector<bool> group_used( header.num_groups );
+  loaded.routes.resize( header.num_routes );
+  for( uint32_t i = 0; i < header.num_routes; i++ ) {
+    if( is_free[i] ) {
+      continue;
+    }
+    RoutingTableEntry& entry = loaded.routes[i];
+    entry.route_prefix = loadElement<uint32_t>( file, layout.route_prefix, i );
+    entry.next_hop = loadElement<uint32_t>( file, layout.route_next_hop, i );
+    entry.prefix_length = loadElement<uint8_t>( file, layout.route_prefix_length, i );
+    if( entry.prefix_length > 32 ) {
+      throw runtime_error( path + ": FIB snapshot has a bad route" );
+    }
+    if( entry.next_hop & MULTIPATH ) {
+      // (each group belongs to one route)
+      const uint32_t g = entry.next_hop & ~MULTIPATH;
+      if( g >= header.num_groups or loaded.groups[g].paths.empty() or group_used[g] ) {
+        throw runtime_error( path + ": FIB snapshot has a bad route" );
+      }
+      group_used[g] = true;
+    } else if( entry.next_hop >= next_hops.size() ) {
+      throw runtime_error( path + ": FIB snapshot has a bad route" );
+    }
+    if( header.num_trie_nodes == 0 and not loaded.trie.insert( entry.route_prefix, entry.prefix_length, i ) ) {
+      throw runtime_error( path + ": FIB snapshot has two routes for the same prefix" );
+    }
+  }
+
+  // A saved trie is used as it is (after checking that it is a well-formed trie over the live
+  // routes; it is trusted to agree with their prefixes). The array is 8-byte aligned in the file,
+  // and the mapping is page aligned.
+  if( header.num_trie_nodes > 0 ) {
+    const span<const RouteTrie::Node> nodes {
+      reinterpret_cast<const RouteTrie::Node*>( file.data() + layout.trie_nodes ), header.num_trie_nodes }; // NOLINT(*-reinterpret-cast)
+    loaded.trie = RouteTrie::from_nodes( nodes, header.num_routes );
+    const bool routes_free_slot = any_of( nodes.begin(), nodes.end(), [&]( const RouteTrie::Node& node ) {
+      return node.route != RouteTrie::NO_ROUTE and is_free[node.route];
+    } );
+    if( routes_free_slot or loaded.trie.size() != num_live ) {
+      throw runtime_error( path + ": FIB snapshot's trie does not match its routes" );
+    }
+  }
+
+  RoutingTable->replace( [&]( const Fib& current ) {
+    Fib fib = std::move( loaded );
+    fib.generation = current.generation + 1;
+
+    // The snapshot's next hops are renumbered into this router's, keeping the next hop indices
+    // that route() has cached
+    fib.next_hops = current.next_hops;
+    fib.next_hop_ids = current.next_hop_ids;
+    // (snapshots hold only IPv4 routes, so the IPv6 ones are kept)
+    fib.trie6 = current.trie6;
+    fib.next_hops6 = current.next_hops6;
+    vector<uint32_t> renumbered( next_hops.size() );
+    for( size_t i = 0; i < next_hops.size(); i++ ) {
+      renumbered[i] = fib.intern( next_hops[i] );
+    }
+    for( uint32_t i = 0; i < fib.routes.size(); i++ ) {
+      if( not is_free[i] and not( fib.routes[i].next_hop & MULTIPATH ) ) {
+        fib.routes[i].next_hop = renumbered[fib.routes[i].next_hop];
+      }
+    }
+    for( MultipathGroup& group : fib.groups ) {
+      for( uint32_t& hop : group.paths ) {
+        hop = renumbered[hop];
+      }
+      for( uint32_t& hop : group.buckets ) {
+        hop = group.paths.empty() ? 0 : renumbered[hop];
+      }
+    }
+    return fib;
+  } );
+
+  LOG_INFO( "loaded ", num_live, " routes from FIB snapshot ", path );
+}
+
+void Router::save_neighbor_snapshot( const string& path ) const
+{
+  vector<uint32_t> owners;
+  vector<NetworkInterface::Neighbor> neighbors;
+  for( size_t i = 0; i < interfaces_.size(); i++ ) {
+    for( const NetworkInterface::Neighbor& neighbor : interfaces_[i].neighbors() ) {
+      owners.push_back( static_cast<uint32_t>( i ) );
+      neighbors.push_back( neighbor );
+    }
+  }
+
+  NeighborSnapshotHeader header;
+  header.num_interfaces = static_cast<uint32_t>( interfaces_.size() );
+  header.num_entries = static_cast<uint32_t>( neighbors.size() );
+  header.saved_at = wallClockMs();
+  const NeighborSnapshotLayout layout { header };
+
+  string file( layout.size, '\0' );
+  memcpy( file.data(), &header, sizeof( header ) );
+  for( size_t i = 0; i < neighbors.size(); i++ ) {
+    // (a TTL is at most the 30 s an ARP reply gives an entry)
+    const auto ttl = static_cast<uint32_t>( min<uint64_t>( neighbors[i].ttl, numeric_limits<uint32_t>::max() ) );
+    storeElement( file, layout.entry_interface, i, owners[i] );
+    storeElement( file, layout.entry_ip_address, i, neighbors[i].ip_address );
+    storeElement( file, layout.entry_ttl, i, ttl );
+    storeElement( file, layout.entry_ethernet_address, i, neighbors[i].ethernet_address );
+  }
+
+  writeSnapshot( path, file );
+  LOG_INFO( "saved ", neighbors.size(), " neighbors to ", path );
+}
+
+void Router::load_neighbor_snapshot( const string& path )
+{
+  const FileDescriptor fd { CheckSystemCall( "open " + path, ::open( path.c_str(), O_RDONLY | O_CLOEXEC ) ) }; // NOLINT(*-vararg)
+  const MappedFile mapping { fd };
+  const string_view file = mapping.view();
+
+  NeighborSnapshotHeader header;
+  if( file.size() < sizeof( header ) ) {
+    throw runtime_error( path + ": too short to be a neighbor snapshot" );
+  }
+  memcpy( &header, file.data(), sizeof( header ) );
+  if( header.magic != NeighborSnapshotHeader::MAGIC ) {
+    throw runtime_error( path + ": not a neighbor snapshot" );
+  }
+  if( header.version != NeighborSnapshotHeader::VERSION ) {
+    throw runtime_error( path + ": unsupported neighbor snapshot version " + to_string( header.version ) );
+  }
+  if( header.byte_order != NeighborSnapshotHeader::BYTE_ORDER_MARK ) {
+    throw runtime_error( path + ": neighbor snapshot has the wrong byte order" );
+  }
+  if( header.num_interfaces != interfaces_.size() ) {
+    throw runtime_error( path + ": neighbor snapshot is of a router with " + to_string( header.num_interfaces )
+                         + " interfaces" );
+  }
+  const NeighborSnapshotLayout layout { header };
+  if( file.size() != layout.size ) {
+    throw runtime_error( path + ": neighbor snapshot has the wrong size" );
+  }
+
+  // (the time the router was down, which every entry has lost; a clock that went back loses none)
+  const uint64_t now = wallClockMs();
+  const uint64_t elapsed = now > header.saved_at ? now - header.saved_at : 0;
+
+  vector<vector<NetworkInterface::Neighbor>> restored( interfaces_.size() );
+  for( size_t i = 0; i < header.num_entries; i++ ) {
+    const auto owner = loadElement<uint32_t>( file, layout.entry_interface, i );
+    if( owner >= interfaces_.size() ) {
+      throw runtime_error( path + ": neighbor snapshot has a bad interface" );
+    }
+    const auto ttl = loadElement<uint32_t>( file, layout.entry_ttl, i );
+    if( ttl > elapsed ) {
+      restored[owner].push_back( { loadElement<uint32_t>( file, layout.entry_ip_address, i ),
+                                   loadElement<EthernetAddress>( file, layout.entry_ethernet_address, i ),
+                                   ttl - elapsed } );
+    }
+  }
+
+  size_t count = 0;
+  for( size_t i = 0; i < interfaces_.size(); i++ ) {
+    interfaces_[i].restore_neighbors( restored[i] );
+    count += restored[i].size();
+  }
+  LOG_INFO( "restored ", count, " of ", header.num_entries, " neighbors from ", path, " (saved ", elapsed,
+            " ms ago)" );
+}
+
+bool Router::remove_route( const uint32_t route_prefix, const uint8_t prefix_length )
+{
+  return updateFib( [&]( Fib& fib ) {
+    const uint32_t route_index = fib.trie.erase( route_prefix, prefix_length );
+    if( route_index == RouteTrie::NO_ROUTE ) {
+      return false;
+    }
+    fib.releaseGroup( fib.routes[route_index].next_hop );
+    fib.routes[route_index] = RoutingTableEntry();
+    fib.free_slots.push_back( route_index );
+    return true;
+  } );
+}
+
+// route_prefix: The IPv6 prefix to match the datagram's destination address against
+// prefix_length: How many high-order bits of route_prefix must match (at most 128)
+// next_hop: The IPv6 address of the next hop, or empty for a directly attached network
+// interface_num: The index of the interface to send the datagram out on.
+void Router::add_route6( const IPv6Address& route_prefix,
+                         const uint8_t prefix_length,
+                         const optional<IPv6Address> next_hop,
+                         const size_t interface_num )
+{
+  // (the prefix length is checked before any copy of the FIB is changed)
+  if( prefix_length > 128 ) {
+    throw runtime_error( "add_route6: prefix length must be at most 128" );
+  }
+
+  LOG_DEBUG( "adding route ", to_string( route_prefix ), "/", static_cast<int>( prefix_length ), " => ",
+             next_hop.has_value() ? to_string( *next_hop ) : string( "(direct)" ), " on interface ", interface_num );
+
+  NextHop6 hop {};
+  hop.address = next_hop.value_or( IPv6Address {} );
+  hop.interface_num = static_cast<uint32_t>( interface_num );
+  hop.direct = not next_hop.has_value();
+
+  updateFib( [&]( Fib& fib ) {
+    if( fib.trie6.find( route_prefix, prefix_length ) != RouteTrie6::NO_ROUTE ) {
+      return false;
+    }
+    fib.trie6.insert( route_prefix, prefix_length, fib.intern6( hop ) );
+    return true;
+  } );
+}
+
+bool Router::remove_route6( const IPv6Address& route_prefix, const uint8_t prefix_length )
+{
+  if( prefix_length > 128 ) {
+    return false;
+  }
+  return updateFib( [&]( Fib& fib ) {
+    return fib.trie6.erase( route_prefix, prefix_length ) != RouteTrie6::NO_ROUTE;
+  } );
+}
+
+bool Router::add_path( const uint32_t route_prefix,
+                       const uint8_t prefix_length,
+                       const optional<Address> next_hop,
+                       const size_t interface_num )
+{
+  const NextHop hop = makeNextHop( next_hop.has_value() ? optional<uint32_t> { next_hop->ipv4_numeric() } : nullopt,
+                                    interface_num );
+
+  return updateFib( [&]( Fib& fib ) {
+    const uint32_t hop_index = fib.intern( hop );
+    const uint32_t route_index = fib.trie.find( route_prefix, prefix_length );
+    if( route_index == RouteTrie::NO_ROUTE ) {
+      fib.add( route_prefix, prefix_length, hop_index );
+      return true;
+    }
+
+    uint32_t& route_hop = fib.routes[route_index].next_hop;
+    vector<uint32_t> paths = fib.paths( route_hop );
+    if( ranges::find( paths, hop_index ) != paths.end() ) {
+      return false;
+    }
+    paths.push_back( hop_index );
+    fib.setPaths( route_hop, std::move( paths ) );
+    return true;
+  } );
+}
+
+bool Router::remove_path( const uint32_t route_prefix,
+                          const uint8_t prefix_length,
+                          const optional<Address> next_hop,
+                          const size_t interface_num )
+{
+  const NextHop hop = makeNextHop( next_hop.has_value() ? optional<uint32_t> { next_hop->ipv4_numeric() } : nullopt,
+                                    interface_num );
+
+  return updateFib( [&]( Fib& fib ) {
+    const uint32_t route_index = fib.trie.find( route_prefix, prefix_length );
+    if( route_index == RouteTrie::NO_ROUTE ) {
+      return false;
+    }
+
+    uint32_t& route_hop = fib.routes[route_index].next_hop;
+    vector<uint32_t> paths = fib.paths( route_hop );
+    const auto it = ranges::find_if( paths, [&]( const uint32_t index ) { return fib.next_hops[index] == hop; } );
+    if( it == paths.end() ) {
+      return false;
+    }
+    paths.erase( it );
+
+    // The last path: withdrawing the route
+    if( paths.empty() ) {
+      fib.trie.erase( route_prefix, prefix_length );
+      fib.releaseGroup( route_hop );
+      fib.routes[route_index] = RoutingTableEntry();
+      fib.free_slots.push_back( route_index );
+      return true;
+    }
+    fib.setPaths( route_hop, std::move( paths ) );
+    return true;
+  } );
+}
+
+void Router::replace_route( const uint32_t route_prefix,
+                            const uint8_t prefix_length,
+                            const optional<Address> next_hop,
+                            const size_t interface_num )
+{
+  const NextHop hop = makeNextHop( next_hop.has_value() ? optional<uint32_t> { next_hop->ipv4_numeric() } : nullopt,
+                                    interface_num );
+
+  updateFib( [&]( Fib& fib ) {
+    const uint32_t route_index = fib.trie.find( route_prefix, prefix_length );
+    if( route_index == RouteTrie::NO_ROUTE ) {
+      fib.add( route_prefix, prefix_length, fib.intern( hop ) );
+    } else {
+      fib.releaseGroup( fib.routes[route_index].next_hop );
+      fib.routes[route_index].next_hop = fib.intern( hop );
+    }
+    return true;
+  } );
+}
+
+uint32_t Router::Fib::intern( const NextHop& next_hop )
+{
+  const uint64_t key = uint64_t { next_hop.address } | uint64_t { next_hop.interface_num } << 32;
+  const auto [it, inserted] = next_hop_ids.try_emplace( next_hop.direct ? ~key : key,
+                                                        static_cast<uint32_t>( next_hops.size() ) );
+  if( inserted ) {
+    next_hops.push_back( next_hop );
+  }
+  return it->second;
+}
+
+uint32_t Router::Fib::intern6( const NextHop6& next_hop )
+{
+  const auto it = find( next_hops6.begin(), next_hops6.end(), next_hop );
+  if( it != next_hops6.end() ) {
+    return static_cast<uint32_t>( it - next_hops6.begin() );
+  }
+  next_hops6.push_back( next_hop );
+  return static_cast<uint32_t>( next_hops6.size() - 1 );
+}
 
-  // Creating a new Routing Table Entry
+void Router::Fib::add( const uint32_t route_prefix, const uint8_t prefix_length, const uint32_t next_hop )
+{
   RoutingTableEntry entry;
   entry.route_prefix = route_prefix;
   entry.prefix_length = prefix_length;
   entry.next_hop = next_hop;
-  entry.interface_num = interface_num;
 
-  // Adding the Routing Table Entry to the Routing Table
-  RoutingTable.push_back( entry );
+  // Reusing the slot of a withdrawn route if there is one
+  uint32_t route_index = static_cast<uint32_t>( routes.size() );
+  if( free_slots.empty() ) {
+    routes.push_back( entry );
+  } else {
+    route_index = free_slots.back();
+    free_slots.pop_back();
+    routes[route_index] = entry;
+  }
+  trie.insert( entry.route_prefix, entry.prefix_length, route_index );
+}
+
+vector<uint32_t> Router::Fib::paths( const uint32_t next_hop ) const
+{
+  if( next_hop & MULTIPATH ) {
+    return groups[next_hop & ~MULTIPATH].paths;
+  }
+  return { next_hop };
+}
+
+void Router::Fib::setPaths( uint32_t& next_hop, vector<uint32_t> new_paths )
+{
+  if( new_paths.size() == 1 ) {
+    releaseGroup( next_hop );
+    next_hop = new_paths.front();
+    return;
+  }
+
+  // A route with a single next hop becomes multipath: a new group, with every bucket on that hop
+  if( not( next_hop & MULTIPATH ) ) {
+    uint32_t group_index = static_cast<uint32_t>( groups.size() );
+    if( free_groups.empty() ) {
+      groups.emplace_back();
+    } else {
+      group_index = free_groups.back();
+      free_groups.pop_back();
+    }
+    MultipathGroup& group = groups[group_index];
+    group.paths = { next_hop };
+    group.buckets.fill( next_hop );
+    next_hop = MULTIPATH | group_index;
+  }
+
+  rebalance( groups[next_hop & ~MULTIPATH], std::move( new_paths ) );
+}
+
+void Router::Fib::releaseGroup( const uint32_t next_hop )
+{
+  if( next_hop & MULTIPATH ) {
+    const uint32_t group_index = next_hop & ~MULTIPATH;
+    groups[group_index] = MultipathGroup();
+    free_groups.push_back( group_index );
+  }
+}
+
+void Router::rebalance( MultipathGroup& group, vector<uint32_t> paths )
+{
+  const size_t num_paths = paths.size();
+  const auto position = [&]( const uint32_t hop ) {
+    return static_cast<size_t>( ranges::find( paths, hop ) - paths.begin() );
+  };
+
+  // How many buckets each path has now
+  vector<size_t> owned( num_paths );
+  for( const uint32_t hop : group.buckets ) {
+    const size_t i = position( hop );
+    if( i < num_paths ) {
+      owned[i]++;
+    }
+  }
+
+  // Each path's fair share; the paths that have the most buckets now keep the odd ones over
+  vector<size_t> by_owned( num_paths );
+  for( size_t i = 0; i < num_paths; i++ ) {
+    by_owned[i] = i;
+  }
+  ranges::stable_sort( by_owned, [&]( const size_t a, const size_t b ) { return owned[a] > owned[b]; } );
+  vector<size_t> share( num_paths, MULTIPATH_BUCKETS / num_paths );
+  for( size_t k = 0; k < MULTIPATH_BUCKETS % num_paths; k++ ) {
+    share[by_owned[k]]++;
+  }
+
+  // Only the buckets of removed paths, and of paths over their share, move: to paths under it
+  size_t taker = 0;
+  for( uint32_t& hop : group.buckets ) {
+    const size_t i = position( hop );
+    if( i < num_paths and owned[i] <= share[i] ) {
+      continue;
+    }
+    if( i < num_paths ) {
+      owned[i]--;
+    }
+    while( owned[taker] >= share[taker] ) {
+      taker++;
+    }
+    hop = paths[taker];
+    owned[taker]++;
+  }
+
+  group.paths = std::move( paths );
 }
 
 void Router::route() {
 
+  PROFILE_SCOPE( route );
+
+  // One version of the FIB (and of the access-control list) is used for the whole run
+  const auto fib = RoutingTable->read();
+  const auto acl = Acl->read();
+
+  // Room for the adjacencies (and counters) of next hops added since the last run
+  NextHopAdjacencies.resize( fib->next_hops.size(), NetworkInterface::NO_ADJACENCY );
+  RouteBurst.path_datagrams.resize( fib->next_hops.size() );
+  RouteBurst.use_acl( *acl );
+  RouteBurst.use_sampling( SampleRate );
+
   // Iterating over all interfaces
   for( size_t i = 0; i < interfaces_.size(); i++ ) {
 
-    // Taking out the first datagram from the interface
-    optional<InternetDatagram> datagram = interfaces_[i].maybe_receive();
+    // Consuming every incoming datagram, a burst at a time
+    forwardFrom( i, RouteBurst, *fib, *acl, SendNow { *this } );
+
+    // Then its IPv6 datagrams
+    while( RouteBurst.fill6( interfaces_[i], *fib ) ) {
+      for( size_t k = 0; k < RouteBurst.datagrams6.size(); k++ ) {
+        IPv6View& datagram = RouteBurst.datagrams6[k];
+        const NextHop6* hop = forwardingHop6( datagram, *fib, RouteBurst.routes6[k] );
+        if( hop != nullptr ) {
+          const IPv6Address next_hop = hop->direct ? datagram.dst() : hop->address;
+          interfaces_[hop->interface_num].send_datagram6( std::move( datagram ), next_hop );
+          RouteBurst.record_latency();
+        }
+      }
+    }
+    
+  }
 
-    // Consuming every incoming datagram
-    while( datagram.has_value() ) {
+}
 
-      // Checking for the longest prefix match
-      RoutingTableEntry table_entry;
-      int longest_prefix_length = -999;
+void Router::CachedLookup::lookup( const span<const IPv4View> datagrams, const span<uint32_t> routes ) {
 
-      for( size_t j = 0; j < RoutingTable.size(); j++ ) {
+#ifdef LATENCY_HISTOGRAMS
+  burst.started = latency_clock_ns();
+#endif
 
-        if( isPrefixMatch( datagram->header.dst, RoutingTable[j].route_prefix, RoutingTable[j].prefix_length ) ) {
+  // First pass: the lookups, from the cache where possible, and from the trie all together otherwise
+  burst.destinations.clear();
+  burst.missed.clear();
+  for( size_t k = 0; k < datagrams.size(); k++ ) {
+    const uint32_t dst = datagrams[k].dst();
+    if( not burst.cache.find( dst, fib.generation, routes[k] ) ) {
+      burst.destinations.push_back( dst );
+      burst.missed.push_back( static_cast<uint32_t>( k ) );
+    }
+  }
 
-          if( RoutingTable[j].prefix_length > longest_prefix_length ) {
-            longest_prefix_length = RoutingTable[j].prefix_length;
-            table_entry = RoutingTable[j];
-          }
-        }
-      }
+  if( not burst.missed.empty() ) {
+    burst.missed_routes.resize( burst.missed.size() );
+    fib.trie.lookup_batch( burst.destinations, burst.missed_routes );
+    for( size_t j = 0; j < burst.missed.size(); j++ ) {
+      routes[burst.missed[j]] = burst.missed_routes[j];
+      burst.cache.store( burst.destinations[j], fib.generation, burst.missed_routes[j] );
+    }
+  }
+}
+
+template<class Output>
+void Router::Forward<Output>::forward( IPv4View& datagram, const uint32_t route ) {
 
-      // If longest_prefix_length is less than 0, then no match was found ...
-      // ... and we should drop and move to the next datagram
-      // Otherwise, we should process it
-      if( longest_prefix_length >= 0) {
+  // Routing it (dropped if there is no route or the TTL has expired)
+  const RoutingTableEntry* table_entry = router.forwardingEntry( datagram, fib, route );
+  if( table_entry == nullptr ) {
+    return;
+  }
 
-        // Checking the TTL field of the datagram
-        // If the TTL field is 0 or 1, then we should drop the datagram
-        // Otherwise, we should process it
-        if( datagram->header.ttl > 1 ) {
+  if( not router.Flows.empty() ) {
+    router.recordFlow( in, datagram );
+  }
 
-          // Decrementing the TTL field
-          datagram->header.ttl--;
+  const uint32_t hop_index = fib.select( *table_entry, datagram );
+  const NextHop& hop = fib.next_hops[hop_index];
+  burst.path_datagrams[hop_index]++;
 
-          // Recomputing the checksum
-          datagram->header.compute_checksum();
+  if( burst.sampling.due() ) [[unlikely]] {
+    router.sample( in, datagram, *table_entry, hop.interface_num );
+  }
 
-          // If the next_hop field is empty, then the network is directly attached to the router
-          // In this case, the next_hop address should be the datagram's final destination
-          if( table_entry.next_hop.has_value() ) {
-            interfaces_[table_entry.interface_num].send_datagram( *datagram, table_entry.next_hop.value() );
-          } else {
-            interfaces_[table_entry.interface_num].send_datagram( *datagram, Address::from_ipv4_numeric( datagram->header.dst ) );
+  // The router owns the datagram from here on, so it is moved (not copied) to its interface
+  output( datagram, hop_index, hop );
+  burst.record_latency();
+}
+
+void Router::SendNow::operator()( IPv4View& datagram, const uint32_t hop_index, const NextHop& hop ) {
+
+  AsyncNetworkInterface& out = router.interfaces_[hop.interface_num];
+
+  // If the network is directly attached to the router, the next hop address
+  // should be the datagram's final destination
+  if( not hop.direct ) {
+    // Sending through the next hop's adjacency (its neighbor entry), looked up once
+    uint32_t& adjacency = router.NextHopAdjacencies[hop_index];
+    if( adjacency == NetworkInterface::NO_ADJACENCY ) {
+      adjacency = out.adjacency( hop.address );
+    }
+    out.send_to_adjacency( std::move( datagram ), adjacency );
+  } else {
+    const uint32_t dst = datagram.dst();
+    out.send_datagram( std::move( datagram ), dst );
+  }
+}
+
+void Router::ToOutboxes::operator()( IPv4View& datagram, const uint32_t /* hop_index */, const NextHop& hop ) {
+  const uint32_t next_hop = hop.direct ? datagram.dst() : hop.address;
+  outboxes[hop.interface_num].push_back( { std::move( datagram ), next_hop } );
+}
+
+template<class Output>
+void Router::forwardFrom( const size_t in, Burst& burst, const Fib& fib, const AclVersion& acl, Output output ) {
+
+  const CachedLookup lookup { burst, fib };
+  const Forward<Output> forward { *this, fib, burst, in, std::move( output ) };
+
+  // (one loop for each filter, so that an empty list costs nothing per datagram)
+  if( acl.classifier.empty() ) {
+    ForwardingPipeline pipeline { lookup, PermitAll {}, forward };
+    pipeline.drain( interfaces_[in], burst.datagrams, burst.routes, ROUTE_BURST );
+  } else {
+    ForwardingPipeline pipeline { lookup, AclFilter { *this, acl, burst }, forward };
+    pipeline.drain( interfaces_[in], burst.datagrams, burst.routes, ROUTE_BURST );
+  }
+}
+
+bool Router::Burst::fill6( AsyncNetworkInterface& interface, const Fib& fib ) {
+
+#ifdef LATENCY_HISTOGRAMS
+  started = latency_clock_ns();
+#endif
+
+  datagrams6.clear();
+  if( interface.maybe_receive_views6( datagrams6, ROUTE_BURST ) == 0 ) {
+    return false;
+  }
+
+  destinations6.clear();
+  for( const IPv6View& datagram : datagrams6 ) {
+    destinations6.push_back( datagram.dst() );
+  }
+  routes6.resize( datagrams6.size() );
+  fib.trie6.lookup_batch( destinations6, routes6 );
+  return true;
+}
+
+DestinationCache::Stats Router::destination_cache_stats() const {
+  DestinationCache::Stats total = RouteBurst.cache.stats();
+  for( const auto& burst : WorkerBursts ) {
+    total.hits += burst.cache.stats().hits;
+    total.misses += burst.cache.stats().misses;
+  }
+  return total;
+}
+
+LatencyHistogram Router::route_latency() const {
+  LatencyHistogram total;
+#ifdef LATENCY_HISTOGRAMS
+  total.merge( RouteBurst.latency );
+  for( const auto& burst : WorkerBursts ) {
+    total.merge( burst.latency );
+  }
+#endif
+  return total;
+}
+
+void Router::print_latency( ostream& out ) const {
+  if constexpr( not LATENCY_HISTOGRAMS_ENABLED ) {
+    out << "latency histograms are not compiled in (build with -DLATENCY_HISTOGRAMS=ON)\n";
+    return;
+  }
+  route_latency().print( out, "route" );
+  for( size_t i = 0; i < interfaces_.size(); i++ ) {
+    interfaces_[i].send_latency().print( out, "interface " + to_string( i ) + " send_datagram" );
+    interfaces_[i].recv_latency().print( out, "interface " + to_string( i ) + " recv_frame" );
+  }
+}
+
+vector<Router::PathStats> Router::path_stats() const {
+  const auto fib = RoutingTable->read();
+  vector<PathStats> paths( fib->next_hops.size() );
+  for( size_t i = 0; i < paths.size(); i++ ) {
+    const NextHop& hop = fib->next_hops[i];
+    paths[i].next_hop = hop.direct ? nullopt : optional<uint32_t> { hop.address };
+    paths[i].interface_num = hop.interface_num;
+  }
+
+  const auto add_counts = [&]( const Burst& burst ) {
+    for( size_t i = 0; i < burst.path_datagrams.size() and i < paths.size(); i++ ) {
+      paths[i].datagrams += burst.path_datagrams[i];
+    }
+  };
+  add_counts( RouteBurst );
+  for( const auto& burst : WorkerBursts ) {
+    add_counts( burst );
+  }
+  return paths;
+}
+
+void Router::set_acl( const span<const AclRule> rules, const AclRule::Action default_action ) {
+  LOG_DEBUG( "setting an access-control list of ", rules.size(), " rule(s)" );
+
+  // Compiled before the swap, so that routing is not held up by it
+  AclClassifier classifier { rules, default_action };
+  Acl->replace( [&]( const AclVersion& old ) {
+    return AclVersion { std::move( classifier ), old.generation + 1 };
+  } );
+}
+
+vector<uint64_t> Router::acl_hits() const {
+  const auto acl = Acl->read();
+  vector<uint64_t> hits( acl->classifier.rules().size() );
+
+  const auto add_counts = [&]( const Burst& burst ) {
+    if( burst.acl_generation != acl->generation ) {
+      return;
+    }
+    for( size_t i = 0; i < hits.size(); i++ ) {
+      hits[i] += burst.acl_hits[i];
+    }
+  };
+  add_counts( RouteBurst );
+  for( const auto& burst : WorkerBursts ) {
+    add_counts( burst );
+  }
+  return hits;
+}
+
+shared_ptr<NeighborTable> Router::share_neighbors( const span<const size_t> interface_nums ) {
+  auto table = make_shared<NeighborTable>();
+  for( const size_t num : interface_nums ) {
+    interfaces_.at( num ).set_neighbor_table( table );
+  }
+  return table;
+}
+
+Router::Stats Router::stats() const {
+  Stats snapshot {};
+  snapshot.forwarded = Counters.sum( Counter::FORWARDED );
+  snapshot.no_route = Counters.sum( Counter::NO_ROUTE );
+  snapshot.ttl_expired = Counters.sum( Counter::TTL_EXPIRED );
+  snapshot.acl_denied = Counters.sum( Counter::ACL_DENIED );
+  for( const auto& interface : interfaces_ ) {
+    snapshot.parse_errors += interface.stats().rx_parse_errors;
+    snapshot.rx_ring_full += interface.rx_dropped();
+  }
+  return snapshot;
+}
+
+void Router::track_flows( const size_t memory_budget, const uint64_t idle_timeout ) {
+  FlowMemoryBudget = memory_budget;
+  FlowIdleTimeout = idle_timeout;
+  Flows.clear();
+  for( size_t i = 0; i < interfaces_.size(); i++ ) {
+    Flows.emplace_back( memory_budget, idle_timeout );
+  }
+  LOG_INFO( "tracking flows in ", memory_budget, " bytes per interface, idle timeout ", idle_timeout, " ms" );
+}
+
+vector<vector<FlowTable::Flow>> Router::flows() const {
+  vector<vector<FlowTable::Flow>> flows( Flows.size() );
+  for( size_t i = 0; i < Flows.size(); i++ ) {
+    Flows[i].for_each( [&]( const FlowTable::Flow& flow ) { flows[i].push_back( flow ); } );
+  }
+  return flows;
+}
+
+FlowTable::Stats Router::flow_stats() const {
+  FlowTable::Stats total {};
+  for( const FlowTable& table : Flows ) {
+    const FlowTable::Stats stats = table.stats();
+    total.active += stats.active;
+    total.capacity += stats.capacity;
+    total.created += stats.created;
+    total.expired += stats.expired;
+    total.rejected += stats.rejected;
+  }
+  return total;
+}
+
+void Router::tick( const size_t ms_since_last_tick ) {
+  CurrentTime += ms_since_last_tick;
+  for( auto& interface : interfaces_ ) {
+    interface.tick( ms_since_last_tick );
+  }
+  for( FlowTable& table : Flows ) {
+    table.expire( CurrentTime );
+  }
+}
+
+void Router::Burst::use_sampling( const uint32_t rate ) {
+  if( sampling.rate() != rate ) {
+    random_device seed;
+    sampling.reset( rate, ( uint64_t { seed() } << 32 ) | seed() );
+  }
+}
+
+void Router::sample( const size_t in,
+                     const IPv4View& datagram,
+                     const RoutingTableEntry& entry,
+                     const uint32_t out_interface ) {
+  PacketSample sample;
+  sample.captured = static_cast<uint16_t>( datagram.copy_to( sample.header ) );
+  sample.length = static_cast<uint32_t>( datagram.size() );
+  sample.in_interface = static_cast<uint32_t>( in );
+  sample.out_interface = out_interface;
+  sample.prefix = entry.route_prefix;
+  sample.prefix_length = entry.prefix_length;
+  sample.time = CurrentTime;
+  Sampler->submit( in, std::move( sample ) );
+}
+
+void Router::start_sampling( const uint32_t one_in_n,
+                             PacketSampler::Exporter exporter,
+                             const size_t ring_capacity ) {
+  Sampler.reset();
+  Sampler = make_unique<PacketSampler>( interfaces_.size(), ring_capacity, std::move( exporter ) );
+  SampleRate = max<uint32_t>( one_in_n, 1 );
+  LOG_INFO( "sampling 1 in ", SampleRate, " forwarded datagrams" );
+}
+
+PacketSampler::Stats Router::stop_sampling() {
+  if( Sampler == nullptr ) {
+    return {};
+  }
+  Sampler->stop();
+  const PacketSampler::Stats stats = Sampler->stats();
+  Sampler.reset();
+  SampleRate = 0;
+  LOG_INFO( "stopped sampling: ", stats.sampled, " sampled, ", stats.dropped, " dropped, ", stats.exported, " exported" );
+  return stats;
+}
+
+PacketSampler::Stats Router::sampling_stats() const {
+  return Sampler != nullptr ? Sampler->stats() : PacketSampler::Stats {};
+}
+
+void Router::set_worker_cpus( vector<int> cpus ) {
+  // (checked now, rather than when the workers restart)
+  if( not cpus_allowed( cpus ) ) {
+    throw runtime_error( "Router::set_worker_cpus: CPU not available" );
+  }
+  WorkerCpus = std::move( cpus );
+  LOG_INFO( "route_parallel() workers pinned to ", WorkerCpus.size(), " CPU(s)" );
+}
+
+void Router::route_parallel( const size_t num_workers ) {
+
+  const size_t num_interfaces = interfaces_.size();
+
+  // Nothing to parallelize
+  if( num_workers <= 1 or num_interfaces <= 1 ) {
+    route();
+    return;
+  }
+
+  PROFILE_SCOPE( route );
+
+  // (Re)starting the workers if their number (or placement) changed
+  if( Workers == nullptr or Workers->size() != num_workers or Workers->cpus() != WorkerCpus ) {
+    Workers.reset();
+    Workers = make_unique<WorkerPool>( num_workers, WorkerCpus );
+  }
+
+  // One version of the FIB (and of the access-control list) is used for the whole run (the
+  // workers share the caller's view)
+  const auto fib = RoutingTable->read();
+  const auto acl = Acl->read();
+
+  // One outbox per (inbound, outbound) interface pair; they keep their capacity between calls
+  Outboxes.resize( num_interfaces );
+  for( auto& outbox : Outboxes ) {
+    outbox.resize( num_interfaces );
+  }
+  Outboxes6.resize( num_interfaces );
+  for( auto& outbox : Outboxes6 ) {
+    outbox.resize( num_interfaces );
+  }
+
+  WorkerBursts.resize( num_workers );
+  for( auto& burst : WorkerBursts ) {
+    burst.path_datagrams.resize( fib->next_hops.size() );
+    burst.use_acl( *acl );
+    burst.use_sampling( SampleRate );
+  }
+
+  // Phase 1: each worker drains and routes the datagrams received on its own interfaces
+  Workers->run( [&]( const size_t worker ) {
+    Burst& burst = WorkerBursts[worker];
+    for( size_t i = worker; i < num_interfaces; i += num_workers ) {
+      forwardFrom( i, burst, *fib, *acl, ToOutboxes { Outboxes[i] } );
+      while( burst.fill6( interfaces_[i], *fib ) ) {
+        for( size_t k = 0; k < burst.datagrams6.size(); k++ ) {
+          IPv6View& datagram = burst.datagrams6[k];
+          const NextHop6* hop = forwardingHop6( datagram, *fib, burst.routes6[k] );
+          if( hop != nullptr ) {
+            const IPv6Address next_hop = hop->direct ? datagram.dst() : hop->address;
+            Outboxes6[i][hop->interface_num].push_back( { std::move( datagram ), next_hop } );
+            burst.record_latency();
           }
-          
         }
+      }
+    }
+  } );
 
+  // Phase 2: each worker sends what was routed to its own interfaces, in inbound-interface order
+  Workers->run( [&]( const size_t worker ) {
+    for( size_t out = worker; out < num_interfaces; out += num_workers ) {
+      for( size_t in = 0; in < num_interfaces; in++ ) {
+        for( PendingForward& pending : Outboxes[in][out] ) {
+          interfaces_[out].send_datagram( std::move( pending.datagram ), pending.next_hop );
+        }
+        Outboxes[in][out].clear();
+        for( PendingForward6& pending : Outboxes6[in][out] ) {
+          interfaces_[out].send_datagram6( std::move( pending.datagram ), pending.next_hop );
+        }
+        Outboxes6[in][out].clear();
       }
-      
-      // Checking for the next datagram
-      datagram = interfaces_[i].maybe_receive();
     }
-    
+  } );
+
+}
+
+const Router::RoutingTableEntry* Router::forwardingEntry( IPv4View& datagram,
+                                                         const Fib& fib,
+                                                         const uint32_t route_index ) {
+
+  // If no route was found by the longest prefix match, we should drop the datagram
+  if( route_index == RouteTrie::NO_ROUTE ) {
+    Counters.add( Counter::NO_ROUTE );
+    return nullptr;
+  }
+
+  // Checking the TTL field of the datagram
+  // If the TTL field is 0 or 1, then we should drop the datagram
+  if( datagram.ttl() <= 1 ) {
+    Counters.add( Counter::TTL_EXPIRED );
+    return nullptr;
   }
 
+  Counters.add( Counter::FORWARDED );
+
+  // Decrementing the TTL field
+  // (in the datagram's own bytes, the checksum adjusted incrementally)
+  datagram.decrement_ttl();
+
+  return &fib.routes[route_index];
+}
+
+const Router::NextHop6* Router::forwardingHop6( IPv6View& datagram, const Fib& fib, const uint32_t route ) {
+
+  if( route == RouteTrie6::NO_ROUTE ) {
+    Counters.add( Counter::NO_ROUTE );
+    return nullptr;
+  }
+
+  // A hop limit of 0 or 1 has run out, as a TTL does
+  if( datagram.hop_limit() <= 1 ) {
+    Counters.add( Counter::TTL_EXPIRED );
+    return nullptr;
+  }
+
+  Counters.add( Counter::FORWARDED );
+  datagram.decrement_hop_limit();
+  return &fib.next_hops6[route];
+}
+
+bool Router::aclPermits( const IPv4View& datagram, const AclVersion& acl, Burst& burst ) {
+
+  if( acl.classifier.empty() ) {
+    return true;
+  }
+
+  const size_t rule = acl.classifier.match( datagram.header() );
+  if( rule != AclClassifier::NO_MATCH ) {
+    burst.acl_hits[rule]++;
+  }
+  if( acl.classifier.action( rule ) == AclRule::Action::DENY ) {
+    Counters.add( Counter::ACL_DENIED );
+    return false;
+  }
+  return true;
+}
+
+Router::NextHop Router::makeNextHop( const optional<uint32_t>& next_hop, const size_t interface_num ) {
+  NextHop hop {};
+  hop.address = next_hop.value_or( 0 );
+  hop.interface_num = static_cast<uint32_t>( interface_num );
+  hop.direct = not next_hop.has_value();
+  return hop;
 }
 
 
@@ -1,24 +1,98 @@
 #pragma once
 
+#include "acl.hh"
+#include "counters.hh"
+#include "crc32c.hh"
+#include "destination_cache.hh"
+#include "flow_table.hh"
+#include "forwarding_pipeline.hh"
+#include "latency.hh"
+#include "left_right.hh"
 #include "network_interface.hh"
+#include "packet_sampler.hh"
+#include "rcu.hh"
+#include "ring_buffer.hh"
+#include "route_trie.hh"
+#include "route_trie6.hh"
+#include "worker_pool.hh"
 
+#include <array>
+#include <memory>
 #include <optional>
-#include <queue>
+#include <ostream>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 // A wrapper for NetworkInterface that makes the host-side
 // interface asynchronous: instead of returning received datagrams
 // immediately (from the `recv_frame` method), it stores them for
 // later retrieval. Otherwise, behaves identically to the underlying
 // implementation of NetworkInterface.
+//
+// Received datagrams are kept in a bounded single-producer/single-consumer ring, and datagrams
+// to be sent can be queued on a bounded multi-producer ring (enqueue_send), so the interface can
+// be split across threads without locks: one I/O thread owns the NetworkInterface itself (it calls
+// recv_frame, tick, flush_sends and maybe_send), one forwarding thread calls maybe_receive, and any
+// number of forwarding threads call enqueue_send. Without threads, it behaves as before, except that
+// a datagram received while the receive ring is full is dropped (and counted).
+//
+// An interface of a router is put in forwarding mode (set_forwarding), in which received datagrams
+// are not decoded but kept as views of the bytes they arrived in (see IPv4View), on a ring of
+// their own that the router drains with maybe_receive_views() (and IPv6 datagrams, as IPv6Views,
+// on another, drained with maybe_receive_views6()).
 class AsyncNetworkInterface : public NetworkInterface
 {
-  std::queue<InternetDatagram> datagrams_in_ {};
+public:
+  static constexpr size_t DEFAULT_RX_CAPACITY = 4096; // received datagrams held, at most
+  static constexpr size_t DEFAULT_TX_CAPACITY = 1024; // datagrams queued by enqueue_send, at most
+
+private:
+  // A datagram queued by enqueue_send()
+  struct OutboundDatagram
+  {
+    InternetDatagram datagram {};
+    uint32_t next_hop {};
+  };
+
+  // Held by pointer so that the interface stays movable (the rings themselves are not)
+  std::unique_ptr<SpscRing<InternetDatagram>> datagrams_in_ {
+    std::make_unique<SpscRing<InternetDatagram>>( DEFAULT_RX_CAPACITY ) };
+  std::unique_ptr<MpscRing<OutboundDatagram>> datagrams_out_ {
+    std::make_unique<MpscRing<OutboundDatagram>>( DEFAULT_TX_CAPACITY ) };
+  uint64_t rx_dropped_ {};
+  std::vector<OutboundDatagram> flush_batch_ {};
+  size_t rx_capacity_ { DEFAULT_RX_CAPACITY }; // of each receive ring
+
+  // Received datagrams, in forwarding mode (which creates the rings)
+  std::unique_ptr<SpscRing<IPv4View>> views_in_ {};
+  std::unique_ptr<SpscRing<IPv6View>> views6_in_ {};
 
 public:
   using NetworkInterface::NetworkInterface;
 
   // Construct from a NetworkInterface
-  explicit AsyncNetworkInterface( NetworkInterface&& interface ) : NetworkInterface( interface ) {}
+  explicit AsyncNetworkInterface( NetworkInterface&& interface ) : NetworkInterface( std::move( interface ) ) {}
+
+  // Copying (which copies any queued datagrams) is only safe while no other thread is using either interface
+  AsyncNetworkInterface( const AsyncNetworkInterface& other )
+    : NetworkInterface( other )
+    , datagrams_in_( std::make_unique<SpscRing<InternetDatagram>>( *other.datagrams_in_ ) )
+    , datagrams_out_( std::make_unique<MpscRing<OutboundDatagram>>( *other.datagrams_out_ ) )
+    , rx_dropped_( other.rx_dropped_ )
+    , rx_capacity_( other.rx_capacity_ )
+    , views_in_( other.views_in_ ? std::make_unique<SpscRing<IPv4View>>( *other.views_in_ ) : nullptr )
+    , views6_in_( other.views6_in_ ? std::make_unique<SpscRing<IPv6View>>( *other.views6_in_ ) : nullptr )
+  {}
+  AsyncNetworkInterface& operator=( const AsyncNetworkInterface& other )
+  {
+    AsyncNetworkInterface copy { other };
+    return *this = std::move( copy );
+  }
+  AsyncNetworkInterface( AsyncNetworkInterface&& other ) = default;
+  AsyncNetworkInterface& operator=( AsyncNetworkInterface&& other ) = default;
+  ~AsyncNetworkInterface() = default;
 
   // \brief Receives and Ethernet frame and responds appropriately.
 
@@ -29,22 +103,101 @@ public:
   // \param[in] frame the incoming Ethernet frame
   void recv_frame( const EthernetFrame& frame )
   {
+    if ( views_in_ and frame.header.type == EthernetHeader::TYPE_IPv6 ) {
+      auto optional_view = NetworkInterface::recv_frame_view6( frame );
+      if ( optional_view.has_value() and not views6_in_->push( std::move( optional_view.value() ) ) ) {
+        rx_dropped_++;
+      }
+      return;
+    }
+    if ( views_in_ ) {
+      auto optional_view = NetworkInterface::recv_frame_view( frame );
+      if ( optional_view.has_value() and not views_in_->push( std::move( optional_view.value() ) ) ) {
+        rx_dropped_++;
+      }
+      return;
+    }
     auto optional_dgram = NetworkInterface::recv_frame( frame );
-    if ( optional_dgram.has_value() ) {
-      datagrams_in_.push( std::move( optional_dgram.value() ) );
+    if ( optional_dgram.has_value() and not datagrams_in_->push( std::move( optional_dgram.value() ) ) ) {
+      rx_dropped_++;
     }
   };
 
   // Access queue of Internet datagrams that have been received
-  std::optional<InternetDatagram> maybe_receive()
+  std::optional<InternetDatagram> maybe_receive() { return datagrams_in_->pop(); }
+
+  // Append up to `max_datagrams` received datagrams to `out`; returns how many were appended
+  size_t maybe_receive_batch( std::vector<InternetDatagram>& out, size_t max_datagrams = SIZE_MAX )
+  {
+    return datagrams_in_->pop_batch( out, max_datagrams );
+  }
+
+  // Keep received datagrams as views, to be forwarded (or, turning it off, decode them again).
+  // Must not be called while other threads are using the interface.
+  void set_forwarding( const bool forwarding )
+  {
+    if ( not forwarding ) {
+      views_in_.reset();
+      views6_in_.reset();
+    } else if ( not views_in_ ) {
+      views_in_ = std::make_unique<SpscRing<IPv4View>>( rx_capacity_ );
+      views6_in_ = std::make_unique<SpscRing<IPv6View>>( rx_capacity_ );
+    }
+  }
+  bool forwarding() const { return views_in_ != nullptr; }
+
+  // Replace the receive rings with rings of `rx_capacity` datagrams, and the send queue with one
+  // of `tx_capacity` (e.g. to fit many interfaces in memory), dropping whatever they held. Must
+  // not be called while other threads are using the interface.
+  void set_ring_capacities( const size_t rx_capacity, const size_t tx_capacity )
+  {
+    rx_capacity_ = rx_capacity;
+    datagrams_in_ = std::make_unique<SpscRing<InternetDatagram>>( rx_capacity );
+    datagrams_out_ = std::make_unique<MpscRing<OutboundDatagram>>( tx_capacity );
+    if ( views_in_ ) {
+      views_in_ = std::make_unique<SpscRing<IPv4View>>( rx_capacity );
+      views6_in_ = std::make_unique<SpscRing<IPv6View>>( rx_capacity );
+    }
+  }
+
+  // Append up to `max_views` datagrams received in forwarding mode to `out`; returns how many
+  // were appended
+  size_t maybe_receive_views( std::vector<IPv4View>& out, size_t max_views = SIZE_MAX )
   {
-    if ( datagrams_in_.empty() ) {
-      return {};
+    return views_in_ ? views_in_->pop_batch( out, max_views ) : 0;
+  }
+
+  // Same, for IPv6 datagrams (which forwarding mode keeps on a ring of their own)
+  size_t maybe_receive_views6( std::vector<IPv6View>& out, size_t max_views = SIZE_MAX )
+  {
+    return views6_in_ ? views6_in_->pop_batch( out, max_views ) : 0;
+  }
+
+  // Datagrams dropped by recv_frame() because the receive ring was full
+  uint64_t rx_dropped() const { return rx_dropped_; }
+
+  // Queue a datagram to be sent (by a later flush_sends) to the given next hop. Safe to call from
+  // any number of threads at once. Returns false, leaving `dgram` alone, if the queue is full.
+  bool enqueue_send( InternetDatagram&& dgram, const uint32_t next_hop )
+  {
+    OutboundDatagram outbound { std::move( dgram ), next_hop };
+    if ( datagrams_out_->push( std::move( outbound ) ) ) {
+      return true;
     }
+    dgram = std::move( outbound.datagram );
+    return false;
+  }
 
-    InternetDatagram datagram = std::move( datagrams_in_.front() );
-    datagrams_in_.pop();
-    return datagram;
+  // Send (with send_datagram) everything queued by enqueue_send(); returns how many were sent.
+  // Must be called on the thread that owns the interface.
+  size_t flush_sends()
+  {
+    flush_batch_.clear();
+    const size_t count = datagrams_out_->pop_batch( flush_batch_ );
+    for ( auto& outbound : flush_batch_ ) {
+      send_datagram( std::move( outbound.datagram ), outbound.next_hop );
+    }
+    return count;
   }
 };
 
@@ -57,39 +210,369 @@ class Router
 
   // -- My Data structures --
 
-  // Routing Table Entry
+  // Where a route sends its datagrams. Next hops are interned (see Fib::next_hops), so that
+  // the many routes through the same neighbor share one.
+  struct NextHop {
+    // The raw IP address of the next hop (unused for a direct route)
+    uint32_t address;
+    // Interface number
+    uint32_t interface_num;
+    // The network is directly attached to the router: the next hop is the datagram's destination
+    bool direct;
+
+    bool operator==( const NextHop& other ) const = default;
+  };
+
+  // Where an IPv6 route sends its datagrams (interned in Fib::next_hops6, as NextHop is)
+  struct NextHop6 {
+    // The IPv6 address of the next hop (unused for a direct route)
+    IPv6Address address;
+    // Interface number
+    uint32_t interface_num;
+    // The network is directly attached to the router: the next hop is the datagram's destination
+    bool direct;
+
+    bool operator==( const NextHop6& other ) const = default;
+  };
+
+  // Marks a RoutingTableEntry::next_hop that names a multipath group rather than a next hop
+  static constexpr uint32_t MULTIPATH = 1U << 31;
+
+  // Routing Table Entry (12 bytes)
   struct RoutingTableEntry {
     // Route prefix
     uint32_t route_prefix;
+    // Index of the route's next hop in Fib::next_hops, or MULTIPATH | the index of its
+    // group of equal-cost paths in Fib::groups
+    uint32_t next_hop;
     // Prefix length
     uint8_t prefix_length;
-    // The IP address of the next hop. Will be empty if the network is directly attached to the router
-    std::optional<Address> next_hop;
-    // Interface number
-    size_t interface_num;
 
     // Default constructor initializes members to safe defaults.
     RoutingTableEntry()
         : route_prefix(0),
-          prefix_length(0),
-          next_hop(std::nullopt),
-          interface_num(0) { }
+          next_hop(0),
+          prefix_length(0) { }
+  };
+
+public:
+  // Flow-hash buckets of a multipath route
+  static constexpr size_t MULTIPATH_BUCKETS = 256;
+
+private:
+  // The equal-cost paths of a multipath route. A datagram's flow (source, destination and
+  // protocol) hashes to one of the buckets, which says which path it takes. Paths are added and
+  // removed by moving as few buckets as possible (resilient hashing): a new path takes its share
+  // of buckets from the others, and the buckets of a removed path are shared out among the rest,
+  // so every other flow stays on its path.
+  struct MultipathGroup {
+    std::vector<uint32_t> paths {};                      // next hop indices, in the order added
+    std::array<uint32_t, MULTIPATH_BUCKETS> buckets {}; // next hop index of each bucket
+  };
+
+  // One version of the forwarding information base (FIB)
+  struct Fib {
+    // Routing Table (slots listed in free_slots are unused; on huge pages once it is large)
+    HugePageVector<RoutingTableEntry> routes {};
+    std::vector<uint32_t> free_slots {};
+
+    // Every next hop used so far, indexed by routes[].next_hop. Only ever appended to (and
+    // carried over to every new version), so an index always names the same next hop.
+    std::vector<NextHop> next_hops {};
+    std::unordered_map<uint64_t, uint32_t> next_hop_ids {};
+
+    // Groups of the multipath routes (slots listed in free_groups are unused)
+    std::vector<MultipathGroup> groups {};
+    std::vector<uint32_t> free_groups {};
+
+    // Forwarding table: longest-prefix-match trie over routes (stores indices into it)
+    RouteTrie trie {};
+
+    // IPv6 forwarding table, whose routes are the indices of their next hops in next_hops6
+    // (IPv6 routes have no multipath groups). Next hops are only ever appended, as next_hops are.
+    RouteTrie6 trie6 {};
+    std::vector<NextHop6> next_hops6 {};
+
+    // Bumped by every change, so that cached lookups from older versions are ignored
+    uint64_t generation { 1 };
+
+    // Index of a next hop in next_hops (added if it is new)
+    uint32_t intern( const NextHop& next_hop );
+
+    // Index of an IPv6 next hop in next_hops6 (added if it is new; there are few, so they are
+    // searched rather than hashed)
+    uint32_t intern6( const NextHop6& next_hop );
+
+    // Store a route for a prefix that has none yet
+    void add( uint32_t route_prefix, uint8_t prefix_length, uint32_t next_hop );
+
+    // The next hop index a datagram takes on a route (for a multipath route, the path its flow
+    // hashes to)
+    uint32_t select( const RoutingTableEntry& entry, const IPv4View& datagram ) const {
+      if( not( entry.next_hop & MULTIPATH ) ) {
+        return entry.next_hop;
+      }
+      return groups[entry.next_hop & ~MULTIPATH].buckets[flowHash( datagram ) % MULTIPATH_BUCKETS];
+    }
+
+    // The next hop indices of a route's paths
+    std::vector<uint32_t> paths( uint32_t next_hop ) const;
+
+    // Give a route (whose RoutingTableEntry::next_hop is `next_hop`) the paths `paths` (at
+    // least one), moving as few flows as possible
+    void setPaths( uint32_t& next_hop, std::vector<uint32_t> paths );
+
+    // Free a route's group, if it has one
+    void releaseGroup( uint32_t next_hop );
+  };
+
+  // Hash of a datagram's flow: CRC-32C of its source, destination and protocol (so that the
+  // fragments of a datagram, and every datagram of a connection, take the same path)
+  static uint32_t flowHash( const IPv4View& datagram ) {
+    return crc32c_extend( crc32c_extend( crc32c_extend( ~0U, datagram.src() ), datagram.dst() ), datagram.proto() );
+  }
+
+  // Reassign the buckets of `group` so that `paths` share them evenly, moving as few as possible
+  static void rebalance( MultipathGroup& group, std::vector<uint32_t> paths );
+
+  // The current FIB, kept as a left-right pair: route() reads one copy for its whole run without
+  // locking, while add_route(), remove_route(), replace_route() and RouteUpdate::commit() change
+  // the other and switch (possibly from other threads), so that a change costs what it changes
+  // rather than a copy of the whole table. Held by pointer so that the Router stays movable.
+  std::unique_ptr<LeftRight<Fib>> RoutingTable;
+
+  // Publish a new version of the FIB, if `change` returns true. `change` is applied to both
+  // copies of the FIB in turn, so it must leave a copy as it was when it returns false.
+  template<class F>
+  bool updateFib( F&& change ) {
+    return RoutingTable->update( [&change]( Fib& fib ) {
+      if( not change( fib ) ) {
+        return false;
+      }
+      fib.generation++;
+      return true;
+    } );
+  }
+
+  // -- Access control --
+
+  // One version of the access-control list (each new list gets a new generation)
+  struct AclVersion {
+    AclClassifier classifier {};
+    uint64_t generation {};
   };
 
-  // Routing Table
-  std::vector<RoutingTableEntry> RoutingTable;
+  // The current access-control list, applied to every datagram before it is routed. Replaced
+  // whole by set_acl() (by read-copy-update, as for the FIB), so route() sees one list for its
+  // whole run.
+  std::unique_ptr<Rcu<AclVersion>> Acl;
+
+  // -- Burst routing --
+
+  // Datagrams taken from an interface at a time by route(); their lookups are done as one batch
+  static constexpr size_t ROUTE_BURST = 32;
+
+  // Scratch space for one burst (kept between calls so that it does not reallocate)
+  struct Burst {
+    std::vector<IPv4View> datagrams {};
+    std::vector<uint32_t> destinations {};
+    std::vector<uint32_t> routes {};
+
+    // Recently looked-up destinations (each burst has its own, so workers never share one)
+    DestinationCache cache {};
+    std::vector<uint32_t> missed {};        // positions in the burst that missed the cache
+    std::vector<uint32_t> missed_routes {}; // ... and their routes, from the trie
+
+    // Datagrams forwarded through each next hop, by next hop index
+    std::vector<uint64_t> path_datagrams {};
+
+    // Datagrams that matched each rule of the access-control list of generation acl_generation
+    std::vector<uint64_t> acl_hits {};
+    uint64_t acl_generation {};
+
+    // Start counting for `acl`, if the counts so far are for another list
+    void use_acl( const AclVersion& acl ) {
+      if( acl_generation != acl.generation ) {
+        acl_hits.assign( acl.classifier.rules().size(), 0 );
+        acl_generation = acl.generation;
+      }
+    }
+
+    // Time from the start of a burst's lookups to each of its datagrams being handed to its
+    // outbound interface (empty unless built with LATENCY_HISTOGRAMS)
+    [[no_unique_address]] LatencyRecorder latency {};
+    uint64_t started {};
+
+    // Record the latency of one datagram of the burst, now that it has been handed off
+    void record_latency() {
+#ifdef LATENCY_HISTOGRAMS
+      latency.record( latency_clock_ns() - started );
+#endif
+    }
+
+    // Picks the datagrams of the burst's interfaces to sample (see start_sampling())
+    SampleCountdown sampling {};
+
+    // Sample 1 in `rate` datagrams, if the countdown is for another rate
+    void use_sampling( uint32_t rate );
+
+    // Take up to ROUTE_BURST IPv6 datagrams from `interface` and look up all of their routes
+    // together in the IPv6 trie (IPv4 bursts are taken by a ForwardingPipeline, see forwardFrom()).
+    // Returns false if there was nothing to take.
+    std::vector<IPv6View> datagrams6 {};
+    std::vector<IPv6Address> destinations6 {};
+    std::vector<uint32_t> routes6 {};
+    bool fill6( AsyncNetworkInterface& interface, const Fib& fib );
+  };
+
+  Burst RouteBurst;
+
+  // Adjacency (on its outbound interface) of each next hop that is not direct, by next hop
+  // index; filled in by route() as next hops are used (they never change, so neither do these)
+  std::vector<uint32_t> NextHopAdjacencies;
+
+  // -- Parallel routing (route_parallel) --
+
+  // A datagram that has been routed, waiting to be sent on its outbound interface
+  struct PendingForward {
+    IPv4View datagram;
+    uint32_t next_hop;
+  };
+
+  // Worker threads, started by the first route_parallel() call
+  std::unique_ptr<WorkerPool> Workers;
+
+  // CPUs to pin the workers to (see set_worker_cpus())
+  std::vector<int> WorkerCpus;
+
+  // Routed datagrams, indexed by [inbound interface][outbound interface]
+  std::vector<std::vector<std::vector<PendingForward>>> Outboxes;
+
+  // The same for IPv6 datagrams
+  struct PendingForward6 {
+    IPv6View datagram;
+    IPv6Address next_hop;
+  };
+  std::vector<std::vector<std::vector<PendingForward6>>> Outboxes6;
+
+  // One burst per worker
+  std::vector<Burst> WorkerBursts;
+
+  // -- The stages of the IPv4 forwarding pipeline (see forwarding_pipeline.hh) --
+
+  // Looks a burst up in the burst's destination cache, then the misses all together in the trie
+  struct CachedLookup {
+    Burst& burst;
+    const Fib& fib;
+    void lookup( std::span<const IPv4View> datagrams, std::span<uint32_t> routes );
+  };
+
+  // Checks each datagram against the access-control list (see aclPermits())
+  struct AclFilter {
+    Router& router;
+    const AclVersion& acl;
+    Burst& burst;
+    bool permits( const IPv4View& datagram ) { return router.aclPermits( datagram, acl, burst ); }
+  };
+
+  // Routes each datagram from interface `in` (see forwardingEntry()), counts, tracks and samples
+  // it, and hands it with its next hop to `output`: SendNow or ToOutboxes
+  template<class Output>
+  struct Forward {
+    Router& router;
+    const Fib& fib;
+    Burst& burst;
+    size_t in;
+    Output output;
+    void forward( IPv4View& datagram, uint32_t route );
+  };
+
+  // Sends each datagram on its outbound interface straight away (for route())
+  struct SendNow {
+    Router& router;
+    void operator()( IPv4View& datagram, uint32_t hop_index, const NextHop& hop );
+  };
+
+  // Queues each datagram in the outbox of its outbound interface (for route_parallel())
+  struct ToOutboxes {
+    std::vector<std::vector<PendingForward>>& outboxes;
+    void operator()( IPv4View& datagram, uint32_t hop_index, const NextHop& hop );
+  };
+
+  // Forward every IPv4 datagram waiting on interface `in` through `output`, a burst at a time in
+  // `burst` (with the filter left out of the pipeline altogether while the list is empty)
+  template<class Output>
+  void forwardFrom( size_t in, Burst& burst, const Fib& fib, const AclVersion& acl, Output output );
+
+  // -- Counters --
+
+  enum class Counter {
+    FORWARDED,
+    NO_ROUTE,
+    TTL_EXPIRED,
+    ACL_DENIED,
+    COUNT
+  };
+  ShardedCounters<Counter> Counters;
+
+  // -- Flow tracking (off unless track_flows() is called) --
+
+  // Flows forwarded from each inbound interface (empty while tracking is off). One table per
+  // interface, so that the workers of route_parallel(), which each own some of the interfaces,
+  // need no locking.
+  std::vector<FlowTable> Flows;
+  size_t FlowMemoryBudget;
+  uint64_t FlowIdleTimeout;
+
+  // Time elapsed since the router was created, in milliseconds (advanced by tick())
+  uint64_t CurrentTime;
+
+  // Count a datagram being forwarded from interface `in` in its flow
+  void recordFlow( size_t in, const IPv4View& datagram ) {
+    const FlowKey key = FlowKey::of( datagram );
+    Flows[in].record( key, FlowTable::hash( key ), datagram.size(), CurrentTime );
+  }
+
+  // -- Packet sampling (off unless start_sampling() is called) --
+
+  // Queues sampled datagrams for the exporter thread, with one source per inbound interface
+  // (null while sampling is off)
+  std::unique_ptr<PacketSampler> Sampler;
+  uint32_t SampleRate;
+
+  // Copy a datagram being forwarded from interface `in` out on `out_interface` by `entry`, for
+  // the exporter
+  void sample( size_t in, const IPv4View& datagram, const RoutingTableEntry& entry, uint32_t out_interface );
 
 public:
 
+  // A snapshot of what the router has done with the datagrams it received
+  struct Stats {
+    uint64_t forwarded;       // datagrams sent on towards their next hop
+    uint64_t no_route;        // dropped: no route matched the destination
+    uint64_t ttl_expired;     // dropped: the TTL ran out
+    uint64_t acl_denied;      // dropped: denied by the access-control list
+    uint64_t parse_errors;    // dropped by the interfaces: did not parse (e.g. a bad checksum)
+    uint64_t rx_ring_full;    // dropped by the interfaces: the receive ring was full
+  };
+
   // Default constructor for the Router class.
   Router();
 
   // Add an interface to the router
   // interface: an already-constructed network interface
   // returns the index of the interface after it has been added to the router
+  // (which is put in forwarding mode)
   size_t add_interface( AsyncNetworkInterface&& interface )
   {
     interfaces_.push_back( std::move( interface ) );
+    interfaces_.back().set_forwarding( true );
+    if( FlowMemoryBudget != 0 ) {
+      Flows.emplace_back( FlowMemoryBudget, FlowIdleTimeout );
+    }
+    if( Sampler != nullptr ) {
+      Sampler->add_source();
+    }
     return interfaces_.size() - 1;
   }
 
@@ -102,14 +585,234 @@ public:
                   std::optional<Address> next_hop,
                   size_t interface_num );
 
+  // A route, as given to load_routes()
+  struct Route {
+    uint32_t prefix;
+    uint8_t prefix_length;
+    std::optional<uint32_t> next_hop; // raw IP address; empty for a directly attached network
+    size_t interface_num;
+  };
+
+  // One change in a diff of the routing table (see RouteUpdate)
+  struct RouteChange {
+    enum class Kind {
+      ADD,      // as add_route(): no change if the prefix already has a route
+      REPLACE,  // as replace_route(): add the route, or change the next hop of the existing one
+      WITHDRAW, // as remove_route() (next_hop and interface_num are unused)
+    };
+    Kind kind;
+    uint32_t prefix;
+    uint8_t prefix_length;
+    std::optional<uint32_t> next_hop {}; // raw IP address; empty for a directly attached network
+    size_t interface_num {};
+  };
+
+  // A batch of changes to the routing table, made all at once by commit(): routing sees the
+  // table either as it was or with every change made, and a batch costs about as much as its
+  // changes, whatever the size of the table (see RoutingTable). Changes are made in the order
+  // they were applied, so a later change to a prefix overrides an earlier one.
+  class RouteUpdate {
+    Router& router_;
+    std::vector<RouteChange> changes_ {};
+
+    explicit RouteUpdate( Router& router ) : router_( router ) {}
+    friend class Router;
+
+  public:
+    // Add `diff` to the batch (nothing changes until commit())
+    void apply( std::span<const RouteChange> diff ) { changes_.insert( changes_.end(), diff.begin(), diff.end() ); }
+
+    // Number of changes in the batch
+    size_t size() const { return changes_.size(); }
+
+    // Make the batch's changes, as one new version of the FIB, and empty the batch. Returns the
+    // number of changes that changed something (e.g. not an ADD for a prefix that has a route,
+    // or a WITHDRAW for one that has none).
+    size_t commit();
+  };
+
+  // Start a batch of changes to the routing table (see RouteUpdate)
+  RouteUpdate begin_update() { return RouteUpdate { *this }; }
+
+  // Replace the whole routing table with `routes`, as one new version of the FIB. The routes are
+  // sorted and inserted in one pass (much faster than one add_route() per route, which publishes
+  // a new copy of the table each time). As with add_route(), if several routes have the same
+  // prefix, the first one wins.
+  void load_routes( std::span<const Route> routes );
+
+  // Write the routing table to `path` (replacing the file at once, by renaming a new file over it),
+  // in the format described in fib_snapshot.hh. With `include_trie`, the trie is saved as well, so
+  // that loading the snapshot does not have to rebuild it.
+  void save_fib_snapshot( const std::string& path, bool include_trie = true ) const;
+
+  // Replace the whole routing table with a snapshot written by save_fib_snapshot(), as one new
+  // version of the FIB. The file is mapped into memory and read in one pass. Throws (leaving the
+  // routing table as it was) if the file is not a valid snapshot for this router.
+  void load_fib_snapshot( const std::string& path );
+
+  // Write the complete ARP table entries of every interface (IP address, Ethernet address and
+  // time left) to `path`, replacing the file at once as save_fib_snapshot() does, in the format
+  // described in neighbor_snapshot.hh. Saving both on shutdown lets a restarted router forward
+  // at once, instead of reloading its routes and broadcasting ARP requests for every next hop.
+  // Not to be called while the interfaces are routing (e.g. during route_parallel()).
+  void save_neighbor_snapshot( const std::string& path ) const;
+
+  // Restore ARP table entries saved by save_neighbor_snapshot() (by a router with the same
+  // interfaces), counting the time since the save against their TTLs, so that entries that
+  // would have expired are left out. Each restored entry is used at once and verified by a
+  // unicast ARP request at its interface's next tick() (see NetworkInterface::restore_neighbors()).
+  // The file is mapped into memory and read in one pass. Throws (restoring nothing) if it is not
+  // a valid snapshot for this router.
+  void load_neighbor_snapshot( const std::string& path );
+
+  // Add an equal-cost path to the route for exactly route_prefix/prefix_length (adding the route
+  // if there is none), so that its flows are spread over its paths by hash (ECMP). Adding a path
+  // to a route of n paths moves about 1/(n+1) of its flows, all onto the new path. Returns false
+  // if the route already has this path.
+  bool add_path( uint32_t route_prefix,
+                 uint8_t prefix_length,
+                 std::optional<Address> next_hop,
+                 size_t interface_num );
+
+  // Remove one path from the route for exactly route_prefix/prefix_length (withdrawing the route
+  // if it was the last). Only the flows on the removed path move. Returns false if the route has
+  // no such path.
+  bool remove_path( uint32_t route_prefix,
+                    uint8_t prefix_length,
+                    std::optional<Address> next_hop,
+                    size_t interface_num );
+
+  // Withdraw the route for exactly route_prefix/prefix_length; returns false if there was none
+  bool remove_route( uint32_t route_prefix, uint8_t prefix_length );
+
+  // Add an IPv6 route (as add_route(): the first route added for a prefix wins). IPv6
+  // datagrams are forwarded by route() and route_parallel() alongside IPv4 ones, sharing their
+  // counters, with their hop limit decremented as the TTL is; they are not filtered by the
+  // access-control list, tracked, sampled, or spread over multiple paths, and the interfaces
+  // resolve their next hops with NDP (see NetworkInterface::send_datagram6()).
+  void add_route6( const IPv6Address& route_prefix,
+                   uint8_t prefix_length,
+                   std::optional<IPv6Address> next_hop,
+                   size_t interface_num );
+
+  // Withdraw the IPv6 route for exactly route_prefix/prefix_length; returns false if there was none
+  bool remove_route6( const IPv6Address& route_prefix, uint8_t prefix_length );
+
+  // Add a route, or change the next hop and interface of the existing route for the same prefix
+  void replace_route( uint32_t route_prefix,
+                      uint8_t prefix_length,
+                      std::optional<Address> next_hop,
+                      size_t interface_num );
+
+  // Replace the access-control list with `rules` (the first rule that matches a datagram says
+  // whether it is routed or dropped; `default_action` applies to datagrams that match none).
+  // The rules are compiled (see AclClassifier) before the new list is swapped in as a whole, so
+  // routing in progress uses either the old list or the new one, never a mix. The list starts
+  // empty, permitting everything.
+  void set_acl( std::span<const AclRule> rules, AclRule::Action default_action = AclRule::Action::PERMIT );
+
+  // Datagrams that matched each rule of the current access-control list, in rule order (only
+  // exact while the router is not running)
+  std::vector<uint64_t> acl_hits() const;
+
+  // Make the given interfaces (which face the same Ethernet segment) share one neighbor table,
+  // so that a neighbor resolved by one is not resolved again by the others (see
+  // NetworkInterface::set_neighbor_table). Returns the table.
+  std::shared_ptr<NeighborTable> share_neighbors( std::span<const size_t> interface_nums );
+
   // Route packets between the interfaces. For each interface, use the
   // maybe_receive() method to consume every incoming datagram and
   // send it on one of interfaces to the correct next hop. The router
   // chooses the outbound interface and next-hop as specified by the
   // route with the longest prefix_length that matches the datagram's
   // destination address.
+  //
+  // Datagrams are handled in bursts of up to ROUTE_BURST per interface: the route lookups of a
+  // burst are done together (RouteTrie::lookup_batch), then each datagram has its TTL and
+  // checksum rewritten and is sent, in order. (IPv4 datagrams go through a ForwardingPipeline
+  // of CachedLookup, AclFilter and Forward<SendNow>, see forwardFrom().)
   void route();
 
+  // Hits and misses of the destination caches used by route() and route_parallel(), combined
+  DestinationCache::Stats destination_cache_stats() const;
+
+  // Per-datagram latency of route() and route_parallel(), from lookup to enqueue on the outbound
+  // interface (empty unless built with LATENCY_HISTOGRAMS)
+  LatencyHistogram route_latency() const;
+
+  // Print p50/p99/p999 of the route, send_datagram and recv_frame latencies (of every interface)
+  // to `out`. May be called while the router is running, but not during the first
+  // route_parallel() call with a given number of workers.
+  void print_latency( std::ostream& out ) const;
+
+  // How much a next hop has been used
+  struct PathStats {
+    std::optional<uint32_t> next_hop {}; // raw IP address; empty for a directly attached network
+    size_t interface_num {};
+    uint64_t datagrams {};               // forwarded through it by route() and route_parallel()
+  };
+
+  // Usage of every next hop that a route has had (only exact while the router is not running)
+  std::vector<PathStats> path_stats() const;
+
+  // The router's counters (and its interfaces' receive drops); may be called from any thread,
+  // but the per-interface counts are only exact while the interfaces are not running
+  Stats stats() const;
+
+  // Track the flows (addresses, protocol and ports, see FlowKey) of forwarded datagrams, with
+  // per-flow counts, in a table of `memory_budget` bytes for each inbound interface (including
+  // those added later). A flow is evicted after `idle_timeout` ms without a datagram (see
+  // tick()). Calling this again starts new, empty tables.
+  void track_flows( size_t memory_budget, uint64_t idle_timeout );
+
+  // Every flow being tracked, by inbound interface (only exact while the router is not running)
+  std::vector<std::vector<FlowTable::Flow>> flows() const;
+
+  // The flow tables' counts, summed over the inbound interfaces
+  FlowTable::Stats flow_stats() const;
+
+  // Advance the router's clock, and every interface's (as NetworkInterface::tick() does), and
+  // evict the flows that have gone idle. Not to be called while route() or route_parallel() runs.
+  void tick( size_t ms_since_last_tick );
+
+  // Sample 1 in `one_in_n` of the datagrams forwarded by route() and route_parallel(), at random
+  // (see SampleCountdown), and pass them to `exporter` (see PacketSampler), which is called in
+  // batches on a thread of its own. A sample is the start of the datagram as it was forwarded, its
+  // inbound and outbound interfaces, and the prefix of the route it matched; it is queued on its
+  // inbound interface's ring, of `ring_capacity` samples, and dropped if that is full. Sampling
+  // again replaces the exporter. Not to be called while route() or route_parallel() runs.
+  //
+  // (The exporter thread makes the process multi-threaded, if it was not already, after which
+  // the standard library counts the references to Buffers with atomic operations.)
+  void start_sampling( uint32_t one_in_n, PacketSampler::Exporter exporter, size_t ring_capacity = 1024 );
+
+  // Stop sampling: the samples still queued are exported, and the exporter thread stops. Returns
+  // the sampler's final counts. Not to be called while route() or route_parallel() runs.
+  PacketSampler::Stats stop_sampling();
+
+  // The counts of the sampler (all zero while sampling is off)
+  PacketSampler::Stats sampling_stats() const;
+
+  // Same as route(), with the work spread over `num_workers` threads (including the caller).
+  //
+  // Interfaces are sharded across the workers (interface i belongs to worker i % num_workers).
+  // In a first phase, each worker drains the interfaces it owns and routes their datagrams
+  // (lookup and TTL) into per-interface outboxes; in a second phase each worker sends the
+  // datagrams queued for the interfaces it owns, in inbound-interface order. Each interface is
+  // only touched by its own worker in each phase, so the datagrams sent, and their order, are
+  // exactly the same as with route().
+  void route_parallel( size_t num_workers );
+
+  // Pin worker w of route_parallel() (worker 0 being the calling thread) to CPU cpus[w % size],
+  // or, if `cpus` is empty (the default), let the workers run anywhere. Takes effect at the next
+  // route_parallel(), which restarts the workers. Throws if a CPU is not available.
+  //
+  // Worker w owns interfaces w, w + num_workers, ..., and is the only thread that touches their
+  // neighbor tables and send queues, and that grows their flow tables (see route_parallel()), so
+  // with one worker per interface pinned near its NIC (see cpus_near_devices()), the per-interface
+  // state stays on the NIC's NUMA node and no two sockets share it.
+  void set_worker_cpus( std::vector<int> cpus );
+
   // -- My Helper Functions --
 
   /***
@@ -122,5 +825,37 @@ public:
    * @return true if there is a prefix match, false otherwise
    */
   bool isPrefixMatch(uint32_t ip_address1, uint32_t ip_address2, uint8_t prefix_length);
+
+  /***
+   * Checks whether a datagram can be forwarded, and decrements its TTL
+   *
+   * @param datagram The datagram to be forwarded
+   * @param fib The version of the FIB to route with
+   * @param route_index The datagram's route in the FIB (from a lookup), or RouteTrie::NO_ROUTE
+   *
+   * @return the routing table entry to forward it with, or nullptr if it should be dropped
+   *   (no route, or TTL expired; counted)
+   */
+  const RoutingTableEntry* forwardingEntry(IPv4View& datagram, const Fib& fib,
+                                                  uint32_t route_index);
+
+  // The same for an IPv6 datagram (its hop limit decremented), returning its next hop
+  const NextHop6* forwardingHop6(IPv6View& datagram, const Fib& fib, uint32_t route);
+
+  /***
+   * Checks a datagram against the access-control list
+   *
+   * @param datagram The datagram (its header is only decoded if the list is not empty)
+   * @param acl The version of the access-control list to check with
+   * @param burst The burst the datagram is in (which counts the rule it matched)
+   *
+   * @return true if the datagram may be routed, false if it should be dropped (counted)
+   */
+  bool aclPermits(const IPv4View& datagram, const AclVersion& acl, Burst& burst);
+
+  /***
+   * Creates a next hop (to be interned in a FIB)
+   */
+  static NextHop makeNextHop(const std::optional<uint32_t>& next_hop, size_t interface_num);
   
 };
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <coroutine>
+#include <exception>
+#include <utility>
+
+// A coroutine that returns nothing, for code that waits on interfaces with co_await (see
+// CoInterface). A Task does not start until it is resumed, and it owns its coroutine frame:
+// destroying an unfinished Task destroys the frame, with whatever the coroutine was holding.
+// An exception that escapes the coroutine finishes it, and is rethrown by rethrow_if_failed().
+//
+// Tasks are meant to be handed to EventLoop::spawn(), which starts them and keeps them until
+// they finish.
+class Task
+{
+public:
+  struct promise_type
+  {
+    std::exception_ptr exception {};
+
+    Task get_return_object() { return Task { std::coroutine_handle<promise_type>::from_promise( *this ) }; }
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    std::suspend_always final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() { exception = std::current_exception(); }
+  };
+
+  Task() = default;
+  ~Task()
+  {
+    if ( handle_ ) {
+      handle_.destroy();
+    }
+  }
+
+  Task( Task&& other ) noexcept : handle_( std::exchange( other.handle_, {} ) ) {}
+  Task& operator=( Task&& other ) noexcept
+  {
+    if ( this != &other ) {
+      if ( handle_ ) {
+        handle_.destroy();
+      }
+      handle_ = std::exchange( other.handle_, {} );
+    }
+    return *this;
+  }
+  Task( const Task& other ) = delete;
+  Task& operator=( const Task& other ) = delete;
+
+  // Run the coroutine until it next suspends (or finishes)
+  void resume()
+  {
+    if ( handle_ and not handle_.done() ) {
+      handle_.resume();
+    }
+  }
+
+  // Whether the coroutine has finished (or there is none)
+  bool done() const { return not handle_ or handle_.done(); }
+
+  // Rethrow the exception that finished the coroutine, if one did
+  void rethrow_if_failed() const
+  {
+    if ( handle_ and handle_.done() and handle_.promise().exception ) {
+      std::rethrow_exception( handle_.promise().exception );
+    }
+  }
+
+private:
+  explicit Task( std::coroutine_handle<promise_type> handle ) : handle_( handle ) {}
+
+  std::coroutine_handle<promise_type> handle_ {};
+};
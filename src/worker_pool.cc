@@ -0,0 +1,64 @@
+#include "worker_pool.hh"
+#include "cpu_affinity.hh"
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+using namespace std;
+
+WorkerPool::WorkerPool( const size_t workers, vector<int> cpus )
+  : start_( static_cast<ptrdiff_t>( max<size_t>( workers, 1 ) ) )
+  , done_( static_cast<ptrdiff_t>( max<size_t>( workers, 1 ) ) )
+  , cpus_( std::move( cpus ) )
+{
+  // (checked here, where it can throw, rather than on the workers)
+  if ( not cpus_allowed( cpus_ ) ) {
+    throw runtime_error( "WorkerPool: CPU not available" );
+  }
+
+  for ( size_t i = 1; i < workers; i++ ) {
+    threads_.emplace_back( [this, i] { loop( i ); } );
+  }
+}
+
+WorkerPool::~WorkerPool()
+{
+  stopping_ = true;
+  start_.arrive_and_wait();
+  // the jthreads are joined as threads_ is destroyed, before the barriers
+}
+
+void WorkerPool::pin( const size_t index ) const
+{
+  if ( not cpus_.empty() ) {
+    const int cpu = cpus_[index % cpus_.size()];
+    pin_current_thread( { &cpu, 1 } );
+  }
+}
+
+void WorkerPool::loop( const size_t index )
+{
+  pin( index );
+  while ( true ) {
+    start_.arrive_and_wait();
+    if ( stopping_ ) {
+      return;
+    }
+    ( *task_ )( index );
+    done_.arrive_and_wait();
+  }
+}
+
+void WorkerPool::run( const function<void( size_t )>& task )
+{
+  if ( not cpus_.empty() and pinned_caller_ != this_thread::get_id() ) {
+    pin( 0 );
+    pinned_caller_ = this_thread::get_id();
+  }
+  task_ = &task;
+  start_.arrive_and_wait();
+  task( 0 );
+  done_.arrive_and_wait();
+  task_ = nullptr;
+}
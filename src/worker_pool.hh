@@ -0,0 +1,49 @@
+#pragma once
+
+#include <barrier>
+#include <cstddef>
+#include <functional>
+#include <thread>
+#include <vector>
+
+// A fixed set of worker threads that run one task at a time, all of them together.
+//
+// run( task ) calls task( w ) once for every worker index w in [0, size()), each on its own
+// thread (index 0 is the calling thread), and returns when all of them have finished. The
+// threads are started once and parked on a barrier between tasks, so a run() costs two
+// barrier synchronizations rather than a thread creation per worker.
+//
+// If `cpus` is given, worker w is pinned to CPU cpus[w % cpus.size()]: each thread pins itself
+// when it starts, and the thread calling run() (worker 0) is pinned on its first run() (and
+// stays pinned).
+class WorkerPool
+{
+  const std::function<void( size_t )>* task_ {};
+  bool stopping_ {};
+  std::barrier<> start_;
+  std::barrier<> done_;
+  std::vector<int> cpus_;
+  std::thread::id pinned_caller_ {};
+  std::vector<std::jthread> threads_ {};
+
+  void loop( size_t index );
+
+  // Pin the calling thread as worker `index`, if the pool has CPUs
+  void pin( size_t index ) const;
+
+public:
+  explicit WorkerPool( size_t workers, std::vector<int> cpus = {} );
+  ~WorkerPool();
+
+  WorkerPool( const WorkerPool& other ) = delete;
+  WorkerPool& operator=( const WorkerPool& other ) = delete;
+  WorkerPool( WorkerPool&& other ) = delete;
+  WorkerPool& operator=( WorkerPool&& other ) = delete;
+
+  size_t size() const { return threads_.size() + 1; }
+
+  // The CPUs the workers are pinned to (empty if they are not)
+  const std::vector<int>& cpus() const { return cpus_; }
+
+  void run( const std::function<void( size_t )>& task );
+};
@@ -0,0 +1,64 @@
+#include "address_map.hh"
+#include "common.hh"
+
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+using namespace std;
+
+namespace {
+
+// Random inserts and erases, checked against std::unordered_map
+void test_against_unordered_map()
+{
+  mt19937 rng { 458 };
+  AddressMap<uint64_t> map;
+  unordered_map<uint32_t, uint64_t> reference;
+
+  for ( int i = 0; i < 200000; i++ ) {
+    // a small key space forces long probe runs and many collisions
+    const uint32_t key = rng() % 4096;
+    if ( rng() % 3 ) {
+      const uint64_t value = rng();
+      map.insert( key ).first = value;
+      reference[key] = value;
+    } else {
+      expect( map.erase( key ) == ( reference.erase( key ) == 1 ), "erase result mismatch" );
+    }
+
+    const uint32_t probe = rng() % 4096;
+    const uint64_t* found = map.find( probe );
+    const auto it = reference.find( probe );
+    expect( ( found != nullptr ) == ( it != reference.end() ), "find() presence mismatch for " + to_string( probe ) );
+    if ( found ) {
+      expect( *found == it->second, "find() value mismatch for " + to_string( probe ) );
+    }
+  }
+
+  expect( map.size() == reference.size(), "size mismatch" );
+
+  size_t visited = 0;
+  map.for_each( [&]( uint32_t key, const uint64_t& value ) {
+    expect( reference.at( key ) == value, "for_each() value mismatch" );
+    visited++;
+  } );
+  expect( visited == reference.size(), "for_each() should visit every entry once" );
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    test_against_unordered_map();
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
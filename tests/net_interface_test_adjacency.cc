@@ -0,0 +1,99 @@
+#include "arp_message.hh"
+#include "common.hh"
+#include "network_interface.hh"
+
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+namespace {
+
+const EthernetAddress local_eth { 0x02, 0, 0, 0, 0, 1 };
+const EthernetAddress neighbor_eth { 0x02, 0, 0, 0, 0, 2 };
+const uint32_t neighbor_ip = Address( "10.0.0.2", 0 ).ipv4_numeric();
+
+InternetDatagram datagram( uint16_t id )
+{
+  InternetDatagram dgram;
+  dgram.header.id = id;
+  dgram.header.dst = Address( "8.8.8.8", 0 ).ipv4_numeric();
+  dgram.header.compute_checksum();
+  return dgram;
+}
+
+// The only frame waiting to be sent
+EthernetFrame only_frame( NetworkInterface& interface )
+{
+  auto frame = interface.maybe_send();
+  expect( frame.has_value(), "a frame should have been sent" );
+  expect( not interface.maybe_send().has_value(), "only one frame should have been sent" );
+  return std::move( *frame );
+}
+
+void learn_neighbor( NetworkInterface& interface )
+{
+  ARPMessage arp;
+  arp.opcode = ARPMessage::OPCODE_REPLY;
+  arp.sender_ethernet_address = neighbor_eth;
+  arp.sender_ip_address = neighbor_ip;
+  arp.target_ethernet_address = local_eth;
+  arp.target_ip_address = Address( "10.0.0.1", 0 ).ipv4_numeric();
+  EthernetFrame frame;
+  frame.header = { local_eth, neighbor_eth, EthernetHeader::TYPE_ARP };
+  frame.payload = serialize( arp );
+  interface.recv_frame( frame );
+}
+
+void test_adjacency_follows_arp()
+{
+  NetworkInterface interface { local_eth, Address( "10.0.0.1", 0 ) };
+
+  const uint32_t adj = interface.adjacency( neighbor_ip );
+  expect( interface.adjacency( neighbor_ip ) == adj, "the same next hop should give the same adjacency" );
+
+  // unresolved: falls back to ARP
+  interface.send_to_adjacency( datagram( 1 ), adj );
+  expect( only_frame( interface ).header.type == EthernetHeader::TYPE_ARP, "an unresolved adjacency should ARP" );
+
+  // the reply resolves it, and the queued datagram goes out
+  learn_neighbor( interface );
+  EthernetFrame flushed = only_frame( interface );
+  expect( flushed.header.dst == neighbor_eth, "the queued datagram should go to the learned address" );
+
+  // resolved: the prebuilt header is used
+  interface.send_to_adjacency( datagram( 2 ), adj );
+  const EthernetFrame fast = only_frame( interface );
+  expect( fast.header.type == EthernetHeader::TYPE_IPv4 and fast.header.dst == neighbor_eth
+            and fast.header.src == local_eth,
+          "a resolved adjacency should send with its prebuilt header" );
+  InternetDatagram parsed;
+  expect( parse( parsed, fast.payload ) and parsed.header.id == 2, "the datagram should be carried intact" );
+
+  // when the ARP entry expires, so does the adjacency
+  interface.tick( 31'000 );
+  interface.send_to_adjacency( datagram( 3 ), adj );
+  expect( only_frame( interface ).header.type == EthernetHeader::TYPE_ARP, "an expired adjacency should ARP again" );
+
+  // an adjacency created after the neighbor is known starts out resolved
+  NetworkInterface other { local_eth, Address( "10.0.0.1", 0 ) };
+  learn_neighbor( other );
+  other.send_to_adjacency( datagram( 4 ), other.adjacency( neighbor_ip ) );
+  expect( only_frame( other ).header.dst == neighbor_eth, "a new adjacency should pick up the ARP table" );
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    test_adjacency_follows_arp();
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
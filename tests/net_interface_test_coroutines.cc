@@ -0,0 +1,176 @@
+#include "co_interface.hh"
+#include "common.hh"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+namespace {
+
+// Two UDP sockets on the loopback interface, connected to each other
+pair<UDPSocket, UDPSocket> socket_pair()
+{
+  UDPSocket a;
+  UDPSocket b;
+  a.bind( Address( "127.0.0.1", 0 ) );
+  b.bind( Address( "127.0.0.1", 0 ) );
+  a.connect( b.local_address() );
+  b.connect( a.local_address() );
+  return { std::move( a ), std::move( b ) };
+}
+
+InternetDatagram make_datagram( uint32_t src, uint32_t dst, const string& payload )
+{
+  InternetDatagram dgram;
+  dgram.header.src = src;
+  dgram.header.dst = dst;
+  dgram.payload.emplace_back( payload );
+  dgram.header.len = IPv4Header::LENGTH + payload.size();
+  dgram.header.compute_checksum();
+  return dgram;
+}
+
+// Run `loop` until it is stopped, or for at most two seconds
+void run_with_watchdog( EventLoop& loop )
+{
+  jthread watchdog { [&]( const stop_token& token ) {
+    const auto deadline = steady_clock::now() + seconds( 2 );
+    while ( not token.stop_requested() and steady_clock::now() < deadline ) {
+      this_thread::sleep_for( milliseconds( 1 ) );
+    }
+    loop.stop();
+  } };
+  loop.run();
+}
+
+Task echo( CoInterface& iface )
+{
+  while ( true ) {
+    InternetDatagram dgram = co_await iface.receive();
+    swap( dgram.header.src, dgram.header.dst );
+    dgram.header.compute_checksum();
+    const uint32_t next_hop = dgram.header.dst;
+    co_await iface.send( std::move( dgram ), next_hop );
+  }
+}
+
+Task ping( CoInterface& iface, uint32_t peer, size_t count, size_t& replies, EventLoop& loop )
+{
+  const uint32_t self = Address( "10.0.0.1", 0 ).ipv4_numeric();
+  for ( size_t i = 0; i < count; i++ ) {
+    const bool sent = co_await iface.send( make_datagram( self, peer, "ping " + to_string( i ) ), peer );
+    expect( sent, "every ping should be sent" );
+    const InternetDatagram reply = co_await iface.receive();
+    expect( string_view { reply.payload.front() } == "ping " + to_string( i ), "replies should come back in order" );
+    expect( reply.header.src == peer, "the reply should come from the peer" );
+    replies++;
+  }
+  loop.stop();
+}
+
+// A ping-pong between two coroutines: the first send waits for ARP, the rest go out at once
+void test_ping_pong()
+{
+  auto [a, b] = socket_pair();
+  const uint32_t ip_b = Address( "10.0.0.2", 0 ).ipv4_numeric();
+  AsyncNetworkInterface interface_a { { 0x02, 0, 0, 0, 0, 1 }, Address( "10.0.0.1", 0 ) };
+  AsyncNetworkInterface interface_b { { 0x02, 0, 0, 0, 0, 2 }, Address( "10.0.0.2", 0 ) };
+  FrameLink link_a { std::move( a ) };
+  FrameLink link_b { std::move( b ) };
+
+  EventLoop loop { milliseconds( 1 ) };
+  loop.add( interface_a, link_a );
+  loop.add( interface_b, link_b );
+  CoInterface co_a { interface_a, loop };
+  CoInterface co_b { interface_b, loop };
+
+  size_t replies = 0;
+  loop.spawn( echo( co_b ) );
+  loop.spawn( ping( co_a, ip_b, 50, replies, loop ) );
+  expect( co_a.waiting_senders() == 1, "the first ping should wait for ARP" );
+  expect( co_b.waiting_receivers() == 1, "the echo should wait for a datagram" );
+
+  run_with_watchdog( loop );
+
+  expect( replies == 50, "every ping should be answered, got " + to_string( replies ) );
+  expect( loop.tasks() == 1, "only the echo should still be running" );
+  expect( interface_a.stats().arp_requests_sent == 1, "one ARP request should have been sent" );
+  expect( interface_a.stats().arp_misses == 0, "no datagram should have waited in the interface's ARP queue" );
+}
+
+// A send to a neighbor that never answers resumes with false once the ARP timeout passes
+void test_arp_timeout()
+{
+  auto [a, b] = socket_pair();
+  AsyncNetworkInterface interface { { 0x02, 0, 0, 0, 0, 1 }, Address( "10.0.0.1", 0 ) };
+  FrameLink link { std::move( a ) };
+  EventLoop loop { milliseconds( 1 ) };
+  loop.add( interface, link );
+  CoInterface co { interface, loop, milliseconds( 20 ) };
+
+  const uint32_t absent = Address( "10.0.0.9", 0 ).ipv4_numeric();
+  optional<bool> result;
+  uint64_t resumed_at = 0;
+  loop.spawn( []( CoInterface& iface, uint32_t hop, optional<bool>& out, uint64_t& at, EventLoop& l ) -> Task {
+    out = co_await iface.send( make_datagram( 0, hop, "lost" ), hop );
+    at = l.ticked_ms();
+    l.stop();
+  }( co, absent, result, resumed_at, loop ) );
+
+  run_with_watchdog( loop );
+
+  expect( result.has_value() and not *result, "the send should time out" );
+  expect( resumed_at >= 20, "the send should not time out early" );
+  expect( co.waiting_senders() == 0, "a timed-out send should stop waiting" );
+  expect( interface.stats().arp_requests_sent == 1, "an ARP request should have been sent" );
+}
+
+// An exception that escapes a task comes out of the loop
+void test_task_failure()
+{
+  auto [a, b] = socket_pair();
+  AsyncNetworkInterface interface { { 0x02, 0, 0, 0, 0, 1 }, Address( "10.0.0.1", 0 ) };
+  FrameLink link { std::move( a ) };
+  EventLoop loop { milliseconds( 1 ) };
+  loop.add( interface, link );
+  CoInterface co { interface, loop, milliseconds( 5 ) };
+
+  const uint32_t absent = Address( "10.0.0.9", 0 ).ipv4_numeric();
+  loop.spawn( []( CoInterface& iface, uint32_t hop ) -> Task {
+    if ( not co_await iface.send( make_datagram( 0, hop, "lost" ), hop ) ) {
+      throw runtime_error( "unreachable" );
+    }
+  }( co, absent ) );
+
+  bool thrown = false;
+  try {
+    run_with_watchdog( loop );
+  } catch ( const runtime_error& e ) {
+    thrown = string_view { e.what() } == "unreachable";
+  }
+  expect( thrown, "the task's exception should be rethrown by the loop" );
+  expect( loop.tasks() == 0, "the failed task should be gone" );
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    test_ping_pong();
+    test_arp_timeout();
+    test_task_failure();
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,191 @@
+#include "arp_message.hh"
+#include "common.hh"
+#include "egress_scheduler.hh"
+#include "ethernet_frame.hh"
+#include "ipv4_datagram.hh"
+#include "network_interface.hh"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+const EthernetAddress local_eth { 0x02, 0, 0, 0, 0, 1 };
+const EthernetAddress neighbor_eth { 0x02, 0, 0, 0, 0, 2 };
+const uint32_t local_ip = Address( "10.0.0.1", 0 ).ipv4_numeric();
+const uint32_t neighbor_ip = Address( "10.0.0.2", 0 ).ipv4_numeric();
+
+constexpr uint8_t DSCP_EF = 46;
+constexpr uint8_t DSCP_CS6 = 48;
+
+InternetDatagram make_datagram( uint8_t dscp, size_t payload = 100 )
+{
+  InternetDatagram dgram;
+  dgram.header.tos = static_cast<uint8_t>( dscp << 2 );
+  dgram.payload.emplace_back( string( payload, 'x' ) );
+  dgram.header.len = IPv4Header::LENGTH + payload;
+  dgram.header.compute_checksum();
+  return dgram;
+}
+
+EthernetFrame ipv4_frame( uint8_t dscp, size_t payload = 100 )
+{
+  EthernetFrame frame;
+  frame.header = { neighbor_eth, local_eth, EthernetHeader::TYPE_IPv4 };
+  frame.payload = serialize( make_datagram( dscp, payload ) );
+  return frame;
+}
+
+EthernetFrame arp_frame( uint16_t opcode, const EthernetAddress& dst )
+{
+  ARPMessage arp;
+  arp.opcode = opcode;
+  arp.sender_ethernet_address = neighbor_eth;
+  arp.sender_ip_address = neighbor_ip;
+  arp.target_ip_address = local_ip;
+  EthernetFrame frame;
+  frame.header = { dst, neighbor_eth, EthernetHeader::TYPE_ARP };
+  frame.payload = serialize( arp );
+  return frame;
+}
+
+void test_classify()
+{
+  expect( EgressScheduler::classify( arp_frame( ARPMessage::OPCODE_REPLY, local_eth ) ) == EgressScheduler::ARP_CLASS,
+          "ARP should have its own class" );
+  expect( EgressScheduler::classify( ipv4_frame( DSCP_CS6 ) ) == 1, "network control should come next" );
+  expect( EgressScheduler::classify( ipv4_frame( DSCP_EF ) ) == 2, "EF should be in the second IPv4 class" );
+  expect( EgressScheduler::classify( ipv4_frame( 26 ) ) == 3, "AF31 should be in the third IPv4 class" );
+  expect( EgressScheduler::classify( ipv4_frame( 0 ) ) == EgressScheduler::BEST_EFFORT_CLASS,
+          "DSCP 0 should be best effort" );
+}
+
+// The class of each frame, in the order they leave
+vector<size_t> drain( EgressScheduler& scheduler, size_t max_frames = SIZE_MAX )
+{
+  vector<EthernetFrame> frames;
+  scheduler.pop_batch( frames, max_frames );
+  vector<size_t> classes;
+  for ( const auto& frame : frames ) {
+    classes.push_back( EgressScheduler::classify( frame ) );
+  }
+  return classes;
+}
+
+void test_policies()
+{
+  const auto fill = []( EgressScheduler& scheduler ) {
+    scheduler.push( ipv4_frame( 0 ) );
+    scheduler.push( ipv4_frame( DSCP_EF ) );
+    scheduler.push( ipv4_frame( 0 ) );
+    scheduler.push( arp_frame( ARPMessage::OPCODE_REPLY, local_eth ) );
+  };
+
+  EgressScheduler fifo;
+  fill( fifo );
+  expect( drain( fifo ) == vector<size_t> { 4, 2, 4, 0 }, "FIFO should keep the queueing order" );
+
+  EgressScheduler priority { { .policy = EgressScheduler::Policy::PRIORITY } };
+  fill( priority );
+  expect( priority.size() == 4 and priority.queued_frames( 4 ) == 2, "the frames should be counted per class" );
+  expect( drain( priority ) == vector<size_t> { 0, 2, 4, 4 }, "strict priority should send ARP, then EF" );
+  expect( priority.empty() and priority.queued_bytes( 4 ) == 0, "the queue should be empty" );
+
+  // switching policies requeues what is waiting
+  fill( fifo );
+  fifo.configure( { .policy = EgressScheduler::Policy::PRIORITY } );
+  expect( drain( fifo ) == vector<size_t> { 0, 2, 4, 4 }, "a new policy should apply to waiting frames" );
+}
+
+// DRR shares the link by the classes' quanta, and ARP still goes first
+void test_drr()
+{
+  EgressScheduler::Config config { .policy = EgressScheduler::Policy::DRR };
+  EgressScheduler scheduler { config };
+  for ( size_t i = 0; i < 200; i++ ) { // (full-size frames)
+    scheduler.push( ipv4_frame( 0, 1480 ) );
+    scheduler.push( ipv4_frame( DSCP_CS6, 1480 ) );
+  }
+  vector<size_t> classes = drain( scheduler, 90 );
+  const auto control = ranges::count( classes, 1 );
+  expect( control == 80, "network control should get 8 of every 9 frames, got " + to_string( control ) );
+
+  scheduler.push( arp_frame( ARPMessage::OPCODE_REPLY, local_eth ) );
+  expect( drain( scheduler, 1 ) == vector<size_t> { 0 }, "ARP should jump the round" );
+
+  // once network control runs out, best effort takes every frame
+  classes = drain( scheduler );
+  expect( classes.size() == 310 and ranges::count( classes, 4 ) == 190, "every frame should be sent" );
+  expect( ranges::count( classes.begin() + 150, classes.end(), 1 ) == 0, "the tail should all be best effort" );
+
+  // frames larger than the quantum still get through, over several rounds
+  config.quantum = { 0, 100, 100, 100, 100 };
+  scheduler.configure( config );
+  scheduler.push( ipv4_frame( 0, 1400 ) );
+  scheduler.push( ipv4_frame( DSCP_EF, 1400 ) );
+  expect( drain( scheduler ).size() == 2, "a small quantum should not starve a class" );
+}
+
+void test_limits()
+{
+  EgressScheduler::Config config { .policy = EgressScheduler::Policy::PRIORITY };
+  config.max_frames[EgressScheduler::BEST_EFFORT_CLASS] = 2;
+  config.max_bytes[2] = 300;
+  EgressScheduler scheduler { config };
+
+  expect( scheduler.push( ipv4_frame( 0 ) ) and scheduler.push( ipv4_frame( 0 ) ), "two frames should fit" );
+  expect( not scheduler.push( ipv4_frame( 0 ) ), "a third best-effort frame should be dropped" );
+  expect( scheduler.push( ipv4_frame( DSCP_EF ) ) and scheduler.push( ipv4_frame( DSCP_EF ) ),
+          "another class should have room" );
+  expect( not scheduler.push( ipv4_frame( DSCP_EF ) ), "the byte limit should hold" );
+  expect( scheduler.push( arp_frame( ARPMessage::OPCODE_REPLY, local_eth ) ), "ARP should not be limited" );
+}
+
+// An interface answers ARP ahead of a backlog of data
+void test_interface()
+{
+  NetworkInterface interface { local_eth, Address( "10.0.0.1", 0 ) };
+  EgressScheduler::Config config { .policy = EgressScheduler::Policy::PRIORITY };
+  config.max_frames[EgressScheduler::BEST_EFFORT_CLASS] = 50;
+  interface.set_egress_scheduler( config );
+
+  interface.recv_frame( arp_frame( ARPMessage::OPCODE_REPLY, local_eth ) );
+  for ( size_t i = 0; i < 60; i++ ) {
+    interface.send_datagram( make_datagram( 0 ), neighbor_ip );
+  }
+  expect( interface.stats().egress_drops == 10, "datagrams over the class limit should be dropped" );
+
+  interface.recv_frame( arp_frame( ARPMessage::OPCODE_REQUEST, ETHERNET_BROADCAST ) );
+  const auto first = interface.maybe_send();
+  expect( first.has_value() and first->header.type == EthernetHeader::TYPE_ARP,
+          "the ARP reply should go out ahead of the data" );
+
+  vector<EthernetFrame> frames;
+  expect( interface.maybe_send_batch( frames, 20 ) == 20 and interface.maybe_send_batch( frames ) == 30,
+          "the data should drain in batches" );
+  expect( interface.stats().tx_frames == 51, "every frame sent should be counted" );
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    test_classify();
+    test_policies();
+    test_drr();
+    test_limits();
+    test_interface();
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
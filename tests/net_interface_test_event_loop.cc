@@ -0,0 +1,224 @@
+#include "common.hh"
+#include "event_loop.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+namespace {
+
+// Two UDP sockets on the loopback interface, connected to each other
+pair<UDPSocket, UDPSocket> socket_pair()
+{
+  UDPSocket a;
+  UDPSocket b;
+  a.bind( Address( "127.0.0.1", 0 ) );
+  b.bind( Address( "127.0.0.1", 0 ) );
+  a.connect( b.local_address() );
+  b.connect( a.local_address() );
+  return { std::move( a ), std::move( b ) };
+}
+
+// Two interfaces linked over sockets, driven by one loop: ARP then forwarding happen on their own
+void test_forwarding()
+{
+  auto [a, b] = socket_pair();
+  const uint32_t ip_b = Address( "10.0.0.2", 0 ).ipv4_numeric();
+  AsyncNetworkInterface interface_a { { 0x02, 0, 0, 0, 0, 1 }, Address( "10.0.0.1", 0 ) };
+  AsyncNetworkInterface interface_b { { 0x02, 0, 0, 0, 0, 2 }, Address( "10.0.0.2", 0 ) };
+  FrameLink link_a { std::move( a ) };
+  FrameLink link_b { std::move( b ) };
+
+  EventLoop loop { milliseconds( 1 ) };
+  loop.add( interface_a, link_a );
+  loop.add( interface_b, link_b );
+
+  for ( int i = 0; i < 100; i++ ) {
+    InternetDatagram dgram;
+    dgram.header.src = Address( "10.0.0.1", 0 ).ipv4_numeric();
+    dgram.header.dst = ip_b;
+    dgram.payload.emplace_back( "datagram " + to_string( i ) );
+    dgram.header.len = IPv4Header::LENGTH + dgram.payload.back().size();
+    dgram.header.compute_checksum();
+    expect( interface_a.enqueue_send( std::move( dgram ), ip_b ), "the datagram should be queued" );
+  }
+
+  size_t delivered = 0;
+  loop.set_handler( [&]( size_t ) {
+    while ( const auto dgram = interface_b.maybe_receive() ) {
+      expect( string_view { dgram->payload.front() } == "datagram " + to_string( delivered ),
+              "datagrams should be delivered in order" );
+      delivered++;
+    }
+    if ( delivered == 100 ) {
+      loop.stop();
+    }
+  } );
+
+  // a stop from another thread, in case the datagrams never arrive
+  jthread watchdog { [&]( const stop_token& token ) {
+    const auto deadline = steady_clock::now() + seconds( 2 );
+    while ( not token.stop_requested() and steady_clock::now() < deadline ) {
+      this_thread::sleep_for( milliseconds( 1 ) );
+    }
+    loop.stop();
+  } };
+  loop.run();
+  watchdog.request_stop();
+
+  expect( delivered == 100, "every datagram should cross the link, got " + to_string( delivered ) );
+  expect( interface_a.stats().arp_requests_sent == 1, "one ARP request should have been sent" );
+}
+
+// With nothing to receive, the loop sleeps until the timer ticks the interfaces
+void test_ticks()
+{
+  auto [a, b] = socket_pair();
+  AsyncNetworkInterface interface { { 0x02, 0, 0, 0, 0, 1 }, Address( "10.0.0.1", 0 ) };
+  FrameLink link { std::move( a ) };
+  EventLoop loop { milliseconds( 5 ) };
+  loop.add( interface, link );
+
+  const auto start = steady_clock::now();
+  size_t wakeups = 0;
+  while ( steady_clock::now() - start < milliseconds( 50 ) ) {
+    wakeups += loop.run_once( 100 );
+  }
+  expect( loop.ticked_ms() >= 40 and loop.ticked_ms() <= 60, "the interfaces should be ticked as time passes" );
+  expect( wakeups <= 12, "an idle loop should only wake up for the timer" );
+}
+
+// With adaptive polling, a flood is received by busy-polling with a growing burst, and the loop
+// goes back to sleeping once the link is quiet
+void test_adaptive_polling()
+{
+  auto [a, b] = socket_pair();
+  const uint32_t ip_b = Address( "10.0.0.2", 0 ).ipv4_numeric();
+  AsyncNetworkInterface interface_a { { 0x02, 0, 0, 0, 0, 1 }, Address( "10.0.0.1", 0 ) };
+  AsyncNetworkInterface interface_b { { 0x02, 0, 0, 0, 0, 2 }, Address( "10.0.0.2", 0 ) };
+  FrameLink link_a { std::move( a ) };
+  FrameLink link_b { std::move( b ) };
+
+  EventLoop loop { milliseconds( 1 ) };
+  loop.set_adaptive_polling( { .empty_polls_before_sleep = 16, .min_burst = 4, .max_burst = 64 } );
+  loop.add( interface_a, link_a );
+  loop.add( interface_b, link_b );
+  expect( link_b.burst() == 32, "a burst within the policy's range should be kept" );
+
+  // (queued before ARP resolves, so that all of them are sent at once)
+  constexpr size_t count = 200;
+  for ( size_t i = 0; i < count; i++ ) {
+    InternetDatagram dgram;
+    dgram.header.src = Address( "10.0.0.1", 0 ).ipv4_numeric();
+    dgram.header.dst = ip_b;
+    dgram.payload.emplace_back( "datagram " + to_string( i ) );
+    dgram.header.len = IPv4Header::LENGTH + dgram.payload.back().size();
+    dgram.header.compute_checksum();
+    expect( interface_a.enqueue_send( std::move( dgram ), ip_b ), "the datagram should be queued" );
+  }
+
+  // Stop once the loop, polling through the flood, has gone back to sleeping and been woken
+  // again (by the timer): everything checked below is counted by the loop itself, not timed
+  size_t delivered = 0;
+  optional<EventLoop::PollingStats> after_flood;
+  bool burst_in_range = true;
+  loop.set_handler( [&]( size_t ) {
+    while ( interface_b.maybe_receive() ) {
+      delivered++;
+    }
+    burst_in_range = burst_in_range and link_b.burst() >= 4 and link_b.burst() <= 64;
+    const auto& stats = loop.polling_stats();
+    if ( delivered == count and not after_flood ) {
+      after_flood = stats;
+    } else if ( after_flood and stats.sleeps > after_flood->sleeps ) {
+      loop.stop();
+    }
+  } );
+
+  // (only in case the loop never goes back to sleep)
+  atomic<bool> stopped { false };
+  jthread watchdog { [&] {
+    for ( int i = 0; i < 1000 and not stopped; i++ ) {
+      this_thread::sleep_for( milliseconds( 10 ) );
+    }
+    loop.stop();
+  } };
+  loop.run();
+  stopped = true;
+  watchdog.join();
+
+  const auto& stats = loop.polling_stats();
+  expect( delivered == count, "every datagram should cross the link, got " + to_string( delivered ) );
+  expect( after_flood.has_value() and stats.sleeps > after_flood->sleeps,
+          "an idle loop should go back to sleeping after the flood" );
+  expect( after_flood->polls > 0, "the flood should have been busy-polled" );
+  expect( stats.empty_polls - after_flood->empty_polls >= 16 and stats.polls > after_flood->polls,
+          "the loop should only sleep after a run of empty polls" );
+  expect( stats.wakeups > after_flood->wakeups, "a sleeping loop should be woken by its timer" );
+  expect( burst_in_range, "the burst should stay within the policy's range" );
+}
+
+// The burst follows the queue: doubling when a round finds more than a burst waiting, and halving
+// back to the policy's minimum while rounds find little (driven one round at a time, so that the
+// queue is known)
+void test_burst_adaptation()
+{
+  auto [a, b] = socket_pair();
+  AsyncNetworkInterface interface_b { { 0x02, 0, 0, 0, 0, 2 }, Address( "10.0.0.2", 0 ) };
+  FrameLink link_b { std::move( b ) };
+
+  EventLoop loop { milliseconds( 1 ) };
+  loop.set_adaptive_polling( { .empty_polls_before_sleep = 16, .min_burst = 4, .max_burst = 64 } );
+  loop.add( interface_b, link_b );
+  expect( link_b.burst() == 32, "a burst within the policy's range should be kept" );
+
+  // (what the frames hold does not matter: the link takes them, and the interface drops them)
+  const auto queue = [&a]( const size_t frames ) {
+    for ( size_t i = 0; i < frames; i++ ) {
+      a.send( string( 64, 'x' ) );
+    }
+  };
+
+  queue( 3 * 32 );
+  expect( loop.poll_once() == 3 * 32, "a round should take the whole queue" );
+  expect( link_b.burst() == 64 and loop.polling_stats().burst_increases == 1,
+          "the burst should double when more than one burst is waiting" );
+
+  queue( 3 * 64 );
+  loop.poll_once();
+  expect( link_b.burst() == 64 and loop.polling_stats().burst_increases == 1,
+          "the burst should not grow past the policy's maximum" );
+
+  for ( const size_t burst : { 32, 16, 8, 4, 4 } ) {
+    loop.poll_once();
+    expect( link_b.burst() == burst, "the burst should halve while the queue is empty" );
+  }
+  expect( loop.polling_stats().burst_decreases == 4, "the burst should stop shrinking at the policy's minimum" );
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    test_forwarding();
+    test_ticks();
+    test_adaptive_polling();
+    test_burst_adaptation();
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
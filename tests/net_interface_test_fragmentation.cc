@@ -0,0 +1,248 @@
+#include "arp_message.hh"
+#include "common.hh"
+#include "ethernet_frame.hh"
+#include "ip_fragmentation.hh"
+#include "network_interface.hh"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+bool points_into( string_view inner, string_view outer )
+{
+  return inner.data() >= outer.data() and inner.data() + inner.size() <= outer.data() + outer.size();
+}
+
+string concat( const vector<Buffer>& buffers )
+{
+  string out;
+  for ( const auto& piece : buffers ) {
+    out.append( piece );
+  }
+  return out;
+}
+
+const uint32_t IP_A = Address( "10.0.0.1", 0 ).ipv4_numeric();
+const uint32_t IP_B = Address( "10.0.0.2", 0 ).ipv4_numeric();
+const EthernetAddress ETH_A { 0x02, 0, 0, 0, 0, 1 };
+const EthernetAddress ETH_B { 0x02, 0, 0, 0, 0, 2 };
+
+// A datagram from A to B whose payload is `pieces` (a repeating pattern, so misplaced bytes show)
+InternetDatagram make_datagram( const vector<size_t>& pieces, uint16_t id = 7, bool df = false )
+{
+  InternetDatagram dgram;
+  dgram.header.src = IP_A;
+  dgram.header.dst = IP_B;
+  dgram.header.id = id;
+  dgram.header.df = df;
+  size_t total = 0;
+  for ( const size_t size : pieces ) {
+    string bytes;
+    for ( size_t i = 0; i < size; i++ ) {
+      bytes.push_back( static_cast<char>( 'a' + ( total + i ) % 23 ) );
+    }
+    dgram.payload.emplace_back( std::move( bytes ) );
+    total += size;
+  }
+  dgram.header.len = IPv4Header::LENGTH + total;
+  dgram.header.compute_checksum();
+  return dgram;
+}
+
+// Teach `interface` the Ethernet address of `ip` with an ARP reply
+void learn( NetworkInterface& interface, const EthernetAddress& local, uint32_t local_ip, const EthernetAddress& eth, uint32_t ip )
+{
+  ARPMessage arp;
+  arp.opcode = ARPMessage::OPCODE_REPLY;
+  arp.sender_ethernet_address = eth;
+  arp.sender_ip_address = ip;
+  arp.target_ethernet_address = local;
+  arp.target_ip_address = local_ip;
+  EthernetFrame frame;
+  frame.header = { local, eth, EthernetHeader::TYPE_ARP };
+  frame.payload = serialize( arp );
+  interface.recv_frame( frame );
+}
+
+void test_fragment()
+{
+  const InternetDatagram dgram = make_datagram( { 1000, 3000 } );
+  vector<InternetDatagram> fragments;
+  expect( fragment( dgram, 1500, fragments ), "a datagram without DF should be fragmented" );
+  expect( fragments.size() == 3, "4000 bytes should make three fragments" );
+
+  const vector<size_t> lengths { 1480, 1480, 1040 };
+  string rejoined;
+  for ( size_t i = 0; i < fragments.size(); i++ ) {
+    const IPv4Header& header = fragments[i].header;
+    expect( header.len == IPv4Header::LENGTH + lengths[i], "fragment " + to_string( i ) + " has the wrong length" );
+    expect( header.offset * 8U == 1480 * i, "fragment " + to_string( i ) + " has the wrong offset" );
+    expect( header.mf == ( i + 1 < fragments.size() ), "only the last fragment should clear MF" );
+    expect( header.id == dgram.header.id, "fragments should keep the identification" );
+    for ( const auto& piece : fragments[i].payload ) {
+      expect( points_into( piece, dgram.payload[0] ) or points_into( piece, dgram.payload[1] ),
+              "fragment payloads should be slices of the original" );
+    }
+    rejoined += concat( fragments[i].payload );
+  }
+  expect( rejoined == concat( dgram.payload ), "the fragments should carry the whole payload, in order" );
+
+  // a fragment of a fragment keeps its place in the original datagram
+  vector<InternetDatagram> again;
+  expect( fragment( fragments[1], 600, again ), "a fragment can be fragmented again" );
+  expect( again.size() == 3 and again.front().header.offset == 1480 / 8, "refragments should start at their offset" );
+  expect( again.back().header.mf, "refragments of a middle fragment all keep MF" );
+
+  fragments.clear();
+  expect( not fragment( make_datagram( { 3000 }, 8, true ), 1500, fragments ) and fragments.empty(),
+          "a datagram with DF should not be fragmented" );
+}
+
+// Datagrams over the MTU go out as fragments, which the receiving interface reassembles
+void test_send_and_reassemble()
+{
+  NetworkInterface a { ETH_A, Address( "10.0.0.1", 0 ) };
+  NetworkInterface b { ETH_B, Address( "10.0.0.2", 0 ) };
+  learn( a, ETH_A, IP_A, ETH_B, IP_B );
+
+  const InternetDatagram dgram = make_datagram( { 5000 } );
+  a.send_datagram( dgram, IP_B );
+  vector<EthernetFrame> frames;
+  a.maybe_send_batch( frames );
+  expect( frames.size() == 4, "5000 bytes should go out as four frames" );
+  expect( a.stats().fragments_sent == 4, "the fragments should be counted" );
+
+  // delivered out of order, with a duplicate
+  reverse( frames.begin(), frames.end() );
+  frames.push_back( frames[1] );
+  optional<InternetDatagram> whole;
+  for ( const auto& frame : frames ) {
+    auto received = b.recv_frame( frame );
+    expect( not whole.has_value() or not received.has_value(), "the datagram should be delivered once" );
+    if ( received.has_value() ) {
+      whole = std::move( received );
+    }
+  }
+  expect( whole.has_value(), "the fragments should be reassembled" );
+  expect( concat( whole->payload ) == concat( dgram.payload ), "the reassembled payload should match" );
+  expect( whole->header.len == dgram.header.len and not whole->header.mf and whole->header.offset == 0,
+          "the reassembled header should describe the whole datagram" );
+  expect( b.stats().reassembled == 1 and b.stats().reassembly_drops == 0, "one datagram should be reassembled" );
+
+  // the serialized datagram checks out (its checksum was recomputed)
+  InternetDatagram reparsed;
+  expect( parse( reparsed, serialize( *whole ) ), "the reassembled datagram should parse" );
+
+  // DF set: dropped rather than sent whole
+  a.send_datagram( make_datagram( { 5000 }, 9, true ), IP_B );
+  expect( not a.maybe_send().has_value() and a.stats().fragmentation_drops == 1,
+          "an oversized datagram with DF should be dropped" );
+
+  // the adjacency fast path respects the MTU too
+  a.set_mtu( 576 );
+  a.send_to_adjacency( make_datagram( { 1000 }, 10 ), a.adjacency( IP_B ) );
+  frames.clear();
+  a.maybe_send_batch( frames );
+  expect( frames.size() == 2, "a datagram over the MTU should be fragmented on the adjacency path" );
+}
+
+// Fragments of datagrams to other addresses are passed up untouched (for forwarding)
+void test_transit_fragments()
+{
+  NetworkInterface router { ETH_B, Address( "10.0.0.254", 0 ) };
+  vector<InternetDatagram> fragments;
+  fragment( make_datagram( { 3000 } ), 1500, fragments );
+
+  EthernetFrame frame;
+  frame.header = { ETH_B, ETH_A, EthernetHeader::TYPE_IPv4 };
+  frame.payload = serialize( fragments.front() );
+  const auto received = router.recv_frame( frame );
+  expect( received.has_value() and received->header.mf, "a transit fragment should be passed up as it is" );
+  expect( router.stats().fragments_received == 0, "a transit fragment should not be held" );
+}
+
+InternetDatagram fragment_of( uint16_t id, uint16_t offset_units, size_t length, bool mf )
+{
+  InternetDatagram frag = make_datagram( { length }, id );
+  frag.header.offset = offset_units;
+  frag.header.mf = mf;
+  frag.header.compute_checksum();
+  return frag;
+}
+
+void test_reassembler_rules()
+{
+  Reassembler reassembler { { .max_bytes = 1 << 20, .max_datagrams = 100, .max_fragments = 16, .timeout_ms = 1000 } };
+
+  // a partial overlap discards the whole datagram
+  expect( not reassembler.add( fragment_of( 1, 0, 800, true ), 0 ), "a first fragment alone is not whole" );
+  expect( not reassembler.add( fragment_of( 1, 50, 800, false ), 0 ), "an overlapping fragment is discarded" );
+  expect( reassembler.datagrams() == 0 and reassembler.stats().invalid == 1, "the overlap should drop the datagram" );
+
+  // inconsistent lengths too
+  reassembler.add( fragment_of( 2, 100, 80, false ), 0 );
+  reassembler.add( fragment_of( 2, 50, 80, false ), 0 );
+  expect( reassembler.datagrams() == 0 and reassembler.stats().invalid == 2, "two last fragments should conflict" );
+  reassembler.add( fragment_of( 3, 0, 100, true ), 0 );
+  expect( reassembler.stats().invalid == 3, "a non-final fragment must carry a multiple of 8 bytes" );
+
+  // a partial datagram times out
+  reassembler.add( fragment_of( 4, 0, 800, true ), 10 );
+  reassembler.expire( 500 );
+  expect( reassembler.datagrams() == 1, "a partial datagram should wait for its timeout" );
+  reassembler.expire( 1010 );
+  expect( reassembler.datagrams() == 0 and reassembler.bytes() == 0 and reassembler.stats().timeouts == 1,
+          "a partial datagram should be dropped after its timeout" );
+  expect( not reassembler.add( fragment_of( 4, 100, 80, false ), 1020 ), "a late fragment should not complete it" );
+}
+
+// A flood of fragments that never complete stays within the limits, and real datagrams still get through
+void test_fragment_flood()
+{
+  const Reassembler::Limits limits { .max_bytes = 256 << 10, .max_datagrams = 200, .max_fragments = 16, .timeout_ms = 30'000 };
+  Reassembler reassembler { limits };
+
+  for ( uint32_t i = 0; i < 20'000; i++ ) {
+    InternetDatagram frag = fragment_of( static_cast<uint16_t>( i ), 0, 1480, true );
+    frag.header.src = 0x0B00'0000 + i; // (different sources, so ids do not collide)
+    reassembler.add( std::move( frag ), i / 100 );
+    expect( reassembler.datagrams() <= limits.max_datagrams, "the datagram limit should hold" );
+    expect( reassembler.bytes() <= limits.max_bytes, "the byte budget should hold" );
+  }
+  expect( reassembler.stats().evictions > 0, "the flood should have pushed out partial datagrams" );
+
+  vector<InternetDatagram> fragments;
+  const InternetDatagram dgram = make_datagram( { 4000 }, 99 );
+  fragment( dgram, 1500, fragments );
+  optional<InternetDatagram> whole;
+  for ( auto& frag : fragments ) {
+    whole = reassembler.add( std::move( frag ), 200 );
+  }
+  expect( whole.has_value() and concat( whole->payload ) == concat( dgram.payload ),
+          "a datagram should still be reassembled during a flood" );
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    test_fragment();
+    test_send_and_reassemble();
+    test_transit_fragments();
+    test_reassembler_rules();
+    test_fragment_flood();
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,184 @@
+#include "arp_message.hh"
+#include "common.hh"
+#include "ethernet_frame.hh"
+#include "ipv4_datagram.hh"
+#include "network_interface.hh"
+#include "token_bucket.hh"
+
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+const EthernetAddress local_eth { 0x02, 0, 0, 0, 0, 1 };
+const EthernetAddress neighbor_eth { 0x02, 0, 0, 0, 0, 2 };
+const uint32_t local_ip = Address( "10.0.0.1", 0 ).ipv4_numeric();
+
+InternetDatagram make_datagram( char tag, size_t payload = 100 )
+{
+  InternetDatagram dgram;
+  dgram.payload.emplace_back( string( payload, tag ) );
+  dgram.header.len = IPv4Header::LENGTH + payload;
+  dgram.header.compute_checksum();
+  return dgram;
+}
+
+void reply_from( NetworkInterface& interface, uint32_t neighbor_ip )
+{
+  ARPMessage arp;
+  arp.opcode = ARPMessage::OPCODE_REPLY;
+  arp.sender_ethernet_address = neighbor_eth;
+  arp.sender_ip_address = neighbor_ip;
+  arp.target_ethernet_address = local_eth;
+  arp.target_ip_address = local_ip;
+  EthernetFrame reply;
+  reply.header = { local_eth, neighbor_eth, EthernetHeader::TYPE_ARP };
+  reply.payload = serialize( arp );
+  interface.recv_frame( reply );
+}
+
+// The payload tags of the IPv4 frames waiting to be sent (ARP frames are skipped)
+string sent_tags( NetworkInterface& interface )
+{
+  string tags;
+  while ( auto frame = interface.maybe_send() ) {
+    if ( frame->header.type == EthernetHeader::TYPE_IPv4 ) {
+      tags.push_back( string_view { frame->payload.back() }.front() );
+    }
+  }
+  return tags;
+}
+
+void test_token_bucket()
+{
+  TokenBucket unlimited;
+  for ( int i = 0; i < 1000; i++ ) {
+    expect( unlimited.consume( 0 ), "a zero-rate bucket should be unlimited" );
+  }
+
+  TokenBucket bucket { 10, 3 }; // 10 per second, bursts of 3
+  for ( int i = 0; i < 3; i++ ) {
+    expect( bucket.consume( 0 ), "a full bucket should allow a burst" );
+  }
+  expect( not bucket.consume( 0 ), "an empty bucket should refuse" );
+  expect( not bucket.consume( 99 ), "a token takes 100 ms to refill" );
+  expect( bucket.consume( 100 ), "the refilled token should be allowed" );
+  expect( bucket.consume( 10000 ) and bucket.consume( 10000 ) and bucket.consume( 10000 )
+            and not bucket.consume( 10000 ),
+          "refilling should stop at the burst size" );
+}
+
+void test_tail_drop()
+{
+  NetworkInterface interface { local_eth, Address( "10.0.0.1", 0 ) };
+  interface.set_pending_limits( { .max_packets_per_neighbor = 2 } );
+
+  const uint32_t neighbor_ip = Address( "10.0.0.2", 0 ).ipv4_numeric();
+  for ( const char tag : string { "abcd" } ) {
+    interface.send_datagram( make_datagram( tag ), neighbor_ip );
+  }
+  expect( interface.stats().pending_dropped_packets == 2, "datagrams over the cap should be dropped" );
+  expect( interface.stats().pending_dropped_bytes == 2 * ( IPv4Header::LENGTH + 100 ),
+          "dropped bytes should be counted" );
+
+  reply_from( interface, neighbor_ip );
+  expect( sent_tags( interface ) == "ab", "tail drop should keep the oldest datagrams" );
+}
+
+void test_drop_oldest()
+{
+  NetworkInterface interface { local_eth, Address( "10.0.0.1", 0 ) };
+  interface.set_pending_limits(
+    { .max_bytes_per_neighbor = 3 * ( IPv4Header::LENGTH + 100 ), .policy = NetworkInterface::DropPolicy::DROP_OLDEST } );
+
+  const uint32_t neighbor_ip = Address( "10.0.0.2", 0 ).ipv4_numeric();
+  for ( const char tag : string { "abcde" } ) {
+    interface.send_datagram( make_datagram( tag ), neighbor_ip );
+  }
+  expect( interface.stats().pending_dropped_packets == 2, "the oldest datagrams should make room" );
+
+  reply_from( interface, neighbor_ip );
+  expect( sent_tags( interface ) == "cde", "drop-oldest should keep the newest datagrams" );
+}
+
+void test_interface_cap()
+{
+  NetworkInterface interface { local_eth, Address( "10.0.0.1", 0 ) };
+  interface.set_pending_limits( { .max_packets = 3 } );
+
+  const uint32_t first = Address( "10.0.0.2", 0 ).ipv4_numeric();
+  const uint32_t second = Address( "10.0.0.3", 0 ).ipv4_numeric();
+  interface.send_datagram( make_datagram( 'a' ), first );
+  interface.send_datagram( make_datagram( 'b' ), first );
+  interface.send_datagram( make_datagram( 'c' ), second );
+  interface.send_datagram( make_datagram( 'd' ), second );
+  expect( interface.stats().pending_dropped_packets == 1, "the interface cap should cover all neighbors" );
+
+  // a reply frees its neighbor's share of the cap
+  reply_from( interface, first );
+  expect( sent_tags( interface ) == "ab", "the first neighbor's datagrams should be sent" );
+  interface.send_datagram( make_datagram( 'e' ), second );
+  interface.send_datagram( make_datagram( 'f' ), second );
+  expect( interface.stats().pending_dropped_packets == 1, "sent datagrams should not count against the cap" );
+
+  // so does expiry
+  interface.tick( 5000 );
+  expect( sent_tags( interface ).empty(), "nothing should be sent on expiry" );
+  for ( const char tag : string { "ghi" } ) {
+    interface.send_datagram( make_datagram( tag ), second );
+  }
+  expect( interface.stats().pending_dropped_packets == 1, "expired datagrams should not count against the cap" );
+}
+
+void test_arp_rate_limit()
+{
+  NetworkInterface interface { local_eth, Address( "10.0.0.1", 0 ) };
+  interface.set_arp_rate_limit( 10, 2 );
+
+  const auto count_requests = [&] {
+    size_t requests = 0;
+    while ( auto frame = interface.maybe_send() ) {
+      requests += frame->header.type == EthernetHeader::TYPE_ARP;
+    }
+    return requests;
+  };
+
+  for ( uint32_t i = 0; i < 5; i++ ) {
+    interface.send_datagram( make_datagram( 'x' ), Address( "10.0.1.0", 0 ).ipv4_numeric() + i );
+  }
+  expect( count_requests() == 2, "only a burst of ARP requests should go out" );
+  expect( interface.stats().arp_requests_suppressed == 3, "suppressed requests should be counted" );
+  expect( interface.stats().pending_dropped_packets == 3, "their datagrams should be dropped" );
+
+  // after a refill, a suppressed next hop can try again
+  interface.tick( 100 );
+  interface.send_datagram( make_datagram( 'x' ), Address( "10.0.1.4", 0 ).ipv4_numeric() );
+  expect( count_requests() == 1, "a refilled token should allow a request" );
+
+  // datagrams to a next hop that is already waiting for ARP do not use tokens
+  interface.send_datagram( make_datagram( 'x' ), Address( "10.0.1.4", 0 ).ipv4_numeric() );
+  expect( interface.stats().arp_requests_suppressed == 3, "queueing on a pending entry should not be limited" );
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    test_token_bucket();
+    test_tail_drop();
+    test_drop_oldest();
+    test_interface_cap();
+    test_arp_rate_limit();
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
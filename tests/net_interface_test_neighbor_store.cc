@@ -0,0 +1,171 @@
+#include "common.hh"
+#include "neighbor_store.hh"
+
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+EthernetAddress address_of( const uint64_t n )
+{
+  return { static_cast<uint8_t>( n ), static_cast<uint8_t>( n >> 8 ), static_cast<uint8_t>( n >> 16 ), 0, 0, 1 };
+}
+
+// Random inserts, completions and erases, checked against std::unordered_map
+void test_against_unordered_map()
+{
+  mt19937 rng { 458 };
+  NeighborStore<uint64_t> store;
+  struct Reference
+  {
+    uint64_t state;
+    bool complete;
+    EthernetAddress address;
+  };
+  unordered_map<uint32_t, Reference> reference;
+
+  for ( int i = 0; i < 200000; i++ ) {
+    // a small key space forces full groups, long overflow chains and many erases along them
+    const uint32_t key = rng() % 4096;
+    const uint32_t op = rng() % 4;
+    if ( op < 2 ) {
+      const uint64_t value = rng();
+      const auto [slot, inserted] = store.insert( key );
+      expect( inserted == ( reference.count( key ) == 0 ), "insert() result mismatch" );
+      store.state( slot ) = value;
+      reference[key].state = value;
+    } else if ( op == 2 ) {
+      const size_t slot = store.find( key );
+      expect( ( slot != store.NONE ) == ( reference.count( key ) == 1 ), "find() presence mismatch" );
+      if ( slot != store.NONE ) {
+        store.set_complete( slot, address_of( key ) );
+        reference[key].complete = true;
+        reference[key].address = address_of( key );
+      }
+    } else {
+      expect( store.erase( key ) == ( reference.erase( key ) == 1 ), "erase result mismatch" );
+    }
+
+    const uint32_t probe = rng() % 4096;
+    const size_t slot = store.find( probe );
+    const auto it = reference.find( probe );
+    expect( ( slot != store.NONE ) == ( it != reference.end() ), "find() presence mismatch for " + to_string( probe ) );
+    if ( slot != store.NONE ) {
+      expect( store.key( slot ) == probe and store.state( slot ) == it->second.state,
+              "find() state mismatch for " + to_string( probe ) );
+      expect( store.complete( slot ) == it->second.complete, "completeness mismatch for " + to_string( probe ) );
+      const EthernetAddress* address = store.find_complete( probe );
+      expect( ( address != nullptr ) == it->second.complete
+                and ( address == nullptr or *address == it->second.address ),
+              "find_complete() mismatch for " + to_string( probe ) );
+    }
+  }
+
+  expect( store.size() == reference.size(), "size mismatch" );
+
+  size_t visited = 0;
+  store.for_each( [&]( uint32_t key, size_t slot ) {
+    expect( reference.at( key ).state == store.state( slot ), "for_each() state mismatch" );
+    visited++;
+  } );
+  expect( visited == reference.size(), "for_each() should visit every entry once" );
+}
+
+// Entries keep their state and address through the table's growth
+void test_growth()
+{
+  NeighborStore<uint64_t> store;
+  for ( uint32_t key = 0; key < 100000; key++ ) {
+    const size_t slot = store.insert( key * 7919 ).first;
+    store.state( slot ) = key;
+    if ( key % 2 ) {
+      store.set_complete( slot, address_of( key ) );
+    }
+  }
+  for ( uint32_t key = 0; key < 100000; key++ ) {
+    const size_t slot = store.find( key * 7919 );
+    expect( slot != store.NONE and store.state( slot ) == key, "an entry should survive growth" );
+    const EthernetAddress* address = store.find_complete( key * 7919 );
+    expect( key % 2 ? address != nullptr and *address == address_of( key ) : address == nullptr,
+            "an entry's address should survive growth" );
+  }
+  expect( store.find( 1 ) == store.NONE, "a missing key should not be found" );
+
+  // an erased entry's slot is reused with a fresh state and no address
+  const size_t slot = store.find( 7919 );
+  expect( store.erase( 7919 ) and not store.erase( 7919 ), "erase() should only remove once" );
+  const size_t reused = store.insert( 7919 ).first;
+  expect( reused == slot and store.state( reused ) == 0 and not store.complete( reused ),
+          "a re-added entry should start incomplete" );
+}
+
+// Once every group's overflow count has saturated (and so is never decremented again), a lookup
+// of a missing key should still end
+void test_saturated_overflow()
+{
+  // grow the table to 64 groups (which it keeps once emptied)
+  NeighborStore<uint64_t> store;
+  constexpr uint32_t GROUPS = 64;
+  for ( uint32_t key = 0; key < 300; key++ ) {
+    store.insert( key );
+  }
+  for ( uint32_t key = 0; key < 300; key++ ) {
+    store.erase( key );
+  }
+
+  // sort keys by home group (where each lands in the empty table), until every group has enough
+  // keys to saturate its count: a full group, and 255 more past it
+  constexpr size_t PER_GROUP = NeighborStore<uint64_t>::GROUP_SIZE + 255;
+  vector<vector<uint32_t>> homed( GROUPS );
+  size_t short_groups = GROUPS;
+  for ( uint32_t key = 1'000'000; short_groups > 0; key++ ) {
+    const size_t slot = store.insert( key ).first;
+    store.erase( key );
+    expect( slot / NeighborStore<uint64_t>::GROUP_SIZE < GROUPS, "the table should have 64 groups" );
+    vector<uint32_t>& keys = homed[slot / NeighborStore<uint64_t>::GROUP_SIZE];
+    if ( keys.size() < PER_GROUP ) {
+      keys.push_back( key );
+      short_groups -= keys.size() == PER_GROUP;
+    }
+  }
+
+  for ( const vector<uint32_t>& keys : homed ) {
+    for ( const uint32_t key : keys ) {
+      store.insert( key );
+    }
+    for ( const uint32_t key : keys ) {
+      store.erase( key );
+    }
+  }
+  expect( store.empty(), "every key should have been erased" );
+
+  expect( store.find( 7 ) == store.NONE, "a missing key should not be found" );
+  expect( store.find_complete( 7 ) == nullptr, "a missing key should have no address" );
+  const size_t slot = store.insert( 7 ).first;
+  store.set_complete( slot, address_of( 7 ) );
+  expect( store.find( 7 ) == slot and *store.find_complete( 7 ) == address_of( 7 ),
+          "a key should still be found once added" );
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    test_against_unordered_map();
+    test_growth();
+    test_saturated_overflow();
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,202 @@
+#include "arp_message.hh"
+#include "common.hh"
+#include "ethernet_frame.hh"
+#include "ipv4_datagram.hh"
+#include "neighbor_table.hh"
+#include "network_interface.hh"
+#include "router.hh"
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+const EthernetAddress first_eth { 0x02, 0, 0, 0, 0, 1 };
+const EthernetAddress second_eth { 0x02, 0, 0, 0, 0, 2 };
+const EthernetAddress neighbor_eth { 0x02, 0, 0, 0, 0, 9 };
+const EthernetAddress moved_eth { 0x02, 0, 0, 0, 0, 10 };
+const uint32_t first_ip = Address( "10.0.0.1", 0 ).ipv4_numeric();
+const uint32_t second_ip = Address( "10.0.0.2", 0 ).ipv4_numeric();
+const uint32_t neighbor_ip = Address( "10.0.0.9", 0 ).ipv4_numeric();
+
+InternetDatagram make_datagram()
+{
+  InternetDatagram dgram;
+  dgram.payload.emplace_back( "hello" );
+  dgram.header.len = IPv4Header::LENGTH + 5;
+  dgram.header.compute_checksum();
+  return dgram;
+}
+
+// The neighbor answers an ARP request from `interface` (whose addresses are given)
+void reply( NetworkInterface& interface,
+            const EthernetAddress& local_eth,
+            uint32_t local_ip,
+            const EthernetAddress& eth = neighbor_eth )
+{
+  ARPMessage arp;
+  arp.opcode = ARPMessage::OPCODE_REPLY;
+  arp.sender_ethernet_address = eth;
+  arp.sender_ip_address = neighbor_ip;
+  arp.target_ethernet_address = local_eth;
+  arp.target_ip_address = local_ip;
+  EthernetFrame frame;
+  frame.header = { local_eth, eth, EthernetHeader::TYPE_ARP };
+  frame.payload = serialize( arp );
+  interface.recv_frame( frame );
+}
+
+vector<EthernetFrame> take_frames( NetworkInterface& interface )
+{
+  vector<EthernetFrame> frames;
+  interface.maybe_send_batch( frames );
+  return frames;
+}
+
+bool is_ipv4_to( const vector<EthernetFrame>& frames, const EthernetAddress& dst )
+{
+  return frames.size() == 1 and frames.front().header.type == EthernetHeader::TYPE_IPv4
+         and frames.front().header.dst == dst;
+}
+
+// The table itself: lookups, ownership, and readers running alongside a writer
+void test_table()
+{
+  NeighborTable table;
+  const uint32_t a = table.attach();
+  const uint32_t b = table.attach();
+  expect( a != b and a != 0, "views should get distinct, nonzero ids" );
+
+  expect( table.learn( neighbor_ip, neighbor_eth, a ), "a new neighbor should be published" );
+  expect( not table.learn( neighbor_ip, neighbor_eth, b ), "the same address again should change nothing" );
+  expect( table.find( neighbor_ip )->owner == a, "... nor take the neighbor over" );
+  expect( not table.withdraw( neighbor_ip, b ), "only the owner should withdraw" );
+  expect( table.learn( neighbor_ip, moved_eth, b ) and table.find( neighbor_ip )->owner == b,
+          "a moved neighbor should be republished by the view that saw it move" );
+  expect( not table.withdraw( neighbor_ip, a ) and table.withdraw( neighbor_ip, b ),
+          "the new owner should be the one to withdraw" );
+  expect( not table.find( neighbor_ip ).has_value() and table.size() == 0, "the table should be empty" );
+
+  // many neighbors, spread over the shards, read while they are being published
+  constexpr uint32_t COUNT = 2000;
+  atomic<bool> done { false };
+  atomic<bool> torn { false };
+  vector<thread> readers;
+  for ( size_t r = 0; r < 3; r++ ) {
+    readers.emplace_back( [&] {
+      while ( not done.load() ) {
+        for ( uint32_t i = 0; i < COUNT; i++ ) {
+          const auto entry = table.find( 0x0A00'0000 + i );
+          if ( entry.has_value()
+               and ( entry->ethernet_address[5] != static_cast<uint8_t>( i ) or entry->owner != a ) ) {
+            torn = true;
+          }
+        }
+      }
+    } );
+  }
+  for ( uint32_t i = 0; i < COUNT; i++ ) {
+    table.learn( 0x0A00'0000 + i, { 0x02, 0, 0, 0, 0, static_cast<uint8_t>( i ) }, a );
+  }
+  done = true;
+  for ( auto& reader : readers ) {
+    reader.join();
+  }
+  expect( not torn.load(), "readers should only see whole entries" );
+  expect( table.size() == COUNT, "every neighbor should be published" );
+}
+
+// A neighbor resolved by one interface is used by the other without ARP
+void test_shared()
+{
+  NetworkInterface first { first_eth, Address( "10.0.0.1", 0 ) };
+  NetworkInterface second { second_eth, Address( "10.0.0.2", 0 ) };
+  const auto table = make_shared<NeighborTable>();
+  first.set_neighbor_table( table );
+  second.set_neighbor_table( table );
+
+  first.send_datagram( make_datagram(), neighbor_ip );
+  expect( take_frames( first ).size() == 1, "the first interface should send an ARP request" );
+  reply( first, first_eth, first_ip );
+  expect( is_ipv4_to( take_frames( first ), neighbor_eth ), "its datagram should follow the reply" );
+  expect( table->find( neighbor_ip ).has_value(), "the neighbor should be published" );
+
+  second.send_datagram( make_datagram(), neighbor_ip );
+  expect( is_ipv4_to( take_frames( second ), neighbor_eth ), "the second interface should send at once" );
+  expect( second.stats().arp_requests_sent == 0 and second.stats().neighbor_table_hits == 1,
+          "... found in the shared table, not by ARP" );
+  expect( second.resolved( neighbor_ip ), "the neighbor should now be in its own table" );
+
+  // adjacencies and resolve() look in the shared table too
+  NetworkInterface third { { 0x02, 0, 0, 0, 0, 3 }, Address( "10.0.0.3", 0 ) };
+  third.set_neighbor_table( table );
+  const uint32_t adjacency = third.adjacency( neighbor_ip );
+  third.send_to_adjacency( make_datagram(), adjacency );
+  expect( is_ipv4_to( take_frames( third ), neighbor_eth ), "a new adjacency should be resolved from the table" );
+  NetworkInterface fourth { { 0x02, 0, 0, 0, 0, 4 }, Address( "10.0.0.4", 0 ) };
+  fourth.set_neighbor_table( table );
+  expect( fourth.resolve( neighbor_ip ) and take_frames( fourth ).empty(), "resolve() should need no ARP" );
+
+  // a neighbor that moves is republished (the others pick it up once their entries expire)
+  reply( second, second_eth, second_ip, moved_eth );
+  expect( table->find( neighbor_ip )->ethernet_address == moved_eth, "the move should be published" );
+
+  // when the owner's entry expires, the neighbor is withdrawn; others' entries do not withdraw it
+  first.tick( 30'000 );
+  expect( table->find( neighbor_ip ).has_value(), "a view that does not own it should not withdraw it" );
+  second.tick( 30'000 );
+  expect( not table->find( neighbor_ip ).has_value(), "the owner's expiry should withdraw it" );
+  fourth.tick( 30'000 );
+  fourth.send_datagram( make_datagram(), neighbor_ip );
+  const vector<EthernetFrame> frames = take_frames( fourth );
+  expect( frames.size() == 1 and frames.front().header.type == EthernetHeader::TYPE_ARP,
+          "once withdrawn, the neighbor should need ARP again" );
+
+  // an interface that shares nothing (the default) keeps to itself
+  NetworkInterface alone { { 0x02, 0, 0, 0, 0, 5 }, Address( "10.0.0.5", 0 ) };
+  reply( first, first_eth, first_ip );
+  expect( not alone.resolve( neighbor_ip ) and alone.stats().neighbor_table_hits == 0,
+          "an unshared interface should use ARP" );
+}
+
+// The router shares one table between the interfaces it is told face the same segment
+void test_router()
+{
+  Router router;
+  router.add_interface( AsyncNetworkInterface { first_eth, Address( "10.0.0.1", 0 ) } );
+  router.add_interface( AsyncNetworkInterface { second_eth, Address( "10.0.0.2", 0 ) } );
+  router.add_interface( AsyncNetworkInterface { { 0x02, 0, 0, 0, 1, 0 }, Address( "192.168.0.1", 0 ) } );
+  const vector<size_t> segment { 0, 1 };
+  const auto table = router.share_neighbors( segment );
+  expect( router.interface( 0 ).neighbor_table() == table and router.interface( 1 ).neighbor_table() == table,
+          "the interfaces should share the table" );
+  expect( router.interface( 2 ).neighbor_table() == nullptr, "other interfaces should not" );
+
+  reply( router.interface( 0 ), first_eth, first_ip );
+  expect( router.interface( 1 ).resolve( neighbor_ip ), "a neighbor learned on one should be known on the other" );
+  expect( not router.interface( 2 ).resolve( neighbor_ip ), "... and not elsewhere" );
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    test_table();
+    test_shared();
+    test_router();
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,172 @@
+#include "arp_message.hh"
+#include "common.hh"
+#include "exception.hh"
+#include "frame_link.hh"
+#include "ipv6_datagram.hh"
+#include "ipv6_view.hh"
+#include "packet_ring.hh"
+
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+namespace {
+
+const EthernetAddress eth_a { 0x02, 0, 0, 0, 0, 1 };
+const EthernetAddress eth_b { 0x02, 0, 0, 0, 0, 2 };
+
+// Frames read from the ring, in place
+void test_ring( PacketRing& sender, PacketRing& receiver )
+{
+  for ( int i = 0; i < 10; i++ ) {
+    EthernetFrame frame;
+    frame.header = { eth_b, eth_a, 0x88B5 }; // (an ethertype for local experiments)
+    frame.payload.emplace_back( "frame " + to_string( i ) + string( 50, '.' ) );
+    expect( sender.send( serialize( frame ) ), "a frame should fit in the TX ring" );
+  }
+  sender.flush();
+
+  vector<string> received;
+  const auto deadline = steady_clock::now() + seconds( 2 );
+  while ( received.size() < 10 and steady_clock::now() < deadline ) {
+    receiver.wait( 10 );
+    while ( const auto block = receiver.next_block() ) {
+      for ( const string_view bytes : *block ) {
+        if ( bytes.size() > EthernetHeader::LENGTH and bytes.substr( 6, 6 ) == string_view { "\x02\0\0\0\0\x01", 6 } ) {
+          received.emplace_back( bytes.substr( EthernetHeader::LENGTH, 7 ) );
+        }
+      }
+    }
+  }
+  expect( received.size() == 10, "every frame should be received, got " + to_string( received.size() ) );
+  for ( int i = 0; i < 10; i++ ) {
+    expect( received[i] == ( "frame " + to_string( i ) ).substr( 0, 7 ), "frames should arrive whole and in order" );
+  }
+
+  bool threw = false;
+  try {
+    sender.send( { Buffer { string( sender.max_frame_size() + 1, 'x' ) } } );
+  } catch ( const runtime_error& ) {
+    threw = true;
+  }
+  expect( threw, "a frame too big for a TX slot should be refused" );
+}
+
+// Two interfaces linked through the rings: ARP, then forwarding
+void test_ring_link( PacketRing& ring_a, PacketRing& ring_b )
+{
+  const uint32_t ip_b = Address( "10.0.0.2", 0 ).ipv4_numeric();
+  NetworkInterface interface_a { eth_a, Address( "10.0.0.1", 0 ) };
+  AsyncNetworkInterface interface_b { eth_b, Address( "10.0.0.2", 0 ) };
+  RingLink link_a { ring_a };
+  RingLink link_b { ring_b };
+
+  for ( int i = 0; i < 20; i++ ) {
+    InternetDatagram dgram;
+    dgram.header.src = Address( "10.0.0.1", 0 ).ipv4_numeric();
+    dgram.header.dst = ip_b;
+    dgram.payload.emplace_back( "datagram " + to_string( i ) );
+    dgram.header.len = IPv4Header::LENGTH + dgram.payload.back().size();
+    dgram.header.compute_checksum();
+    interface_a.send_datagram( dgram, ip_b );
+  }
+
+  size_t delivered = 0;
+  vector<InternetDatagram> ignored;
+  const auto deadline = steady_clock::now() + seconds( 2 );
+  while ( delivered < 20 and steady_clock::now() < deadline ) {
+    link_a.transmit( interface_a );
+    ring_b.wait( 10 );
+    link_b.receive( interface_b );
+    link_b.transmit( interface_b );
+    ring_a.wait( 1 );
+    link_a.receive( interface_a, ignored );
+    while ( const auto dgram = interface_b.maybe_receive() ) {
+      expect( string_view { dgram->payload.front() } == "datagram " + to_string( delivered ),
+              "datagrams should be delivered in order" );
+      delivered++;
+    }
+  }
+  expect( delivered == 20, "every datagram should cross the link, got " + to_string( delivered ) );
+}
+
+// The same for IPv6: the neighbor is resolved with NDP across the rings, then datagrams forwarded
+void test_ring_link6( PacketRing& ring_a, PacketRing& ring_b )
+{
+  NetworkInterface interface_a { eth_a, Address( "10.0.0.1", 0 ) };
+  AsyncNetworkInterface interface_b { eth_b, Address( "10.0.0.2", 0 ) };
+  interface_a.set_ipv6_address( ipv6_address( "2001:db8::a" ) );
+  interface_b.set_ipv6_address( ipv6_address( "2001:db8::b" ) );
+  interface_b.set_forwarding( true );
+  RingLink link_a { ring_a };
+  RingLink link_b { ring_b };
+
+  const IPv6Address ip_b = *interface_b.ipv6_address();
+  for ( int i = 0; i < 5; i++ ) {
+    IPv6Datagram dgram;
+    dgram.header.src = *interface_a.ipv6_address();
+    dgram.header.dst = ip_b;
+    dgram.header.hop_limit = 64;
+    dgram.header.next_header = IPv6Header::NEXT_HEADER_UDP;
+    dgram.payload.emplace_back( "datagram " + to_string( i ) );
+    dgram.header.payload_length = static_cast<uint16_t>( dgram.payload.back().size() );
+    interface_a.send_datagram6( IPv6View::of( dgram ), ip_b );
+  }
+
+  vector<IPv6View> delivered;
+  vector<InternetDatagram> ignored;
+  const auto deadline = steady_clock::now() + seconds( 2 );
+  while ( delivered.size() < 5 and steady_clock::now() < deadline ) {
+    link_a.transmit( interface_a );
+    ring_b.wait( 10 );
+    link_b.receive( interface_b );
+    link_b.transmit( interface_b );
+    ring_a.wait( 1 );
+    link_a.receive( interface_a, ignored );
+    interface_b.maybe_receive_views6( delivered );
+  }
+  expect( interface_b.stats().ndp_solicitations_received >= 1 and interface_a.resolved6( ip_b ),
+          "the neighbor should be resolved with NDP" );
+  expect( delivered.size() == 5, "every IPv6 datagram should cross the link, got " + to_string( delivered.size() ) );
+  for ( size_t i = 0; i < delivered.size(); i++ ) {
+    expect( delivered[i].dst() == ip_b and delivered[i].payload_length() == string( "datagram 0" ).size(),
+            "IPv6 datagrams should arrive whole" );
+  }
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    // (packet sockets need CAP_NET_RAW; without it there is nothing to test)
+    optional<PacketRing> ring_a;
+    optional<PacketRing> ring_b;
+    try {
+      ring_a.emplace( "lo" );
+      ring_b.emplace( "lo" );
+    } catch ( const unix_error& e ) {
+      if ( e.code().value() == EPERM ) {
+        cerr << "skipped: " << e.what() << endl;
+        return EXIT_SUCCESS;
+      }
+      throw;
+    }
+
+    test_ring( *ring_a, *ring_b );
+    test_ring_link( *ring_a, *ring_b );
+    test_ring_link6( *ring_a, *ring_b );
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
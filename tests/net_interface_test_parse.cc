@@ -0,0 +1,164 @@
+#include "arp_message.hh"
+#include "common.hh"
+#include "ethernet_header.hh"
+#include "header_codec.hh"
+#include "ipv4_header.hh"
+
+#include <array>
+#include <bit>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+string concat( const vector<Buffer>& buffers )
+{
+  string out;
+  for ( const auto& piece : buffers ) {
+    out.append( piece );
+  }
+  return out;
+}
+
+// Parse `wire` once from a single buffer (fixed-offset fast path) and once split at `split`
+// (generic byte-at-a-time path), and check that both agree with the original object.
+template<class T>
+void check_round_trip( const T& original, size_t split, const string& name )
+{
+  const string wire = concat( serialize( original ) );
+
+  T fast;
+  expect( parse( fast, { Buffer { wire } } ), name + ": contiguous parse failed" );
+  expect( concat( serialize( fast ) ) == wire, name + ": contiguous parse changed the header" );
+
+  split = 1 + split % ( wire.size() - 1 );
+  T slow;
+  expect( parse( slow, { Buffer { wire.substr( 0, split ) }, Buffer { wire.substr( split ) } } ),
+          name + ": split parse failed" );
+  expect( concat( serialize( slow ) ) == wire, name + ": split parse changed the header" );
+}
+
+void test_headers()
+{
+  mt19937 rng { 458 };
+  for ( int i = 0; i < 1000; i++ ) {
+    IPv4Header ip;
+    ip.tos = rng();
+    ip.len = rng();
+    ip.id = rng();
+    ip.df = rng() % 2;
+    ip.mf = rng() % 2;
+    ip.offset = rng() & 0x1fff;
+    ip.ttl = rng();
+    ip.proto = rng();
+    ip.src = rng();
+    ip.dst = rng();
+    ip.compute_checksum();
+    check_round_trip( ip, rng(), "IPv4Header" );
+
+    EthernetHeader eth {};
+    for ( auto& b : eth.dst ) {
+      b = rng();
+    }
+    for ( auto& b : eth.src ) {
+      b = rng();
+    }
+    eth.type = rng();
+    check_round_trip( eth, rng(), "EthernetHeader" );
+
+    ARPMessage arp;
+    arp.opcode = 1 + rng() % 2;
+    for ( auto& b : arp.sender_ethernet_address ) {
+      b = rng();
+    }
+    arp.sender_ip_address = rng();
+    for ( auto& b : arp.target_ethernet_address ) {
+      b = rng();
+    }
+    arp.target_ip_address = rng();
+    check_round_trip( arp, rng(), "ARPMessage" );
+  }
+
+  // a bad checksum is rejected on both paths
+  IPv4Header bad;
+  bad.compute_checksum();
+  bad.cksum++;
+  const string wire = concat( serialize( bad ) );
+  IPv4Header out;
+  expect( not parse( out, { Buffer { wire } } ), "contiguous parse should reject a bad checksum" );
+  expect( not parse( out, { Buffer { wire.substr( 0, 7 ) }, Buffer { wire.substr( 7 ) } } ),
+          "split parse should reject a bad checksum" );
+}
+
+// The generated codecs put each field where the RFCs say, and honor a field's byte order
+void test_layout()
+{
+  IPv4Header ip;
+  ip.tos = 0x12;
+  ip.len = 0x3456;
+  ip.id = 0x789A;
+  ip.df = false;
+  ip.mf = true;
+  ip.offset = 0x0BCD;
+  ip.ttl = 0x40;
+  ip.proto = 0x11;
+  ip.cksum = 0xEF01;
+  ip.src = 0x0A000001;
+  ip.dst = 0xC0A80102;
+  const string ip_wire = concat( serialize( ip ) );
+  expect( ip_wire
+            == string { "\x45\x12\x34\x56\x78\x9A\x2B\xCD\x40\x11\xEF\x01\x0A\x00\x00\x01\xC0\xA8\x01\x02", 20 },
+          "IPv4Header: fields should be packed big-endian at their offsets" );
+
+  EthernetHeader eth { { 1, 2, 3, 4, 5, 6 }, { 7, 8, 9, 10, 11, 12 }, EthernetHeader::TYPE_ARP };
+  expect( concat( serialize( eth ) ) == string { "\x01\x02\x03\x04\x05\x06\x07\x08\x09\x0A\x0B\x0C\x08\x06", 14 },
+          "EthernetHeader: fields should be at their offsets" );
+
+  struct Mixed
+  {
+    uint16_t little;
+    uint32_t big;
+    uint8_t high;
+    uint8_t low;
+  };
+  using MixedLayout = codec::Layout<7,
+                                    codec::Scalar<&Mixed::little, 0, std::endian::little>,
+                                    codec::Scalar<&Mixed::big, 2>,
+                                    codec::Packed<uint8_t, 6, codec::Bits<&Mixed::high, 5, 3>, codec::Bits<&Mixed::low, 0, 5>>>;
+  const Mixed mixed { 0x0102, 0x03040506, 0x5, 0x1F };
+  array<uint8_t, 7> raw {};
+  MixedLayout::encode( mixed, raw.data() );
+  expect( raw == array<uint8_t, 7> { 0x02, 0x01, 0x03, 0x04, 0x05, 0x06, 0xBF }, "a layout should honor byte order" );
+  Mixed back {};
+  MixedLayout::decode( raw.data(), back );
+  expect( back.little == mixed.little and back.big == mixed.big and back.high == mixed.high and back.low == mixed.low,
+          "a layout should decode what it encodes" );
+
+  // too few bytes is an error, split or not
+  IPv4Header out;
+  const string truncated = ip_wire.substr( 0, 19 );
+  expect( not parse( out, { Buffer { truncated } } ), "a short header should be rejected" );
+  expect( not parse( out, { Buffer { truncated.substr( 0, 4 ) }, Buffer { truncated.substr( 4 ) } } ),
+          "a short split header should be rejected" );
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    test_headers();
+    test_layout();
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,182 @@
+#include "arp_message.hh"
+#include "common.hh"
+#include "ethernet_frame.hh"
+#include "ipv4_datagram.hh"
+#include "network_interface.hh"
+#include "pcap.hh"
+
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+string temp_path( const string& name )
+{
+  return ( filesystem::temp_directory_path() / ( name + "." + to_string( getpid() ) + ".pcap" ) ).string();
+}
+
+string joined( const vector<Buffer>& pieces )
+{
+  string out;
+  for ( const auto& piece : pieces ) {
+    out.append( piece );
+  }
+  return out;
+}
+
+const EthernetAddress local_eth { 0x02, 0, 0, 0, 0, 1 };
+const EthernetAddress neighbor_eth { 0x02, 0, 0, 0, 0, 2 };
+const uint32_t local_ip = Address( "10.0.0.1", 0 ).ipv4_numeric();
+const uint32_t neighbor_ip = Address( "10.0.0.2", 0 ).ipv4_numeric();
+
+// Frames written are read back as they were, with their timestamps
+void test_round_trip()
+{
+  const string path = temp_path( "net_interface_test_pcap" );
+  const string big( 300, 'b' );
+  {
+    PcapWriter writer { path };
+    expect( writer.capture( "first frame", 1'700'000'000'123'456'789 ), "a frame should be captured" );
+    expect( writer.capture( big, 1'700'000'001'000'000'000 ), "a frame should be captured" );
+    writer.flush();
+    expect( writer.stats().captured == 2 and writer.stats().dropped == 0, "the captures should be counted" );
+  }
+
+  PcapReader reader { path };
+  expect( reader.link_type() == PcapWriter::LINKTYPE_ETHERNET, "the capture should be of Ethernet frames" );
+  auto record = reader.next();
+  expect( record.has_value() and record->bytes == "first frame" and record->timestamp_ns == 1'700'000'000'123'456'789,
+          "the first frame should be read back exactly" );
+  record = reader.next();
+  expect( record.has_value() and record->bytes == big and record->original_length == big.size(),
+          "the second frame should be read back exactly" );
+  expect( not reader.next().has_value(), "there should be nothing else" );
+  reader.rewind();
+  expect( reader.next()->bytes == "first frame", "rewind() should start again" );
+
+  // a short snapshot length keeps the start of each frame, and its real length
+  {
+    PcapWriter writer { path, PcapWriter::DEFAULT_CAPACITY, 14 };
+    writer.capture( big, 0 );
+  }
+  PcapReader cut { path };
+  record = cut.next();
+  expect( record.has_value() and record->bytes.size() == 14 and record->original_length == big.size(),
+          "a frame over the snapshot length should be cut short" );
+  filesystem::remove( path );
+}
+
+// Files from other machines: microsecond timestamps, big-endian, and a last record cut short by
+// an interrupted capture
+void test_foreign_file()
+{
+  string file;
+  const auto big_endian = [&]( uint32_t value, size_t length ) {
+    for ( size_t i = 0; i < length; i++ ) {
+      file.push_back( static_cast<char>( value >> ( ( length - i - 1 ) * 8 ) ) );
+    }
+  };
+  big_endian( 0xA1B2'C3D4, 4 );
+  big_endian( 2, 2 );
+  big_endian( 4, 2 );
+  big_endian( 0, 4 );
+  big_endian( 0, 4 );
+  big_endian( 65535, 4 );
+  big_endian( 1, 4 );
+  big_endian( 10, 4 );
+  big_endian( 250'000, 4 );
+  big_endian( 3, 4 );
+  big_endian( 60, 4 );
+  file += "abc";
+  big_endian( 11, 4 );
+  big_endian( 0, 4 );
+  big_endian( 100, 4 );
+  big_endian( 100, 4 );
+  file += "only part of the frame";
+
+  PcapReader reader { string_view { file } };
+  const auto record = reader.next();
+  expect( record.has_value() and record->bytes == "abc" and record->original_length == 60
+            and record->timestamp_ns == 10'250'000'000,
+          "a big-endian microsecond capture should be read" );
+  expect( not reader.next().has_value(), "a record cut short should end the capture" );
+
+  bool threw = false;
+  try {
+    PcapReader bad { string_view { "not a capture file at all" } };
+  } catch ( const runtime_error& ) {
+    threw = true;
+  }
+  expect( threw, "a file that is not a capture should be rejected" );
+}
+
+// An interface captures what it receives and what it sends, in order
+void test_interface_tap()
+{
+  const string path = temp_path( "net_interface_test_pcap_tap" );
+  auto writer = make_shared<PcapWriter>( path );
+  NetworkInterface interface { local_eth, Address( "10.0.0.1", 0 ) };
+  interface.set_capture( writer );
+
+  InternetDatagram dgram;
+  dgram.payload.emplace_back( "hello" );
+  dgram.header.len = IPv4Header::LENGTH + 5;
+  dgram.header.compute_checksum();
+  interface.send_datagram( dgram, neighbor_ip );
+  const auto request = interface.maybe_send();
+
+  ARPMessage arp;
+  arp.opcode = ARPMessage::OPCODE_REPLY;
+  arp.sender_ethernet_address = neighbor_eth;
+  arp.sender_ip_address = neighbor_ip;
+  arp.target_ethernet_address = local_eth;
+  arp.target_ip_address = local_ip;
+  EthernetFrame reply;
+  reply.header = { local_eth, neighbor_eth, EthernetHeader::TYPE_ARP };
+  reply.payload = serialize( arp );
+  interface.recv_frame( reply );
+  vector<EthernetFrame> sent;
+  interface.maybe_send_batch( sent );
+  expect( request.has_value() and sent.size() == 1, "an ARP request, then the datagram, should go out" );
+
+  interface.set_capture( nullptr );
+  interface.recv_frame( reply );
+  writer->flush();
+  expect( writer->stats().captured == 3, "three frames should have been captured" );
+
+  PcapReader reader { path };
+  const vector<string> expected { joined( serialize( *request ) ), joined( serialize( reply ) ), joined( serialize( sent[0] ) ) };
+  uint64_t last_time = 0;
+  for ( const auto& frame : expected ) {
+    const auto record = reader.next();
+    expect( record.has_value() and record->bytes == frame, "the frames should be captured in order" );
+    expect( record->timestamp_ns >= last_time, "timestamps should not go backwards" );
+    last_time = record->timestamp_ns;
+  }
+  expect( not reader.next().has_value(), "nothing should be captured once capture is off" );
+  filesystem::remove( path );
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    test_round_trip();
+    test_foreign_file();
+    test_interface_tap();
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
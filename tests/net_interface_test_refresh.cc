@@ -0,0 +1,175 @@
+#include "arp_message.hh"
+#include "common.hh"
+#include "ethernet_frame.hh"
+#include "ipv4_datagram.hh"
+#include "network_interface.hh"
+
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+const EthernetAddress local_eth { 0x02, 0, 0, 0, 0, 1 };
+const EthernetAddress neighbor_eth { 0x02, 0, 0, 0, 0, 2 };
+const EthernetAddress standby_eth { 0x02, 0, 0, 0, 0, 3 };
+const uint32_t local_ip = Address( "10.0.0.1", 0 ).ipv4_numeric();
+const uint32_t neighbor_ip = Address( "10.0.0.2", 0 ).ipv4_numeric();
+
+InternetDatagram make_datagram()
+{
+  InternetDatagram dgram;
+  dgram.payload.emplace_back( "hello" );
+  dgram.header.len = IPv4Header::LENGTH + 5;
+  dgram.header.compute_checksum();
+  return dgram;
+}
+
+EthernetFrame arp_frame( uint16_t opcode,
+                         const EthernetAddress& sender_eth,
+                         uint32_t sender_ip,
+                         const EthernetAddress& dst,
+                         uint32_t target_ip )
+{
+  ARPMessage arp;
+  arp.opcode = opcode;
+  arp.sender_ethernet_address = sender_eth;
+  arp.sender_ip_address = sender_ip;
+  arp.target_ip_address = target_ip;
+  EthernetFrame frame;
+  frame.header = { dst, sender_eth, EthernetHeader::TYPE_ARP };
+  frame.payload = serialize( arp );
+  return frame;
+}
+
+// The neighbor answers a request (or has just been learned)
+void reply( NetworkInterface& interface, const EthernetAddress& eth = neighbor_eth )
+{
+  interface.recv_frame( arp_frame( ARPMessage::OPCODE_REPLY, eth, neighbor_ip, local_eth, local_ip ) );
+}
+
+vector<EthernetFrame> take_frames( NetworkInterface& interface )
+{
+  vector<EthernetFrame> frames;
+  interface.maybe_send_batch( frames );
+  return frames;
+}
+
+// Where a datagram to the neighbor goes right now (or a broadcast ARP request, if it must wait)
+EthernetFrame send_one( NetworkInterface& interface )
+{
+  interface.send_datagram( make_datagram(), neighbor_ip );
+  const vector<EthernetFrame> frames = take_frames( interface );
+  expect( frames.size() == 1, "one frame should go out, not " + to_string( frames.size() ) );
+  return frames.front();
+}
+
+bool is_ipv4_to( const EthernetFrame& frame, const EthernetAddress& dst )
+{
+  return frame.header.type == EthernetHeader::TYPE_IPv4 and frame.header.dst == dst;
+}
+
+// A refresh request goes out before the entry expires; its reply keeps the entry alive
+void test_refresh_answered()
+{
+  NetworkInterface interface { local_eth, Address( "10.0.0.1", 0 ) };
+  interface.set_arp_refresh( 2000 );
+  reply( interface );
+
+  interface.tick( 27'999 );
+  expect( take_frames( interface ).empty(), "no refresh should go out early" );
+  interface.tick( 1 );
+  const vector<EthernetFrame> refresh = take_frames( interface );
+  expect( refresh.size() == 1 and refresh.front().header.dst == neighbor_eth,
+          "a unicast refresh request should go out 2 s before expiry" );
+  ARPMessage arp;
+  expect( parse( arp, refresh.front().payload ) and arp.opcode == ARPMessage::OPCODE_REQUEST
+            and arp.target_ip_address == neighbor_ip,
+          "the refresh should be an ARP request for the neighbor" );
+
+  interface.tick( 1000 ); // (the stale entry is still used meanwhile)
+  expect( is_ipv4_to( send_one( interface ), neighbor_eth ), "a refreshing entry should still forward" );
+
+  reply( interface );
+  interface.tick( 5000 ); // past the original expiry
+  expect( is_ipv4_to( send_one( interface ), neighbor_eth ), "an answered refresh should renew the entry" );
+  expect( interface.stats().expiries == 0 and interface.stats().arp_refreshes_sent == 1,
+          "the entry should not have expired" );
+
+  // a second round, 30 s after the answer
+  interface.tick( 23'000 );
+  expect( take_frames( interface ).size() == 1 and interface.stats().arp_refreshes_sent == 2,
+          "the renewed entry should be refreshed again" );
+}
+
+// An unanswered refresh lets the entry expire when it would have anyway
+void test_refresh_unanswered()
+{
+  NetworkInterface interface { local_eth, Address( "10.0.0.1", 0 ) };
+  interface.set_arp_refresh( 2000 );
+  reply( interface );
+
+  interface.tick( 29'999 );
+  expect( take_frames( interface ).size() == 1, "the refresh should go out" );
+  expect( is_ipv4_to( send_one( interface ), neighbor_eth ), "the entry should last until its expiry" );
+
+  interface.tick( 1 );
+  const EthernetFrame request = send_one( interface );
+  expect( request.header.type == EthernetHeader::TYPE_ARP and request.header.dst == ETHERNET_BROADCAST,
+          "an expired entry should need a broadcast ARP again" );
+  expect( interface.stats().expiries == 1, "the unanswered entry should have expired" );
+
+  // without refreshing (the default), an entry just expires
+  NetworkInterface plain { local_eth, Address( "10.0.0.1", 0 ) };
+  reply( plain );
+  plain.tick( 30'000 );
+  expect( take_frames( plain ).empty() and plain.stats().arp_refreshes_sent == 0,
+          "no refresh should be sent by default" );
+}
+
+// A gratuitous ARP with a new address for a known neighbor takes effect at once
+void test_gratuitous()
+{
+  NetworkInterface interface { local_eth, Address( "10.0.0.1", 0 ) };
+  reply( interface );
+  const uint32_t adjacency = interface.adjacency( neighbor_ip );
+
+  // a failover: the standby announces the neighbor's address, in a broadcast request for itself
+  interface.recv_frame(
+    arp_frame( ARPMessage::OPCODE_REQUEST, standby_eth, neighbor_ip, ETHERNET_BROADCAST, neighbor_ip ) );
+  expect( take_frames( interface ).empty(), "a gratuitous ARP should not be answered" );
+  expect( is_ipv4_to( send_one( interface ), standby_eth ), "datagrams should go to the new address" );
+  interface.send_to_adjacency( make_datagram(), adjacency );
+  expect( is_ipv4_to( take_frames( interface ).at( 0 ), standby_eth ), "the adjacency should follow the change" );
+  expect( interface.stats().arp_address_changes == 1, "the change should be counted" );
+
+  // ...and a gratuitous reply for a neighbor never seen before is learned too
+  const uint32_t other_ip = Address( "10.0.0.3", 0 ).ipv4_numeric();
+  interface.recv_frame( arp_frame( ARPMessage::OPCODE_REPLY, neighbor_eth, other_ip, ETHERNET_BROADCAST, other_ip ) );
+  expect( interface.resolved( other_ip ), "a gratuitous reply should be learned" );
+
+  // an ARP probe has no sender address to learn, but asks for ours: answered, not learned
+  interface.recv_frame( arp_frame( ARPMessage::OPCODE_REQUEST, standby_eth, 0, ETHERNET_BROADCAST, local_ip ) );
+  expect( take_frames( interface ).size() == 1, "a probe for our address should be answered" );
+  expect( not interface.resolved( 0 ), "a probe should not be learned" );
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    test_refresh_answered();
+    test_refresh_unanswered();
+    test_gratuitous();
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
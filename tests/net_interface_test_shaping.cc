@@ -0,0 +1,137 @@
+#include "arp_message.hh"
+#include "common.hh"
+#include "ethernet_frame.hh"
+#include "ipv4_datagram.hh"
+#include "network_interface.hh"
+
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+const EthernetAddress local_eth { 0x02, 0, 0, 0, 0, 1 };
+const EthernetAddress neighbor_eth { 0x02, 0, 0, 0, 0, 2 };
+const uint32_t local_ip = Address( "10.0.0.1", 0 ).ipv4_numeric();
+const uint32_t neighbor_ip = Address( "10.0.0.2", 0 ).ipv4_numeric();
+
+// A datagram making a frame of 14 + 20 + `payload` bytes
+InternetDatagram make_datagram( size_t payload )
+{
+  InternetDatagram dgram;
+  dgram.header.src = neighbor_ip;
+  dgram.header.dst = local_ip;
+  dgram.payload.emplace_back( string( payload, 'x' ) );
+  dgram.header.len = IPv4Header::LENGTH + payload;
+  dgram.header.compute_checksum();
+  return dgram;
+}
+
+void learn_neighbor( NetworkInterface& interface )
+{
+  ARPMessage arp;
+  arp.opcode = ARPMessage::OPCODE_REPLY;
+  arp.sender_ethernet_address = neighbor_eth;
+  arp.sender_ip_address = neighbor_ip;
+  arp.target_ethernet_address = local_eth;
+  arp.target_ip_address = local_ip;
+  EthernetFrame frame;
+  frame.header = { local_eth, neighbor_eth, EthernetHeader::TYPE_ARP };
+  frame.payload = serialize( arp );
+  interface.recv_frame( frame );
+}
+
+size_t drain( NetworkInterface& interface )
+{
+  vector<EthernetFrame> frames;
+  return interface.maybe_send_batch( frames );
+}
+
+// Frames wait in the send queue until the shaper has the tokens for them
+void test_shaper()
+{
+  NetworkInterface interface { local_eth, Address( "10.0.0.1", 0 ) };
+  learn_neighbor( interface );
+  interface.set_egress_shaper( 100'000, 3000 ); // 100 bytes per ms
+
+  for ( size_t i = 0; i < 10; i++ ) {
+    interface.send_datagram( make_datagram( 1000 ), neighbor_ip ); // 1034-byte frames
+  }
+  expect( drain( interface ) == 2, "a full bucket should let two frames out" );
+  expect( not interface.maybe_send().has_value(), "the third frame should be held" );
+  expect( interface.stats().shaper_delays == 2, "held frames should be counted" );
+
+  interface.tick( 10 ); // 932 + 1000 bytes of tokens
+  expect( drain( interface ) == 1, "10 ms should let one more frame out" );
+  interface.tick( 1000 ); // (up to the burst)
+  expect( drain( interface ) == 2, "the bucket should refill up to its burst" );
+
+  size_t sent = 5;
+  for ( int ms = 0; ms < 100; ms++ ) {
+    interface.tick( 1 );
+    sent += drain( interface );
+  }
+  expect( sent == 10, "every frame should eventually go out" );
+  expect( interface.stats().tx_frames == 10 and interface.stats().egress_drops == 0, "no frame should be lost" );
+
+  // a frame larger than the burst still goes out (taking a whole burst)
+  interface.set_egress_shaper( 1000, 500 );
+  interface.send_datagram( make_datagram( 1000 ), neighbor_ip );
+  expect( interface.maybe_send().has_value(), "a large frame should not be held forever" );
+  interface.send_datagram( make_datagram( 100 ), neighbor_ip );
+  expect( not interface.maybe_send().has_value(), "the burst should have been used up" );
+  interface.tick( 200 );
+  expect( interface.maybe_send().has_value(), "the bucket should refill" );
+}
+
+EthernetFrame incoming( size_t payload )
+{
+  EthernetFrame frame;
+  frame.header = { local_eth, neighbor_eth, EthernetHeader::TYPE_IPv4 };
+  frame.payload = serialize( make_datagram( payload ) );
+  return frame;
+}
+
+// Received frames over the policer's rate are dropped
+void test_policer()
+{
+  NetworkInterface interface { local_eth, Address( "10.0.0.1", 0 ) };
+  interface.set_ingress_policer( 10'000, 2000 );
+
+  size_t accepted = 0;
+  for ( size_t i = 0; i < 5; i++ ) {
+    accepted += interface.recv_frame( incoming( 500 ) ).has_value() ? 1 : 0; // 534-byte frames
+  }
+  expect( accepted == 3, "the burst should admit three frames, not " + to_string( accepted ) );
+  expect( interface.stats().policer_drops == 2 and interface.stats().policer_dropped_bytes == 2 * 534,
+          "the policed frames should be counted" );
+  expect( interface.stats().rx_frames == 5, "policed frames are still received" );
+
+  interface.tick( 100 ); // 1000 bytes of tokens
+  expect( interface.recv_frame( incoming( 500 ) ).has_value(), "the bucket should refill" );
+
+  // unlimited by default
+  NetworkInterface plain { local_eth, Address( "10.0.0.1", 0 ) };
+  for ( size_t i = 0; i < 100; i++ ) {
+    expect( plain.recv_frame( incoming( 1400 ) ).has_value(), "the default should not police" );
+  }
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    test_shaper();
+    test_policer();
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
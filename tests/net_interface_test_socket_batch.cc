@@ -0,0 +1,192 @@
+#include "common.hh"
+#include "frame_link.hh"
+#include "socket.hh"
+
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+// Two UDP sockets on the loopback interface, connected to each other
+pair<UDPSocket, UDPSocket> socket_pair()
+{
+  UDPSocket a;
+  UDPSocket b;
+  a.bind( Address( "127.0.0.1", 0 ) );
+  b.bind( Address( "127.0.0.1", 0 ) );
+  a.connect( b.local_address() );
+  b.connect( a.local_address() );
+  return { std::move( a ), std::move( b ) };
+}
+
+void test_batches()
+{
+  auto [a, b] = socket_pair();
+  b.set_blocking( false );
+
+  vector<string> payloads( 4 );
+  expect( b.recv_batch( payloads ) == 0, "a non-blocking socket with nothing waiting should receive nothing" );
+
+  // each datagram gathered from its pieces
+  const vector<vector<Buffer>> datagrams { { string { "hello, " }, string { "world" } },
+                                           { string { "two" } },
+                                           { string { "three" }, string {}, string { "!" } } };
+  expect( a.send_batch( datagrams ) == 3, "every datagram should be sent" );
+  expect( a.write_count() == 1, "a batch should be sent with one system call" );
+
+  payloads[0].reserve( 4096 );
+  expect( b.recv_batch( payloads ) == 3, "every datagram should be received at once" );
+  expect( b.read_count() == 1, "a batch should be received with one system call" );
+  expect( payloads[0] == "hello, world" and payloads[1] == "two" and payloads[2] == "three!",
+          "datagrams should be received whole and in order" );
+  expect( payloads[3].empty(), "unused payloads should be left empty" );
+
+  // a datagram too big for its buffer
+  a.send_batch( vector<vector<Buffer>> { { string( DatagramSocket::kMinBatchBufferSize + 1, 'x' ) } } );
+  vector<string> small( 1 );
+  bool threw = false;
+  try {
+    b.recv_batch( small );
+  } catch ( const runtime_error& ) {
+    threw = true;
+  }
+  expect( threw, "an oversized datagram should be reported" );
+}
+
+bool points_into( string_view inner, string_view outer )
+{
+  return inner.data() >= outer.data() and inner.data() + inner.size() <= outer.data() + outer.size();
+}
+
+// A frame with a large payload, serialized as a header region plus the payload by reference
+vector<Buffer> serialized_frame( const Buffer& payload )
+{
+  InternetDatagram dgram;
+  dgram.payload.push_back( payload );
+  dgram.header.len = IPv4Header::LENGTH + payload.size();
+  dgram.header.compute_checksum();
+  EthernetFrame frame;
+  frame.header = { { 0x02, 0, 0, 0, 0, 2 }, { 0x02, 0, 0, 0, 0, 1 }, EthernetHeader::TYPE_IPv4 };
+  frame.payload = serialize( dgram );
+  return serialize( frame );
+}
+
+string joined( const vector<Buffer>& pieces )
+{
+  string out;
+  for ( const auto& piece : pieces ) {
+    out.append( piece );
+  }
+  return out;
+}
+
+// Serialized frames are written straight from their pieces, one record per frame
+void test_vectored_writes()
+{
+  int fds[2] {}; // NOLINT(*-avoid-c-arrays)
+  expect( ::socketpair( AF_UNIX, SOCK_SEQPACKET, 0, fds ) == 0, "socketpair should succeed" );
+  FileDescriptor sender { fds[0] };
+  FileDescriptor receiver { fds[1] };
+
+  const Buffer payload { string( 1000, 'p' ) };
+  const vector<Buffer> frame = serialized_frame( payload );
+  expect( frame.size() == 2 and points_into( frame.back(), payload ), "the payload should not be copied" );
+  expect( sender.write( frame ) == EthernetHeader::LENGTH + IPv4Header::LENGTH + 1000,
+          "the whole frame should be written" );
+  expect( sender.write_count() == 1, "a frame should be written with one system call" );
+  string received;
+  receiver.read( received );
+  expect( received == joined( frame ), "the frame should arrive whole" );
+
+  // a batch keeps its frames apart
+  const vector<vector<Buffer>> frames { serialized_frame( Buffer { string( 100, 'a' ) } ),
+                                        serialized_frame( Buffer { string( 200, 'b' ) } ),
+                                        { Buffer { string { "short" } } } };
+  expect( sender.write_batch( frames ) == 3 and sender.write_count() == 4, "each frame should be written" );
+  for ( const auto& sent : frames ) {
+    receiver.read( received );
+    expect( received == joined( sent ), "each frame should arrive as its own record" );
+  }
+
+  // a non-blocking fd takes what fits, and stops at the first frame it cannot
+  sender.set_blocking( false );
+  const vector<vector<Buffer>> many( 10'000, frame );
+  const size_t taken = sender.write_batch( many );
+  expect( taken > 0 and taken < many.size(), "a full fd should stop the batch" );
+
+  // and a socket sends one frame with sendmsg
+  auto [a, b] = socket_pair();
+  expect( a.send( frame ) and a.write_count() == 1, "a frame should be sent with one system call" );
+  vector<string> payloads( 1 );
+  expect( b.recv_batch( payloads ) == 1 and payloads[0] == joined( frame ), "the frame should be received whole" );
+}
+
+// Two interfaces linked over sockets: ARP, then forwarding, happen a burst at a time
+void test_frame_link()
+{
+  auto [a, b] = socket_pair();
+  b.set_blocking( false );
+  const uint32_t ip_b = Address( "10.0.0.2", 0 ).ipv4_numeric();
+
+  NetworkInterface interface_a { { 0x02, 0, 0, 0, 0, 1 }, Address( "10.0.0.1", 0 ) };
+  AsyncNetworkInterface interface_b { { 0x02, 0, 0, 0, 0, 2 }, Address( "10.0.0.2", 0 ) };
+  FrameLink link_a { std::move( a ) };
+  FrameLink link_b { std::move( b ), 8 };
+
+  for ( int i = 0; i < 20; i++ ) {
+    InternetDatagram dgram;
+    dgram.header.src = Address( "10.0.0.1", 0 ).ipv4_numeric();
+    dgram.header.dst = ip_b;
+    dgram.payload.emplace_back( "datagram " + to_string( i ) );
+    dgram.header.len = IPv4Header::LENGTH + dgram.payload.back().size();
+    dgram.header.compute_checksum();
+    interface_a.send_datagram( dgram, ip_b );
+  }
+
+  // the ARP request goes out, is answered, and releases the queued datagrams
+  expect( link_a.transmit( interface_a ) == 1, "an ARP request should be sent" );
+  expect( link_b.receive( interface_b ) == 1, "the ARP request should arrive" );
+  expect( link_b.transmit( interface_b ) == 1, "an ARP reply should be sent" );
+  vector<InternetDatagram> none;
+  expect( link_a.receive( interface_a, none ) == 1 and none.empty(), "the ARP reply should arrive" );
+
+  size_t sent = 0;
+  while ( const size_t count = link_a.transmit( interface_a ) ) {
+    sent += count;
+  }
+  expect( sent == 20 and link_a.unsent() == 0, "every datagram should be sent" );
+
+  size_t frames = 0;
+  while ( const size_t received = link_b.receive( interface_b ) ) {
+    expect( received <= 8, "a receive should take at most one burst" );
+    frames += received;
+  }
+  expect( frames == 20, "every datagram should cross the link" );
+  for ( int i = 0; i < 20; i++ ) {
+    const auto dgram = interface_b.maybe_receive();
+    expect( dgram.has_value() and string_view { dgram->payload.front() } == "datagram " + to_string( i ),
+            "datagrams should be delivered in order" );
+  }
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    test_batches();
+    test_vectored_writes();
+    test_frame_link();
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
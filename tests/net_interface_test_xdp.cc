@@ -0,0 +1,181 @@
+#include "common.hh"
+#include "exception.hh"
+#include "frame_link.hh"
+#include "ipv6_datagram.hh"
+#include "ipv6_view.hh"
+#include "packet_ring.hh"
+#include "xdp_socket.hh"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+namespace {
+
+// Only frames of this (local experimental) type are redirected, so that the rest of the loopback
+// traffic (e.g. other tests) is left alone
+constexpr uint16_t TEST_TYPE = 0x88B6;
+
+vector<Buffer> test_frame( const string& text )
+{
+  EthernetFrame frame;
+  frame.header = { { 0x02, 0, 0, 0, 0, 2 }, { 0x02, 0, 0, 0, 0, 1 }, TEST_TYPE };
+  frame.payload.emplace_back( text + string( 50, '.' ) );
+  return serialize( frame );
+}
+
+// The texts of the test frames that `socket` receives within a second, until `count` have arrived
+vector<string> receive_texts( XdpSocket& socket, size_t count )
+{
+  vector<string> texts;
+  const auto deadline = steady_clock::now() + seconds( 1 );
+  while ( texts.size() < count and steady_clock::now() < deadline ) {
+    socket.wait( 10 );
+    socket.receive( [&]( const string_view bytes ) {
+      if ( bytes.size() > EthernetHeader::LENGTH and static_cast<uint8_t>( bytes[12] ) == TEST_TYPE >> 8 ) {
+        const string_view text = bytes.substr( EthernetHeader::LENGTH );
+        texts.emplace_back( text.substr( 0, text.find( '.' ) ) );
+      }
+    } );
+  }
+  return texts;
+}
+
+void test_receive( XdpSocket& socket )
+{
+  PacketRing sender { "lo" };
+  for ( int i = 0; i < 10; i++ ) {
+    expect( sender.send( test_frame( "rx " + to_string( i ) ) ), "a frame should fit in the TX ring" );
+  }
+  sender.flush();
+
+  const vector<string> texts = receive_texts( socket, 10 );
+  expect( texts.size() == 10, "every frame should be received, got " + to_string( texts.size() ) );
+  for ( int i = 0; i < 10; i++ ) {
+    expect( texts[i] == "rx " + to_string( i ), "frames should arrive whole and in order" );
+  }
+}
+
+// Frames sent on the loopback device come straight back, and are redirected to the socket again
+void test_send( XdpSocket& socket )
+{
+  for ( int round = 0; round < 3; round++ ) {
+    for ( int i = 0; i < 400; i++ ) {
+      expect( socket.send( test_frame( "tx " + to_string( i ) ) ), "a frame should be queued" );
+    }
+    socket.flush();
+
+    const vector<string> texts = receive_texts( socket, 400 );
+    expect( texts.size() == 400, "every frame sent should come back, got " + to_string( texts.size() ) );
+    expect( texts.front() == "tx 0" and texts.back() == "tx 399", "frames should be sent in order" );
+  }
+
+  bool threw = false;
+  try {
+    socket.send( { Buffer { string( socket.max_frame_size() + 1, 'x' ) } } );
+  } catch ( const runtime_error& ) {
+    threw = true;
+  }
+  expect( threw, "a frame too big for a chunk should be refused" );
+}
+
+// The driver loop keeps an interface going until it is told to stop
+void test_run( XdpSocket& socket )
+{
+  AsyncNetworkInterface interface { { 0x02, 0, 0, 0, 0, 1 }, Address( "10.0.0.1", 0 ) };
+  interface.enqueue_send( InternetDatagram {}, Address( "10.0.0.2", 0 ).ipv4_numeric() );
+
+  RingLink link { socket };
+  atomic<bool> stop { false };
+  thread driver { [&] { link.run( interface, stop ); } };
+  this_thread::sleep_for( milliseconds( 50 ) );
+  stop = true;
+  driver.join();
+
+  // the queued datagram became an ARP request, which was sent
+  expect( interface.stats().arp_requests_sent == 1, "the driver loop should send what was queued" );
+  expect( interface.stats().tx_frames == 1 and link.unsent() == 0, "the ARP request should have been transmitted" );
+}
+
+// Two interfaces on one socket (every frame sent comes back to it): b's neighbor is resolved with
+// NDP, and IPv6 datagrams are forwarded to it
+void test_link6( XdpSocket& socket )
+{
+  NetworkInterface interface_a { { 0x02, 0, 0, 0, 0, 1 }, Address( "10.0.0.1", 0 ) };
+  AsyncNetworkInterface interface_b { { 0x02, 0, 0, 0, 0, 2 }, Address( "10.0.0.2", 0 ) };
+  interface_a.set_ipv6_address( ipv6_address( "2001:db8::a" ) );
+  interface_b.set_ipv6_address( ipv6_address( "2001:db8::b" ) );
+  interface_b.set_forwarding( true );
+  RingLink link { socket };
+
+  const IPv6Address ip_b = *interface_b.ipv6_address();
+  for ( int i = 0; i < 5; i++ ) {
+    IPv6Datagram dgram;
+    dgram.header.src = *interface_a.ipv6_address();
+    dgram.header.dst = ip_b;
+    dgram.header.hop_limit = 64;
+    dgram.header.next_header = IPv6Header::NEXT_HEADER_UDP;
+    dgram.payload.emplace_back( "datagram " + to_string( i ) );
+    dgram.header.payload_length = static_cast<uint16_t>( dgram.payload.back().size() );
+    interface_a.send_datagram6( IPv6View::of( dgram ), ip_b );
+  }
+
+  vector<IPv6View> delivered;
+  vector<InternetDatagram> ignored;
+  const auto deadline = steady_clock::now() + seconds( 2 );
+  while ( delivered.size() < 5 and steady_clock::now() < deadline ) {
+    link.transmit( interface_a );
+    socket.wait( 10 );
+    link.receive( interface_b );
+    link.transmit( interface_b );
+    socket.wait( 10 );
+    link.receive( interface_a, ignored );
+    interface_b.maybe_receive_views6( delivered );
+  }
+  expect( interface_b.stats().ndp_solicitations_received >= 1 and interface_a.resolved6( ip_b ),
+          "the neighbor should be resolved with NDP" );
+  expect( delivered.size() == 5, "every IPv6 datagram should cross the link, got " + to_string( delivered.size() ) );
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    // (XDP needs CAP_BPF and CAP_NET_ADMIN, and a kernel with AF_XDP; without them there is nothing to test)
+    optional<XdpProgram> program;
+    optional<XdpSocket> socket;
+    try {
+      program.emplace( "lo", 1, TEST_TYPE );
+      socket.emplace( "lo", 0 );
+      program->add( 0, *socket );
+    } catch ( const unix_error& e ) {
+      cerr << "skipped: " << e.what() << endl;
+      return EXIT_SUCCESS;
+    }
+
+    test_receive( *socket );
+    test_send( *socket );
+    test_run( *socket );
+
+    // (IPv6 frames are only redirected for as long as this test runs)
+    program.reset();
+    program.emplace( "lo", 1, EthernetHeader::TYPE_IPv6 );
+    program->add( 0, *socket );
+    test_link6( *socket );
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,216 @@
+#include "arp_message.hh"
+#include "common.hh"
+#include "ethernet_frame.hh"
+#include "ipv4_datagram.hh"
+#include "network_interface.hh"
+#include "packet_pool.hh"
+
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+bool points_into( string_view inner, string_view outer )
+{
+  return inner.data() >= outer.data() and inner.data() + inner.size() <= outer.data() + outer.size();
+}
+
+void test_buffer_slices()
+{
+  // (longer than Buffer::INLINE_CAPACITY, so that it is shared rather than held inline)
+  string digits;
+  for ( size_t i = 0; i < 10; i++ ) {
+    digits += "0123456789";
+  }
+  const Buffer whole { digits };
+  const Buffer slice = whole.substr( 2, 5 );
+  expect( string_view { slice } == "23456", "substr() should view the requested range" );
+  expect( points_into( slice, whole ), "substr() should share the backing string" );
+
+  Buffer tail = slice;
+  tail.remove_prefix( 3 );
+  expect( string_view { tail } == "56", "remove_prefix() should shrink the view" );
+  expect( string_view { slice } == "23456", "remove_prefix() should not affect other views" );
+
+  // mutable access to a slice gives it a private copy of its bytes
+  static_cast<string&>( tail ).append( "!" );
+  expect( string_view { tail } == "56!", "mutation should apply to the slice" );
+  expect( string_view { whole } == digits, "mutating a slice should not affect its source" );
+}
+
+// Small buffers hold their bytes inline, and behave like any other
+void test_inline_buffers()
+{
+  const Buffer small { string { "0123456789" } };
+  Buffer copy = small;
+  expect( string_view { copy } == "0123456789" and not points_into( copy, small ),
+          "a copy of a small buffer should copy its bytes" );
+  copy.remove_prefix( 4 );
+  expect( string_view { copy.substr( 1, 3 ) } == "567", "small buffers should slice" );
+  static_cast<string&>( copy ).append( string( 100, '!' ) );
+  expect( copy.size() == 106 and string_view { small } == "0123456789",
+          "a small buffer should grow into a string of its own" );
+  expect( Buffer {}.empty() and Buffer::copy_of( string( 65, 'x' ) ).size() == 65, "any size should be held" );
+
+  // an ARP message serializes into an inline buffer: the pool's scratch string goes straight back
+  PacketPool pool { 256, 8 };
+  ARPMessage arp;
+  arp.opcode = ARPMessage::OPCODE_REPLY;
+  const PacketPool::Stats before = pool.stats();
+  const vector<Buffer> wire = serialize( arp, pool );
+  const PacketPool::Stats after = pool.stats();
+  expect( wire.size() == 1 and wire.front().size() == ARPMessage::LENGTH, "the message should be one buffer" );
+  expect( after.allocations - before.allocations == after.recycled - before.recycled,
+          "no pooled buffer should stay out for a small message" );
+}
+
+void test_received_payload_is_a_view()
+{
+  const EthernetAddress local_eth { 0x02, 0, 0, 0, 0, 1 };
+  NetworkInterface interface { local_eth, Address( "10.0.0.1", 0 ) };
+
+  // One contiguous buffer holding the IPv4 header and payload, as a driver would deliver it
+  InternetDatagram dgram;
+  dgram.header.src = Address( "10.0.0.2", 0 ).ipv4_numeric();
+  dgram.header.dst = Address( "10.0.0.1", 0 ).ipv4_numeric();
+  dgram.payload.emplace_back( string( 1000, 'x' ) );
+  dgram.header.len = IPv4Header::LENGTH + 1000;
+  dgram.header.compute_checksum();
+
+  string wire;
+  for ( const auto& piece : serialize( dgram ) ) {
+    wire.append( piece );
+  }
+
+  EthernetFrame frame;
+  frame.header = { local_eth, { 0x02, 0, 0, 0, 0, 2 }, EthernetHeader::TYPE_IPv4 };
+  frame.payload.emplace_back( std::move( wire ) );
+
+  const auto received = interface.recv_frame( frame );
+  expect( received.has_value(), "datagram should be delivered" );
+  expect( received->payload.size() == 1, "payload should be a single buffer" );
+  expect( received->payload.front().size() == 1000, "payload should exclude the header" );
+  expect( points_into( received->payload.front(), frame.payload.front() ),
+          "payload should be a view of the received frame, not a copy" );
+}
+
+void test_frame_serialization()
+{
+  InternetDatagram dgram;
+  dgram.payload.emplace_back( string( 1000, 'y' ) );
+  dgram.header.len = IPv4Header::LENGTH + 1000;
+  dgram.header.compute_checksum();
+
+  EthernetFrame frame;
+  frame.header = { { 0x02, 0, 0, 0, 0, 2 }, { 0x02, 0, 0, 0, 0, 1 }, EthernetHeader::TYPE_IPv4 };
+  frame.payload = serialize( dgram );
+
+  // both headers share one region, and the payload is attached by reference
+  const vector<Buffer> wire = serialize( frame );
+  expect( wire.size() == 2, "frame should serialize to a header region plus the payload" );
+  expect( wire.front().size() == EthernetHeader::LENGTH + IPv4Header::LENGTH,
+          "header region should hold the Ethernet and IPv4 headers" );
+  expect( points_into( wire.back(), dgram.payload.front() ), "payload should be referenced, not copied" );
+}
+
+// An rvalue datagram is moved all the way into its frame, whether it is sent at once or queued on ARP
+void test_send_moves_payload()
+{
+  const EthernetAddress local_eth { 0x02, 0, 0, 0, 0, 1 };
+  const EthernetAddress neighbor_eth { 0x02, 0, 0, 0, 0, 2 };
+  const uint32_t neighbor_ip = Address( "10.0.0.2", 0 ).ipv4_numeric();
+  NetworkInterface interface { local_eth, Address( "10.0.0.1", 0 ) };
+
+  InternetDatagram queued;
+  queued.payload.emplace_back( string( 1000, 'q' ) );
+  const string_view queued_bytes = queued.payload.front();
+  interface.send_datagram( std::move( queued ), neighbor_ip );
+  expect( interface.maybe_send().has_value(), "an ARP request should be sent first" );
+
+  // the ARP reply releases the queued datagram
+  ARPMessage arp;
+  arp.opcode = ARPMessage::OPCODE_REPLY;
+  arp.sender_ethernet_address = neighbor_eth;
+  arp.sender_ip_address = neighbor_ip;
+  arp.target_ethernet_address = local_eth;
+  arp.target_ip_address = Address( "10.0.0.1", 0 ).ipv4_numeric();
+  EthernetFrame reply;
+  reply.header = { local_eth, neighbor_eth, EthernetHeader::TYPE_ARP };
+  reply.payload = serialize( arp );
+  interface.recv_frame( reply );
+
+  auto frame = interface.maybe_send();
+  expect( frame.has_value() and frame->payload.size() == 2, "the queued datagram should be sent" );
+  expect( string_view { frame->payload.back() }.data() == queued_bytes.data(),
+          "a queued datagram's payload should be moved into its frame" );
+
+  InternetDatagram direct;
+  direct.payload.emplace_back( string( 1000, 'd' ) );
+  const Buffer original = direct.payload.front();
+  interface.send_datagram( std::move( direct ), neighbor_ip );
+  frame = interface.maybe_send();
+  expect( frame.has_value() and points_into( frame->payload.back(), original ),
+          "a sent datagram's payload should be moved into its frame" );
+}
+
+void test_packet_pool()
+{
+  PacketPool pool { 256, 8 };
+
+  const string* first_storage = nullptr;
+  {
+    const shared_ptr<string> buf = pool.allocate();
+    expect( buf->empty() and buf->capacity() >= 256, "pooled buffers should be empty with full capacity" );
+    first_storage = buf.get();
+  }
+  expect( pool.stats().recycled == 1, "a released buffer should return to the pool" );
+  {
+    const shared_ptr<string> buf = pool.allocate();
+    expect( buf.get() == first_storage, "the next allocation should reuse the released buffer" );
+    expect( pool.stats().reused == 1, "reuse should be counted" );
+  }
+
+  // serializing through a pool gives the same bytes as the default heap path
+  InternetDatagram dgram;
+  dgram.payload.emplace_back( string( 1000, 'z' ) );
+  dgram.header.len = IPv4Header::LENGTH + 1000;
+  dgram.header.compute_checksum();
+  EthernetFrame frame;
+  frame.header = { { 0x02, 0, 0, 0, 0, 2 }, { 0x02, 0, 0, 0, 0, 1 }, EthernetHeader::TYPE_IPv4 };
+  frame.payload = serialize( dgram, pool );
+
+  const vector<Buffer> pooled = serialize( frame, pool );
+  const vector<Buffer> plain = serialize( frame );
+  expect( pooled.size() == plain.size(), "pooled serialization should produce the same pieces" );
+  for ( size_t i = 0; i < plain.size(); i++ ) {
+    expect( string_view { pooled[i] } == string_view { plain[i] }, "pooled serialization should match" );
+  }
+
+  EthernetFrame parsed;
+  expect( parse( parsed, pooled, pool ), "pooled frame should parse" );
+  expect( parsed.header.type == EthernetHeader::TYPE_IPv4, "pooled frame should keep its header" );
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    test_buffer_slices();
+    test_inline_buffers();
+    test_received_payload_is_a_view();
+    test_frame_serialization();
+    test_send_moves_payload();
+    test_packet_pool();
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,174 @@
+#include "acl.hh"
+#include "common.hh"
+#include "router.hh"
+
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+IPv4Header make_header( uint32_t src, uint32_t dst, uint8_t proto, uint8_t tos = 0 )
+{
+  IPv4Header header;
+  header.src = src;
+  header.dst = dst;
+  header.proto = proto;
+  header.tos = tos;
+  return header;
+}
+
+// Random rules over a few overlapping address blocks (so that many rules overlap), and headers
+// in the same blocks
+uint32_t random_address( mt19937& rng )
+{
+  return ( 0x0A'00'00'00 + ( rng() % 4 ) * 0x0100'0000 ) | ( static_cast<uint32_t>( rng() ) & 0x00FF'FFFF );
+}
+
+AclRule random_rule( mt19937& rng )
+{
+  AclRule rule;
+  rule.src_prefix = random_address( rng );
+  rule.src_length = static_cast<uint8_t>( rng() % 33 );
+  rule.dst_prefix = random_address( rng );
+  rule.dst_length = static_cast<uint8_t>( rng() % 25 );
+  if ( rng() % 2 ) {
+    rule.proto = rng() % 2 ? uint8_t { 6 } : uint8_t { 17 };
+  }
+  if ( rng() % 4 == 0 ) {
+    rule.tos_mask = 0xFC;
+    rule.tos = static_cast<uint8_t>( ( rng() % 64 ) << 2 );
+  }
+  rule.action = rng() % 2 ? AclRule::Action::PERMIT : AclRule::Action::DENY;
+  return rule;
+}
+
+// The classifier agrees with a scan of the rules
+void test_classifier()
+{
+  mt19937 rng { 458 };
+  for ( const size_t count : { 0UL, 1UL, 7UL, 64UL, 65UL, 300UL } ) {
+    vector<AclRule> rules;
+    for ( size_t i = 0; i < count; i++ ) {
+      rules.push_back( random_rule( rng ) );
+    }
+    const AclClassifier acl { rules };
+    for ( size_t i = 0; i < 20'000; i++ ) {
+      // (half of the headers copy a rule's addresses, so that they match something)
+      IPv4Header header = make_header( random_address( rng ), random_address( rng ), rng() % 2 ? 6 : 17 );
+      header.tos = static_cast<uint8_t>( rng() );
+      if ( count > 0 and rng() % 2 ) {
+        const AclRule& rule = rules[rng() % count];
+        header.src = rule.src_prefix;
+        header.dst = rule.dst_prefix;
+      }
+      expect( acl.match( header ) == acl.match_linear( header ),
+              "the classifier and the scan should agree (" + to_string( count ) + " rules)" );
+    }
+  }
+
+  // the edges of the address space, and the first matching rule wins
+  const vector<AclRule> rules {
+    { .src_prefix = 0xFFFF'FF00, .src_length = 24, .action = AclRule::Action::DENY },
+    { .dst_prefix = 0, .dst_length = 8, .proto = 1, .action = AclRule::Action::DENY },
+    { .src_prefix = 0xFFFF'FFFF, .src_length = 32 },
+  };
+  const AclClassifier acl { rules };
+  expect( acl.match( make_header( 0xFFFF'FFFF, 1, 6 ) ) == 0, "the first rule should win" );
+  expect( acl.match( make_header( 0xFFFF'FEFF, 0x00FF'FFFF, 1 ) ) == 1, "the end of a /8 should match" );
+  expect( acl.match( make_header( 0xFFFF'FEFF, 0x0100'0000, 1 ) ) == AclClassifier::NO_MATCH,
+          "just past a /8 should not match" );
+  expect( acl.action( AclClassifier::NO_MATCH ) == AclRule::Action::PERMIT, "the default should permit" );
+}
+
+constexpr uint32_t INSIDE = 0x0A'00'00'00;  // 10.0.0.0/8, on interface 1
+constexpr uint32_t OUTSIDE = 0xC0'A8'00'00; // 192.168.0.0/16, on interface 0
+
+Router make_router()
+{
+  Router router;
+  router.add_interface( AsyncNetworkInterface { { 0x02, 0, 0, 0, 0, 0 }, Address( "192.168.255.1", 0 ) } );
+  router.add_interface( AsyncNetworkInterface { { 0x02, 0, 0, 0, 0, 1 }, Address( "10.255.255.1", 0 ) } );
+  router.add_route( INSIDE, 8, {}, 1 );
+  router.add_route( OUTSIDE, 16, {}, 0 );
+  return router;
+}
+
+// Send a datagram in on interface 0 and route it; returns whether it was forwarded
+bool forward( Router& router, uint32_t src, uint32_t dst, uint8_t proto, uint8_t tos = 0 )
+{
+  InternetDatagram dgram;
+  dgram.header = make_header( src, dst, proto, tos );
+  dgram.header.ttl = 64;
+  dgram.header.compute_checksum();
+  EthernetFrame frame;
+  frame.header = { { 0x02, 0, 0, 0, 0, 0 }, { 0x02, 0, 0, 0, 9, 9 }, EthernetHeader::TYPE_IPv4 };
+  frame.payload = serialize( dgram );
+  router.interface( 0 ).recv_frame( frame );
+
+  const uint64_t before = router.stats().forwarded;
+  router.route();
+  return router.stats().forwarded == before + 1;
+}
+
+void test_router()
+{
+  Router router = make_router();
+  expect( forward( router, OUTSIDE | 1, INSIDE | 1, 6 ), "an empty list should permit everything" );
+
+  // no UDP to 10.1.0.0/16, except with DSCP EF; nothing at all from one host
+  const vector<AclRule> rules {
+    { .dst_prefix = INSIDE | 0x01'00'00, .dst_length = 16, .proto = 17, .tos = 46 << 2, .tos_mask = 0xFC },
+    { .dst_prefix = INSIDE | 0x01'00'00, .dst_length = 16, .proto = 17, .action = AclRule::Action::DENY },
+    { .src_prefix = OUTSIDE | 66, .src_length = 32, .action = AclRule::Action::DENY },
+  };
+  router.set_acl( rules );
+  expect( not forward( router, OUTSIDE | 1, INSIDE | 0x01'00'05, 17 ), "UDP to 10.1/16 should be denied" );
+  expect( forward( router, OUTSIDE | 1, INSIDE | 0x01'00'05, 17, 46 << 2 ), "EF UDP should be permitted" );
+  expect( forward( router, OUTSIDE | 1, INSIDE | 0x01'00'05, 6 ), "TCP should be permitted" );
+  expect( not forward( router, OUTSIDE | 66, INSIDE | 0x02'00'00, 6 ), "the denied host should be dropped" );
+  expect( not forward( router, OUTSIDE | 66, INSIDE | 0x02'00'00, 1 ), "... whatever it sends" );
+  expect( router.acl_hits() == vector<uint64_t> { 1, 1, 2 }, "each rule's hits should be counted" );
+  expect( router.stats().acl_denied == 3, "denied datagrams should be counted" );
+
+  // route_parallel filters too, and counts into the same totals
+  for ( size_t i = 0; i < 10; i++ ) {
+    InternetDatagram dgram;
+    dgram.header = make_header( OUTSIDE | 66, INSIDE | 1, 6 );
+    dgram.header.ttl = 64;
+    dgram.header.compute_checksum();
+    EthernetFrame frame;
+    frame.header = { { 0x02, 0, 0, 0, 0, 0 }, { 0x02, 0, 0, 0, 9, 9 }, EthernetHeader::TYPE_IPv4 };
+    frame.payload = serialize( dgram );
+    router.interface( 0 ).recv_frame( frame );
+  }
+  router.route_parallel( 2 );
+  expect( router.acl_hits()[2] == 12 and router.stats().acl_denied == 13, "parallel routing should filter" );
+
+  // a new list starts its own counts, and can deny by default
+  router.set_acl( vector<AclRule> { { .src_prefix = OUTSIDE, .src_length = 16 } }, AclRule::Action::DENY );
+  expect( router.acl_hits() == vector<uint64_t> { 0 }, "a new list should start counting from zero" );
+  expect( forward( router, OUTSIDE | 66, INSIDE | 1, 6 ), "the new list should apply" );
+  expect( not forward( router, 0x0B'00'00'01, INSIDE | 1, 6 ), "unmatched datagrams should get the default" );
+  expect( router.acl_hits() == vector<uint64_t> { 1 }, "only matches should count as hits" );
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    test_classifier();
+    test_router();
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
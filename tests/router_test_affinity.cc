@@ -0,0 +1,112 @@
+#include "common.hh"
+#include "cpu_affinity.hh"
+#include "router.hh"
+#include "worker_pool.hh"
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <sched.h>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+template<class F>
+bool throws( F&& f )
+{
+  try {
+    f();
+  } catch ( const exception& ) {
+    return true;
+  }
+  return false;
+}
+
+void test_cpu_lists()
+{
+  expect( parse_cpu_list( "0-3,8,10-11\n" ) == vector<int> { 0, 1, 2, 3, 8, 10, 11 }, "a CPU list should parse" );
+  expect( parse_cpu_list( "" ).empty(), "an empty CPU list should parse" );
+  expect( throws( [] { parse_cpu_list( "0-x" ); } ), "a bad CPU list should be rejected" );
+
+  expect( not allowed_cpus().empty(), "some CPU should be allowed" );
+  expect( cpus_allowed( allowed_cpus() ), "the allowed CPUs should be allowed" );
+  expect( not cpus_allowed( vector<int> { -1 } ), "no negative CPU should be allowed" );
+
+  // (a device that does not exist has no node, and gets an allowed CPU)
+  const vector<string> devices { "no-such-device0", "no-such-device1" };
+  const vector<int> near = cpus_near_devices( devices );
+  expect( not device_numa_node( devices[0] ).has_value(), "an unknown device should have no node" );
+  expect( near.size() == 2 and cpus_allowed( near ), "every device should get an allowed CPU" );
+}
+
+// Each worker of a pinned pool runs on its CPU
+void test_pool()
+{
+  const vector<int>& allowed = allowed_cpus();
+  const vector<int> cpus { allowed.back(), allowed.front() };
+
+  atomic<int> misplaced { 0 };
+  {
+    WorkerPool pool { 2, cpus };
+    for ( int run = 0; run < 3; run++ ) {
+      pool.run( [&]( const size_t worker ) {
+        if ( sched_getcpu() != cpus[worker] ) {
+          misplaced++;
+        }
+      } );
+    }
+  }
+  expect( misplaced == 0, "workers should run on their CPUs" );
+  pin_current_thread( {} );
+
+  expect( throws( [] { WorkerPool { 2, { -1 } }; } ), "a pool on an unavailable CPU should be refused" );
+}
+
+// Pinned workers route exactly as route() does
+void test_router()
+{
+  Router router;
+  for ( uint8_t i = 0; i < 4; i++ ) {
+    router.add_interface( AsyncNetworkInterface { { 0x02, 0, 0, 0, 0, i }, Address::from_ipv4_numeric( 0x0A'00'00'01U + ( i << 8U ) ) } );
+    router.add_route( 0xC0'A8'00'00 + ( i << 8U ), 24, {}, i );
+  }
+  expect( throws( [&] { router.set_worker_cpus( { -1 } ); } ), "an unavailable CPU should be refused" );
+  router.set_worker_cpus( cpus_near_devices( vector<string>( 4, "no-such-device" ) ) );
+
+  for ( uint32_t n = 0; n < 40; n++ ) {
+    InternetDatagram dgram;
+    dgram.header.src = 0x0A'00'00'05;
+    dgram.header.dst = 0xC0'A8'00'05 + ( ( n % 4 ) << 8 );
+    dgram.header.ttl = 64;
+    dgram.header.len = IPv4Header::LENGTH;
+    dgram.header.compute_checksum();
+    EthernetFrame frame;
+    frame.header = { { 0x02, 0, 0, 0, 0, 0 }, { 0x02, 0, 0, 0, 0, 9 }, EthernetHeader::TYPE_IPv4 };
+    frame.payload = serialize( dgram );
+    router.interface( 0 ).recv_frame( frame );
+  }
+  router.route_parallel( 4 );
+  pin_current_thread( {} );
+
+  expect( router.stats().forwarded == 40, "pinned workers should forward everything" );
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    test_cpu_lists();
+    test_pool();
+    test_router();
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,107 @@
+#include "checksum.hh"
+#include "common.hh"
+#include "ipv4_header.hh"
+
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+string raw( const IPv4Header& header )
+{
+  string out;
+  for ( const auto& piece : serialize( header ) ) {
+    out.append( piece );
+  }
+  return out;
+}
+
+// The incremental TTL update must agree with a full recomputation for every header
+void test_decrement_ttl()
+{
+  mt19937 rng { 458 };
+  for ( int i = 0; i < 100000; i++ ) {
+    IPv4Header header;
+    header.tos = rng();
+    header.len = rng();
+    header.id = rng();
+    header.ttl = 2 + rng() % 254;
+    header.proto = rng();
+    header.src = rng();
+    header.dst = rng();
+    header.compute_checksum();
+    expect( IPv4Header::checksum_ok( raw( header ) ), "raw verification should accept a correct header" );
+
+    IPv4Header expected = header;
+    expected.ttl--;
+    expected.compute_checksum();
+
+    header.decrement_ttl();
+    expect( header.cksum == expected.cksum,
+            "incremental checksum " + to_string( header.cksum ) + " != recomputed " + to_string( expected.cksum ) );
+    expect( IPv4Header::checksum_ok( raw( header ) ), "raw verification should accept the updated header" );
+
+    header.cksum ^= 1U << ( rng() % 16 );
+    expect( not IPv4Header::checksum_ok( raw( header ) ), "raw verification should reject a corrupted header" );
+  }
+}
+
+// The original byte-at-a-time algorithm, as a reference
+uint16_t reference_checksum( const vector<string>& pieces )
+{
+  uint32_t sum = 0;
+  bool parity = false;
+  for ( const auto& piece : pieces ) {
+    for ( const uint8_t byte : piece ) {
+      sum += parity ? byte : byte << 8;
+      parity = not parity;
+    }
+  }
+  while ( sum > 0xffff ) {
+    sum = ( sum >> 16 ) + static_cast<uint16_t>( sum );
+  }
+  return ~sum;
+}
+
+// The vectorized sum must match the scalar one for any lengths and any split into pieces
+void test_internet_checksum()
+{
+  mt19937 rng { 458 };
+  for ( int i = 0; i < 3000; i++ ) {
+    vector<string> pieces( 1 + rng() % 4 );
+    vector<Buffer> buffers;
+    for ( auto& piece : pieces ) {
+      piece.resize( rng() % ( i < 2000 ? 200 : 5000 ) );
+      for ( auto& ch : piece ) {
+        ch = static_cast<char>( i % 7 ? rng() : 0xff ); // include all-ones runs for large carries
+      }
+      buffers.emplace_back( piece );
+    }
+
+    InternetChecksum check;
+    check.add( buffers );
+    expect( check.value() == reference_checksum( pieces ),
+            "InternetChecksum disagrees with the byte-at-a-time reference (case " + to_string( i ) + ")" );
+  }
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    test_decrement_ttl();
+    test_internet_checksum();
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,158 @@
+#include "arp_message.hh"
+#include "common.hh"
+#include "counters.hh"
+#include "router.hh"
+
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+enum class Event
+{
+  A,
+  B,
+  COUNT
+};
+
+void test_sharded_counters()
+{
+  ShardedCounters<Event> counters;
+  vector<thread> threads;
+  for ( uint64_t t = 0; t < 12; t++ ) {
+    threads.emplace_back( [&counters, t] {
+      for ( int i = 0; i < 10000; i++ ) {
+        counters.add( Event::A );
+      }
+      counters.raise( Event::B, t );
+    } );
+  }
+  for ( auto& t : threads ) {
+    t.join();
+  }
+  expect( counters.sum( Event::A ) == 120000, "increments from every thread should be summed" );
+  expect( counters.max( Event::B ) == 11, "the highest level should be kept" );
+
+  const ShardedCounters<Event> copy { counters };
+  expect( copy.sum( Event::A ) == 120000 and copy.max( Event::B ) == 11, "a copy should be a snapshot" );
+}
+
+EthernetFrame frame_to( const EthernetAddress& dst_eth, uint32_t dst, uint8_t ttl )
+{
+  InternetDatagram dgram;
+  dgram.header.dst = dst;
+  dgram.header.ttl = ttl;
+  dgram.payload.emplace_back( string( 100, 'p' ) );
+  dgram.header.len = IPv4Header::LENGTH + 100;
+  dgram.header.compute_checksum();
+
+  EthernetFrame frame;
+  frame.header = { dst_eth, { 0x02, 0, 0, 0, 1, 0 }, EthernetHeader::TYPE_IPv4 };
+  frame.payload = serialize( dgram );
+  return frame;
+}
+
+void test_interface_counters()
+{
+  const EthernetAddress local_eth { 0x02, 0, 0, 0, 0, 1 };
+  const EthernetAddress neighbor_eth { 0x02, 0, 0, 0, 0, 2 };
+  const uint32_t local_ip = Address( "10.0.0.1", 0 ).ipv4_numeric();
+  const uint32_t neighbor_ip = Address( "10.0.0.2", 0 ).ipv4_numeric();
+  NetworkInterface interface { local_eth, Address( "10.0.0.1", 0 ) };
+
+  InternetDatagram dgram;
+  dgram.payload.emplace_back( string( 100, 'x' ) );
+  interface.send_datagram( dgram, neighbor_ip );
+  interface.send_datagram( dgram, neighbor_ip );
+  expect( interface.stats().arp_misses == 2 and interface.stats().arp_requests_sent == 1,
+          "datagrams to an unknown neighbor should miss, with one request" );
+  expect( interface.stats().pending_high_water == 2, "the pending depth should be tracked" );
+
+  ARPMessage arp;
+  arp.opcode = ARPMessage::OPCODE_REPLY;
+  arp.sender_ethernet_address = neighbor_eth;
+  arp.sender_ip_address = neighbor_ip;
+  arp.target_ethernet_address = local_eth;
+  arp.target_ip_address = local_ip;
+  EthernetFrame reply;
+  reply.header = { local_eth, neighbor_eth, EthernetHeader::TYPE_ARP };
+  reply.payload = serialize( arp );
+  interface.recv_frame( reply );
+  expect( interface.stats().arp_replies_received == 1, "the reply should be counted" );
+
+  interface.send_datagram( dgram, neighbor_ip );
+  expect( interface.stats().arp_hits == 1, "a datagram to a known neighbor should hit" );
+
+  size_t frames = 0;
+  while ( interface.maybe_send().has_value() ) {
+    frames++;
+  }
+  const auto sent = interface.stats();
+  expect( sent.tx_frames == frames and frames == 4, "every frame taken out should be counted" );
+  expect( sent.tx_bytes == EthernetHeader::LENGTH * 4 + ARPMessage::LENGTH + 3 * ( IPv4Header::LENGTH + 100 ),
+          "sent bytes should be counted" );
+
+  // received frames (and the ones that do not parse)
+  EthernetFrame bad = frame_to( local_eth, local_ip, 64 );
+  string corrupted = bad.payload.front();
+  corrupted[10] ^= 0x01; // the header checksum
+  bad.payload = { Buffer { std::move( corrupted ) } };
+  interface.recv_frame( frame_to( local_eth, local_ip, 64 ) );
+  interface.recv_frame( bad );
+  interface.recv_frame( frame_to( { 0x02, 0, 0, 0, 0, 9 }, local_ip, 64 ) ); // not for us
+  const auto received = interface.stats();
+  expect( received.rx_frames == 3, "frames for this interface should be counted" );
+  expect( received.rx_parse_errors == 1, "a bad checksum should be counted" );
+
+  interface.tick( 30000 );
+  expect( interface.stats().expiries == 1, "the expired entry should be counted" );
+}
+
+void test_router_drops()
+{
+  Router router;
+  for ( uint8_t i = 0; i < 2; i++ ) {
+    router.add_interface(
+      AsyncNetworkInterface { { 0x02, 0, 0, 0, 0, i }, Address::from_ipv4_numeric( 0x0A'00'00'01 + i ) } );
+  }
+  router.add_route( 0xC0'A8'00'00, 16, {}, 1 );
+
+  const EthernetAddress eth0 { 0x02, 0, 0, 0, 0, 0 };
+  router.interface( 0 ).recv_frame( frame_to( eth0, 0xC0'A8'00'05, 64 ) );
+  router.interface( 0 ).recv_frame( frame_to( eth0, 0xC0'A8'00'06, 64 ) );
+  router.interface( 0 ).recv_frame( frame_to( eth0, 0x08'08'08'08, 64 ) );
+  router.interface( 0 ).recv_frame( frame_to( eth0, 0xC0'A8'00'07, 1 ) );
+  EthernetFrame bad = frame_to( eth0, 0xC0'A8'00'05, 64 );
+  bad.payload = { Buffer { string( 10, 'z' ) } };
+  router.interface( 0 ).recv_frame( bad );
+  router.route();
+
+  const Router::Stats stats = router.stats();
+  expect( stats.forwarded == 2, "routed datagrams should be counted" );
+  expect( stats.no_route == 1, "datagrams without a route should be counted" );
+  expect( stats.ttl_expired == 1, "datagrams with an expired TTL should be counted" );
+  expect( stats.parse_errors == 1, "datagrams that did not parse should be counted" );
+  expect( stats.rx_ring_full == 0, "nothing should have overflowed" );
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    test_sharded_counters();
+    test_interface_counters();
+    test_router_drops();
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
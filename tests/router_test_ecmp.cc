@@ -0,0 +1,201 @@
+#include "common.hh"
+#include "crc32c.hh"
+#include "router.hh"
+
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+constexpr size_t NUM_INTERFACES = 5;
+constexpr uint32_t PREFIX = 0x0A'00'00'00; // 10.0.0.0/8, reached over interfaces 1 to 4
+
+Router make_router()
+{
+  Router router;
+  for ( uint8_t i = 0; i < NUM_INTERFACES; i++ ) {
+    router.add_interface(
+      AsyncNetworkInterface { { 0x02, 0, 0, 0, 0, i }, Address::from_ipv4_numeric( 0xC0'A8'00'01 + i ) } );
+  }
+  return router;
+}
+
+Address uplink( size_t i )
+{
+  return Address::from_ipv4_numeric( 0xAC'10'00'01 + i );
+}
+
+// Datagrams forwarded so far through the uplink on each interface
+vector<uint64_t> usage( const Router& router )
+{
+  vector<uint64_t> counts( NUM_INTERFACES );
+  for ( const auto& path : router.path_stats() ) {
+    counts[path.interface_num] += path.datagrams;
+  }
+  return counts;
+}
+
+// The interface that the router sends a datagram of this flow out of
+size_t route_flow( Router& router, uint32_t src, uint32_t dst, uint8_t proto )
+{
+  InternetDatagram dgram;
+  dgram.header.src = src;
+  dgram.header.dst = dst;
+  dgram.header.proto = proto;
+  dgram.header.ttl = 64;
+  dgram.header.compute_checksum();
+  EthernetFrame frame;
+  frame.header = { { 0x02, 0, 0, 0, 0, 0 }, { 0x02, 0, 0, 0, 1, 0 }, EthernetHeader::TYPE_IPv4 };
+  frame.payload = serialize( dgram );
+
+  const vector<uint64_t> before = usage( router );
+  router.interface( 0 ).recv_frame( frame );
+  router.route();
+  const vector<uint64_t> after = usage( router );
+  for ( size_t i = 0; i < NUM_INTERFACES; i++ ) {
+    if ( after[i] != before[i] ) {
+      return i;
+    }
+  }
+  throw runtime_error( "the datagram was not forwarded" );
+}
+
+struct Flow
+{
+  uint32_t src;
+  uint32_t dst;
+  uint8_t proto;
+};
+
+vector<Flow> make_flows( size_t count )
+{
+  mt19937 rng { 458 };
+  vector<Flow> flows;
+  for ( size_t i = 0; i < count; i++ ) {
+    const auto src = static_cast<uint32_t>( rng() );
+    const uint32_t dst = PREFIX | static_cast<uint32_t>( rng() & 0xFF'FFFF );
+    flows.push_back( { src, dst, rng() % 2 ? uint8_t { 6 } : uint8_t { 17 } } );
+  }
+  return flows;
+}
+
+vector<size_t> route_flows( Router& router, const vector<Flow>& flows )
+{
+  vector<size_t> out;
+  for ( const Flow& flow : flows ) {
+    out.push_back( route_flow( router, flow.src, flow.dst, flow.proto ) );
+  }
+  return out;
+}
+
+void test_crc32c()
+{
+  expect( crc32c( "123456789" ) == 0xE306'9283, "CRC-32C check value" );
+  expect( crc32c( "" ) == 0, "CRC-32C of nothing" );
+  // the word form is the same register update as four bytes
+  const uint32_t word = 0x6463'6261; // "abcd"
+  expect( ~crc32c_extend( ~0U, word ) == crc32c( "abcd" ), "word and byte CRCs should agree" );
+}
+
+// Flows are spread evenly over the paths, and each flow sticks to one
+void test_spreading()
+{
+  Router router = make_router();
+  for ( size_t i = 1; i < NUM_INTERFACES; i++ ) {
+    expect( router.add_path( PREFIX, 8, uplink( i ), i ), "a new path should be added" );
+  }
+  expect( not router.add_path( PREFIX, 8, uplink( 1 ), 1 ), "a path should only be added once" );
+
+  const vector<Flow> flows = make_flows( 4000 );
+  const vector<size_t> first = route_flows( router, flows );
+  const vector<uint64_t> counts = usage( router );
+  for ( size_t i = 1; i < NUM_INTERFACES; i++ ) {
+    expect( counts[i] > 800 and counts[i] < 1200, "path " + to_string( i ) + " carried " + to_string( counts[i] ) );
+  }
+  expect( route_flows( router, flows ) == first, "a flow should always take the same path" );
+}
+
+// Adding or removing a path only moves the flows that have to move
+void test_resilience()
+{
+  Router router = make_router();
+  for ( size_t i = 1; i <= 3; i++ ) {
+    router.add_path( PREFIX, 8, uplink( i ), i );
+  }
+  const vector<Flow> flows = make_flows( 3000 );
+  const vector<size_t> three = route_flows( router, flows );
+
+  router.add_path( PREFIX, 8, uplink( 4 ), 4 );
+  const vector<size_t> four = route_flows( router, flows );
+  size_t moved = 0;
+  for ( size_t k = 0; k < flows.size(); k++ ) {
+    if ( four[k] != three[k] ) {
+      expect( four[k] == 4, "a flow should only move onto the new path" );
+      moved++;
+    }
+  }
+  expect( moved > 600 and moved < 900, "about a quarter of the flows should move, not " + to_string( moved ) );
+
+  expect( router.remove_path( PREFIX, 8, uplink( 2 ), 2 ), "the path should be removed" );
+  const vector<size_t> without_two = route_flows( router, flows );
+  for ( size_t k = 0; k < flows.size(); k++ ) {
+    expect( four[k] == 2 or without_two[k] == four[k], "only the removed path's flows should move" );
+    expect( without_two[k] != 2, "no flow should take the removed path" );
+  }
+  expect( not router.remove_path( PREFIX, 8, uplink( 2 ), 2 ), "a path should only be removed once" );
+
+  // down to one path
+  router.remove_path( PREFIX, 8, uplink( 1 ), 1 );
+  router.remove_path( PREFIX, 8, uplink( 3 ), 3 );
+  for ( const size_t out : route_flows( router, make_flows( 50 ) ) ) {
+    expect( out == 4, "a single remaining path should take every flow" );
+  }
+}
+
+void test_withdrawn()
+{
+  Router router = make_router();
+  router.add_path( PREFIX, 8, uplink( 1 ), 1 );
+  router.add_path( PREFIX, 8, uplink( 2 ), 2 );
+  router.remove_path( PREFIX, 8, uplink( 1 ), 1 );
+  router.remove_path( PREFIX, 8, uplink( 2 ), 2 );
+  const uint64_t no_route = router.stats().no_route;
+  bool forwarded = true;
+  try {
+    route_flow( router, 1, PREFIX | 1, 6 );
+  } catch ( const runtime_error& ) {
+    forwarded = false;
+  }
+  expect( not forwarded and router.stats().no_route == no_route + 1, "removing the last path should withdraw the route" );
+
+  // replace_route turns a multipath route back into a single one
+  router.add_path( PREFIX, 8, uplink( 1 ), 1 );
+  router.add_path( PREFIX, 8, uplink( 2 ), 2 );
+  router.replace_route( PREFIX, 8, uplink( 3 ), 3 );
+  for ( const size_t out : route_flows( router, make_flows( 50 ) ) ) {
+    expect( out == 3, "a replaced route should have only its new path" );
+  }
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    test_crc32c();
+    test_spreading();
+    test_resilience();
+    test_withdrawn();
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,134 @@
+#include "common.hh"
+#include "fabric_simulator.hh"
+
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+namespace {
+
+uint32_t ip( const string& str )
+{
+  return Address { str }.ipv4_numeric();
+}
+
+// h0 -- r0 -- r1 -- r2 -- h2, every link 1 ms
+void test_chain()
+{
+  FabricSimulator sim;
+  const size_t r0 = sim.add_router();
+  const size_t r1 = sim.add_router();
+  const size_t r2 = sim.add_router();
+  const auto [r0_east, r1_west] = sim.connect( r0, Address { "172.16.0.1" }, r1, Address { "172.16.0.2" } );
+  const auto [r1_east, r2_west] = sim.connect( r1, Address { "172.16.1.1" }, r2, Address { "172.16.1.2" } );
+  const size_t h0 = sim.add_host( r0, Address { "10.0.0.2" }, Address { "10.0.0.1" } );
+  const size_t h2 = sim.add_host( r2, Address { "10.2.0.2" }, Address { "10.2.0.1" } );
+
+  sim.router( r0 ).add_route( ip( "10.0.0.0" ), 24, {}, sim.attachment( h0 ) );
+  sim.router( r0 ).add_route( ip( "0.0.0.0" ), 0, Address { "172.16.0.2" }, r0_east );
+  sim.router( r1 ).add_route( ip( "10.0.0.0" ), 16, Address { "172.16.0.1" }, r1_west );
+  sim.router( r1 ).add_route( ip( "10.2.0.0" ), 16, Address { "172.16.1.2" }, r1_east );
+  sim.router( r2 ).add_route( ip( "10.2.0.0" ), 24, {}, sim.attachment( h2 ) );
+  sim.router( r2 ).add_route( ip( "0.0.0.0" ), 0, Address { "172.16.1.1" }, r2_west );
+
+  sim.add_flow( h0, Address { "10.2.0.2" }, 100 );
+  const FabricSimulator::Report report = sim.run( 200 );
+
+  expect( report.sent == 100 and report.delivered == 100, "every datagram should arrive" );
+  expect( report.forwarded == 300, "each datagram should be forwarded by all three routers" );
+  expect( report.hops == 400, "each datagram should take four links" );
+  expect( report.link_drops == 0, "no link should overflow" );
+  // (to the histogram's precision)
+  expect( report.per_hop.percentile( 0.5 ) >= 1000 and report.per_hop.percentile( 0.5 ) < 1040,
+          "once ARP is done, a hop should take one link latency" );
+  expect( report.end_to_end.max() > 4000, "the first datagram should wait for ARP on the way" );
+  expect( report.windows == 200 and sim.now() == 200, "1 ms links should give 1 ms windows" );
+
+  // A route withdrawn between runs
+  sim.router( r1 ).remove_route( ip( "10.2.0.0" ), 16 );
+  sim.add_flow( h0, Address { "10.2.0.2" }, 10 );
+  const FabricSimulator::Report after = sim.run( 50 );
+  expect( after.sent == 10 and after.delivered == 0, "datagrams without a route should not arrive" );
+  expect( sim.router( r1 ).stats().no_route == 10, "the router without the route should drop them" );
+}
+
+// A core router with `edges` edge routers (on links holding `capacity` frames), each with `hosts`
+// hosts that send to the hosts of the next edge router
+unique_ptr<FabricSimulator> star( const size_t edges,
+                                  const size_t hosts,
+                                  const size_t capacity = FabricSimulator::DEFAULT_LINK_CAPACITY )
+{
+  auto sim = make_unique<FabricSimulator>();
+  const size_t core = sim->add_router();
+  for ( size_t e = 0; e < edges; e++ ) {
+    const size_t edge = sim->add_router();
+    const string link = "172.16." + to_string( e ) + ".";
+    const auto [core_port, edge_port]
+      = sim->connect( core, Address { link + "1" }, edge, Address { link + "2" }, 3, capacity );
+    sim->router( core ).add_route( ip( "10." + to_string( e ) + ".0.0" ), 16, Address { link + "2" }, core_port );
+    sim->router( edge ).add_route( 0, 0, Address { link + "1" }, edge_port );
+    for ( size_t h = 0; h < hosts; h++ ) {
+      const string subnet = "10." + to_string( e ) + "." + to_string( h ) + ".";
+      const size_t host = sim->add_host( edge, Address { subnet + "2" }, Address { subnet + "1" }, 2 );
+      sim->router( edge ).add_route( ip( subnet + "0" ), 24, {}, sim->attachment( host ) );
+    }
+  }
+
+  for ( size_t e = 0; e < edges; e++ ) {
+    for ( size_t h = 0; h < hosts; h++ ) {
+      const string destination = "10." + to_string( ( e + 1 ) % edges ) + "." + to_string( h ) + ".2";
+      sim->add_flow( e * hosts + h, Address { destination }, 50, 1 + h % 3, h );
+    }
+  }
+  return sim;
+}
+
+// The same fabric gives the same results on one thread as on several
+void test_threads()
+{
+  const auto one = star( 6, 5 )->run( 300, 1 );
+  const auto four = star( 6, 5 )->run( 300, 4 );
+
+  expect( one.threads == 1 and four.threads == 4, "the runs should use the threads asked for" );
+  expect( one.windows == 150, "2 ms links should give 2 ms windows" );
+  expect( one.sent == 6 * 5 * 50 and one.delivered == one.sent, "every datagram should arrive" );
+  expect( one.hops == one.delivered * 4, "each datagram should take four links" );
+  expect( four.sent == one.sent and four.delivered == one.delivered and four.forwarded == one.forwarded,
+          "the threads should not change what is delivered" );
+  expect( four.hops == one.hops and four.latency_us == one.latency_us
+            and four.end_to_end.percentile( 0.99 ) == one.end_to_end.percentile( 0.99 ),
+          "the threads should not change the latencies" );
+}
+
+// Links too small for the traffic drop the same frames on one thread as on several, although
+// senders run up to a window ahead of their receivers
+void test_threads_with_drops()
+{
+  const auto one = star( 6, 5, 4 )->run( 300, 1 );
+  const auto four = star( 6, 5, 4 )->run( 300, 4 );
+
+  expect( one.link_drops > 0 and one.delivered < one.sent, "the edge links should overflow" );
+  expect( four.link_drops == one.link_drops, "the threads should not change what is dropped" );
+  expect( four.delivered == one.delivered and four.forwarded == one.forwarded and four.latency_us == one.latency_us,
+          "the threads should not change what is delivered" );
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    test_chain();
+    test_threads();
+    test_threads_with_drops();
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
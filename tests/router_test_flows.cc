@@ -0,0 +1,167 @@
+#include "common.hh"
+#include "flow_table.hh"
+#include "router.hh"
+
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+FlowKey flow( const uint32_t n )
+{
+  return { 0x0A'00'00'00 + n, 0xC0'A8'00'01, n * 7, IPv4Header::PROTO_UDP };
+}
+
+// Random flows and idle periods, checked against a map of when each flow was last seen
+void test_flow_table()
+{
+  constexpr uint64_t timeout = 1000;
+  FlowTable table { 64 * 1024, timeout };
+  const size_t capacity = table.stats().capacity;
+  expect( capacity >= 256 and capacity * 80 <= 64 * 1024, "the table should fill its budget, and no more" );
+
+  mt19937 rng { 458 };
+  unordered_map<uint32_t, uint64_t> last_seen;
+  uint64_t now = 0;
+  for ( int step = 0; step < 100000; step++ ) {
+    const uint32_t n = rng() % 1024;
+    const FlowKey key = flow( n );
+    const FlowTable::Flow* recorded = table.record( key, FlowTable::hash( key ), 100, now );
+    if ( recorded != nullptr ) {
+      expect( recorded->key == key and recorded->last_seen == now, "record() should return the flow" );
+      last_seen[n] = now;
+    } else {
+      expect( not last_seen.contains( n ), "a tracked flow should always be recorded" );
+      expect( ( table.stats().active + 1 ) * 8 > capacity * 7, "a flow should only be rejected when full" );
+    }
+
+    if ( rng() % 64 == 0 ) {
+      now += rng() % 300;
+      table.expire( now );
+      erase_if( last_seen, [&]( const auto& entry ) { return now >= entry.second + timeout; } );
+    }
+
+    if ( step % 1000 == 0 ) {
+      expect( table.stats().active == last_seen.size(), "flows should be evicted exactly when idle" );
+      for ( uint32_t probe = 0; probe < 1024; probe++ ) {
+        const FlowTable::Flow* found = table.find( flow( probe ) );
+        const auto it = last_seen.find( probe );
+        expect( ( found != nullptr ) == ( it != last_seen.end() ), "find() presence mismatch" );
+        expect( found == nullptr or found->last_seen == it->second, "find() last_seen mismatch" );
+      }
+    }
+  }
+  expect( table.stats().rejected > 0 and table.stats().expired > 0, "the test should fill and expire the table" );
+
+  // counts, and a long idle period
+  FlowTable small { 64 * 80, timeout };
+  for ( int i = 0; i < 3; i++ ) {
+    small.record( flow( 1 ), FlowTable::hash( flow( 1 ) ), 40, 10 );
+  }
+  const FlowTable::Flow* counted = small.find( flow( 1 ) );
+  expect( counted != nullptr and counted->datagrams == 3 and counted->bytes == 120, "a flow should be counted" );
+  small.expire( timeout + 9 );
+  expect( small.find( flow( 1 ) ) != nullptr, "a flow should not expire early" );
+  small.expire( 1'000'000 );
+  expect( small.find( flow( 1 ) ) == nullptr and small.stats().expired == 1, "an idle flow should expire" );
+}
+
+InternetDatagram make_datagram( const uint32_t src, const uint8_t proto, const string& payload )
+{
+  InternetDatagram dgram;
+  dgram.header.src = src;
+  dgram.header.dst = 0xC0'A8'00'05;
+  dgram.header.proto = proto;
+  dgram.header.ttl = 64;
+  dgram.header.len = IPv4Header::LENGTH + payload.size();
+  dgram.header.compute_checksum();
+  dgram.payload.emplace_back( payload );
+  return dgram;
+}
+
+// Ports are read from the payload of TCP and UDP datagrams that are not fragments
+void test_ports()
+{
+  const string ports { "\x12\x34\x00\x35rest", 8 };
+  const auto ports_of = []( const InternetDatagram& dgram ) { return IPv4View::of( dgram ).ports(); };
+  expect( ports_of( make_datagram( 1, IPv4Header::PROTO_UDP, ports ) ) == 0x1234'0035, "UDP ports should be read" );
+  expect( ports_of( make_datagram( 1, IPv4Header::PROTO_TCP, ports ) ) == 0x1234'0035, "TCP ports should be read" );
+  expect( ports_of( make_datagram( 1, 1, ports ) ) == 0, "other protocols have no ports" );
+  expect( ports_of( make_datagram( 1, IPv4Header::PROTO_UDP, "\x12" ) ) == 0, "a short payload has no ports" );
+
+  InternetDatagram fragment = make_datagram( 1, IPv4Header::PROTO_UDP, ports );
+  fragment.header.df = false;
+  fragment.header.mf = true;
+  fragment.header.compute_checksum();
+  expect( ports_of( fragment ) == 0, "a fragment has no ports" );
+
+  // ports split between buffers
+  InternetDatagram split = make_datagram( 1, IPv4Header::PROTO_UDP, "" );
+  split.payload = { Buffer { string( "\x12" ) }, Buffer { string( "\x34\x00", 2 ) }, Buffer { string( "\x35" ) } };
+  split.header.len = IPv4Header::LENGTH + 4;
+  split.header.compute_checksum();
+  expect( ports_of( split ) == 0x1234'0035, "ports split between buffers should be read" );
+}
+
+// The router counts the flows it forwards, and evicts them on its own clock
+void test_router()
+{
+  Router router;
+  router.add_interface( AsyncNetworkInterface { { 0x02, 0, 0, 0, 0, 1 }, Address( "10.0.0.1", 0 ) } );
+  router.track_flows( 1 << 16, 5000 );
+  router.add_interface( AsyncNetworkInterface { { 0x02, 0, 0, 0, 0, 2 }, Address( "192.168.0.1", 0 ) } );
+  router.add_route( 0xC0'A8'00'00, 16, {}, 1 );
+
+  const auto send = [&]( const uint32_t src, const string& payload ) {
+    EthernetFrame frame;
+    frame.header = { { 0x02, 0, 0, 0, 0, 1 }, { 0x02, 0, 0, 0, 0, 5 }, EthernetHeader::TYPE_IPv4 };
+    frame.payload = serialize( make_datagram( src, IPv4Header::PROTO_UDP, payload ) );
+    router.interface( 0 ).recv_frame( frame );
+  };
+  send( 0x0A'00'00'05, string( "\x12\x34\x00\x35", 4 ) );
+  send( 0x0A'00'00'05, string( "\x12\x34\x00\x35", 4 ) );
+  send( 0x0A'00'00'05, string( "\x12\x35\x00\x35", 4 ) ); // another source port
+  send( 0x0A'00'00'06, string( "\x12\x34\x00\x35", 4 ) );
+  router.route();
+
+  const vector<vector<FlowTable::Flow>> flows = router.flows();
+  expect( flows.size() == 2 and flows[0].size() == 3 and flows[1].empty(), "flows should be tracked per interface" );
+  uint64_t datagrams = 0;
+  for ( const FlowTable::Flow& f : flows[0] ) {
+    datagrams += f.datagrams;
+    if ( f.key.src == 0x0A'00'00'05 and f.key.ports == 0x1234'0035 ) {
+      expect( f.datagrams == 2 and f.bytes == 2 * ( IPv4Header::LENGTH + 4 ), "a flow's datagrams should be counted" );
+    }
+  }
+  expect( datagrams == 4, "every forwarded datagram should be counted" );
+
+  router.tick( 4000 );
+  send( 0x0A'00'00'06, string( "\x12\x34\x00\x35", 4 ) );
+  router.route();
+  router.tick( 2000 );
+  const FlowTable::Stats stats = router.flow_stats();
+  expect( stats.active == 1 and stats.created == 3 and stats.expired == 2, "idle flows should be evicted by tick()" );
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    test_flow_table();
+    test_ports();
+    test_router();
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,200 @@
+#include "arp_message.hh"
+#include "common.hh"
+#include "ethernet_frame.hh"
+#include "ipv4_datagram.hh"
+#include "ipv4_view.hh"
+#include "router.hh"
+
+#include <cstdlib>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+string concat( const vector<Buffer>& buffers )
+{
+  string out;
+  for ( const auto& piece : buffers ) {
+    out.append( piece );
+  }
+  return out;
+}
+
+const EthernetAddress inside_eth { 0x02, 0, 0, 0, 0, 1 };
+const EthernetAddress outside_eth { 0x02, 0, 0, 0, 0, 2 };
+const EthernetAddress host_eth { 0x02, 0, 0, 0, 0, 9 };
+const uint32_t host_ip = Address( "192.168.0.9", 0 ).ipv4_numeric();
+
+InternetDatagram make_datagram( const string& payload, const uint8_t ttl = 64 )
+{
+  InternetDatagram dgram;
+  dgram.header.src = Address( "10.0.0.5", 0 ).ipv4_numeric();
+  dgram.header.dst = host_ip;
+  dgram.header.ttl = ttl;
+  dgram.header.len = IPv4Header::LENGTH + payload.size();
+  dgram.header.compute_checksum();
+  dgram.payload.emplace_back( payload );
+  return dgram;
+}
+
+// A frame to the router's inside interface, all in one buffer (as a driver receives it)
+EthernetFrame frame_of( const InternetDatagram& dgram )
+{
+  EthernetFrame frame;
+  frame.header = { inside_eth, { 0x02, 0, 0, 0, 0, 5 }, EthernetHeader::TYPE_IPv4 };
+  frame.payload = serialize( dgram );
+  EthernetFrame whole;
+  parse( whole, { Buffer { concat( serialize( frame ) ) } } );
+  return whole;
+}
+
+// The view: checks made on the raw bytes, fields read where they are, TTL patched in place
+void test_view()
+{
+  const InternetDatagram dgram = make_datagram( string( 200, 'p' ) );
+  vector<Buffer> bytes { Buffer { concat( serialize( dgram ) ) } };
+
+  optional<IPv4View> view = IPv4View::parse( bytes );
+  expect( view.has_value(), "a good datagram should parse" );
+  expect( view->dst() == dgram.header.dst and view->src() == dgram.header.src and view->ttl() == 64
+            and view->proto() == dgram.header.proto and view->size() == IPv4Header::LENGTH + 200
+            and not view->fragment(),
+          "fields should be read from the raw bytes" );
+
+  // shared bytes are copied before they are patched, so the original is left alone
+  const string before = concat( bytes );
+  view->decrement_ttl();
+  expect( concat( bytes ) == before, "patching a shared buffer should not change it" );
+  const InternetDatagram decoded = view->decode();
+  expect( decoded.header.ttl == 63 and concat( decoded.payload ) == string( 200, 'p' ),
+          "the patched datagram should decode, with a valid checksum" );
+  const vector<Buffer> patched = view->release();
+  expect( patched.size() == 2 and patched.front().size() == IPv4Header::LENGTH
+            and string_view { patched.back() }.data() == string_view { bytes.front() }.data() + IPv4Header::LENGTH,
+          "only the header of a shared buffer should be copied" );
+
+  // unshared bytes are patched where they are
+  bytes = { Buffer { concat( serialize( dgram ) ) } };
+  const char* const where = string_view { bytes.front() }.data();
+  view = IPv4View::parse( bytes );
+  bytes.clear();
+  view->decrement_ttl();
+  const vector<Buffer> out = view->release();
+  expect( out.size() == 1 and string_view { out.front() }.data() == where, "the TTL should be patched in place" );
+
+  // a header split across buffers is gathered; a bad checksum is rejected
+  const string wire = concat( serialize( dgram ) );
+  view = IPv4View::parse( { Buffer { wire.substr( 0, 7 ) }, Buffer { wire.substr( 7 ) } } );
+  expect( view.has_value() and view->dst() == host_ip and view->size() == wire.size(),
+          "a split header should be gathered" );
+  string corrupt = wire;
+  corrupt[8] ^= 1;
+  expect( not IPv4View::parse( { Buffer { corrupt } } ).has_value(), "a bad checksum should be rejected" );
+  expect( not IPv4View::parse( { Buffer { wire.substr( 0, 19 ) } } ).has_value(), "a short header should be rejected" );
+
+  // the header's options (here, the first bytes of the payload), and the total length, must fit in the bytes
+  InternetDatagram with_options = dgram;
+  with_options.header.hlen = 6;
+  with_options.header.compute_checksum();
+  const string options_wire = concat( serialize( with_options ) );
+  expect( IPv4View::parse( { Buffer { options_wire.substr( 0, 22 ) }, Buffer { options_wire.substr( 22 ) } } )
+            .has_value(),
+          "options split across buffers should be gathered" );
+  expect( not IPv4View::parse( { Buffer { options_wire.substr( 0, 22 ) } } ).has_value(),
+          "a header truncated in its options should be rejected" );
+  expect( not IPv4View::parse( { Buffer { wire.substr( 0, wire.size() - 1 ) } } ).has_value(),
+          "a payload shorter than the total length should be rejected" );
+  expect( IPv4View::parse( { Buffer { wire + string( 6, '\0' ) } } ).has_value(),
+          "padding after the datagram should be allowed" );
+}
+
+// The router forwards the bytes it received, with only the TTL and checksum changed
+void test_router()
+{
+  Router router;
+  router.add_interface( AsyncNetworkInterface { inside_eth, Address( "10.0.0.1", 0 ) } );
+  router.add_interface( AsyncNetworkInterface { outside_eth, Address( "192.168.0.1", 0 ) } );
+  router.add_route( Address( "192.168.0.0", 0 ).ipv4_numeric(), 16, {}, 1 );
+  expect( router.interface( 0 ).forwarding(), "a router's interfaces should forward views" );
+
+  // the first datagram waits for ARP (decoded, in the pending queue)
+  const InternetDatagram first = make_datagram( string( 300, 'a' ) );
+  router.interface( 0 ).recv_frame( frame_of( first ) );
+  router.route();
+  optional<EthernetFrame> request = router.interface( 1 ).maybe_send();
+  expect( request.has_value() and request->header.type == EthernetHeader::TYPE_ARP, "ARP should be sent first" );
+
+  ARPMessage arp;
+  arp.opcode = ARPMessage::OPCODE_REPLY;
+  arp.sender_ethernet_address = host_eth;
+  arp.sender_ip_address = host_ip;
+  arp.target_ethernet_address = outside_eth;
+  arp.target_ip_address = Address( "192.168.0.1", 0 ).ipv4_numeric();
+  EthernetFrame reply;
+  reply.header = { outside_eth, host_eth, EthernetHeader::TYPE_ARP };
+  reply.payload = serialize( arp );
+  router.interface( 1 ).recv_frame( reply );
+
+  InternetDatagram expected = first;
+  expected.header.decrement_ttl();
+  optional<EthernetFrame> sent = router.interface( 1 ).maybe_send();
+  expect( sent.has_value() and concat( sent->payload ) == concat( serialize( expected ) ),
+          "the queued datagram should go out with its TTL decremented" );
+
+  // once resolved, a datagram goes out as the one buffer it came in, patched in place
+  EthernetFrame second = frame_of( make_datagram( string( 1000, 'b' ) ) );
+  const char* const where = string_view { second.payload.front() }.data();
+  router.interface( 0 ).recv_frame( second );
+  second = {};
+  router.route();
+  sent = router.interface( 1 ).maybe_send();
+  expect( sent.has_value() and sent->header.dst == host_eth and sent->payload.size() == 1
+            and string_view { sent->payload.front() }.data() == where,
+          "a forwarded datagram should keep its buffer" );
+  InternetDatagram forwarded;
+  expect( parse( forwarded, sent->payload ) and forwarded.header.ttl == 63
+            and concat( forwarded.payload ) == string( 1000, 'b' ),
+          "the forwarded datagram should have a valid header and its payload" );
+
+  // larger than the outbound MTU: decoded, and fragmented
+  router.interface( 1 ).set_mtu( 576 );
+  InternetDatagram large = make_datagram( string( 1000, 'c' ) );
+  large.header.df = false;
+  large.header.compute_checksum();
+  router.interface( 0 ).recv_frame( frame_of( large ) );
+  router.route();
+  vector<EthernetFrame> fragments;
+  router.interface( 1 ).maybe_send_batch( fragments );
+  expect( fragments.size() == 2, "a datagram over the MTU should be fragmented" );
+
+  // bad checksums and expired TTLs are still dropped
+  EthernetFrame bad = frame_of( make_datagram( "x" ) );
+  string corrupt = concat( bad.payload );
+  corrupt[10] ^= 1;
+  bad.payload = { Buffer { corrupt } };
+  router.interface( 0 ).recv_frame( bad );
+  router.interface( 0 ).recv_frame( frame_of( make_datagram( "y", 1 ) ) );
+  router.route();
+  expect( router.stats().parse_errors == 1 and router.stats().ttl_expired == 1, "bad datagrams should be counted" );
+  expect( not router.interface( 1 ).maybe_send().has_value(), "... and not forwarded" );
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    test_view();
+    test_router();
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
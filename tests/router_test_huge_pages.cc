@@ -0,0 +1,100 @@
+#include "common.hh"
+#include "huge_pages.hh"
+#include "route_trie.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+namespace {
+
+size_t total( const HugePageUsage& usage )
+{
+  size_t bytes = 0;
+  for ( const size_t b : usage.bytes ) {
+    bytes += b;
+  }
+  return bytes;
+}
+
+// Mappings fall back to whatever pages there are, and are counted by backend
+void test_mapping()
+{
+  const size_t before = total( huge_page_usage() );
+
+  PageBackend backend {};
+  void* const mapping = map_huge_pages( 3 * HUGE_PAGE_SIZE + 1, &backend );
+  expect( reinterpret_cast<uintptr_t>( mapping ) % HUGE_PAGE_SIZE == 0, "a mapping should be huge-page aligned" );
+  const HugePageUsage during = huge_page_usage();
+  expect( during[backend] >= 4 * HUGE_PAGE_SIZE, "a mapping should be counted under its backend" );
+  expect( total( during ) == before + 4 * HUGE_PAGE_SIZE, "a mapping should be rounded up to huge pages" );
+  expect( during.to_string().find( string { to_string( backend ) } ) != string::npos, "the report should name it" );
+
+  // (zeroed, and all of it writable)
+  auto* const bytes = static_cast<uint8_t*>( mapping );
+  expect( bytes[0] == 0 and bytes[3 * HUGE_PAGE_SIZE] == 0, "a mapping should be zeroed" );
+  for ( size_t i = 0; i < 4 * HUGE_PAGE_SIZE; i += 4096 ) {
+    bytes[i] = 1;
+  }
+
+  unmap_huge_pages( mapping, 3 * HUGE_PAGE_SIZE + 1 );
+  expect( total( huge_page_usage() ) == before, "unmapping should be counted" );
+}
+
+// Vectors move onto huge pages once they are large, and stay on the heap until then
+void test_vector()
+{
+  const size_t before = total( huge_page_usage() );
+
+  HugePageVector<uint32_t> values( 1000, 7 );
+  expect( total( huge_page_usage() ) == before, "a small vector should stay on the heap" );
+
+  for ( uint32_t i = 0; i < 4'000'000; i++ ) {
+    values.push_back( i );
+  }
+  expect( total( huge_page_usage() ) >= before + values.capacity() * sizeof( uint32_t ),
+          "a large vector should be on huge pages" );
+  expect( values[999] == 7 and values[1000] == 0 and values.back() == 3'999'999, "growing should keep the values" );
+
+  HugePageVector<uint32_t> copy = values;
+  expect( copy == values, "copies should be equal" );
+
+  values.clear();
+  values.shrink_to_fit();
+  copy.clear();
+  copy.shrink_to_fit();
+  expect( total( huge_page_usage() ) == before, "freeing a vector should unmap it" );
+}
+
+// A large trie (its nodes on huge pages) still finds its routes
+void test_trie()
+{
+  RouteTrie trie;
+  for ( uint32_t i = 0; i < 200'000; i++ ) {
+    trie.insert( i << 8, 24, i );
+  }
+  expect( trie.nodes().size() * sizeof( RouteTrie::Node ) >= HUGE_PAGE_SIZE, "the trie should be large" );
+  for ( uint32_t i = 0; i < 200'000; i += 997 ) {
+    expect( trie.lookup( ( i << 8 ) | 5 ) == i, "the trie should find its routes" );
+  }
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    test_mapping();
+    test_vector();
+    test_trie();
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,345 @@
+#include "common.hh"
+#include "ndp_message.hh"
+#include "route_trie6.hh"
+#include "router.hh"
+
+#include <cstddef>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+const EthernetAddress HOST_ETHERNET { 0x02, 0, 0, 0, 0x10, 0x01 };
+const IPv6Address HOST = ipv6_address( "2001:db8:1::10" );
+
+EthernetFrame ipv6_frame( const EthernetAddress& src, const EthernetAddress& dst, const IPv6Datagram& dgram )
+{
+  EthernetFrame frame;
+  frame.header = { dst, src, EthernetHeader::TYPE_IPv6 };
+  frame.payload = serialize( dgram );
+  return frame;
+}
+
+IPv6Datagram datagram_to( const IPv6Address& dst, uint8_t hop_limit )
+{
+  IPv6Datagram dgram;
+  dgram.header.src = ipv6_address( "2001:db8:2::20" );
+  dgram.header.dst = dst;
+  dgram.header.hop_limit = hop_limit;
+  dgram.header.next_header = IPv6Header::NEXT_HEADER_UDP;
+  dgram.header.payload_length = 5;
+  dgram.payload.emplace_back( string( "hello" ) );
+  return dgram;
+}
+
+// The NDP message carried by a frame, if it is one (with a correct checksum)
+optional<NDPMessage> ndp_message( const EthernetFrame& frame )
+{
+  IPv6Datagram dgram;
+  if ( frame.header.type != EthernetHeader::TYPE_IPv6 or not parse( dgram, frame.payload ) ) {
+    return {};
+  }
+  string raw;
+  for ( const auto& piece : dgram.payload ) {
+    raw.append( piece );
+  }
+  NDPMessage message;
+  if ( dgram.header.next_header != IPv6Header::NEXT_HEADER_ICMPV6 or not NDPMessage::checksum_ok( dgram.header, raw )
+       or not parse( message, dgram.payload ) ) {
+    return {};
+  }
+  return message;
+}
+
+// An advertisement from `from` (at `from_ethernet`) to `to` (at `to_ethernet`)
+EthernetFrame advertisement( const IPv6Address& from,
+                             const EthernetAddress& from_ethernet,
+                             const IPv6Address& to,
+                             const EthernetAddress& to_ethernet )
+{
+  NDPMessage message;
+  message.type = NDPMessage::TYPE_NEIGHBOR_ADVERTISEMENT;
+  message.solicited = true;
+  message.override_address = true;
+  message.target = from;
+  message.link_layer_address = from_ethernet;
+
+  IPv6Datagram dgram;
+  dgram.header.src = from;
+  dgram.header.dst = to;
+  dgram.header.hop_limit = NDPMessage::HOP_LIMIT;
+  dgram.header.next_header = IPv6Header::NEXT_HEADER_ICMPV6;
+  dgram.header.payload_length = static_cast<uint16_t>( message.serialized_length() );
+  message.compute_checksum( dgram.header );
+  dgram.payload = serialize( message );
+  return ipv6_frame( from_ethernet, to_ethernet, dgram );
+}
+
+void test_codec()
+{
+  const IPv6Datagram dgram = datagram_to( HOST, 7 );
+  IPv6Datagram parsed;
+  expect( parse( parsed, serialize( dgram ) ), "an IPv6 datagram parses" );
+  expect( parsed.header.dst == HOST and parsed.header.hop_limit == 7 and parsed.header.payload_length == 5,
+          "IPv6 header round trip: " + parsed.header.to_string() );
+
+  const optional<IPv6View> view = IPv6View::parse( serialize( dgram ) );
+  expect( view.has_value() and view->dst() == HOST and view->size() == IPv6Header::LENGTH + 5,
+          "a view reads the header in place" );
+
+  InternetDatagram ipv4;
+  expect( not IPv6View::parse( serialize( ipv4 ) ).has_value(), "an IPv4 datagram is not an IPv6 view" );
+
+  const IPv6Address solicited = solicited_node_address( ipv6_address( "2001:db8::12:3456" ) );
+  expect( to_string( solicited ) == "ff02::1:ff12:3456", "solicited-node address" );
+  const EthernetAddress multicast = ethernet_multicast_address( ipv6_address( "ff02::1:ff12:3456" ) );
+  expect( multicast == EthernetAddress { 0x33, 0x33, 0xff, 0x12, 0x34, 0x56 }, "solicited-node Ethernet address" );
+
+  const EthernetFrame frame = advertisement( HOST, HOST_ETHERNET, ipv6_address( "2001:db8:1::1" ), {} );
+  const optional<NDPMessage> message = ndp_message( frame );
+  expect( message.has_value() and message->target == HOST and message->link_layer_address == HOST_ETHERNET
+            and message->solicited,
+          "NDP advertisement round trip" );
+}
+
+// RouteTrie6 against a brute-force longest-prefix match, as routes are added and removed
+void test_trie()
+{
+  mt19937 rng { 6 };
+  const vector<IPv6Address> bases
+    = { ipv6_address( "2001:db8::" ), ipv6_address( "2001:db8:ffff::" ), ipv6_address( "fe80::" ) };
+
+  const auto random_address = [&] {
+    IPv6Address address = bases[rng() % bases.size()];
+    for ( size_t i = static_cast<size_t>( rng() % 17 ); i < address.size(); i++ ) {
+      address[i] = static_cast<uint8_t>( rng() );
+    }
+    return address;
+  };
+
+  RouteTrie6 trie;
+  map<pair<IPv6Address, uint8_t>, uint32_t> model;
+
+  const auto model_lookup = [&]( const IPv6Address& address ) {
+    uint32_t route = RouteTrie6::NO_ROUTE;
+    int longest = -1;
+    for ( const auto& [prefix, value] : model ) {
+      if ( RouteTrie6::mask( address, prefix.second ) == prefix.first and prefix.second > longest ) {
+        longest = prefix.second;
+        route = value;
+      }
+    }
+    return route;
+  };
+
+  for ( uint32_t round = 0; round < 2000; round++ ) {
+    const auto length = static_cast<uint8_t>( rng() % 129 );
+    const IPv6Address prefix = RouteTrie6::mask( random_address(), length );
+    if ( rng() % 4 == 0 and not model.empty() ) {
+      auto it = model.begin();
+      advance( it, rng() % model.size() );
+      expect( trie.erase( it->first.first, it->first.second ) == it->second, "erase returns the route" );
+      model.erase( it );
+    } else {
+      const bool inserted = model.emplace( make_pair( prefix, length ), round ).second;
+      expect( trie.insert( prefix, length, round ) == inserted, "insert reports whether the prefix was new" );
+    }
+    expect( trie.size() == model.size(), "size" );
+
+    for ( int probe = 0; probe < 8; probe++ ) {
+      const IPv6Address address = random_address();
+      expect( trie.lookup( address ) == model_lookup( address ), "lookup of " + to_string( address ) );
+    }
+  }
+
+  vector<IPv6Address> addresses;
+  for ( int i = 0; i < 64; i++ ) {
+    addresses.push_back( random_address() );
+  }
+  vector<uint32_t> routes( addresses.size() );
+  trie.lookup_batch( addresses, routes );
+  for ( size_t i = 0; i < addresses.size(); i++ ) {
+    expect( routes[i] == model_lookup( addresses[i] ), "lookup_batch" );
+  }
+
+  trie.clear();
+  expect( trie.size() == 0 and trie.lookup( addresses.front() ) == RouteTrie6::NO_ROUTE, "clear" );
+}
+
+// Two interfaces resolving each other with NDP
+void test_ndp()
+{
+  const EthernetAddress a_ethernet { 0x02, 0, 0, 0, 0, 0x0a };
+  const EthernetAddress b_ethernet { 0x02, 0, 0, 0, 0, 0x0b };
+  NetworkInterface a { a_ethernet, Address( "10.0.0.1" ) };
+  NetworkInterface b { b_ethernet, Address( "10.0.0.2" ) };
+  a.set_ipv6_address( ipv6_address( "2001:db8::a" ) );
+  b.set_ipv6_address( ipv6_address( "2001:db8::b" ) );
+
+  // A datagram to b waits while a solicits b's solicited-node address
+  a.send_datagram6( *IPv6View::parse( serialize( datagram_to( *b.ipv6_address(), 64 ) ) ), *b.ipv6_address() );
+  expect( not a.resolved6( *b.ipv6_address() ), "not resolved yet" );
+  optional<EthernetFrame> solicitation = a.maybe_send();
+  expect( solicitation.has_value() and not a.maybe_send().has_value(), "one solicitation, the datagram waits" );
+  expect( solicitation->header.dst == ethernet_multicast_address( solicited_node_address( *b.ipv6_address() ) ),
+          "the solicitation is multicast" );
+  const optional<NDPMessage> ns = ndp_message( *solicitation );
+  expect( ns.has_value() and ns->type == NDPMessage::TYPE_NEIGHBOR_SOLICITATION and ns->target == *b.ipv6_address()
+            and ns->link_layer_address == a_ethernet,
+          "a neighbor solicitation for b, with a's Ethernet address" );
+
+  // b answers (and learns a), a sends what was waiting
+  expect( not b.recv_frame_view6( *solicitation ).has_value(), "NDP is not passed up" );
+  expect( b.resolved6( *a.ipv6_address() ), "b learned a from the solicitation" );
+  optional<EthernetFrame> reply = b.maybe_send();
+  expect( reply.has_value() and reply->header.dst == a_ethernet, "b answers a directly" );
+  const optional<NDPMessage> na = ndp_message( *reply );
+  expect( na.has_value() and na->type == NDPMessage::TYPE_NEIGHBOR_ADVERTISEMENT and na->solicited
+            and na->link_layer_address == b_ethernet,
+          "a solicited advertisement with b's Ethernet address" );
+
+  expect( not a.recv_frame_view6( *reply ).has_value(), "NDP is not passed up" );
+  expect( a.resolved6( *b.ipv6_address() ), "a learned b" );
+  optional<EthernetFrame> data = a.maybe_send();
+  expect( data.has_value() and data->header.dst == b_ethernet and data->header.type == EthernetHeader::TYPE_IPv6,
+          "the waiting datagram goes to b" );
+  const optional<IPv6View> received = b.recv_frame_view6( *data );
+  expect( received.has_value() and received->dst() == *b.ipv6_address(), "b receives the datagram" );
+
+  // A solicitation for some other address is not answered, and an entry expires after 30 s
+  NetworkInterface c { { 0x02, 0, 0, 0, 0, 0x0c }, Address( "10.0.0.3" ) };
+  c.set_ipv6_address( ipv6_address( "2001:db8::c" ) );
+  expect( not c.recv_frame_view6( *solicitation ).has_value() and not c.maybe_send().has_value(),
+          "a solicitation for another address is ignored" );
+  a.tick( 30000 );
+  expect( not a.resolved6( *b.ipv6_address() ) and a.stats().ndp_expiries == 1, "the entry expires" );
+
+  const NetworkInterface::Stats stats = a.stats();
+  expect( stats.ndp_solicitations_sent == 1 and stats.ndp_advertisements_received == 1, "a's NDP counters" );
+  expect( b.stats().ndp_solicitations_received == 1 and b.stats().ndp_advertisements_sent == 1, "b's NDP counters" );
+}
+
+// A router forwarding IPv6 datagrams between two interfaces
+void test_router( size_t workers )
+{
+  Router router;
+  for ( uint8_t i = 0; i < 2; i++ ) {
+    AsyncNetworkInterface interface { { 0x02, 0, 0, 0, 0, i }, Address::from_ipv4_numeric( 0x0A'00'00'01 + i ) };
+    interface.set_ipv6_address( ipv6_address( "2001:db8:" + to_string( i ) + "::1" ) );
+    router.add_interface( std::move( interface ) );
+  }
+  router.add_route6( ipv6_address( "2001:db8:1::" ), 48, nullopt, 1 );
+  router.add_route6( ipv6_address( "2001:db8:3::" ), 48, ipv6_address( "2001:db8:1::10" ), 1 );
+
+  const auto receive = [&]( const IPv6Datagram& dgram ) {
+    router.interface( 0 ).recv_frame( ipv6_frame( { 0x02, 0, 0, 0, 0x20, 0 }, { 0x02, 0, 0, 0, 0, 0 }, dgram ) );
+    router.route_parallel( workers );
+  };
+
+  // Directly attached: the router solicits the destination, then forwards with the hop limit decremented
+  receive( datagram_to( HOST, 64 ) );
+  optional<EthernetFrame> solicitation = router.interface( 1 ).maybe_send();
+  expect( solicitation.has_value() and ndp_message( *solicitation ).has_value()
+            and ndp_message( *solicitation )->target == HOST,
+          "the router solicits the destination" );
+  const EthernetAddress router_ethernet { 0x02, 0, 0, 0, 0, 1 };
+  router.interface( 1 ).recv_frame(
+    advertisement( HOST, HOST_ETHERNET, *router.interface( 1 ).ipv6_address(), router_ethernet ) );
+  optional<EthernetFrame> forwarded = router.interface( 1 ).maybe_send();
+  IPv6Datagram out;
+  expect( forwarded.has_value() and forwarded->header.dst == HOST_ETHERNET and parse( out, forwarded->payload ),
+          "the datagram is forwarded once the destination is known" );
+  expect( out.header.hop_limit == 63 and out.header.dst == HOST, "hop limit decremented" );
+
+  // Through a next hop (the same host), already known
+  receive( datagram_to( ipv6_address( "2001:db8:3::99" ), 64 ) );
+  forwarded = router.interface( 1 ).maybe_send();
+  expect( forwarded.has_value() and forwarded->header.dst == HOST_ETHERNET, "forwarded to the next hop" );
+
+  // No route, and an expired hop limit
+  receive( datagram_to( ipv6_address( "2001:db8:9::1" ), 64 ) );
+  receive( datagram_to( HOST, 1 ) );
+  expect( not router.interface( 1 ).maybe_send().has_value(), "nothing else is sent" );
+
+  const Router::Stats stats = router.stats();
+  expect( stats.forwarded == 2 and stats.no_route == 1 and stats.ttl_expired == 1, "router counters" );
+
+  // A withdrawn route no longer matches
+  expect( router.remove_route6( ipv6_address( "2001:db8:3::" ), 48 ), "the route is withdrawn" );
+  expect( not router.remove_route6( ipv6_address( "2001:db8:3::" ), 48 ), "... only once" );
+  receive( datagram_to( ipv6_address( "2001:db8:3::99" ), 64 ) );
+  expect( router.stats().no_route == 2, "no route after the withdrawal" );
+}
+
+// Replacing the IPv4 routes, in bulk or from a snapshot, keeps the IPv6 routes
+void test_ipv4_reload_keeps_ipv6()
+{
+  Router router;
+  for ( uint8_t i = 0; i < 2; i++ ) {
+    AsyncNetworkInterface interface { { 0x02, 0, 0, 0, 0, i }, Address::from_ipv4_numeric( 0x0A'00'00'01 + i ) };
+    interface.set_ipv6_address( ipv6_address( "2001:db8:" + to_string( i ) + "::1" ) );
+    router.add_interface( std::move( interface ) );
+  }
+  router.add_route6( ipv6_address( "2001:db8:1::" ), 48, nullopt, 1 );
+
+  // (the first datagram waits for the destination to answer the router's solicitation)
+  bool resolved = false;
+  const auto forwarded = [&] {
+    router.interface( 0 ).recv_frame(
+      ipv6_frame( { 0x02, 0, 0, 0, 0x20, 0 }, { 0x02, 0, 0, 0, 0, 0 }, datagram_to( HOST, 64 ) ) );
+    router.route();
+    if ( not resolved ) {
+      router.interface( 1 ).recv_frame(
+        advertisement( HOST, HOST_ETHERNET, *router.interface( 1 ).ipv6_address(), { 0x02, 0, 0, 0, 0, 1 } ) );
+      resolved = true;
+    }
+    optional<EthernetFrame> frame = router.interface( 1 ).maybe_send();
+    while ( frame.has_value() and frame->header.dst != HOST_ETHERNET ) {
+      frame = router.interface( 1 ).maybe_send();
+    }
+    return frame.has_value();
+  };
+  expect( forwarded(), "the IPv6 datagram is forwarded" );
+
+  const vector<Router::Route> routes { { 0x0A'01'00'00, 16, nullopt, 1 } };
+  router.load_routes( routes );
+  expect( forwarded(), "loading IPv4 routes keeps the IPv6 routes" );
+
+  const string path = ( filesystem::temp_directory_path()
+                        / ( "router_test_ipv6." + to_string( getpid() ) + ".fib" ) )
+                        .string();
+  router.save_fib_snapshot( path );
+  router.load_fib_snapshot( path );
+  filesystem::remove( path );
+  expect( forwarded(), "loading a FIB snapshot keeps the IPv6 routes" );
+  expect( router.stats().no_route == 0, "nothing is left without a route" );
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    test_codec();
+    test_trie();
+    test_ndp();
+    test_router( 1 );
+    test_router( 2 );
+    test_ipv4_reload_keeps_ipv6();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,110 @@
+#include "common.hh"
+#include "latency.hh"
+#include "router.hh"
+
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+namespace {
+
+// A percentile should be within the histogram's precision (1/SUB_BUCKETS) of the exact value
+void expect_close( uint64_t measured, uint64_t exact, const string& what )
+{
+  const double error = static_cast<double>( measured ) - static_cast<double>( exact );
+  expect( error >= 0 and error <= static_cast<double>( exact ) / LatencyHistogram::SUB_BUCKETS + 1,
+          what + ": got " + to_string( measured ) + ", expected about " + to_string( exact ) );
+}
+
+void test_histogram()
+{
+  LatencyHistogram empty;
+  expect( empty.count() == 0 and empty.percentile( 0.99 ) == 0, "an empty histogram should report zero" );
+
+  LatencyHistogram small;
+  for ( uint64_t v = 0; v < LatencyHistogram::SUB_BUCKETS; v++ ) {
+    small.record( v );
+  }
+  expect( small.percentile( 0 ) == 0 and small.percentile( 1 ) == LatencyHistogram::SUB_BUCKETS - 1,
+          "small values should be exact" );
+
+  // uniform values from 1 to 1,000,000
+  LatencyHistogram uniform;
+  for ( uint64_t v = 1; v <= 1'000'000; v++ ) {
+    uniform.record( v );
+  }
+  expect( uniform.count() == 1'000'000 and uniform.max() == 1'000'000, "count and max should be exact" );
+  expect_close( uniform.percentile( 0.5 ), 500'000, "p50" );
+  expect_close( uniform.percentile( 0.99 ), 990'000, "p99" );
+  expect_close( uniform.percentile( 0.999 ), 999'000, "p999" );
+  expect( uniform.percentile( 1 ) == 1'000'000, "p100 should be the max" );
+
+  // merging, and huge values
+  LatencyHistogram merged;
+  merged.record( UINT64_MAX );
+  merged.merge( uniform );
+  expect( merged.count() == 1'000'001, "merge should add the counts" );
+  expect( merged.max() == LatencyHistogram::MAX_VALUE, "huge values should be clamped" );
+  expect_close( merged.percentile( 0.5 ), 500'000, "merged p50" );
+
+  ostringstream line;
+  uniform.print( line, "test" );
+  expect( line.str().starts_with( "test: count=1000000 p50=" ), "print should name the histogram" );
+}
+
+static_assert( LATENCY_HISTOGRAMS_ENABLED or std::is_empty_v<LatencyRecorder>,
+               "the recorder should take no space when compiled out" );
+
+void test_router_latency()
+{
+  Router router;
+  for ( uint8_t i = 0; i < 2; i++ ) {
+    router.add_interface(
+      AsyncNetworkInterface { { 0x02, 0, 0, 0, 0, i }, Address::from_ipv4_numeric( 0x0A'00'00'01 + i ) } );
+  }
+  router.add_route( 0xC0'A8'00'00, 16, {}, 1 );
+
+  for ( int i = 0; i < 100; i++ ) {
+    InternetDatagram dgram;
+    dgram.header.dst = 0xC0'A8'00'05;
+    dgram.header.ttl = 64;
+    dgram.header.compute_checksum();
+    EthernetFrame frame;
+    frame.header = { { 0x02, 0, 0, 0, 0, 0 }, { 0x02, 0, 0, 0, 1, 0 }, EthernetHeader::TYPE_IPv4 };
+    frame.payload = serialize( dgram );
+    router.interface( 0 ).recv_frame( frame );
+  }
+  router.route();
+
+  ostringstream report;
+  router.print_latency( report );
+  if constexpr ( LATENCY_HISTOGRAMS_ENABLED ) {
+    expect( router.route_latency().count() == 100, "every routed datagram should be timed" );
+    expect( router.interface( 0 ).recv_latency().count() == 100, "every received frame should be timed" );
+    expect( router.interface( 1 ).send_latency().count() == 100, "every sent datagram should be timed" );
+    expect( report.str().find( "route: count=100 " ) != string::npos, "the report should include route()" );
+  } else {
+    expect( router.route_latency().count() == 0, "nothing should be timed when compiled out" );
+    expect( report.str().find( "not compiled in" ) != string::npos, "the report should say it is disabled" );
+  }
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    test_histogram();
+    test_router_latency();
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
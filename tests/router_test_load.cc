@@ -0,0 +1,117 @@
+#include "common.hh"
+#include "router.hh"
+
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+constexpr size_t NUM_INTERFACES = 4;
+
+Router make_router()
+{
+  Router router;
+  for ( uint8_t i = 0; i < NUM_INTERFACES; i++ ) {
+    router.add_interface(
+      AsyncNetworkInterface { { 0x02, 0, 0, 0, 0, i }, Address::from_ipv4_numeric( 0x0A'00'00'01 + i ) } );
+  }
+  return router;
+}
+
+// Everything the router sends for a datagram to `dst`, as "interface:frame bytes" lines
+string forward( Router& router, uint32_t dst )
+{
+  InternetDatagram dgram;
+  dgram.header.dst = dst;
+  dgram.header.ttl = 64;
+  dgram.header.compute_checksum();
+  EthernetFrame frame;
+  frame.header = { { 0x02, 0, 0, 0, 0, 0 }, { 0x02, 0, 0, 0, 1, 0 }, EthernetHeader::TYPE_IPv4 };
+  frame.payload = serialize( dgram );
+  router.interface( 0 ).recv_frame( frame );
+  router.route();
+
+  string out;
+  for ( size_t i = 0; i < NUM_INTERFACES; i++ ) {
+    while ( auto sent = router.interface( i ).maybe_send() ) {
+      out += to_string( i ) + ":";
+      for ( const auto& piece : serialize( *sent ) ) {
+        out.append( piece );
+      }
+      out += "\n";
+    }
+  }
+  return out;
+}
+
+// A bulk-loaded table routes exactly like the same routes added one at a time
+void test_load_matches_add()
+{
+  mt19937 rng { 458 };
+  vector<Router::Route> routes;
+  for ( int i = 0; i < 300; i++ ) {
+    const auto length = static_cast<uint8_t>( rng() % 33 );
+    // few distinct prefixes, so that there are duplicates (the first one wins)
+    const uint32_t prefix = static_cast<uint32_t>( rng() % 16 ) << 28 | static_cast<uint32_t>( rng() % 4 ) << 20;
+    const optional<uint32_t> next_hop
+      = rng() % 2 ? optional<uint32_t> { 0xC0'A8'00'01 + static_cast<uint32_t>( rng() % 8 ) } : nullopt;
+    routes.push_back( { prefix, length, next_hop, static_cast<size_t>( rng() % NUM_INTERFACES ) } );
+  }
+
+  Router added = make_router();
+  for ( const auto& route : routes ) {
+    added.add_route( route.prefix,
+                     route.prefix_length,
+                     route.next_hop.has_value() ? optional<Address> { Address::from_ipv4_numeric( *route.next_hop ) }
+                                                : nullopt,
+                     route.interface_num );
+  }
+
+  Router loaded = make_router();
+  loaded.add_route( 0, 0, {}, 3 ); // replaced by the load
+  loaded.load_routes( routes );
+
+  for ( int i = 0; i < 2000; i++ ) {
+    const uint32_t dst = static_cast<uint32_t>( rng() % 16 ) << 28 | static_cast<uint32_t>( rng() % 8 ) << 20
+                         | static_cast<uint32_t>( rng() & 0xFFFFF );
+    expect( forward( added, dst ) == forward( loaded, dst ), "loaded and added tables should route alike" );
+  }
+}
+
+void test_load_then_update()
+{
+  Router router = make_router();
+  router.load_routes( vector<Router::Route> { { 0xC0'A8'00'00, 16, {}, 1 }, { 0x0A'00'00'00, 8, {}, 2 } } );
+  expect( forward( router, 0xC0'A8'05'05 ).starts_with( "1:" ), "loaded route should be used" );
+
+  // the usual updates work on a loaded table
+  router.replace_route( 0xC0'A8'00'00, 16, Address( "10.0.0.9", 0 ), 2 );
+  expect( forward( router, 0xC0'A8'05'06 ).starts_with( "2:" ), "replaced route should be used" );
+  expect( router.remove_route( 0x0A'00'00'00, 8 ), "loaded route should be removable" );
+
+  // an empty load clears the table
+  router.load_routes( {} );
+  expect( forward( router, 0xC0'A8'05'07 ).empty(), "an empty load should remove every route" );
+  expect( router.stats().no_route == 1, "the datagram should have been dropped for lack of a route" );
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    test_load_matches_add();
+    test_load_then_update();
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
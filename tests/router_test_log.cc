@@ -0,0 +1,104 @@
+#include "common.hh"
+#include "log.hh"
+#include "router.hh"
+
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+void test_line_formatting()
+{
+  LogLine line;
+  line.append( "route " );
+  line.append( LogIpv4 { 0x0a000100 } );
+  line.append( '/' );
+  line.append( 24 );
+  line.append( " up=" );
+  line.append( true );
+  expect( line.view() == "route 10.0.1.0/24 up=true", "arguments should be formatted in place" );
+
+  LogLine full;
+  full.append( string( LogLine::MAX_LENGTH + 10, 'x' ) );
+  full.append( 12345 );
+  expect( full.view().size() == LogLine::MAX_LENGTH, "long lines should be truncated" );
+}
+
+void test_router_logs_to_ring()
+{
+  const uint64_t before = Log::count( LogLevel::DEBUG );
+  Router router;
+  router.add_route( 0x0a000000, 8, Address( "192.168.0.1", 0 ), 0 );
+  router.add_route( 0x0b000000, 8, {}, 1 );
+
+  if constexpr ( log_enabled( LogLevel::DEBUG ) ) {
+    expect( Log::count( LogLevel::DEBUG ) == before + 3, "construction and each route should be logged" );
+    const auto records = Log::recent();
+    expect( records.size() >= 2, "records should be kept in the ring" );
+    expect( records.back().text == "adding route 11.0.0.0/8 => (direct) on interface 1",
+            "the last record should be the last route" );
+    expect( records[records.size() - 2].text == "adding route 10.0.0.0/8 => 192.168.0.1 on interface 0",
+            "gateway routes should log their next hop" );
+  } else {
+    expect( Log::count( LogLevel::DEBUG ) == before, "compiled-out levels should not be logged" );
+  }
+}
+
+void test_concurrent_writers()
+{
+  Log::set_stderr_level( LogLevel::OFF );
+  const uint64_t before = Log::count( LogLevel::WARN );
+  const uint64_t dropped_before = Log::dropped();
+
+  constexpr int threads = 4;
+  constexpr int per_thread = 2 * Log::RING_CAPACITY;
+  vector<thread> writers;
+  for ( int t = 0; t < threads; t++ ) {
+    writers.emplace_back( [t] {
+      for ( int i = 0; i < per_thread; i++ ) {
+        LOG_WARN( "writer ", t, " record ", i );
+      }
+    } );
+  }
+  for ( auto& writer : writers ) {
+    writer.join();
+  }
+  Log::set_stderr_level( LogLevel::WARN );
+
+  expect( Log::count( LogLevel::WARN ) == before + threads * per_thread, "every record should be counted" );
+  // (a record dropped because a preempted writer still held its slot leaves a gap)
+  const uint64_t dropped = Log::dropped() - dropped_before;
+  const auto records = Log::recent();
+  expect( records.size() + dropped >= Log::RING_CAPACITY, "the ring should hold its capacity once wrapped" );
+  for ( size_t i = 0; i < records.size(); i++ ) {
+    expect( i == 0 or records[i].sequence > records[i - 1].sequence, "records should be in order" );
+    const string_view text = records[i].text;
+    const size_t record = text.find( " record " );
+    expect( text.starts_with( "writer " ) and record != string_view::npos and record + 8 < text.size()
+              and text.find_first_not_of( "0123456789", record + 8 ) == string_view::npos,
+            "records should be intact" );
+  }
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    test_line_formatting();
+    test_router_logs_to_ring();
+    test_concurrent_writers();
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,133 @@
+#include "arp_message.hh"
+#include "common.hh"
+#include "router.hh"
+
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+constexpr size_t NUM_INTERFACES = 8;
+
+EthernetAddress router_mac( size_t i )
+{
+  return { 0x02, 0, 0, 0, 0, static_cast<uint8_t>( i ) };
+}
+
+EthernetAddress host_mac( size_t i, uint32_t host )
+{
+  return { 0x02, 0, 0, 1, static_cast<uint8_t>( i ), static_cast<uint8_t>( host ) };
+}
+
+// 10.0.i.host
+uint32_t host_ip( size_t i, uint32_t host )
+{
+  return 0x0A'00'00'00 | static_cast<uint32_t>( i ) << 8 | host;
+}
+
+// Interface i is on 10.0.i.0/24, with the router at 10.0.i.1; 10.0.i.128/25 is behind a gateway at 10.0.i.2
+Router make_router()
+{
+  Router router;
+  for ( size_t i = 0; i < NUM_INTERFACES; i++ ) {
+    router.add_interface( AsyncNetworkInterface { router_mac( i ), Address::from_ipv4_numeric( host_ip( i, 1 ) ) } );
+    router.add_route( host_ip( i, 0 ), 24, {}, i );
+    router.add_route( host_ip( i, 128 ), 25, Address::from_ipv4_numeric( host_ip( i, 2 ) ), i );
+  }
+  return router;
+}
+
+string wire( const EthernetFrame& frame )
+{
+  string out;
+  for ( const auto& piece : serialize( frame ) ) {
+    out.append( piece );
+  }
+  return out;
+}
+
+vector<string> drain( Router& router )
+{
+  vector<string> sent;
+  for ( size_t i = 0; i < NUM_INTERFACES; i++ ) {
+    for ( auto frame = router.interface( i ).maybe_send(); frame.has_value(); frame = router.interface( i ).maybe_send() ) {
+      sent.push_back( to_string( i ) + ":" + wire( *frame ) );
+    }
+  }
+  return sent;
+}
+
+// route_parallel() must send exactly the same frames, in the same order, as route()
+void test_matches_single_threaded()
+{
+  Router serial = make_router();
+  Router parallel = make_router();
+
+  mt19937 rng { 458 };
+
+  // Each interface already knows some of its neighbors
+  for ( size_t i = 0; i < NUM_INTERFACES; i++ ) {
+    for ( uint32_t host = 2; host < 10; host++ ) {
+      ARPMessage arp;
+      arp.opcode = ARPMessage::OPCODE_REPLY;
+      arp.sender_ethernet_address = host_mac( i, host );
+      arp.sender_ip_address = host_ip( i, host );
+      arp.target_ethernet_address = router_mac( i );
+      arp.target_ip_address = host_ip( i, 1 );
+
+      EthernetFrame frame;
+      frame.header = { router_mac( i ), host_mac( i, host ), EthernetHeader::TYPE_ARP };
+      frame.payload = serialize( arp );
+      serial.interface( i ).recv_frame( frame );
+      parallel.interface( i ).recv_frame( frame );
+    }
+  }
+
+  for ( int round = 0; round < 20; round++ ) {
+    for ( size_t i = 0; i < NUM_INTERFACES; i++ ) {
+      const size_t count = rng() % 50;
+      for ( size_t n = 0; n < count; n++ ) {
+        InternetDatagram dgram;
+        dgram.header.src = host_ip( i, 3 );
+        dgram.header.dst = host_ip( rng() % ( NUM_INTERFACES + 1 ), rng() % 256 ); // some have no route
+        dgram.header.ttl = rng() % 4;                                               // some expire
+        dgram.header.id = rng();
+        dgram.payload.emplace_back( string( rng() % 200, 'x' ) );
+        dgram.header.len = IPv4Header::LENGTH + dgram.payload.front().size();
+        dgram.header.compute_checksum();
+
+        EthernetFrame frame;
+        frame.header = { router_mac( i ), host_mac( i, 3 ), EthernetHeader::TYPE_IPv4 };
+        frame.payload = serialize( dgram );
+        serial.interface( i ).recv_frame( frame );
+        parallel.interface( i ).recv_frame( frame );
+      }
+    }
+
+    serial.route();
+    parallel.route_parallel( 1 + round % 5 );
+
+    expect( drain( serial ) == drain( parallel ),
+            "route_parallel() sent different frames from route() in round " + to_string( round ) );
+  }
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    test_matches_single_threaded();
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
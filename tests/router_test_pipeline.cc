@@ -0,0 +1,137 @@
+#include "common.hh"
+#include "forwarding_pipeline.hh"
+#include "ipv4_datagram.hh"
+#include "ipv4_view.hh"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+IPv4View make_view( const uint32_t dst, const uint8_t ttl )
+{
+  InternetDatagram dgram;
+  dgram.header.src = 0x0a00'0001;
+  dgram.header.dst = dst;
+  dgram.header.ttl = ttl;
+  dgram.header.len = IPv4Header::LENGTH;
+  dgram.header.compute_checksum();
+  return IPv4View::of( dgram );
+}
+
+// Hands out its datagrams, up to max_views at a time
+struct VectorSource
+{
+  vector<IPv4View> views {};
+  size_t next = 0;
+
+  size_t maybe_receive_views( vector<IPv4View>& out, const size_t max_views )
+  {
+    const size_t count = min( max_views, views.size() - next );
+    for ( size_t k = 0; k < count; k++ ) {
+      out.push_back( std::move( views[next++] ) );
+    }
+    return count;
+  }
+};
+
+// The route of a datagram is the last byte of its destination
+struct LastByteLookup
+{
+  vector<size_t>* burst_sizes;
+
+  void lookup( const span<const IPv4View> datagrams, const span<uint32_t> routes )
+  {
+    burst_sizes->push_back( datagrams.size() );
+    for ( size_t k = 0; k < datagrams.size(); k++ ) {
+      routes[k] = datagrams[k].dst() & 0xff;
+    }
+  }
+};
+
+// Lets only datagrams with an even TTL through
+struct EvenTtlFilter
+{
+  static bool permits( const IPv4View& datagram ) { return datagram.ttl() % 2 == 0; }
+};
+
+// Keeps the route of each datagram it is given
+struct RecordingScheduler
+{
+  vector<uint32_t>* routes;
+
+  void forward( IPv4View& /* datagram */, const uint32_t route ) { routes->push_back( route ); }
+};
+
+static_assert( DatagramSource<VectorSource> );
+static_assert( ForwardingLookup<LastByteLookup> );
+static_assert( ForwardingFilter<EvenTtlFilter> and ForwardingFilter<PermitAll> );
+static_assert( ForwardingScheduler<RecordingScheduler> );
+static_assert( not ForwardingFilter<RecordingScheduler> );
+
+// A filter with nothing to do takes no room in the pipeline
+static_assert( sizeof( ForwardingPipeline<LastByteLookup, PermitAll, RecordingScheduler> )
+               == sizeof( LastByteLookup ) + sizeof( RecordingScheduler ) );
+
+// Every datagram is taken, a burst at a time, looked up and, if the filter permits it, forwarded in order
+void test_stages()
+{
+  VectorSource source;
+  for ( uint32_t i = 0; i < 10; i++ ) {
+    source.views.push_back( make_view( 0xc0a8'0000 + i, static_cast<uint8_t>( 64 + i ) ) );
+  }
+
+  vector<size_t> burst_sizes;
+  vector<uint32_t> forwarded;
+  ForwardingPipeline pipeline { LastByteLookup { &burst_sizes }, EvenTtlFilter {}, RecordingScheduler { &forwarded } };
+
+  vector<IPv4View> datagrams;
+  vector<uint32_t> routes;
+  expect( pipeline.drain( source, datagrams, routes, 3 ) == 10, "every datagram should be taken" );
+  expect( burst_sizes == vector<size_t> { 3, 3, 3, 1 }, "datagrams should be looked up a burst at a time" );
+  expect( forwarded == vector<uint32_t> { 0, 2, 4, 6, 8 }, "only permitted datagrams should be forwarded, in order" );
+
+  expect( pipeline.drain( source, datagrams, routes, 3 ) == 0, "a drained source should give nothing more" );
+  expect( burst_sizes.size() == 4, "an empty source should not be looked up" );
+}
+
+// Without a filter, everything is forwarded
+void test_permit_all()
+{
+  VectorSource source;
+  for ( uint32_t i = 0; i < 5; i++ ) {
+    source.views.push_back( make_view( 0xc0a8'0010 + i, 63 ) );
+  }
+
+  vector<size_t> burst_sizes;
+  vector<uint32_t> forwarded;
+  ForwardingPipeline pipeline { LastByteLookup { &burst_sizes }, PermitAll {}, RecordingScheduler { &forwarded } };
+
+  vector<IPv4View> datagrams;
+  vector<uint32_t> routes;
+  expect( pipeline.drain( source, datagrams, routes, 32 ) == 5, "every datagram should be taken" );
+  expect( burst_sizes == vector<size_t> { 5 }, "a short source should fit in one burst" );
+  expect( forwarded == vector<uint32_t> { 0x10, 0x11, 0x12, 0x13, 0x14 }, "every datagram should be forwarded" );
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    test_stages();
+    test_permit_all();
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,192 @@
+#include "arp_message.hh"
+#include "common.hh"
+#include "rcu.hh"
+#include "router.hh"
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+// Readers must always see a complete version, never a half-updated or freed one
+void test_rcu_snapshots()
+{
+  Rcu<vector<uint64_t>> cell { vector<uint64_t>( 64, 0 ) };
+  atomic<bool> done { false };
+  atomic<uint64_t> reads { 0 };
+
+  vector<jthread> readers;
+  for ( int r = 0; r < 3; r++ ) {
+    readers.emplace_back( [&] {
+      while ( not done ) {
+        const auto version = cell.read();
+        for ( const uint64_t value : *version ) {
+          expect( value == version->front(), "reader saw a partially updated version" );
+        }
+        reads++;
+      }
+    } );
+  }
+
+  // keep updating until the readers have overlapped with a good number of updates
+  uint64_t last = 0;
+  for ( uint64_t v = 1; v <= 2000 or reads < 1000; v++ ) {
+    last = v;
+    expect( cell.update( [v]( vector<uint64_t>& next ) {
+      next.assign( next.size(), v );
+      return true;
+    } ),
+            "update should publish" );
+  }
+  expect( not cell.update( []( vector<uint64_t>& ) { return false; } ), "a no-op update should not publish" );
+  done = true;
+  readers.clear();
+
+  expect( cell.read()->front() == last, "the last update should be visible" );
+}
+
+// Writers publishing back to back while short-lived readers come and go: a reader that loads
+// the epoch just before one flip and registers after it must still hold back the writer that
+// frees its version (the sanitized build reports any version read after it was freed)
+void test_rcu_back_to_back_writers()
+{
+  Rcu<vector<uint64_t>> cell { vector<uint64_t>( 16, 0 ) };
+  atomic<bool> done { false };
+  atomic<uint64_t> reads { 0 };
+
+  vector<jthread> readers;
+  for ( int r = 0; r < 4; r++ ) {
+    readers.emplace_back( [&] {
+      while ( not done ) {
+        const auto version = cell.read();
+        const uint64_t first = version->front();
+        this_thread::yield();
+        for ( const uint64_t value : *version ) {
+          expect( value == first, "reader saw a changed or freed version" );
+        }
+        reads++;
+      }
+    } );
+  }
+
+  atomic<uint64_t> updates { 0 };
+  vector<jthread> writers;
+  for ( int w = 0; w < 2; w++ ) {
+    writers.emplace_back( [&] {
+      while ( updates < 20'000 or reads < 20'000 ) {
+        const uint64_t v = ++updates;
+        cell.update( [v]( vector<uint64_t>& next ) {
+          next.assign( next.size(), v );
+          return true;
+        } );
+      }
+    } );
+  }
+  writers.clear();
+  done = true;
+  readers.clear();
+
+  const auto last = cell.read();
+  for ( const uint64_t value : *last ) {
+    expect( value == last->front(), "the last version should be complete" );
+  }
+}
+
+// Index of the only interface that sent something (an ARP request for the next hop), or -1.
+// Time is then moved past the ARP request timeout, so that the next datagram to the same
+// destination triggers a new request.
+int sending_interface( Router& router, size_t num_interfaces )
+{
+  int sender = -1;
+  for ( size_t i = 0; i < num_interfaces; i++ ) {
+    while ( router.interface( i ).maybe_send().has_value() ) {
+      expect( sender == -1 or sender == static_cast<int>( i ), "datagram was sent on two interfaces" );
+      sender = static_cast<int>( i );
+    }
+    router.interface( i ).tick( 10'000 );
+  }
+  return sender;
+}
+
+void send_through( Router& router, uint32_t dst )
+{
+  InternetDatagram dgram;
+  dgram.header.dst = dst;
+  dgram.header.ttl = 64;
+  dgram.header.compute_checksum();
+
+  EthernetFrame frame;
+  frame.header = { { 0x02, 0, 0, 0, 0, 0 }, { 0x02, 0, 0, 0, 1, 0 }, EthernetHeader::TYPE_IPv4 };
+  frame.payload = serialize( dgram );
+  router.interface( 0 ).recv_frame( frame );
+  router.route();
+}
+
+void test_remove_and_replace()
+{
+  Router router;
+  for ( uint8_t i = 0; i < 3; i++ ) {
+    router.add_interface(
+      AsyncNetworkInterface { { 0x02, 0, 0, 0, 0, i }, Address::from_ipv4_numeric( 0x0A'00'00'01 + i ) } );
+  }
+
+  const uint32_t dst = 0xC0'A8'01'05; // 192.168.1.5
+  router.add_route( 0xC0'A8'00'00, 16, {}, 1 );
+  send_through( router, dst );
+  expect( sending_interface( router, 3 ) == 1, "the /16 route should be used" );
+
+  router.replace_route( 0xC0'A8'00'00, 16, {}, 2 );
+  send_through( router, dst );
+  expect( sending_interface( router, 3 ) == 2, "the replaced route should be used" );
+
+  router.add_route( 0xC0'A8'01'00, 24, {}, 0 );
+  send_through( router, dst );
+  expect( sending_interface( router, 3 ) == 0, "the more specific route should win" );
+
+  expect( router.remove_route( 0xC0'A8'01'00, 24 ), "removing an existing route should succeed" );
+  expect( not router.remove_route( 0xC0'A8'01'00, 24 ), "removing a missing route should fail" );
+  send_through( router, dst );
+  expect( sending_interface( router, 3 ) == 2, "traffic should fall back to the /16" );
+
+  expect( router.remove_route( 0xC0'A8'00'00, 16 ), "removing the /16 should succeed" );
+  send_through( router, dst );
+  expect( sending_interface( router, 3 ) == -1, "with no route the datagram should be dropped" );
+
+  // a withdrawn prefix can be added again
+  router.add_route( 0xC0'A8'00'00, 16, {}, 1 );
+  send_through( router, dst );
+  expect( sending_interface( router, 3 ) == 1, "the re-added route should be used" );
+
+  // every route change invalidated the cache, so each of the sends above was a miss
+  expect( router.destination_cache_stats().hits == 0, "a changed FIB should not hit stale entries" );
+  expect( router.destination_cache_stats().misses == 6, "each send after a change should miss" );
+
+  for ( int i = 0; i < 10; i++ ) {
+    send_through( router, dst );
+    sending_interface( router, 3 );
+  }
+  expect( router.destination_cache_stats().hits == 10, "repeated destinations should hit the cache" );
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    test_rcu_snapshots();
+    test_rcu_back_to_back_writers();
+    test_remove_and_replace();
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
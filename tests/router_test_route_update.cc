@@ -0,0 +1,143 @@
+#include "common.hh"
+#include "left_right.hh"
+#include "router.hh"
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+// Readers must always see a complete copy, never one that is being changed; and both copies
+// must end up with every change
+void test_left_right()
+{
+  LeftRight<vector<uint64_t>> cell { vector<uint64_t>( 64, 0 ) };
+  atomic<bool> done { false };
+  atomic<uint64_t> reads { 0 };
+
+  vector<jthread> readers;
+  for ( int r = 0; r < 3; r++ ) {
+    readers.emplace_back( [&] {
+      while ( not done ) {
+        const auto version = cell.read();
+        for ( const uint64_t value : *version ) {
+          expect( value == version->front(), "reader saw a copy being changed" );
+        }
+        reads++;
+      }
+    } );
+  }
+
+  // each update adds one to every element, so a copy that missed one would be left behind
+  uint64_t updates = 0;
+  while ( updates < 200 or reads < 100 ) {
+    expect( cell.update( []( vector<uint64_t>& copy ) {
+      for ( uint64_t& value : copy ) {
+        value++;
+      }
+      return true;
+    } ),
+            "update should publish" );
+    updates++;
+  }
+  expect( not cell.update( []( vector<uint64_t>& ) { return false; } ), "a no-op update should not publish" );
+  done = true;
+  readers.clear();
+
+  expect( cell.read()->front() == updates, "the last update should be visible" );
+  cell.update( []( vector<uint64_t>& copy ) { return copy.front() != 0; } ); // (switches copies)
+  expect( cell.read()->front() == updates and cell.read()->back() == updates, "both copies should be up to date" );
+
+  cell.replace( []( const vector<uint64_t>& current ) { return vector<uint64_t>( 8, current.front() + 1 ); } );
+  cell.update( []( vector<uint64_t>& ) { return true; } );
+  expect( cell.read()->size() == 8 and cell.read()->front() == updates + 1, "replace() should reach both copies" );
+}
+
+// The interface a datagram to `dst` is routed out of (it sends an ARP request), or -1
+int route_of( Router& router, const uint32_t dst )
+{
+  InternetDatagram dgram;
+  dgram.header.dst = dst;
+  dgram.header.ttl = 64;
+  dgram.header.compute_checksum();
+  EthernetFrame frame;
+  frame.header = { { 0x02, 0, 0, 0, 0, 0 }, { 0x02, 0, 0, 0, 1, 0 }, EthernetHeader::TYPE_IPv4 };
+  frame.payload = serialize( dgram );
+  router.interface( 0 ).recv_frame( frame );
+  router.route();
+
+  int sender = -1;
+  for ( size_t i = 0; i < 3; i++ ) {
+    while ( router.interface( i ).maybe_send().has_value() ) {
+      sender = static_cast<int>( i );
+    }
+    router.interface( i ).tick( 10'000 ); // (so that the next datagram asks again)
+  }
+  return sender;
+}
+
+void test_route_update()
+{
+  using Kind = Router::RouteChange::Kind;
+
+  Router router;
+  for ( uint8_t i = 0; i < 3; i++ ) {
+    router.add_interface(
+      AsyncNetworkInterface { { 0x02, 0, 0, 0, 0, i }, Address::from_ipv4_numeric( 0x0A'00'00'01 + i ) } );
+  }
+  router.add_route( 0xC0'A8'00'00, 16, {}, 1 ); // 192.168.0.0/16
+  router.add_route( 0xAC'10'00'00, 12, {}, 1 ); // 172.16.0.0/12
+
+  Router::RouteUpdate update = router.begin_update();
+  const vector<Router::RouteChange> diff {
+    { Kind::ADD, 0xC0'A8'00'00, 16, {}, 2 },                // already routed: ignored
+    { Kind::REPLACE, 0xAC'10'00'00, 12, 0x0A'00'00'09, 2 }, // new next hop
+    { Kind::ADD, 0x0A'01'00'00, 16, {}, 2 },                // new
+    { Kind::WITHDRAW, 0xC0'A8'00'00, 16 },
+    { Kind::WITHDRAW, 0x0B'00'00'00, 8 }, // not routed: ignored
+  };
+  update.apply( diff );
+  expect( update.size() == diff.size(), "apply() should add to the batch" );
+  expect( route_of( router, 0xC0'A8'01'05 ) == 1, "nothing should change before commit()" );
+
+  expect( update.commit() == 3, "commit() should count the changes that took effect" );
+  expect( update.size() == 0, "commit() should empty the batch" );
+  expect( route_of( router, 0xC0'A8'01'05 ) == -1, "the withdrawn route should be gone" );
+  expect( route_of( router, 0xAC'10'05'05 ) == 2, "the replaced route should use its new next hop" );
+  expect( route_of( router, 0x0A'01'00'05 ) == 2, "the added route should be used" );
+
+  // later changes to a prefix override earlier ones in the same batch
+  update.apply( vector<Router::RouteChange> { { Kind::ADD, 0xC0'A8'00'00, 16, {}, 1 },
+                                              { Kind::WITHDRAW, 0xC0'A8'00'00, 16 },
+                                              { Kind::REPLACE, 0xC0'A8'00'00, 16, {}, 2 } } );
+  expect( update.commit() == 3, "every change of the batch should take effect" );
+  expect( route_of( router, 0xC0'A8'01'05 ) == 2, "the last change to a prefix should win" );
+  expect( update.commit() == 0, "an empty batch should change nothing" );
+
+  // single-route changes still reach both copies of the FIB
+  expect( router.remove_route( 0xAC'10'00'00, 12 ), "removing an existing route should succeed" );
+  expect( route_of( router, 0xAC'10'05'05 ) == -1 and route_of( router, 0xAC'10'05'05 ) == -1,
+          "a removed route should stay removed" );
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    test_left_right();
+    test_route_update();
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
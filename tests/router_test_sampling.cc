@@ -0,0 +1,135 @@
+#include "common.hh"
+#include "packet_sampler.hh"
+#include "router.hh"
+
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+// The countdown samples 1 in N on average, and never while off
+void test_countdown()
+{
+  SampleCountdown off;
+  for ( int i = 0; i < 100000; i++ ) {
+    expect( not off.due(), "a countdown that is off should sample nothing" );
+  }
+
+  SampleCountdown every;
+  every.reset( 1, 7 );
+  for ( int i = 0; i < 1000; i++ ) {
+    expect( every.due(), "a rate of 1 should sample everything" );
+  }
+
+  SampleCountdown countdown;
+  countdown.reset( 100, 12345 );
+  size_t sampled = 0;
+  for ( int i = 0; i < 1'000'000; i++ ) {
+    sampled += countdown.due() ? 1 : 0;
+  }
+  expect( sampled > 9500 and sampled < 10500, "1 in 100 should be sampled, on average" );
+}
+
+InternetDatagram make_datagram( const uint32_t dst, const string& payload )
+{
+  InternetDatagram dgram;
+  dgram.header.src = 0x0A'00'00'05;
+  dgram.header.dst = dst;
+  dgram.header.proto = IPv4Header::PROTO_UDP;
+  dgram.header.ttl = 64;
+  dgram.header.len = IPv4Header::LENGTH + payload.size();
+  dgram.header.compute_checksum();
+  dgram.payload.emplace_back( payload );
+  return dgram;
+}
+
+// Sampled datagrams reach the exporter, with how they were routed
+void test_router( const size_t num_workers )
+{
+  Router router;
+  router.add_interface( AsyncNetworkInterface { { 0x02, 0, 0, 0, 0, 1 }, Address( "10.0.0.1", 0 ) } );
+  router.add_route( 0xC0'A8'00'00, 16, {}, 1 );
+
+  mutex samples_mutex;
+  vector<PacketSample> samples;
+  router.start_sampling( 1, [&]( span<const PacketSample> batch ) {
+    expect( batch.size() <= PacketSampler::EXPORT_BATCH, "batches should be bounded" );
+    const lock_guard lock { samples_mutex };
+    samples.insert( samples.end(), batch.begin(), batch.end() );
+  } );
+  // (an interface added while sampling gets a source too)
+  router.add_interface( AsyncNetworkInterface { { 0x02, 0, 0, 0, 0, 2 }, Address( "192.168.0.1", 0 ) } );
+
+  const string payload( 200, 'x' );
+  for ( uint32_t n = 0; n < 10; n++ ) {
+    EthernetFrame frame;
+    frame.header = { { 0x02, 0, 0, 0, 0, 1 }, { 0x02, 0, 0, 0, 0, 5 }, EthernetHeader::TYPE_IPv4 };
+    frame.payload = serialize( make_datagram( 0xC0'A8'00'01 + n, payload ) );
+    router.interface( 0 ).recv_frame( frame );
+  }
+  router.route_parallel( num_workers );
+
+  const PacketSampler::Stats stats = router.stop_sampling();
+  expect( stats.sampled == 10 and stats.dropped == 0 and stats.exported == 10, "every datagram should be sampled" );
+  expect( router.sampling_stats().sampled == 0, "stopping should reset the counts" );
+
+  expect( samples.size() == 10, "every sample should be exported before stopping" );
+  for ( uint32_t n = 0; n < 10; n++ ) {
+    const PacketSample& sample = samples[n];
+    expect( sample.in_interface == 0 and sample.out_interface == 1, "a sample should have its interfaces" );
+    expect( sample.prefix == 0xC0'A8'00'00 and sample.prefix_length == 16, "a sample should have its route" );
+    expect( sample.length == IPv4Header::LENGTH + payload.size(), "a sample should have its length" );
+    expect( sample.captured == PacketSample::HEADER_BYTES, "a sample should have the start of the datagram" );
+    // (as forwarded: the TTL has been decremented)
+    expect( sample.header[8] == 63, "a sample should have the forwarded header" );
+    expect( codec::load<uint32_t>( sample.header.data() + 16 ) == 0xC0'A8'00'01 + n, "a sample should be in order" );
+    expect( sample.header[IPv4Header::LENGTH] == 'x', "a sample should have the payload" );
+  }
+
+  // once stopped, nothing is sampled
+  EthernetFrame frame;
+  frame.header = { { 0x02, 0, 0, 0, 0, 1 }, { 0x02, 0, 0, 0, 0, 5 }, EthernetHeader::TYPE_IPv4 };
+  frame.payload = serialize( make_datagram( 0xC0'A8'00'01, payload ) );
+  router.interface( 0 ).recv_frame( frame );
+  router.route();
+  expect( samples.size() == 10, "nothing should be sampled once stopped" );
+}
+
+// A full ring drops samples (and counts them), rather than blocking routing
+void test_full_ring()
+{
+  mutex gate;
+  gate.lock();
+  PacketSampler sampler { 1, 4, [&]( span<const PacketSample> ) { const lock_guard lock { gate }; } };
+  for ( int i = 0; i < 100; i++ ) {
+    sampler.submit( 0, PacketSample {} );
+  }
+  gate.unlock();
+  sampler.stop();
+  const PacketSampler::Stats stats = sampler.stats();
+  expect( stats.sampled == 100 and stats.dropped > 0 and stats.dropped + stats.exported == 100,
+          "a full ring should drop samples" );
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    test_countdown();
+    test_router( 1 );
+    test_router( 2 );
+    test_full_ring();
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,273 @@
+#include "arp_message.hh"
+#include "common.hh"
+#include "neighbor_snapshot.hh"
+#include "router.hh"
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+constexpr size_t NUM_INTERFACES = 4;
+
+Router make_router()
+{
+  Router router;
+  for ( uint8_t i = 0; i < NUM_INTERFACES; i++ ) {
+    router.add_interface(
+      AsyncNetworkInterface { { 0x02, 0, 0, 0, 0, i }, Address::from_ipv4_numeric( 0x0A'00'00'01 + i ) } );
+  }
+  return router;
+}
+
+// Everything the router sends for a datagram to `dst`, as "interface:frame bytes" lines
+string forward( Router& router, uint32_t dst )
+{
+  InternetDatagram dgram;
+  dgram.header.dst = dst;
+  dgram.header.ttl = 64;
+  dgram.header.compute_checksum();
+  EthernetFrame frame;
+  frame.header = { { 0x02, 0, 0, 0, 0, 0 }, { 0x02, 0, 0, 0, 1, 0 }, EthernetHeader::TYPE_IPv4 };
+  frame.payload = serialize( dgram );
+  router.interface( 0 ).recv_frame( frame );
+  router.route();
+
+  string out;
+  for ( size_t i = 0; i < NUM_INTERFACES; i++ ) {
+    while ( auto sent = router.interface( i ).maybe_send() ) {
+      out += to_string( i ) + ":";
+      for ( const auto& piece : serialize( *sent ) ) {
+        out.append( piece );
+      }
+      out += "\n";
+    }
+  }
+  return out;
+}
+
+// Contents of a file
+string read_file( const string& path )
+{
+  ifstream in { path, ios::binary };
+  return { istreambuf_iterator<char> { in }, istreambuf_iterator<char> {} };
+}
+
+void write_file( const string& path, const string& contents )
+{
+  ofstream out { path, ios::binary | ios::trunc };
+  out << contents;
+}
+
+bool load_fails( Router& router, const string& path )
+{
+  try {
+    router.load_fib_snapshot( path );
+  } catch ( const exception& ) {
+    return true;
+  }
+  return false;
+}
+
+// A table with withdrawn routes (free slots), shared next hops and multipath routes
+void fill( Router& router, mt19937& rng )
+{
+  for ( int i = 0; i < 300; i++ ) {
+    const auto length = static_cast<uint8_t>( rng() % 33 );
+    const uint32_t prefix = static_cast<uint32_t>( rng() % 16 ) << 28 | static_cast<uint32_t>( rng() % 4 ) << 20;
+    const optional<Address> next_hop
+      = rng() % 2 ? optional<Address> { Address::from_ipv4_numeric( 0xC0'A8'00'01 + rng() % 8 ) } : nullopt;
+    router.add_route( prefix, length, next_hop, rng() % NUM_INTERFACES );
+    if ( rng() % 4 == 0 ) {
+      router.remove_route( prefix, length );
+    } else if ( rng() % 3 == 0 ) {
+      router.add_path( prefix, length, Address::from_ipv4_numeric( 0xC0'A8'00'11 + rng() % 4 ), rng() % NUM_INTERFACES );
+    }
+  }
+}
+
+// A saved table, loaded into another router (with or without its trie), routes like the original
+void test_round_trip( const string& path )
+{
+  mt19937 rng { 458 };
+  for ( const bool include_trie : { true, false } ) {
+    // (a fresh original each time, so that both routers start with the same ARP state)
+    mt19937 table_rng { 458 };
+    Router original = make_router();
+    fill( original, table_rng );
+    original.save_fib_snapshot( path, include_trie );
+
+    Router loaded = make_router();
+    loaded.add_route( 0, 0, Address( "10.0.0.77", 0 ), 3 ); // next hops already interned are kept
+    loaded.load_fib_snapshot( path );
+
+    for ( int i = 0; i < 2000; i++ ) {
+      const uint32_t dst = static_cast<uint32_t>( rng() % 16 ) << 28 | static_cast<uint32_t>( rng() % 8 ) << 20
+                           | static_cast<uint32_t>( rng() & 0xFFFFF );
+      expect( forward( original, dst ) == forward( loaded, dst ), "loaded snapshot should route like the original" );
+    }
+
+    // the usual updates work on a loaded table
+    loaded.replace_route( 0xC0'A8'00'00, 16, {}, 2 );
+    expect( forward( loaded, 0xC0'A8'05'05 ).starts_with( "2:" ), "updates should apply to a loaded table" );
+  }
+
+  // saving the loaded table gives back the same file
+  Router original = make_router();
+  fill( original, rng );
+  original.save_fib_snapshot( path );
+  const string saved = read_file( path );
+  Router loaded = make_router();
+  loaded.load_fib_snapshot( path );
+  loaded.save_fib_snapshot( path );
+  expect( read_file( path ) == saved, "a loaded snapshot should save back to the same bytes" );
+}
+
+// A file that is not a valid snapshot is rejected, and the table is left as it was
+void test_rejects_bad_files( const string& path )
+{
+  Router original = make_router();
+  original.add_route( 0xC0'A8'00'00, 16, Address( "10.0.0.9", 0 ), 1 );
+  original.add_route( 0xC0'A8'01'00, 24, {}, 2 );
+  original.save_fib_snapshot( path );
+  const string good = read_file( path );
+
+  // (a router with no routes, which stays that way)
+  Router router = make_router();
+  const auto expect_rejected = [&]( const string& contents, const string& what ) {
+    write_file( path, contents );
+    expect( load_fails( router, path ), "load should reject " + what );
+    const uint64_t no_route = router.stats().no_route;
+    forward( router, 0xC0'A8'01'01 );
+    expect( router.stats().no_route == no_route + 1, "a rejected load should not change the table" );
+  };
+
+  expect_rejected( "", "an empty file" );
+  expect_rejected( good.substr( 0, good.size() - 1 ), "a truncated file" );
+
+  string bad_magic = good;
+  bad_magic[0] = 'X';
+  expect_rejected( bad_magic, "a bad magic number" );
+
+  string bad_version = good;
+  bad_version[8] = 99;
+  expect_rejected( bad_version, "an unknown version" );
+
+  // the last trie node pointing back at node 1 (which already has a parent)
+  string bad_trie = good;
+  const uint32_t node_one = 1;
+  memcpy( bad_trie.data() + bad_trie.size() - sizeof( RouteTrie::Node ), &node_one, sizeof( node_one ) );
+  expect_rejected( bad_trie, "a malformed trie" );
+
+  // a snapshot that routes through an interface this router does not have
+  Router bigger = make_router();
+  bigger.add_interface( AsyncNetworkInterface { { 0x02, 0, 0, 0, 0, 9 }, Address( "10.0.0.99", 0 ) } );
+  bigger.add_route( 0x0A'00'00'00, 8, {}, NUM_INTERFACES );
+  bigger.save_fib_snapshot( path );
+  expect( load_fails( router, path ), "load should reject a route through a missing interface" );
+
+  expect( load_fails( router, path + ".missing" ), "load should reject a missing file" );
+}
+
+// Neighbors saved by one router are used at once by another, and verified soon after
+void test_neighbors( const string& path )
+{
+  const EthernetAddress neighbor_mac { 0x02, 0, 0, 0, 0, 0x42 };
+  const uint32_t neighbor_ip = 0x0A'00'00'42;
+
+  // (the original learns the neighbor, on interface 1, from an ARP reply)
+  Router original = make_router();
+  ARPMessage reply;
+  reply.opcode = ARPMessage::OPCODE_REPLY;
+  reply.sender_ethernet_address = neighbor_mac;
+  reply.sender_ip_address = neighbor_ip;
+  reply.target_ethernet_address = { 0x02, 0, 0, 0, 0, 1 };
+  reply.target_ip_address = 0x0A'00'00'02;
+  EthernetFrame frame;
+  frame.header = { reply.target_ethernet_address, neighbor_mac, EthernetHeader::TYPE_ARP };
+  frame.payload = serialize( reply );
+  original.interface( 1 ).recv_frame( frame );
+  original.interface( 1 ).tick( 1000 );
+  expect( original.interface( 1 ).neighbors().size() == 1 and original.interface( 1 ).neighbors()[0].ttl == 29000,
+          "the original should know the neighbor" );
+  original.save_neighbor_snapshot( path );
+  const string good = read_file( path );
+
+  Router loaded = make_router();
+  loaded.add_route( 0xC0'A8'00'00, 16, Address::from_ipv4_numeric( neighbor_ip ), 1 );
+  loaded.load_neighbor_snapshot( path );
+  const vector<NetworkInterface::Neighbor> restored = loaded.interface( 1 ).neighbors();
+  expect( restored.size() == 1 and restored[0].ip_address == neighbor_ip and restored[0].ethernet_address == neighbor_mac
+            and restored[0].ttl <= 29000 and restored[0].ttl > 20000,
+          "the neighbor should be restored with the time it had left" );
+  expect( loaded.interface( 1 ).stats().neighbors_restored == 1, "the restore should be counted" );
+
+  // (a datagram goes straight out to it, and the next tick asks the neighbor alone to confirm)
+  string sent = forward( loaded, 0xC0'A8'01'01 );
+  expect( sent.starts_with( "1:" ) and sent.substr( 2, 6 ) == string( neighbor_mac.begin(), neighbor_mac.end() )
+            and loaded.interface( 1 ).stats().arp_requests_sent == 0,
+          "a restored neighbor should be used without ARP" );
+  loaded.interface( 1 ).tick( 1 );
+  const optional<EthernetFrame> refresh = loaded.interface( 1 ).maybe_send();
+  expect( refresh.has_value() and refresh->header.type == EthernetHeader::TYPE_ARP and refresh->header.dst == neighbor_mac
+            and loaded.interface( 1 ).stats().arp_refreshes_sent == 1,
+          "a restored neighbor should be verified by a unicast ARP request" );
+
+  // entries whose time ran out while the router was down are left out (here: saved in 1970)
+  string stale = good;
+  memset( stale.data() + offsetof( NeighborSnapshotHeader, saved_at ), 0, sizeof( uint64_t ) );
+  write_file( path, stale );
+  Router late = make_router();
+  late.load_neighbor_snapshot( path );
+  expect( late.interface( 1 ).neighbors().empty(), "expired neighbors should not be restored" );
+
+  // files that are not snapshots, or of another router, are rejected
+  const auto load_neighbors_fails = [&]( Router& router ) {
+    try {
+      router.load_neighbor_snapshot( path );
+    } catch ( const exception& ) {
+      return true;
+    }
+    return false;
+  };
+  write_file( path, good.substr( 0, good.size() - 8 ) );
+  expect( load_neighbors_fails( late ), "load should reject a truncated neighbor snapshot" );
+  original.save_fib_snapshot( path );
+  expect( load_neighbors_fails( late ), "load should reject a FIB snapshot as a neighbor snapshot" );
+  Router bigger = make_router();
+  bigger.add_interface( AsyncNetworkInterface { { 0x02, 0, 0, 0, 0, 9 }, Address( "10.0.0.99", 0 ) } );
+  bigger.save_neighbor_snapshot( path );
+  expect( load_neighbors_fails( late ), "load should reject a snapshot of a router with other interfaces" );
+  expect( late.interface( 1 ).neighbors().empty(), "a rejected load should restore nothing" );
+}
+
+} // namespace
+
+int main()
+{
+  const string path
+    = ( filesystem::temp_directory_path() / ( "router_test_snapshot." + to_string( getpid() ) ) ).string();
+  int result = EXIT_SUCCESS;
+  try {
+    test_round_trip( path );
+    test_rejects_bad_files( path );
+    test_neighbors( path );
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    result = EXIT_FAILURE;
+  }
+
+  filesystem::remove( path );
+  return result;
+}
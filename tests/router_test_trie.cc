@@ -0,0 +1,117 @@
+#include "common.hh"
+#include "route_trie.hh"
+
+#include <cstdlib>
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+struct Prefix
+{
+  uint32_t prefix;
+  uint8_t length;
+};
+
+// Reference implementation: linear scan, first route wins among equal lengths
+uint32_t naive_lookup( const vector<Prefix>& routes, uint32_t address )
+{
+  uint32_t best = RouteTrie::NO_ROUTE;
+  int best_length = -1;
+  for ( size_t i = 0; i < routes.size(); i++ ) {
+    if ( RouteTrie::mask( address, routes[i].length ) == RouteTrie::mask( routes[i].prefix, routes[i].length )
+         and routes[i].length > best_length ) {
+      best_length = routes[i].length;
+      best = i;
+    }
+  }
+  return best;
+}
+
+void test_basics()
+{
+  RouteTrie trie;
+  expect( trie.lookup( 0x01020304 ) == RouteTrie::NO_ROUTE, "empty trie should miss" );
+
+  // host bits beyond the prefix length are ignored
+  expect( trie.insert( 0x80'1E'4C'FF, 16, 0 ), "insert 128.30.76.255/16" );
+  expect( trie.lookup( 0x80'1E'00'01 ) == 0, "128.30.0.1 should match 128.30.0.0/16" );
+
+  // duplicate prefixes keep the first route
+  expect( not trie.insert( 0x80'1E'00'00, 16, 1 ), "duplicate prefix should be rejected" );
+  expect( trie.lookup( 0x80'1E'00'01 ) == 0, "first route should win" );
+
+  // default route and host route
+  expect( trie.insert( 0, 0, 2 ), "insert default route" );
+  expect( trie.insert( 0x80'1E'00'01, 32, 3 ), "insert host route" );
+  expect( trie.lookup( 0x08'08'08'08 ) == 2, "default route should match anything" );
+  expect( trie.lookup( 0x80'1E'00'01 ) == 3, "host route should be most specific" );
+  expect( trie.lookup( 0x80'1E'00'02 ) == 0, "neighbor of host route should use /16" );
+  expect( trie.size() == 3, "trie should hold three routes" );
+
+  // exact-match find and erase
+  expect( trie.find( 0x80'1E'00'00, 16 ) == 0, "find should return the /16" );
+  expect( trie.find( 0x80'00'00'00, 8 ) == RouteTrie::NO_ROUTE, "find should miss a prefix with no route" );
+  expect( trie.erase( 0x80'1E'00'01, 32 ) == 3, "erase should return the removed route" );
+  expect( trie.erase( 0x80'1E'00'01, 32 ) == RouteTrie::NO_ROUTE, "erasing twice should miss" );
+  expect( trie.lookup( 0x80'1E'00'01 ) == 0, "after erasing the host route, the /16 should match" );
+  expect( trie.insert( 0x80'1E'00'01, 32, 3 ), "an erased prefix can be inserted again" );
+
+  trie.clear();
+  expect( trie.lookup( 0x80'1E'00'01 ) == RouteTrie::NO_ROUTE, "cleared trie should miss" );
+}
+
+void test_against_linear_scan()
+{
+  mt19937 rng { 458 };
+  vector<Prefix> routes;
+  RouteTrie trie;
+
+  for ( uint32_t i = 0; i < 2000; i++ ) {
+    // cluster the prefixes so that many of them overlap
+    const uint32_t prefix = ( rng() & 0x0F'FF'FF'FF ) | 0x0A'00'00'00;
+    const auto length = static_cast<uint8_t>( rng() % 33 );
+    routes.push_back( { prefix, length } );
+    trie.insert( prefix, length, i );
+  }
+
+  vector<uint32_t> addresses;
+  for ( int i = 0; i < 20000; i++ ) {
+    const uint32_t address = ( rng() & 0x0F'FF'FF'FF ) | 0x0A'00'00'00;
+    expect( trie.lookup( address ) == naive_lookup( routes, address ),
+            "trie disagrees with linear scan for address " + to_string( address ) );
+    addresses.push_back( address );
+  }
+
+  // batched lookups agree with single ones, for any burst size
+  for ( size_t begin = 0, size = 1; begin < addresses.size(); begin += size, size = 1 + rng() % 40 ) {
+    const span<const uint32_t> burst = span { addresses }.subspan( begin, min( size, addresses.size() - begin ) );
+    vector<uint32_t> results( burst.size() );
+    trie.lookup_batch( burst, results );
+    for ( size_t i = 0; i < burst.size(); i++ ) {
+      expect( results[i] == trie.lookup( burst[i] ), "lookup_batch disagrees with lookup" );
+    }
+  }
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    test_basics();
+    test_against_linear_scan();
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,226 @@
+#include "alloc_tracker.hh"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <sstream>
+
+#ifdef ALLOCATION_TRACKING
+#include <cxxabi.h>
+#include <dlfcn.h>
+#endif
+
+using namespace std;
+
+#ifdef ALLOCATION_TRACKING
+
+namespace {
+
+// Call sites are hashed into a fixed table (with linear probing); once it is full, any new site
+// is charged to the overflow entry at the end
+constexpr size_t SITE_BITS = 12;
+constexpr size_t SITES = size_t { 1 } << SITE_BITS;
+
+struct SiteCounters
+{
+  atomic<uintptr_t> address { 0 };
+  atomic<uint64_t> allocations { 0 };
+  atomic<uint64_t> bytes { 0 };
+};
+
+array<SiteCounters, SITES + 1> site_table {};
+atomic<uint64_t> total_allocations { 0 };
+atomic<uint64_t> total_bytes { 0 };
+
+SiteCounters& site_of( const uintptr_t address )
+{
+  size_t i = static_cast<size_t>( ( address * 0x9E37'79B9'7F4A'7C15ULL ) >> ( 64 - SITE_BITS ) );
+  for ( size_t probe = 0; probe < SITES; probe++, i = ( i + 1 ) % SITES ) {
+    uintptr_t current = site_table[i].address.load( memory_order_relaxed );
+    if ( current == 0 ) {
+      // (on failure, current is what another thread claimed the entry for)
+      site_table[i].address.compare_exchange_strong( current, address, memory_order_relaxed );
+      current = site_table[i].address.load( memory_order_relaxed );
+    }
+    if ( current == address ) {
+      return site_table[i];
+    }
+  }
+  return site_table[SITES];
+}
+
+void* allocate( size_t size, const size_t alignment, const uintptr_t site )
+{
+  total_allocations.fetch_add( 1, memory_order_relaxed );
+  total_bytes.fetch_add( size, memory_order_relaxed );
+  SiteCounters& counters = site_of( site );
+  counters.allocations.fetch_add( 1, memory_order_relaxed );
+  counters.bytes.fetch_add( size, memory_order_relaxed );
+
+  size = max<size_t>( size, 1 );
+  void* const p = alignment <= alignof( max_align_t )
+                    ? malloc( size )                                                                // NOLINT(*-no-malloc)
+                    : aligned_alloc( alignment, ( size + alignment - 1 ) / alignment * alignment ); // NOLINT(*-no-malloc)
+  if ( p == nullptr ) {
+    throw bad_alloc();
+  }
+  return p;
+}
+
+// "function+0xoffset", "module+0xoffset" (for addr2line), or the bare address
+string symbolize( const uintptr_t address )
+{
+  stringstream ss;
+  Dl_info info {};
+  if ( dladdr( reinterpret_cast<void*>( address ), &info ) == 0 ) { // NOLINT(*-reinterpret-cast)
+    ss << "0x" << hex << address;
+  } else if ( info.dli_sname == nullptr ) {
+    ss << ( info.dli_fname != nullptr ? info.dli_fname : "?" ) << "+0x" << hex
+       << address - reinterpret_cast<uintptr_t>( info.dli_fbase ); // NOLINT(*-reinterpret-cast)
+  } else {
+    int status = 0;
+    char* const demangled = abi::__cxa_demangle( info.dli_sname, nullptr, nullptr, &status );
+    ss << ( status == 0 ? demangled : info.dli_sname ) << "+0x" << hex
+       << address - reinterpret_cast<uintptr_t>( info.dli_saddr ); // NOLINT(*-reinterpret-cast)
+    free( demangled );                                              // NOLINT(*-no-malloc)
+  }
+  return ss.str();
+}
+
+// Prints the report at exit, if asked to by the environment
+struct ExitReport
+{
+  ExitReport() = default;
+  ExitReport( const ExitReport& other ) = delete;
+  ExitReport& operator=( const ExitReport& other ) = delete;
+  ~ExitReport()
+  {
+    if ( getenv( "ALLOC_TRACKER_REPORT" ) != nullptr ) { // NOLINT(*-mt-unsafe)
+      alloc_tracker::report( cerr );
+    }
+  }
+} exit_report;
+
+} // namespace
+
+// Referenced by the instrumented libraries' link options, so that this file (and with it the
+// replacement operator new) is linked into every binary that uses them
+extern "C" void alloc_tracker_linked() {}
+
+// NOLINTBEGIN(*-no-malloc)
+__attribute__( ( noinline ) ) void* operator new( size_t size )
+{
+  return allocate( size, alignof( max_align_t ), reinterpret_cast<uintptr_t>( __builtin_return_address( 0 ) ) );
+}
+__attribute__( ( noinline ) ) void* operator new[]( size_t size )
+{
+  return allocate( size, alignof( max_align_t ), reinterpret_cast<uintptr_t>( __builtin_return_address( 0 ) ) );
+}
+__attribute__( ( noinline ) ) void* operator new( size_t size, align_val_t alignment )
+{
+  return allocate(
+    size, static_cast<size_t>( alignment ), reinterpret_cast<uintptr_t>( __builtin_return_address( 0 ) ) );
+}
+__attribute__( ( noinline ) ) void* operator new[]( size_t size, align_val_t alignment )
+{
+  return allocate(
+    size, static_cast<size_t>( alignment ), reinterpret_cast<uintptr_t>( __builtin_return_address( 0 ) ) );
+}
+void operator delete( void* p ) noexcept
+{
+  free( p );
+}
+void operator delete( void* p, size_t /* size */ ) noexcept
+{
+  free( p );
+}
+void operator delete( void* p, align_val_t /* alignment */ ) noexcept
+{
+  free( p );
+}
+void operator delete( void* p, size_t /* size */, align_val_t /* alignment */ ) noexcept
+{
+  free( p );
+}
+// NOLINTEND(*-no-malloc)
+
+namespace alloc_tracker {
+
+Totals totals()
+{
+  return { total_allocations.load( memory_order_relaxed ), total_bytes.load( memory_order_relaxed ) };
+}
+
+vector<Site> sites()
+{
+  vector<Site> result;
+  for ( size_t i = 0; i <= SITES; i++ ) {
+    const SiteCounters& counters = site_table[i];
+    const uint64_t allocations = counters.allocations.load( memory_order_relaxed );
+    if ( allocations == 0 ) {
+      continue;
+    }
+    result.push_back( { i == SITES ? string( "(other sites)" ) : symbolize( counters.address.load( memory_order_relaxed ) ),
+                        allocations,
+                        counters.bytes.load( memory_order_relaxed ) } );
+  }
+  sort( result.begin(), result.end(), []( const Site& a, const Site& b ) { return a.allocations > b.allocations; } );
+  return result;
+}
+
+void reset()
+{
+  // (the sites keep their entries, so that a concurrent allocation never loses its place)
+  for ( SiteCounters& counters : site_table ) {
+    counters.allocations.store( 0, memory_order_relaxed );
+    counters.bytes.store( 0, memory_order_relaxed );
+  }
+  total_allocations.store( 0, memory_order_relaxed );
+  total_bytes.store( 0, memory_order_relaxed );
+}
+
+} // namespace alloc_tracker
+
+#else
+
+namespace alloc_tracker {
+
+Totals totals()
+{
+  return {};
+}
+
+vector<Site> sites()
+{
+  return {};
+}
+
+void reset() {}
+
+} // namespace alloc_tracker
+
+#endif
+
+namespace alloc_tracker {
+
+void report( ostream& out, const uint64_t per, const size_t max_sites )
+{
+  // (taken before the report allocates anything itself)
+  const Totals total = totals();
+  const vector<Site> top = sites();
+  const auto divided = [per]( const uint64_t value ) { return static_cast<double>( value ) / static_cast<double>( max<uint64_t>( per, 1 ) ); };
+
+  out << fixed << setprecision( 3 ) << "allocations: " << divided( total.allocations ) << " ("
+      << divided( total.bytes ) << " bytes)" << ( per > 1 ? " per item" : "" ) << "\n";
+  for ( size_t i = 0; i < top.size() and i < max_sites; i++ ) {
+    out << "  " << setw( 12 ) << divided( top[i].allocations ) << setw( 14 ) << divided( top[i].bytes ) << " B  "
+        << top[i].name << "\n";
+  }
+  out << defaultfloat;
+}
+
+} // namespace alloc_tracker
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Heap allocation tracking, for the instrumented builds (the *_instrumented libraries).
+//
+// With ALLOCATION_TRACKING defined, the library replaces the global operator new and counts
+// every allocation, and its size, by call site: the code that called operator new, once the
+// compiler has inlined what it can (so a Buffer's allocation is charged to the function that
+// built the Buffer, not to std::make_shared). The counters are a fixed-size table of atomics,
+// so the hook never allocates itself and may be hit from any thread. Without it, nothing is
+// counted, and the functions below report nothing.
+//
+// A process that sets ALLOC_TRACKER_REPORT in its environment prints its top call sites to
+// stderr when it exits (see report()), so any test binary can be profiled as it is.
+
+#ifdef ALLOCATION_TRACKING
+inline constexpr bool ALLOCATION_TRACKING_ENABLED = true;
+#else
+inline constexpr bool ALLOCATION_TRACKING_ENABLED = false;
+#endif
+
+namespace alloc_tracker {
+
+struct Totals
+{
+  uint64_t allocations {};
+  uint64_t bytes {};
+};
+
+// One call site, with what it has allocated
+struct Site
+{
+  std::string name {}; // "function+0xoffset" (or the bare address, if it has no symbol)
+  uint64_t allocations {};
+  uint64_t bytes {};
+};
+
+// Everything allocated so far (since the start, or since reset())
+Totals totals();
+
+// The call sites that have allocated so far, most allocations first
+std::vector<Site> sites();
+
+// Start counting again from zero
+void reset();
+
+// The top `max_sites` call sites, one per line, with their allocations and bytes divided by
+// `per` (e.g. the number of packets handled since reset(), for allocations per packet)
+void report( std::ostream& out, uint64_t per = 1, size_t max_sites = 20 );
+
+} // namespace alloc_tracker
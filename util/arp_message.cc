@@ -1,4 +1,5 @@
 #include "arp_message.hh"
+#include "header_codec.hh"
 
 #include <arpa/inet.h>
 #include <iomanip>
@@ -6,6 +7,21 @@
 
 using namespace std;
 
+namespace {
+
+using Layout = codec::Layout<ARPMessage::LENGTH,
+                             codec::Scalar<&ARPMessage::hardware_type, 0>,
+                             codec::Scalar<&ARPMessage::protocol_type, 2>,
+                             codec::Scalar<&ARPMessage::hardware_address_size, 4>,
+                             codec::Scalar<&ARPMessage::protocol_address_size, 5>,
+                             codec::Scalar<&ARPMessage::opcode, 6>,
+                             codec::Bytes<&ARPMessage::sender_ethernet_address, 8>,
+                             codec::Scalar<&ARPMessage::sender_ip_address, 14>,
+                             codec::Bytes<&ARPMessage::target_ethernet_address, 18>,
+                             codec::Scalar<&ARPMessage::target_ip_address, 24>>;
+
+} // namespace
+
 bool ARPMessage::supported() const
 {
   return hardware_type == TYPE_ETHERNET and protocol_type == EthernetHeader::TYPE_IPv4
@@ -32,28 +48,7 @@ string ARPMessage::to_string() const
 
 void ARPMessage::parse( Parser& parser )
 {
-  parser.integer( hardware_type );
-  parser.integer( protocol_type );
-  parser.integer( hardware_address_size );
-  parser.integer( protocol_address_size );
-  parser.integer( opcode );
-
-  if ( not supported() ) {
-    parser.set_error();
-    return;
-  }
-
-  // read sender addresses (Ethernet and IP)
-  for ( auto& b : sender_ethernet_address ) {
-    parser.integer( b );
-  }
-  parser.integer( sender_ip_address );
-
-  // read target addresses (Ethernet and IP)
-  for ( auto& b : target_ethernet_address ) {
-    parser.integer( b );
-  }
-  parser.integer( target_ip_address );
+  Layout::read( parser, *this, [this]( const uint8_t* ) { return supported(); } );
 }
 
 void ARPMessage::serialize( Serializer& serializer ) const
@@ -62,21 +57,5 @@ void ARPMessage::serialize( Serializer& serializer ) const
     throw runtime_error( "ARPMessage: unsupported field combination (must be Ethernet/IP, and request or reply)" );
   }
 
-  serializer.integer( hardware_type );
-  serializer.integer( protocol_type );
-  serializer.integer( hardware_address_size );
-  serializer.integer( protocol_address_size );
-  serializer.integer( opcode );
-
-  // read sender addresses (Ethernet and IP)
-  for ( const auto& b : sender_ethernet_address ) {
-    serializer.integer( b );
-  }
-  serializer.integer( sender_ip_address );
-
-  // read target addresses (Ethernet and IP)
-  for ( const auto& b : target_ethernet_address ) {
-    serializer.integer( b );
-  }
-  serializer.integer( target_ip_address );
+  Layout::write( serializer, *this );
 }
@@ -1,23 +1,148 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <memory>
 #include <string>
+#include <string_view>
 
+// A reference-counted string, or a slice (offset/length view) of one.
+//
+// Copying a Buffer, or taking a slice of it with substr() or remove_prefix(),
+// shares the backing string instead of copying bytes. A Buffer constructed
+// from a string views all of it (and follows it if it is modified through
+// operator std::string&); a slice is fixed to its range, and is turned into
+// a private copy of that range the first time it is accessed mutably.
+//
+// Strings of up to INLINE_CAPACITY bytes (headers, ARP messages) are instead held inline, with no
+// heap allocation or reference count: copying one copies its bytes. An inline Buffer behaves as
+// a slice of its own bytes, moving to a shared string the first time it is accessed mutably, so
+// the difference only shows in where its bytes are (a copy, or a moved-from Buffer, no longer
+// points at the same bytes).
 class Buffer
 {
-  std::shared_ptr<std::string> buffer_;
+public:
+  static constexpr size_t INLINE_CAPACITY = 64;
+
+private:
+  std::shared_ptr<std::string> buffer_; // null for an inline Buffer
+  size_t offset_ {};
+  size_t length_ { WHOLE };
+  std::array<char, INLINE_CAPACITY> inline_ {};
+
+  // length_ value of a Buffer that views all of its backing string
+  static constexpr size_t WHOLE = std::string::npos;
+
+  bool is_slice() const { return length_ != WHOLE; }
+  bool is_inline() const { return buffer_ == nullptr; }
+
+  // Replace a slice (or an inline Buffer) by a fresh string holding only its bytes
+  void unshare()
+  {
+    if ( is_slice() ) {
+      buffer_ = std::make_shared<std::string>( std::string_view { *this } );
+      offset_ = 0;
+      length_ = WHOLE;
+    }
+  }
+
+  // Hold `bytes` inline (they must fit)
+  void store_inline( const std::string_view bytes )
+  {
+    std::copy( bytes.begin(), bytes.end(), inline_.begin() );
+    length_ = bytes.size();
+  }
 
 public:
   // NOLINTBEGIN(*-explicit-*)
 
-  Buffer( std::string str = {} ) : buffer_( make_shared<std::string>( std::move( str ) ) ) {}
-  operator std::string_view() const { return *buffer_; }
-  operator std::string&() { return *buffer_; }
+  Buffer( std::string str = {} ) : buffer_()
+  {
+    if ( str.size() <= INLINE_CAPACITY ) {
+      store_inline( str );
+    } else {
+      buffer_ = std::make_shared<std::string>( std::move( str ) );
+    }
+  }
+  operator std::string_view() const
+  {
+    if ( is_inline() ) {
+      return { inline_.data() + offset_, length_ };
+    }
+    const std::string_view whole { *buffer_ };
+    return is_slice() ? whole.substr( offset_, length_ ) : whole;
+  }
+  operator std::string&()
+  {
+    unshare();
+    return *buffer_;
+  }
 
   // NOLINTEND(*-explicit-*)
 
-  std::string&& release() { return std::move( *buffer_ ); }
-  size_t size() const { return buffer_->size(); }
-  size_t length() const { return buffer_->length(); }
-  bool empty() const { return buffer_->empty(); }
+  // Adopt an already-shared string (e.g. one from a PacketPool)
+  explicit Buffer( std::shared_ptr<std::string> storage ) : buffer_( std::move( storage ) ) {}
+
+  // A Buffer holding a copy of `bytes`: inline if they fit, so that a caller with a reusable
+  // scratch string (e.g. a Serializer's header region) need allocate nothing for small ones
+  static Buffer copy_of( const std::string_view bytes )
+  {
+    if ( bytes.size() > INLINE_CAPACITY ) {
+      return Buffer { std::make_shared<std::string>( bytes ) };
+    }
+    Buffer ret;
+    ret.store_inline( bytes );
+    return ret;
+  }
+
+  // Whether other Buffers share this one's backing string (so that mutable_data() would copy it)
+  bool shared() const { return not is_inline() and buffer_.use_count() != 1; }
+
+  // The bytes of this Buffer, to be changed in place (e.g. a forwarded header's TTL). They are
+  // written where they are when no other Buffer shares them, even in a slice; otherwise this
+  // Buffer first gets a private copy of them, so that no other Buffer sees the change.
+  char* mutable_data()
+  {
+    if ( is_inline() ) {
+      return inline_.data() + offset_;
+    }
+    if ( buffer_.use_count() != 1 ) {
+      buffer_ = std::make_shared<std::string>( std::string_view { *this } );
+      offset_ = 0;
+      length_ = WHOLE;
+    }
+    return buffer_->data() + offset_;
+  }
+
+  std::string&& release()
+  {
+    unshare();
+    return std::move( *buffer_ );
+  }
+  size_t size() const { return is_slice() ? length_ : buffer_->size(); }
+  size_t length() const { return size(); }
+  bool empty() const { return size() == 0; }
+
+  // A Buffer viewing bytes [pos, pos + n) of this one, sharing its backing string
+  Buffer substr( size_t pos, size_t n = std::string::npos ) const
+  {
+    Buffer ret { *this };
+    ret.remove_prefix( pos );
+    if ( n < ret.size() ) {
+      ret.length_ = n;
+    }
+    return ret;
+  }
+
+  // Drop the first n bytes from the view, without copying
+  void remove_prefix( size_t n )
+  {
+    const size_t len = size();
+    n = std::min( n, len );
+    if ( n == 0 ) {
+      return;
+    }
+    offset_ += n;
+    length_ = len - n;
+  }
 };
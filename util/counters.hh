@@ -0,0 +1,91 @@
+#pragma once
+
+#include "ring_buffer.hh"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// A set of event counters that any thread may bump without sharing a cache line with the others.
+//
+// The counters are split into a few cache-line-aligned shards, and each thread bumps the shard
+// picked by its own thread number, with a relaxed atomic add. Reading a counter sums (or takes
+// the maximum of) its shards, so reads are a little slower and only approximately consistent
+// with each other while writers are running.
+//
+// `Kind` is an enum class whose last enumerator, COUNT, gives the number of counters.
+template<typename Kind>
+class ShardedCounters
+{
+public:
+  static constexpr size_t SHARDS = 8;
+  static constexpr size_t SIZE = static_cast<size_t>( Kind::COUNT );
+
+private:
+  struct alignas( RING_CACHE_LINE ) Shard
+  {
+    std::array<std::atomic<uint64_t>, SIZE> values {};
+  };
+
+  std::array<Shard, SHARDS> shards_ {};
+
+  static size_t shard_index()
+  {
+    static std::atomic<size_t> next_thread { 0 };
+    thread_local const size_t index = next_thread.fetch_add( 1, std::memory_order_relaxed ) % SHARDS;
+    return index;
+  }
+
+  std::atomic<uint64_t>& local( const Kind kind ) { return shards_[shard_index()].values[static_cast<size_t>( kind )]; }
+
+public:
+  ShardedCounters() = default;
+
+  // Copies are snapshots (and only exact while no thread is writing)
+  ShardedCounters( const ShardedCounters& other ) { *this = other; }
+  ShardedCounters& operator=( const ShardedCounters& other )
+  {
+    for ( size_t s = 0; s < SHARDS; s++ ) {
+      for ( size_t i = 0; i < SIZE; i++ ) {
+        shards_[s].values[i].store( other.shards_[s].values[i].load( std::memory_order_relaxed ),
+                                    std::memory_order_relaxed );
+      }
+    }
+    return *this;
+  }
+  ~ShardedCounters() = default;
+
+  // Count `n` events
+  void add( const Kind kind, const uint64_t n = 1 ) { local( kind ).fetch_add( n, std::memory_order_relaxed ); }
+
+  // Record a level, for counters read with max() (e.g. a high-water mark)
+  void raise( const Kind kind, const uint64_t value )
+  {
+    std::atomic<uint64_t>& counter = local( kind );
+    uint64_t current = counter.load( std::memory_order_relaxed );
+    while ( value > current
+            and not counter.compare_exchange_weak( current, value, std::memory_order_relaxed ) ) {}
+  }
+
+  // Events counted by add(), over all threads
+  uint64_t sum( const Kind kind ) const
+  {
+    uint64_t total = 0;
+    for ( const Shard& shard : shards_ ) {
+      total += shard.values[static_cast<size_t>( kind )].load( std::memory_order_relaxed );
+    }
+    return total;
+  }
+
+  // Highest level recorded by raise(), over all threads
+  uint64_t max( const Kind kind ) const
+  {
+    uint64_t highest = 0;
+    for ( const Shard& shard : shards_ ) {
+      const uint64_t value = shard.values[static_cast<size_t>( kind )].load( std::memory_order_relaxed );
+      highest = value > highest ? value : highest;
+    }
+    return highest;
+  }
+};
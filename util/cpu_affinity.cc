@@ -0,0 +1,142 @@
+#include "cpu_affinity.hh"
+#include "exception.hh"
+
+#include <algorithm>
+#include <charconv>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+
+#include <pthread.h>
+#include <sched.h>
+
+using namespace std;
+
+namespace {
+
+// The first line of a sysfs file, or "" if it cannot be read
+string read_line( const string& path )
+{
+  ifstream file { path };
+  string line;
+  getline( file, line );
+  return line;
+}
+
+int parse_int( const string_view text )
+{
+  int value = -1;
+  const auto result = from_chars( text.data(), text.data() + text.size(), value );
+  if ( result.ec != errc {} or result.ptr != text.data() + text.size() ) {
+    throw runtime_error( "bad CPU number: " + string { text } );
+  }
+  return value;
+}
+
+} // namespace
+
+vector<int> parse_cpu_list( string_view list )
+{
+  vector<int> cpus;
+  while ( not list.empty() and list.back() == '\n' ) {
+    list.remove_suffix( 1 );
+  }
+  while ( not list.empty() ) {
+    const size_t comma = list.find( ',' );
+    const string_view range = list.substr( 0, comma );
+    list = comma == string_view::npos ? string_view {} : list.substr( comma + 1 );
+
+    const size_t dash = range.find( '-' );
+    const int first = parse_int( range.substr( 0, dash ) );
+    const int last = dash == string_view::npos ? first : parse_int( range.substr( dash + 1 ) );
+    for ( int cpu = first; cpu <= last; cpu++ ) {
+      cpus.push_back( cpu );
+    }
+  }
+  return cpus;
+}
+
+const vector<int>& allowed_cpus()
+{
+  static const vector<int> cpus = [] {
+    cpu_set_t set;
+    CPU_ZERO( &set );
+    if ( const int error = pthread_getaffinity_np( pthread_self(), sizeof( set ), &set ); error != 0 ) {
+      throw unix_error { "pthread_getaffinity_np", error };
+    }
+    vector<int> allowed;
+    for ( int cpu = 0; cpu < CPU_SETSIZE; cpu++ ) {
+      if ( CPU_ISSET( cpu, &set ) ) {
+        allowed.push_back( cpu );
+      }
+    }
+    return allowed;
+  }();
+  return cpus;
+}
+
+bool cpus_allowed( const span<const int> cpus )
+{
+  const vector<int>& allowed = allowed_cpus();
+  return ranges::all_of( cpus, [&]( const int cpu ) { return ranges::find( allowed, cpu ) != allowed.end(); } );
+}
+
+void pin_current_thread( const span<const int> cpus )
+{
+  cpu_set_t set;
+  CPU_ZERO( &set );
+  for ( const int cpu : cpus.empty() ? span<const int> { allowed_cpus() } : cpus ) {
+    if ( cpu < 0 or cpu >= CPU_SETSIZE ) {
+      throw runtime_error( "no such CPU: " + to_string( cpu ) );
+    }
+    CPU_SET( cpu, &set );
+  }
+  if ( const int error = pthread_setaffinity_np( pthread_self(), sizeof( set ), &set ); error != 0 ) {
+    throw unix_error { "pthread_setaffinity_np", error };
+  }
+}
+
+optional<int> device_numa_node( const string& device )
+{
+  const string node = read_line( "/sys/class/net/" + device + "/device/numa_node" );
+  if ( node.empty() or node.starts_with( '-' ) ) {
+    return {};
+  }
+  return parse_int( node );
+}
+
+vector<int> numa_node_cpus( const int node )
+{
+  return parse_cpu_list( read_line( "/sys/devices/system/node/node" + to_string( node ) + "/cpulist" ) );
+}
+
+vector<int> cpus_near_devices( const span<const string> devices )
+{
+  const vector<int>& allowed = allowed_cpus();
+  if ( allowed.empty() ) {
+    throw runtime_error( "no CPUs allowed" );
+  }
+
+  // (the allowed CPUs of each node, and how many devices have been placed on it so far)
+  map<int, pair<vector<int>, size_t>> nodes;
+  vector<int> cpus;
+  for ( const string& device : devices ) {
+    const int node = device_numa_node( device ).value_or( -1 );
+    auto [it, added] = nodes.try_emplace( node );
+    auto& [near, placed] = it->second;
+    if ( added ) {
+      if ( node >= 0 ) {
+        for ( const int cpu : numa_node_cpus( node ) ) {
+          if ( ranges::find( allowed, cpu ) != allowed.end() ) {
+            near.push_back( cpu );
+          }
+        }
+      }
+      if ( near.empty() ) {
+        near = allowed;
+      }
+    }
+    cpus.push_back( near[placed++ % near.size()] );
+  }
+  return cpus;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Placing threads on cores, and finding the cores near a network device (from sysfs).
+//
+// Memory is placed on the NUMA node of the thread that first writes it (the kernel's default
+// policy, and how huge_pages.hh mappings are placed), so a structure that is built and used by
+// a thread pinned near a device stays on that device's node.
+
+// The CPUs of a list such as "0-3,8,10-11" (the format of the kernel's cpulist files)
+std::vector<int> parse_cpu_list( std::string_view list );
+
+// The CPUs the process may run on: the affinity of the thread that first asks (which is before
+// any thread is pinned by WorkerPool, which asks before it pins)
+const std::vector<int>& allowed_cpus();
+
+// Whether the process may run on every one of `cpus`
+bool cpus_allowed( std::span<const int> cpus );
+
+// Restrict the calling thread to `cpus` (or, if empty, to allowed_cpus()). Throws unix_error on failure
+// (e.g. a CPU that does not exist, or that the process may not use).
+void pin_current_thread( std::span<const int> cpus );
+
+// The NUMA node a network device (e.g. "eth0") is attached to, or none if it is not known (a
+// virtual device, or a machine with a single node)
+std::optional<int> device_numa_node( const std::string& device );
+
+// The CPUs of NUMA node `node` (empty if there is no such node)
+std::vector<int> numa_node_cpus( int node );
+
+// One CPU for each of `devices`, on its NUMA node where that is known (and among the allowed
+// CPUs), spreading the devices on a node over its CPUs. E.g. as Router::set_worker_cpus() with
+// one worker per interface, so that each interface is handled on its NIC's node.
+std::vector<int> cpus_near_devices( std::span<const std::string> devices );
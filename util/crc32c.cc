@@ -0,0 +1,79 @@
+#include "crc32c.hh"
+
+#include <array>
+#include <cstddef>
+
+using namespace std;
+
+namespace {
+
+constexpr uint32_t POLYNOMIAL = 0x82F6'3B78; // reflected
+
+constexpr array<uint32_t, 256> TABLE = [] {
+  array<uint32_t, 256> table {};
+  for ( uint32_t i = 0; i < table.size(); i++ ) {
+    uint32_t crc = i;
+    for ( int bit = 0; bit < 8; bit++ ) {
+      crc = ( crc >> 1 ) ^ ( ( crc & 1 ) ? POLYNOMIAL : 0 );
+    }
+    table[i] = crc;
+  }
+  return table;
+}();
+
+uint32_t software_byte( const uint32_t crc, const uint8_t byte )
+{
+  return TABLE[( crc ^ byte ) & 0xff] ^ ( crc >> 8 );
+}
+
+#if defined( __x86_64__ )
+__attribute__( ( target( "sse4.2" ) ) ) uint32_t hardware_word( const uint32_t crc, const uint32_t word )
+{
+  return __builtin_ia32_crc32si( crc, word );
+}
+
+__attribute__( ( target( "sse4.2" ) ) ) uint32_t hardware_byte( const uint32_t crc, const uint8_t byte )
+{
+  return __builtin_ia32_crc32qi( crc, byte );
+}
+
+const bool HAS_CRC32_INSTRUCTION = __builtin_cpu_supports( "sse4.2" );
+#else
+constexpr bool HAS_CRC32_INSTRUCTION = false;
+#endif
+
+} // namespace
+
+uint32_t crc32c_extend( uint32_t crc, const uint32_t word )
+{
+#if defined( __x86_64__ )
+  if ( HAS_CRC32_INSTRUCTION ) {
+    return hardware_word( crc, word );
+  }
+#endif
+  for ( int shift = 0; shift < 32; shift += 8 ) {
+    crc = software_byte( crc, static_cast<uint8_t>( word >> shift ) );
+  }
+  return crc;
+}
+
+uint32_t crc32c( const string_view data )
+{
+  uint32_t crc = ~0U;
+  for ( const char c : data ) {
+    const auto byte = static_cast<uint8_t>( c );
+#if defined( __x86_64__ )
+    if ( HAS_CRC32_INSTRUCTION ) {
+      crc = hardware_byte( crc, byte );
+      continue;
+    }
+#endif
+    crc = software_byte( crc, byte );
+  }
+  return ~crc;
+}
+
+bool crc32c_hardware()
+{
+  return HAS_CRC32_INSTRUCTION;
+}
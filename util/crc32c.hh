@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+// CRC-32C (Castagnoli), e.g. for hashing flows.
+//
+// On x86-64 CPUs with SSE4.2 (checked once, at startup) this uses the crc32 instruction, one per
+// 4-byte word; otherwise a table, one lookup per byte. Both give the same results.
+
+// Extend the CRC register `crc` by the 4 bytes of `word` (least significant first). This is the
+// raw register update, without the initial and final inversion of a complete CRC-32C, for
+// callers that chain a few words into a hash.
+uint32_t crc32c_extend( uint32_t crc, uint32_t word );
+
+// The standard CRC-32C of `data` (crc32c( "123456789" ) == 0xE3069283)
+uint32_t crc32c( std::string_view data );
+
+// Whether crc32c_extend() and crc32c() use the crc32 instruction
+bool crc32c_hardware();
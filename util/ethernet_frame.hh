@@ -19,6 +19,8 @@ struct EthernetFrame
 
   void serialize( Serializer& serializer ) const
   {
+    // the Ethernet header and the (small) headers at the front of the payload share one allocation
+    serializer.reserve( EthernetHeader::LENGTH + Serializer::coalesced_length( payload ) );
     header.serialize( serializer );
     serializer.buffer( payload );
   }
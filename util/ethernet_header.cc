@@ -1,4 +1,5 @@
 #include "ethernet_header.hh"
+#include "header_codec.hh"
 
 #include <iomanip>
 #include <sstream>
@@ -33,6 +34,9 @@ string EthernetHeader::to_string() const
     case TYPE_ARP:
       ss << "ARP";
       break;
+    case TYPE_IPv6:
+      ss << "IPv6";
+      break;
     default:
       ss << "[unknown type " << hex << type << "!]";
       break;
@@ -41,34 +45,21 @@ string EthernetHeader::to_string() const
   return ss.str();
 }
 
-void EthernetHeader::parse( Parser& parser )
-{
-  // read destination address
-  for ( auto& b : dst ) {
-    parser.integer( b );
-  }
+namespace {
 
-  // read source address
-  for ( auto& b : src ) {
-    parser.integer( b );
-  }
+using Layout = codec::Layout<EthernetHeader::LENGTH,
+                             codec::Bytes<&EthernetHeader::dst, 0>,
+                             codec::Bytes<&EthernetHeader::src, 6>,
+                             codec::Scalar<&EthernetHeader::type, 12>>;
+
+} // namespace
 
-  // read frame type (e.g. IPv4, ARP, or something else)
-  parser.integer( type );
+void EthernetHeader::parse( Parser& parser )
+{
+  Layout::read( parser, *this );
 }
 
 void EthernetHeader::serialize( Serializer& serializer ) const
 {
-  // write destination address
-  for ( const auto& b : dst ) {
-    serializer.integer( b );
-  }
-
-  // write source address
-  for ( const auto& b : src ) {
-    serializer.integer( b );
-  }
-
-  // write frame type (e.g. IPv4, ARP, or something else)
-  serializer.integer( type );
+  Layout::write( serializer, *this );
 }
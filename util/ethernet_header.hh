@@ -21,6 +21,9 @@ struct EthernetHeader
   static constexpr size_t LENGTH = 14;         //!< Ethernet header length in bytes
   static constexpr uint16_t TYPE_IPv4 = 0x800; //!< Type number for [IPv4](\ref rfc::rfc791)
   static constexpr uint16_t TYPE_ARP = 0x806;  //!< Type number for [ARP](\ref rfc::rfc826)
+  static constexpr uint16_t TYPE_IPv6 = 0x86DD; //!< Type number for [IPv6](\ref rfc::rfc8200)
+
+  static constexpr uint64_t serialized_length() { return LENGTH; }
 
   EthernetAddress dst;
   EthernetAddress src;
@@ -1,10 +1,10 @@
 #include "file_descriptor.hh"
 
 #include "exception.hh"
+#include "log.hh"
 
 #include <algorithm>
 #include <fcntl.h>
-#include <iostream>
 #include <stdexcept>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -62,7 +62,7 @@ FileDescriptor::FDWrapper::~FDWrapper()
     close();
   } catch ( const exception& e ) {
     // don't throw an exception from the destructor
-    cerr << "Exception destructing FDWrapper: " << e.what() << endl;
+    LOG_ERROR( "Exception destructing FDWrapper: ", e.what() );
   }
 }
 
@@ -180,6 +180,62 @@ size_t FileDescriptor::write( const vector<string_view>& buffers )
   return bytes_written;
 }
 
+void FileDescriptor::append_iovecs( const span<const Buffer> buffers, vector<iovec>& iovecs )
+{
+  for ( const auto& piece : buffers ) {
+    const string_view bytes = piece;
+    iovecs.push_back( { const_cast<char*>( bytes.data() ), bytes.size() } ); // NOLINT(*-const-cast)
+  }
+}
+
+size_t FileDescriptor::write( const span<const Buffer> buffers )
+{
+  // scratch space, kept between calls so that a write does not allocate
+  thread_local vector<iovec> iovecs;
+  iovecs.clear();
+  append_iovecs( buffers, iovecs );
+
+  size_t total_size = 0;
+  for ( const auto& piece : iovecs ) {
+    total_size += piece.iov_len;
+  }
+
+  const ssize_t bytes_written
+    = CheckSystemCall( "writev", ::writev( fd_num(), iovecs.data(), static_cast<int>( iovecs.size() ) ) );
+  register_write();
+
+  if ( bytes_written > static_cast<ssize_t>( total_size ) ) {
+    throw runtime_error( "write wrote more than length of input buffer" );
+  }
+
+  return bytes_written;
+}
+
+size_t FileDescriptor::write_batch( const span<const vector<Buffer>> records )
+{
+  size_t written = 0;
+  for ( const auto& record : records ) {
+    size_t size = 0;
+    for ( const auto& piece : record ) {
+      size += piece.size();
+    }
+    if ( size == 0 ) {
+      written++;
+      continue;
+    }
+
+    const size_t bytes_written = write( record );
+    if ( bytes_written == 0 ) {
+      break;
+    }
+    if ( bytes_written != size ) {
+      throw runtime_error( "write_batch: a record was written in part (not a message-oriented fd?)" );
+    }
+    written++;
+  }
+  return written;
+}
+
 void FileDescriptor::set_blocking( bool blocking )
 {
   int flags = CheckSystemCall( "fcntl", fcntl( fd_num(), F_GETFL ) ); // NOLINT(*-vararg)
@@ -193,3 +249,10 @@ void FileDescriptor::set_blocking( bool blocking )
 
   internal_fd_->non_blocking_ = not blocking;
 }
+
+off_t FileDescriptor::size() const
+{
+  struct stat s {};
+  CheckSystemCall( "fstat", fstat( fd_num(), &s ) );
+  return s.st_size;
+}
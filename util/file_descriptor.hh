@@ -1,8 +1,12 @@
 #pragma once
 
+#include "buffer.hh"
+
 #include <cstddef>
 #include <limits>
 #include <memory>
+#include <span>
+#include <sys/uio.h>
 #include <vector>
 
 // A reference-counted handle to a file descriptor
@@ -54,6 +58,9 @@ protected:
   template<typename T>
   T CheckSystemCall( std::string_view s_attempt, T return_value ) const;
 
+  // Append an iovec for each of `buffers` to `iovecs` (pointing at the buffers' own bytes)
+  static void append_iovecs( std::span<const Buffer> buffers, std::vector<iovec>& iovecs );
+
 public:
   // Construct from a file descriptor number returned by the kernel
   explicit FileDescriptor( int fd );
@@ -70,6 +77,16 @@ public:
   size_t write( std::string_view buffer );
   size_t write( const std::vector<std::string_view>& buffers );
 
+  // Write the pieces of one record (e.g. a frame as returned by serialize()) with one
+  // [writev(2)](\ref man2::writev), straight from their buffers: they are never joined into one
+  // contiguous copy. Returns the number of bytes written (0 if a non-blocking fd is full).
+  size_t write( std::span<const Buffer> buffers );
+
+  // Write each record with a writev(2) of its own, for a message-oriented fd (e.g. a TAP device
+  // or a SOCK_SEQPACKET socket) that takes one record per write, whole or not at all. Stops at
+  // the first record that a non-blocking fd does not take; returns the number written.
+  size_t write_batch( std::span<const std::vector<Buffer>> records );
+
   // Close the underlying file descriptor
   void close() { internal_fd_->close(); }
 
@@ -0,0 +1,253 @@
+#pragma once
+
+#include "parser.hh"
+
+#include <array>
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+
+// Fixed-size header codecs, generated at compile time from a description of the header's layout.
+//
+// A layout lists each field of the header with its offset on the wire, e.g.
+//
+//   using Layout = codec::Layout<EthernetHeader::LENGTH,
+//                                codec::Bytes<&EthernetHeader::dst, 0>,
+//                                codec::Bytes<&EthernetHeader::src, 6>,
+//                                codec::Scalar<&EthernetHeader::type, 12>>;
+//
+// and Layout::decode() / Layout::encode() move the whole header between a struct and its raw
+// bytes with one (unaligned) load or store per field, plus a byte swap where the field's byte order
+// is not the machine's. The layout is checked when it is compiled: every byte of the header must
+// belong to exactly one field.
+namespace codec {
+
+// An integer of byte order `Order`, in this machine's byte order (or the other way round)
+template<std::unsigned_integral T, std::endian Order = std::endian::big>
+constexpr T byteswap_to_native( T value )
+{
+  if constexpr ( Order == std::endian::native or sizeof( T ) == 1 ) {
+    return value;
+  } else if constexpr ( sizeof( T ) == 2 ) {
+    return __builtin_bswap16( value );
+  } else if constexpr ( sizeof( T ) == 4 ) {
+    return __builtin_bswap32( value );
+  } else {
+    static_assert( sizeof( T ) == 8 );
+    return __builtin_bswap64( value );
+  }
+}
+
+// Load or store an integer of byte order `Order` from/to raw bytes (one unaligned access)
+template<std::unsigned_integral T, std::endian Order = std::endian::big>
+T load( const uint8_t* data )
+{
+  T value {};
+  std::memcpy( &value, data, sizeof( T ) );
+  return byteswap_to_native<T, Order>( value );
+}
+
+template<std::unsigned_integral T, std::endian Order = std::endian::big>
+void store( uint8_t* data, const T value )
+{
+  const T wire = byteswap_to_native<T, Order>( value ); // (a byte swap is its own inverse)
+  std::memcpy( data, &wire, sizeof( T ) );
+}
+
+// The struct and type of a data member, from a pointer to it
+template<class M>
+struct member_traits;
+
+template<class C, class T>
+struct member_traits<T C::*>
+{
+  using owner = C;
+  using type = T;
+};
+
+template<auto Member>
+using member_type = typename member_traits<decltype( Member )>::type;
+
+// An integer field, `Order` on the wire
+template<auto Member, size_t Offset, std::endian Order = std::endian::big>
+  requires std::unsigned_integral<member_type<Member>>
+struct Scalar
+{
+  static constexpr size_t OFFSET = Offset;
+  static constexpr size_t WIDTH = sizeof( member_type<Member> );
+
+  template<class H>
+  static void decode( const uint8_t* raw, H& header )
+  {
+    header.*Member = load<member_type<Member>, Order>( raw + Offset );
+  }
+
+  template<class H>
+  static void encode( const H& header, uint8_t* raw )
+  {
+    store<member_type<Member>, Order>( raw + Offset, header.*Member );
+  }
+};
+
+// A field of raw bytes (e.g. an Ethernet address), copied as is
+template<auto Member, size_t Offset>
+struct Bytes
+{
+  static constexpr size_t OFFSET = Offset;
+  static constexpr size_t WIDTH = sizeof( member_type<Member> );
+
+  template<class H>
+  static void decode( const uint8_t* raw, H& header )
+  {
+    std::memcpy( ( header.*Member ).data(), raw + Offset, WIDTH );
+  }
+
+  template<class H>
+  static void encode( const H& header, uint8_t* raw )
+  {
+    std::memcpy( raw + Offset, ( header.*Member ).data(), WIDTH );
+  }
+};
+
+// Part of a packed word: `Width` bits of it, starting `Shift` bits from the least significant
+template<auto Member, unsigned Shift, unsigned Width>
+  requires( Width > 0 and Shift + Width < 64 )
+struct Bits
+{
+  static constexpr unsigned SHIFT = Shift;
+  static constexpr uint64_t MASK = ( uint64_t { 1 } << Width ) - 1;
+
+  template<std::unsigned_integral T, class H>
+  static void decode( const T word, H& header )
+  {
+    header.*Member = static_cast<member_type<Member>>( ( word >> Shift ) & MASK );
+  }
+
+  template<std::unsigned_integral T, class H>
+  static T encode( const H& header )
+  {
+    return static_cast<T>( ( static_cast<uint64_t>( header.*Member ) & MASK ) << Shift );
+  }
+};
+
+// A (big-endian) word of type T, packed from several fields, e.g. IPv4's version and
+// header length, or its flags and fragment offset
+template<std::unsigned_integral T, size_t Offset, class... Parts>
+struct Packed
+{
+  static constexpr size_t OFFSET = Offset;
+  static constexpr size_t WIDTH = sizeof( T );
+
+  // The parts do not overlap, and fit in the word
+  static consteval bool parts_fit()
+  {
+    const std::array<uint64_t, sizeof...( Parts )> masks { ( Parts::MASK << Parts::SHIFT )... };
+    uint64_t seen = 0;
+    for ( const uint64_t mask : masks ) {
+      if ( ( seen & mask ) != 0 ) {
+        return false;
+      }
+      seen |= mask;
+    }
+    return sizeof( T ) == 8 or ( seen >> ( 8 * sizeof( T ) ) ) == 0;
+  }
+  static_assert( parts_fit(), "packed header word: parts must not overlap, and must fit in the word" );
+
+  template<class H>
+  static void decode( const uint8_t* raw, H& header )
+  {
+    const T word = load<T>( raw + Offset );
+    ( Parts::template decode<T>( word, header ), ... );
+  }
+
+  template<class H>
+  static void encode( const H& header, uint8_t* raw )
+  {
+    store<T>( raw + Offset, static_cast<T>( ( Parts::template encode<T>( header ) | ... ) ) );
+  }
+};
+
+// A header of `Length` bytes, made of `Fields`
+template<size_t Length, class... Fields>
+struct Layout
+{
+  static constexpr size_t LENGTH = Length;
+
+  // Every byte belongs to exactly one field
+  static consteval bool covers_exactly()
+  {
+    std::array<unsigned, Length> owners {};
+    bool fits = true;
+    const auto claim = [&]( const size_t offset, const size_t width ) {
+      if ( offset + width > Length ) {
+        fits = false;
+        return;
+      }
+      for ( size_t i = offset; i < offset + width; i++ ) {
+        owners.at( i )++;
+      }
+    };
+    ( claim( Fields::OFFSET, Fields::WIDTH ), ... );
+    for ( const unsigned count : owners ) {
+      fits = fits and count == 1;
+    }
+    return fits;
+  }
+  static_assert( covers_exactly(), "header layout: fields must cover every byte of LENGTH exactly once" );
+
+  template<class H>
+  static void decode( const uint8_t* raw, H& header )
+  {
+    ( Fields::decode( raw, header ), ... );
+  }
+
+  template<class H>
+  static void encode( const H& header, uint8_t* raw )
+  {
+    ( Fields::encode( header, raw ), ... );
+  }
+
+  // Decode the next LENGTH bytes of `parser` into `header` (directly from the parser's buffer if
+  // they are contiguous there, otherwise from a copy), and remove them. `verify` is shown the raw
+  // bytes first (e.g. to check a checksum); if it returns false, the parser's error is set.
+  template<class H, class Verify>
+  static void read( Parser& parser, H& header, Verify&& verify )
+  {
+    if ( const uint8_t* const raw = parser.contiguous( Length ) ) {
+      decode( raw, header );
+      if ( not verify( raw ) ) {
+        parser.set_error();
+      }
+      parser.remove_prefix( Length );
+      return;
+    }
+
+    std::array<uint8_t, Length> copy {};
+    parser.string( { reinterpret_cast<char*>( copy.data() ), Length } ); // NOLINT(*-cast)
+    if ( parser.has_error() ) {
+      return;
+    }
+    decode( copy.data(), header );
+    if ( not verify( copy.data() ) ) {
+      parser.set_error();
+    }
+  }
+
+  template<class H>
+  static void read( Parser& parser, H& header )
+  {
+    read( parser, header, []( const uint8_t* ) { return true; } );
+  }
+
+  // Append the header to `serializer`
+  template<class H>
+  static void write( Serializer& serializer, const H& header )
+  {
+    encode( header, serializer.fixed( Length ) );
+  }
+};
+
+} // namespace codec
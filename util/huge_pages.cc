@@ -0,0 +1,172 @@
+#include "huge_pages.hh"
+#include "exception.hh"
+#include "log.hh"
+
+#include <fstream>
+#include <mutex>
+#include <unordered_map>
+
+#include <sys/mman.h>
+
+using namespace std;
+
+namespace {
+
+constexpr size_t GIGANTIC_PAGE_SIZE = size_t { 1 } << 30;
+
+// The page size a request is rounded up to
+size_t mapping_page( const size_t bytes )
+{
+  return bytes >= GIGANTIC_PAGE_SIZE ? GIGANTIC_PAGE_SIZE : HUGE_PAGE_SIZE;
+}
+
+size_t mapping_length( const size_t bytes )
+{
+  const size_t page = mapping_page( bytes );
+  return ( max<size_t>( bytes, 1 ) + page - 1 ) / page * page;
+}
+
+// The backend of every mapping (so that unmapping can count it), and the usage counts
+struct Mappings
+{
+  mutex lock {};
+  unordered_map<const void*, PageBackend> backends {};
+  HugePageUsage usage {};
+  array<bool, static_cast<size_t>( PageBackend::COUNT )> logged {};
+};
+
+Mappings& mappings()
+{
+  static Mappings instance;
+  return instance;
+}
+
+// Whether the kernel would honor MADV_HUGEPAGE (transparent huge pages not set to "never")
+bool transparent_huge_pages()
+{
+  static const bool enabled = [] {
+    ifstream settings { "/sys/kernel/mm/transparent_hugepage/enabled" };
+    string line;
+    getline( settings, line );
+    return not line.empty() and line.find( "[never]" ) == string::npos;
+  }();
+  return enabled;
+}
+
+// A mapping of reserved huge pages of 2^`log_page` bytes, or nullptr if there are not enough
+void* map_hugetlb( const size_t length, const int log_page )
+{
+  void* const mapping = mmap( nullptr,
+                              length,
+                              PROT_READ | PROT_WRITE,
+                              MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | ( log_page << MAP_HUGE_SHIFT ),
+                              -1,
+                              0 );
+  return mapping == MAP_FAILED ? nullptr : mapping; // NOLINT(*-cstyle-cast)
+}
+
+// A mapping of small pages that starts on a huge page boundary (so that the kernel can back it
+// with transparent huge pages from the start)
+void* map_aligned( const size_t length )
+{
+  void* const mapping
+    = mmap( nullptr, length + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+  if ( mapping == MAP_FAILED ) { // NOLINT(*-cstyle-cast)
+    throw unix_error { "mmap" };
+  }
+
+  // (trimming the unaligned head and the tail beyond the length)
+  char* const start = static_cast<char*>( mapping );
+  const size_t head = ( HUGE_PAGE_SIZE - reinterpret_cast<uintptr_t>( start ) % HUGE_PAGE_SIZE ) % HUGE_PAGE_SIZE; // NOLINT(*-reinterpret-cast)
+  if ( head != 0 ) {
+    munmap( start, head );
+  }
+  if ( head != HUGE_PAGE_SIZE ) {
+    munmap( start + head + length, HUGE_PAGE_SIZE - head );
+  }
+  return start + head;
+}
+
+} // namespace
+
+string_view to_string( const PageBackend backend )
+{
+  switch ( backend ) {
+    case PageBackend::HUGETLB_1G:
+      return "hugetlb-1G";
+    case PageBackend::HUGETLB_2M:
+      return "hugetlb-2M";
+    case PageBackend::TRANSPARENT:
+      return "transparent";
+    case PageBackend::SMALL:
+      return "small";
+    default:
+      return "unknown";
+  }
+}
+
+string HugePageUsage::to_string() const
+{
+  string text;
+  for ( size_t i = 0; i < bytes.size(); i++ ) {
+    if ( not text.empty() ) {
+      text += ", ";
+    }
+    text += ::to_string( static_cast<PageBackend>( i ) );
+    text += ": " + std::to_string( bytes[i] >> 20 ) + " MB";
+  }
+  return text;
+}
+
+HugePageUsage huge_page_usage()
+{
+  Mappings& all = mappings();
+  const lock_guard lock { all.lock };
+  return all.usage;
+}
+
+void* map_huge_pages( const size_t bytes, PageBackend* const backend )
+{
+  const size_t length = mapping_length( bytes );
+
+  PageBackend used = PageBackend::HUGETLB_1G;
+  void* mapping = length >= GIGANTIC_PAGE_SIZE ? map_hugetlb( length, 30 ) : nullptr;
+  if ( mapping == nullptr ) {
+    used = PageBackend::HUGETLB_2M;
+    mapping = map_hugetlb( length, 21 );
+  }
+  if ( mapping == nullptr ) {
+    mapping = map_aligned( length );
+    used = transparent_huge_pages() and madvise( mapping, length, MADV_HUGEPAGE ) == 0 ? PageBackend::TRANSPARENT
+                                                                                    : PageBackend::SMALL;
+  }
+
+  Mappings& all = mappings();
+  {
+    const lock_guard lock { all.lock };
+    all.backends.emplace( mapping, used );
+    all.usage.bytes[static_cast<size_t>( used )] += length;
+    if ( not all.logged[static_cast<size_t>( used )] ) {
+      all.logged[static_cast<size_t>( used )] = true;
+      LOG_INFO( "huge pages: mapping ", length >> 20, " MB with the ", ::to_string( used ), " backend" );
+    }
+  }
+  if ( backend != nullptr ) {
+    *backend = used;
+  }
+  return mapping;
+}
+
+void unmap_huge_pages( void* const data, const size_t bytes )
+{
+  const size_t length = mapping_length( bytes );
+  munmap( data, length );
+
+  Mappings& all = mappings();
+  const lock_guard lock { all.lock };
+  const auto it = all.backends.find( data );
+  if ( it != all.backends.end() ) {
+    all.usage.bytes[static_cast<size_t>( it->second )] -= length;
+    all.backends.erase( it );
+  }
+}
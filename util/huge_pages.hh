@@ -0,0 +1,107 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <new>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Memory on huge pages, for the large tables that every datagram reads (the FIB, the neighbor
+// tables) and the packet buffer area of an XdpSocket, so that they take few TLB entries.
+//
+// map_huge_pages() tries, in order: 1 GB hugetlb pages (for a request of at least 1 GB), 2 MB
+// hugetlb pages (both need pages reserved by the administrator, e.g. in /proc/sys/vm/nr_hugepages),
+// then a 2 MB-aligned mapping of small pages that the kernel is asked to back with transparent
+// huge pages (madvise(MADV_HUGEPAGE)), and finally plain small pages, if transparent huge pages
+// are disabled. Each step falls back to the next when it fails, so a mapping is only refused if
+// even small pages cannot be had.
+//
+// No page is placed until it is first written, so under the default (local) NUMA policy each
+// page lands on the node of the thread that first touches it: a table built by a worker thread
+// is local to that worker.
+//
+// huge_page_usage() says which backends are in use (the first mapping made by each backend is
+// also logged, at INFO).
+
+enum class PageBackend : uint8_t
+{
+  HUGETLB_1G,  // reserved 1 GB pages
+  HUGETLB_2M,  // reserved 2 MB pages
+  TRANSPARENT, // small pages, advised to be merged into transparent huge pages
+  SMALL,       // small pages
+  COUNT
+};
+
+std::string_view to_string( PageBackend backend );
+
+// Requests smaller than this are not worth a mapping of their own (see HugePageAllocator)
+inline constexpr size_t HUGE_PAGE_SIZE = size_t { 2 } << 20;
+
+// Bytes currently mapped by each backend, across the process
+struct HugePageUsage
+{
+  std::array<size_t, static_cast<size_t>( PageBackend::COUNT )> bytes {};
+
+  size_t operator[]( PageBackend backend ) const { return bytes[static_cast<size_t>( backend )]; }
+
+  // e.g. "hugetlb-2M: 0 MB, transparent: 24 MB, small: 0 MB"
+  std::string to_string() const;
+};
+
+HugePageUsage huge_page_usage();
+
+// A zeroed, private, read-write anonymous mapping of at least `bytes` bytes (rounded up to a
+// whole number of huge pages), on the largest pages available. Throws unix_error if none can be
+// had. `backend`, if given, is set to the backend used.
+void* map_huge_pages( size_t bytes, PageBackend* backend = nullptr );
+
+// Unmap memory from map_huge_pages( bytes )
+void unmap_huge_pages( void* data, size_t bytes );
+
+// A standard allocator that puts allocations of at least HUGE_PAGE_SIZE bytes on huge pages (see
+// map_huge_pages()), and leaves smaller ones to operator new, so that a container only moves to
+// huge pages once it is large enough for that to matter.
+template<typename T>
+struct HugePageAllocator
+{
+  using value_type = T;
+
+  HugePageAllocator() = default;
+  template<typename U>
+  HugePageAllocator( const HugePageAllocator<U>& /* other */ ) // NOLINT(*-explicit-*)
+  {}
+
+  T* allocate( const size_t n )
+  {
+    if ( n > std::numeric_limits<size_t>::max() / sizeof( T ) ) {
+      throw std::bad_array_new_length {};
+    }
+    if ( n * sizeof( T ) < HUGE_PAGE_SIZE ) {
+      return std::allocator<T> {}.allocate( n );
+    }
+    return static_cast<T*>( map_huge_pages( n * sizeof( T ) ) );
+  }
+
+  void deallocate( T* p, const size_t n )
+  {
+    if ( n * sizeof( T ) < HUGE_PAGE_SIZE ) {
+      std::allocator<T> {}.deallocate( p, n );
+      return;
+    }
+    unmap_huge_pages( p, n * sizeof( T ) );
+  }
+
+  template<typename U>
+  bool operator==( const HugePageAllocator<U>& /* other */ ) const
+  {
+    return true;
+  }
+};
+
+// A vector that moves to huge pages once it is large
+template<typename T>
+using HugePageVector = std::vector<T, HugePageAllocator<T>>;
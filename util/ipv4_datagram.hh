@@ -21,11 +21,25 @@ struct IPv4Datagram
 
   void serialize( Serializer& serializer ) const
   {
+    // the header and any small payload pieces share one allocation; large pieces are referenced
+    serializer.reserve( IPv4Header::serialized_length() + Serializer::coalesced_length( payload ) );
     header.serialize( serializer );
     for ( const auto& x : payload ) {
       serializer.buffer( x );
     }
   }
+
+  // Same as serialize(), but the payload buffers are moved into the output rather than shared
+  // (for a datagram that is being handed off, e.g. forwarded); leaves the payload empty
+  void serialize_consuming( Serializer& serializer )
+  {
+    serializer.reserve( IPv4Header::serialized_length() + Serializer::coalesced_length( payload ) );
+    header.serialize( serializer );
+    for ( auto& x : payload ) {
+      serializer.buffer( std::move( x ) );
+    }
+    payload.clear();
+  }
 };
 
 using InternetDatagram = IPv4Datagram;
@@ -1,5 +1,6 @@
 #include "ipv4_header.hh"
 #include "checksum.hh"
+#include "header_codec.hh"
 
 #include <arpa/inet.h>
 #include <array>
@@ -8,28 +9,36 @@
 
 using namespace std;
 
+namespace {
+
+using Layout = codec::Layout<IPv4Header::LENGTH,
+                             codec::Packed<uint8_t,
+                                           0,
+                                           codec::Bits<&IPv4Header::ver, 4, 4>,
+                                           codec::Bits<&IPv4Header::hlen, 0, 4>>,
+                             codec::Scalar<&IPv4Header::tos, 1>,
+                             codec::Scalar<&IPv4Header::len, 2>,
+                             codec::Scalar<&IPv4Header::id, 4>,
+                             codec::Packed<uint16_t,
+                                           6,
+                                           codec::Bits<&IPv4Header::df, 14, 1>, // don't fragment
+                                           codec::Bits<&IPv4Header::mf, 13, 1>, // more fragments
+                                           codec::Bits<&IPv4Header::offset, 0, 13>>,
+                             codec::Scalar<&IPv4Header::ttl, 8>,
+                             codec::Scalar<&IPv4Header::proto, 9>,
+                             codec::Scalar<&IPv4Header::cksum, 10>,
+                             codec::Scalar<&IPv4Header::src, 12>,
+                             codec::Scalar<&IPv4Header::dst, 16>>;
+
+} // namespace
+
 // Parse from string.
 void IPv4Header::parse( Parser& parser )
 {
-  uint8_t first_byte {};
-  parser.integer( first_byte );
-  ver = first_byte >> 4;    // version
-  hlen = first_byte & 0x0f; // header length
-  parser.integer( tos );    // type of service
-  parser.integer( len );
-  parser.integer( id );
-
-  uint16_t fo_val {};
-  parser.integer( fo_val );
-  df = static_cast<bool>( fo_val & 0x4000 ); // don't fragment
-  mf = static_cast<bool>( fo_val & 0x2000 ); // more fragments
-  offset = fo_val & 0x1fff;                  // offset
-
-  parser.integer( ttl );
-  parser.integer( proto );
-  parser.integer( cksum );
-  parser.integer( src );
-  parser.integer( dst );
+  // (the checksum is verified on the raw bytes, before they are removed from the parser)
+  Layout::read( parser, *this, []( const uint8_t* raw ) {
+    return checksum_ok( { reinterpret_cast<const char*>( raw ), LENGTH } ); // NOLINT(*-cast)
+  } );
 
   if ( ver != 4 ) {
     parser.set_error();
@@ -40,13 +49,11 @@ void IPv4Header::parse( Parser& parser )
   }
 
   parser.remove_prefix( static_cast<uint64_t>( hlen ) * 4 - IPv4Header::LENGTH );
+}
 
-  // Verify checksum
-  const uint16_t given_cksum = cksum;
-  compute_checksum();
-  if ( cksum != given_cksum ) {
-    parser.set_error();
-  }
+void IPv4Header::decode( const uint8_t* raw )
+{
+  Layout::decode( raw, *this );
 }
 
 // Serialize the IPv4Header (does not recompute the checksum)
@@ -57,22 +64,7 @@ void IPv4Header::serialize( Serializer& serializer ) const
     throw runtime_error( "wrong IP version" );
   }
 
-  const uint8_t first_byte = ( static_cast<uint32_t>( ver ) << 4 ) | ( hlen & 0xfU );
-  serializer.integer( first_byte ); // version and header length
-  serializer.integer( tos );
-  serializer.integer( len );
-  serializer.integer( id );
-
-  const uint16_t fo_val = ( df ? 0x4000U : 0 ) | ( mf ? 0x2000U : 0 ) | ( offset & 0x1fffU );
-  serializer.integer( fo_val );
-
-  serializer.integer( ttl );
-  serializer.integer( proto );
-
-  serializer.integer( cksum );
-
-  serializer.integer( src );
-  serializer.integer( dst );
+  Layout::write( serializer, *this );
 }
 
 uint16_t IPv4Header::payload_length() const
@@ -103,15 +95,49 @@ uint32_t IPv4Header::pseudo_checksum() const
 void IPv4Header::compute_checksum()
 {
   cksum = 0;
-  Serializer s;
-  serialize( s );
+  array<uint8_t, LENGTH> raw {};
+  Layout::encode( *this, raw.data() );
 
   // calculate checksum -- taken over header only
   InternetChecksum check;
-  check.add( s.output() );
+  check.add( { reinterpret_cast<const char*>( raw.data() ), LENGTH } ); // NOLINT(*-cast)
   cksum = check.value();
 }
 
+void IPv4Header::update_checksum( const uint16_t old_word, const uint16_t new_word )
+{
+  cksum = adjusted_checksum( cksum, old_word, new_word );
+}
+
+uint16_t IPv4Header::adjusted_checksum( const uint16_t checksum, const uint16_t old_word, const uint16_t new_word )
+{
+  // HC' = ~( ~HC + ~m + m' ), in one's complement arithmetic
+  uint32_t sum = static_cast<uint16_t>( ~checksum );
+  sum += static_cast<uint16_t>( ~old_word );
+  sum += new_word;
+  while ( sum > 0xffff ) {
+    sum = ( sum >> 16 ) + static_cast<uint16_t>( sum );
+  }
+  return ~static_cast<uint16_t>( sum );
+}
+
+void IPv4Header::decrement_ttl()
+{
+  // TTL shares its 16-bit word with the protocol field
+  const uint16_t old_word = ( static_cast<uint16_t>( ttl ) << 8 ) | proto;
+  ttl--;
+  const uint16_t new_word = ( static_cast<uint16_t>( ttl ) << 8 ) | proto;
+  update_checksum( old_word, new_word );
+}
+
+// A header that includes its own correct checksum sums to 0xffff (so its checksum value is 0)
+bool IPv4Header::checksum_ok( const std::string_view raw_header )
+{
+  InternetChecksum check;
+  check.add( raw_header );
+  return check.value() == 0;
+}
+
 std::string IPv4Header::to_string() const
 {
   stringstream ss {};
@@ -5,6 +5,7 @@
 #include <cstddef>
 #include <cstdint>
 #include <string>
+#include <string_view>
 
 // IPv4 Internet datagram header (note: IP options are not supported)
 struct IPv4Header
@@ -12,6 +13,7 @@ struct IPv4Header
   static constexpr size_t LENGTH = 20;        // IPv4 header length, not including options
   static constexpr uint8_t DEFAULT_TTL = 128; // A reasonable default TTL value
   static constexpr uint8_t PROTO_TCP = 6;     // Protocol number for TCP
+  static constexpr uint8_t PROTO_UDP = 17;    // Protocol number for UDP
 
   static constexpr uint64_t serialized_length() { return LENGTH; }
 
@@ -57,9 +59,25 @@ struct IPv4Header
   // Set checksum to correct value
   void compute_checksum();
 
+  // Adjust the checksum for a change of one 16-bit header word from `old_word` to `new_word`,
+  // without re-summing the header ([RFC 1624](\ref rfc::rfc1624), eqn. 3)
+  void update_checksum( uint16_t old_word, uint16_t new_word );
+
+  // The same adjustment, to a checksum given on its own (e.g. one read from a raw header)
+  static uint16_t adjusted_checksum( uint16_t checksum, uint16_t old_word, uint16_t new_word );
+
+  // Decrement the TTL and incrementally update the checksum to match
+  void decrement_ttl();
+
+  // Verify the checksum of a raw (serialized) header, directly on its bytes
+  static bool checksum_ok( std::string_view raw_header );
+
   // Return a string containing a header in human-readable format
   std::string to_string() const;
 
+  // Decode the fields from a raw header of at least LENGTH bytes (without checking anything)
+  void decode( const uint8_t* raw );
+
   void parse( Parser& parser );
   void serialize( Serializer& serializer ) const;
 };
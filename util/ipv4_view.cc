@@ -0,0 +1,130 @@
+#include "ipv4_view.hh"
+
+#include <algorithm>
+
+using namespace std;
+
+optional<IPv4View> IPv4View::parse( const vector<Buffer>& bytes )
+{
+  IPv4View view;
+  view.bytes_ = bytes;
+
+  // (the whole header, options included, must be in the first buffer: if it is split across
+  // buffers, or missing, they are gathered into one)
+  const auto header_length = [&view] {
+    const string_view front { view.bytes_.front() };
+    return front.size() < IPv4Header::LENGTH ? SIZE_MAX : static_cast<size_t>( front[0] & 0x0f ) * 4;
+  };
+  if ( view.bytes_.empty() or header_length() > view.bytes_.front().size() ) {
+    string joined;
+    for ( const auto& piece : bytes ) {
+      joined.append( piece );
+    }
+    view.bytes_.assign( 1, Buffer { std::move( joined ) } );
+    if ( header_length() > view.bytes_.front().size() ) {
+      return {};
+    }
+  }
+
+  // (the total length may be short of the bytes, e.g. of a padded Ethernet frame's payload, but
+  // not beyond them)
+  const uint8_t* const raw = view.raw();
+  const uint8_t version = raw[0] >> 4;
+  const size_t length = codec::load<uint16_t>( raw + 2 );
+  if ( version != 4 or header_length() < IPv4Header::LENGTH or length > view.size()
+       or not IPv4Header::checksum_ok( { reinterpret_cast<const char*>( raw ), IPv4Header::LENGTH } ) ) { // NOLINT(*-cast)
+    return {};
+  }
+  return view;
+}
+
+IPv4View IPv4View::of( const InternetDatagram& dgram )
+{
+  // (a serialized datagram's header is at the start of its first buffer, the header region)
+  IPv4View view;
+  view.bytes_ = serialize( dgram );
+  return view;
+}
+
+uint32_t IPv4View::ports() const
+{
+  if ( ( proto() != IPv4Header::PROTO_TCP and proto() != IPv4Header::PROTO_UDP ) or fragment() ) {
+    return 0;
+  }
+
+  // (the ports may be in the first buffer, after the header, or in the ones that follow it)
+  size_t skip = static_cast<size_t>( raw()[0] & 0x0f ) * 4;
+  uint8_t ports[4] {}; // NOLINT(*-avoid-c-arrays)
+  size_t have = 0;
+  for ( const auto& piece : bytes_ ) {
+    const string_view bytes { piece };
+    for ( size_t i = min( skip, bytes.size() ); i < bytes.size() and have < sizeof( ports ); i++ ) {
+      ports[have++] = static_cast<uint8_t>( bytes[i] );
+    }
+    skip -= min( skip, bytes.size() );
+    if ( have == sizeof( ports ) ) {
+      return codec::load<uint32_t>( ports );
+    }
+  }
+  return 0; // (too short to have ports)
+}
+
+size_t IPv4View::size() const
+{
+  size_t size = 0;
+  for ( const auto& piece : bytes_ ) {
+    size += piece.size();
+  }
+  return size;
+}
+
+size_t IPv4View::copy_to( const span<uint8_t> out ) const
+{
+  size_t copied = 0;
+  for ( const auto& piece : bytes_ ) {
+    const string_view bytes { piece };
+    const size_t count = min( bytes.size(), out.size() - copied );
+    copy_n( bytes.data(), count, out.data() + copied );
+    copied += count;
+    if ( copied == out.size() ) {
+      break;
+    }
+  }
+  return copied;
+}
+
+void IPv4View::decrement_ttl()
+{
+  // Bytes still shared with another Buffer (e.g. the received frame, which its owner keeps) are
+  // not copied whole before they are patched: only the header is, into a Buffer of its own in
+  // front of the rest
+  if ( bytes_.front().shared() ) {
+    const size_t header_length = static_cast<size_t>( raw()[0] & 0x0f ) * 4;
+    Buffer rest = bytes_.front().substr( header_length );
+    bytes_.front() = Buffer::copy_of( std::string_view { bytes_.front() }.substr( 0, header_length ) );
+    if ( not rest.empty() ) {
+      bytes_.insert( bytes_.begin() + 1, std::move( rest ) );
+    }
+  }
+
+  // TTL shares its 16-bit word with the protocol field
+  uint8_t* const raw = reinterpret_cast<uint8_t*>( bytes_.front().mutable_data() ); // NOLINT(*-cast)
+  const auto old_word = codec::load<uint16_t>( raw + 8 );
+  raw[8]--;
+  const auto new_word = codec::load<uint16_t>( raw + 8 );
+  codec::store( raw + 10, IPv4Header::adjusted_checksum( codec::load<uint16_t>( raw + 10 ), old_word, new_word ) );
+}
+
+IPv4Header IPv4View::header() const
+{
+  IPv4Header header;
+  header.decode( raw() );
+  return header;
+}
+
+InternetDatagram IPv4View::decode() const
+{
+  InternetDatagram dgram;
+  ::parse( dgram, bytes_ ); // (cannot fail: the header has been checked)
+  return dgram;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "buffer.hh"
+#include "header_codec.hh"
+#include "ipv4_datagram.hh"
+#include "ipv4_header.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+// A received IPv4 datagram that is being forwarded, kept as the bytes it arrived in.
+//
+// Forwarding reads only a few fields of the header (the destination and the TTL, and the flow for
+// a multipath route), so rather than decode the header and split off the payload, only to
+// serialize both again on the way out, a view checks the header once on its raw bytes, reads
+// fields where they are, patches the TTL and checksum in place, and hands the original buffers
+// on to the outbound interface. A datagram that has to be seen whole (delivered locally,
+// fragmented, or queued for ARP) is decoded into an InternetDatagram.
+class IPv4View
+{
+  std::vector<Buffer> bytes_ {}; // the whole datagram, with its header contiguous in the first buffer
+
+  const uint8_t* raw() const
+  {
+    return reinterpret_cast<const uint8_t*>( std::string_view { bytes_.front() }.data() ); // NOLINT(*-cast)
+  }
+
+public:
+  // A view of a received datagram (e.g. an Ethernet frame's payload), or none if its header does
+  // not parse: the same checks as IPv4Header::parse(), made on the raw bytes, and also that the
+  // header (with its options) and the total length it gives fit in the bytes
+  static std::optional<IPv4View> parse( const std::vector<Buffer>& bytes );
+
+  // A view of a datagram that has been decoded (e.g. one reassembled from its fragments)
+  static IPv4View of( const InternetDatagram& dgram );
+
+  uint32_t src() const { return codec::load<uint32_t>( raw() + 12 ); }
+  uint32_t dst() const { return codec::load<uint32_t>( raw() + 16 ); }
+  uint8_t ttl() const { return raw()[8]; }
+  uint8_t proto() const { return raw()[9]; }
+
+  // Whether the datagram is a fragment (more fragments follow, or its offset is not 0)
+  bool fragment() const { return ( codec::load<uint16_t>( raw() + 6 ) & 0x3fff ) != 0; }
+
+  // The source and destination ports (source in the high 16 bits) of a TCP or UDP datagram that
+  // is not a fragment, read from the start of its payload; 0 for any other datagram (including
+  // every fragment, so that all of a datagram's fragments have the same flow)
+  uint32_t ports() const;
+
+  // Length of the datagram, header included (all of its bytes, as IPv4Header::parse() leaves
+  // them in an InternetDatagram)
+  size_t size() const;
+
+  // Copy the datagram's first out.size() bytes (or all of it, if it is shorter) into `out`;
+  // returns how many were copied
+  size_t copy_to( std::span<uint8_t> out ) const;
+
+  // Decrement the TTL and incrementally update the checksum to match, in the datagram's own bytes
+  // (if another Buffer shares them, only the header is copied first, and the payload left shared)
+  void decrement_ttl();
+
+  // The whole header, decoded
+  IPv4Header header() const;
+
+  // The whole datagram, decoded
+  InternetDatagram decode() const;
+
+  // The datagram's bytes (e.g. for the payload of an Ethernet frame); leaves the view empty
+  std::vector<Buffer> release() { return std::move( bytes_ ); }
+};
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "ipv6_header.hh"
+#include "parser.hh"
+
+#include <vector>
+
+//! \brief [IPv6](\ref rfc::rfc8200) Internet datagram
+struct IPv6Datagram
+{
+  IPv6Header header {};
+  std::vector<Buffer> payload {};
+
+  void parse( Parser& parser )
+  {
+    header.parse( parser );
+    parser.all_remaining( payload );
+  }
+
+  void serialize( Serializer& serializer ) const
+  {
+    // the header and any small payload pieces share one allocation; large pieces are referenced
+    serializer.reserve( IPv6Header::serialized_length() + Serializer::coalesced_length( payload ) );
+    header.serialize( serializer );
+    for ( const auto& x : payload ) {
+      serializer.buffer( x );
+    }
+  }
+};
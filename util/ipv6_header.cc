@@ -0,0 +1,101 @@
+#include "ipv6_header.hh"
+#include "header_codec.hh"
+
+#include <arpa/inet.h>
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+
+using Layout = codec::Layout<IPv6Header::LENGTH,
+                             codec::Packed<uint32_t,
+                                           0,
+                                           codec::Bits<&IPv6Header::ver, 28, 4>,
+                                           codec::Bits<&IPv6Header::traffic_class, 20, 8>,
+                                           codec::Bits<&IPv6Header::flow_label, 0, 20>>,
+                             codec::Scalar<&IPv6Header::payload_length, 4>,
+                             codec::Scalar<&IPv6Header::next_header, 6>,
+                             codec::Scalar<&IPv6Header::hop_limit, 7>,
+                             codec::Bytes<&IPv6Header::src, 8>,
+                             codec::Bytes<&IPv6Header::dst, 24>>;
+
+} // namespace
+
+string to_string( const IPv6Address& address )
+{
+  array<char, INET6_ADDRSTRLEN> text {};
+  inet_ntop( AF_INET6, address.data(), text.data(), text.size() );
+  return text.data();
+}
+
+IPv6Address ipv6_address( const string& text )
+{
+  IPv6Address address {};
+  if ( inet_pton( AF_INET6, text.c_str(), address.data() ) != 1 ) {
+    throw runtime_error( "not an IPv6 address: " + text );
+  }
+  return address;
+}
+
+// Parse from string.
+void IPv6Header::parse( Parser& parser )
+{
+  Layout::read( parser, *this );
+
+  if ( ver != 6 ) {
+    parser.set_error();
+  }
+}
+
+void IPv6Header::decode( const uint8_t* raw )
+{
+  Layout::decode( raw, *this );
+}
+
+// Serialize the IPv6Header
+void IPv6Header::serialize( Serializer& serializer ) const
+{
+  // consistency checks
+  if ( ver != 6 ) {
+    throw runtime_error( "wrong IP version" );
+  }
+
+  Layout::write( serializer, *this );
+}
+
+//! \details This value is needed when computing the checksum of an ICMPv6, TCP or UDP message.
+//! ~~~{.txt}
+//!   0      7 8     15 16    23 24    31
+//!  +--------+--------+--------+--------+
+//!  |     source address (16 bytes)     |
+//!  +--------+--------+--------+--------+
+//!  |  destination address (16 bytes)   |
+//!  +--------+--------+--------+--------+
+//!  |     upper-layer packet length     |
+//!  +--------+--------+--------+--------+
+//!  |      zero       |  next header    |
+//!  +--------+--------+--------+--------+
+//! ~~~
+uint32_t IPv6Header::pseudo_checksum() const
+{
+  uint32_t pcksum = 0;
+  for ( size_t i = 0; i < src.size(); i += 2 ) {
+    pcksum += codec::load<uint16_t>( src.data() + i ) + codec::load<uint16_t>( dst.data() + i );
+  }
+  pcksum += payload_length;
+  pcksum += next_header;
+  return pcksum;
+}
+
+std::string IPv6Header::to_string() const
+{
+  stringstream ss {};
+  ss << "IPv" << +ver << ", "
+     << "payload_length=" << +payload_length << ", "
+     << "next_header=" << +next_header << ", " << ( hop_limit >= 10 ? "" : "hop_limit=" + std::to_string( hop_limit ) + ", " )
+     << "src=" << ::to_string( src ) << ", "
+     << "dst=" << ::to_string( dst );
+  return ss.str();
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "parser.hh"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// An IPv6 address, in network byte order (as it is on the wire)
+using IPv6Address = std::array<uint8_t, 16>;
+
+// Printable representation of an IPv6Address (e.g. "2001:db8::1")
+std::string to_string( const IPv6Address& address );
+
+// The IPv6Address written as `text` (e.g. "fe80::1"). Throws runtime_error if it is not one.
+IPv6Address ipv6_address( const std::string& text );
+
+// [IPv6](\ref rfc::rfc8200) datagram header (note: extension headers are not supported, and are
+// left in the payload)
+struct IPv6Header
+{
+  static constexpr size_t LENGTH = 40;              // IPv6 header length
+  static constexpr uint8_t DEFAULT_HOP_LIMIT = 64;  // A reasonable default hop limit
+  static constexpr uint8_t NEXT_HEADER_TCP = 6;     // Next header number for TCP
+  static constexpr uint8_t NEXT_HEADER_UDP = 17;    // Next header number for UDP
+  static constexpr uint8_t NEXT_HEADER_ICMPV6 = 58; // Next header number for ICMPv6
+
+  static constexpr uint64_t serialized_length() { return LENGTH; }
+
+  /*
+   *   0                   1                   2                   3
+   *   0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+   *  +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+   *  |Version| Traffic Class |           Flow Label                  |
+   *  +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+   *  |         Payload Length        |  Next Header  |   Hop Limit   |
+   *  +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+   *  |                                                               |
+   *  +                         Source Address                        +
+   *  |                          (16 bytes)                           |
+   *  +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+   *  |                                                               |
+   *  +                      Destination Address                      +
+   *  |                          (16 bytes)                           |
+   *  +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+   */
+
+  // IPv6 Header fields
+  uint8_t ver = 6;                       // IP version
+  uint8_t traffic_class = 0;             // traffic class
+  uint32_t flow_label = 0;               // flow label (20 bits)
+  uint16_t payload_length = 0;           // length of what follows the header
+  uint8_t next_header = NEXT_HEADER_TCP; // protocol of what follows the header
+  uint8_t hop_limit = DEFAULT_HOP_LIMIT; // hop limit (IPv6's TTL)
+  IPv6Address src {};                    // src address
+  IPv6Address dst {};                    // dst address
+
+  // Pseudo-header's contribution to the checksum of an upper-layer message (e.g. ICMPv6) that
+  // is the whole payload ([RFC 8200](\ref rfc::rfc8200), section 8.1)
+  uint32_t pseudo_checksum() const;
+
+  // Return a string containing a header in human-readable format
+  std::string to_string() const;
+
+  // Decode the fields from a raw header of at least LENGTH bytes (without checking anything)
+  void decode( const uint8_t* raw );
+
+  void parse( Parser& parser );
+  void serialize( Serializer& serializer ) const;
+};
@@ -0,0 +1,63 @@
+#include "ipv6_view.hh"
+
+using namespace std;
+
+optional<IPv6View> IPv6View::parse( const vector<Buffer>& bytes )
+{
+  IPv6View view;
+  if ( not bytes.empty() and bytes.front().size() >= IPv6Header::LENGTH ) {
+    view.bytes_ = bytes;
+  } else {
+    // the header is split across buffers (or missing): gathered into one
+    string joined;
+    for ( const auto& piece : bytes ) {
+      joined.append( piece );
+    }
+    if ( joined.size() < IPv6Header::LENGTH ) {
+      return {};
+    }
+    view.bytes_.emplace_back( std::move( joined ) );
+  }
+
+  if ( view.raw()[0] >> 4 != 6 or view.size() < IPv6Header::LENGTH + view.payload_length() ) {
+    return {};
+  }
+  return view;
+}
+
+IPv6View IPv6View::of( const IPv6Datagram& dgram )
+{
+  // (a serialized datagram's header is at the start of its first buffer, the header region)
+  IPv6View view;
+  view.bytes_ = serialize( dgram );
+  return view;
+}
+
+size_t IPv6View::size() const
+{
+  size_t size = 0;
+  for ( const auto& piece : bytes_ ) {
+    size += piece.size();
+  }
+  return size;
+}
+
+void IPv6View::decrement_hop_limit()
+{
+  uint8_t* const raw = reinterpret_cast<uint8_t*>( bytes_.front().mutable_data() ); // NOLINT(*-cast)
+  raw[7]--;
+}
+
+IPv6Header IPv6View::header() const
+{
+  IPv6Header header;
+  header.decode( raw() );
+  return header;
+}
+
+IPv6Datagram IPv6View::decode() const
+{
+  IPv6Datagram dgram;
+  ::parse( dgram, bytes_ ); // (cannot fail: the header has been checked)
+  return dgram;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "buffer.hh"
+#include "header_codec.hh"
+#include "ipv6_datagram.hh"
+#include "ipv6_header.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+// A received IPv6 datagram that is being forwarded, kept as the bytes it arrived in (as IPv4View
+// keeps an IPv4 datagram).
+//
+// An IPv6 header has no checksum, so forwarding one only reads its destination and hop limit and
+// decrements the hop limit in place; the original buffers are handed on to the outbound
+// interface.
+class IPv6View
+{
+  std::vector<Buffer> bytes_ {}; // the whole datagram, with its header contiguous in the first buffer
+
+  const uint8_t* raw() const
+  {
+    return reinterpret_cast<const uint8_t*>( std::string_view { bytes_.front() }.data() ); // NOLINT(*-cast)
+  }
+
+  static IPv6Address address( const uint8_t* raw )
+  {
+    IPv6Address address;
+    std::memcpy( address.data(), raw, address.size() );
+    return address;
+  }
+
+public:
+  // A view of a received datagram (e.g. an Ethernet frame's payload), or none if it is not an
+  // IPv6 datagram as long as its header says
+  static std::optional<IPv6View> parse( const std::vector<Buffer>& bytes );
+
+  // A view of a datagram that has been decoded
+  static IPv6View of( const IPv6Datagram& dgram );
+
+  IPv6Address src() const { return address( raw() + 8 ); }
+  IPv6Address dst() const { return address( raw() + 24 ); }
+  uint8_t hop_limit() const { return raw()[7]; }
+  uint8_t next_header() const { return raw()[6]; }
+  uint16_t payload_length() const { return codec::load<uint16_t>( raw() + 4 ); }
+
+  // Length of the datagram, header included
+  size_t size() const;
+
+  // Decrement the hop limit, in the datagram's own bytes (copied first only if another Buffer
+  // shares them)
+  void decrement_hop_limit();
+
+  // The whole header, decoded
+  IPv6Header header() const;
+
+  // The whole datagram, decoded
+  IPv6Datagram decode() const;
+
+  // The datagram's bytes (e.g. for the payload of an Ethernet frame); leaves the view empty
+  std::vector<Buffer> release() { return std::move( bytes_ ); }
+};
@@ -0,0 +1,183 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <ostream>
+#include <string_view>
+#include <type_traits>
+
+// Latency histograms for the forwarding hot paths.
+//
+// LatencyHistogram is an HDR-style log-linear histogram of nanosecond values: every power of two
+// is split into SUB_BUCKETS equal buckets, so recorded values keep about 3% precision from 1 ns
+// up to about 18 minutes, in a fixed array of counters. It has one writer (the thread that owns
+// the object being measured), whose record() is a relaxed load and store, and any number of
+// readers (to dump percentiles from a running router).
+//
+// The instrumentation itself is only compiled in with LATENCY_HISTOGRAMS defined (the CMake
+// option of the same name). Instrumented classes hold a LatencyRecorder, which is then an
+// empty type, and time their code with LATENCY_SCOPE, which then expands to nothing.
+
+#ifdef LATENCY_HISTOGRAMS
+inline constexpr bool LATENCY_HISTOGRAMS_ENABLED = true;
+#else
+inline constexpr bool LATENCY_HISTOGRAMS_ENABLED = false;
+#endif
+
+// Nanoseconds from a clock that is not slewed by NTP
+inline uint64_t latency_clock_ns()
+{
+  timespec now {};
+  clock_gettime( CLOCK_MONOTONIC_RAW, &now );
+  return static_cast<uint64_t>( now.tv_sec ) * 1'000'000'000 + static_cast<uint64_t>( now.tv_nsec );
+}
+
+class LatencyHistogram
+{
+public:
+  static constexpr size_t SUB_BUCKET_BITS = 5;
+  static constexpr size_t SUB_BUCKETS = size_t { 1 } << SUB_BUCKET_BITS;
+  static constexpr size_t MAX_BITS = 40;                      // values are clamped below 2^40 ns
+  static constexpr uint64_t MAX_VALUE = ( uint64_t { 1 } << MAX_BITS ) - 1;
+  static constexpr size_t BUCKETS = ( MAX_BITS - SUB_BUCKET_BITS + 1 ) * SUB_BUCKETS;
+
+private:
+  std::array<std::atomic<uint64_t>, BUCKETS> counts_ {};
+  std::atomic<uint64_t> total_ { 0 };
+  std::atomic<uint64_t> max_ { 0 };
+
+  static size_t bucket( const uint64_t value )
+  {
+    if ( value < SUB_BUCKETS ) {
+      return value;
+    }
+    const size_t magnitude = std::bit_width( value ) - 1; // >= SUB_BUCKET_BITS
+    const size_t shift = magnitude - SUB_BUCKET_BITS;
+    return ( shift + 1 ) * SUB_BUCKETS + static_cast<size_t>( ( value >> shift ) - SUB_BUCKETS );
+  }
+
+  // The largest value that falls in bucket `index`
+  static uint64_t highest_in( const size_t index )
+  {
+    if ( index < SUB_BUCKETS ) {
+      return index;
+    }
+    const size_t shift = index / SUB_BUCKETS - 1;
+    const uint64_t low = ( SUB_BUCKETS + index % SUB_BUCKETS ) << shift;
+    return low + ( uint64_t { 1 } << shift ) - 1;
+  }
+
+  static void bump( std::atomic<uint64_t>& counter, const uint64_t n )
+  {
+    counter.store( counter.load( std::memory_order_relaxed ) + n, std::memory_order_relaxed );
+  }
+
+public:
+  LatencyHistogram() = default;
+
+  // Copies are snapshots (and only exact while the writer is not running)
+  LatencyHistogram( const LatencyHistogram& other ) { *this = other; }
+  LatencyHistogram& operator=( const LatencyHistogram& other )
+  {
+    for ( size_t i = 0; i < BUCKETS; i++ ) {
+      counts_[i].store( other.counts_[i].load( std::memory_order_relaxed ), std::memory_order_relaxed );
+    }
+    total_.store( other.count(), std::memory_order_relaxed );
+    max_.store( other.max(), std::memory_order_relaxed );
+    return *this;
+  }
+  ~LatencyHistogram() = default;
+
+  // Writer side
+  void record( uint64_t ns )
+  {
+    ns = ns > MAX_VALUE ? MAX_VALUE : ns;
+    bump( counts_[bucket( ns )], 1 );
+    bump( total_, 1 );
+    if ( ns > max_.load( std::memory_order_relaxed ) ) {
+      max_.store( ns, std::memory_order_relaxed );
+    }
+  }
+
+  // Writer side: add `other`'s values to this histogram
+  void merge( const LatencyHistogram& other )
+  {
+    for ( size_t i = 0; i < BUCKETS; i++ ) {
+      bump( counts_[i], other.counts_[i].load( std::memory_order_relaxed ) );
+    }
+    bump( total_, other.count() );
+    if ( other.max() > max() ) {
+      max_.store( other.max(), std::memory_order_relaxed );
+    }
+  }
+
+  uint64_t count() const { return total_.load( std::memory_order_relaxed ); }
+  uint64_t max() const { return max_.load( std::memory_order_relaxed ); }
+
+  // The value at quantile `q` (0 to 1): the highest value equivalent to the one below which
+  // a fraction q of the recorded values fall (0 if nothing was recorded)
+  uint64_t percentile( const double q ) const
+  {
+    const uint64_t total = count();
+    if ( total == 0 ) {
+      return 0;
+    }
+    auto rank = static_cast<uint64_t>( q * static_cast<double>( total ) + 0.5 );
+    rank = rank < 1 ? 1 : ( rank > total ? total : rank );
+
+    uint64_t seen = 0;
+    for ( size_t i = 0; i < BUCKETS; i++ ) {
+      seen += counts_[i].load( std::memory_order_relaxed );
+      if ( seen >= rank ) {
+        const uint64_t value = highest_in( i );
+        return value < max() ? value : max();
+      }
+    }
+    return max();
+  }
+
+  // One line: "<name>: count=... p50=...ns p99=...ns p999=...ns max=...ns"
+  void print( std::ostream& out, const std::string_view name ) const
+  {
+    out << name << ": count=" << count() << " p50=" << percentile( 0.5 ) << "ns p99=" << percentile( 0.99 )
+        << "ns p999=" << percentile( 0.999 ) << "ns max=" << max() << "ns\n";
+  }
+};
+
+// Stands in for a LatencyHistogram when the instrumentation is compiled out
+struct NoLatencyHistogram
+{
+  void record( uint64_t /* ns */ ) {}
+};
+
+using LatencyRecorder = std::conditional_t<LATENCY_HISTOGRAMS_ENABLED, LatencyHistogram, NoLatencyHistogram>;
+
+// Records the time from its construction to its destruction
+class LatencyScope
+{
+  LatencyHistogram& histogram_;
+  uint64_t start_ { latency_clock_ns() };
+
+public:
+  explicit LatencyScope( LatencyHistogram& histogram ) : histogram_( histogram ) {}
+  ~LatencyScope() { histogram_.record( latency_clock_ns() - start_ ); }
+
+  LatencyScope( const LatencyScope& other ) = delete;
+  LatencyScope& operator=( const LatencyScope& other ) = delete;
+  LatencyScope( LatencyScope&& other ) = delete;
+  LatencyScope& operator=( LatencyScope&& other ) = delete;
+};
+
+// NOLINTBEGIN(*-macro-usage)
+#define LATENCY_CONCAT_INNER( a, b ) a##b
+#define LATENCY_CONCAT( a, b ) LATENCY_CONCAT_INNER( a, b )
+#ifdef LATENCY_HISTOGRAMS
+#define LATENCY_SCOPE( recorder ) const LatencyScope LATENCY_CONCAT( latency_scope_, __LINE__ ) { recorder }
+#else
+#define LATENCY_SCOPE( recorder ) static_cast<void>( 0 )
+#endif
+// NOLINTEND(*-macro-usage)
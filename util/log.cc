@@ -0,0 +1,144 @@
+#include "log.hh"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <iostream>
+#include <memory>
+
+using namespace std;
+
+namespace {
+
+// One ring slot, guarded by a sequence lock: `seq` is odd while a writer fills the slot, and
+// 2 * (position + 1) once it holds the record at `position`
+struct Slot
+{
+  atomic<uint64_t> seq { 0 };
+  LogLevel level { LogLevel::OFF };
+  uint16_t length { 0 };
+  array<char, LogLine::MAX_LENGTH> text {};
+};
+
+struct Ring
+{
+  unique_ptr<Slot[]> slots { make_unique<Slot[]>( Log::RING_CAPACITY ) }; // NOLINT(*-avoid-c-arrays)
+  atomic<uint64_t> next { 0 };
+  array<atomic<uint64_t>, static_cast<size_t>( LogLevel::OFF ) + 1> counts {};
+  atomic<uint64_t> dropped { 0 };
+  atomic<LogLevel> stderr_level { LogLevel::WARN };
+};
+
+Ring& ring()
+{
+  static Ring the_ring;
+  return the_ring;
+}
+
+} // namespace
+
+string_view to_string( const LogLevel level )
+{
+  switch ( level ) {
+    case LogLevel::TRACE:
+      return "TRACE";
+    case LogLevel::DEBUG:
+      return "DEBUG";
+    case LogLevel::INFO:
+      return "INFO";
+    case LogLevel::WARN:
+      return "WARN";
+    case LogLevel::ERROR:
+      return "ERROR";
+    case LogLevel::OFF:
+      break;
+  }
+  return "OFF";
+}
+
+void LogLine::append( const string_view str )
+{
+  const size_t n = min( str.size(), MAX_LENGTH - length_ );
+  memcpy( text_ + length_, str.data(), n );
+  length_ += n;
+}
+
+void LogLine::append( const LogIpv4 ip )
+{
+  for ( int shift = 24; shift >= 0; shift -= 8 ) {
+    append( ( ip.address >> shift ) & 0xffU );
+    if ( shift != 0 ) {
+      append( '.' );
+    }
+  }
+}
+
+void Log::write( const LogLevel level, const string_view text )
+{
+  Ring& r = ring();
+  r.counts.at( static_cast<size_t>( level ) ).fetch_add( 1, memory_order_relaxed );
+
+  const uint64_t position = r.next.fetch_add( 1, memory_order_relaxed );
+  Slot& slot = r.slots[position % RING_CAPACITY];
+
+  // Claim the slot, unless the writer of a newer record has already claimed it (this writer
+  // having been preempted for a whole lap of the ring), in which case this record is only lost
+  // to the ring a little early. A slot that another writer is still filling (odd `seq`) is not
+  // taken either, so that only one writer ever touches its record: the record is dropped (and
+  // counted by dropped()) instead.
+  uint64_t seq = slot.seq.load( memory_order_relaxed );
+  bool claimed = false;
+  while ( seq % 2 == 0 and seq < 2 * position + 1 and not claimed ) {
+    claimed = slot.seq.compare_exchange_weak( seq, 2 * position + 1, memory_order_relaxed );
+  }
+  if ( claimed ) {
+    atomic_thread_fence( memory_order_release );
+    slot.level = level;
+    slot.length = static_cast<uint16_t>( min( text.size(), slot.text.size() ) );
+    memcpy( slot.text.data(), text.data(), slot.length );
+    slot.seq.store( 2 * ( position + 1 ), memory_order_release );
+  } else if ( seq % 2 == 1 ) {
+    r.dropped.fetch_add( 1, memory_order_relaxed );
+  }
+
+  if ( level >= r.stderr_level.load( memory_order_relaxed ) ) {
+    cerr << to_string( level ) << ": " << text << "\n";
+  }
+}
+
+vector<Log::Record> Log::recent()
+{
+  Ring& r = ring();
+  const uint64_t end = r.next.load( memory_order_acquire );
+  const uint64_t begin = end > RING_CAPACITY ? end - RING_CAPACITY : 0;
+
+  vector<Record> records;
+  records.reserve( end - begin );
+  for ( uint64_t position = begin; position < end; position++ ) {
+    const Slot& slot = r.slots[position % RING_CAPACITY];
+    if ( slot.seq.load( memory_order_acquire ) != 2 * ( position + 1 ) ) {
+      continue;
+    }
+    Record record { position, slot.level, string { slot.text.data(), slot.length } };
+    atomic_thread_fence( memory_order_acquire );
+    if ( slot.seq.load( memory_order_relaxed ) == 2 * ( position + 1 ) ) {
+      records.push_back( std::move( record ) );
+    }
+  }
+  return records;
+}
+
+uint64_t Log::count( const LogLevel level )
+{
+  return ring().counts.at( static_cast<size_t>( level ) ).load( memory_order_relaxed );
+}
+
+uint64_t Log::dropped()
+{
+  return ring().dropped.load( memory_order_relaxed );
+}
+
+void Log::set_stderr_level( const LogLevel level )
+{
+  ring().stderr_level.store( level, memory_order_relaxed );
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <atomic>
+#include <charconv>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Leveled logging into an in-memory ring.
+//
+// LOG_DEBUG( "added ", count, " routes" ) formats its arguments into a fixed-size line and
+// appends it to a process-wide ring of recent records; nothing touches the heap or a file
+// descriptor unless the record is also at or above the stderr level (WARN by default).
+// Writers claim ring slots with one atomic increment, so logging from several threads does
+// not take a lock.
+//
+// Levels below LOG_MIN_LEVEL (a number from 0, TRACE, to 5, OFF; DEBUG by default) are
+// compiled out: their arguments are not even evaluated. Set it with -DLOG_MIN_LEVEL=...
+// (or the LOG_MIN_LEVEL CMake cache variable).
+
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL 1
+#endif
+
+enum class LogLevel : uint8_t
+{
+  TRACE,
+  DEBUG,
+  INFO,
+  WARN,
+  ERROR,
+  OFF,
+};
+
+constexpr bool log_enabled( const LogLevel level )
+{
+  return static_cast<int>( level ) >= LOG_MIN_LEVEL and level != LogLevel::OFF;
+}
+
+std::string_view to_string( LogLevel level );
+
+// An IPv4 address to be logged in dotted-quad form (without going through Address)
+struct LogIpv4
+{
+  uint32_t address;
+};
+
+// One line of log text, formatted in place (long lines are truncated)
+class LogLine
+{
+public:
+  static constexpr size_t MAX_LENGTH = 176;
+
+private:
+  char text_[MAX_LENGTH] {}; // NOLINT(*-avoid-c-arrays)
+  size_t length_ {};
+
+public:
+  void append( std::string_view str );
+  void append( const char* str ) { append( std::string_view { str } ); }
+  void append( const std::string& str ) { append( std::string_view { str } ); }
+  void append( char c ) { append( std::string_view { &c, 1 } ); }
+  void append( bool b ) { append( std::string_view { b ? "true" : "false" } ); }
+  void append( LogIpv4 ip );
+
+  template<std::integral T>
+  void append( T value )
+  {
+    const auto result = std::to_chars( text_ + length_, text_ + MAX_LENGTH, value );
+    length_ = result.ec == std::errc {} ? static_cast<size_t>( result.ptr - text_ ) : MAX_LENGTH;
+  }
+
+  std::string_view view() const { return { text_, length_ }; }
+};
+
+class Log
+{
+public:
+  static constexpr size_t RING_CAPACITY = 1024; // records kept, at most
+
+  struct Record
+  {
+    uint64_t sequence; // position in the stream of records (0 is the first)
+    LogLevel level;
+    std::string text;
+  };
+
+  // Append a record to the ring (and to stderr, at or above the stderr level)
+  static void write( LogLevel level, std::string_view text );
+
+  // The records still in the ring, oldest first (records being overwritten are skipped)
+  static std::vector<Record> recent();
+
+  // Records written at `level` so far, including those that have left the ring
+  static uint64_t count( LogLevel level );
+
+  // Records that never made it into the ring, because their slot was still being filled by the
+  // writer of an older record (preempted for a whole lap of the ring)
+  static uint64_t dropped();
+
+  // Also copy records at or above `level` to stderr (OFF: never)
+  static void set_stderr_level( LogLevel level );
+};
+
+template<typename... Args>
+void log_write( const LogLevel level, const Args&... args )
+{
+  LogLine line;
+  ( line.append( args ), ... );
+  Log::write( level, line.view() );
+}
+
+// NOLINTBEGIN(*-macro-usage)
+#define LOG_AT( level, ... )                                                                                     \
+  do {                                                                                                           \
+    if constexpr ( log_enabled( level ) ) {                                                                      \
+      log_write( level, __VA_ARGS__ );                                                                           \
+    }                                                                                                            \
+  } while ( false )
+
+#define LOG_TRACE( ... ) LOG_AT( LogLevel::TRACE, __VA_ARGS__ )
+#define LOG_DEBUG( ... ) LOG_AT( LogLevel::DEBUG, __VA_ARGS__ )
+#define LOG_INFO( ... ) LOG_AT( LogLevel::INFO, __VA_ARGS__ )
+#define LOG_WARN( ... ) LOG_AT( LogLevel::WARN, __VA_ARGS__ )
+#define LOG_ERROR( ... ) LOG_AT( LogLevel::ERROR, __VA_ARGS__ )
+// NOLINTEND(*-macro-usage)
@@ -0,0 +1,29 @@
+#include "mapped_file.hh"
+#include "exception.hh"
+
+#include <sys/mman.h>
+
+using namespace std;
+
+MappedFile::MappedFile( const FileDescriptor& fd ) : size_( fd.size() )
+{
+  if ( size_ == 0 ) {
+    return;
+  }
+
+  void* const mapping = mmap( nullptr, size_, PROT_READ, MAP_PRIVATE, fd.fd_num(), 0 );
+  if ( mapping == MAP_FAILED ) { // NOLINT(*-cstyle-cast)
+    throw unix_error { "mmap" };
+  }
+  data_ = static_cast<const char*>( mapping );
+
+  // the file is read front to back, once
+  madvise( mapping, size_, MADV_SEQUENTIAL );
+}
+
+MappedFile::~MappedFile()
+{
+  if ( data_ != nullptr ) {
+    munmap( const_cast<char*>( data_ ), size_ ); // NOLINT(*-const-cast)
+  }
+}
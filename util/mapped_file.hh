@@ -0,0 +1,28 @@
+#pragma once
+
+#include "file_descriptor.hh"
+
+#include <cstddef>
+#include <string_view>
+
+// A read-only, private memory mapping of a whole file (see mmap(2)).
+//
+// The mapping stays valid after the FileDescriptor it was made from is closed, and is unmapped
+// when the MappedFile is destroyed. An empty file maps to an empty view.
+class MappedFile
+{
+  const char* data_ { nullptr };
+  size_t size_ { 0 };
+
+public:
+  explicit MappedFile( const FileDescriptor& fd );
+  ~MappedFile();
+
+  // The file's contents
+  std::string_view view() const { return { data_, size_ }; }
+
+  MappedFile( const MappedFile& other ) = delete;
+  MappedFile& operator=( const MappedFile& other ) = delete;
+  MappedFile( MappedFile&& other ) = delete;
+  MappedFile& operator=( MappedFile&& other ) = delete;
+};
@@ -0,0 +1,120 @@
+#include "ndp_message.hh"
+#include "checksum.hh"
+#include "header_codec.hh"
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+
+using Layout = codec::Layout<NDPMessage::LENGTH,
+                             codec::Scalar<&NDPMessage::type, 0>,
+                             codec::Scalar<&NDPMessage::code, 1>,
+                             codec::Scalar<&NDPMessage::checksum, 2>,
+                             codec::Packed<uint32_t,
+                                           4,
+                                           codec::Bits<&NDPMessage::router, 31, 1>,
+                                           codec::Bits<&NDPMessage::solicited, 30, 1>,
+                                           codec::Bits<&NDPMessage::override_address, 29, 1>>,
+                             codec::Bytes<&NDPMessage::target, 8>>;
+
+// The option that carries a message's link-layer address
+uint8_t addressOption( const uint8_t type )
+{
+  return type == NDPMessage::TYPE_NEIGHBOR_SOLICITATION ? NDPMessage::OPTION_SOURCE_LINK_LAYER_ADDRESS
+                                                        : NDPMessage::OPTION_TARGET_LINK_LAYER_ADDRESS;
+}
+
+} // namespace
+
+bool NDPMessage::supported() const
+{
+  return ( type == TYPE_NEIGHBOR_SOLICITATION or type == TYPE_NEIGHBOR_ADVERTISEMENT ) and code == 0;
+}
+
+void NDPMessage::compute_checksum( const IPv6Header& header )
+{
+  checksum = 0;
+  InternetChecksum check { header.pseudo_checksum() };
+  check.add( ::serialize( *this ) );
+  checksum = check.value();
+}
+
+// A message that includes its own correct checksum sums (with the pseudo-header) to 0xffff
+bool NDPMessage::checksum_ok( const IPv6Header& header, const string_view raw_message )
+{
+  InternetChecksum check { header.pseudo_checksum() };
+  check.add( raw_message );
+  return check.value() == 0;
+}
+
+string NDPMessage::to_string() const
+{
+  stringstream ss {};
+  ss << ( type == TYPE_NEIGHBOR_SOLICITATION ? "SOLICITATION" : "ADVERTISEMENT" ) << ", target=" << ::to_string( target );
+  if ( link_layer_address.has_value() ) {
+    ss << ", link-layer address=" << ::to_string( *link_layer_address );
+  }
+  if ( solicited ) {
+    ss << ", solicited";
+  }
+  return ss.str();
+}
+
+void NDPMessage::parse( Parser& parser )
+{
+  Layout::read( parser, *this, [this]( const uint8_t* ) { return supported(); } );
+
+  // Options: (type, length in units of 8 bytes, value); only the link-layer address is kept
+  link_layer_address.reset();
+  while ( not parser.has_error() and parser.input().size() > 0 ) {
+    uint8_t option = 0;
+    uint8_t length = 0;
+    parser.integer( option );
+    parser.integer( length );
+    if ( length == 0 or length * OPTION_LENGTH - 2 > parser.input().size() ) {
+      parser.set_error(); // (an empty option would never end)
+      return;
+    }
+    if ( option == addressOption( type ) and length * OPTION_LENGTH == OPTION_LENGTH ) {
+      EthernetAddress address {};
+      parser.string( { reinterpret_cast<char*>( address.data() ), address.size() } ); // NOLINT(*-cast)
+      link_layer_address = address;
+    } else {
+      parser.remove_prefix( length * OPTION_LENGTH - 2 );
+    }
+  }
+}
+
+void NDPMessage::serialize( Serializer& serializer ) const
+{
+  if ( not supported() ) {
+    throw runtime_error( "NDPMessage: unsupported type (must be a neighbor solicitation or advertisement)" );
+  }
+
+  Layout::write( serializer, *this );
+  if ( link_layer_address.has_value() ) {
+    uint8_t* const option = serializer.fixed( OPTION_LENGTH );
+    option[0] = addressOption( type );
+    option[1] = 1; // (units of 8 bytes)
+    std::copy( link_layer_address->begin(), link_layer_address->end(), option + 2 );
+  }
+}
+
+IPv6Address solicited_node_address( const IPv6Address& address )
+{
+  IPv6Address multicast { 0xff, 0x02, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x01, 0xff };
+  std::copy( address.end() - 3, address.end(), multicast.end() - 3 );
+  return multicast;
+}
+
+EthernetAddress ethernet_multicast_address( const IPv6Address& multicast )
+{
+  // 33:33 and the last 32 bits of the address (RFC 2464, section 7)
+  EthernetAddress ethernet { 0x33, 0x33 };
+  std::copy( multicast.end() - 4, multicast.end(), ethernet.begin() + 2 );
+  return ethernet;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "ethernet_header.hh"
+#include "ipv6_header.hh"
+#include "parser.hh"
+
+#include <optional>
+#include <string_view>
+
+// [NDP](\ref rfc::rfc4861) neighbor solicitation or advertisement (the ICMPv6 messages that
+// resolve an IPv6 address to an Ethernet address, as ARP does for IPv4), with its link-layer
+// address option. Other options are skipped when parsing.
+struct NDPMessage
+{
+  static constexpr size_t LENGTH = 24;         // message length in bytes, without options
+  static constexpr size_t OPTION_LENGTH = 8;   // length of an Ethernet link-layer address option
+  static constexpr uint8_t TYPE_NEIGHBOR_SOLICITATION = 135;
+  static constexpr uint8_t TYPE_NEIGHBOR_ADVERTISEMENT = 136;
+  static constexpr uint8_t OPTION_SOURCE_LINK_LAYER_ADDRESS = 1;
+  static constexpr uint8_t OPTION_TARGET_LINK_LAYER_ADDRESS = 2;
+  static constexpr uint8_t HOP_LIMIT = 255;    // the only hop limit an NDP message is sent (and accepted) with
+
+  uint8_t type {};       // solicitation or advertisement
+  uint8_t code {};       // always 0
+  uint16_t checksum {};  // ICMPv6 checksum, over the IPv6 pseudo-header and the message
+  bool router {};        // (advertisement) the sender is a router
+  bool solicited {};     // (advertisement) in reply to a solicitation
+  bool override_address {}; // (advertisement) replace a cached link-layer address
+  IPv6Address target {}; // the address being resolved
+
+  // The sender's Ethernet address (a solicitation's source option) or the target's (an
+  // advertisement's target option), if the message has one
+  std::optional<EthernetAddress> link_layer_address {};
+
+  // Is this type of message supported by the parser?
+  bool supported() const;
+
+  // Length of the serialized message
+  uint64_t serialized_length() const { return LENGTH + ( link_layer_address.has_value() ? OPTION_LENGTH : 0 ); }
+
+  // Set the checksum to the correct value for a message carried by a datagram with `header`
+  // (whose payload_length must already be serialized_length())
+  void compute_checksum( const IPv6Header& header );
+
+  // Verify the checksum of a raw (serialized) message carried by a datagram with `header`
+  static bool checksum_ok( const IPv6Header& header, std::string_view raw_message );
+
+  // Return a string containing the message in human-readable format
+  std::string to_string() const;
+
+  void parse( Parser& parser );
+  void serialize( Serializer& serializer ) const;
+};
+
+// The solicited-node multicast address of `address` (ff02::1:ff00:0/104 and its last 24 bits),
+// that solicitations for it are sent to, and the Ethernet multicast address that it maps to
+IPv6Address solicited_node_address( const IPv6Address& address );
+EthernetAddress ethernet_multicast_address( const IPv6Address& multicast );
@@ -0,0 +1,136 @@
+#include "packet_pool.hh"
+
+using namespace std;
+
+struct PacketPool::State
+{
+  size_t buffer_size;
+  size_t max_free;
+  thread::id owner { this_thread::get_id() };
+
+  vector<string> free_strings {};                // empty strings that still own their capacity
+  vector<unique_ptr<string>> free_shells {};     // string objects for wrap() to fill
+  size_t block_size {};                          // size of the control blocks on free_blocks
+  vector<void*> free_blocks {};                  // shared_ptr control blocks
+  Stats stats {};
+
+  State( size_t size, size_t max ) : buffer_size( size ), max_free( max ) {}
+
+  bool on_owner_thread() const { return this_thread::get_id() == owner; }
+
+  void recycle( string&& str )
+  {
+    if ( str.capacity() < buffer_size or free_strings.size() >= max_free ) {
+      return;
+    }
+    str.clear();
+    free_strings.push_back( std::move( str ) );
+    stats.recycled++;
+  }
+
+  ~State()
+  {
+    for ( void* block : free_blocks ) {
+      ::operator delete( block );
+    }
+  }
+
+  State( const State& other ) = delete;
+  State& operator=( const State& other ) = delete;
+  State( State&& other ) = delete;
+  State& operator=( State&& other ) = delete;
+};
+
+PacketPool::PacketPool( const size_t buffer_size, const size_t max_free )
+  : state_( make_shared<State>( buffer_size, max_free ) )
+{}
+
+PacketPool& PacketPool::local()
+{
+  thread_local PacketPool pool;
+  return pool;
+}
+
+size_t PacketPool::buffer_size() const
+{
+  return state_->buffer_size;
+}
+
+PacketPool::Stats PacketPool::stats() const
+{
+  return state_->stats;
+}
+
+string PacketPool::take()
+{
+  State& state = *state_;
+  state.stats.allocations++;
+
+  if ( not state.free_strings.empty() ) {
+    string str = std::move( state.free_strings.back() );
+    state.free_strings.pop_back();
+    state.stats.reused++;
+    return str;
+  }
+
+  string str;
+  str.reserve( state.buffer_size );
+  return str;
+}
+
+void PacketPool::recycle( string&& str )
+{
+  state_->recycle( std::move( str ) );
+}
+
+shared_ptr<string> PacketPool::wrap( string&& str )
+{
+  State& state = *state_;
+
+  unique_ptr<string> shell;
+  if ( state.free_shells.empty() ) {
+    shell = make_unique<string>( std::move( str ) );
+  } else {
+    shell = std::move( state.free_shells.back() );
+    state.free_shells.pop_back();
+    *shell = std::move( str );
+  }
+
+  return { shell.release(), Recycler { state_ }, BlockAllocator<string> { state_ } };
+}
+
+void PacketPool::Recycler::operator()( string* const str ) const
+{
+  unique_ptr<string> shell { str };
+  const shared_ptr<State> state = pool.lock();
+  if ( not state or not state->on_owner_thread() ) {
+    return;
+  }
+
+  state->recycle( std::move( *shell ) );
+  if ( state->free_shells.size() < state->max_free ) {
+    state->free_shells.push_back( std::move( shell ) );
+  }
+}
+
+void* PacketPool::allocate_block( const shared_ptr<State>& state, const size_t size )
+{
+  if ( state and state->block_size == size and not state->free_blocks.empty() ) {
+    void* block = state->free_blocks.back();
+    state->free_blocks.pop_back();
+    return block;
+  }
+  return ::operator new( size );
+}
+
+void PacketPool::deallocate_block( const weak_ptr<State>& pool, void* const block, const size_t size )
+{
+  const shared_ptr<State> state = pool.lock();
+  if ( state and state->on_owner_thread() and state->free_blocks.size() < state->max_free
+       and ( state->block_size == 0 or state->block_size == size ) ) {
+    state->block_size = size;
+    state->free_blocks.push_back( block );
+    return;
+  }
+  ::operator delete( block );
+}
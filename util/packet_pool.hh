@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// A pool of fixed-capacity packet buffers (in the spirit of BSD mbufs).
+//
+// Buffers handed out by allocate() are empty std::strings whose capacity is already
+// `buffer_size` bytes. When the last reference goes away, the string (with its capacity)
+// and its shared_ptr control block go back onto this pool's free lists instead of to the
+// heap allocator, so a steady stream of packets stops touching malloc once the pool is warm.
+//
+// A pool has one owning thread (the one that created it): only that thread may allocate
+// from it, and buffers released on any other thread are simply freed. PacketPool::local()
+// returns a pool owned by the calling thread.
+//
+// PacketPool is a cheap handle: copies refer to the same pool.
+class PacketPool
+{
+public:
+  static constexpr size_t DEFAULT_BUFFER_SIZE = 2048; // a full Ethernet frame, with headroom
+  static constexpr size_t DEFAULT_MAX_FREE = 4096;    // buffers kept on the free list, at most
+
+  struct Stats
+  {
+    uint64_t allocations; // buffers handed out
+    uint64_t reused;      // ... of which came from the free list
+    uint64_t recycled;    // buffers returned to the free list
+  };
+
+private:
+  struct State;
+
+  // Returns a string to its pool (or frees it) when the last Buffer referring to it goes away
+  struct Recycler
+  {
+    std::weak_ptr<State> pool;
+    void operator()( std::string* str ) const;
+  };
+
+  // Allocates the shared_ptr control blocks of pooled buffers from the pool's block free list
+  template<typename T>
+  struct BlockAllocator
+  {
+    using value_type = T;
+
+    std::weak_ptr<State> pool;
+
+    explicit BlockAllocator( std::weak_ptr<State> p ) : pool( std::move( p ) ) {}
+    template<typename U>
+    BlockAllocator( const BlockAllocator<U>& other ) : pool( other.pool ) // NOLINT(*-explicit-*)
+    {}
+
+    T* allocate( size_t n );
+    void deallocate( T* p, size_t n );
+
+    template<typename U>
+    bool operator==( const BlockAllocator<U>& other ) const
+    {
+      return not pool.owner_before( other.pool ) and not other.pool.owner_before( pool );
+    }
+  };
+
+  std::shared_ptr<State> state_;
+
+  static void* allocate_block( const std::shared_ptr<State>& state, size_t size );
+  static void deallocate_block( const std::weak_ptr<State>& pool, void* block, size_t size );
+
+public:
+  explicit PacketPool( size_t buffer_size = DEFAULT_BUFFER_SIZE, size_t max_free = DEFAULT_MAX_FREE );
+
+  // The calling thread's own pool
+  static PacketPool& local();
+
+  // An empty string with at least buffer_size() bytes of capacity, to be filled by the caller
+  std::string take();
+
+  // Share a string, so that it (with its capacity) returns to the pool when released
+  std::shared_ptr<std::string> wrap( std::string&& str );
+
+  // An empty pooled buffer with at least buffer_size() bytes of capacity: wrap( take() )
+  std::shared_ptr<std::string> allocate() { return wrap( take() ); }
+
+  // Give a string's capacity to the pool (e.g. a scratch buffer that is no longer needed)
+  void recycle( std::string&& str );
+
+  size_t buffer_size() const;
+  Stats stats() const;
+};
+
+template<typename T>
+T* PacketPool::BlockAllocator<T>::allocate( const size_t n )
+{
+  if ( n != 1 ) {
+    return std::allocator<T> {}.allocate( n );
+  }
+  return static_cast<T*>( allocate_block( pool.lock(), sizeof( T ) ) );
+}
+
+template<typename T>
+void PacketPool::BlockAllocator<T>::deallocate( T* p, const size_t n )
+{
+  if ( n != 1 ) {
+    std::allocator<T> {}.deallocate( p, n );
+    return;
+  }
+  deallocate_block( pool, p, sizeof( T ) );
+}
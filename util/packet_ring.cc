@@ -0,0 +1,208 @@
+#include "packet_ring.hh"
+
+#include "exception.hh"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include <net/if.h>
+#include <poll.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+// Where a frame's bytes start in a TX slot
+constexpr size_t TX_DATA_OFFSET = TPACKET3_HDRLEN - sizeof( sockaddr_ll );
+
+template<typename T>
+void set_packet_option( const PacketSocket& socket, const int option, const T& value )
+{
+  CheckSystemCall( "setsockopt", ::setsockopt( socket.fd_num(), SOL_PACKET, option, &value, sizeof( value ) ) );
+}
+
+} // namespace
+
+PacketRing::PacketRing( const string& device ) : PacketRing( device, Config {} ) {}
+
+PacketRing::PacketRing( const string& device, const Config& config )
+  : socket_( SOCK_RAW, htons( ETH_P_ALL ) ), config_( config )
+{
+  const auto page_size = static_cast<size_t>( sysconf( _SC_PAGESIZE ) );
+  if ( config_.rx_block_size % page_size != 0 or config_.tx_frame_size % TPACKET_ALIGNMENT != 0
+       or config_.tx_frame_size <= TX_DATA_OFFSET ) {
+    throw runtime_error( "PacketRing: bad ring geometry" );
+  }
+
+  sockaddr_ll address {};
+  address.sll_family = AF_PACKET;
+  address.sll_protocol = htons( ETH_P_ALL );
+  address.sll_ifindex = static_cast<int>( if_nametoindex( device.c_str() ) );
+  if ( address.sll_ifindex == 0 ) {
+    throw unix_error { "if_nametoindex " + device };
+  }
+
+  set_packet_option( socket_, PACKET_VERSION, int { TPACKET_V3 } );
+
+  // RX: blocks of frames, each block handed over when it is full or has waited long enough
+  tpacket_req3 rx {};
+  rx.tp_block_size = static_cast<unsigned int>( config_.rx_block_size );
+  rx.tp_block_nr = static_cast<unsigned int>( config_.rx_block_count );
+  rx.tp_frame_size = TPACKET_ALIGNMENT << 7; // (only checked by the kernel, for V3)
+  rx.tp_frame_nr = rx.tp_block_size / rx.tp_frame_size * rx.tp_block_nr;
+  rx.tp_retire_blk_tov = config_.rx_block_timeout_ms;
+  set_packet_option( socket_, PACKET_RX_RING, rx );
+
+  // TX: fixed-size slots, packed into page-multiple blocks
+  tx_block_size_ = ( config_.tx_frame_size + page_size - 1 ) / page_size * page_size;
+  tx_frames_per_block_ = tx_block_size_ / config_.tx_frame_size;
+  const size_t tx_blocks = ( max<size_t>( config_.tx_frame_count, 1 ) + tx_frames_per_block_ - 1 ) / tx_frames_per_block_;
+  tx_frame_count_ = tx_blocks * tx_frames_per_block_;
+  tpacket_req3 tx {};
+  tx.tp_block_size = static_cast<unsigned int>( tx_block_size_ );
+  tx.tp_block_nr = static_cast<unsigned int>( tx_blocks );
+  tx.tp_frame_size = static_cast<unsigned int>( config_.tx_frame_size );
+  tx.tp_frame_nr = static_cast<unsigned int>( tx_frame_count_ );
+  set_packet_option( socket_, PACKET_TX_RING, tx );
+
+  if ( config_.ignore_outgoing ) {
+    set_packet_option( socket_, PACKET_IGNORE_OUTGOING, int { 1 } );
+  }
+
+  ring_size_ = config_.rx_block_size * config_.rx_block_count + tx_block_size_ * tx_blocks;
+  void* const ring = mmap( nullptr, ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, socket_.fd_num(), 0 );
+  if ( ring == MAP_FAILED ) { // NOLINT(*-cstyle-cast)
+    throw unix_error { "mmap" };
+  }
+  ring_ = static_cast<char*>( ring );
+
+  try {
+    socket_.bind( Address { reinterpret_cast<const sockaddr*>( &address ), sizeof( address ) } ); // NOLINT(*-reinterpret-cast)
+  } catch ( ... ) {
+    munmap( ring_, ring_size_ );
+    throw;
+  }
+}
+
+PacketRing::~PacketRing()
+{
+  munmap( ring_, ring_size_ );
+}
+
+tpacket_block_desc* PacketRing::rxBlock( const size_t index ) const
+{
+  return reinterpret_cast<tpacket_block_desc*>( ring_ + index * config_.rx_block_size ); // NOLINT(*-reinterpret-cast)
+}
+
+tpacket3_hdr* PacketRing::txSlot( const size_t index ) const
+{
+  char* const tx_ring = ring_ + config_.rx_block_size * config_.rx_block_count;
+  char* const slot = tx_ring + index / tx_frames_per_block_ * tx_block_size_
+                     + index % tx_frames_per_block_ * config_.tx_frame_size;
+  return reinterpret_cast<tpacket3_hdr*>( slot ); // NOLINT(*-reinterpret-cast)
+}
+
+optional<PacketRing::Block> PacketRing::next_block()
+{
+  tpacket_block_desc* const desc = rxBlock( rx_next_ );
+  if ( ( __atomic_load_n( &desc->hdr.bh1.block_status, __ATOMIC_ACQUIRE ) & TP_STATUS_USER ) == 0 ) {
+    return {};
+  }
+  rx_next_ = ( rx_next_ + 1 ) % config_.rx_block_count;
+  return Block { desc };
+}
+
+bool PacketRing::wait( const int timeout_ms )
+{
+  if ( __atomic_load_n( &rxBlock( rx_next_ )->hdr.bh1.block_status, __ATOMIC_ACQUIRE ) & TP_STATUS_USER ) {
+    return true;
+  }
+  pollfd fd { socket_.fd_num(), POLLIN | POLLERR, 0 };
+  return CheckSystemCall( "poll", ::poll( &fd, 1, timeout_ms ) ) > 0;
+}
+
+bool PacketRing::send( const vector<Buffer>& frame )
+{
+  size_t length = 0;
+  for ( const auto& piece : frame ) {
+    length += piece.size();
+  }
+  if ( length > max_frame_size() ) {
+    throw runtime_error( "PacketRing: frame of " + to_string( length ) + " bytes is too big for a TX slot" );
+  }
+
+  tpacket3_hdr* const slot = txSlot( tx_next_ );
+  const uint32_t status = __atomic_load_n( &slot->tp_status, __ATOMIC_ACQUIRE );
+  if ( status != TP_STATUS_AVAILABLE and ( status & TP_STATUS_WRONG_FORMAT ) == 0 ) {
+    return false; // the kernel has not transmitted this slot's last frame yet
+  }
+
+  char* out = reinterpret_cast<char*>( slot ) + TX_DATA_OFFSET; // NOLINT(*-reinterpret-cast)
+  for ( const auto& piece : frame ) {
+    const string_view bytes = piece;
+    memcpy( out, bytes.data(), bytes.size() );
+    out += bytes.size();
+  }
+  slot->tp_len = static_cast<uint32_t>( length );
+  slot->tp_snaplen = static_cast<uint32_t>( length );
+  slot->tp_next_offset = 0;
+  __atomic_store_n( &slot->tp_status, TP_STATUS_SEND_REQUEST, __ATOMIC_RELEASE );
+
+  tx_next_ = ( tx_next_ + 1 ) % tx_frame_count_;
+  tx_queued_ = true;
+  return true;
+}
+
+void PacketRing::flush()
+{
+  if ( not tx_queued_ ) {
+    return;
+  }
+  if ( ::send( socket_.fd_num(), nullptr, 0, MSG_DONTWAIT ) < 0 and errno != EAGAIN and errno != ENOBUFS ) {
+    throw unix_error { "send (TX ring)" };
+  }
+  tx_queued_ = false;
+}
+
+size_t PacketRing::max_frame_size() const
+{
+  return config_.tx_frame_size - TX_DATA_OFFSET;
+}
+
+PacketRing::Block::~Block()
+{
+  if ( desc_ != nullptr ) {
+    __atomic_store_n( &desc_->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE );
+  }
+}
+
+string_view PacketRing::Block::iterator::operator*() const
+{
+  return { reinterpret_cast<const char*>( frame_ ) + frame_->tp_mac, frame_->tp_snaplen }; // NOLINT(*-reinterpret-cast)
+}
+
+PacketRing::Block::iterator& PacketRing::Block::iterator::operator++()
+{
+  remaining_--;
+  frame_ = reinterpret_cast<const tpacket3_hdr*>( reinterpret_cast<const char*>( frame_ ) // NOLINT(*-reinterpret-cast)
+                                                  + frame_->tp_next_offset );
+  return *this;
+}
+
+PacketRing::Block::iterator PacketRing::Block::begin() const
+{
+  const char* const block = reinterpret_cast<const char*>( desc_ ); // NOLINT(*-reinterpret-cast)
+  return { reinterpret_cast<const tpacket3_hdr*>( block + desc_->hdr.bh1.offset_to_first_pkt ), // NOLINT(*-reinterpret-cast)
+           desc_->hdr.bh1.num_pkts };
+}
+
+size_t PacketRing::Block::size() const
+{
+  return desc_->hdr.bh1.num_pkts;
+}
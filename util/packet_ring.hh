@@ -0,0 +1,130 @@
+#pragma once
+
+#include "buffer.hh"
+#include "socket.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct tpacket_block_desc;
+struct tpacket3_hdr;
+
+// A packet socket with TPACKET_V3 receive and transmit rings shared with the kernel (see
+// the kernel's packet_mmap documentation).
+//
+// Received frames are written by the kernel straight into the RX ring, in blocks of several
+// frames, and are read from there in place: next_block() returns the next block the kernel has
+// handed over, whose frames are views into the ring, and the block goes back to the kernel when
+// that Block is destroyed. Frames to send are copied (gathered from their pieces) straight into
+// slots of the TX ring by send(), and flush() tells the kernel to transmit everything queued
+// with one system call.
+//
+// A PacketRing is used by one thread. Opening one needs CAP_NET_RAW.
+class PacketRing
+{
+public:
+  struct Config
+  {
+    size_t rx_block_size = 1 << 18;  // bytes per RX block (a multiple of the page size)
+    size_t rx_block_count = 16;      // RX blocks
+    uint32_t rx_block_timeout_ms = 1; // a partly filled block is handed over after this long
+    size_t tx_frame_size = 2048;     // bytes per TX slot, including the kernel's header
+    size_t tx_frame_count = 512;     // TX slots
+    bool ignore_outgoing = true;     // leave this socket's own (and the host's) outgoing frames out of the RX ring
+  };
+
+  // One block of received frames, lent by the kernel until the Block is destroyed
+  class Block
+  {
+    tpacket_block_desc* desc_;
+
+  public:
+    explicit Block( tpacket_block_desc* desc ) : desc_( desc ) {}
+    ~Block();
+
+    Block( const Block& other ) = delete;
+    Block& operator=( const Block& other ) = delete;
+    Block( Block&& other ) noexcept : desc_( other.desc_ ) { other.desc_ = nullptr; }
+    Block& operator=( Block&& other ) = delete;
+
+    // Iterates over the block's frames (as views into the ring)
+    class iterator
+    {
+      const tpacket3_hdr* frame_;
+      uint32_t remaining_;
+
+    public:
+      iterator( const tpacket3_hdr* frame, uint32_t remaining ) : frame_( frame ), remaining_( remaining ) {}
+      std::string_view operator*() const;
+      iterator& operator++();
+      bool operator==( const iterator& other ) const { return remaining_ == other.remaining_; }
+    };
+
+    iterator begin() const;
+    iterator end() const { return { nullptr, 0 }; }
+    size_t size() const;
+  };
+
+  // Open a ring on network device `device` (e.g. "eth0"), receiving and sending every protocol
+  explicit PacketRing( const std::string& device );
+  PacketRing( const std::string& device, const Config& config );
+  ~PacketRing();
+
+  PacketRing( const PacketRing& other ) = delete;
+  PacketRing& operator=( const PacketRing& other ) = delete;
+  PacketRing( PacketRing&& other ) = delete;
+  PacketRing& operator=( PacketRing&& other ) = delete;
+
+  // The next block of received frames, if the kernel has handed one over
+  std::optional<Block> next_block();
+
+  // Call `on_frame( std::string_view )` for every frame of every block that the kernel has handed
+  // over (returning each block to it afterwards); returns the number of frames
+  template<class F>
+  size_t receive( F&& on_frame )
+  {
+    size_t count = 0;
+    while ( const auto block = next_block() ) {
+      for ( const std::string_view frame : *block ) {
+        on_frame( frame );
+        count++;
+      }
+    }
+    return count;
+  }
+
+  // Wait up to `timeout_ms` (or forever, if negative) for a block to be handed over
+  bool wait( int timeout_ms );
+
+  // Copy a frame (gathered from its pieces) into the next free TX slot. Returns false, and
+  // queues nothing, if every slot is still waiting to be transmitted; throws if the frame is
+  // bigger than max_frame_size().
+  bool send( const std::vector<Buffer>& frame );
+
+  // Have the kernel transmit every frame queued by send() (without waiting for it to finish)
+  void flush();
+
+  // Largest frame that send() takes
+  size_t max_frame_size() const;
+
+  PacketSocket& socket() { return socket_; }
+
+private:
+  PacketSocket socket_;
+  Config config_;
+  size_t tx_block_size_ {};
+  size_t tx_frames_per_block_ {};
+  size_t tx_frame_count_ {};
+  char* ring_ { nullptr }; // the RX ring, followed by the TX ring
+  size_t ring_size_ {};
+  size_t rx_next_ {}; // next RX block to look at
+  size_t tx_next_ {}; // next TX slot to fill
+  bool tx_queued_ {}; // send() has queued frames since the last flush()
+
+  tpacket_block_desc* rxBlock( size_t index ) const;
+  tpacket3_hdr* txSlot( size_t index ) const;
+};
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "buffer.hh"
+#include "packet_pool.hh"
 
 #include <algorithm>
 #include <concepts>
@@ -8,6 +9,7 @@
 #include <cstring>
 #include <deque>
 #include <numeric>
+#include <optional>
 #include <span>
 #include <stdexcept>
 #include <string>
@@ -65,18 +67,17 @@ class Parser
       if ( empty() ) {
         return;
       }
-      std::string first_str = std::move( buffer_.front() );
-      if ( skip_ ) {
-        first_str = first_str.substr( skip_ );
-      }
-      out.emplace_back( std::move( first_str ) );
+      // The first buffer is sliced past the bytes already parsed (no copy)
+      Buffer first = std::move( buffer_.front() );
+      first.remove_prefix( skip_ );
+      out.push_back( std::move( first ) );
       buffer_.pop_front();
       for ( auto&& x : buffer_ ) {
         out.emplace_back( std::move( x ) );
       }
     }
 
-    void dump_all( Buffer& out )
+    void dump_all( Buffer& out, std::optional<PacketPool>& pool )
     {
       std::vector<Buffer> concat;
       dump_all( concat );
@@ -85,10 +86,11 @@ class Parser
         return;
       }
 
-      out.release().clear();
+      std::string joined = pool ? pool->take() : std::string {};
       for ( const auto& s : concat ) {
-        out.release().append( s );
+        joined.append( s );
       }
+      out = pool ? Buffer { pool->wrap( std::move( joined ) ) } : Buffer { std::move( joined ) };
     }
 
     void append( Buffer str )
@@ -100,6 +102,7 @@ class Parser
 
   BufferList input_;
   bool error_ {};
+  std::optional<PacketPool> pool_ {};
 
   void check_size( const size_t size )
   {
@@ -111,12 +114,26 @@ class Parser
 public:
   explicit Parser( const std::vector<Buffer>& input ) : input_( input ) {}
 
+  // Opt-in: any bytes the parser has to copy into a new Buffer are allocated from `pool`
+  Parser( const std::vector<Buffer>& input, PacketPool pool ) : input_( input ), pool_( std::move( pool ) ) {}
+
   const BufferList& input() const { return input_; }
 
   bool has_error() const { return error_; }
   void set_error() { error_ = true; }
   void remove_prefix( size_t n ) { input_.remove_prefix( n ); }
 
+  // If the next `len` bytes are all in the first buffer, returns a pointer to them (for fixed-layout
+  // decoding); otherwise (or after an error) returns nullptr and the caller falls back to integer().
+  const uint8_t* contiguous( const size_t len ) const
+  {
+    if ( has_error() or input_.size() < len ) {
+      return nullptr;
+    }
+    const std::string_view first = input_.peek();
+    return first.size() >= len ? reinterpret_cast<const uint8_t*>( first.data() ) : nullptr; // NOLINT(*-cast)
+  }
+
   template<std::unsigned_integral T>
   void integer( T& out )
   {
@@ -155,18 +172,55 @@ public:
   }
 
   void all_remaining( std::vector<Buffer>& out ) { input_.dump_all( out ); }
-  void all_remaining( Buffer& out ) { input_.dump_all( out ); }
+  void all_remaining( Buffer& out ) { input_.dump_all( out, pool_ ); }
 };
 
 class Serializer
 {
   std::vector<Buffer> output_ {};
   std::string buffer_ {};
+  std::optional<PacketPool> pool_ {};
 
 public:
+  // Buffers up to this size are copied into the current header region instead of being
+  // referenced, so a small header or payload does not become a separate Buffer of its own
+  static constexpr size_t COALESCE_LIMIT = 64;
+
   Serializer() = default;
   explicit Serializer( std::string&& buffer ) : buffer_( std::move( buffer ) ) {}
 
+  // Opt-in: header regions are written into buffers from `pool`, and return there when released
+  explicit Serializer( PacketPool pool ) : buffer_( pool.take() ), pool_( std::move( pool ) ) {}
+
+  ~Serializer()
+  {
+    if ( pool_ ) {
+      pool_->recycle( std::move( buffer_ ) );
+    }
+  }
+
+  Serializer( const Serializer& other ) = delete;
+  Serializer& operator=( const Serializer& other ) = delete;
+  Serializer( Serializer&& other ) = delete;
+  Serializer& operator=( Serializer&& other ) = delete;
+
+  // Sized mode: preallocate room for `len` more bytes of headers, so that a run of headers
+  // is written into one allocation
+  void reserve( const size_t len ) { buffer_.reserve( buffer_.size() + len ); }
+
+  // Room needed to coalesce the leading small pieces of a payload into the header region
+  static size_t coalesced_length( const std::vector<Buffer>& bufs )
+  {
+    size_t len = 0;
+    for ( const auto& b : bufs ) {
+      if ( b.size() > COALESCE_LIMIT ) {
+        break;
+      }
+      len += b.size();
+    }
+    return len;
+  }
+
   template<std::unsigned_integral T>
   void integer( const T& val )
   {
@@ -178,12 +232,35 @@ public:
     }
   }
 
+  // Append `len` bytes to the current header region, and return them for a fixed-layout encoder
+  // to fill in (valid until the next call on the serializer)
+  uint8_t* fixed( const size_t len )
+  {
+    const size_t start = buffer_.size();
+    buffer_.resize( start + len );
+    return reinterpret_cast<uint8_t*>( buffer_.data() + start ); // NOLINT(*-cast)
+  }
+
   void buffer( const Buffer& buf )
   {
+    if ( buf.size() <= COALESCE_LIMIT ) {
+      buffer_.append( std::string_view { buf } );
+      return;
+    }
     flush();
     output_.push_back( buf );
   }
 
+  void buffer( Buffer&& buf )
+  {
+    if ( buf.size() <= COALESCE_LIMIT ) {
+      buffer_.append( std::string_view { buf } );
+      return;
+    }
+    flush();
+    output_.push_back( std::move( buf ) );
+  }
+
   void buffer( const std::vector<Buffer>& bufs )
   {
     for ( const auto& b : bufs ) {
@@ -193,6 +270,21 @@ public:
 
   void flush()
   {
+    if ( buffer_.empty() ) {
+      return;
+    }
+    // A small region (e.g. the headers of an ARP message) is copied inline, and buffer_ keeps
+    // its capacity for the next one
+    if ( buffer_.size() <= Buffer::INLINE_CAPACITY ) {
+      output_.push_back( Buffer::copy_of( buffer_ ) );
+      buffer_.clear();
+      return;
+    }
+    if ( pool_ ) {
+      output_.emplace_back( pool_->wrap( std::move( buffer_ ) ) );
+      buffer_ = pool_->take();
+      return;
+    }
     output_.emplace_back( std::move( buffer_ ) );
     buffer_.clear();
   }
@@ -200,7 +292,7 @@ public:
   std::vector<Buffer> output()
   {
     flush();
-    return output_;
+    return std::move( output_ );
   }
 };
 
@@ -209,6 +301,21 @@ template<class T>
 std::vector<Buffer> serialize( const T& obj )
 {
   Serializer s;
+  if constexpr ( requires { T::serialized_length(); } ) {
+    s.reserve( T::serialized_length() );
+  }
+  obj.serialize( s );
+  return s.output();
+}
+
+// As above, with the header regions allocated from `pool`
+template<class T>
+std::vector<Buffer> serialize( const T& obj, PacketPool pool )
+{
+  Serializer s { std::move( pool ) };
+  if constexpr ( requires { T::serialized_length(); } ) {
+    s.reserve( T::serialized_length() );
+  }
   obj.serialize( s );
   return s.output();
 }
@@ -221,3 +328,12 @@ bool parse( T& obj, const std::vector<Buffer>& buffers )
   obj.parse( p );
   return not p.has_error();
 }
+
+// As above, with any copied bytes allocated from `pool`
+template<class T>
+bool parse( T& obj, const std::vector<Buffer>& buffers, PacketPool pool )
+{
+  Parser p { buffers, std::move( pool ) };
+  obj.parse( p );
+  return not p.has_error();
+}
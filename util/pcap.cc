@@ -0,0 +1,222 @@
+#include "pcap.hh"
+
+#include "exception.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+constexpr uint32_t MAGIC_MICROSECONDS = 0xA1B2'C3D4;
+constexpr uint32_t MAGIC_NANOSECONDS = 0xA1B2'3C4D;
+constexpr uint16_t VERSION_MAJOR = 2;
+constexpr uint16_t VERSION_MINOR = 4;
+constexpr size_t FILE_HEADER_LENGTH = 24;
+constexpr size_t RECORD_HEADER_LENGTH = 16;
+
+template<typename T>
+void append( string& out, const T value )
+{
+  char bytes[sizeof( T )]; // NOLINT(*-avoid-c-arrays)
+  memcpy( bytes, &value, sizeof( T ) );
+  out.append( bytes, sizeof( T ) );
+}
+
+} // namespace
+
+PcapWriter::PcapWriter( const string& path, const size_t capacity, const uint32_t snaplen )
+  : file_( CheckSystemCall( "open " + path,
+                            ::open( path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644 ) ) ) // NOLINT(*-vararg)
+  , snaplen_( snaplen )
+  , pending_( capacity )
+  , writer_()
+{
+  // (written in this machine's byte order, which the magic number tells readers)
+  string header;
+  append( header, MAGIC_NANOSECONDS );
+  append( header, VERSION_MAJOR );
+  append( header, VERSION_MINOR );
+  append( header, int32_t { 0 } );  // time zone (always UTC)
+  append( header, uint32_t { 0 } ); // timestamp accuracy
+  append( header, snaplen_ );
+  append( header, LINKTYPE_ETHERNET );
+  write_all( header );
+
+  writer_ = thread( [this] { run(); } );
+}
+
+PcapWriter::~PcapWriter()
+{
+  stop_ = true;
+  writer_.join();
+}
+
+bool PcapWriter::capture( const EthernetFrame& frame )
+{
+  const auto now = chrono::system_clock::now().time_since_epoch();
+  const auto timestamp_ns = static_cast<uint64_t>( chrono::duration_cast<chrono::nanoseconds>( now ).count() );
+
+  const vector<Buffer> pieces = serialize( frame );
+  size_t length = 0;
+  for ( const auto& piece : pieces ) {
+    length += piece.size();
+  }
+
+  string record = make_record( timestamp_ns, length, min<size_t>( length, snaplen_ ) );
+  for ( const auto& piece : pieces ) {
+    const string_view bytes = piece;
+    const size_t room = snaplen_ - ( record.size() - RECORD_HEADER_LENGTH );
+    record.append( bytes.substr( 0, room ) );
+  }
+  return push( std::move( record ) );
+}
+
+bool PcapWriter::capture( const string_view frame, const uint64_t timestamp_ns )
+{
+  const string_view kept = frame.substr( 0, snaplen_ );
+  string record = make_record( timestamp_ns, frame.size(), kept.size() );
+  record.append( kept );
+  return push( std::move( record ) );
+}
+
+string PcapWriter::make_record( const uint64_t timestamp_ns, const size_t original_length, const size_t captured ) const
+{
+  string record;
+  record.reserve( RECORD_HEADER_LENGTH + captured );
+  append( record, static_cast<uint32_t>( timestamp_ns / 1'000'000'000 ) );
+  append( record, static_cast<uint32_t>( timestamp_ns % 1'000'000'000 ) );
+  append( record, static_cast<uint32_t>( captured ) );
+  append( record, static_cast<uint32_t>( original_length ) );
+  return record;
+}
+
+bool PcapWriter::push( string&& record )
+{
+  if ( not pending_.push( std::move( record ) ) ) {
+    dropped_++;
+    return false;
+  }
+  captured_++;
+  return true;
+}
+
+void PcapWriter::flush()
+{
+  while ( written_.load() < captured_.load() ) {
+    this_thread::yield();
+  }
+}
+
+PcapWriter::Stats PcapWriter::stats() const
+{
+  return { captured_.load(), dropped_.load(), bytes_written_.load() };
+}
+
+void PcapWriter::run()
+{
+  vector<string> batch;
+  string out;
+  while ( true ) {
+    // (checked before the ring, so that nothing captured before the stop is left behind)
+    const bool stopping = stop_.load();
+
+    batch.clear();
+    pending_.pop_batch( batch, 1024 );
+    if ( batch.empty() ) {
+      if ( stopping ) {
+        return;
+      }
+      this_thread::sleep_for( chrono::milliseconds( 1 ) );
+      continue;
+    }
+
+    // one write for the whole batch
+    out.clear();
+    for ( const auto& record : batch ) {
+      out.append( record );
+    }
+    write_all( out );
+    written_ += batch.size();
+  }
+}
+
+void PcapWriter::write_all( string_view bytes )
+{
+  while ( not bytes.empty() ) {
+    const size_t written = file_.write( bytes );
+    bytes.remove_prefix( written );
+    bytes_written_ += written;
+  }
+}
+
+PcapReader::PcapReader( const string& path )
+{
+  const FileDescriptor fd { CheckSystemCall( "open " + path, ::open( path.c_str(), O_RDONLY | O_CLOEXEC ) ) }; // NOLINT(*-vararg)
+  mapping_ = make_unique<MappedFile>( fd );
+  contents_ = mapping_->view();
+  read_header();
+}
+
+PcapReader::PcapReader( const string_view contents ) : contents_( contents )
+{
+  read_header();
+}
+
+void PcapReader::read_header()
+{
+  if ( contents_.size() < FILE_HEADER_LENGTH ) {
+    throw runtime_error( "too short to be a pcap file" );
+  }
+
+  uint32_t magic {};
+  memcpy( &magic, contents_.data(), sizeof( magic ) );
+  const uint32_t swapped_magic = __builtin_bswap32( magic );
+  swapped_ = swapped_magic == MAGIC_MICROSECONDS or swapped_magic == MAGIC_NANOSECONDS;
+  if ( not swapped_ and magic != MAGIC_MICROSECONDS and magic != MAGIC_NANOSECONDS ) {
+    throw runtime_error( "not a pcap file (pcapng is not supported)" );
+  }
+  nanoseconds_ = ( swapped_ ? swapped_magic : magic ) == MAGIC_NANOSECONDS;
+
+  snaplen_ = load32( 16 );
+  link_type_ = load32( 20 );
+  position_ = FILE_HEADER_LENGTH;
+}
+
+uint32_t PcapReader::load32( const size_t offset ) const
+{
+  uint32_t value {};
+  memcpy( &value, contents_.data() + offset, sizeof( value ) );
+  return swapped_ ? __builtin_bswap32( value ) : value;
+}
+
+optional<PcapRecord> PcapReader::next()
+{
+  if ( contents_.size() - position_ < RECORD_HEADER_LENGTH ) {
+    return {};
+  }
+  const uint64_t seconds = load32( position_ );
+  const uint64_t fraction = load32( position_ + 4 );
+  const uint32_t captured = load32( position_ + 8 );
+  const uint32_t original = load32( position_ + 12 );
+  if ( contents_.size() - position_ - RECORD_HEADER_LENGTH < captured ) {
+    return {};
+  }
+
+  PcapRecord record;
+  record.timestamp_ns = seconds * 1'000'000'000 + ( nanoseconds_ ? fraction : fraction * 1000 );
+  record.original_length = original;
+  record.bytes = contents_.substr( position_ + RECORD_HEADER_LENGTH, captured );
+  position_ += RECORD_HEADER_LENGTH + captured;
+  return record;
+}
+
+void PcapReader::rewind()
+{
+  position_ = FILE_HEADER_LENGTH;
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include "ethernet_frame.hh"
+#include "file_descriptor.hh"
+#include "mapped_file.hh"
+#include "ring_buffer.hh"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// Packet captures in the classic pcap format (see pcap-savefile(5)), as read and written by
+// tcpdump and Wireshark: a file header, then each frame with its timestamp and length.
+
+// A captured frame
+struct PcapRecord
+{
+  uint64_t timestamp_ns {};    // since the Unix epoch
+  uint32_t original_length {}; // of the frame on the wire (more than bytes.size() if the capture cut it short)
+  std::string_view bytes {};
+};
+
+// Writes frames to a capture file without holding up the threads that capture them.
+//
+// capture() serializes a frame into a record and pushes it onto a bounded ring; a thread of the
+// writer's own takes the records off the ring and writes them to the file in batches. When the
+// ring is full (the disk cannot keep up), capture() drops the record and counts it, rather than
+// wait. Any number of threads may capture into the same writer.
+class PcapWriter
+{
+public:
+  static constexpr size_t DEFAULT_CAPACITY = 8192;  // records waiting to be written, at most
+  static constexpr uint32_t DEFAULT_SNAPLEN = 65535; // bytes kept of each frame, at most
+  static constexpr uint32_t LINKTYPE_ETHERNET = 1;
+
+  struct Stats
+  {
+    uint64_t captured;      // records written, or waiting to be
+    uint64_t dropped;       // records dropped because the ring was full
+    uint64_t bytes_written; // to the file, headers included
+  };
+
+  // Create (or truncate) the file at `path`, and start the writer thread
+  explicit PcapWriter( const std::string& path, size_t capacity = DEFAULT_CAPACITY, uint32_t snaplen = DEFAULT_SNAPLEN );
+
+  // Writes every record captured so far, then closes the file
+  ~PcapWriter();
+
+  PcapWriter( const PcapWriter& other ) = delete;
+  PcapWriter& operator=( const PcapWriter& other ) = delete;
+  PcapWriter( PcapWriter&& other ) = delete;
+  PcapWriter& operator=( PcapWriter&& other ) = delete;
+
+  // Capture a frame, timestamped now. Returns false if it was dropped.
+  bool capture( const EthernetFrame& frame );
+
+  // Capture a frame's bytes, with a given timestamp (ns since the Unix epoch)
+  bool capture( std::string_view frame, uint64_t timestamp_ns );
+
+  // Wait until every record captured so far has been written to the file
+  void flush();
+
+  Stats stats() const;
+
+private:
+  FileDescriptor file_;
+  uint32_t snaplen_;
+  MpscRing<std::string> pending_;
+
+  std::atomic<uint64_t> captured_ { 0 };
+  std::atomic<uint64_t> dropped_ { 0 };
+  std::atomic<uint64_t> written_ { 0 }; // records
+  std::atomic<uint64_t> bytes_written_ { 0 };
+  std::atomic<bool> stop_ { false };
+  std::thread writer_; // started last, once the file header is written
+
+  // A record's header and the first `captured` of its bytes, ready for the file
+  std::string make_record( uint64_t timestamp_ns, size_t original_length, size_t captured ) const;
+
+  bool push( std::string&& record );
+
+  // The writer thread
+  void run();
+  void write_all( std::string_view bytes );
+};
+
+// Reads the frames of a capture file (microsecond or nanosecond timestamps, in either byte order).
+// The file is memory-mapped, and each record's bytes are a view of the mapping.
+class PcapReader
+{
+public:
+  // Map the file at `path`; throws if it is not a pcap file
+  explicit PcapReader( const std::string& path );
+
+  // Read a capture that is already in memory (which must outlive the reader)
+  explicit PcapReader( std::string_view contents );
+
+  // The next frame, or none at the end of the file (a last record cut short, as left by a
+  // capture that was interrupted, counts as the end)
+  std::optional<PcapRecord> next();
+
+  // Start again from the first frame
+  void rewind();
+
+  uint32_t link_type() const { return link_type_; }
+  uint32_t snaplen() const { return snaplen_; }
+
+private:
+  std::unique_ptr<MappedFile> mapping_ {};
+  std::string_view contents_ {};
+  size_t position_ {};
+  bool swapped_ {};     // written in the other byte order
+  bool nanoseconds_ {}; // timestamps in ns (not us)
+  uint32_t link_type_ {};
+  uint32_t snaplen_ {};
+
+  void read_header();
+  uint32_t load32( size_t offset ) const;
+};
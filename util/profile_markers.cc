@@ -0,0 +1,18 @@
+#include "profile_markers.hh"
+
+// (the empty asm keeps each marker a real function, with a body perf can probe)
+// NOLINTBEGIN(*-macro-usage)
+#define PROFILE_MARKER_DEFINE( name )                                                                        \
+  __attribute__( ( noinline ) ) void netlink_##name##_begin()                                               \
+  {                                                                                                          \
+    asm volatile( "" );                                                                                      \
+  }                                                                                                          \
+  __attribute__( ( noinline ) ) void netlink_##name##_end()                                                 \
+  {                                                                                                          \
+    asm volatile( "" );                                                                                      \
+  }
+extern "C" {
+PROFILE_MARKERS( PROFILE_MARKER_DEFINE )
+}
+#undef PROFILE_MARKER_DEFINE
+// NOLINTEND(*-macro-usage)
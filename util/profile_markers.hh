@@ -0,0 +1,55 @@
+#pragma once
+
+// Markers around the forwarding hot paths, for profiling the instrumented builds with perf.
+//
+// With PROFILING_MARKERS defined, PROFILE_SCOPE( name ) calls netlink_<name>_begin() where it
+// stands and netlink_<name>_end() when the scope exits. These are empty functions that are never
+// inlined, with C names, so that perf can put a uprobe on each and attribute time between them:
+//
+//   perf probe -x ./benchmark_forwarding_instrumented netlink_route_begin
+//   perf probe -x ./benchmark_forwarding_instrumented netlink_route_end
+//   perf record -e probe_benchmark_forwarding_instrumented:* -e cycles ./benchmark_forwarding_instrumented
+//
+// (and they show up by name in perf report and in ftrace's function tracer). Without it,
+// PROFILE_SCOPE expands to nothing.
+
+// The marked paths
+#define PROFILE_MARKERS( X )                                                                                 \
+  X( route )                                                                                                 \
+  X( send_datagram )                                                                                         \
+  X( recv_frame )                                                                                            \
+  X( tick )
+
+// NOLINTBEGIN(*-macro-usage)
+#define PROFILE_MARKER_DECLARE( name )                                                                       \
+  void netlink_##name##_begin();                                                                             \
+  void netlink_##name##_end();
+extern "C" {
+PROFILE_MARKERS( PROFILE_MARKER_DECLARE )
+}
+#undef PROFILE_MARKER_DECLARE
+
+// Calls the end marker of a scope when it exits
+class ProfileScope
+{
+  void ( *end_ )();
+
+public:
+  ProfileScope( void ( *begin )(), void ( *end )() ) : end_( end ) { begin(); }
+  ~ProfileScope() { end_(); }
+
+  ProfileScope( const ProfileScope& other ) = delete;
+  ProfileScope& operator=( const ProfileScope& other ) = delete;
+  ProfileScope( ProfileScope&& other ) = delete;
+  ProfileScope& operator=( ProfileScope&& other ) = delete;
+};
+
+#define PROFILE_CONCAT_INNER( a, b ) a##b
+#define PROFILE_CONCAT( a, b ) PROFILE_CONCAT_INNER( a, b )
+#ifdef PROFILING_MARKERS
+#define PROFILE_SCOPE( name )                                                                                \
+  const ProfileScope PROFILE_CONCAT( profile_scope_, __LINE__ ) { netlink_##name##_begin, netlink_##name##_end }
+#else
+#define PROFILE_SCOPE( name ) static_cast<void>( 0 )
+#endif
+// NOLINTEND(*-macro-usage)
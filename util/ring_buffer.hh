@@ -0,0 +1,220 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <utility>
+#include <vector>
+
+// Bounded lock-free ring buffers for handing objects between threads.
+//
+// Both rings hold a power-of-two number of slots (the requested capacity is rounded up).
+// A push onto a full ring fails and leaves its argument untouched, so the caller decides
+// whether to drop or retry. The producer and consumer indices live on separate cache lines
+// so that the two sides do not false-share.
+
+// Cache line size assumed for padding (std::hardware_destructive_interference_size is not
+// ABI-stable, and GCC warns about using it in headers)
+inline constexpr size_t RING_CACHE_LINE = 64;
+
+// Single-producer, single-consumer ring: one thread may push, and one (other) thread may pop.
+//
+// Each side keeps a private copy of the other side's index and only re-reads the shared
+// one when the copy says the ring is full (or empty), so in steady state a push or a pop
+// touches no cache line written by the other thread except the slot itself.
+template<typename T>
+class SpscRing
+{
+  std::vector<T> slots_;
+  size_t mask_;
+
+  alignas( RING_CACHE_LINE ) std::atomic<size_t> head_ { 0 }; // next slot to pop (written by the consumer)
+  size_t cached_tail_ { 0 };                                   // consumer's copy of tail_
+
+  alignas( RING_CACHE_LINE ) std::atomic<size_t> tail_ { 0 }; // next slot to push (written by the producer)
+  size_t cached_head_ { 0 };                                   // producer's copy of head_
+
+public:
+  explicit SpscRing( const size_t capacity )
+    : slots_( std::bit_ceil( std::max<size_t>( capacity, 2 ) ) ), mask_( slots_.size() - 1 )
+  {}
+
+  // Copying is only safe while neither side is running
+  SpscRing( const SpscRing& other )
+    : slots_( other.slots_ )
+    , mask_( other.mask_ )
+    , head_( other.head_.load() )
+    , cached_tail_( other.cached_tail_ )
+    , tail_( other.tail_.load() )
+    , cached_head_( other.cached_head_ )
+  {}
+  SpscRing& operator=( const SpscRing& other ) = delete;
+
+  size_t capacity() const { return slots_.size(); }
+
+  // Approximate when called while the other side is running
+  size_t size() const { return tail_.load( std::memory_order_acquire ) - head_.load( std::memory_order_acquire ); }
+  bool empty() const { return size() == 0; }
+
+  // Producer side: returns false (and leaves `value` alone) if the ring is full
+  bool push( T&& value ) { return push_batch( std::span<T> { &value, 1 } ) == 1; }
+
+  // Producer side: moves as many of `values` as fit (from the front), and returns how many
+  size_t push_batch( std::span<T> values )
+  {
+    const size_t tail = tail_.load( std::memory_order_relaxed );
+    if ( tail + values.size() - cached_head_ > capacity() ) {
+      cached_head_ = head_.load( std::memory_order_acquire );
+    }
+    const size_t count = std::min( values.size(), capacity() - ( tail - cached_head_ ) );
+    for ( size_t i = 0; i < count; i++ ) {
+      slots_[( tail + i ) & mask_] = std::move( values[i] );
+    }
+    tail_.store( tail + count, std::memory_order_release );
+    return count;
+  }
+
+  // Consumer side
+  std::optional<T> pop()
+  {
+    const size_t head = head_.load( std::memory_order_relaxed );
+    if ( head == cached_tail_ ) {
+      cached_tail_ = tail_.load( std::memory_order_acquire );
+      if ( head == cached_tail_ ) {
+        return {};
+      }
+    }
+    std::optional<T> value { std::move( slots_[head & mask_] ) };
+    head_.store( head + 1, std::memory_order_release );
+    return value;
+  }
+
+  // Consumer side: appends up to `max` values to `out`, and returns how many
+  size_t pop_batch( std::vector<T>& out, const size_t max = SIZE_MAX )
+  {
+    const size_t head = head_.load( std::memory_order_relaxed );
+    if ( cached_tail_ - head < max ) {
+      cached_tail_ = tail_.load( std::memory_order_acquire );
+    }
+    const size_t count = std::min( max, cached_tail_ - head );
+    for ( size_t i = 0; i < count; i++ ) {
+      out.push_back( std::move( slots_[( head + i ) & mask_] ) );
+    }
+    head_.store( head + count, std::memory_order_release );
+    return count;
+  }
+};
+
+// Multi-producer, single-consumer ring: any number of threads may push, and one thread may pop.
+//
+// This is Vyukov's bounded queue: every slot carries a sequence number that says whether it
+// is free for the producer claiming position `pos` (seq == pos) or holds a value for the
+// consumer (seq == pos + 1), so producers only contend on one compare-and-swap of the tail.
+// Values from the same producer are popped in the order that producer pushed them.
+template<typename T>
+class MpscRing
+{
+  struct Slot
+  {
+    std::atomic<size_t> seq { 0 };
+    T value {};
+  };
+
+  std::unique_ptr<Slot[]> slots_; // NOLINT(*-avoid-c-arrays)
+  size_t mask_;
+
+  alignas( RING_CACHE_LINE ) std::atomic<size_t> tail_ { 0 }; // next position to claim (producers)
+  alignas( RING_CACHE_LINE ) size_t head_ { 0 };              // next position to pop (consumer only)
+
+public:
+  explicit MpscRing( const size_t capacity )
+    : slots_( std::make_unique<Slot[]>( std::bit_ceil( std::max<size_t>( capacity, 2 ) ) ) ) // NOLINT(*-c-arrays)
+    , mask_( std::bit_ceil( std::max<size_t>( capacity, 2 ) ) - 1 )
+  {
+    for ( size_t i = 0; i <= mask_; i++ ) {
+      slots_[i].seq.store( i, std::memory_order_relaxed );
+    }
+  }
+
+  // Copying is only safe while neither side is running
+  MpscRing( const MpscRing& other )
+    : slots_( std::make_unique<Slot[]>( other.capacity() ) ) // NOLINT(*-c-arrays)
+    , mask_( other.mask_ )
+    , tail_( other.tail_.load() )
+    , head_( other.head_ )
+  {
+    for ( size_t i = 0; i <= mask_; i++ ) {
+      slots_[i].seq.store( other.slots_[i].seq.load() );
+      slots_[i].value = other.slots_[i].value;
+    }
+  }
+  MpscRing& operator=( const MpscRing& other ) = delete;
+
+  size_t capacity() const { return mask_ + 1; }
+
+  // Producer side: returns false (and leaves `value` alone) if the ring is full
+  bool push( T&& value )
+  {
+    size_t pos = tail_.load( std::memory_order_relaxed );
+    while ( true ) {
+      Slot& slot = slots_[pos & mask_];
+      const size_t seq = slot.seq.load( std::memory_order_acquire );
+      const auto diff = static_cast<intptr_t>( seq ) - static_cast<intptr_t>( pos );
+      if ( diff == 0 ) {
+        if ( tail_.compare_exchange_weak( pos, pos + 1, std::memory_order_relaxed ) ) {
+          slot.value = std::move( value );
+          slot.seq.store( pos + 1, std::memory_order_release );
+          return true;
+        }
+      } else if ( diff < 0 ) {
+        return false; // the slot still holds a value from one lap ago
+      } else {
+        pos = tail_.load( std::memory_order_relaxed ); // another producer claimed it
+      }
+    }
+  }
+
+  // Producer side: pushes from the front of `values` until the ring is full, and returns how many
+  size_t push_batch( std::span<T> values )
+  {
+    size_t count = 0;
+    while ( count < values.size() and push( std::move( values[count] ) ) ) {
+      count++;
+    }
+    return count;
+  }
+
+  // Consumer side
+  std::optional<T> pop()
+  {
+    Slot& slot = slots_[head_ & mask_];
+    if ( slot.seq.load( std::memory_order_acquire ) != head_ + 1 ) {
+      return {};
+    }
+    std::optional<T> value { std::move( slot.value ) };
+    slot.seq.store( head_ + capacity(), std::memory_order_release );
+    head_++;
+    return value;
+  }
+
+  // Consumer side: appends up to `max` values to `out`, and returns how many
+  size_t pop_batch( std::vector<T>& out, const size_t max = SIZE_MAX )
+  {
+    size_t count = 0;
+    for ( ; count < max; count++ ) {
+      Slot& slot = slots_[head_ & mask_];
+      if ( slot.seq.load( std::memory_order_acquire ) != head_ + 1 ) {
+        break;
+      }
+      out.push_back( std::move( slot.value ) );
+      slot.seq.store( head_ + capacity(), std::memory_order_release );
+      head_++;
+    }
+    return count;
+  }
+};
@@ -2,6 +2,8 @@
 
 #include "exception.hh"
 
+#include <algorithm>
+#include <cerrno>
 #include <cstddef>
 #include <linux/if_packet.h>
 #include <net/if.h>
@@ -151,6 +153,101 @@ void DatagramSocket::send( const string_view payload )
   register_write();
 }
 
+bool DatagramSocket::send( const span<const Buffer> datagram )
+{
+  thread_local vector<iovec> iovecs;
+  iovecs.clear();
+  append_iovecs( datagram, iovecs );
+
+  msghdr message {};
+  message.msg_iov = iovecs.data();
+  message.msg_iovlen = iovecs.size();
+  if ( ::sendmsg( fd_num(), &message, 0 ) < 0 ) {
+    if ( errno == EAGAIN or errno == EWOULDBLOCK ) {
+      return false;
+    }
+    throw unix_error { "sendmsg" };
+  }
+
+  register_write();
+  return true;
+}
+
+size_t DatagramSocket::recv_batch( const span<string> payloads )
+{
+  // scratch space, kept between calls so that a batch does not allocate
+  thread_local vector<mmsghdr> messages;
+  thread_local vector<iovec> iovecs;
+  messages.assign( payloads.size(), {} );
+  iovecs.resize( payloads.size() );
+
+  for ( size_t i = 0; i < payloads.size(); i++ ) {
+    string& payload = payloads[i];
+    payload.resize( max( payload.capacity(), kMinBatchBufferSize ) );
+    iovecs[i] = { payload.data(), payload.size() };
+    messages[i].msg_hdr.msg_iov = &iovecs[i];
+    messages[i].msg_hdr.msg_iovlen = 1;
+  }
+
+  // (a blocking socket waits for the first datagram, then takes only what has already arrived)
+  const int received = ::recvmmsg(
+    fd_num(), messages.data(), static_cast<unsigned int>( messages.size() ), MSG_WAITFORONE, nullptr );
+  if ( received < 0 ) {
+    for ( auto& payload : payloads ) {
+      payload.clear();
+    }
+    if ( errno == EAGAIN or errno == EWOULDBLOCK ) {
+      return 0;
+    }
+    throw unix_error { "recvmmsg" };
+  }
+
+  register_read();
+  const auto count = static_cast<size_t>( received );
+  for ( size_t i = 0; i < payloads.size(); i++ ) {
+    payloads[i].resize( i < count ? messages[i].msg_len : 0 );
+  }
+  for ( size_t i = 0; i < count; i++ ) {
+    if ( messages[i].msg_hdr.msg_flags & MSG_TRUNC ) { // NOLINT(*-signed-bitwise)
+      throw runtime_error( "recvmmsg (oversized datagram)" );
+    }
+  }
+  return count;
+}
+
+size_t DatagramSocket::send_batch( const span<const vector<Buffer>> datagrams )
+{
+  if ( datagrams.empty() ) {
+    return 0;
+  }
+
+  thread_local vector<mmsghdr> messages;
+  thread_local vector<iovec> iovecs;
+  messages.assign( datagrams.size(), {} );
+  iovecs.clear();
+
+  for ( const auto& datagram : datagrams ) {
+    append_iovecs( datagram, iovecs );
+  }
+  size_t first_piece = 0;
+  for ( size_t i = 0; i < datagrams.size(); i++ ) {
+    messages[i].msg_hdr.msg_iov = iovecs.data() + first_piece;
+    messages[i].msg_hdr.msg_iovlen = datagrams[i].size();
+    first_piece += datagrams[i].size();
+  }
+
+  const int sent = ::sendmmsg( fd_num(), messages.data(), static_cast<unsigned int>( messages.size() ), 0 );
+  if ( sent < 0 ) {
+    if ( errno == EAGAIN or errno == EWOULDBLOCK ) {
+      return 0;
+    }
+    throw unix_error { "sendmmsg" };
+  }
+
+  register_write();
+  return static_cast<size_t>( sent );
+}
+
 // mark the socket as listening for incoming connections
 //! \param[in] backlog is the number of waiting connections to queue (see [listen(2)](\ref man2::listen))
 void TCPSocket::listen( const int backlog )
@@ -1,11 +1,15 @@
 #pragma once
 
 #include "address.hh"
+#include "buffer.hh"
 #include "file_descriptor.hh"
 
 #include <cstdint>
 #include <functional>
+#include <span>
+#include <string>
 #include <sys/socket.h>
+#include <vector>
 
 //! \brief Base class for network sockets (TCP, UDP, etc.)
 //! \details Socket is generally used via a subclass. See TCPSocket and UDPSocket for usage examples.
@@ -71,6 +75,28 @@ public:
 
   //! Send datagram to the socket's connected address (must call connect() first)
   void send( std::string_view payload );
+
+  //! \brief Send one datagram gathered from its pieces (e.g. a frame as returned by serialize()) with
+  //! [sendmsg(2)](\ref man2::sendmsg), to the socket's connected address
+  //! \returns whether it was sent (false if the socket is non-blocking and full)
+  bool send( std::span<const Buffer> datagram );
+
+  //! Smallest buffer that recv_batch() receives a datagram into
+  static constexpr size_t kMinBatchBufferSize = 2048;
+
+  //! \brief Receive up to `payloads.size()` datagrams with one [recvmmsg(2)](\ref man2::recvmmsg)
+  //! \details Each datagram is received into the capacity its string already has (or kMinBatchBufferSize,
+  //! if that is more), so that buffers from a PacketPool are filled without reallocating. Blocks until
+  //! at least one datagram has arrived, unless the socket is non-blocking. The senders' addresses are
+  //! not kept.
+  //! \returns the number of datagrams received (the rest of `payloads` are left empty)
+  //! \note If a payload is too small to hold its datagram, this method throws a std::runtime_error
+  size_t recv_batch( std::span<std::string> payloads );
+
+  //! \brief Send datagrams to the socket's connected (or bound) address with one [sendmmsg(2)](\ref man2::sendmmsg)
+  //! \details Each datagram is gathered from its pieces (e.g. a frame as returned by serialize()).
+  //! \returns the number of datagrams sent, from the front (0 if the socket is non-blocking and full)
+  size_t send_batch( std::span<const std::vector<Buffer>> datagrams );
 };
 
 //! A wrapper around [UDP sockets](\ref man7::udp)
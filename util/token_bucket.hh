@@ -0,0 +1,44 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+
+// A token bucket rate limiter driven by an external millisecond clock.
+//
+// The bucket holds up to `burst` tokens and refills at `rate` tokens per second; each event
+// that is allowed through consumes one token. A rate of zero means "unlimited" (every event
+// is allowed). Time only moves forward when the caller says so, which keeps the limiter
+// deterministic under the interfaces' tick()-driven clock.
+class TokenBucket
+{
+  uint64_t rate_;       // tokens per second (0: unlimited)
+  uint64_t burst_;      // bucket size, in tokens
+  uint64_t milli_tokens_; // current fill, in thousandths of a token (so that refills are exact)
+  uint64_t last_ms_ {};
+
+public:
+  explicit TokenBucket( const uint64_t rate = 0, const uint64_t burst = 1 )
+    : rate_( rate ), burst_( std::max<uint64_t>( burst, 1 ) ), milli_tokens_( burst_ * 1000 )
+  {}
+
+  bool unlimited() const { return rate_ == 0; }
+  uint64_t burst() const { return burst_; }
+
+  // Take `tokens` tokens at time `now_ms` if there are that many; returns whether they were taken
+  bool consume( const uint64_t now_ms, const uint64_t tokens = 1 )
+  {
+    if ( unlimited() ) {
+      return true;
+    }
+    if ( now_ms > last_ms_ ) {
+      // rate tokens/s is rate milli-tokens/ms
+      milli_tokens_ = std::min( burst_ * 1000, milli_tokens_ + ( now_ms - last_ms_ ) * rate_ );
+      last_ms_ = now_ms;
+    }
+    if ( milli_tokens_ < tokens * 1000 ) {
+      return false;
+    }
+    milli_tokens_ -= tokens * 1000;
+    return true;
+  }
+};
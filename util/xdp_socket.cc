@@ -0,0 +1,299 @@
+#include "xdp_socket.hh"
+
+#include "exception.hh"
+#include "huge_pages.hh"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <bit>
+#include <cerrno>
+#include <cstring>
+#include <linux/bpf.h>
+#include <linux/if_link.h>
+#include <net/if.h>
+#include <poll.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+template<typename T>
+void set_xdp_option( const int fd, const int option, const T& value )
+{
+  CheckSystemCall( "setsockopt", ::setsockopt( fd, SOL_XDP, option, &value, sizeof( value ) ) );
+}
+
+unsigned int device_index( const string& device )
+{
+  const unsigned int index = if_nametoindex( device.c_str() );
+  if ( index == 0 ) {
+    throw unix_error { "if_nametoindex " + device };
+  }
+  return index;
+}
+
+// Errors from a wakeup that only mean the kernel is already busy with the ring
+bool is_transient( const int error )
+{
+  return error == EAGAIN or error == EBUSY or error == ENOBUFS or error == ENETDOWN;
+}
+
+int bpf( const int command, bpf_attr& attr )
+{
+  return static_cast<int>( syscall( __NR_bpf, command, &attr, sizeof( attr ) ) );
+}
+
+int create_xsk_map( const uint32_t queue_count )
+{
+  bpf_attr attr {};
+  attr.map_type = BPF_MAP_TYPE_XSKMAP;
+  attr.key_size = sizeof( uint32_t );
+  attr.value_size = sizeof( uint32_t );
+  attr.max_entries = queue_count;
+  return CheckSystemCall( "bpf (create XSKMAP)", bpf( BPF_MAP_CREATE, attr ) );
+}
+
+bpf_insn instruction( const uint8_t code, const uint8_t dst, const uint8_t src, const int16_t off, const int32_t imm )
+{
+  bpf_insn insn {};
+  insn.code = code;
+  insn.dst_reg = dst & 0xfU;
+  insn.src_reg = src & 0xfU;
+  insn.off = off;
+  insn.imm = imm;
+  return insn;
+}
+
+// return bpf_redirect_map( &map, ctx->rx_queue_index, XDP_PASS ), where ctx (in r1) is the
+// xdp_md of the frame; with an ethertype, frames of other types are passed first
+int load_redirect_program( const FileDescriptor& map, const optional<uint16_t> ethertype )
+{
+  vector<bpf_insn> code;
+  if ( ethertype.has_value() ) {
+    code.push_back( instruction( BPF_LDX | BPF_W | BPF_MEM, 2, 1, 0, 0 ) );    // r2 = ctx->data
+    code.push_back( instruction( BPF_LDX | BPF_W | BPF_MEM, 3, 1, 4, 0 ) );    // r3 = ctx->data_end
+    code.push_back( instruction( BPF_ALU64 | BPF_MOV | BPF_X, 4, 2, 0, 0 ) );  // r4 = r2 + 14
+    code.push_back( instruction( BPF_ALU64 | BPF_ADD | BPF_K, 4, 0, 0, 14 ) ); //
+    code.push_back( instruction( BPF_JMP | BPF_JGT | BPF_X, 4, 3, 8, 0 ) );    // shorter than a header: pass
+    code.push_back( instruction( BPF_LDX | BPF_H | BPF_MEM, 4, 2, 12, 0 ) );   // r4 = the type
+    code.push_back( instruction( BPF_JMP | BPF_JNE | BPF_K, 4, 0, 6, htons( *ethertype ) ) ); // another type: pass
+  }
+  code.push_back( instruction( BPF_LDX | BPF_W | BPF_MEM, 2, 1, 16, 0 ) );                     // r2 = ctx->rx_queue_index
+  code.push_back( instruction( BPF_LD | BPF_DW | BPF_IMM, 1, BPF_PSEUDO_MAP_FD, 0, map.fd_num() ) ); // r1 = &map
+  code.push_back( instruction( 0, 0, 0, 0, 0 ) );                                               // (its upper half)
+  code.push_back( instruction( BPF_ALU64 | BPF_MOV | BPF_K, 3, 0, 0, XDP_PASS ) );
+  code.push_back( instruction( BPF_JMP | BPF_CALL, 0, 0, 0, BPF_FUNC_redirect_map ) );
+  code.push_back( instruction( BPF_JMP | BPF_EXIT, 0, 0, 0, 0 ) );
+  if ( ethertype.has_value() ) {
+    code.push_back( instruction( BPF_ALU64 | BPF_MOV | BPF_K, 0, 0, 0, XDP_PASS ) ); // pass: return XDP_PASS
+    code.push_back( instruction( BPF_JMP | BPF_EXIT, 0, 0, 0, 0 ) );
+  }
+
+  static constexpr char license[] = "Dual MIT/GPL"; // NOLINT(*-avoid-c-arrays)
+  bpf_attr attr {};
+  attr.prog_type = BPF_PROG_TYPE_XDP;
+  attr.insns = reinterpret_cast<uint64_t>( code.data() ); // NOLINT(*-reinterpret-cast)
+  attr.insn_cnt = static_cast<uint32_t>( code.size() );
+  attr.license = reinterpret_cast<uint64_t>( license ); // NOLINT(*-reinterpret-cast)
+  return CheckSystemCall( "bpf (load XDP program)", bpf( BPF_PROG_LOAD, attr ) );
+}
+
+int attach_xdp_program( const FileDescriptor& program, const string& device, const bool native )
+{
+  bpf_attr attr {};
+  attr.link_create.prog_fd = program.fd_num();
+  attr.link_create.target_ifindex = device_index( device );
+  attr.link_create.attach_type = BPF_XDP;
+  attr.link_create.flags = native ? XDP_FLAGS_DRV_MODE : XDP_FLAGS_SKB_MODE;
+  return CheckSystemCall( "bpf (attach XDP program to " + device + ")", bpf( BPF_LINK_CREATE, attr ) );
+}
+
+} // namespace
+
+XdpSocket::XdpSocket( const string& device, const uint32_t queue ) : XdpSocket( device, queue, Config {} ) {}
+
+XdpSocket::XdpSocket( const string& device, const uint32_t queue, const Config& config )
+  : Socket( AF_XDP, SOCK_RAW ), config_( config )
+{
+  if ( not has_single_bit( config_.frame_size ) or config_.frame_size < 2048 or not has_single_bit( config_.ring_size )
+       or config_.frame_count < 2 ) {
+    throw runtime_error( "XdpSocket: bad UMEM or ring geometry" );
+  }
+  const unsigned int ifindex = device_index( device );
+
+  umem_size_ = size_t { config_.frame_size } * config_.frame_count;
+  // (on huge pages if possible: every frame received or sent touches it)
+  umem_ = static_cast<char*>( map_huge_pages( umem_size_, &umem_backend_ ) );
+
+  try {
+    xdp_umem_reg registration {};
+    registration.addr = reinterpret_cast<uint64_t>( umem_ ); // NOLINT(*-reinterpret-cast)
+    registration.len = umem_size_;
+    registration.chunk_size = config_.frame_size;
+    set_xdp_option( fd_num(), XDP_UMEM_REG, registration );
+    set_xdp_option( fd_num(), XDP_UMEM_FILL_RING, config_.ring_size );
+    set_xdp_option( fd_num(), XDP_UMEM_COMPLETION_RING, config_.ring_size );
+    set_xdp_option( fd_num(), XDP_RX_RING, config_.ring_size );
+    set_xdp_option( fd_num(), XDP_TX_RING, config_.ring_size );
+
+    xdp_mmap_offsets offsets {};
+    socklen_t length = sizeof( offsets );
+    CheckSystemCall( "getsockopt", ::getsockopt( fd_num(), SOL_XDP, XDP_MMAP_OFFSETS, &offsets, &length ) );
+
+    const auto map_ring = [&]( Ring& ring, const xdp_ring_offset& offset, const size_t desc_size, const off_t page ) {
+      ring.map_size = offset.desc + config_.ring_size * desc_size;
+      void* const map
+        = mmap( nullptr, ring.map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_num(), page );
+      if ( map == MAP_FAILED ) { // NOLINT(*-cstyle-cast)
+        throw unix_error { "mmap (XDP ring)" };
+      }
+      char* const base = static_cast<char*>( map );
+      ring.map = map;
+      ring.producer = reinterpret_cast<uint32_t*>( base + offset.producer ); // NOLINT(*-reinterpret-cast)
+      ring.consumer = reinterpret_cast<uint32_t*>( base + offset.consumer ); // NOLINT(*-reinterpret-cast)
+      ring.flags = reinterpret_cast<uint32_t*>( base + offset.flags );       // NOLINT(*-reinterpret-cast)
+      ring.descs = base + offset.desc;
+      ring.mask = config_.ring_size - 1;
+    };
+    map_ring( fill_, offsets.fr, sizeof( uint64_t ), XDP_UMEM_PGOFF_FILL_RING );
+    map_ring( completion_, offsets.cr, sizeof( uint64_t ), XDP_UMEM_PGOFF_COMPLETION_RING );
+    map_ring( rx_, offsets.rx, sizeof( xdp_desc ), XDP_PGOFF_RX_RING );
+    map_ring( tx_, offsets.tx, sizeof( xdp_desc ), XDP_PGOFF_TX_RING );
+
+    // The first chunks are for receiving (at most a fill ring's worth), and the rest for sending
+    const uint32_t rx_frames = min( config_.frame_count / 2, config_.ring_size );
+    auto* fill = static_cast<uint64_t*>( fill_.descs );
+    for ( uint32_t i = 0; i < rx_frames; i++ ) {
+      fill[i] = uint64_t { i } * config_.frame_size;
+    }
+    __atomic_store_n( fill_.producer, rx_frames, __ATOMIC_RELEASE );
+    for ( uint32_t i = rx_frames; i < config_.frame_count; i++ ) {
+      tx_free_.push_back( uint64_t { i } * config_.frame_size );
+    }
+    tx_producer_ = *tx_.producer;
+
+    sockaddr_xdp address {};
+    address.sxdp_family = AF_XDP;
+    address.sxdp_flags = ( config_.zero_copy ? XDP_ZEROCOPY : XDP_COPY ) | XDP_USE_NEED_WAKEUP;
+    address.sxdp_ifindex = ifindex;
+    address.sxdp_queue_id = queue;
+    bind( Address { reinterpret_cast<const sockaddr*>( &address ), sizeof( address ) } ); // NOLINT(*-reinterpret-cast)
+  } catch ( ... ) {
+    unmap();
+    throw;
+  }
+}
+
+XdpSocket::~XdpSocket()
+{
+  unmap();
+}
+
+void XdpSocket::unmap()
+{
+  for ( Ring* ring : { &fill_, &completion_, &rx_, &tx_ } ) {
+    if ( ring->map != nullptr ) {
+      munmap( ring->map, ring->map_size );
+      ring->map = nullptr;
+    }
+  }
+  if ( umem_ != nullptr ) {
+    unmap_huge_pages( umem_, umem_size_ );
+    umem_ = nullptr;
+  }
+}
+
+void XdpSocket::kickFill()
+{
+  if ( __atomic_load_n( fill_.flags, __ATOMIC_ACQUIRE ) & XDP_RING_NEED_WAKEUP ) {
+    if ( ::recvfrom( fd_num(), nullptr, 0, MSG_DONTWAIT, nullptr, nullptr ) < 0 and not is_transient( errno ) ) {
+      throw unix_error { "recvfrom (XDP fill ring)" };
+    }
+  }
+}
+
+void XdpSocket::reapCompletions()
+{
+  const uint32_t head = *completion_.consumer;
+  const uint32_t count = __atomic_load_n( completion_.producer, __ATOMIC_ACQUIRE ) - head;
+  const auto* chunks = static_cast<const uint64_t*>( completion_.descs );
+  for ( uint32_t i = 0; i < count; i++ ) {
+    tx_free_.push_back( chunks[( head + i ) & completion_.mask] );
+  }
+  __atomic_store_n( completion_.consumer, head + count, __ATOMIC_RELEASE );
+}
+
+bool XdpSocket::send( const vector<Buffer>& frame )
+{
+  size_t length = 0;
+  for ( const auto& piece : frame ) {
+    length += piece.size();
+  }
+  if ( length > max_frame_size() ) {
+    throw runtime_error( "XdpSocket: frame of " + to_string( length ) + " bytes is too big for a UMEM chunk" );
+  }
+
+  if ( tx_free_.empty() ) {
+    reapCompletions();
+  }
+  if ( tx_free_.empty() or tx_producer_ - __atomic_load_n( tx_.consumer, __ATOMIC_ACQUIRE ) > tx_.mask ) {
+    return false;
+  }
+
+  const uint64_t chunk = tx_free_.back();
+  tx_free_.pop_back();
+  char* out = umem_ + chunk;
+  for ( const auto& piece : frame ) {
+    const string_view bytes = piece;
+    memcpy( out, bytes.data(), bytes.size() );
+    out += bytes.size();
+  }
+  static_cast<xdp_desc*>( tx_.descs )[tx_producer_ & tx_.mask] = { chunk, static_cast<uint32_t>( length ), 0 };
+  tx_producer_++;
+  return true;
+}
+
+void XdpSocket::flush()
+{
+  if ( tx_producer_ != *tx_.producer ) {
+    __atomic_store_n( tx_.producer, tx_producer_, __ATOMIC_RELEASE );
+    if ( __atomic_load_n( tx_.flags, __ATOMIC_ACQUIRE ) & XDP_RING_NEED_WAKEUP ) {
+      if ( ::sendto( fd_num(), nullptr, 0, MSG_DONTWAIT, nullptr, 0 ) < 0 and not is_transient( errno ) ) {
+        throw unix_error { "sendto (XDP TX ring)" };
+      }
+    }
+  }
+  reapCompletions();
+}
+
+bool XdpSocket::wait( const int timeout_ms )
+{
+  if ( __atomic_load_n( rx_.producer, __ATOMIC_ACQUIRE ) != *rx_.consumer ) {
+    return true;
+  }
+  pollfd fd { fd_num(), POLLIN, 0 };
+  return CheckSystemCall( "poll", ::poll( &fd, 1, timeout_ms ) ) > 0;
+}
+
+XdpProgram::XdpProgram( const string& device,
+                        const uint32_t queue_count,
+                        const optional<uint16_t> ethertype,
+                        const bool native )
+  : map_( create_xsk_map( queue_count ) )
+  , program_( load_redirect_program( map_, ethertype ) )
+  , link_( attach_xdp_program( program_, device, native ) )
+{}
+
+void XdpProgram::add( const uint32_t queue, const XdpSocket& socket )
+{
+  const uint32_t fd = socket.fd_num();
+  bpf_attr update {};
+  update.map_fd = map_.fd_num();
+  update.key = reinterpret_cast<uint64_t>( &queue );  // NOLINT(*-reinterpret-cast)
+  update.value = reinterpret_cast<uint64_t>( &fd );   // NOLINT(*-reinterpret-cast)
+  CheckSystemCall( "bpf (add XDP socket)", bpf( BPF_MAP_UPDATE_ELEM, update ) );
+}
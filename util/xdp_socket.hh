@@ -0,0 +1,144 @@
+#pragma once
+
+#include "buffer.hh"
+#include "file_descriptor.hh"
+#include "huge_pages.hh"
+#include "socket.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <linux/if_xdp.h>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// An AF_XDP socket on one queue of a network device (see the kernel's af_xdp documentation).
+//
+// The socket owns its UMEM, an area of frame-sized chunks shared with the kernel (on huge pages,
+// where they can be had), and the four rings that pass chunks back and forth: the fill ring gives
+// the kernel free chunks to receive into, the RX ring returns them filled, the TX ring hands over
+// chunks to send, and the completion ring returns them once they have been sent. Half of the chunks are for receiving and half for
+// sending, and a chunk's index is all that ever moves between the rings.
+//
+// A frame is only delivered to the socket if an XDP program on the device redirects it there
+// (see XdpProgram). An XdpSocket is used by one thread.
+class XdpSocket : public Socket
+{
+public:
+  struct Config
+  {
+    uint32_t frame_size = 2048;  // bytes per UMEM chunk (a power of two, at least 2048)
+    uint32_t frame_count = 4096; // chunks in the UMEM
+    uint32_t ring_size = 2048;   // descriptors per ring (a power of two)
+    bool zero_copy = false;      // needs driver support (otherwise the kernel copies frames in and out)
+  };
+
+  XdpSocket( const std::string& device, uint32_t queue );
+  XdpSocket( const std::string& device, uint32_t queue, const Config& config );
+  ~XdpSocket();
+
+  XdpSocket( const XdpSocket& other ) = delete;
+  XdpSocket& operator=( const XdpSocket& other ) = delete;
+  XdpSocket( XdpSocket&& other ) = delete;
+  XdpSocket& operator=( XdpSocket&& other ) = delete;
+
+  // Call `on_frame( std::string_view )` for every frame received so far (a view into the UMEM, valid
+  // only during the call), then give their chunks back to the kernel. Returns the number of frames.
+  template<class F>
+  size_t receive( F&& on_frame );
+
+  // Copy a frame (gathered from its pieces) into a free chunk and queue it on the TX ring. Returns
+  // false, and queues nothing, if no chunk or TX slot is free; throws if the frame is bigger
+  // than max_frame_size().
+  bool send( const std::vector<Buffer>& frame );
+
+  // Hand every frame queued by send() to the kernel, and take back the chunks of sent frames
+  void flush();
+
+  // Wait up to `timeout_ms` (or forever, if negative) for a frame to be received
+  bool wait( int timeout_ms );
+
+  size_t max_frame_size() const { return config_.frame_size; }
+
+  // The kind of pages the UMEM is on (see map_huge_pages())
+  PageBackend umem_backend() const { return umem_backend_; }
+
+private:
+  // One of the rings, shared with the kernel: producer and consumer are free-running indices
+  struct Ring
+  {
+    uint32_t* producer { nullptr };
+    uint32_t* consumer { nullptr };
+    uint32_t* flags { nullptr };
+    void* descs { nullptr };
+    uint32_t mask {};
+    void* map { nullptr };
+    size_t map_size {};
+  };
+
+  Config config_;
+  char* umem_ { nullptr };
+  size_t umem_size_ {};
+  PageBackend umem_backend_ { PageBackend::SMALL };
+  Ring fill_ {};
+  Ring completion_ {};
+  Ring rx_ {};
+  Ring tx_ {};
+  std::vector<uint64_t> tx_free_ {}; // chunks free for send()
+  uint32_t tx_producer_ {};          // TX ring producer index, published by flush()
+
+  // Wake the kernel up to receive into the fill ring, if it has asked for that
+  void kickFill();
+
+  // Move the chunks of sent frames from the completion ring to tx_free_
+  void reapCompletions();
+
+  // Unmap the UMEM and whichever rings have been mapped
+  void unmap();
+};
+
+// An XDP program on a network device that redirects frames to XdpSockets: each frame received on
+// queue q goes to the socket added for q, if there is one (and, if `ethertype` is given, only if
+// the frame has that Ethernet type); every other frame goes on into the kernel's stack as usual.
+// It is attached in generic mode, which works with every driver, unless `native` is set, and
+// detached when the XdpProgram is destroyed. Loading one needs CAP_BPF and CAP_NET_ADMIN.
+class XdpProgram
+{
+  FileDescriptor map_;
+  FileDescriptor program_;
+  FileDescriptor link_;
+
+public:
+  explicit XdpProgram( const std::string& device,
+                       uint32_t queue_count = 64,
+                       std::optional<uint16_t> ethertype = {},
+                       bool native = false );
+
+  // Redirect the frames of `queue` to `socket`
+  void add( uint32_t queue, const XdpSocket& socket );
+};
+
+template<class F>
+size_t XdpSocket::receive( F&& on_frame )
+{
+  const uint32_t rx_head = *rx_.consumer;
+  const uint32_t count = __atomic_load_n( rx_.producer, __ATOMIC_ACQUIRE ) - rx_head;
+  if ( count == 0 ) {
+    kickFill();
+    return 0;
+  }
+
+  // (as many received chunks go back on the fill ring as came off it, so it never overflows)
+  const uint32_t fill_head = *fill_.producer;
+  const auto* descs = static_cast<const xdp_desc*>( rx_.descs );
+  auto* fill = static_cast<uint64_t*>( fill_.descs );
+  for ( uint32_t i = 0; i < count; i++ ) {
+    const xdp_desc& desc = descs[( rx_head + i ) & rx_.mask];
+    on_frame( std::string_view { umem_ + desc.addr, desc.len } );
+    fill[( fill_head + i ) & fill_.mask] = desc.addr & ~( uint64_t { config_.frame_size } - 1 );
+  }
+  __atomic_store_n( rx_.consumer, rx_head + count, __ATOMIC_RELEASE );
+  __atomic_store_n( fill_.producer, fill_head + count, __ATOMIC_RELEASE );
+  return count;
+}